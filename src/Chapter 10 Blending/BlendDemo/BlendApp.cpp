@@ -7,7 +7,7 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "FrameResource.h"
-#include "Waves.h"
+#include "../../Common/Waves.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -57,9 +57,18 @@ enum class RenderLayer : int
 	Opaque = 0,
 	Transparent,
 	AlphaTested,
+	Waves,
 	Count
 };
 
+// Root constants of WavesVS, cbWaves in Default.hlsl.
+struct WaveStreamConstants
+{
+	UINT RowCount = 0;
+	UINT ColumnCount = 0;
+	float SpatialStep = 0.0f;
+};
+
 class BlendApp : public D3DApp
 {
 public:
@@ -124,8 +133,6 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
- 
-    RenderItem* mWavesRitem = nullptr;
 
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
@@ -296,6 +303,17 @@ void BlendApp::Draw(const GameTimer& gt)
 	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
 
+	// The waves are streamed as heights only; WavesVS rebuilds the vertices.
+	WaveStreamConstants waveConstants;
+	waveConstants.RowCount = mWaves->RowCount();
+	waveConstants.ColumnCount = mWaves->ColumnCount();
+	waveConstants.SpatialStep = mWaves->SpatialStep();
+
+	mCommandList->SetPipelineState(mPSOs["wavesStream"].Get());
+	mCommandList->SetGraphicsRoot32BitConstants(4, 3, &waveConstants, 0);
+	mCommandList->SetGraphicsRootShaderResourceView(5, mCurrFrameResource->WavesHeights->Resource()->GetGPUVirtualAddress());
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Waves]);
+
     // Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
@@ -514,25 +532,9 @@ void BlendApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	mWaves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
-	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for(int i = 0; i < mWaves->VertexCount(); ++i)
-	{
-		Vertex v;
-
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
-		
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
-
-		currWavesVB->CopyData(i, v);
-	}
-
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	// Only the heights change, so copy just those for this frame.  WavesVS works
+	// out the normals and texture coordinates.
+	mWaves->CopyHeights(reinterpret_cast<float*>(mCurrFrameResource->WavesHeights->MappedData()));
 }
 
 void BlendApp::LoadTextures()
@@ -569,7 +571,7 @@ void BlendApp::BuildRootSignature()
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
@@ -577,10 +579,14 @@ void BlendApp::BuildRootSignature()
     slotRootParameter[2].InitAsConstantBufferView(1);
     slotRootParameter[3].InitAsConstantBufferView(2);
 
+	// Wave grid size and the heights buffer for WavesVS.
+    slotRootParameter[4].InitAsConstants(3, 3);
+    slotRootParameter[5].InitAsShaderResourceView(1);
+
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -660,6 +666,7 @@ void BlendApp::BuildShadersAndInputLayout()
 	};
 
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_0");
+	mShaders["wavesStreamVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "WavesVS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_0");
 	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_0");
 	
@@ -758,7 +765,7 @@ void BlendApp::BuildWavesGeometry()
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "waterGeo";
 
-	// Set dynamically.
+	// No vertex buffer; WavesVS builds the vertices from the streamed heights.
 	geo->VertexBufferCPU = nullptr;
 	geo->VertexBufferGPU = nullptr;
 
@@ -885,6 +892,19 @@ void BlendApp::BuildPSOs()
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
 
+	//
+	// PSO for the wave grid streamed as heights; WavesVS builds the vertices.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesStreamPsoDesc = transparentPsoDesc;
+	wavesStreamPsoDesc.InputLayout = { nullptr, 0 };
+	wavesStreamPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["wavesStreamVS"]->GetBufferPointer()),
+		mShaders["wavesStreamVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesStreamPsoDesc, IID_PPV_ARGS(&mPSOs["wavesStream"])));
+
 	//
 	// PSO for alpha tested objects
 	//
@@ -954,9 +974,7 @@ void BlendApp::BuildRenderItems()
 	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
 
-    mWavesRitem = wavesRitem.get();
-
-	mRitemLayer[(int)RenderLayer::Transparent].push_back(wavesRitem.get());
+	mRitemLayer[(int)RenderLayer::Waves].push_back(wavesRitem.get());
 
     auto gridRitem = std::make_unique<RenderItem>();
     gridRitem->World = MathHelper::Identity4x4();
@@ -1001,7 +1019,9 @@ void BlendApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
     {
         auto ri = ritems[i];
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+        // The streamed waves have no vertex buffer.
+        if(ri->Geo->VertexBufferGPU != nullptr)
+            cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
         cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
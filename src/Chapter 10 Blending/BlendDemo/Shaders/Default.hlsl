@@ -78,6 +78,16 @@ cbuffer cbMaterial : register(b2)
 	float4x4 gMatTransform;
 };
 
+// Wave grid streamed as heights only, see WavesVS.
+cbuffer cbWaves : register(b3)
+{
+    uint gWaveRowCount;
+    uint gWaveColumnCount;
+    float gWaveSpatialStep;
+};
+
+ByteAddressBuffer gWaveHeights : register(t1);
+
 struct VertexIn
 {
 	float3 PosL    : POSITION;
@@ -114,6 +124,49 @@ VertexOut VS(VertexIn vin)
     return vout;
 }
 
+float WaveHeight(uint i)
+{
+    return asfloat(gWaveHeights.Load(i << 2));
+}
+
+// Rebuilds a wave grid vertex from its index, laid out like Waves lays out its grid.
+VertexOut WavesVS(uint vertexID : SV_VertexID)
+{
+	VertexOut vout = (VertexOut)0.0f;
+
+    uint row = vertexID / gWaveColumnCount;
+    uint col = vertexID - row*gWaveColumnCount;
+
+    float width = (gWaveColumnCount - 1)*gWaveSpatialStep;
+    float depth = (gWaveRowCount - 1)*gWaveSpatialStep;
+    float3 posL = float3(-0.5f*width + col*gWaveSpatialStep, WaveHeight(vertexID), 0.5f*depth - row*gWaveSpatialStep);
+
+    // The boundary does not move, so its normal stays straight up.  Inside, the
+    // same finite differences as Waves.
+    float3 normalL = float3(0.0f, 1.0f, 0.0f);
+    if(row > 0 && row < gWaveRowCount - 1 && col > 0 && col < gWaveColumnCount - 1)
+    {
+        float l = WaveHeight(vertexID - 1);
+        float r = WaveHeight(vertexID + 1);
+        float t = WaveHeight(vertexID - gWaveColumnCount);
+        float b = WaveHeight(vertexID + gWaveColumnCount);
+        normalL = normalize(float3(l - r, 2.0f*gWaveSpatialStep, b - t));
+    }
+
+    // Derive tex-coords from position by mapping [-w/2,w/2] --> [0,1].
+    float2 texC = float2(0.5f + posL.x/width, 0.5f - posL.z/depth);
+
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
+    vout.PosW = posW.xyz;
+    vout.NormalW = mul(normalL, (float3x3)gWorld);
+    vout.PosH = mul(posW, gViewProj);
+
+	float4 texTransformed = mul(float4(texC, 0.0f, 1.0f), gTexTransform);
+	vout.TexC = mul(texTransformed, gMatTransform).xy;
+
+    return vout;
+}
+
 float4 PS(VertexOut pin) : SV_Target
 {
     float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
@@ -89,19 +89,56 @@ struct PatchTess
 	float InsideTess[2] : SV_InsideTessFactor;
 };
 
+// Largest distance in pixels between the surface and its triangles.
+static const float gPixelTolerance = 0.5f;
+
+// Largest second difference of four projected control points.
+float SecondDifference(float2 p0, float2 p1, float2 p2, float2 p3)
+{
+	return max(length(p0 + p2 - 2.0f*p1), length(p1 + p3 - 2.0f*p2));
+}
+
+// n segments of a cubic stay within (1/8)(6D)/n^2 of it, where D is the largest
+// second difference of its control points.  This is the metric of
+// Common/BezierTessellator, so the CPU reference gives the same factors.
+float TessFactor(float d)
+{
+	return sqrt(0.75f*d/gPixelTolerance);
+}
+
 PatchTess ConstantHS(InputPatch<VertexOut, 16> patch, uint patchID : SV_PrimitiveID)
 {
 	PatchTess pt;
 	
-	// Uniform tessellation for this demo.
-
-	pt.EdgeTess[0] = 25;
-	pt.EdgeTess[1] = 25;
-	pt.EdgeTess[2] = 25;
-	pt.EdgeTess[3] = 25;
+	// Control points in pixels.  Points behind the eye get a tiny w, which sends
+	// the factors to the maximum.
+	float2 s[16];
+	[unroll]
+	for(int i = 0; i < 16; ++i)
+	{
+		float4 posW = mul(float4(patch[i].PosL, 1.0f), gWorld);
+		float4 posH = mul(posW, gViewProj);
+		s[i] = 0.5f*gRenderTargetSize*float2(posH.x, -posH.y) / max(posH.w, 1.0e-4f);
+	}
+
+	float row[4];
+	float column[4];
+	[unroll]
+	for(int k = 0; k < 4; ++k)
+	{
+		row[k] = SecondDifference(s[4*k], s[4*k + 1], s[4*k + 2], s[4*k + 3]);
+		column[k] = SecondDifference(s[k], s[4 + k], s[8 + k], s[12 + k]);
+	}
+
+	// An edge's factor only depends on the edge's own control points, so patches
+	// that share an edge agree on it.
+	pt.EdgeTess[0] = TessFactor(column[0]);
+	pt.EdgeTess[1] = TessFactor(row[0]);
+	pt.EdgeTess[2] = TessFactor(column[3]);
+	pt.EdgeTess[3] = TessFactor(row[3]);
 	
-	pt.InsideTess[0] = 25;
-	pt.InsideTess[1] = 25;
+	pt.InsideTess[0] = TessFactor(max(max(row[0], row[1]), max(row[2], row[3])));
+	pt.InsideTess[1] = TessFactor(max(max(column[0], column[1]), max(column[2], column[3])));
 	
 	return pt;
 }
@@ -114,7 +151,7 @@ struct HullOut
 // This Hull Shader part is commonly used for a coordinate basis change, 
 // for example changing from a quad to a Bezier bi-cubic.
 [domain("quad")]
-[partitioning("integer")]
+[partitioning("fractional_odd")]
 [outputtopology("triangle_cw")]
 [outputcontrolpoints(16)]
 [patchconstantfunc("ConstantHS")]
@@ -7,7 +7,9 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/DrawBatcher.h"
 #include "FrameResource.h"
+#include <tuple>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -32,18 +34,13 @@ struct RenderItem
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource.  Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
-
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-	UINT ObjCBIndex = -1;
-
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
 
+	// Ids of Geo and of the submesh drawn, which tell the draw batcher what items share.
+	UINT GeoIndex = 0;
+	UINT MeshIndex = 0;
+
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -74,7 +71,7 @@ private:
 
     void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
-	void UpdateObjectCBs(const GameTimer& gt);
+	void UpdateInstanceBuffer(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 
@@ -117,6 +114,11 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mOpaqueRitems;
 
+	// Sorts and batches mOpaqueRitems each frame; with mBatching off they are drawn
+	// one at a time in the order above, as before.
+	std::unique_ptr<DrawBatcher> mBatcher;
+	bool mBatching = true;
+
     PassConstants mMainPassCB;
 
 	Camera mCamera;
@@ -171,6 +173,12 @@ bool CameraAndDynamicIndexingApp::Initialize()
     mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
 	mCamera.SetPosition(0.0f, 2.0f, -15.0f);
+
+	// The shader reads the material index from the instance data, so items that differ
+	// only in material still draw as one batch.
+	DrawBatcher::Desc batchDesc;
+	batchDesc.MaterialPerInstance = true;
+	mBatcher = std::make_unique<DrawBatcher>(batchDesc);
  
 	LoadTextures();
     BuildRootSignature();
@@ -219,7 +227,7 @@ void CameraAndDynamicIndexingApp::Update(const GameTimer& gt)
     }
 
 	AnimateMaterials(gt);
-	UpdateObjectCBs(gt);
+	UpdateInstanceBuffer(gt);
 	UpdateMaterialBuffer(gt);
 	UpdateMainPassCB(gt);
 }
@@ -339,6 +347,16 @@ void CameraAndDynamicIndexingApp::OnKeyboardInput(const GameTimer& gt)
 	if(GetAsyncKeyState('D') & 0x8000)
 		mCamera.Strafe(10.0f*dt);
 
+	static bool bBatchKeyPressed = false;
+	if(GetAsyncKeyState('B') & 0x8000)
+	{
+		if(!bBatchKeyPressed)
+			mBatching = !mBatching;
+		bBatchKeyPressed = true;
+	}
+	else
+		bBatchKeyPressed = false;
+
 	mCamera.UpdateViewMatrix();
 }
  
@@ -347,28 +365,43 @@ void CameraAndDynamicIndexingApp::AnimateMaterials(const GameTimer& gt)
 	
 }
 
-void CameraAndDynamicIndexingApp::UpdateObjectCBs(const GameTimer& gt)
+void CameraAndDynamicIndexingApp::UpdateInstanceBuffer(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for(auto& e : mAllRitems)
+	XMMATRIX view = mCamera.GetView();
+
+	// All the items are opaque and share one PSO.  Depth is that of the item's origin.
+	mBatcher->Clear();
+	for(auto ri : mOpaqueRitems)
 	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if(e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+		XMMATRIX world = XMLoadFloat4x4(&ri->World);
+
+		DrawBatcher::Draw draw;
+		draw.Material = ri->Mat->MatCBIndex;
+		draw.Geometry = ri->GeoIndex;
+		draw.Mesh = ri->MeshIndex;
+		draw.Depth = XMVectorGetZ(XMVector3TransformCoord(world.r[3], view));
+		mBatcher->Add(draw);
+	}
+	mBatcher->Build();
+
+	// Batched, the instances go in sorted order so that each batch reads a contiguous
+	// range; otherwise item i is instance i.  The order changes with the camera, so the
+	// whole buffer is written every frame.
+	auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
+	const std::vector<uint32_t>& order = mBatcher->Order();
+	for(size_t k = 0; k < mOpaqueRitems.size(); ++k)
+	{
+		RenderItem* ri = mOpaqueRitems[mBatching ? order[k] : k];
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
-			objConstants.MaterialIndex = e->Mat->MatCBIndex;
+		XMMATRIX world = XMLoadFloat4x4(&ri->World);
+		XMMATRIX texTransform = XMLoadFloat4x4(&ri->TexTransform);
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+		InstanceData instData;
+		XMStoreFloat4x4(&instData.World, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&instData.TexTransform, XMMatrixTranspose(texTransform));
+		instData.MaterialIndex = ri->Mat->MatCBIndex;
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
+		currInstanceBuffer->CopyData((int)k, instData);
 	}
 }
 
@@ -476,19 +509,20 @@ void CameraAndDynamicIndexingApp::BuildRootSignature()
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, 0, 0);
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[5];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
-    slotRootParameter[0].InitAsConstantBufferView(0);
+    slotRootParameter[0].InitAsConstants(1, 0);
     slotRootParameter[1].InitAsConstantBufferView(1);
     slotRootParameter[2].InitAsShaderResourceView(0, 1);
 	slotRootParameter[3].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[4].InitAsShaderResourceView(1, 1);
 
 
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -793,7 +827,6 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
 	auto boxRitem = std::make_unique<RenderItem>();
 	XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(2.0f, 2.0f, 2.0f)*XMMatrixTranslation(0.0f, 1.0f, 0.0f));
 	XMStoreFloat4x4(&boxRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	boxRitem->ObjCBIndex = 0;
 	boxRitem->Mat = mMaterials["crate0"].get();
 	boxRitem->Geo = mGeometries["shapeGeo"].get();
 	boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -805,7 +838,6 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
     auto gridRitem = std::make_unique<RenderItem>();
     gridRitem->World = MathHelper::Identity4x4();
 	XMStoreFloat4x4(&gridRitem->TexTransform, XMMatrixScaling(8.0f, 8.0f, 1.0f));
-	gridRitem->ObjCBIndex = 1;
 	gridRitem->Mat = mMaterials["tile0"].get();
 	gridRitem->Geo = mGeometries["shapeGeo"].get();
 	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -815,7 +847,6 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
 	mAllRitems.push_back(std::move(gridRitem));
 
 	XMMATRIX brickTexTransform = XMMatrixScaling(1.0f, 1.0f, 1.0f);
-	UINT objCBIndex = 2;
 	for(int i = 0; i < 5; ++i)
 	{
 		auto leftCylRitem = std::make_unique<RenderItem>();
@@ -831,7 +862,6 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
 
 		XMStoreFloat4x4(&leftCylRitem->World, rightCylWorld);
 		XMStoreFloat4x4(&leftCylRitem->TexTransform, brickTexTransform);
-		leftCylRitem->ObjCBIndex = objCBIndex++;
 		leftCylRitem->Mat = mMaterials["bricks0"].get();
 		leftCylRitem->Geo = mGeometries["shapeGeo"].get();
 		leftCylRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -841,7 +871,6 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
 
 		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		XMStoreFloat4x4(&rightCylRitem->TexTransform, brickTexTransform);
-		rightCylRitem->ObjCBIndex = objCBIndex++;
 		rightCylRitem->Mat = mMaterials["bricks0"].get();
 		rightCylRitem->Geo = mGeometries["shapeGeo"].get();
 		rightCylRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -851,7 +880,6 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
 
 		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->TexTransform = MathHelper::Identity4x4();
-		leftSphereRitem->ObjCBIndex = objCBIndex++;
 		leftSphereRitem->Mat = mMaterials["stone0"].get();
 		leftSphereRitem->Geo = mGeometries["shapeGeo"].get();
 		leftSphereRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -861,7 +889,6 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
 
 		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->TexTransform = MathHelper::Identity4x4();
-		rightSphereRitem->ObjCBIndex = objCBIndex++;
 		rightSphereRitem->Mat = mMaterials["stone0"].get();
 		rightSphereRitem->Geo = mGeometries["shapeGeo"].get();
 		rightSphereRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -878,32 +905,68 @@ void CameraAndDynamicIndexingApp::BuildRenderItems()
 	// All the render items are opaque.
 	for(auto& e : mAllRitems)
 		mOpaqueRitems.push_back(e.get());
+
+	// Number the geometries and the submeshes the items draw.
+	std::vector<MeshGeometry*> geos;
+	std::vector<std::tuple<MeshGeometry*, UINT, UINT, int>> meshes;
+	for(auto& e : mAllRitems)
+	{
+		auto geo = std::find(geos.begin(), geos.end(), e->Geo);
+		e->GeoIndex = (UINT)(geo - geos.begin());
+		if(geo == geos.end())
+			geos.push_back(e->Geo);
+
+		auto key = std::make_tuple(e->Geo, e->IndexCount, e->StartIndexLocation, e->BaseVertexLocation);
+		auto mesh = std::find(meshes.begin(), meshes.end(), key);
+		e->MeshIndex = (UINT)(mesh - meshes.begin());
+		if(mesh == meshes.end())
+			meshes.push_back(key);
+	}
 }
 
 void CameraAndDynamicIndexingApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
-    UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
- 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	// For structured buffers, we can bypass the heap and set as a root descriptor.
+	auto instanceBuffer = mCurrFrameResource->InstanceBuffer->Resource();
+	cmdList->SetGraphicsRootShaderResourceView(4, instanceBuffer->GetGPUVirtualAddress());
 
-    // For each render item...
-    for(size_t i = 0; i < ritems.size(); ++i)
-    {
-        auto ri = ritems[i];
+	if(!mBatching)
+	{
+		// For each render item...
+		for(size_t i = 0; i < ritems.size(); ++i)
+		{
+			auto ri = ritems[i];
+
+			cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+			cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-        cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
-        cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
-        cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+			cmdList->SetGraphicsRoot32BitConstant(0, (UINT)i, 0);
 
-        D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
+		return;
+	}
+
+	// The batches were made from these items in UpdateInstanceBuffer.  The one PSO was set
+	// when the command list was reset and the material index comes with each instance, so
+	// a batch may span materials and only a change of geometry needs binding.
+	const std::vector<uint32_t>& order = mBatcher->Order();
+	for(const DrawBatcher::Batch& batch : mBatcher->Batches())
+	{
+		auto ri = ritems[order[batch.First]];
 
-		// CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-		// tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+		if(batch.GeometryChanged)
+		{
+			cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+			cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+		}
 
-		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+		cmdList->SetGraphicsRoot32BitConstant(0, batch.First, 0);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
-    }
+		cmdList->DrawIndexedInstanced(ri->IndexCount, batch.Count, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+	}
 }
 
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> CameraAndDynamicIndexingApp::GetStaticSamplers()
@@ -0,0 +1,156 @@
+#include "InstanceBvh.h"
+#include "../../Common/MathHelper.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+void InstanceBvh::Build(const std::vector<BoundingBox>& worldBounds)
+{
+	UINT instanceCount = (UINT)worldBounds.size();
+
+	mNodes.clear();
+	mOrder.resize(instanceCount);
+	for(UINT i = 0; i < instanceCount; ++i)
+		mOrder[i] = i;
+
+	// mBounds is indexed by instance while building and by slot afterwards.
+	mBounds = worldBounds;
+
+	if(instanceCount > 0)
+	{
+		mNodes.reserve(2 * (instanceCount / MaxLeafSize + 1));
+		BuildNode(0, 0, instanceCount);
+	}
+
+	std::vector<BoundingBox> ordered(instanceCount);
+	mSlot.resize(instanceCount);
+	for(UINT i = 0; i < instanceCount; ++i)
+	{
+		ordered[i] = worldBounds[mOrder[i]];
+		mSlot[mOrder[i]] = i;
+	}
+	mBounds.swap(ordered);
+
+	mLeaf.resize(instanceCount);
+	for(UINT n = 0; n < (UINT)mNodes.size(); ++n)
+	{
+		if(mNodes[n].Right == 0)
+		{
+			for(UINT i = mNodes[n].First; i < mNodes[n].First + mNodes[n].Count; ++i)
+				mLeaf[mOrder[i]] = n;
+		}
+	}
+
+	mDirty.assign(mNodes.size(), false);
+	mAnyDirty = false;
+}
+
+UINT InstanceBvh::BuildNode(UINT parent, UINT first, UINT count)
+{
+	UINT index = (UINT)mNodes.size();
+	mNodes.push_back(Node());
+	mNodes[index].First = first;
+	mNodes[index].Count = count;
+	mNodes[index].Parent = parent;
+
+	XMVECTOR boxMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR boxMax = XMVectorReplicate(-MathHelper::Infinity);
+	XMVECTOR centerMin = boxMin;
+	XMVECTOR centerMax = boxMax;
+	for(UINT i = first; i < first + count; ++i)
+	{
+		const BoundingBox& box = mBounds[mOrder[i]];
+		XMVECTOR center = XMLoadFloat3(&box.Center);
+		XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+		boxMin = XMVectorMin(boxMin, XMVectorSubtract(center, extents));
+		boxMax = XMVectorMax(boxMax, XMVectorAdd(center, extents));
+		centerMin = XMVectorMin(centerMin, center);
+		centerMax = XMVectorMax(centerMax, center);
+	}
+	BoundingBox::CreateFromPoints(mNodes[index].Bounds, boxMin, boxMax);
+
+	if(count <= MaxLeafSize)
+		return index;
+
+	// Split at the median along the axis the box centers spread the most.
+	XMFLOAT3 spread;
+	XMStoreFloat3(&spread, XMVectorSubtract(centerMax, centerMin));
+	int axis = 0;
+	if(spread.y > spread.x)
+		axis = 1;
+	if(spread.z > (&spread.x)[axis])
+		axis = 2;
+
+	UINT half = count / 2;
+	auto begin = mOrder.begin() + first;
+	std::nth_element(begin, begin + half, begin + count, [&](UINT a, UINT b)
+	{
+		return (&mBounds[a].Center.x)[axis] < (&mBounds[b].Center.x)[axis];
+	});
+
+	BuildNode(index, first, half);
+	UINT right = BuildNode(index, first + half, count - half);
+	mNodes[index].Right = right;
+
+	return index;
+}
+
+void InstanceBvh::SetBounds(UINT instance, const BoundingBox& worldBounds)
+{
+	mBounds[mSlot[instance]] = worldBounds;
+
+	// Mark the path to the root; stop where another moved instance already did.
+	UINT node = mLeaf[instance];
+	while(!mDirty[node])
+	{
+		mDirty[node] = true;
+		if(node == 0)
+			break;
+		node = mNodes[node].Parent;
+	}
+
+	mAnyDirty = true;
+}
+
+void InstanceBvh::Refit()
+{
+	if(!mAnyDirty)
+		return;
+
+	// Children are stored after their parent, so walking backwards updates
+	// both children before the parent.
+	for(UINT n = (UINT)mNodes.size(); n-- > 0; )
+	{
+		if(mDirty[n])
+		{
+			UpdateNode(n);
+			mDirty[n] = false;
+		}
+	}
+
+	mAnyDirty = false;
+}
+
+void InstanceBvh::UpdateNode(UINT index)
+{
+	Node& node = mNodes[index];
+
+	if(node.Right != 0)
+	{
+		BoundingBox::CreateMerged(node.Bounds, mNodes[index + 1].Bounds, mNodes[node.Right].Bounds);
+		return;
+	}
+
+	XMVECTOR boxMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR boxMax = XMVectorReplicate(-MathHelper::Infinity);
+	for(UINT i = node.First; i < node.First + node.Count; ++i)
+	{
+		XMVECTOR center = XMLoadFloat3(&mBounds[i].Center);
+		XMVECTOR extents = XMLoadFloat3(&mBounds[i].Extents);
+
+		boxMin = XMVectorMin(boxMin, XMVectorSubtract(center, extents));
+		boxMax = XMVectorMax(boxMax, XMVectorAdd(center, extents));
+	}
+	BoundingBox::CreateFromPoints(node.Bounds, boxMin, boxMax);
+}
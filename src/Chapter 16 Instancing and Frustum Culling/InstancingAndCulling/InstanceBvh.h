@@ -0,0 +1,126 @@
+#ifndef INSTANCEBVH_H
+#define INSTANCEBVH_H
+
+#include "../../Common/MathHelper.h"
+#include <DirectXCollision.h>
+#include <vector>
+
+///<summary>
+/// Bounding volume hierarchy over the world space boxes of a render item's
+/// instances, used to frustum cull them without visiting every instance.
+///
+/// Each instance's box is transformed to world space once, when it is built
+/// or moved, instead of moving the frustum into every instance's local space
+/// each frame.  The hierarchy is built once with median splits; when instances
+/// move, SetBounds marks the path to the root and Refit grows or shrinks just
+/// those nodes.  Refitting keeps the tree valid but not tight, so after large
+/// rearrangements call Build again.
+///
+/// Cull visits the tree top down: a node outside the frustum is dropped with
+/// its whole subtree, and a node completely inside it hands over all of its
+/// instances without testing them.  Only instances in leaves that straddle a
+/// frustum plane are tested one by one.  The world box of a rotated instance
+/// is larger than its local box, so Cull may accept an instance the per-instance
+/// local space test rejects, but never the other way round.
+///</summary>
+
+class InstanceBvh
+{
+public:
+    // One world space box per instance, indexed by instance.
+    void Build(const std::vector<DirectX::BoundingBox>& worldBounds);
+
+    // Moves an instance.  The tree is updated by the next Refit.
+    void SetBounds(UINT instance, const DirectX::BoundingBox& worldBounds);
+    void Refit();
+
+    // Calls visit(instance) for each instance whose box is not outside the
+    // world space frustum, in tree order.
+    template<typename Visitor>
+    void Cull(const DirectX::BoundingFrustum& worldFrustum, Visitor&& visit)const;
+
+    UINT InstanceCount()const { return (UINT)mOrder.size(); }
+    UINT NodeCount()const { return (UINT)mNodes.size(); }
+
+private:
+    struct Node
+    {
+        DirectX::BoundingBox Bounds;
+        UINT First = 0;     // The node's instances are mOrder[First, First + Count).
+        UINT Count = 0;
+        UINT Right = 0;     // Right child, the left child follows the node.  0 for a leaf.
+        UINT Parent = 0;
+    };
+
+    UINT BuildNode(UINT parent, UINT first, UINT count);
+    void UpdateNode(UINT node);
+
+private:
+    static const UINT MaxLeafSize = 8;
+    static const UINT MaxDepth = 64;
+
+    std::vector<Node> mNodes;
+
+    // Instance indices in leaf order, and their boxes in the same order so a
+    // leaf reads them contiguously.
+    std::vector<UINT> mOrder;
+    std::vector<DirectX::BoundingBox> mBounds;
+
+    // Per instance: position in mOrder and the leaf holding it.
+    std::vector<UINT> mSlot;
+    std::vector<UINT> mLeaf;
+
+    std::vector<bool> mDirty;
+    bool mAnyDirty = false;
+};
+
+template<typename Visitor>
+void InstanceBvh::Cull(const DirectX::BoundingFrustum& worldFrustum, Visitor&& visit)const
+{
+    using namespace DirectX;
+
+    if(mNodes.empty())
+        return;
+
+    XMVECTOR planes[6];
+    worldFrustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+    UINT stack[MaxDepth + 1];
+    UINT stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0)
+    {
+        const Node& node = mNodes[stack[--stackSize]];
+
+        ContainmentType containment = node.Bounds.ContainedBy(
+            planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]);
+
+        if(containment == DISJOINT)
+            continue;
+
+        if(containment == CONTAINS)
+        {
+            // The whole subtree is visible.
+            for(UINT i = node.First; i < node.First + node.Count; ++i)
+                visit(mOrder[i]);
+        }
+        else if(node.Right == 0)
+        {
+            for(UINT i = node.First; i < node.First + node.Count; ++i)
+            {
+                if(mBounds[i].ContainedBy(planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]) != DISJOINT)
+                    visit(mOrder[i]);
+            }
+        }
+        else
+        {
+            // Left child on top so instances come out in tree order.
+            UINT index = (UINT)(&node - mNodes.data());
+            stack[stackSize++] = node.Right;
+            stack[stackSize++] = index + 1;
+        }
+    }
+}
+
+#endif // INSTANCEBVH_H
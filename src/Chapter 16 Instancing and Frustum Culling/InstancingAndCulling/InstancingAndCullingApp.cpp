@@ -7,7 +7,10 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/OcclusionRasterizer.h"
+#include "../../Common/ModelLoader.h"
 #include "FrameResource.h"
+#include "InstanceBvh.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -50,6 +53,12 @@ struct RenderItem
 	BoundingBox Bounds;
 	std::vector<InstanceData> Instances;
 
+	// The instances as the shader reads them, with transposed matrices, their
+	// world space bounds and a hierarchy over the bounds for culling.
+	std::vector<InstanceData> ShaderInstances;
+	std::vector<BoundingBox> WorldBounds;
+	InstanceBvh InstanceTree;
+
     // DrawIndexedInstanced parameters.
     UINT IndexCount = 0;
 	UINT InstanceCount = 0;
@@ -81,6 +90,7 @@ private:
 	void UpdateInstanceData(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void RasterizeOccluders(const RenderItem* ri, const std::vector<UINT>& candidates, CXMMATRIX viewProj);
 
 	void LoadTextures();
     void BuildRootSignature();
@@ -124,9 +134,15 @@ private:
 	UINT mInstanceCount = 0;
 
 	bool mFrustumCullingEnabled = true;
+	bool mOcclusionCullingEnabled = false;
 
 	BoundingFrustum mCamFrustum;
 
+	// Low resolution depth of the nearest instances, and the instances that passed
+	// frustum culling this frame.
+	OcclusionRasterizer mOcclusionRasterizer;
+	std::vector<UINT> mOcclusionCandidates;
+
     PassConstants mMainPassCB;
 
 	Camera mCamera;
@@ -210,6 +226,8 @@ void InstancingAndCullingApp::OnResize()
 	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 
 	BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
+
+	mOcclusionRasterizer.Resize(256, (UINT)(256 / AspectRatio()));
 }
 
 void InstancingAndCullingApp::Update(const GameTimer& gt)
@@ -355,6 +373,12 @@ void InstancingAndCullingApp::OnKeyboardInput(const GameTimer& gt)
 	if(GetAsyncKeyState('2') & 0x8000)
 		mFrustumCullingEnabled = false;
 
+	if(GetAsyncKeyState('3') & 0x8000)
+		mOcclusionCullingEnabled = true;
+
+	if(GetAsyncKeyState('4') & 0x8000)
+		mOcclusionCullingEnabled = false;
+
 	mCamera.UpdateViewMatrix();
 }
  
@@ -368,39 +392,48 @@ void InstancingAndCullingApp::UpdateInstanceData(const GameTimer& gt)
 	XMMATRIX view = mCamera.GetView();
 	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
 
+	// The instance bounds are kept in world space, so the frustum is moved
+	// there once instead of into every instance's local space.
+	BoundingFrustum worldSpaceFrustum;
+	mCamFrustum.Transform(worldSpaceFrustum, invView);
+
+	XMMATRIX viewProj = XMMatrixMultiply(view, mCamera.GetProj());
+
 	auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
 	for(auto& e : mAllRitems)
 	{
-		const auto& instanceData = e->Instances;
+		const auto& shaderInstances = e->ShaderInstances;
 
 		int visibleInstanceCount = 0;
 
-		for(UINT i = 0; i < (UINT)instanceData.size(); ++i)
+		// Write the instance data to structured buffer for the visible objects.
+		auto writeInstance = [&](UINT i)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
+			currInstanceBuffer->CopyData(visibleInstanceCount++, shaderInstances[i]);
+		};
 
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+		if(mFrustumCullingEnabled && mOcclusionCullingEnabled)
+		{
+			// Draw the nearest instances that survive frustum culling into the software
+			// depth buffer, then drop the instances hidden behind them.
+			mOcclusionCandidates.clear();
+			e->InstanceTree.Cull(worldSpaceFrustum, [&](UINT i) { mOcclusionCandidates.push_back(i); });
 
-			// View space to the object's local space.
-			XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
- 
-			// Transform the camera frustum from view space to the object's local space.
-			BoundingFrustum localSpaceFrustum;
-			mCamFrustum.Transform(localSpaceFrustum, viewToLocal);
+			RasterizeOccluders(e.get(), mOcclusionCandidates, viewProj);
 
-			// Perform the box/frustum intersection test in local space.
-			if((localSpaceFrustum.Contains(e->Bounds) != DirectX::DISJOINT) || (mFrustumCullingEnabled==false))
+			for(UINT i : mOcclusionCandidates)
 			{
-				InstanceData data;
-				XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
-				XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-				data.MaterialIndex = instanceData[i].MaterialIndex;
-
-				// Write the instance data to structured buffer for the visible objects.
-				currInstanceBuffer->CopyData(visibleInstanceCount++, data);
+				if(mOcclusionRasterizer.IsVisible(e->WorldBounds[i], viewProj))
+					writeInstance(i);
 			}
 		}
+		else if(mFrustumCullingEnabled)
+			e->InstanceTree.Cull(worldSpaceFrustum, writeInstance);
+		else
+		{
+			for(UINT i = 0; i < (UINT)shaderInstances.size(); ++i)
+				writeInstance(i);
+		}
 
 		e->InstanceCount = visibleInstanceCount;
 
@@ -413,6 +446,38 @@ void InstancingAndCullingApp::UpdateInstanceData(const GameTimer& gt)
 	}
 }
 
+void InstancingAndCullingApp::RasterizeOccluders(const RenderItem* ri, const std::vector<UINT>& candidates, CXMMATRIX viewProj)
+{
+	// The nearest instances cover the most of the screen.
+	const size_t maxOccluders = 4;
+	size_t occluderCount = MathHelper::Min(maxOccluders, candidates.size());
+
+	XMVECTOR eye = mCamera.GetPosition();
+	auto distanceSq = [&](UINT i)
+	{
+		return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&ri->WorldBounds[i].Center), eye)));
+	};
+
+	std::vector<UINT> nearest(candidates);
+	std::partial_sort(nearest.begin(), nearest.begin() + occluderCount, nearest.end(),
+		[&](UINT a, UINT b) { return distanceSq(a) < distanceSq(b); });
+
+	// The occluders are the render item's own triangles, read from the CPU copy of its buffers.
+	const MeshGeometry* geo = ri->Geo;
+	const BYTE* positions = (const BYTE*)geo->VertexBufferCPU->GetBufferPointer() + ri->BaseVertexLocation * geo->VertexByteStride;
+	const UINT vertexCount = geo->VertexBufferByteSize / geo->VertexByteStride - ri->BaseVertexLocation;
+	const std::uint32_t* indices = (const std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer() + ri->StartIndexLocation;
+
+	mOcclusionRasterizer.Clear();
+	for(size_t k = 0; k < occluderCount; ++k)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&ri->Instances[nearest[k]].World);
+		mOcclusionRasterizer.AddOccluder(positions, geo->VertexByteStride, vertexCount,
+			indices, ri->IndexCount, XMMatrixMultiply(world, viewProj));
+	}
+	mOcclusionRasterizer.Rasterize();
+}
+
 void InstancingAndCullingApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
 	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
@@ -475,6 +540,26 @@ void InstancingAndCullingApp::UpdateMainPassCB(const GameTimer& gt)
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
+// Transposes the instance matrices for the shader and moves the mesh bounds
+// into world space for each instance.
+static void PrepareInstances(const BoundingBox& localBounds, const std::vector<InstanceData>& instances,
+	std::vector<InstanceData>& shaderInstances, std::vector<BoundingBox>& worldBounds)
+{
+	shaderInstances.resize(instances.size());
+	worldBounds.resize(instances.size());
+	for(size_t i = 0; i < instances.size(); ++i)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&instances[i].World);
+		XMMATRIX texTransform = XMLoadFloat4x4(&instances[i].TexTransform);
+
+		XMStoreFloat4x4(&shaderInstances[i].World, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&shaderInstances[i].TexTransform, XMMatrixTranspose(texTransform));
+		shaderInstances[i].MaterialIndex = instances[i].MaterialIndex;
+
+		localBounds.Transform(worldBounds[i], world);
+	}
+}
+
 void InstancingAndCullingApp::LoadTextures()
 {
 	auto bricksTex = std::make_unique<Texture>();
@@ -672,33 +757,18 @@ void InstancingAndCullingApp::BuildShadersAndInputLayout()
 
 void InstancingAndCullingApp::BuildSkullGeometry()
 {
-	std::ifstream fin("Models/skull.txt");
-
-	if(!fin)
+	ModelData model;
+	if(!ModelLoader::Load("Models/skull.txt", model))
 	{
 		MessageBox(0, L"Models/skull.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
-
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-	std::vector<Vertex> vertices(vcount);
-	for(UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(model.Positions.size());
+	for(size_t i = 0; i < vertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		vertices[i].Pos = model.Positions[i];
+		vertices[i].Normal = model.Normals[i];
 
 		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
 
@@ -718,26 +788,9 @@ void InstancingAndCullingApp::BuildSkullGeometry()
 		float v = phi / XM_PI;
 
 		vertices[i].TexC = { u, v };
-
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
-	}
-
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
-
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for(UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
 	}
 
-	fin.close();
+	const std::vector<std::int32_t>& indices = model.Indices;
 
 	//
 	// Pack the indices of all the meshes into one index buffer.
@@ -771,7 +824,7 @@ void InstancingAndCullingApp::BuildSkullGeometry()
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
-	submesh.Bounds = bounds;
+	submesh.Bounds = model.Bounds;
 
 	geo->DrawArgs["skull"] = submesh;
 
@@ -938,6 +991,9 @@ void InstancingAndCullingApp::BuildRenderItems()
 		}
 	}
 
+	// World space bounds are computed once here and only change if an instance moves.
+	PrepareInstances(skullRitem->Bounds, skullRitem->Instances, skullRitem->ShaderInstances, skullRitem->WorldBounds);
+	skullRitem->InstanceTree.Build(skullRitem->WorldBounds);
 
 	mAllRitems.push_back(std::move(skullRitem));
 	
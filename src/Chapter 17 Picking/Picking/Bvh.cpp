@@ -0,0 +1,639 @@
+#include "Bvh.h"
+#include <atomic>
+#include <climits>
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace
+{
+	const UINT BinCount = 12;
+
+	// Subtrees with more primitives than this are built as parallel tasks.
+	const UINT ParallelBuildSize = 4096;
+
+	// Below this depth nodes are split in half by primitive count instead of by
+	// SAH, so even a pathological mesh cannot overflow the traversal stack.
+	const UINT MaxSahDepth = 48;
+	const int TraversalStackSize = 128;
+
+	// Relative slack on box sizes, slab distances and triangle test terms.  They
+	// only decide what is tested exactly, so slack costs a few extra tests, never
+	// a different answer.  Slab distances get the most: the distance
+	// TriangleTests reports for a ray grazing a triangle can put the hit point
+	// slightly outside the triangle's box.
+	const float BoxSlack = 1e-5f;
+	const float DistanceSlack = 1e-3f;
+	const float TriangleSlack = 1e-5f;
+
+	// SAH cost of testing one primitive relative to one box test.  Triangles are
+	// tested four at a time, so a leaf of a few is barely dearer than a box.
+	const float PrimitiveCost = 0.25f;
+
+	float HalfArea(FXMVECTOR boxMin, FXMVECTOR boxMax)
+	{
+		XMFLOAT3 e;
+		XMStoreFloat3(&e, XMVectorMax(XMVectorSubtract(boxMax, boxMin), XMVectorZero()));
+		return e.x*e.y + e.y*e.z + e.z*e.x;
+	}
+
+	struct Builder
+	{
+		const std::vector<XMFLOAT3>* PrimMin = nullptr;
+		const std::vector<XMFLOAT3>* PrimMax = nullptr;
+		std::vector<XMFLOAT3> Centroids;
+		std::vector<UINT>* Order = nullptr;
+		std::vector<BvhNode>* Nodes = nullptr;
+		std::atomic<UINT> NodeCount;
+		UINT MaxLeafSize = 4;
+
+		void Subdivide(UINT nodeIndex, UINT first, UINT count, UINT depth);
+		UINT SplitMedian(UINT first, UINT count, int axis);
+	};
+
+	void Builder::Subdivide(UINT nodeIndex, UINT first, UINT count, UINT depth)
+	{
+		std::vector<UINT>& order = *Order;
+
+		XMVECTOR boxMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR boxMax = XMVectorReplicate(-MathHelper::Infinity);
+		XMVECTOR centroidMin = boxMin;
+		XMVECTOR centroidMax = boxMax;
+		for(UINT i = first; i < first + count; ++i)
+		{
+			UINT p = order[i];
+			XMVECTOR c = XMLoadFloat3(&Centroids[p]);
+			boxMin = XMVectorMin(boxMin, XMLoadFloat3(&(*PrimMin)[p]));
+			boxMax = XMVectorMax(boxMax, XMLoadFloat3(&(*PrimMax)[p]));
+			centroidMin = XMVectorMin(centroidMin, c);
+			centroidMax = XMVectorMax(centroidMax, c);
+		}
+
+		// Pad the box so a primitive touching its face is strictly inside.
+		XMVECTOR pad = XMVectorScale(XMVectorAdd(XMVectorSubtract(boxMax, boxMin),
+			XMVectorAdd(XMVectorAbs(boxMin), XMVectorAbs(boxMax))), BoxSlack);
+
+		BvhNode& node = (*Nodes)[nodeIndex];
+		XMStoreFloat3(&node.Min, XMVectorSubtract(boxMin, pad));
+		XMStoreFloat3(&node.Max, XMVectorAdd(boxMax, pad));
+		node.LeftFirst = first;
+		node.Count = count;
+
+		if(count == 1)
+			return;
+
+		XMFLOAT3 cMin, cExtent;
+		XMStoreFloat3(&cMin, centroidMin);
+		XMStoreFloat3(&cExtent, XMVectorSubtract(centroidMax, centroidMin));
+
+		// Binned SAH: a split costs one more box test plus the expected primitive
+		// tests in the children; a leaf costs testing every primitive here.
+		int bestAxis = -1;
+		UINT bestBin = 0;
+		float bestCost = MathHelper::Infinity;
+		if(depth < MaxSahDepth)
+		{
+			for(int axis = 0; axis < 3; ++axis)
+			{
+				float extent = (&cExtent.x)[axis];
+				if(extent <= 0.0f)
+					continue;
+
+				UINT binPrims[BinCount] = {};
+				XMVECTOR binMin[BinCount], binMax[BinCount];
+				for(UINT b = 0; b < BinCount; ++b)
+				{
+					binMin[b] = XMVectorReplicate(+MathHelper::Infinity);
+					binMax[b] = XMVectorReplicate(-MathHelper::Infinity);
+				}
+
+				float scale = BinCount / extent;
+				for(UINT i = first; i < first + count; ++i)
+				{
+					UINT p = order[i];
+					UINT b = MathHelper::Min(BinCount - 1, (UINT)(((&Centroids[p].x)[axis] - (&cMin.x)[axis]) * scale));
+					binPrims[b]++;
+					binMin[b] = XMVectorMin(binMin[b], XMLoadFloat3(&(*PrimMin)[p]));
+					binMax[b] = XMVectorMax(binMax[b], XMLoadFloat3(&(*PrimMax)[p]));
+				}
+
+				// Sweep from the right to get the cost of everything past each plane.
+				float rightCost[BinCount];
+				XMVECTOR sweepMin = XMVectorReplicate(+MathHelper::Infinity);
+				XMVECTOR sweepMax = XMVectorReplicate(-MathHelper::Infinity);
+				UINT sweepPrims = 0;
+				for(UINT b = BinCount - 1; b > 0; --b)
+				{
+					sweepMin = XMVectorMin(sweepMin, binMin[b]);
+					sweepMax = XMVectorMax(sweepMax, binMax[b]);
+					sweepPrims += binPrims[b];
+					rightCost[b] = sweepPrims ? sweepPrims * HalfArea(sweepMin, sweepMax) : -1.0f;
+				}
+
+				sweepMin = XMVectorReplicate(+MathHelper::Infinity);
+				sweepMax = XMVectorReplicate(-MathHelper::Infinity);
+				sweepPrims = 0;
+				for(UINT b = 1; b < BinCount; ++b)
+				{
+					sweepMin = XMVectorMin(sweepMin, binMin[b - 1]);
+					sweepMax = XMVectorMax(sweepMax, binMax[b - 1]);
+					sweepPrims += binPrims[b - 1];
+					if(sweepPrims == 0 || rightCost[b] < 0.0f)
+						continue;
+
+					float cost = sweepPrims * HalfArea(sweepMin, sweepMax) + rightCost[b];
+					if(cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+		}
+
+		float area = HalfArea(boxMin, boxMax);
+		float splitCost = area > 0.0f ? 1.0f + PrimitiveCost * bestCost / area : MathHelper::Infinity;
+		if(count <= MaxLeafSize && (bestAxis < 0 || splitCost >= PrimitiveCost * count))
+			return;
+
+		UINT mid = first;
+		if(bestAxis >= 0)
+		{
+			float binMinAxis = (&cMin.x)[bestAxis];
+			float scale = BinCount / (&cExtent.x)[bestAxis];
+			auto split = std::partition(order.begin() + first, order.begin() + first + count, [&](UINT p)
+			{
+				return MathHelper::Min(BinCount - 1, (UINT)(((&Centroids[p].x)[bestAxis] - binMinAxis) * scale)) < bestBin;
+			});
+			mid = (UINT)(split - order.begin());
+		}
+
+		if(mid == first || mid == first + count)
+		{
+			int axis = cExtent.x >= cExtent.y && cExtent.x >= cExtent.z ? 0 : (cExtent.y >= cExtent.z ? 1 : 2);
+			mid = SplitMedian(first, count, axis);
+		}
+
+		UINT left = NodeCount.fetch_add(2);
+		node.LeftFirst = left;
+		node.Count = 0;
+
+		UINT leftCount = mid - first;
+		UINT rightCount = count - leftCount;
+		if(count > ParallelBuildSize)
+		{
+			concurrency::parallel_invoke(
+				[&] { Subdivide(left, first, leftCount, depth + 1); },
+				[&] { Subdivide(left + 1, mid, rightCount, depth + 1); });
+		}
+		else
+		{
+			Subdivide(left, first, leftCount, depth + 1);
+			Subdivide(left + 1, mid, rightCount, depth + 1);
+		}
+	}
+
+	UINT Builder::SplitMedian(UINT first, UINT count, int axis)
+	{
+		std::vector<UINT>& order = *Order;
+		UINT mid = first + count / 2;
+		std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count,
+			[&](UINT a, UINT b) { return (&Centroids[a].x)[axis] < (&Centroids[b].x)[axis]; });
+		return mid;
+	}
+
+	// Reciprocal ray direction.  Zero components become a huge finite value so
+	// the slab test never computes 0 * infinity.
+	XMVECTOR XM_CALLCONV InverseDirection(FXMVECTOR rayDir)
+	{
+		const XMVECTOR tiny = XMVectorReplicate(1e-30f);
+		XMVECTOR d = XMVectorSelect(rayDir, XMVectorOrInt(tiny, XMVectorAndInt(rayDir, XMVectorReplicateInt(0x80000000))),
+			XMVectorLess(XMVectorAbs(rayDir), tiny));
+		return XMVectorReciprocal(d);
+	}
+
+	// True if the ray enters the box no farther than tMax; tEnter is where it enters.
+	bool XM_CALLCONV EntersBox(const BvhNode& node, FXMVECTOR rayOrigin, FXMVECTOR invDir, float tMax, float& tEnter)
+	{
+		XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.Min), rayOrigin), invDir);
+		XMVECTOR t2 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&node.Max), rayOrigin), invDir);
+
+		XMVECTOR tNear = XMVectorMin(t1, t2);
+		XMVECTOR tFar = XMVectorMax(t1, t2);
+		tNear = XMVectorSubtract(tNear, XMVectorScale(XMVectorAbs(tNear), DistanceSlack));
+		tFar = XMVectorAdd(tFar, XMVectorScale(XMVectorAbs(tFar), DistanceSlack));
+
+		XMVECTOR enter = XMVectorMax(XMVectorMax(tNear, XMVectorSplatY(tNear)),
+			XMVectorMax(XMVectorSplatZ(tNear), XMVectorZero()));
+		XMVECTOR exit = XMVectorMin(XMVectorMin(tFar, XMVectorSplatY(tFar)), XMVectorSplatZ(tFar));
+
+		tEnter = XMVectorGetX(enter);
+		return tEnter <= XMVectorGetX(exit) && tEnter <= tMax;
+	}
+
+	// Front to back traversal.  Nodes entered farther than tBest are skipped;
+	// ties are still visited so the leaf test can break them.
+	template<typename LeafTest>
+	void XM_CALLCONV Traverse(const std::vector<BvhNode>& nodes, FXMVECTOR rayOrigin, FXMVECTOR invDir,
+		const float& tBest, LeafTest leafTest)
+	{
+		float tRoot = 0.0f;
+		if(nodes.empty() || !EntersBox(nodes[0], rayOrigin, invDir, tBest, tRoot))
+			return;
+
+		UINT stackNode[TraversalStackSize];
+		float stackEntry[TraversalStackSize];
+		int top = 0;
+
+		UINT nodeIndex = 0;
+		for(;;)
+		{
+			const BvhNode& node = nodes[nodeIndex];
+			if(node.Count > 0)
+			{
+				leafTest(node);
+			}
+			else
+			{
+				UINT nearChild = node.LeftFirst;
+				UINT farChild = nearChild + 1;
+				float tNear = 0.0f, tFar = 0.0f;
+				bool hitNear = EntersBox(nodes[nearChild], rayOrigin, invDir, tBest, tNear);
+				bool hitFar = EntersBox(nodes[farChild], rayOrigin, invDir, tBest, tFar);
+				if(hitFar && (!hitNear || tFar < tNear))
+				{
+					std::swap(nearChild, farChild);
+					std::swap(tNear, tFar);
+					std::swap(hitNear, hitFar);
+				}
+
+				if(hitNear)
+				{
+					if(hitFar)
+					{
+						stackNode[top] = farChild;
+						stackEntry[top] = tFar;
+						++top;
+					}
+					nodeIndex = nearChild;
+					continue;
+				}
+			}
+
+			// Pop the next node that can still beat the nearest hit.
+			for(;;)
+			{
+				if(top == 0)
+					return;
+				--top;
+				if(stackEntry[top] <= tBest)
+					break;
+			}
+			nodeIndex = stackNode[top];
+		}
+	}
+}
+
+void BuildBvh(const std::vector<XMFLOAT3>& primMin, const std::vector<XMFLOAT3>& primMax,
+	UINT maxLeafSize, std::vector<BvhNode>& nodes, std::vector<UINT>& order)
+{
+	const UINT primCount = (UINT)primMin.size();
+
+	nodes.clear();
+	order.resize(primCount);
+	if(primCount == 0)
+		return;
+
+	for(UINT i = 0; i < primCount; ++i)
+		order[i] = i;
+
+	Builder builder;
+	builder.PrimMin = &primMin;
+	builder.PrimMax = &primMax;
+	builder.Order = &order;
+	builder.Nodes = &nodes;
+	builder.MaxLeafSize = MathHelper::Max(1u, maxLeafSize);
+	builder.NodeCount = 1;
+
+	builder.Centroids.resize(primCount);
+	for(UINT i = 0; i < primCount; ++i)
+	{
+		XMStoreFloat3(&builder.Centroids[i], XMVectorScale(
+			XMVectorAdd(XMLoadFloat3(&primMin[i]), XMLoadFloat3(&primMax[i])), 0.5f));
+	}
+
+	// A binary tree over n leaves or fewer has at most 2n - 1 nodes.
+	nodes.resize(2 * primCount - 1);
+	builder.Subdivide(0, 0, primCount, 0);
+	nodes.resize(builder.NodeCount);
+}
+
+void MeshBvh::Build(const void* positions, UINT vertexStride,
+	const std::uint32_t* indices, UINT triangleCount)
+{
+	mTriangleCount = triangleCount;
+
+	auto position = [&](std::uint32_t i) -> const XMFLOAT3&
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(static_cast<const BYTE*>(positions) + (size_t)i*vertexStride);
+	};
+
+	std::vector<XMFLOAT3> triMin(triangleCount);
+	std::vector<XMFLOAT3> triMax(triangleCount);
+	concurrency::parallel_for(0u, triangleCount, [&](UINT i)
+	{
+		XMVECTOR v0 = XMLoadFloat3(&position(indices[i*3 + 0]));
+		XMVECTOR v1 = XMLoadFloat3(&position(indices[i*3 + 1]));
+		XMVECTOR v2 = XMLoadFloat3(&position(indices[i*3 + 2]));
+		XMStoreFloat3(&triMin[i], XMVectorMin(v0, XMVectorMin(v1, v2)));
+		XMStoreFloat3(&triMax[i], XMVectorMax(v0, XMVectorMax(v1, v2)));
+	});
+
+	std::vector<UINT> order;
+	BuildBvh(triMin, triMax, MaxLeafSize, mNodes, order);
+
+	// Give every leaf whole groups of four triangle slots.
+	UINT slotCount = 0;
+	for(auto& node : mNodes)
+	{
+		if(node.Count > 0)
+			slotCount += (node.Count + 3) & ~3u;
+	}
+
+	mTriangles.assign(slotCount, UINT_MAX);
+	mVertices.assign((size_t)slotCount * 3, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	mGroups.assign(slotCount / 4, TriangleGroup());
+	memset(mGroups.data(), 0, mGroups.size() * sizeof(TriangleGroup));
+
+	UINT nextSlot = 0;
+	for(auto& node : mNodes)
+	{
+		if(node.Count == 0)
+			continue;
+
+		UINT firstPrim = node.LeftFirst;
+		node.LeftFirst = nextSlot;
+		for(UINT k = 0; k < node.Count; ++k)
+		{
+			UINT tri = order[firstPrim + k];
+			UINT slot = nextSlot + k;
+			mTriangles[slot] = tri;
+
+			XMFLOAT3 v0 = position(indices[tri*3 + 0]);
+			XMFLOAT3 v1 = position(indices[tri*3 + 1]);
+			XMFLOAT3 v2 = position(indices[tri*3 + 2]);
+			mVertices[slot*3 + 0] = v0;
+			mVertices[slot*3 + 1] = v1;
+			mVertices[slot*3 + 2] = v2;
+
+			// Edges are computed exactly as TriangleTests::Intersects computes them.
+			XMFLOAT3 e1, e2;
+			XMStoreFloat3(&e1, XMVectorSubtract(XMLoadFloat3(&v1), XMLoadFloat3(&v0)));
+			XMStoreFloat3(&e2, XMVectorSubtract(XMLoadFloat3(&v2), XMLoadFloat3(&v0)));
+
+			TriangleGroup& group = mGroups[slot / 4];
+			UINT lane = slot % 4;
+			for(int a = 0; a < 3; ++a)
+			{
+				(&group.V0[a].x)[lane] = (&v0.x)[a];
+				(&group.E1[a].x)[lane] = (&e1.x)[a];
+				(&group.E2[a].x)[lane] = (&e2.x)[a];
+			}
+		}
+		nextSlot += (node.Count + 3) & ~3u;
+	}
+
+	if(mNodes.empty())
+	{
+		mBounds = BoundingBox();
+		return;
+	}
+
+	XMVECTOR boundsMin = XMLoadFloat3(&mNodes[0].Min);
+	XMVECTOR boundsMax = XMLoadFloat3(&mNodes[0].Max);
+	XMStoreFloat3(&mBounds.Center, XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f));
+	XMStoreFloat3(&mBounds.Extents, XMVectorScale(XMVectorSubtract(boundsMax, boundsMin), 0.5f));
+}
+
+void XM_CALLCONV MeshBvh::IntersectLeaf(const BvhNode& leaf, FXMVECTOR rayOrigin, FXMVECTOR rayDir,
+	float& tBest, UINT& slotBest)const
+{
+	const XMVECTOR ox = XMVectorSplatX(rayOrigin), oy = XMVectorSplatY(rayOrigin), oz = XMVectorSplatZ(rayOrigin);
+	const XMVECTOR dx = XMVectorSplatX(rayDir), dy = XMVectorSplatY(rayDir), dz = XMVectorSplatZ(rayDir);
+	const XMVECTOR adx = XMVectorAbs(dx), ady = XMVectorAbs(dy), adz = XMVectorAbs(dz);
+	const XMVECTOR signMask = XMVectorReplicateInt(0x80000000);
+	const XMVECTOR rayEpsilon = XMVectorReplicate(1e-20f);
+
+	const UINT groupCount = (leaf.Count + 3) / 4;
+	for(UINT g = 0; g < groupCount; ++g)
+	{
+		const TriangleGroup& group = mGroups[leaf.LeftFirst / 4 + g];
+		XMVECTOR e1x = XMLoadFloat4(&group.E1[0]), e1y = XMLoadFloat4(&group.E1[1]), e1z = XMLoadFloat4(&group.E1[2]);
+		XMVECTOR e2x = XMLoadFloat4(&group.E2[0]), e2y = XMLoadFloat4(&group.E2[1]), e2z = XMLoadFloat4(&group.E2[2]);
+		XMVECTOR sx = XMVectorSubtract(ox, XMLoadFloat4(&group.V0[0]));
+		XMVECTOR sy = XMVectorSubtract(oy, XMLoadFloat4(&group.V0[1]));
+		XMVECTOR sz = XMVectorSubtract(oz, XMLoadFloat4(&group.V0[2]));
+
+		// Moller-Trumbore without the divide: p = d x e2, q = s x e1.
+		XMVECTOR px = XMVectorSubtract(XMVectorMultiply(dy, e2z), XMVectorMultiply(dz, e2y));
+		XMVECTOR py = XMVectorSubtract(XMVectorMultiply(dz, e2x), XMVectorMultiply(dx, e2z));
+		XMVECTOR pz = XMVectorSubtract(XMVectorMultiply(dx, e2y), XMVectorMultiply(dy, e2x));
+		XMVECTOR qx = XMVectorSubtract(XMVectorMultiply(sy, e1z), XMVectorMultiply(sz, e1y));
+		XMVECTOR qy = XMVectorSubtract(XMVectorMultiply(sz, e1x), XMVectorMultiply(sx, e1z));
+		XMVECTOR qz = XMVectorSubtract(XMVectorMultiply(sx, e1y), XMVectorMultiply(sy, e1x));
+
+		XMVECTOR det = XMVectorAdd(XMVectorAdd(XMVectorMultiply(e1x, px), XMVectorMultiply(e1y, py)), XMVectorMultiply(e1z, pz));
+		XMVECTOR u = XMVectorAdd(XMVectorAdd(XMVectorMultiply(sx, px), XMVectorMultiply(sy, py)), XMVectorMultiply(sz, pz));
+		XMVECTOR v = XMVectorAdd(XMVectorAdd(XMVectorMultiply(dx, qx), XMVectorMultiply(dy, qy)), XMVectorMultiply(dz, qz));
+		XMVECTOR t = XMVectorAdd(XMVectorAdd(XMVectorMultiply(e2x, qx), XMVectorMultiply(e2y, qy)), XMVectorMultiply(e2z, qz));
+
+		// Bounds on how far another evaluation order could move each term.
+		XMVECTOR pax = XMVectorAdd(XMVectorAbs(XMVectorMultiply(dy, e2z)), XMVectorAbs(XMVectorMultiply(dz, e2y)));
+		XMVECTOR pay = XMVectorAdd(XMVectorAbs(XMVectorMultiply(dz, e2x)), XMVectorAbs(XMVectorMultiply(dx, e2z)));
+		XMVECTOR paz = XMVectorAdd(XMVectorAbs(XMVectorMultiply(dx, e2y)), XMVectorAbs(XMVectorMultiply(dy, e2x)));
+		XMVECTOR qax = XMVectorAdd(XMVectorAbs(XMVectorMultiply(sy, e1z)), XMVectorAbs(XMVectorMultiply(sz, e1y)));
+		XMVECTOR qay = XMVectorAdd(XMVectorAbs(XMVectorMultiply(sz, e1x)), XMVectorAbs(XMVectorMultiply(sx, e1z)));
+		XMVECTOR qaz = XMVectorAdd(XMVectorAbs(XMVectorMultiply(sx, e1y)), XMVectorAbs(XMVectorMultiply(sy, e1x)));
+
+		XMVECTOR slackDet = XMVectorScale(XMVectorAdd(XMVectorAdd(XMVectorMultiply(XMVectorAbs(e1x), pax),
+			XMVectorMultiply(XMVectorAbs(e1y), pay)), XMVectorMultiply(XMVectorAbs(e1z), paz)), TriangleSlack);
+		XMVECTOR slackU = XMVectorScale(XMVectorAdd(XMVectorAdd(XMVectorMultiply(XMVectorAbs(sx), pax),
+			XMVectorMultiply(XMVectorAbs(sy), pay)), XMVectorMultiply(XMVectorAbs(sz), paz)), TriangleSlack);
+		XMVECTOR slackV = XMVectorScale(XMVectorAdd(XMVectorAdd(XMVectorMultiply(adx, qax),
+			XMVectorMultiply(ady, qay)), XMVectorMultiply(adz, qaz)), TriangleSlack);
+		XMVECTOR slackT = XMVectorScale(XMVectorAdd(XMVectorAdd(XMVectorMultiply(XMVectorAbs(e2x), qax),
+			XMVectorMultiply(XMVectorAbs(e2y), qay)), XMVectorMultiply(XMVectorAbs(e2z), qaz)), TriangleSlack);
+
+		// Flip signs for back facing triangles so one set of comparisons covers both.
+		XMVECTOR sign = XMVectorAndInt(det, signMask);
+		det = XMVectorXorInt(det, sign);
+		u = XMVectorXorInt(u, sign);
+		v = XMVectorXorInt(v, sign);
+		t = XMVectorXorInt(t, sign);
+
+		XMVECTOR candidate = XMVectorGreaterOrEqual(XMVectorAdd(det, slackDet), rayEpsilon);
+		candidate = XMVectorAndInt(candidate, XMVectorGreaterOrEqual(XMVectorAdd(u, slackU), XMVectorZero()));
+		candidate = XMVectorAndInt(candidate, XMVectorGreaterOrEqual(XMVectorAdd(v, slackV), XMVectorZero()));
+		candidate = XMVectorAndInt(candidate, XMVectorGreaterOrEqual(XMVectorAdd(t, slackT), XMVectorZero()));
+		candidate = XMVectorAndInt(candidate, XMVectorLessOrEqual(XMVectorSubtract(XMVectorAdd(u, v), det),
+			XMVectorAdd(XMVectorAdd(slackU, slackV), slackDet)));
+
+		if(XMVector4EqualInt(candidate, XMVectorFalseInt()))
+			continue;
+
+		XMUINT4 lanes;
+		XMStoreUInt4(&lanes, candidate);
+		const UINT laneCount = MathHelper::Min(4u, leaf.Count - g*4);
+		for(UINT lane = 0; lane < laneCount; ++lane)
+		{
+			if((&lanes.x)[lane] == 0)
+				continue;
+
+			UINT slot = leaf.LeftFirst + g*4 + lane;
+			XMVECTOR v0 = XMLoadFloat3(&mVertices[slot*3 + 0]);
+			XMVECTOR v1 = XMLoadFloat3(&mVertices[slot*3 + 1]);
+			XMVECTOR v2 = XMLoadFloat3(&mVertices[slot*3 + 2]);
+
+			float tHit = 0.0f;
+			if(!TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, tHit))
+				continue;
+
+			// Ties go to the lowest triangle index, like a loop over all triangles.
+			bool nearer = slotBest == UINT_MAX ? tHit <= tBest :
+				(tHit < tBest || (tHit == tBest && mTriangles[slot] < mTriangles[slotBest]));
+			if(nearer)
+			{
+				tBest = tHit;
+				slotBest = slot;
+			}
+		}
+	}
+}
+
+bool MeshBvh::Intersects(FXMVECTOR rayOrigin, FXMVECTOR rayDir, float tMax, RayHit& hit)const
+{
+	float tBest = tMax;
+	UINT slotBest = UINT_MAX;
+
+	XMVECTOR invDir = InverseDirection(rayDir);
+	Traverse(mNodes, rayOrigin, invDir, tBest, [&](const BvhNode& leaf)
+	{
+		IntersectLeaf(leaf, rayOrigin, rayDir, tBest, slotBest);
+	});
+
+	if(slotBest == UINT_MAX)
+		return false;
+
+	// Barycentrics the way TriangleTests::Intersects would derive them.
+	XMVECTOR v0 = XMLoadFloat3(&mVertices[slotBest*3 + 0]);
+	XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&mVertices[slotBest*3 + 1]), v0);
+	XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&mVertices[slotBest*3 + 2]), v0);
+	XMVECTOR s = XMVectorSubtract(rayOrigin, v0);
+	XMVECTOR p = XMVector3Cross(rayDir, e2);
+	XMVECTOR q = XMVector3Cross(s, e1);
+	XMVECTOR det = XMVector3Dot(e1, p);
+
+	hit.T = tBest;
+	hit.Triangle = mTriangles[slotBest];
+	hit.U = XMVectorGetX(XMVectorDivide(XMVector3Dot(s, p), det));
+	hit.V = XMVectorGetX(XMVectorDivide(XMVector3Dot(rayDir, q), det));
+	hit.Instance = 0;
+	return true;
+}
+
+void SceneBvh::Clear()
+{
+	mInstances.clear();
+	mNodes.clear();
+	mOrder.clear();
+}
+
+UINT SceneBvh::AddInstance(const MeshBvh* mesh, const XMFLOAT4X4& world)
+{
+	Instance instance;
+	instance.Mesh = mesh;
+	mInstances.push_back(instance);
+
+	UINT index = (UINT)mInstances.size() - 1;
+	SetWorld(index, world);
+	return index;
+}
+
+void SceneBvh::SetWorld(UINT instance, const XMFLOAT4X4& world)
+{
+	XMMATRIX W = XMLoadFloat4x4(&world);
+	XMVECTOR det = XMMatrixDeterminant(W);
+	mInstances[instance].World = world;
+	XMStoreFloat4x4(&mInstances[instance].InvWorld, XMMatrixInverse(&det, W));
+}
+
+void SceneBvh::Build()
+{
+	std::vector<XMFLOAT3> instanceMin(mInstances.size());
+	std::vector<XMFLOAT3> instanceMax(mInstances.size());
+	for(size_t i = 0; i < mInstances.size(); ++i)
+	{
+		BoundingBox worldBounds;
+		mInstances[i].Mesh->Bounds().Transform(worldBounds, XMLoadFloat4x4(&mInstances[i].World));
+
+		XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+		XMVECTOR extents = XMLoadFloat3(&worldBounds.Extents);
+		XMStoreFloat3(&instanceMin[i], XMVectorSubtract(center, extents));
+		XMStoreFloat3(&instanceMax[i], XMVectorAdd(center, extents));
+	}
+
+	BuildBvh(instanceMin, instanceMax, 2, mNodes, mOrder);
+}
+
+void XM_CALLCONV SceneBvh::TransformRay(UINT instance, FXMVECTOR rayOrigin, FXMVECTOR rayDir,
+	XMVECTOR& localOrigin, XMVECTOR& localDir, float& distanceScale)const
+{
+	XMMATRIX invWorld = XMLoadFloat4x4(&mInstances[instance].InvWorld);
+
+	localOrigin = XMVector3TransformCoord(rayOrigin, invWorld);
+	localDir = XMVector3TransformNormal(rayDir, invWorld);
+
+	// Local distances are along the normalized local direction.
+	distanceScale = XMVectorGetX(XMVector3Length(localDir));
+	localDir = XMVector3Normalize(localDir);
+}
+
+bool SceneBvh::Intersects(FXMVECTOR rayOrigin, FXMVECTOR rayDir, RayHit& hit)const
+{
+	float tBest = MathHelper::Infinity;
+	bool found = false;
+
+	XMVECTOR invDir = InverseDirection(rayDir);
+	Traverse(mNodes, rayOrigin, invDir, tBest, [&](const BvhNode& leaf)
+	{
+		for(UINT k = 0; k < leaf.Count; ++k)
+		{
+			UINT instance = mOrder[leaf.LeftFirst + k];
+
+			XMVECTOR localOrigin, localDir;
+			float distanceScale = 1.0f;
+			TransformRay(instance, rayOrigin, rayDir, localOrigin, localDir, distanceScale);
+
+			// The local limit is widened a little so rounding in the conversion
+			// cannot hide a hit that ties the current one in world units.
+			float tMax = found ? tBest * distanceScale * (1.0f + DistanceSlack) : MathHelper::Infinity;
+
+			RayHit local;
+			if(!mInstances[instance].Mesh->Intersects(localOrigin, localDir, tMax, local))
+				continue;
+
+			float t = local.T / distanceScale;
+			if(!found || t < tBest || (t == tBest && instance < hit.Instance))
+			{
+				hit = local;
+				hit.T = t;
+				hit.Instance = instance;
+				tBest = t;
+				found = true;
+			}
+		}
+	});
+
+	return found;
+}
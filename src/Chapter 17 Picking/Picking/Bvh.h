@@ -0,0 +1,126 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "../../Common/MathHelper.h"
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+///<summary>
+/// Bounding volume hierarchies for ray picking.
+///
+/// MeshBvh is built once per mesh with a binned surface area heuristic; large
+/// subtrees are built in parallel.  Nodes are stored in one flat array and
+/// the triangles of each leaf are stored in groups of four, structure-of-arrays,
+/// so a ray is tested against four triangles at a time.  The vector test only
+/// rejects triangles that clearly miss; the rest are confirmed with
+/// TriangleTests::Intersects, so a hit has exactly the distance the brute
+/// force loop over every triangle would report, and ties go to the lowest
+/// triangle index as they do in that loop.
+///
+/// SceneBvh is the top level: a hierarchy over instances, each a MeshBvh with
+/// its own world matrix.  World rays are moved into each instance's local
+/// space and distances are reported in world units.
+///</summary>
+
+struct BvhNode
+{
+    DirectX::XMFLOAT3 Min;
+    UINT LeftFirst = 0;     // Interior: left child, the right child follows it.  Leaf: first primitive.
+    DirectX::XMFLOAT3 Max;
+    UINT Count = 0;         // Primitives in a leaf, 0 for an interior node.
+};
+
+// Builds a binned SAH hierarchy over primitive bounds.  order receives the
+// primitive indices in the order the leaves reference them.
+void BuildBvh(const std::vector<DirectX::XMFLOAT3>& primMin, const std::vector<DirectX::XMFLOAT3>& primMax,
+    UINT maxLeafSize, std::vector<BvhNode>& nodes, std::vector<UINT>& order);
+
+struct RayHit
+{
+    float T = MathHelper::Infinity; // Distance along the ray.
+    UINT Triangle = 0;              // Triangle index in the mesh's index list.
+    float U = 0.0f;                 // Barycentric weights of the triangle's second
+    float V = 0.0f;                 // and third vertex.
+    UINT Instance = 0;              // SceneBvh only.
+};
+
+class MeshBvh
+{
+public:
+    // positions points at the first vertex position, vertexStride bytes apart.
+    void Build(const void* positions, UINT vertexStride,
+        const std::uint32_t* indices, UINT triangleCount);
+
+    // Finds the nearest triangle hit no farther than tMax.  rayDir must be unit length.
+    bool Intersects(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir, float tMax, RayHit& hit)const;
+
+    const DirectX::BoundingBox& Bounds()const { return mBounds; }
+    UINT TriangleCount()const { return mTriangleCount; }
+    UINT NodeCount()const { return (UINT)mNodes.size(); }
+
+private:
+    // Four triangles, one per lane: first vertex and the two edges leaving it.
+    struct TriangleGroup
+    {
+        DirectX::XMFLOAT4 V0[3];
+        DirectX::XMFLOAT4 E1[3];
+        DirectX::XMFLOAT4 E2[3];
+    };
+
+    void XM_CALLCONV IntersectLeaf(const BvhNode& leaf, DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir,
+        float& tBest, UINT& slotBest)const;
+
+private:
+    static const UINT MaxLeafSize = 8;
+
+    std::vector<BvhNode> mNodes;
+    std::vector<TriangleGroup> mGroups;
+
+    // Per triangle slot: source triangle index (UINT_MAX for padding) and its
+    // three vertices as given, for the exact test.
+    std::vector<UINT> mTriangles;
+    std::vector<DirectX::XMFLOAT3> mVertices;
+
+    DirectX::BoundingBox mBounds;
+    UINT mTriangleCount = 0;
+};
+
+class SceneBvh
+{
+public:
+    void Clear();
+
+    // Returns the instance index reported in RayHit::Instance.
+    UINT AddInstance(const MeshBvh* mesh, const DirectX::XMFLOAT4X4& world);
+    void SetWorld(UINT instance, const DirectX::XMFLOAT4X4& world);
+
+    // Call after adding instances or changing their world matrices.
+    void Build();
+
+    // Finds the nearest hit over all instances.  rayDir must be unit length;
+    // hit.T is the world space distance.
+    bool Intersects(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir, RayHit& hit)const;
+
+    // Moves a world ray into an instance's local space.  A local distance
+    // divided by distanceScale is the world distance.
+    void XM_CALLCONV TransformRay(UINT instance, DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir,
+        DirectX::XMVECTOR& localOrigin, DirectX::XMVECTOR& localDir, float& distanceScale)const;
+
+    UINT InstanceCount()const { return (UINT)mInstances.size(); }
+    const MeshBvh* GetMesh(UINT instance)const { return mInstances[instance].Mesh; }
+
+private:
+    struct Instance
+    {
+        const MeshBvh* Mesh = nullptr;
+        DirectX::XMFLOAT4X4 World;
+        DirectX::XMFLOAT4X4 InvWorld;
+    };
+
+    std::vector<Instance> mInstances;
+    std::vector<BvhNode> mNodes;
+    std::vector<UINT> mOrder;
+};
+
+#endif // BVH_H
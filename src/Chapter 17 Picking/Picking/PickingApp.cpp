@@ -7,7 +7,9 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/ModelLoader.h"
 #include "FrameResource.h"
+#include "Bvh.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -28,6 +30,9 @@ struct RenderItem
 	bool Visible = true;
 
 	BoundingBox Bounds;
+
+	// Triangle hierarchy used for picking, or null if the item cannot be picked.
+	const MeshBvh* PickBvh = nullptr;
  
     // World matrix of the shape that describes the object's local space
     // relative to the world space, which defines the position, orientation,
@@ -99,6 +104,7 @@ private:
     void BuildMaterials();
     void BuildRenderItems();
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void BuildPickingBvh();
 	void Pick(int sx, int sy);
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
@@ -131,6 +137,11 @@ private:
 
 	RenderItem* mPickedRitem = nullptr;
 
+	// Per mesh triangle hierarchies, and one instance per pickable render item on top.
+	std::unordered_map<std::string, std::unique_ptr<MeshBvh>> mMeshBvhs;
+	SceneBvh mPickingBvh;
+	std::vector<RenderItem*> mPickableRitems;
+
     PassConstants mMainPassCB;
 
 	Camera mCamera;
@@ -196,6 +207,7 @@ bool PickingApp::Initialize()
     BuildCarGeometry();
 	BuildMaterials();
     BuildRenderItems();
+	BuildPickingBvh();
     BuildFrameResources();
     BuildPSOs();
 
@@ -563,57 +575,27 @@ void PickingApp::BuildShadersAndInputLayout()
 
 void PickingApp::BuildCarGeometry()
 {
-	std::ifstream fin("Models/car.txt");
-
-	if(!fin)
+	ModelData model;
+	if(!ModelLoader::Load("Models/car.txt", model))
 	{
 		MessageBox(0, L"Models/car.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
-
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-	std::vector<Vertex> vertices(vcount);
-	for(UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(model.Positions.size());
+	for(size_t i = 0; i < vertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-
-		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
+		vertices[i].Pos = model.Positions[i];
+		vertices[i].Normal = model.Normals[i];
 
 		vertices[i].TexC = { 0.0f, 0.0f };
-
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
 	}
 
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
+	const std::vector<std::int32_t>& indices = model.Indices;
 
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for(UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-
-	fin.close();
+	auto carBvh = std::make_unique<MeshBvh>();
+	carBvh->Build(&vertices[0].Pos, sizeof(Vertex), reinterpret_cast<const std::uint32_t*>(indices.data()), (UINT)indices.size() / 3);
+	mMeshBvhs["car"] = std::move(carBvh);
 
 	//
 	// Pack the indices of all the meshes into one index buffer.
@@ -647,7 +629,7 @@ void PickingApp::BuildCarGeometry()
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
-	submesh.Bounds = bounds;
+	submesh.Bounds = model.Bounds;
 
 	geo->DrawArgs["car"] = submesh;
 
@@ -757,6 +739,7 @@ void PickingApp::BuildRenderItems()
 	carRitem->Geo = mGeometries["carGeo"].get();
 	carRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	carRitem->Bounds = carRitem->Geo->DrawArgs["car"].Bounds;
+	carRitem->PickBvh = mMeshBvhs["car"].get();
 	carRitem->IndexCount = carRitem->Geo->DrawArgs["car"].IndexCount;
 	carRitem->StartIndexLocation = carRitem->Geo->DrawArgs["car"].StartIndexLocation;
 	carRitem->BaseVertexLocation = carRitem->Geo->DrawArgs["car"].BaseVertexLocation;
@@ -868,6 +851,23 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> PickingApp::GetStaticSamplers()
 		anisotropicWrap, anisotropicClamp };
 }
 
+void PickingApp::BuildPickingBvh()
+{
+	// Every visible opaque item with a triangle hierarchy can be picked.  Call this
+	// again after moving, showing or hiding one.
+	mPickingBvh.Clear();
+	mPickableRitems.clear();
+	for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+	{
+		if(ri->Visible == false || ri->PickBvh == nullptr)
+			continue;
+
+		mPickingBvh.AddInstance(ri->PickBvh, ri->World);
+		mPickableRitems.push_back(ri);
+	}
+	mPickingBvh.Build();
+}
+
 void PickingApp::Pick(int sx, int sy)
 {
 	XMFLOAT4X4 P = mCamera.GetProj4x4f();
@@ -879,86 +879,33 @@ void PickingApp::Pick(int sx, int sy)
 	// Ray definition in view space.
 	XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
 	XMVECTOR rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
-	
+
+	// Transform the ray to world space once.  The picking hierarchy moves it into
+	// the local space of each render item it reaches.
 	XMMATRIX V = mCamera.GetView();
 	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
 
+	rayOrigin = XMVector3TransformCoord(rayOrigin, invView);
+	rayDir = XMVector3Normalize(XMVector3TransformNormal(rayDir, invView));
+
 	// Assume nothing is picked to start, so the picked render-item is invisible.
 	mPickedRitem->Visible = false;
 
-	// Check if we picked an opaque render item.  A real app might keep a separate "picking list"
-	// of objects that can be selected.   
-	for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+	RayHit hit;
+	if(mPickingBvh.Intersects(rayOrigin, rayDir, hit))
 	{
-		auto geo = ri->Geo;
+		RenderItem* ri = mPickableRitems[hit.Instance];
 
-		// Skip invisible render-items.
-		if(ri->Visible == false)
-			continue;
-
-		XMMATRIX W = XMLoadFloat4x4(&ri->World);
-		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
-
-		// Tranform ray to vi space of Mesh.
-		XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+		mPickedRitem->Visible = true;
+		mPickedRitem->Geo = ri->Geo;
+		mPickedRitem->IndexCount = 3;
+		mPickedRitem->BaseVertexLocation = ri->BaseVertexLocation;
 
-		rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-		rayDir = XMVector3TransformNormal(rayDir, toLocal);
+		// Picked render item needs same world matrix as object picked.
+		mPickedRitem->World = ri->World;
+		mPickedRitem->NumFramesDirty = gNumFrameResources;
 
-		// Make the ray direction unit length for the intersection tests.
-		rayDir = XMVector3Normalize(rayDir);
-
-		// If we hit the bounding box of the Mesh, then we might have picked a Mesh triangle,
-		// so do the ray/triangle tests.
-		//
-		// If we did not hit the bounding box, then it is impossible that we hit 
-		// the Mesh, so do not waste effort doing ray/triangle tests.
-		float tmin = 0.0f;
-		if(ri->Bounds.Intersects(rayOrigin, rayDir, tmin))
-		{
-			// NOTE: For the demo, we know what to cast the vertex/index data to.  If we were mixing
-			// formats, some metadata would be needed to figure out what to cast it to.
-			auto vertices = (Vertex*)geo->VertexBufferCPU->GetBufferPointer();
-			auto indices = (std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer();
-			UINT triCount = ri->IndexCount / 3;
-
-			// Find the nearest ray/triangle intersection.
-			tmin = MathHelper::Infinity;
-			for(UINT i = 0; i < triCount; ++i)
-			{
-				// Indices for this triangle.
-				UINT i0 = indices[i * 3 + 0];
-				UINT i1 = indices[i * 3 + 1];
-				UINT i2 = indices[i * 3 + 2];
-
-				// Vertices for this triangle.
-				XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-				XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-				XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-				// We have to iterate over all the triangles in order to find the nearest intersection.
-				float t = 0.0f;
-				if(TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
-				{
-					if(t < tmin)
-					{
-						// This is the new nearest picked triangle.
-						tmin = t;
-						UINT pickedTriangle = i;
-
-						mPickedRitem->Visible = true;
-						mPickedRitem->IndexCount = 3;
-						mPickedRitem->BaseVertexLocation = 0;
-
-						// Picked render item needs same world matrix as object picked.
-						mPickedRitem->World = ri->World;
-						mPickedRitem->NumFramesDirty = gNumFrameResources;
-
-						// Offset to the picked triangle in the mesh index buffer.
-						mPickedRitem->StartIndexLocation = 3 * pickedTriangle;
-					}
-				}
-			}
-		}
+		// Offset to the picked triangle in the mesh index buffer.
+		mPickedRitem->StartIndexLocation = ri->StartIndexLocation + 3 * hit.Triangle;
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,121 @@
+//***************************************************************************************
+// CubeFaceCuller.cpp
+//***************************************************************************************
+
+#include "CubeFaceCuller.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// The planes are x - y, x + y, x - z, x + z, y - z and y + z = 0 with unit
+	// normals, so a sphere reaches a plane's positive side when the unnormalized
+	// distance is at least -sqrt(2) r.
+	const float Sqrt2 = 1.41421356f;
+
+	// Distances below this are taken as this when motion is measured, so an object
+	// passing through the probe doesn't report an unbounded angle.
+	const float MinMotionDistance = 0.01f;
+}
+
+void CubeFaceCuller::SetProbe(const XMFLOAT3& center, float farZ)
+{
+	mCenter = center;
+	mFarZ = farZ;
+	mLastSpheres.clear();
+	mLastMasks.clear();
+}
+
+uint8_t CubeFaceCuller::FaceMask(const XMFLOAT3& center, float farZ, const BoundingSphere& sphere)
+{
+	float x = sphere.Center.x - center.x;
+	float y = sphere.Center.y - center.y;
+	float z = sphere.Center.z - center.z;
+	float r = sphere.Radius;
+
+	if(x*x + y*y + z*z > (farZ + r)*(farZ + r))
+		return 0;
+
+	float reach = Sqrt2*r;
+	float d[6] = { x - y, x + y, x - z, x + z, y - z, y + z };
+
+	// Bit i of pos is the sphere reaching the positive side of plane i, and of
+	// neg the negative side.
+	uint32_t pos = 0;
+	uint32_t neg = 0;
+	for(int i = 0; i < 6; ++i)
+	{
+		pos |= (d[i] >= -reach ? 1u : 0u) << i;
+		neg |= (d[i] <= reach ? 1u : 0u) << i;
+	}
+
+	// Each face is the set of points that are farther along its axis than along
+	// either other axis: four of the planes.
+	auto all = [](uint32_t posBits, uint32_t posNeeded, uint32_t negBits, uint32_t negNeeded)
+	{
+		return (posBits & posNeeded) == posNeeded && (negBits & negNeeded) == negNeeded;
+	};
+
+	uint8_t mask = 0;
+	mask |= all(pos, 0x0f, neg, 0x00) ? 0x01 : 0; // +X: x >= |y|, x >= |z|
+	mask |= all(pos, 0x00, neg, 0x0f) ? 0x02 : 0; // -X
+	mask |= all(pos, 0x32, neg, 0x01) ? 0x04 : 0; // +Y: y >= |x|, y >= |z|
+	mask |= all(pos, 0x01, neg, 0x32) ? 0x08 : 0; // -Y
+	mask |= all(pos, 0x28, neg, 0x14) ? 0x10 : 0; // +Z: z >= |x|, z >= |y|
+	mask |= all(pos, 0x14, neg, 0x28) ? 0x20 : 0; // -Z
+
+	return mask;
+}
+
+void CubeFaceCuller::Cull(const BoundingSphere* spheres, uint32_t count)
+{
+	mMasks.resize(count);
+	for(int face = 0; face < FaceCount; ++face)
+	{
+		mVisible[face].clear();
+		mFaceMotion[face] = 0.0f;
+	}
+
+	bool hasHistory = mLastSpheres.size() == count;
+
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		const BoundingSphere& sphere = spheres[i];
+		uint8_t mask = FaceMask(mCenter, mFarZ, sphere);
+		mMasks[i] = mask;
+
+		for(int face = 0; face < FaceCount; ++face)
+		{
+			if(mask & (1 << face))
+				mVisible[face].push_back(i);
+		}
+
+		if(!hasHistory)
+			continue;
+
+		const BoundingSphere& last = mLastSpheres[i];
+		float dx = sphere.Center.x - last.Center.x;
+		float dy = sphere.Center.y - last.Center.y;
+		float dz = sphere.Center.z - last.Center.z;
+		float moved = sqrtf(dx*dx + dy*dy + dz*dz) + fabsf(sphere.Radius - last.Radius);
+		if(moved == 0.0f)
+			continue;
+
+		float cx = sphere.Center.x - mCenter.x;
+		float cy = sphere.Center.y - mCenter.y;
+		float cz = sphere.Center.z - mCenter.z;
+		float distance = (std::max)(sqrtf(cx*cx + cy*cy + cz*cz), MinMotionDistance);
+
+		uint8_t seen = mask | mLastMasks[i];
+		for(int face = 0; face < FaceCount; ++face)
+		{
+			if(seen & (1 << face))
+				mFaceMotion[face] += moved / distance;
+		}
+	}
+
+	mLastSpheres.assign(spheres, spheres + count);
+	mLastMasks = mMasks;
+}
@@ -0,0 +1,59 @@
+//***************************************************************************************
+// CubeFaceCuller.h
+//
+// Culls a scene against the six faces of a cube map in one pass over the objects.
+//
+// The six 90 degree frusta about a probe share their side planes: every side plane is
+// one of x = +-y, x = +-z or y = +-z in probe space.  A bounding sphere is measured
+// against those six planes once, and each face's visibility is four of the twelve
+// comparisons, so an object gets a 6-bit mask (bit i for face i, in CubeMapFace
+// order) and goes into the visible list of every face whose bit is set.  Spheres
+// that reach past the far plane on no face are out of every face.  Like any sphere
+// against planes test it is conservative near the frustum corners.
+//
+// The culler also keeps last frame's spheres and masks and measures how far each
+// object moved as seen from the probe: the displacement of its center over its
+// distance, an angle in radians.  The motion is added to every face that saw the
+// object on either frame, which is what CubeMapScheduler ranks faces by.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class CubeFaceCuller
+{
+public:
+	static const int FaceCount = 6;
+
+	// Puts the probe at center and drops the history, so the next Cull reports no
+	// motion.  A probe that moved needs every face redrawn anyway; see
+	// CubeMapScheduler::Invalidate.
+	void SetProbe(const DirectX::XMFLOAT3& center, float farZ);
+
+	// Culls count world space spheres.  The spheres must be in the same order from
+	// one call to the next for the motion to mean anything.
+	void Cull(const DirectX::BoundingSphere* spheres, uint32_t count);
+
+	uint8_t Mask(uint32_t object)const { return mMasks[object]; }
+	const std::vector<uint32_t>& Visible(int face)const { return mVisible[face]; }
+
+	// Motion seen on a face during the last Cull; see above.
+	float FaceMotion(int face)const { return mFaceMotion[face]; }
+
+	// The mask of one sphere, without the bookkeeping.
+	static uint8_t FaceMask(const DirectX::XMFLOAT3& center, float farZ, const DirectX::BoundingSphere& sphere);
+
+private:
+	DirectX::XMFLOAT3 mCenter = { 0.0f, 0.0f, 0.0f };
+	float mFarZ = 1000.0f;
+
+	std::vector<uint8_t> mMasks;
+	std::vector<uint32_t> mVisible[FaceCount];
+	float mFaceMotion[FaceCount] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+	std::vector<DirectX::BoundingSphere> mLastSpheres;
+	std::vector<uint8_t> mLastMasks;
+};
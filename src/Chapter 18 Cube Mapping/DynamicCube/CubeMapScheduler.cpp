@@ -0,0 +1,64 @@
+//***************************************************************************************
+// CubeMapScheduler.cpp
+//***************************************************************************************
+
+#include "CubeMapScheduler.h"
+#include <algorithm>
+
+CubeMapScheduler::CubeMapScheduler(uint32_t probeCount, const Desc& desc) :
+	mDesc(desc), mFaces(probeCount*FaceCount), mScheduled(probeCount, 0)
+{
+}
+
+void CubeMapScheduler::Invalidate(uint32_t probe)
+{
+	for(int face = 0; face < FaceCount; ++face)
+		mFaces[probe*FaceCount + face].Invalid = true;
+}
+
+void CubeMapScheduler::AddMotion(uint32_t probe, int face, float motion)
+{
+	mFaces[probe*FaceCount + face].Motion += motion;
+}
+
+const std::vector<uint8_t>& CubeMapScheduler::Schedule()
+{
+	const uint32_t faceCount = (uint32_t)mFaces.size();
+
+	std::fill(mScheduled.begin(), mScheduled.end(), (uint8_t)0);
+	mCandidates.clear();
+
+	auto redraw = [&](uint32_t i)
+	{
+		mScheduled[i / FaceCount] |= (uint8_t)(1 << (i % FaceCount));
+		mFaces[i].Age = 0;
+		mFaces[i].Motion = 0.0f;
+		mFaces[i].Invalid = false;
+		mCursor = (i + 1) % faceCount;
+	};
+
+	// Candidates in round-robin order from the cursor, so that a stable sort keeps
+	// ties in that order.
+	uint32_t start = mCursor;
+	for(uint32_t k = 0; k < faceCount; ++k)
+	{
+		uint32_t i = (start + k) % faceCount;
+		Face& face = mFaces[i];
+		++face.Age;
+
+		if(face.Invalid)
+			redraw(i);
+		else if(face.Motion > 0.0f || face.Age >= mDesc.RefreshFrames)
+			mCandidates.push_back(i);
+	}
+
+	auto priority = [&](uint32_t i) { return mFaces[i].Age + mDesc.MotionWeight*mFaces[i].Motion; };
+	std::stable_sort(mCandidates.begin(), mCandidates.end(),
+		[&](uint32_t a, uint32_t b) { return priority(a) > priority(b); });
+
+	uint32_t count = (std::min)((uint32_t)mCandidates.size(), mDesc.FaceBudget);
+	for(uint32_t k = 0; k < count; ++k)
+		redraw(mCandidates[k]);
+
+	return mScheduled;
+}
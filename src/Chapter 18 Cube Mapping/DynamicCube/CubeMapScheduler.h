@@ -0,0 +1,65 @@
+//***************************************************************************************
+// CubeMapScheduler.h
+//
+// Spreads the redrawing of dynamic cube maps over frames.  Each frame at most
+// FaceBudget faces, over all probes, are redrawn; the rest keep last frame's image.
+//
+// A face becomes a candidate when something moved in it (CubeFaceCuller::FaceMotion)
+// or when it has gone RefreshFrames frames without a redraw, which catches changes
+// the culler can't see, such as lights and materials.  Candidates are ranked by
+// their age in frames plus MotionWeight times the motion they have gathered since
+// their last redraw, so moving faces go first and no face waits forever.  Ties go
+// round-robin, starting after the last face redrawn.  Invalidated faces (every face
+// at first, and every face of a probe that moved) are redrawn at the next Schedule
+// whatever the budget.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class CubeMapScheduler
+{
+public:
+	static const int FaceCount = 6;
+
+	struct Desc
+	{
+		uint32_t FaceBudget = 2;
+		uint32_t RefreshFrames = 60;
+
+		// Frames of age one radian of motion is worth.
+		float MotionWeight = 100.0f;
+	};
+
+	CubeMapScheduler(uint32_t probeCount, const Desc& desc);
+
+	const Desc& GetDesc()const { return mDesc; }
+
+	void Invalidate(uint32_t probe);
+	void AddMotion(uint32_t probe, int face, float motion);
+
+	// Picks this frame's faces: bit i of entry p is face i of probe p.  Call once a
+	// frame.
+	const std::vector<uint8_t>& Schedule();
+
+	// Frames since the face was last redrawn.
+	uint32_t Age(uint32_t probe, int face)const { return mFaces[probe*FaceCount + face].Age; }
+
+private:
+	struct Face
+	{
+		uint32_t Age = 0;
+		float Motion = 0.0f;
+		bool Invalid = true;
+	};
+
+	Desc mDesc;
+	std::vector<Face> mFaces;
+	std::vector<uint8_t> mScheduled;
+	std::vector<uint32_t> mCandidates;
+
+	// The face after the last one redrawn, where ties start.
+	uint32_t mCursor = 0;
+};
@@ -7,8 +7,11 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/ModelLoader.h"
 #include "FrameResource.h"
 #include "CubeRenderTarget.h"
+#include "CubeFaceCuller.h"
+#include "CubeMapScheduler.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -54,6 +57,9 @@ struct RenderItem
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+	// Bounds of the submesh in local space, for culling the cube map faces.
+	BoundingBox Bounds;
 };
 
 enum class RenderLayer : int
@@ -90,6 +96,8 @@ private:
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateCubeMapFacePassCBs();
+	void AnimateSkull(float totalTime);
+	void CullCubeMapFaces();
 
 	void LoadTextures();
     void BuildRootSignature();
@@ -147,6 +155,14 @@ private:
 	Camera mCamera;
 	Camera mCubeMapCamera[6];
 
+	// The opaque items each face sees, and the faces redrawn this frame.  Faces
+	// not redrawn keep their image from an earlier frame.
+	CubeFaceCuller mCubeFaceCuller;
+	std::unique_ptr<CubeMapScheduler> mCubeMapScheduler;
+	std::vector<BoundingSphere> mCubeMapSpheres;
+	std::vector<RenderItem*> mCubeFaceRitems[6];
+	uint8_t mCubeFacesToDraw = 0;
+
     POINT mLastMousePos;
 };
 
@@ -199,6 +215,9 @@ bool DynamicCubeMapApp::Initialize()
 	mDynamicCubeMap = std::make_unique<CubeRenderTarget>(md3dDevice.Get(), 
 		CubeMapSize, CubeMapSize, DXGI_FORMAT_R8G8B8A8_UNORM);
 
+	mCubeFaceCuller.SetProbe(mCubeMapCamera[0].GetPosition3f(), 1000.0f);
+	mCubeMapScheduler = std::make_unique<CubeMapScheduler>(1, CubeMapScheduler::Desc());
+
 	LoadTextures();
     BuildRootSignature();
 	BuildDescriptorHeaps();
@@ -259,16 +278,8 @@ void DynamicCubeMapApp::Update(const GameTimer& gt)
 {
     OnKeyboardInput(gt);
 
-	//
-	// Animate the skull around the center sphere.
-	//
-
-	XMMATRIX skullScale = XMMatrixScaling(0.2f, 0.2f, 0.2f);
-	XMMATRIX skullOffset = XMMatrixTranslation(3.0f, 2.0f, 0.0f);
-	XMMATRIX skullLocalRotate = XMMatrixRotationY(2.0f*gt.TotalTime());
-	XMMATRIX skullGlobalRotate = XMMatrixRotationY(0.5f*gt.TotalTime());
-	XMStoreFloat4x4(&mSkullRitem->World, skullScale*skullLocalRotate*skullOffset*skullGlobalRotate);
-	mSkullRitem->NumFramesDirty = gNumFrameResources;
+	AnimateSkull(gt.TotalTime());
+	CullCubeMapFaces();
 
     // Cycle through the circular frame resource array.
     mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -432,6 +443,48 @@ void DynamicCubeMapApp::OnKeyboardInput(const GameTimer& gt)
 
 	mCamera.UpdateViewMatrix();
 }
+
+void DynamicCubeMapApp::AnimateSkull(float totalTime)
+{
+	//
+	// Animate the skull around the center sphere.
+	//
+
+	XMMATRIX skullScale = XMMatrixScaling(0.2f, 0.2f, 0.2f);
+	XMMATRIX skullOffset = XMMatrixTranslation(3.0f, 2.0f, 0.0f);
+	XMMATRIX skullLocalRotate = XMMatrixRotationY(2.0f*totalTime);
+	XMMATRIX skullGlobalRotate = XMMatrixRotationY(0.5f*totalTime);
+	XMStoreFloat4x4(&mSkullRitem->World, skullScale*skullLocalRotate*skullOffset*skullGlobalRotate);
+	mSkullRitem->NumFramesDirty = gNumFrameResources;
+}
+
+void DynamicCubeMapApp::CullCubeMapFaces()
+{
+	// One pass over the opaque items sorts them into the six faces and measures
+	// how much each face changed; the scheduler then picks the faces to redraw.
+	const std::vector<RenderItem*>& opaque = mRitemLayer[(int)RenderLayer::Opaque];
+
+	mCubeMapSpheres.resize(opaque.size());
+	for(size_t i = 0; i < opaque.size(); ++i)
+	{
+		BoundingBox worldBounds;
+		opaque[i]->Bounds.Transform(worldBounds, XMLoadFloat4x4(&opaque[i]->World));
+		BoundingSphere::CreateFromBoundingBox(mCubeMapSpheres[i], worldBounds);
+	}
+
+	mCubeFaceCuller.Cull(mCubeMapSpheres.data(), (uint32_t)mCubeMapSpheres.size());
+
+	for(int face = 0; face < 6; ++face)
+	{
+		mCubeMapScheduler->AddMotion(0, face, mCubeFaceCuller.FaceMotion(face));
+
+		mCubeFaceRitems[face].clear();
+		for(uint32_t i : mCubeFaceCuller.Visible(face))
+			mCubeFaceRitems[face].push_back(opaque[i]);
+	}
+
+	mCubeFacesToDraw = mCubeMapScheduler->Schedule()[0];
+}
  
 void DynamicCubeMapApp::AnimateMaterials(const GameTimer& gt)
 {
@@ -769,57 +822,23 @@ void DynamicCubeMapApp::BuildShadersAndInputLayout()
 
 void DynamicCubeMapApp::BuildSkullGeometry()
 {
-	std::ifstream fin("Models/skull.txt");
-
-	if(!fin)
+	ModelData model;
+	if(!ModelLoader::Load("Models/skull.txt", model))
 	{
 		MessageBox(0, L"Models/skull.txt not found.", 0, 0);
 		return;
 	}
 
-	UINT vcount = 0;
-	UINT tcount = 0;
-	std::string ignore;
-
-	fin >> ignore >> vcount;
-	fin >> ignore >> tcount;
-	fin >> ignore >> ignore >> ignore >> ignore;
-
-	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-	std::vector<Vertex> vertices(vcount);
-	for(UINT i = 0; i < vcount; ++i)
+	std::vector<Vertex> vertices(model.Positions.size());
+	for(size_t i = 0; i < vertices.size(); ++i)
 	{
-		fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-		fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+		vertices[i].Pos = model.Positions[i];
+		vertices[i].Normal = model.Normals[i];
 
 		vertices[i].TexC = { 0.0f, 0.0f };
-
-		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-		vMin = XMVectorMin(vMin, P);
-		vMax = XMVectorMax(vMax, P);
 	}
 
-	BoundingBox bounds;
-	XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
-	XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
-
-	fin >> ignore;
-	fin >> ignore;
-	fin >> ignore;
-
-	std::vector<std::int32_t> indices(3 * tcount);
-	for(UINT i = 0; i < tcount; ++i)
-	{
-		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-	}
-
-	fin.close();
+	const std::vector<std::int32_t>& indices = model.Indices;
 
 	//
 	// Pack the indices of all the meshes into one index buffer.
@@ -853,7 +872,7 @@ void DynamicCubeMapApp::BuildSkullGeometry()
 	submesh.IndexCount = (UINT)indices.size();
 	submesh.StartIndexLocation = 0;
 	submesh.BaseVertexLocation = 0;
-	submesh.Bounds = bounds;
+	submesh.Bounds = model.Bounds;
 
 	geo->DrawArgs["skull"] = submesh;
 
@@ -905,6 +924,19 @@ void DynamicCubeMapApp::BuildShapeGeometry()
 	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
 	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
 
+	auto meshBounds = [](const GeometryGenerator::MeshData& mesh)
+	{
+		BoundingBox bounds;
+		BoundingBox::CreateFromPoints(bounds, mesh.Vertices.size(),
+			&mesh.Vertices[0].Position, sizeof(GeometryGenerator::Vertex));
+		return bounds;
+	};
+
+	boxSubmesh.Bounds = meshBounds(box);
+	gridSubmesh.Bounds = meshBounds(grid);
+	sphereSubmesh.Bounds = meshBounds(sphere);
+	cylinderSubmesh.Bounds = meshBounds(cylinder);
+
 	//
 	// Extract the vertex elements we are interested in and pack the
 	// vertices of all the meshes into one vertex buffer.
@@ -1113,6 +1145,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 	skyRitem->IndexCount = skyRitem->Geo->DrawArgs["sphere"].IndexCount;
 	skyRitem->StartIndexLocation = skyRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	skyRitem->BaseVertexLocation = skyRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	skyRitem->Bounds = skyRitem->Geo->DrawArgs["sphere"].Bounds;
 
 	mRitemLayer[(int)RenderLayer::Sky].push_back(skyRitem.get());
 	mAllRitems.push_back(std::move(skyRitem));
@@ -1127,6 +1160,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 	skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
 	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
 	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+	skullRitem->Bounds = skullRitem->Geo->DrawArgs["skull"].Bounds;
 
 	mSkullRitem = skullRitem.get();
 
@@ -1143,6 +1177,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->Bounds = boxRitem->Geo->DrawArgs["box"].Bounds;
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
 	mAllRitems.push_back(std::move(boxRitem));
@@ -1157,6 +1192,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 	globeRitem->IndexCount = globeRitem->Geo->DrawArgs["sphere"].IndexCount;
 	globeRitem->StartIndexLocation = globeRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	globeRitem->BaseVertexLocation = globeRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	globeRitem->Bounds = globeRitem->Geo->DrawArgs["sphere"].Bounds;
 
 	mRitemLayer[(int)RenderLayer::OpaqueDynamicReflectors].push_back(globeRitem.get());
 	mAllRitems.push_back(std::move(globeRitem));
@@ -1171,6 +1207,7 @@ void DynamicCubeMapApp::BuildRenderItems()
     gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
     gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
     gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRitem->Bounds = gridRitem->Geo->DrawArgs["grid"].Bounds;
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
 	mAllRitems.push_back(std::move(gridRitem));
@@ -1199,6 +1236,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		leftCylRitem->Bounds = leftCylRitem->Geo->DrawArgs["cylinder"].Bounds;
 
 		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		XMStoreFloat4x4(&rightCylRitem->TexTransform, brickTexTransform);
@@ -1209,6 +1247,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		rightCylRitem->Bounds = rightCylRitem->Geo->DrawArgs["cylinder"].Bounds;
 
 		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -1219,6 +1258,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 		leftSphereRitem->IndexCount = leftSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		leftSphereRitem->StartIndexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		leftSphereRitem->BaseVertexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		leftSphereRitem->Bounds = leftSphereRitem->Geo->DrawArgs["sphere"].Bounds;
 
 		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -1229,6 +1269,7 @@ void DynamicCubeMapApp::BuildRenderItems()
 		rightSphereRitem->IndexCount = rightSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		rightSphereRitem->StartIndexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		rightSphereRitem->BaseVertexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		rightSphereRitem->Bounds = rightSphereRitem->Geo->DrawArgs["sphere"].Bounds;
 
 		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftCylRitem.get());
 		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightCylRitem.get());
@@ -1267,6 +1308,9 @@ void DynamicCubeMapApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, cons
 
 void DynamicCubeMapApp::DrawSceneToCubeMap()
 {
+	if(mCubeFacesToDraw == 0)
+		return;
+
 	mCommandList->RSSetViewports(1, &mDynamicCubeMap->Viewport());
 	mCommandList->RSSetScissorRects(1, &mDynamicCubeMap->ScissorRect());
 
@@ -1276,9 +1320,12 @@ void DynamicCubeMapApp::DrawSceneToCubeMap()
 
 	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
 
-	// For each cube map face.
+	// For each cube map face the scheduler picked.
 	for(int i = 0; i < 6; ++i)
 	{
+		if((mCubeFacesToDraw & (1 << i)) == 0)
+			continue;
+
 		// Clear the back buffer and depth buffer.
 		mCommandList->ClearRenderTargetView(mDynamicCubeMap->Rtv(i), Colors::LightSteelBlue, 0, nullptr);
 		mCommandList->ClearDepthStencilView(mCubeDSV, D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
@@ -1292,7 +1339,7 @@ void DynamicCubeMapApp::DrawSceneToCubeMap()
 		D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + (1+i)*passCBByteSize;
 		mCommandList->SetGraphicsRootConstantBufferView(1, passCBAddress);
 
-		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+		DrawRenderItems(mCommandList.Get(), mCubeFaceRitems[i]);
 
 		mCommandList->SetPipelineState(mPSOs["sky"].Get());
 		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Sky]);
@@ -0,0 +1,171 @@
+#include "CascadedShadows.h"
+
+using namespace DirectX;
+
+CascadedShadows::CascadedShadows(UINT cascadeCount, UINT resolution)
+{
+	mCascadeCount = cascadeCount < 1 ? 1 : (cascadeCount > MaxCascades ? MaxCascades : cascadeCount);
+	mResolution = resolution;
+}
+
+void CascadedShadows::SetSplitLambda(float lambda)
+{
+	mSplitLambda = MathHelper::Clamp(lambda, 0.0f, 1.0f);
+}
+
+void CascadedShadows::SetShadowDistance(float distance)
+{
+	mShadowDistance = distance;
+}
+
+void CascadedShadows::ComputeSplits(float nearZ, float farZ, UINT count, float lambda, float* splits)
+{
+	splits[0] = nearZ;
+	for(UINT i = 1; i < count; ++i)
+	{
+		float s = (float)i / count;
+		float logSplit = nearZ*powf(farZ / nearZ, s);
+		float uniformSplit = nearZ + (farZ - nearZ)*s;
+		splits[i] = lambda*logSplit + (1.0f - lambda)*uniformSplit;
+	}
+	splits[count] = farZ;
+}
+
+void CascadedShadows::FitSliceSphere(float splitNear, float splitFar, float fovY, float aspect,
+	float& centerZ, float& radius)
+{
+	// Squared distance from the view axis to a corner at depth z is k*z^2.  The
+	// center is where the near and far corners are equally far away, unless that
+	// is past the far plane, in which case the far corners alone decide.
+	float tanHalfFovY = tanf(0.5f*fovY);
+	float k = tanHalfFovY*tanHalfFovY*(1.0f + aspect*aspect);
+
+	centerZ = 0.5f*(splitNear + splitFar)*(1.0f + k);
+	if(centerZ >= splitFar)
+	{
+		centerZ = splitFar;
+		radius = splitFar*sqrtf(k);
+	}
+	else
+	{
+		float d = splitFar - centerZ;
+		radius = sqrtf(d*d + k*splitFar*splitFar);
+	}
+}
+
+void CascadedShadows::Update(const Camera& camera, FXMVECTOR lightDir,
+	const BoundingBox* casterBounds, UINT casterCount)
+{
+	float nearZ = camera.GetNearZ();
+	float farZ = MathHelper::Min(camera.GetFarZ(), mShadowDistance);
+
+	float splits[MaxCascades + 1];
+	ComputeSplits(nearZ, farZ, mCascadeCount, mSplitLambda, splits);
+
+	// The light looks from the origin, so light space does not move with the camera
+	// and snapping in it is stable.
+	XMVECTOR dir = XMVector3Normalize(lightDir);
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	if(fabsf(XMVectorGetY(dir)) > 0.99f)
+		up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+	XMMATRIX lightView = XMMatrixLookToLH(XMVectorZero(), dir, up);
+
+	mCasterBoundsL.resize(casterCount);
+	for(UINT i = 0; i < casterCount; ++i)
+		casterBounds[i].Transform(mCasterBoundsL[i], lightView);
+
+	for(UINT i = 0; i < mCascadeCount; ++i)
+	{
+		mCascades[i].SplitNear = splits[i];
+		mCascades[i].SplitFar = splits[i + 1];
+		FitCascade(mCascades[i], camera, lightView);
+	}
+}
+
+void CascadedShadows::FitCascade(Cascade& cascade, const Camera& camera, FXMMATRIX lightView)
+{
+	float centerZ = 0.0f;
+	float radius = 0.0f;
+	FitSliceSphere(cascade.SplitNear, cascade.SplitFar, camera.GetFovY(), camera.GetAspect(), centerZ, radius);
+
+	XMVECTOR centerW = XMVectorMultiplyAdd(XMVectorReplicate(centerZ), camera.GetLook(), camera.GetPosition());
+	XMStoreFloat3(&cascade.Bounds.Center, centerW);
+	cascade.Bounds.Radius = radius;
+
+	// Snapping moves the center by up to a texel, so the frustum is made wide
+	// enough to hold the sphere from anywhere within a texel of its center.
+	float halfExtent = radius*mResolution / (mResolution - 2);
+	float texel = 2.0f*halfExtent / mResolution;
+
+	XMFLOAT3 centerL;
+	XMStoreFloat3(&centerL, XMVector3TransformCoord(centerW, lightView));
+
+	float x = floorf(centerL.x / texel)*texel;
+	float y = floorf(centerL.y / texel)*texel;
+
+	float left = x - halfExtent;
+	float right = x + halfExtent;
+	float bottom = y - halfExtent;
+	float top = y + halfExtent;
+	float farZ = ceilf((centerL.z + radius) / texel)*texel;
+	float nearZ = centerL.z - radius;
+
+	// Anything beside the slice in light space and not behind it can cast onto it.
+	cascade.Casters.clear();
+	for(UINT i = 0; i < (UINT)mCasterBoundsL.size(); ++i)
+	{
+		const BoundingBox& box = mCasterBoundsL[i];
+		if(box.Center.x + box.Extents.x < left || box.Center.x - box.Extents.x > right ||
+		   box.Center.y + box.Extents.y < bottom || box.Center.y - box.Extents.y > top ||
+		   box.Center.z - box.Extents.z > farZ)
+			continue;
+
+		cascade.Casters.push_back(i);
+		nearZ = MathHelper::Min(nearZ, box.Center.z - box.Extents.z);
+	}
+	nearZ = floorf(nearZ / texel)*texel;
+
+	XMMATRIX lightProj = XMMatrixOrthographicOffCenterLH(left, right, bottom, top, nearZ, farZ);
+
+	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
+	XMMATRIX T(
+		0.5f, 0.0f, 0.0f, 0.0f,
+		0.0f, -0.5f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.5f, 0.5f, 0.0f, 1.0f);
+
+	XMFLOAT4X4 view;
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&view, lightView);
+	XMStoreFloat4x4(&proj, lightProj);
+
+	if(memcmp(&view, &cascade.View, sizeof(view)) != 0 || memcmp(&proj, &cascade.Proj, sizeof(proj)) != 0)
+		cascade.Dirty = true;
+
+	cascade.View = view;
+	cascade.Proj = proj;
+	XMStoreFloat4x4(&cascade.ShadowTransform, lightView*lightProj*T);
+
+	cascade.Left = left;
+	cascade.Right = right;
+	cascade.Bottom = bottom;
+	cascade.Top = top;
+	cascade.NearZ = nearZ;
+	cascade.FarZ = farZ;
+}
+
+void CascadedShadows::Invalidate(UINT cascade)
+{
+	mCascades[cascade].Dirty = true;
+}
+
+void CascadedShadows::InvalidateAll()
+{
+	for(UINT i = 0; i < mCascadeCount; ++i)
+		mCascades[i].Dirty = true;
+}
+
+void CascadedShadows::MarkDrawn(UINT cascade)
+{
+	mCascades[cascade].Dirty = false;
+}
@@ -0,0 +1,118 @@
+#ifndef CASCADEDSHADOWS_H
+#define CASCADEDSHADOWS_H
+
+#include "../../Common/Camera.h"
+#include <DirectXCollision.h>
+#include <vector>
+
+///<summary>
+/// Fits the orthographic light frusta of a cascaded shadow map to slices of
+/// the camera frustum and picks the shadow casters each cascade must draw.
+///
+/// The camera frustum, clipped to the shadow distance, is cut into slices with
+/// the practical split scheme: a blend of logarithmic splits, which give every
+/// cascade the same texel density in screen space, and uniform splits, which
+/// keep the nearest cascade from becoming tiny.
+///
+/// Each slice is bounded by the smallest sphere around its corners.  The sphere
+/// only depends on the camera lens and the split depths, so its size does not
+/// change when the camera turns, and the light frustum built around it keeps
+/// the same texel size.  The light looks from the world origin along the light
+/// direction and the sphere center is snapped to whole texels in light space,
+/// so when the camera moves the shadow map slides by whole texels and edges do
+/// not shimmer.
+///
+/// A caster can shadow a slice if it overlaps the light frustum sideways and
+/// starts before the far plane, no matter how close it is to the light; the
+/// light frustum is extruded toward the light to the nearest such caster.
+///
+/// A cascade is marked dirty when its light frustum changes.  A cascade that
+/// is not dirty still holds the depth of the same casters seen from the same
+/// place, so the caller may skip redrawing it as long as none of the casters
+/// moved; Invalidate forces it to be redrawn.
+///</summary>
+
+class CascadedShadows
+{
+public:
+    static const UINT MaxCascades = 4;
+
+    struct Cascade
+    {
+        // Camera view space depth range of the slice.
+        float SplitNear = 0.0f;
+        float SplitFar = 0.0f;
+
+        // Bounding sphere of the slice.
+        DirectX::BoundingSphere Bounds;
+
+        DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
+        DirectX::XMFLOAT4X4 Proj = MathHelper::Identity4x4();
+
+        // World to shadow map texture space, View*Proj*T.
+        DirectX::XMFLOAT4X4 ShadowTransform = MathHelper::Identity4x4();
+
+        // Light space box of the light frustum.
+        float Left = 0.0f;
+        float Right = 0.0f;
+        float Bottom = 0.0f;
+        float Top = 0.0f;
+        float NearZ = 0.0f;
+        float FarZ = 0.0f;
+
+        // Indices of the caster boxes passed to Update that must be drawn.
+        std::vector<UINT> Casters;
+
+        bool Dirty = true;
+    };
+
+    CascadedShadows(UINT cascadeCount, UINT resolution);
+
+    // lambda blends uniform (0) and logarithmic (1) splits.
+    void SetSplitLambda(float lambda);
+
+    // Shadows are only cast up to this camera view space depth.
+    void SetShadowDistance(float distance);
+
+    // Refits the cascades to the camera and picks the casters of each one from
+    // their world space boxes.  lightDir points away from the light.
+    void Update(const Camera& camera, DirectX::FXMVECTOR lightDir,
+        const DirectX::BoundingBox* casterBounds, UINT casterCount);
+
+    // Makes the cascade be reported dirty, e.g. after one of its casters moved.
+    void Invalidate(UINT cascade);
+    void InvalidateAll();
+
+    // Clears the dirty flag once the cascade has been drawn.
+    void MarkDrawn(UINT cascade);
+
+    UINT CascadeCount()const { return mCascadeCount; }
+    UINT Resolution()const { return mResolution; }
+    const Cascade& GetCascade(UINT cascade)const { return mCascades[cascade]; }
+
+    // Split depths of the practical scheme for the camera depth range [nearZ, farZ],
+    // count + 1 values from nearZ to farZ.
+    static void ComputeSplits(float nearZ, float farZ, UINT count, float lambda, float* splits);
+
+    // Center and radius of the smallest sphere around the slice [splitNear, splitFar]
+    // of a frustum, along the view axis in view space.
+    static void FitSliceSphere(float splitNear, float splitFar, float fovY, float aspect,
+        float& centerZ, float& radius);
+
+private:
+    void FitCascade(Cascade& cascade, const Camera& camera, DirectX::FXMMATRIX lightView);
+
+private:
+    UINT mCascadeCount = 0;
+    UINT mResolution = 0;
+
+    float mSplitLambda = 0.8f;
+    float mShadowDistance = 100.0f;
+
+    Cascade mCascades[MaxCascades];
+
+    // Light space boxes of the casters, rebuilt by each Update.
+    std::vector<DirectX::BoundingBox> mCasterBoundsL;
+};
+
+#endif // CASCADEDSHADOWS_H
@@ -15,6 +15,9 @@
     #define NUM_SPOT_LIGHTS 0
 #endif
 
+// Must match CascadedShadows::MaxCascades.
+#define NUM_CASCADES 4
+
 // Include structures and functions for lighting.
 #include "LightingUtil.hlsl"
 
@@ -31,7 +34,7 @@ struct MaterialData
 };
 
 TextureCube gCubeMap : register(t0);
-Texture2D gShadowMap : register(t1);
+Texture2DArray gShadowMap : register(t1);
 
 // An array of textures, which is only supported in shader model 5.1+.  Unlike Texture2DArray, the textures
 // in this array can be different sizes and formats, making it more flexible than texture arrays.
@@ -69,7 +72,8 @@ cbuffer cbPass : register(b1)
     float4x4 gInvProj;
     float4x4 gViewProj;
     float4x4 gInvViewProj;
-    float4x4 gShadowTransform;
+    float4x4 gShadowTransforms[NUM_CASCADES];
+    float4 gCascadeSplits;
     float3 gEyePosW;
     float cbPerObjectPad1;
     float2 gRenderTargetSize;
@@ -112,7 +116,7 @@ float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 unitNormalW, floa
 // PCF for shadow mapping.
 //---------------------------------------------------------------------------------------
 
-float CalcShadowFactor(float4 shadowPosH)
+float CalcShadowFactor(float4 shadowPosH, uint cascade)
 {
     // Complete projection by doing division by w.
     shadowPosH.xyz /= shadowPosH.w;
@@ -120,8 +124,8 @@ float CalcShadowFactor(float4 shadowPosH)
     // Depth in NDC space.
     float depth = shadowPosH.z;
 
-    uint width, height, numMips;
-    gShadowMap.GetDimensions(0, width, height, numMips);
+    uint width, height, elements, numMips;
+    gShadowMap.GetDimensions(0, width, height, elements, numMips);
 
     // Texel size.
     float dx = 1.0f / (float)width;
@@ -138,9 +142,32 @@ float CalcShadowFactor(float4 shadowPosH)
     for(int i = 0; i < 9; ++i)
     {
         percentLit += gShadowMap.SampleCmpLevelZero(gsamShadow,
-            shadowPosH.xy + offsets[i], depth).r;
+            float3(shadowPosH.xy + offsets[i], cascade), depth).r;
     }
     
     return percentLit / 9.0f;
 }
 
+//---------------------------------------------------------------------------------------
+// Picks the first cascade whose slice of the camera frustum holds the point.  Points
+// past the last slice are beyond the shadow distance and are lit.
+//---------------------------------------------------------------------------------------
+
+float CalcCascadedShadowFactor(float3 posW, float viewDepth)
+{
+    uint cascade = 0;
+
+    [unroll]
+    for(int i = 0; i < NUM_CASCADES - 1; ++i)
+    {
+        if(viewDepth > gCascadeSplits[i])
+            cascade = i + 1;
+    }
+
+    if(viewDepth > gCascadeSplits[NUM_CASCADES - 1])
+        return 1.0f;
+
+    float4 shadowPosH = mul(float4(posW, 1.0f), gShadowTransforms[cascade]);
+    return CalcShadowFactor(shadowPosH, cascade);
+}
+
@@ -31,7 +31,7 @@ VertexOut VS(VertexIn vin)
 
 float4 PS(VertexOut pin) : SV_Target
 {
-    return float4(gShadowMap.Sample(gsamLinearWrap, pin.TexC).rrr, 1.0f);
+    return float4(gShadowMap.Sample(gsamLinearWrap, float3(pin.TexC, 0.0f)).rrr, 1.0f);
 }
 
 
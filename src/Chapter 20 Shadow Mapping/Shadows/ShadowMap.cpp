@@ -4,12 +4,13 @@
 
 #include "ShadowMap.h"
  
-ShadowMap::ShadowMap(ID3D12Device* device, UINT width, UINT height)
+ShadowMap::ShadowMap(ID3D12Device* device, UINT width, UINT height, UINT arraySize)
 {
 	md3dDevice = device;
 
 	mWidth = width;
 	mHeight = height;
+	mArraySize = arraySize;
 
 	mViewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
 	mScissorRect = { 0, 0, (int)width, (int)height };
@@ -27,6 +28,11 @@ UINT ShadowMap::Height()const
     return mHeight;
 }
 
+UINT ShadowMap::ArraySize()const
+{
+    return mArraySize;
+}
+
 ID3D12Resource*  ShadowMap::Resource()
 {
 	return mShadowMap.Get();
@@ -37,9 +43,9 @@ CD3DX12_GPU_DESCRIPTOR_HANDLE ShadowMap::Srv()const
 	return mhGpuSrv;
 }
 
-CD3DX12_CPU_DESCRIPTOR_HANDLE ShadowMap::Dsv()const
+CD3DX12_CPU_DESCRIPTOR_HANDLE ShadowMap::Dsv(UINT slice)const
 {
-	return mhCpuDsv;
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mhCpuDsv, slice, mDsvDescriptorSize);
 }
 
 D3D12_VIEWPORT ShadowMap::Viewport()const
@@ -54,12 +60,14 @@ D3D12_RECT ShadowMap::ScissorRect()const
 
 void ShadowMap::BuildDescriptors(CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuSrv,
 	                             CD3DX12_GPU_DESCRIPTOR_HANDLE hGpuSrv,
-	                             CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuDsv)
+	                             CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuDsv,
+	                             UINT dsvDescriptorSize)
 {
-	// Save references to the descriptors. 
+	// Save references to the descriptors.  The DSVs of an array are consecutive.
 	mhCpuSrv = hCpuSrv;
 	mhGpuSrv = hGpuSrv;
     mhCpuDsv = hCpuDsv;
+    mDsvDescriptorSize = dsvDescriptorSize;
 
 	//  Create the descriptors
 	BuildDescriptors();
@@ -85,20 +93,46 @@ void ShadowMap::BuildDescriptors()
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS; 
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-    srvDesc.Texture2D.PlaneSlice = 0;
+	if(mArraySize > 1)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.MipLevels = 1;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = mArraySize;
+		srvDesc.Texture2DArray.PlaneSlice = 0;
+		srvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = 1;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+		srvDesc.Texture2D.PlaneSlice = 0;
+	}
     md3dDevice->CreateShaderResourceView(mShadowMap.Get(), &srvDesc, mhCpuSrv);
 
-	// Create DSV to resource so we can render to the shadow map.
+	// Create a DSV per slice so we can render to each one.
 	D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc; 
     dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-    dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
     dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-    dsvDesc.Texture2D.MipSlice = 0;
-	md3dDevice->CreateDepthStencilView(mShadowMap.Get(), &dsvDesc, mhCpuDsv);
+	for(UINT i = 0; i < mArraySize; ++i)
+	{
+		if(mArraySize > 1)
+		{
+			dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DARRAY;
+			dsvDesc.Texture2DArray.MipSlice = 0;
+			dsvDesc.Texture2DArray.FirstArraySlice = i;
+			dsvDesc.Texture2DArray.ArraySize = 1;
+		}
+		else
+		{
+			dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+			dsvDesc.Texture2D.MipSlice = 0;
+		}
+		md3dDevice->CreateDepthStencilView(mShadowMap.Get(), &dsvDesc, Dsv(i));
+	}
 }
 
 void ShadowMap::BuildResource()
@@ -109,7 +143,7 @@ void ShadowMap::BuildResource()
 	texDesc.Alignment = 0;
 	texDesc.Width = mWidth;
 	texDesc.Height = mHeight;
-	texDesc.DepthOrArraySize = 1;
+	texDesc.DepthOrArraySize = (UINT16)mArraySize;
 	texDesc.MipLevels = 1;
 	texDesc.Format = mFormat;
 	texDesc.SampleDesc.Count = 1;
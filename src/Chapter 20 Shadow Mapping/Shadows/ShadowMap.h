@@ -9,8 +9,10 @@
 class ShadowMap
 {
 public:
+	// arraySize > 1 makes a Texture2DArray with one depth view per slice, e.g.
+	// one per shadow cascade.
 	ShadowMap(ID3D12Device* device,
-		UINT width, UINT height);
+		UINT width, UINT height, UINT arraySize = 1);
 		
 	ShadowMap(const ShadowMap& rhs)=delete;
 	ShadowMap& operator=(const ShadowMap& rhs)=delete;
@@ -18,9 +20,10 @@ public:
 
     UINT Width()const;
     UINT Height()const;
+    UINT ArraySize()const;
 	ID3D12Resource* Resource();
 	CD3DX12_GPU_DESCRIPTOR_HANDLE Srv()const;
-	CD3DX12_CPU_DESCRIPTOR_HANDLE Dsv()const;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE Dsv(UINT slice = 0)const;
 
 	D3D12_VIEWPORT Viewport()const;
 	D3D12_RECT ScissorRect()const;
@@ -28,7 +31,8 @@ public:
 	void BuildDescriptors(
 		CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuSrv,
 		CD3DX12_GPU_DESCRIPTOR_HANDLE hGpuSrv,
-		CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuDsv);
+		CD3DX12_CPU_DESCRIPTOR_HANDLE hCpuDsv,
+		UINT dsvDescriptorSize = 0);
 
 	void OnResize(UINT newWidth, UINT newHeight);
 
@@ -45,11 +49,13 @@ private:
 
 	UINT mWidth = 0;
 	UINT mHeight = 0;
+	UINT mArraySize = 1;
 	DXGI_FORMAT mFormat = DXGI_FORMAT_R24G8_TYPELESS;
 
 	CD3DX12_CPU_DESCRIPTOR_HANDLE mhCpuSrv;
 	CD3DX12_GPU_DESCRIPTOR_HANDLE mhGpuSrv;
 	CD3DX12_CPU_DESCRIPTOR_HANDLE mhCpuDsv;
+	UINT mDsvDescriptorSize = 0;
 
 	Microsoft::WRL::ComPtr<ID3D12Resource> mShadowMap = nullptr;
 };
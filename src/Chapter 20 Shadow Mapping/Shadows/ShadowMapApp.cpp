@@ -7,8 +7,10 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/ModelLoader.h"
 #include "FrameResource.h"
 #include "ShadowMap.h"
+#include "CascadedShadows.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -49,6 +51,9 @@ struct RenderItem
     UINT IndexCount = 0;
     UINT StartIndexLocation = 0;
     int BaseVertexLocation = 0;
+
+    // World space box, used to pick the shadow casters of each cascade.
+    DirectX::BoundingBox Bounds;
 };
 
 enum class RenderLayer : int
@@ -140,16 +145,17 @@ private:
 	Camera mCamera;
 
     std::unique_ptr<ShadowMap> mShadowMap;
+    std::unique_ptr<CascadedShadows> mCascades;
 
-    DirectX::BoundingSphere mSceneBounds;
+    // Opaque items as shadow casters, and their world space boxes in the same order.
+    std::vector<RenderItem*> mCasters;
+    std::vector<BoundingBox> mCasterBounds;
+    std::vector<RenderItem*> mCascadeRitems;
 
-    float mLightNearZ = 0.0f;
-    float mLightFarZ = 0.0f;
-    XMFLOAT3 mLightPosW;
-    XMFLOAT4X4 mLightView = MathHelper::Identity4x4();
-    XMFLOAT4X4 mLightProj = MathHelper::Identity4x4();
-    XMFLOAT4X4 mShadowTransform = MathHelper::Identity4x4();
+    // Keep the depth of a cascade whose light frustum and casters did not change.
+    bool mShadowCacheEnabled = true;
 
+    bool mLightAnimated = true;
     float mLightRotationAngle = 0.0f;
     XMFLOAT3 mBaseLightDirections[3] = {
         XMFLOAT3(0.57735f, -0.57735f, 0.57735f),
@@ -187,12 +193,6 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 ShadowMapApp::ShadowMapApp(HINSTANCE hInstance)
     : D3DApp(hInstance)
 {
-    // Estimate the scene bounding sphere manually since we know how the scene was constructed.
-    // The grid is the "widest object" with a width of 20 and depth of 30.0f, and centered at
-    // the world space origin.  In general, you need to loop over every world space vertex
-    // position and compute the bounding sphere.
-    mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
-    mSceneBounds.Radius = sqrtf(10.0f*10.0f + 15.0f*15.0f);
 }
 
 ShadowMapApp::~ShadowMapApp()
@@ -212,7 +212,9 @@ bool ShadowMapApp::Initialize()
 	mCamera.SetPosition(0.0f, 2.0f, -15.0f);
  
     mShadowMap = std::make_unique<ShadowMap>(
-        md3dDevice.Get(), 2048, 2048);
+        md3dDevice.Get(), 2048, 2048, CascadedShadows::MaxCascades);
+
+    mCascades = std::make_unique<CascadedShadows>(CascadedShadows::MaxCascades, 2048);
 
 	LoadTextures();
     BuildRootSignature();
@@ -247,9 +249,9 @@ void ShadowMapApp::CreateRtvAndDsvDescriptorHeaps()
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
         &rtvHeapDesc, IID_PPV_ARGS(mRtvHeap.GetAddressOf())));
 
-    // Add +1 DSV for shadow map.
+    // Add a DSV for each shadow cascade.
     D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
-    dsvHeapDesc.NumDescriptors = 2;
+    dsvHeapDesc.NumDescriptors = 1 + CascadedShadows::MaxCascades;
     dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
     dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
     dsvHeapDesc.NodeMask = 0;
@@ -286,7 +288,8 @@ void ShadowMapApp::Update(const GameTimer& gt)
     // Animate the lights (and hence shadows).
     //
 
-    mLightRotationAngle += 0.1f*gt.DeltaTime();
+    if(mLightAnimated)
+        mLightRotationAngle += 0.1f*gt.DeltaTime();
 
     XMMATRIX R = XMMatrixRotationY(mLightRotationAngle);
     for(int i = 0; i < 3; ++i)
@@ -440,6 +443,28 @@ void ShadowMapApp::OnKeyboardInput(const GameTimer& gt)
 	if(GetAsyncKeyState('D') & 0x8000)
 		mCamera.Strafe(10.0f*dt);
 
+	// C toggles the cache of unchanged cascades, L stops the light so the cache
+	// has something to keep.
+	static bool bCachePressed = false;
+	if(GetAsyncKeyState('C') & 0x8000)
+	{
+		if(!bCachePressed)
+			mShadowCacheEnabled = !mShadowCacheEnabled;
+		bCachePressed = true;
+	}
+	else
+		bCachePressed = false;
+
+	static bool bLightPressed = false;
+	if(GetAsyncKeyState('L') & 0x8000)
+	{
+		if(!bLightPressed)
+			mLightAnimated = !mLightAnimated;
+		bLightPressed = true;
+	}
+	else
+		bLightPressed = false;
+
 	mCamera.UpdateViewMatrix();
 }
  
@@ -505,40 +530,17 @@ void ShadowMapApp::UpdateShadowTransform(const GameTimer& gt)
 {
     // Only the first "main" light casts a shadow.
     XMVECTOR lightDir = XMLoadFloat3(&mRotatedLightDirections[0]);
-    XMVECTOR lightPos = -2.0f*mSceneBounds.Radius*lightDir;
-    XMVECTOR targetPos = XMLoadFloat3(&mSceneBounds.Center);
-    XMVECTOR lightUp = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-    XMMATRIX lightView = XMMatrixLookAtLH(lightPos, targetPos, lightUp);
-
-    XMStoreFloat3(&mLightPosW, lightPos);
-
-    // Transform bounding sphere to light space.
-    XMFLOAT3 sphereCenterLS;
-    XMStoreFloat3(&sphereCenterLS, XMVector3TransformCoord(targetPos, lightView));
-
-    // Ortho frustum in light space encloses scene.
-    float l = sphereCenterLS.x - mSceneBounds.Radius;
-    float b = sphereCenterLS.y - mSceneBounds.Radius;
-    float n = sphereCenterLS.z - mSceneBounds.Radius;
-    float r = sphereCenterLS.x + mSceneBounds.Radius;
-    float t = sphereCenterLS.y + mSceneBounds.Radius;
-    float f = sphereCenterLS.z + mSceneBounds.Radius;
-
-    mLightNearZ = n;
-    mLightFarZ = f;
-    XMMATRIX lightProj = XMMatrixOrthographicOffCenterLH(l, r, b, t, n, f);
-
-    // Transform NDC space [-1,+1]^2 to texture space [0,1]^2
-    XMMATRIX T(
-        0.5f, 0.0f, 0.0f, 0.0f,
-        0.0f, -0.5f, 0.0f, 0.0f,
-        0.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.0f, 1.0f);
-
-    XMMATRIX S = lightView*lightProj*T;
-    XMStoreFloat4x4(&mLightView, lightView);
-    XMStoreFloat4x4(&mLightProj, lightProj);
-    XMStoreFloat4x4(&mShadowTransform, S);
+
+    mCascades->Update(mCamera, lightDir, mCasterBounds.data(), (UINT)mCasterBounds.size());
+
+    // A cascade holding the depth of a caster that moved must be drawn again.  A
+    // moved caster may also have left or entered any cascade, so redraw them all.
+    bool casterMoved = false;
+    for(auto ri : mCasters)
+        casterMoved = casterMoved || ri->NumFramesDirty > 0;
+
+    if(!mShadowCacheEnabled || casterMoved)
+        mCascades->InvalidateAll();
 }
 
 void ShadowMapApp::UpdateMainPassCB(const GameTimer& gt)
@@ -551,15 +553,19 @@ void ShadowMapApp::UpdateMainPassCB(const GameTimer& gt)
 	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
 	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
 
-    XMMATRIX shadowTransform = XMLoadFloat4x4(&mShadowTransform);
-
 	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
 	XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
 	XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj));
 	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
 	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
 	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-    XMStoreFloat4x4(&mMainPassCB.ShadowTransform, XMMatrixTranspose(shadowTransform));
+    for(UINT i = 0; i < mCascades->CascadeCount(); ++i)
+    {
+        const auto& cascade = mCascades->GetCascade(i);
+        XMMATRIX shadowTransform = XMLoadFloat4x4(&cascade.ShadowTransform);
+        XMStoreFloat4x4(&mMainPassCB.ShadowTransforms[i], XMMatrixTranspose(shadowTransform));
+        (&mMainPassCB.CascadeSplits.x)[i] = cascade.SplitFar;
+    }
 	mMainPassCB.EyePosW = mCamera.GetPosition3f();
 	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
 	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
@@ -581,31 +587,37 @@ void ShadowMapApp::UpdateMainPassCB(const GameTimer& gt)
 
 void ShadowMapApp::UpdateShadowPassCB(const GameTimer& gt)
 {
-    XMMATRIX view = XMLoadFloat4x4(&mLightView);
-    XMMATRIX proj = XMLoadFloat4x4(&mLightProj);
-
-    XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-    XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-    XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-    XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
-
     UINT w = mShadowMap->Width();
     UINT h = mShadowMap->Height();
 
-    XMStoreFloat4x4(&mShadowPassCB.View, XMMatrixTranspose(view));
-    XMStoreFloat4x4(&mShadowPassCB.InvView, XMMatrixTranspose(invView));
-    XMStoreFloat4x4(&mShadowPassCB.Proj, XMMatrixTranspose(proj));
-    XMStoreFloat4x4(&mShadowPassCB.InvProj, XMMatrixTranspose(invProj));
-    XMStoreFloat4x4(&mShadowPassCB.ViewProj, XMMatrixTranspose(viewProj));
-    XMStoreFloat4x4(&mShadowPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-    mShadowPassCB.EyePosW = mLightPosW;
-    mShadowPassCB.RenderTargetSize = XMFLOAT2((float)w, (float)h);
-    mShadowPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / w, 1.0f / h);
-    mShadowPassCB.NearZ = mLightNearZ;
-    mShadowPassCB.FarZ = mLightFarZ;
-
-    auto currPassCB = mCurrFrameResource->PassCB.get();
-    currPassCB->CopyData(1, mShadowPassCB);
+    // One pass per cascade, after the main pass.
+    for(UINT i = 0; i < mCascades->CascadeCount(); ++i)
+    {
+        const auto& cascade = mCascades->GetCascade(i);
+
+        XMMATRIX view = XMLoadFloat4x4(&cascade.View);
+        XMMATRIX proj = XMLoadFloat4x4(&cascade.Proj);
+
+        XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+        XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+        XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
+        XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+
+        XMStoreFloat4x4(&mShadowPassCB.View, XMMatrixTranspose(view));
+        XMStoreFloat4x4(&mShadowPassCB.InvView, XMMatrixTranspose(invView));
+        XMStoreFloat4x4(&mShadowPassCB.Proj, XMMatrixTranspose(proj));
+        XMStoreFloat4x4(&mShadowPassCB.InvProj, XMMatrixTranspose(invProj));
+        XMStoreFloat4x4(&mShadowPassCB.ViewProj, XMMatrixTranspose(viewProj));
+        XMStoreFloat4x4(&mShadowPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
+        XMStoreFloat3(&mShadowPassCB.EyePosW, invView.r[3]);
+        mShadowPassCB.RenderTargetSize = XMFLOAT2((float)w, (float)h);
+        mShadowPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / w, 1.0f / h);
+        mShadowPassCB.NearZ = cascade.NearZ;
+        mShadowPassCB.FarZ = cascade.FarZ;
+
+        auto currPassCB = mCurrFrameResource->PassCB.get();
+        currPassCB->CopyData(1 + i, mShadowPassCB);
+    }
 }
 
 void ShadowMapApp::LoadTextures()
@@ -758,17 +770,22 @@ void ShadowMapApp::BuildDescriptorHeaps()
     md3dDevice->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
     nullSrv.Offset(1, mCbvSrvUavDescriptorSize);
 
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+    // The shadow map is a texture array, one slice per cascade.
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
     srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-    srvDesc.Texture2D.MostDetailedMip = 0;
-    srvDesc.Texture2D.MipLevels = 1;
-    srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+    srvDesc.Texture2DArray.MostDetailedMip = 0;
+    srvDesc.Texture2DArray.MipLevels = 1;
+    srvDesc.Texture2DArray.FirstArraySlice = 0;
+    srvDesc.Texture2DArray.ArraySize = CascadedShadows::MaxCascades;
+    srvDesc.Texture2DArray.PlaneSlice = 0;
+    srvDesc.Texture2DArray.ResourceMinLODClamp = 0.0f;
     md3dDevice->CreateShaderResourceView(nullptr, &srvDesc, nullSrv);
     
     mShadowMap->BuildDescriptors(
         CD3DX12_CPU_DESCRIPTOR_HANDLE(srvCpuStart, mShadowMapHeapIndex, mCbvSrvUavDescriptorSize),
         CD3DX12_GPU_DESCRIPTOR_HANDLE(srvGpuStart, mShadowMapHeapIndex, mCbvSrvUavDescriptorSize),
-        CD3DX12_CPU_DESCRIPTOR_HANDLE(dsvCpuStart, 1, mDsvDescriptorSize));
+        CD3DX12_CPU_DESCRIPTOR_HANDLE(dsvCpuStart, 1, mDsvDescriptorSize),
+        mDsvDescriptorSize);
 }
 
 void ShadowMapApp::BuildShadersAndInputLayout()
@@ -854,6 +871,28 @@ void ShadowMapApp::BuildShapeGeometry()
     quadSubmesh.StartIndexLocation = quadIndexOffset;
     quadSubmesh.BaseVertexLocation = quadVertexOffset;
 
+	// Local space boxes, used to pick the shadow casters of each cascade.
+	auto computeBounds = [](const GeometryGenerator::MeshData& mesh)
+	{
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+		for(const auto& v : mesh.Vertices)
+		{
+			XMVECTOR P = XMLoadFloat3(&v.Position);
+			vMin = XMVectorMin(vMin, P);
+			vMax = XMVectorMax(vMax, P);
+		}
+
+		BoundingBox bounds;
+		BoundingBox::CreateFromPoints(bounds, vMin, vMax);
+		return bounds;
+	};
+
+	boxSubmesh.Bounds = computeBounds(box);
+	gridSubmesh.Bounds = computeBounds(grid);
+	sphereSubmesh.Bounds = computeBounds(sphere);
+	cylinderSubmesh.Bounds = computeBounds(cylinder);
+
 	//
 	// Extract the vertex elements we are interested in and pack the
 	// vertices of all the meshes into one vertex buffer.
@@ -950,38 +989,21 @@ void ShadowMapApp::BuildShapeGeometry()
 
 void ShadowMapApp::BuildSkullGeometry()
 {
-    std::ifstream fin("Models/skull.txt");
-
-    if (!fin)
+    ModelData model;
+    if (!ModelLoader::Load("Models/skull.txt", model))
     {
         MessageBox(0, L"Models/skull.txt not found.", 0, 0);
         return;
     }
 
-    UINT vcount = 0;
-    UINT tcount = 0;
-    std::string ignore;
-
-    fin >> ignore >> vcount;
-    fin >> ignore >> tcount;
-    fin >> ignore >> ignore >> ignore >> ignore;
-
-    XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-    XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-    XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-    XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-    std::vector<Vertex> vertices(vcount);
-    for (UINT i = 0; i < vcount; ++i)
+    std::vector<Vertex> vertices(model.Positions.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
     {
-        fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-        fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
+        vertices[i].Pos = model.Positions[i];
+        vertices[i].Normal = model.Normals[i];
 
         vertices[i].TexC = { 0.0f, 0.0f };
 
-        XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
         XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
 
         // Generate a tangent vector so normal mapping works.  We aren't applying
@@ -999,27 +1021,9 @@ void ShadowMapApp::BuildSkullGeometry()
             XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, up));
             XMStoreFloat3(&vertices[i].TangentU, T);
         }
-        
-
-        vMin = XMVectorMin(vMin, P);
-        vMax = XMVectorMax(vMax, P);
     }
 
-    BoundingBox bounds;
-    XMStoreFloat3(&bounds.Center, 0.5f*(vMin + vMax));
-    XMStoreFloat3(&bounds.Extents, 0.5f*(vMax - vMin));
-
-    fin >> ignore;
-    fin >> ignore;
-    fin >> ignore;
-
-    std::vector<std::int32_t> indices(3 * tcount);
-    for (UINT i = 0; i < tcount; ++i)
-    {
-        fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
-    }
-
-    fin.close();
+    const std::vector<std::int32_t>& indices = model.Indices;
 
     //
     // Pack the indices of all the meshes into one index buffer.
@@ -1053,7 +1057,7 @@ void ShadowMapApp::BuildSkullGeometry()
     submesh.IndexCount = (UINT)indices.size();
     submesh.StartIndexLocation = 0;
     submesh.BaseVertexLocation = 0;
-    submesh.Bounds = bounds;
+    submesh.Bounds = model.Bounds;
 
     geo->DrawArgs["skull"] = submesh;
 
@@ -1165,7 +1169,7 @@ void ShadowMapApp::BuildFrameResources()
     for(int i = 0; i < gNumFrameResources; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            2, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+            1 + CascadedShadows::MaxCascades, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
     }
 }
 
@@ -1263,6 +1267,7 @@ void ShadowMapApp::BuildRenderItems()
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->Geo->DrawArgs["box"].Bounds.Transform(boxRitem->Bounds, XMLoadFloat4x4(&boxRitem->World));
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
 	mAllRitems.push_back(std::move(boxRitem));
@@ -1277,6 +1282,7 @@ void ShadowMapApp::BuildRenderItems()
     skullRitem->IndexCount = skullRitem->Geo->DrawArgs["skull"].IndexCount;
     skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
     skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
+    skullRitem->Geo->DrawArgs["skull"].Bounds.Transform(skullRitem->Bounds, XMLoadFloat4x4(&skullRitem->World));
 
     mRitemLayer[(int)RenderLayer::Opaque].push_back(skullRitem.get());
     mAllRitems.push_back(std::move(skullRitem));
@@ -1291,6 +1297,7 @@ void ShadowMapApp::BuildRenderItems()
     gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
     gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
     gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+    gridRitem->Geo->DrawArgs["grid"].Bounds.Transform(gridRitem->Bounds, XMLoadFloat4x4(&gridRitem->World));
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
 	mAllRitems.push_back(std::move(gridRitem));
@@ -1319,6 +1326,7 @@ void ShadowMapApp::BuildRenderItems()
 		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		leftCylRitem->Geo->DrawArgs["cylinder"].Bounds.Transform(leftCylRitem->Bounds, XMLoadFloat4x4(&leftCylRitem->World));
 
 		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		XMStoreFloat4x4(&rightCylRitem->TexTransform, brickTexTransform);
@@ -1329,6 +1337,7 @@ void ShadowMapApp::BuildRenderItems()
 		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		rightCylRitem->Geo->DrawArgs["cylinder"].Bounds.Transform(rightCylRitem->Bounds, XMLoadFloat4x4(&rightCylRitem->World));
 
 		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -1339,6 +1348,7 @@ void ShadowMapApp::BuildRenderItems()
 		leftSphereRitem->IndexCount = leftSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		leftSphereRitem->StartIndexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		leftSphereRitem->BaseVertexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		leftSphereRitem->Geo->DrawArgs["sphere"].Bounds.Transform(leftSphereRitem->Bounds, XMLoadFloat4x4(&leftSphereRitem->World));
 
 		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->TexTransform = MathHelper::Identity4x4();
@@ -1349,6 +1359,7 @@ void ShadowMapApp::BuildRenderItems()
 		rightSphereRitem->IndexCount = rightSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		rightSphereRitem->StartIndexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		rightSphereRitem->BaseVertexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		rightSphereRitem->Geo->DrawArgs["sphere"].Bounds.Transform(rightSphereRitem->Bounds, XMLoadFloat4x4(&rightSphereRitem->World));
 
 		mRitemLayer[(int)RenderLayer::Opaque].push_back(leftCylRitem.get());
 		mRitemLayer[(int)RenderLayer::Opaque].push_back(rightCylRitem.get());
@@ -1360,6 +1371,11 @@ void ShadowMapApp::BuildRenderItems()
 		mAllRitems.push_back(std::move(leftSphereRitem));
 		mAllRitems.push_back(std::move(rightSphereRitem));
 	}
+
+	// Every opaque item casts a shadow.
+	mCasters = mRitemLayer[(int)RenderLayer::Opaque];
+	for(auto ri : mCasters)
+		mCasterBounds.push_back(ri->Bounds);
 }
 
 void ShadowMapApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -1396,23 +1412,38 @@ void ShadowMapApp::DrawSceneToShadowMap()
 
     UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
 
-    // Clear the back buffer and depth buffer.
-    mCommandList->ClearDepthStencilView(mShadowMap->Dsv(), 
-        D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
-
-    // Set null render target because we are only going to draw to
-    // depth buffer.  Setting a null render target will disable color writes.
-    // Note the active PSO also must specify a render target count of 0.
-    mCommandList->OMSetRenderTargets(0, nullptr, false, &mShadowMap->Dsv());
+    mCommandList->SetPipelineState(mPSOs["shadow_opaque"].Get());
 
-    // Bind the pass constant buffer for the shadow map pass.
     auto passCB = mCurrFrameResource->PassCB->Resource();
-    D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + 1*passCBByteSize;
-    mCommandList->SetGraphicsRootConstantBufferView(1, passCBAddress);
+    for(UINT i = 0; i < mCascades->CascadeCount(); ++i)
+    {
+        const auto& cascade = mCascades->GetCascade(i);
 
-    mCommandList->SetPipelineState(mPSOs["shadow_opaque"].Get());
+        // The slice still holds the same casters seen from the same place.
+        if(!cascade.Dirty)
+            continue;
 
-    DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+        mCommandList->ClearDepthStencilView(mShadowMap->Dsv(i),
+            D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
+
+        // Set null render target because we are only going to draw to
+        // depth buffer.  Setting a null render target will disable color writes.
+        // Note the active PSO also must specify a render target count of 0.
+        mCommandList->OMSetRenderTargets(0, nullptr, false, &mShadowMap->Dsv(i));
+
+        // Bind the pass constant buffer for this cascade.
+        D3D12_GPU_VIRTUAL_ADDRESS passCBAddress = passCB->GetGPUVirtualAddress() + (1 + i)*passCBByteSize;
+        mCommandList->SetGraphicsRootConstantBufferView(1, passCBAddress);
+
+        // Only the casters that can shadow this slice of the view.
+        mCascadeRitems.clear();
+        for(UINT caster : cascade.Casters)
+            mCascadeRitems.push_back(mCasters[caster]);
+
+        DrawRenderItems(mCommandList.Get(), mCascadeRitems);
+
+        mCascades->MarkDrawn(i);
+    }
 
     // Change back to GENERIC_READ so we can read the texture in a shader.
     mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
@@ -59,6 +59,9 @@ struct SsaoConstants
     float OcclusionFadeStart = 0.2f;
     float OcclusionFadeEnd = 2.0f;
     float SurfaceEpsilon = 0.05f;
+
+    // Offset vectors the shader takes.
+    UINT SampleCount = 14;
 };
 
 struct MaterialData
@@ -19,6 +19,9 @@ cbuffer cbSsao : register(b0)
     float    gOcclusionFadeStart;
     float    gOcclusionFadeEnd;
     float    gSurfaceEpsilon;
+
+    // How many of gOffsetVectors to take.
+    uint     gSampleCount;
 };
 
 cbuffer cbRootConstants : register(b1)
@@ -36,7 +39,8 @@ SamplerState gsamLinearClamp : register(s1);
 SamplerState gsamDepthMap : register(s2);
 SamplerState gsamLinearWrap : register(s3);
 
-static const int gSampleCount = 14;
+// Must match Ssao::RotationMapSize.
+static const uint gRotationMapSize = 64;
  
 static const float2 gTexCoords[6] =
 {
@@ -134,24 +138,35 @@ float4 PS(VertexOut pin) : SV_Target
 	//
 	float3 p = (pz/pin.PosV.z)*pin.PosV;
 	
-	// Extract random vector and map from [0,1] --> [-1, +1].
-	float3 randVec = 2.0f*gRandomVecMap.SampleLevel(gsamLinearWrap, 4.0f*pin.TexC, 0.0f).rgb - 1.0f;
+	// Extract the blue noise rotation (cos, sin) and map from [0,1] --> [-1, +1].  The
+	// map tiles the screen with one texel per pixel, so it is read without filtering.
+	uint2 texel = uint2(pin.PosH.xy) & (gRotationMapSize - 1);
+	float2 rotation = 2.0f*gRandomVecMap.Load(int3(texel, 0)).rg - 1.0f;
+
+	// Orthonormal basis about n (Duff et al., "Building an Orthonormal Basis,
+	// Revisited"), turned about n by the rotation angle.
+	float s = n.z >= 0.0f ? 1.0f : -1.0f;
+	float a = -1.0f / (s + n.z);
+	float b = n.x*n.y*a;
+	float3 t0 = float3(1.0f + s*n.x*n.x*a, s*b, -s*n.x);
+	float3 b0 = float3(b, s + n.y*n.y*a, -n.y);
+
+	float3 t = rotation.x*t0 + rotation.y*b0;
+	float3 bt = rotation.x*b0 - rotation.y*t0;
 
 	float occlusionSum = 0.0f;
 	
 	// Sample neighboring points about p in the hemisphere oriented by n.
-	for(int i = 0; i < gSampleCount; ++i)
+	for(uint i = 0; i < gSampleCount; ++i)
 	{
-		// Are offset vectors are fixed and uniformly distributed (so that our offset vectors
-		// do not clump in the same direction).  If we reflect them about a random vector
-		// then we get a random uniform distribution of offset vectors.
-		float3 offset = reflect(gOffsetVectors[i].xyz, randVec);
-	
-		// Flip offset vector if it is behind the plane defined by (p, n).
-		float flip = sign( dot(offset, n) );
+		// The offset vectors are a low discrepancy set in the hemisphere about +z
+		// (so that our offset vectors do not clump in the same direction).  Taken to
+		// the basis about n they are already in front of the plane defined by (p, n).
+		float3 k = gOffsetVectors[i].xyz;
+		float3 offset = k.x*t + k.y*bt + k.z*n;
 		
 		// Sample a point near p within the occlusion radius.
-		float3 q = p + flip * gOcclusionRadius * offset;
+		float3 q = p + gOcclusionRadius * offset;
 		
 		// Project q and generate projective tex-coords.  
 		float4 projQ = mul(float4(q, 1.0f), gProjTex);
@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "Ssao.h"
+#include "../../Common/SampleSets.h"
 #include <DirectXPackedVector.h>
 
 using namespace DirectX;
@@ -359,8 +360,8 @@ void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
     ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
     texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
     texDesc.Alignment = 0;
-    texDesc.Width = 256;
-    texDesc.Height = 256;
+    texDesc.Width = RotationMapSize;
+    texDesc.Height = RotationMapSize;
     texDesc.DepthOrArraySize = 1;
     texDesc.MipLevels = 1;
     texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -393,22 +394,22 @@ void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
         nullptr,
         IID_PPV_ARGS(mRandomVectorMapUploadBuffer.GetAddressOf())));
 
-    XMCOLOR initData[256 * 256];
-    for(int i = 0; i < 256; ++i)
-    {
-        for(int j = 0; j < 256; ++j)
-        {
-			// Random vector in [0,1].  We will decompress in shader to [-1,1].
-            XMFLOAT3 v(MathHelper::RandF(), MathHelper::RandF(), MathHelper::RandF());
+    // A blue noise angle per texel, stored as its cosine and sine in [0,1].  We will
+    // decompress in shader to [-1,1].  Neighboring pixels get angles far apart, so
+    // the blur has only high frequency noise to take out.
+    std::vector<float> angles = SampleSets::BlueNoise(RotationMapSize);
 
-            initData[i * 256 + j] = XMCOLOR(v.x, v.y, v.z, 0.0f);
-        }
+    std::vector<XMCOLOR> initData(RotationMapSize * RotationMapSize);
+    for(UINT i = 0; i < RotationMapSize * RotationMapSize; ++i)
+    {
+        float theta = XM_2PI * angles[i];
+        initData[i] = XMCOLOR(0.5f*cosf(theta) + 0.5f, 0.5f*sinf(theta) + 0.5f, 0.0f, 0.0f);
     }
 
     D3D12_SUBRESOURCE_DATA subResourceData = {};
-    subResourceData.pData = initData;
-    subResourceData.RowPitch = 256 * sizeof(XMCOLOR);
-    subResourceData.SlicePitch = subResourceData.RowPitch * 256;
+    subResourceData.pData = initData.data();
+    subResourceData.RowPitch = RotationMapSize * sizeof(XMCOLOR);
+    subResourceData.SlicePitch = subResourceData.RowPitch * RotationMapSize;
 
     //
     // Schedule to copy the data to the default resource, and change states.
@@ -426,42 +427,13 @@ void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
  
 void Ssao::BuildOffsetVectors()
 {
-    // Start with 14 uniformly distributed vectors.  We choose the 8 corners of the cube
-	// and the 6 center points along each cube face.  We always alternate the points on 
-	// opposites sides of the cubes.  This way we still get the vectors spread out even
-	// if we choose to use less than 14 samples.
-	
-	// 8 cube corners
-	mOffsets[0] = XMFLOAT4(+1.0f, +1.0f, +1.0f, 0.0f);
-	mOffsets[1] = XMFLOAT4(-1.0f, -1.0f, -1.0f, 0.0f);
-
-	mOffsets[2] = XMFLOAT4(-1.0f, +1.0f, +1.0f, 0.0f);
-	mOffsets[3] = XMFLOAT4(+1.0f, -1.0f, -1.0f, 0.0f);
-
-	mOffsets[4] = XMFLOAT4(+1.0f, +1.0f, -1.0f, 0.0f);
-	mOffsets[5] = XMFLOAT4(-1.0f, -1.0f, +1.0f, 0.0f);
-
-	mOffsets[6] = XMFLOAT4(-1.0f, +1.0f, -1.0f, 0.0f);
-	mOffsets[7] = XMFLOAT4(+1.0f, -1.0f, +1.0f, 0.0f);
-
-	// 6 centers of cube faces
-	mOffsets[8] = XMFLOAT4(-1.0f, 0.0f, 0.0f, 0.0f);
-	mOffsets[9] = XMFLOAT4(+1.0f, 0.0f, 0.0f, 0.0f);
-
-	mOffsets[10] = XMFLOAT4(0.0f, -1.0f, 0.0f, 0.0f);
-	mOffsets[11] = XMFLOAT4(0.0f, +1.0f, 0.0f, 0.0f);
-
-	mOffsets[12] = XMFLOAT4(0.0f, 0.0f, -1.0f, 0.0f);
-	mOffsets[13] = XMFLOAT4(0.0f, 0.0f, +1.0f, 0.0f);
-
-    for(int i = 0; i < 14; ++i)
-	{
-		// Create random lengths in [0.25, 1.0].
-		float s = MathHelper::RandF(0.25f, 1.0f);
-		
-		XMVECTOR v = s * XMVector4Normalize(XMLoadFloat4(&mOffsets[i]));
-		
-		XMStoreFloat4(&mOffsets[i], v);
-	}
+    // Offsets in the hemisphere about +z, which the shader takes to the hemisphere
+    // about the pixel's normal.  Directions are cosine weighted and lengths spread
+    // over [0.25, 1.0].  Exactly the SampleCount the shader takes, shortest first;
+    // the vectors it does not read are zero.
+    std::vector<XMFLOAT4> kernel = SampleSets::HemisphereKernel(SampleCount, SampleSets::Sequence::Sobol, 0.25f);
+    SampleSets::SortByLength(kernel);
+
+    std::copy(kernel.begin(), kernel.end(), &mOffsets[0]);
+    std::fill(&mOffsets[SampleCount], std::end(mOffsets), XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
 }
-
@@ -27,6 +27,17 @@ public:
 
     static const int MaxBlurRadius = 5;
 
+    // The shader takes the first SampleCount of the 14 offset vectors, a low
+    // discrepancy set of that many sorted by length.  Each pixel turns them about its
+    // normal by a blue noise angle, so the error is spread evenly over the screen and
+    // fewer samples and blur passes do the work 14 random offsets, white noise and
+    // three blur passes did.
+    static const int SampleCount = 8;
+    static const int BlurCount = 2;
+
+    // The blue noise rotation map tiles the ambient map one texel per pixel.
+    static const UINT RotationMapSize = 64;
+
 	UINT SsaoMapWidth()const;
     UINT SsaoMapHeight()const;
 
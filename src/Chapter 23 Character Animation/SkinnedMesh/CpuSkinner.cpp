@@ -0,0 +1,569 @@
+#include "CpuSkinner.h"
+#if defined(CPUSKINNER_AVX2)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC compiles AVX2 intrinsics anywhere; GCC and Clang only in functions marked for it.
+#if defined(CPUSKINNER_AVX2) && !defined(_MSC_VER)
+#define CPUSKINNER_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define CPUSKINNER_TARGET_AVX2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+#if defined(CPUSKINNER_AVX2)
+	// AVX2 and FMA in the CPU, and YMM state saved by the OS.
+	bool CpuHasAVX2()
+	{
+#if defined(__AVX2__)
+		return true;
+#elif !defined(_MSC_VER)
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		int info[4];
+		__cpuid(info, 0);
+		if(info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if(!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#endif
+	}
+
+	const bool gUseAVX2 = CpuHasAVX2();
+
+	CPUSKINNER_TARGET_AVX2 inline __m256 Madd8(__m256 a, __m256 b, __m256 c)
+	{
+		return _mm256_fmadd_ps(a, b, c);
+	}
+
+	CPUSKINNER_TARGET_AVX2 inline float HorizontalMin8(__m256 v)
+	{
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, v);
+		float m = lanes[0];
+		for(int i = 1; i < 8; ++i)
+			m = MathHelper::Min(m, lanes[i]);
+		return m;
+	}
+
+	CPUSKINNER_TARGET_AVX2 inline float HorizontalMax8(__m256 v)
+	{
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, v);
+		float m = lanes[0];
+		for(int i = 1; i < 8; ++i)
+			m = MathHelper::Max(m, lanes[i]);
+		return m;
+	}
+
+	// Writes 8 SoA lanes out as XMFLOAT3s.
+	CPUSKINNER_TARGET_AVX2 inline void StoreFloat3x8(XMFLOAT3* dst, __m256 x, __m256 y, __m256 z)
+	{
+		alignas(32) float lx[8], ly[8], lz[8];
+		_mm256_store_ps(lx, x);
+		_mm256_store_ps(ly, y);
+		_mm256_store_ps(lz, z);
+		for(int i = 0; i < 8; ++i)
+			dst[i] = XMFLOAT3(lx[i], ly[i], lz[i]);
+	}
+
+	// v' = v + 2*cross(r, cross(r, v) + rw*v), eight vertices at a time.
+	CPUSKINNER_TARGET_AVX2 inline void Rotate8(__m256 rx, __m256 ry, __m256 rz, __m256 rw,
+		__m256 vx, __m256 vy, __m256 vz, __m256& ox, __m256& oy, __m256& oz)
+	{
+		const __m256 two = _mm256_set1_ps(2.0f);
+		__m256 cx = Madd8(rw, vx, _mm256_sub_ps(_mm256_mul_ps(ry, vz), _mm256_mul_ps(rz, vy)));
+		__m256 cy = Madd8(rw, vy, _mm256_sub_ps(_mm256_mul_ps(rz, vx), _mm256_mul_ps(rx, vz)));
+		__m256 cz = Madd8(rw, vz, _mm256_sub_ps(_mm256_mul_ps(rx, vy), _mm256_mul_ps(ry, vx)));
+		ox = Madd8(two, _mm256_sub_ps(_mm256_mul_ps(ry, cz), _mm256_mul_ps(rz, cy)), vx);
+		oy = Madd8(two, _mm256_sub_ps(_mm256_mul_ps(rz, cx), _mm256_mul_ps(rx, cz)), vy);
+		oz = Madd8(two, _mm256_sub_ps(_mm256_mul_ps(rx, cy), _mm256_mul_ps(ry, cx)), vz);
+	}
+#endif
+
+	// v + 2*cross(r, cross(r, v) + w*v), i.e. v rotated by the unit quaternion (r, w).
+	inline XMVECTOR XM_CALLCONV RotateByQuat(FXMVECTOR v, FXMVECTOR q)
+	{
+		XMVECTOR w = XMVectorSplatW(q);
+		XMVECTOR c = XMVectorMultiplyAdd(w, v, XMVector3Cross(q, v));
+		return XMVectorAdd(v, XMVectorScale(XMVector3Cross(q, c), 2.0f));
+	}
+}
+
+CpuSkinner::CpuSkinner(ThreadPool* pool)
+{
+	mPool = pool != nullptr ? pool : &ThreadPool::Default();
+}
+
+bool CpuSkinner::HasAVX2()
+{
+#if defined(CPUSKINNER_AVX2)
+	return gUseAVX2;
+#else
+	return false;
+#endif
+}
+
+void CpuSkinner::SetBindPose(
+	const std::vector<M3DLoader::SkinnedVertex>& vertices,
+	const std::vector<USHORT>& indices,
+	const std::vector<M3DLoader::Subset>& subsets)
+{
+	const UINT vertexCount = (UINT)vertices.size();
+
+	mPos.Resize(vertexCount);
+	mNormal.Resize(vertexCount);
+	mTangent.Resize(vertexCount);
+	for(int k = 0; k < 4; ++k)
+	{
+		mWeights[k].resize(vertexCount);
+		mBoneIndices[k].resize(vertexCount);
+	}
+
+	for(UINT i = 0; i < vertexCount; ++i)
+	{
+		const auto& v = vertices[i];
+
+		mPos.X[i] = v.Pos.x;
+		mPos.Y[i] = v.Pos.y;
+		mPos.Z[i] = v.Pos.z;
+		mNormal.X[i] = v.Normal.x;
+		mNormal.Y[i] = v.Normal.y;
+		mNormal.Z[i] = v.Normal.z;
+		mTangent.X[i] = v.TangentU.x;
+		mTangent.Y[i] = v.TangentU.y;
+		mTangent.Z[i] = v.TangentU.z;
+
+		// Same as the vertex shader: the fourth weight is implied.
+		mWeights[0][i] = v.BoneWeights.x;
+		mWeights[1][i] = v.BoneWeights.y;
+		mWeights[2][i] = v.BoneWeights.z;
+		mWeights[3][i] = 1.0f - v.BoneWeights.x - v.BoneWeights.y - v.BoneWeights.z;
+
+		for(int k = 0; k < 4; ++k)
+			mBoneIndices[k][i] = v.BoneIndices[k];
+	}
+
+	mIndices = indices;
+	mSubsets = subsets;
+	if(mSubsets.empty())
+	{
+		M3DLoader::Subset all;
+		all.Id = 0;
+		all.VertexCount = vertexCount;
+		all.FaceCount = (UINT)indices.size() / 3;
+		mSubsets.push_back(all);
+	}
+
+	// Split every subset into ranges so each range contributes to exactly one subset box.
+	mRanges.clear();
+	for(UINT s = 0; s < (UINT)mSubsets.size(); ++s)
+	{
+		UINT begin = mSubsets[s].VertexStart;
+		UINT end = MathHelper::Min(begin + mSubsets[s].VertexCount, vertexCount);
+		for(UINT first = begin; first < end; first += VerticesPerRange)
+		{
+			VertexRange range;
+			range.Subset = s;
+			range.Begin = first;
+			range.End = MathHelper::Min(first + VerticesPerRange, end);
+			mRanges.push_back(range);
+		}
+	}
+
+	mSkinnedPos.resize(vertexCount);
+	mSkinnedNormal.resize(vertexCount);
+	mSkinnedTangent.resize(vertexCount);
+	mSubsetBounds.assign(mSubsets.size(), BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f)));
+}
+
+void CpuSkinner::Skin(const std::vector<XMFLOAT4X4>& boneTransforms, Method method)
+{
+	if(method == Method::LinearBlend)
+		BuildLinearPalette(boneTransforms);
+	else
+		BuildDualQuatPalette(boneTransforms);
+
+	mPool->ParallelFor((uint32_t)mRanges.size(), [this, method](uint32_t r)
+	{
+		if(method == Method::LinearBlend)
+			SkinRangeLinear(mRanges[r]);
+		else
+			SkinRangeDualQuat(mRanges[r]);
+	});
+
+	// Reduce the per-range extents into subset bounds.
+	std::vector<XMVECTOR> subsetMin(mSubsets.size(), XMVectorReplicate(+MathHelper::Infinity));
+	std::vector<XMVECTOR> subsetMax(mSubsets.size(), XMVectorReplicate(-MathHelper::Infinity));
+	for(const auto& range : mRanges)
+	{
+		subsetMin[range.Subset] = XMVectorMin(subsetMin[range.Subset], XMLoadFloat3(&range.Min));
+		subsetMax[range.Subset] = XMVectorMax(subsetMax[range.Subset], XMLoadFloat3(&range.Max));
+	}
+
+	for(UINT s = 0; s < (UINT)mSubsets.size(); ++s)
+	{
+		// Subsets without vertices keep an empty box.
+		if(XMVector3Greater(subsetMin[s], subsetMax[s]))
+			continue;
+
+		BoundingBox::CreateFromPoints(mSubsetBounds[s], subsetMin[s], subsetMax[s]);
+	}
+}
+
+bool CpuSkinner::Intersects(FXMVECTOR rayOrigin, FXMVECTOR rayDir,
+	float& tmin, UINT& subsetIndex, UINT& triangleIndex)const
+{
+	bool hit = false;
+	tmin = MathHelper::Infinity;
+
+	for(UINT s = 0; s < (UINT)mSubsets.size(); ++s)
+	{
+		float tbox = 0.0f;
+		if(!mSubsetBounds[s].Intersects(rayOrigin, rayDir, tbox) || tbox > tmin)
+			continue;
+
+		const UINT faceEnd = mSubsets[s].FaceStart + mSubsets[s].FaceCount;
+		for(UINT f = mSubsets[s].FaceStart; f < faceEnd; ++f)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&mSkinnedPos[mIndices[f*3 + 0]]);
+			XMVECTOR v1 = XMLoadFloat3(&mSkinnedPos[mIndices[f*3 + 1]]);
+			XMVECTOR v2 = XMLoadFloat3(&mSkinnedPos[mIndices[f*3 + 2]]);
+
+			float t = 0.0f;
+			if(TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t) && t < tmin)
+			{
+				tmin = t;
+				subsetIndex = s;
+				triangleIndex = f;
+				hit = true;
+			}
+		}
+	}
+
+	return hit;
+}
+
+void CpuSkinner::BuildLinearPalette(const std::vector<XMFLOAT4X4>& boneTransforms)
+{
+	// The palette is already transposed for the shader, so its first three rows
+	// dotted with (x, y, z, 1) give the skinned x, y and z.
+	mPalette.resize(boneTransforms.size() * 3);
+	for(size_t b = 0; b < boneTransforms.size(); ++b)
+	{
+		const XMFLOAT4X4& M = boneTransforms[b];
+		mPalette[b*3 + 0] = XMFLOAT4(M._11, M._12, M._13, M._14);
+		mPalette[b*3 + 1] = XMFLOAT4(M._21, M._22, M._23, M._24);
+		mPalette[b*3 + 2] = XMFLOAT4(M._31, M._32, M._33, M._34);
+	}
+}
+
+void CpuSkinner::BuildDualQuatPalette(const std::vector<XMFLOAT4X4>& boneTransforms)
+{
+	mPalette.resize(boneTransforms.size() * 2);
+	for(size_t b = 0; b < boneTransforms.size(); ++b)
+	{
+		XMMATRIX M = XMMatrixTranspose(XMLoadFloat4x4(&boneTransforms[b]));
+
+		// Dual quaternions only carry rotation and translation, so strip scale first.
+		XMMATRIX R = M;
+		R.r[0] = XMVector3Normalize(M.r[0]);
+		R.r[1] = XMVector3Normalize(M.r[1]);
+		R.r[2] = XMVector3Normalize(M.r[2]);
+		R.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+		XMVECTOR real = XMQuaternionNormalize(XMQuaternionRotationMatrix(R));
+
+		// dual = 0.5 * t * real.  Note XMQuaternionMultiply(a, b) returns b*a.
+		XMVECTOR t = XMVectorSetW(M.r[3], 0.0f);
+		XMVECTOR dual = XMVectorScale(XMQuaternionMultiply(real, t), 0.5f);
+
+		XMStoreFloat4(&mPalette[b*2 + 0], real);
+		XMStoreFloat4(&mPalette[b*2 + 1], dual);
+	}
+}
+
+void CpuSkinner::SkinRangeLinear(VertexRange& range)
+{
+	UINT i = range.Begin;
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+#if defined(CPUSKINNER_AVX2)
+	if(gUseAVX2 && mEnableAVX2)
+	{
+		i = SkinRangeLinearAVX2(range);
+		vMin = XMLoadFloat3(&range.Min);
+		vMax = XMLoadFloat3(&range.Max);
+	}
+#endif
+
+	const XMVECTOR rowW = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+
+	for(; i < range.End; ++i)
+	{
+		XMVECTOR r0 = XMVectorZero();
+		XMVECTOR r1 = XMVectorZero();
+		XMVECTOR r2 = XMVectorZero();
+		for(int k = 0; k < 4; ++k)
+		{
+			XMVECTOR w = XMVectorReplicate(mWeights[k][i]);
+			const XMFLOAT4* bone = &mPalette[mBoneIndices[k][i] * 3];
+			r0 = XMVectorMultiplyAdd(w, XMLoadFloat4(&bone[0]), r0);
+			r1 = XMVectorMultiplyAdd(w, XMLoadFloat4(&bone[1]), r1);
+			r2 = XMVectorMultiplyAdd(w, XMLoadFloat4(&bone[2]), r2);
+		}
+
+		// Back to the row-vector convention used by XMVector3Transform.
+		XMMATRIX M = XMMatrixTranspose(XMMATRIX(r0, r1, r2, rowW));
+
+		XMVECTOR p = XMVector3Transform(XMVectorSet(mPos.X[i], mPos.Y[i], mPos.Z[i], 1.0f), M);
+		XMVECTOR n = XMVector3TransformNormal(XMVectorSet(mNormal.X[i], mNormal.Y[i], mNormal.Z[i], 0.0f), M);
+		XMVECTOR t = XMVector3TransformNormal(XMVectorSet(mTangent.X[i], mTangent.Y[i], mTangent.Z[i], 0.0f), M);
+
+		XMStoreFloat3(&mSkinnedPos[i], p);
+		XMStoreFloat3(&mSkinnedNormal[i], n);
+		XMStoreFloat3(&mSkinnedTangent[i], t);
+
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	XMStoreFloat3(&range.Min, vMin);
+	XMStoreFloat3(&range.Max, vMax);
+}
+
+void CpuSkinner::SkinRangeDualQuat(VertexRange& range)
+{
+	UINT i = range.Begin;
+	XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+	XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+
+#if defined(CPUSKINNER_AVX2)
+	if(gUseAVX2 && mEnableAVX2)
+	{
+		i = SkinRangeDualQuatAVX2(range);
+		vMin = XMLoadFloat3(&range.Min);
+		vMax = XMLoadFloat3(&range.Max);
+	}
+#endif
+
+	for(; i < range.End; ++i)
+	{
+		XMVECTOR pivot = XMLoadFloat4(&mPalette[mBoneIndices[0][i] * 2]);
+
+		XMVECTOR real = XMVectorZero();
+		XMVECTOR dual = XMVectorZero();
+		for(int k = 0; k < 4; ++k)
+		{
+			const XMFLOAT4* bone = &mPalette[mBoneIndices[k][i] * 2];
+			XMVECTOR qr = XMLoadFloat4(&bone[0]);
+			XMVECTOR qd = XMLoadFloat4(&bone[1]);
+
+			// Blend in the same hemisphere as the first influence.
+			float w = mWeights[k][i];
+			if(XMVectorGetX(XMVector4Dot(pivot, qr)) < 0.0f)
+				w = -w;
+
+			real = XMVectorMultiplyAdd(XMVectorReplicate(w), qr, real);
+			dual = XMVectorMultiplyAdd(XMVectorReplicate(w), qd, dual);
+		}
+
+		float lenSq = XMVectorGetX(XMVector4LengthSq(real));
+		if(lenSq > 0.0f)
+		{
+			float invLen = 1.0f / sqrtf(lenSq);
+			real = XMVectorScale(real, invLen);
+			dual = XMVectorScale(dual, invLen);
+		}
+		else
+		{
+			real = XMQuaternionIdentity();
+			dual = XMVectorZero();
+		}
+
+		// translation = 2*(w_r*d - w_d*r + cross(r, d))
+		XMVECTOR trans = XMVectorMultiply(XMVectorSplatW(real), dual);
+		trans = XMVectorNegativeMultiplySubtract(XMVectorSplatW(dual), real, trans);
+		trans = XMVectorScale(XMVectorAdd(trans, XMVector3Cross(real, dual)), 2.0f);
+
+		XMVECTOR p = RotateByQuat(XMVectorSet(mPos.X[i], mPos.Y[i], mPos.Z[i], 0.0f), real);
+		p = XMVectorAdd(p, trans);
+		XMVECTOR n = RotateByQuat(XMVectorSet(mNormal.X[i], mNormal.Y[i], mNormal.Z[i], 0.0f), real);
+		XMVECTOR t = RotateByQuat(XMVectorSet(mTangent.X[i], mTangent.Y[i], mTangent.Z[i], 0.0f), real);
+
+		XMStoreFloat3(&mSkinnedPos[i], p);
+		XMStoreFloat3(&mSkinnedNormal[i], n);
+		XMStoreFloat3(&mSkinnedTangent[i], t);
+
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	XMStoreFloat3(&range.Min, vMin);
+	XMStoreFloat3(&range.Max, vMax);
+}
+
+#if defined(CPUSKINNER_AVX2)
+
+CPUSKINNER_TARGET_AVX2 UINT CpuSkinner::SkinRangeLinearAVX2(VertexRange& range)
+{
+	const float* palette = &mPalette[0].x;
+
+	__m256 minX = _mm256_set1_ps(+MathHelper::Infinity);
+	__m256 minY = minX, minZ = minX;
+	__m256 maxX = _mm256_set1_ps(-MathHelper::Infinity);
+	__m256 maxY = maxX, maxZ = maxX;
+
+	UINT i = range.Begin;
+	for(; i + 8 <= range.End; i += 8)
+	{
+		// Blended 3x4 matrix, one register per element, eight vertices per register.
+		__m256 m[12];
+		for(int e = 0; e < 12; ++e)
+			m[e] = _mm256_setzero_ps();
+
+		for(int k = 0; k < 4; ++k)
+		{
+			__m256 w = _mm256_loadu_ps(&mWeights[k][i]);
+			__m256i bone = _mm256_loadu_si256((const __m256i*)&mBoneIndices[k][i]);
+			__m256i base = _mm256_mullo_epi32(bone, _mm256_set1_epi32(12));
+			for(int e = 0; e < 12; ++e)
+			{
+				__m256 v = _mm256_i32gather_ps(palette, _mm256_add_epi32(base, _mm256_set1_epi32(e)), 4);
+				m[e] = Madd8(w, v, m[e]);
+			}
+		}
+
+		__m256 px = _mm256_loadu_ps(&mPos.X[i]);
+		__m256 py = _mm256_loadu_ps(&mPos.Y[i]);
+		__m256 pz = _mm256_loadu_ps(&mPos.Z[i]);
+		__m256 ox = Madd8(m[0], px, Madd8(m[1], py, Madd8(m[2], pz, m[3])));
+		__m256 oy = Madd8(m[4], px, Madd8(m[5], py, Madd8(m[6], pz, m[7])));
+		__m256 oz = Madd8(m[8], px, Madd8(m[9], py, Madd8(m[10], pz, m[11])));
+		StoreFloat3x8(&mSkinnedPos[i], ox, oy, oz);
+
+		minX = _mm256_min_ps(minX, ox); maxX = _mm256_max_ps(maxX, ox);
+		minY = _mm256_min_ps(minY, oy); maxY = _mm256_max_ps(maxY, oy);
+		minZ = _mm256_min_ps(minZ, oz); maxZ = _mm256_max_ps(maxZ, oz);
+
+		__m256 nx = _mm256_loadu_ps(&mNormal.X[i]);
+		__m256 ny = _mm256_loadu_ps(&mNormal.Y[i]);
+		__m256 nz = _mm256_loadu_ps(&mNormal.Z[i]);
+		StoreFloat3x8(&mSkinnedNormal[i],
+			Madd8(m[0], nx, Madd8(m[1], ny, _mm256_mul_ps(m[2], nz))),
+			Madd8(m[4], nx, Madd8(m[5], ny, _mm256_mul_ps(m[6], nz))),
+			Madd8(m[8], nx, Madd8(m[9], ny, _mm256_mul_ps(m[10], nz))));
+
+		__m256 tx = _mm256_loadu_ps(&mTangent.X[i]);
+		__m256 ty = _mm256_loadu_ps(&mTangent.Y[i]);
+		__m256 tz = _mm256_loadu_ps(&mTangent.Z[i]);
+		StoreFloat3x8(&mSkinnedTangent[i],
+			Madd8(m[0], tx, Madd8(m[1], ty, _mm256_mul_ps(m[2], tz))),
+			Madd8(m[4], tx, Madd8(m[5], ty, _mm256_mul_ps(m[6], tz))),
+			Madd8(m[8], tx, Madd8(m[9], ty, _mm256_mul_ps(m[10], tz))));
+	}
+
+	range.Min = XMFLOAT3(HorizontalMin8(minX), HorizontalMin8(minY), HorizontalMin8(minZ));
+	range.Max = XMFLOAT3(HorizontalMax8(maxX), HorizontalMax8(maxY), HorizontalMax8(maxZ));
+
+	return i;
+}
+
+CPUSKINNER_TARGET_AVX2 UINT CpuSkinner::SkinRangeDualQuatAVX2(VertexRange& range)
+{
+	const float* palette = &mPalette[0].x;
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+
+	__m256 minX = _mm256_set1_ps(+MathHelper::Infinity);
+	__m256 minY = minX, minZ = minX;
+	__m256 maxX = _mm256_set1_ps(-MathHelper::Infinity);
+	__m256 maxY = maxX, maxZ = maxX;
+
+	UINT i = range.Begin;
+	for(; i + 8 <= range.End; i += 8)
+	{
+		__m256i pivotBase = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)&mBoneIndices[0][i]), 3);
+		__m256 pivot[4];
+		for(int e = 0; e < 4; ++e)
+			pivot[e] = _mm256_i32gather_ps(palette, _mm256_add_epi32(pivotBase, _mm256_set1_epi32(e)), 4);
+
+		__m256 q[8];
+		for(int e = 0; e < 8; ++e)
+			q[e] = _mm256_setzero_ps();
+
+		for(int k = 0; k < 4; ++k)
+		{
+			__m256i base = _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)&mBoneIndices[k][i]), 3);
+			__m256 b[8];
+			for(int e = 0; e < 8; ++e)
+				b[e] = _mm256_i32gather_ps(palette, _mm256_add_epi32(base, _mm256_set1_epi32(e)), 4);
+
+			// Flip the weight when the bone is in the opposite hemisphere of the first influence.
+			__m256 d = Madd8(pivot[0], b[0], Madd8(pivot[1], b[1], Madd8(pivot[2], b[2], _mm256_mul_ps(pivot[3], b[3]))));
+			__m256 w = _mm256_xor_ps(_mm256_loadu_ps(&mWeights[k][i]), _mm256_and_ps(d, signMask));
+
+			for(int e = 0; e < 8; ++e)
+				q[e] = Madd8(w, b[e], q[e]);
+		}
+
+		// Influences that cancel out leave a zero quaternion; those lanes get the identity,
+		// as in SkinRangeDualQuat.
+		__m256 lenSq = Madd8(q[0], q[0], Madd8(q[1], q[1], Madd8(q[2], q[2], _mm256_mul_ps(q[3], q[3]))));
+		__m256 valid = _mm256_cmp_ps(lenSq, _mm256_setzero_ps(), _CMP_GT_OQ);
+		__m256 invLen = _mm256_and_ps(valid, _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(lenSq)));
+		for(int e = 0; e < 8; ++e)
+			q[e] = _mm256_mul_ps(q[e], invLen);
+		q[3] = _mm256_blendv_ps(_mm256_set1_ps(1.0f), q[3], valid);
+
+		const __m256 rx = q[0], ry = q[1], rz = q[2], rw = q[3];
+		const __m256 dx = q[4], dy = q[5], dz = q[6], dw = q[7];
+
+		// translation = 2*(rw*d - dw*r + cross(r, d))
+		__m256 tx = _mm256_mul_ps(two, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(rw, dx), _mm256_mul_ps(dw, rx)),
+			_mm256_sub_ps(_mm256_mul_ps(ry, dz), _mm256_mul_ps(rz, dy))));
+		__m256 ty = _mm256_mul_ps(two, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(rw, dy), _mm256_mul_ps(dw, ry)),
+			_mm256_sub_ps(_mm256_mul_ps(rz, dx), _mm256_mul_ps(rx, dz))));
+		__m256 tz = _mm256_mul_ps(two, _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(rw, dz), _mm256_mul_ps(dw, rz)),
+			_mm256_sub_ps(_mm256_mul_ps(rx, dy), _mm256_mul_ps(ry, dx))));
+
+		__m256 ox, oy, oz;
+		Rotate8(rx, ry, rz, rw, _mm256_loadu_ps(&mPos.X[i]), _mm256_loadu_ps(&mPos.Y[i]), _mm256_loadu_ps(&mPos.Z[i]), ox, oy, oz);
+		ox = _mm256_add_ps(ox, tx);
+		oy = _mm256_add_ps(oy, ty);
+		oz = _mm256_add_ps(oz, tz);
+		StoreFloat3x8(&mSkinnedPos[i], ox, oy, oz);
+
+		minX = _mm256_min_ps(minX, ox); maxX = _mm256_max_ps(maxX, ox);
+		minY = _mm256_min_ps(minY, oy); maxY = _mm256_max_ps(maxY, oy);
+		minZ = _mm256_min_ps(minZ, oz); maxZ = _mm256_max_ps(maxZ, oz);
+
+		Rotate8(rx, ry, rz, rw, _mm256_loadu_ps(&mNormal.X[i]), _mm256_loadu_ps(&mNormal.Y[i]), _mm256_loadu_ps(&mNormal.Z[i]), ox, oy, oz);
+		StoreFloat3x8(&mSkinnedNormal[i], ox, oy, oz);
+
+		Rotate8(rx, ry, rz, rw, _mm256_loadu_ps(&mTangent.X[i]), _mm256_loadu_ps(&mTangent.Y[i]), _mm256_loadu_ps(&mTangent.Z[i]), ox, oy, oz);
+		StoreFloat3x8(&mSkinnedTangent[i], ox, oy, oz);
+	}
+
+	range.Min = XMFLOAT3(HorizontalMin8(minX), HorizontalMin8(minY), HorizontalMin8(minZ));
+	range.Max = XMFLOAT3(HorizontalMax8(maxX), HorizontalMax8(maxY), HorizontalMax8(maxZ));
+
+	return i;
+}
+
+#endif
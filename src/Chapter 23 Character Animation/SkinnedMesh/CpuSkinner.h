@@ -0,0 +1,136 @@
+#ifndef CPUSKINNER_H
+#define CPUSKINNER_H
+
+#include "LoadM3d.h"
+#include "../../Common/ThreadPool.h"
+#include <DirectXCollision.h>
+
+// The AVX2 kernels are built on x64 whatever the compiler switches and chosen at run time.
+#if defined(_M_X64) || defined(__x86_64__)
+#define CPUSKINNER_AVX2 1
+#endif
+
+///<summary>
+/// Skins a SkinnedVertex stream on the CPU with the same bone palette the
+/// vertex shader consumes, so picking, ray casts and culling bounds can use
+/// the animated pose instead of the bind pose.
+///
+/// The bind pose is stored structure-of-arrays and the vertices are split
+/// into fixed size ranges that are skinned in parallel.  Each range also
+/// accumulates its min/max, which are reduced into a refit AABB per subset;
+/// Intersects skips the subsets whose box the ray misses.
+///
+/// LinearBlend reproduces the SKINNED path of Default.hlsl exactly and can
+/// be used as a reference for it.  DualQuaternion blends rigid bone
+/// transforms as dual quaternions, which avoids the candy-wrapper collapse
+/// of linear blending; any scale in the bone transforms is ignored.
+///
+/// On x64 both methods also have an 8-wide AVX2 kernel.  The project does not
+/// build with /arch:AVX2, so the kernels are picked at run time when CPUID
+/// reports AVX2 and FMA, and the DirectXMath path runs everywhere else.
+///</summary>
+class CpuSkinner
+{
+public:
+    enum class Method
+    {
+        LinearBlend,
+        DualQuaternion
+    };
+
+    // pool defaults to ThreadPool::Default().
+    explicit CpuSkinner(ThreadPool* pool = nullptr);
+    CpuSkinner(const CpuSkinner& rhs) = delete;
+    CpuSkinner& operator=(const CpuSkinner& rhs) = delete;
+
+    // Whether this CPU runs the AVX2 kernels.
+    static bool HasAVX2();
+
+    // The AVX2 kernels are used when HasAVX2; false keeps to the DirectXMath path,
+    // which the kernels can then be checked against.
+    void EnableAVX2(bool enable) { mEnableAVX2 = enable; }
+
+    void SetBindPose(
+        const std::vector<M3DLoader::SkinnedVertex>& vertices,
+        const std::vector<USHORT>& indices,
+        const std::vector<M3DLoader::Subset>& subsets);
+
+    // boneTransforms is the palette produced by SkinnedData::GetFinalTransforms,
+    // which is stored transposed for the shader.
+    void Skin(const std::vector<DirectX::XMFLOAT4X4>& boneTransforms, Method method);
+
+    UINT VertexCount()const { return (UINT)mSkinnedPos.size(); }
+
+    const std::vector<DirectX::XMFLOAT3>& Positions()const { return mSkinnedPos; }
+    const std::vector<DirectX::XMFLOAT3>& Normals()const { return mSkinnedNormal; }
+    const std::vector<DirectX::XMFLOAT3>& Tangents()const { return mSkinnedTangent; }
+
+    // Bounds of each subset in the last skinned pose, in model space.
+    const std::vector<DirectX::BoundingBox>& SubsetBounds()const { return mSubsetBounds; }
+
+    // Finds the nearest triangle of the last skinned pose hit by a model space ray.
+    // rayDir must be unit length.
+    bool Intersects(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir,
+        float& tmin, UINT& subsetIndex, UINT& triangleIndex)const;
+
+private:
+    struct VertexRange
+    {
+        UINT Subset = 0;
+        UINT Begin = 0;
+        UINT End = 0;
+
+        // Written by the worker that skins this range.
+        DirectX::XMFLOAT3 Min;
+        DirectX::XMFLOAT3 Max;
+    };
+
+    struct Stream
+    {
+        std::vector<float> X;
+        std::vector<float> Y;
+        std::vector<float> Z;
+
+        void Resize(size_t n) { X.resize(n); Y.resize(n); Z.resize(n); }
+    };
+
+    void BuildLinearPalette(const std::vector<DirectX::XMFLOAT4X4>& boneTransforms);
+    void BuildDualQuatPalette(const std::vector<DirectX::XMFLOAT4X4>& boneTransforms);
+
+    void SkinRangeLinear(VertexRange& range);
+    void SkinRangeDualQuat(VertexRange& range);
+
+#if defined(CPUSKINNER_AVX2)
+    UINT SkinRangeLinearAVX2(VertexRange& range);
+    UINT SkinRangeDualQuatAVX2(VertexRange& range);
+#endif
+
+private:
+    static const UINT VerticesPerRange = 2048;
+
+    ThreadPool* mPool = nullptr;
+    bool mEnableAVX2 = true;
+
+    // Bind pose, structure-of-arrays.
+    Stream mPos;
+    Stream mNormal;
+    Stream mTangent;
+    std::vector<float> mWeights[4];
+    std::vector<int> mBoneIndices[4];
+
+    std::vector<USHORT> mIndices;
+    std::vector<M3DLoader::Subset> mSubsets;
+    std::vector<VertexRange> mRanges;
+
+    // LinearBlend: three rows (x, y, z outputs) per bone.
+    // DualQuaternion: real and dual part per bone.
+    std::vector<DirectX::XMFLOAT4> mPalette;
+
+    std::vector<DirectX::XMFLOAT3> mSkinnedPos;
+    std::vector<DirectX::XMFLOAT3> mSkinnedNormal;
+    std::vector<DirectX::XMFLOAT3> mSkinnedTangent;
+
+    std::vector<DirectX::BoundingBox> mSubsetBounds;
+};
+
+#endif // CPUSKINNER_H
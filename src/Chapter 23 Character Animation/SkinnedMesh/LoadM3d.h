@@ -2,6 +2,7 @@
 #define LOADM3D_H
 
 #include "SkinnedData.h"
+#include <fstream>
 
 
 
@@ -1,8 +1,10 @@
 #ifndef SKINNEDDATA_H
 #define SKINNEDDATA_H
 
-#include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 ///<summary>
 /// A Keyframe defines the bone transformation at an instant in time.
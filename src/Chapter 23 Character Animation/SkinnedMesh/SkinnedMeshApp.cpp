@@ -12,6 +12,7 @@
 #include "Ssao.h"
 #include "SkinnedData.h"
 #include "LoadM3d.h"
+#include "CpuSkinner.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -137,6 +138,7 @@ private:
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
     void DrawSceneToShadowMap();
 	void DrawNormalsAndDepth();
+    void PickSkinnedModel(int sx, int sy);
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuSrv(int index)const;
     CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuSrv(int index)const;
@@ -193,6 +195,9 @@ private:
     std::vector<M3DLoader::M3dMaterial> mSkinnedMats;
     std::vector<std::string> mSkinnedTextureNames;
 
+    // CPU copy of the animated pose, skinned when a pick needs it.
+    CpuSkinner mCpuSkinner;
+
 	Camera mCamera;
 
     std::unique_ptr<ShadowMap> mShadowMap;
@@ -512,6 +517,12 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
 
 void SkinnedMeshApp::OnMouseDown(WPARAM btnState, int x, int y)
 {
+    if((btnState & MK_RBUTTON) != 0)
+    {
+        PickSkinnedModel(x, y);
+        return;
+    }
+
     mLastMousePos.x = x;
     mLastMousePos.y = y;
 
@@ -1288,6 +1299,8 @@ void SkinnedMeshApp::LoadSkinnedModel()
     mSkinnedModelInst->FinalTransforms.resize(mSkinnedInfo.BoneCount());
     mSkinnedModelInst->ClipName = "Take1";
     mSkinnedModelInst->TimePos = 0.0f;
+
+    mCpuSkinner.SetBindPose(vertices, indices, mSkinnedSubsets);
  
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(SkinnedVertex);
     const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
@@ -1862,6 +1875,49 @@ void SkinnedMeshApp::DrawNormalsAndDepth()
     mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
         D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
 }
+
+void SkinnedMeshApp::PickSkinnedModel(int sx, int sy)
+{
+    if(mRitemLayer[(int)RenderLayer::SkinnedOpaque].empty())
+        return;
+
+    XMFLOAT4X4 P = mCamera.GetProj4x4f();
+
+    // Compute picking ray in view space.
+    float vx = (+2.0f*sx / mClientWidth - 1.0f) / P(0, 0);
+    float vy = (-2.0f*sy / mClientHeight + 1.0f) / P(1, 1);
+
+    XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+    XMVECTOR rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
+
+    // All the soldier render items share one world matrix.
+    XMMATRIX V = mCamera.GetView();
+    XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
+    XMMATRIX W = XMLoadFloat4x4(&mRitemLayer[(int)RenderLayer::SkinnedOpaque][0]->World);
+    XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
+    XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+
+    rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
+    rayDir = XMVector3Normalize(XMVector3TransformNormal(rayDir, toLocal));
+
+    // Test against the animated pose rather than the bind pose in the vertex buffer.
+    // Only picking needs it, so the pose last sent to the vertex shader is skinned here
+    // instead of every frame.
+    mCpuSkinner.Skin(mSkinnedModelInst->FinalTransforms, CpuSkinner::Method::LinearBlend);
+
+    float tmin = 0.0f;
+    UINT subset = 0;
+    UINT triangle = 0;
+    // The frame stats put the caption in the title bar, so the pick shows there.
+    if(mCpuSkinner.Intersects(rayOrigin, rayDir, tmin, subset, triangle))
+    {
+        mMainWndCaption = L"Skinned Mesh Demo    picked " + AnsiToWString(mSkinnedMats[subset].Name) +
+            L" triangle " + std::to_wstring(triangle);
+    }
+    else
+        mMainWndCaption = L"Skinned Mesh Demo    nothing picked";
+}
+
 CD3DX12_CPU_DESCRIPTOR_HANDLE SkinnedMeshApp::GetCpuSrv(int index)const
 {
     auto srv = CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
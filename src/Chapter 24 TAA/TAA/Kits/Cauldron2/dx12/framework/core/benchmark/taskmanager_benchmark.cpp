@@ -0,0 +1,306 @@
+// This file is part of the FidelityFX SDK.
+//
+// Copyright (C) 2025 Advanced Micro Devices, Inc.
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files(the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Scaling benchmark for cauldron::TaskManager. For 1, 2, 4, ... worker threads it times:
+//
+//  - Fan-out: a task adds many small tasks with one TaskCompletionCallback, the way the glTF
+//    loader adds its buffer and texture loads, against the single locked queue TaskManager
+//    used before work stealing (LegacyTaskManager below).
+//  - ParallelFor over a large array, against a serial loop.
+//  - A layered TaskGraph in which every node depends on two nodes of the layer before.
+//
+// Every run checks its results and the program prints PASSED or FAILED and returns non-zero
+// on failure.
+
+#include "../taskmanager.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using namespace cauldron;
+
+namespace
+{
+    const uint32_t FanOutTaskCount      = 20000;
+    const uint32_t FanOutTaskWork       = 200;      // Work() iterations per fan-out task, about a microsecond
+    const uint32_t ParallelForCount     = 1 << 24;
+    const uint32_t GraphLayerCount      = 32;
+    const uint32_t GraphLayerWidth      = 256;
+    const uint32_t GraphNodeWork        = 2000;
+    const int      RunCount             = 5;        // Best of this many runs is reported
+
+    // The TaskManager before work stealing: one queue behind one lock.
+    class LegacyTaskManager
+    {
+    public:
+        void Init(uint32_t threadPoolSize)
+        {
+            for (uint32_t i = 0; i < threadPoolSize; ++i)
+                m_ThreadPool.emplace_back([this]() { TaskExecutor(); });
+        }
+
+        void Shutdown()
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_CriticalSection);
+                m_ShuttingDown = true;
+                m_QueueCondition.notify_all();
+            }
+
+            for (auto& thread : m_ThreadPool)
+                thread.join();
+            m_ThreadPool.clear();
+        }
+
+        void AddTask(Task& newTask)
+        {
+            std::unique_lock<std::mutex> lock(m_CriticalSection);
+            m_TaskQueue.push(std::move(newTask));
+            m_QueueCondition.notify_one();
+        }
+
+        void AddTaskList(std::queue<Task>& newTaskList)
+        {
+            std::unique_lock<std::mutex> lock(m_CriticalSection);
+            while (newTaskList.size())
+            {
+                m_TaskQueue.push(std::move(newTaskList.front()));
+                newTaskList.pop();
+            }
+            m_QueueCondition.notify_all();
+        }
+
+    private:
+        void TaskExecutor()
+        {
+            while (true)
+            {
+                TaskFunc                pTaskFunction;
+                void*                   pTaskParam;
+                TaskCompletionCallback* pCompletionCallback;
+                {
+                    std::unique_lock<std::mutex> lock(m_CriticalSection);
+                    m_QueueCondition.wait(lock, [this] { return !m_TaskQueue.empty() || m_ShuttingDown; });
+                    if (m_ShuttingDown)
+                        break;
+
+                    pTaskFunction       = m_TaskQueue.front().pTaskFunction;
+                    pTaskParam          = m_TaskQueue.front().pTaskParam;
+                    pCompletionCallback = m_TaskQueue.front().pTaskCompletionCallback;
+                    m_TaskQueue.pop();
+                }
+
+                while (pTaskFunction)
+                {
+                    pTaskFunction(pTaskParam);
+                    if (!pCompletionCallback || --pCompletionCallback->TaskCount != 0)
+                        break;
+
+                    TaskCompletionCallback* pDone = pCompletionCallback;
+                    pTaskFunction       = pDone->CompletionTask.pTaskFunction;
+                    pTaskParam          = pDone->CompletionTask.pTaskParam;
+                    pCompletionCallback = pDone->CompletionTask.pTaskCompletionCallback;
+                    delete pDone;
+                }
+            }
+        }
+
+        bool                        m_ShuttingDown = false;
+        std::vector<std::thread>    m_ThreadPool;
+        std::queue<Task>            m_TaskQueue;
+        std::mutex                  m_CriticalSection;
+        std::condition_variable     m_QueueCondition;
+    };
+
+    // A few hundred nanoseconds of dependent arithmetic per 100 iterations.
+    float Work(uint32_t seed, uint32_t iterations)
+    {
+        float value = static_cast<float>(seed & 1023) * 0.001f;
+        for (uint32_t i = 0; i < iterations; ++i)
+            value = value * 0.999f + std::sqrt(value + 1.0f) * 0.001f;
+        return value;
+    }
+
+    double Seconds(const std::function<void()>& work)
+    {
+        double best = 1e30;
+        for (int run = 0; run < RunCount; ++run)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            work();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    // Shared by the fan-out runs of both managers.
+    struct FanOut
+    {
+        std::vector<float>  Results = std::vector<float>(FanOutTaskCount);
+        std::atomic_bool    Done = { false };
+
+        template<typename Manager>
+        void Spawn(Manager* pManager)
+        {
+            // Like the glTF loader: the fan-out is added from a task running on the pool
+            Done.store(false);
+            Task spawnTask([this, pManager](void*)
+            {
+                TaskCompletionCallback* pCallback = new TaskCompletionCallback(Task([this](void*) { Done.store(true); }), FanOutTaskCount);
+                std::queue<Task> taskList;
+                for (uint32_t i = 0; i < FanOutTaskCount; ++i)
+                    taskList.push(Task([this, i](void*) { Results[i] = Work(i, FanOutTaskWork); }, nullptr, pCallback));
+                pManager->AddTaskList(taskList);
+            });
+            pManager->AddTask(spawnTask);
+
+            while (!Done.load())
+                std::this_thread::yield();
+        }
+
+        bool Check() const
+        {
+            for (uint32_t i = 0; i < FanOutTaskCount; ++i)
+            {
+                if (Results[i] != Work(i, FanOutTaskWork))
+                    return false;
+            }
+            return true;
+        }
+    };
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 1)
+        maxThreads = std::max(1, std::atoi(argv[1]));
+
+    std::vector<float> data(ParallelForCount);
+    for (uint32_t i = 0; i < ParallelForCount; ++i)
+        data[i] = static_cast<float>(i % 4096);
+
+    // Reference results
+    std::vector<float> serialOutput(ParallelForCount);
+    double serialTime = Seconds([&]()
+    {
+        for (uint32_t i = 0; i < ParallelForCount; ++i)
+            serialOutput[i] = std::sqrt(data[i]) * 0.5f + data[i] * 0.25f;
+    });
+
+    std::vector<float> graphReference(GraphLayerCount * GraphLayerWidth);
+    for (uint32_t layer = 0; layer < GraphLayerCount; ++layer)
+    {
+        for (uint32_t i = 0; i < GraphLayerWidth; ++i)
+        {
+            float input = layer ? graphReference[(layer - 1) * GraphLayerWidth + i] + graphReference[(layer - 1) * GraphLayerWidth + (i + 1) % GraphLayerWidth] : 1.0f;
+            graphReference[layer * GraphLayerWidth + i] = Work(static_cast<uint32_t>(input), GraphNodeWork) + input * 0.5f;
+        }
+    }
+
+    bool pass = true;
+
+    std::printf("--- TaskManager scaling benchmark ---\n");
+    std::printf("Fan-out: %u tasks of %u iterations, one completion callback\n", FanOutTaskCount, FanOutTaskWork);
+    std::printf("ParallelFor: %u elements, serial %.3f ms\n", ParallelForCount, serialTime * 1000.0);
+    std::printf("Graph: %u layers of %u nodes, two dependencies each\n\n", GraphLayerCount, GraphLayerWidth);
+    std::printf("threads  fan-out legacy  fan-out stealing  ParallelFor  speedup  graph\n");
+
+    for (uint32_t threadCount = 1; ; threadCount = std::min(threadCount * 2, maxThreads))
+    {
+        // The calling thread takes part in ParallelFor and graph waits, so threadCount - 1 workers
+        // make threadCount threads there, as the framework does with the main thread.
+        FanOut legacyFanOut;
+        LegacyTaskManager legacy;
+        legacy.Init(threadCount);
+        double legacyTime = Seconds([&]() { legacyFanOut.Spawn(&legacy); });
+        legacy.Shutdown();
+
+        TaskManager taskManager;
+        taskManager.Init(threadCount);
+
+        FanOut fanOut;
+        double fanOutTime = Seconds([&]() { fanOut.Spawn(&taskManager); });
+        taskManager.Shutdown();
+
+        TaskManager helpingManager;
+        helpingManager.Init(threadCount - 1);
+
+        std::vector<float> output(ParallelForCount);
+        double parallelForTime = Seconds([&]()
+        {
+            helpingManager.ParallelFor(0, ParallelForCount, [&](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                    output[i] = std::sqrt(data[i]) * 0.5f + data[i] * 0.25f;
+            });
+        });
+
+        std::vector<float> graphOutput(GraphLayerCount * GraphLayerWidth);
+        double graphTime = Seconds([&]()
+        {
+            std::fill(graphOutput.begin(), graphOutput.end(), 0.0f);
+
+            TaskGraph graph(&helpingManager);
+            for (uint32_t layer = 0; layer < GraphLayerCount; ++layer)
+            {
+                for (uint32_t i = 0; i < GraphLayerWidth; ++i)
+                {
+                    graph.AddNode(Task([&graphOutput, layer, i](void*)
+                    {
+                        // Reads the two nodes this one depends on, so a missed edge shows up as a wrong result
+                        float input = layer ? graphOutput[(layer - 1) * GraphLayerWidth + i] + graphOutput[(layer - 1) * GraphLayerWidth + (i + 1) % GraphLayerWidth] : 1.0f;
+                        graphOutput[layer * GraphLayerWidth + i] = Work(static_cast<uint32_t>(input), GraphNodeWork) + input * 0.5f;
+                    }), TaskPriority::FrameCritical);
+
+                    if (layer)
+                    {
+                        graph.AddDependency((layer - 1) * GraphLayerWidth + i, layer * GraphLayerWidth + i);
+                        graph.AddDependency((layer - 1) * GraphLayerWidth + (i + 1) % GraphLayerWidth, layer * GraphLayerWidth + i);
+                    }
+                }
+            }
+            graph.Submit();
+            graph.Wait();
+        });
+
+        helpingManager.Shutdown();
+
+        bool runPass = legacyFanOut.Check() && fanOut.Check() && output == serialOutput && graphOutput == graphReference;
+        pass = pass && runPass;
+
+        std::printf("%7u  %11.3f ms  %13.3f ms  %8.3f ms  %6.2fx  %6.3f ms%s\n", threadCount,
+            legacyTime * 1000.0, fanOutTime * 1000.0, parallelForTime * 1000.0, serialTime / parallelForTime, graphTime * 1000.0,
+            runPass ? "" : "  FAILED");
+
+        if (threadCount == maxThreads)
+            break;
+    }
+
+    std::printf("%s\n", pass ? "PASSED" : "FAILED");
+    return pass ? 0 : 1;
+}
@@ -718,6 +718,9 @@ namespace cauldron
             }
         }
 
+        // Before shutting down, ensure no loading is going on in the background, as it can hang
+        while (GetContentManager()->IsCurrentlyLoading()) {}
+
         // Terminate the task manager
         m_pTaskManager->Shutdown();
 
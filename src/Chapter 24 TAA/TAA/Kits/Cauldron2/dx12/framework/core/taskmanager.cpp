@@ -21,115 +21,664 @@
 // THE SOFTWARE.
 
 #include "taskmanager.h"
-#include "contentmanager.h"
-#include "framework.h"
-#include "../misc/assert.h"
 
-#include <functional>
+#include <algorithm>
+#include <cassert>
 
 namespace cauldron
 {
+    static const uint32_t PriorityCount      = static_cast<uint32_t>(TaskPriority::Count);
+    static const uint32_t JobBlockSize       = 256;     // Jobs allocated at once when the pool runs dry
+    static const uint32_t LocalJobBatchSize  = 64;      // Jobs a worker moves between its free list and the shared pool at once
+    static const uint32_t ChunksPerThread    = 8;       // Default ParallelFor grain is the range over this many chunks per thread
+    static const uint32_t IdleSpinCount      = 64;      // Failed searches for work before a worker sleeps
+
+    // State of one ParallelFor call, on the calling thread's stack
+    struct ParallelForState
+    {
+        const RangeFunc*        pRangeFunction = nullptr;
+        uint32_t                ChunkSize = 1;
+        std::atomic_uint32_t    RemainingCount = { 0 };     // Iterations not yet run
+    };
+
+    // Everything the scheduler runs: a Task, a TaskGraph node or a ParallelFor range. Jobs are pooled and
+    // only ever freed with the task manager.
+    struct TaskJob
+    {
+        TaskFunc                pTaskFunction = nullptr;
+        void*                   pTaskParam = nullptr;
+        TaskCompletionCallback* pTaskCompletionCallback = nullptr;
+        TaskPriority            Priority = TaskPriority::Streaming;
+
+        // Graph nodes
+        TaskGraph*              pGraph = nullptr;
+        std::atomic_uint32_t    PendingDependencies = { 0 };
+        std::vector<TaskJob*>   Successors = {};
+
+        // ParallelFor ranges
+        ParallelForState*       pParallelFor = nullptr;
+        uint32_t                RangeBegin = 0;
+        uint32_t                RangeEnd = 0;
+
+        TaskJob*                pNextFree = nullptr;
+    };
+
+    namespace
+    {
+        // Chase-Lev work-stealing deque, with the memory orderings of Le et al., "Correct and Efficient
+        // Work-Stealing for Weak Memory Models". The owning worker pushes and pops at the bottom without
+        // locking; other threads steal from the top. The ring doubles when full, and replaced rings are
+        // kept until the deque is destroyed since a thief may still be reading one.
+        class WorkStealingDeque
+        {
+        public:
+            WorkStealingDeque()
+            {
+                m_Rings.emplace_back(new Ring(InitialCapacity));
+                m_pRing.store(m_Rings.back().get(), std::memory_order_relaxed);
+            }
+
+            // Owner only
+            void Push(TaskJob* pJob)
+            {
+                int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+                int64_t top    = m_Top.load(std::memory_order_acquire);
+                Ring*   pRing  = m_pRing.load(std::memory_order_relaxed);
+
+                if (bottom - top >= pRing->Capacity())
+                    pRing = Grow(pRing, top, bottom);
+
+                pRing->Put(bottom, pJob);
+                m_Bottom.store(bottom + 1, std::memory_order_release);
+            }
+
+            // Owner only
+            TaskJob* Pop()
+            {
+                int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+                Ring*   pRing  = m_pRing.load(std::memory_order_relaxed);
+                m_Bottom.store(bottom, std::memory_order_seq_cst);
+                int64_t top = m_Top.load(std::memory_order_seq_cst);
+
+                if (top > bottom)
+                {
+                    // Empty
+                    m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                TaskJob* pJob = pRing->Get(bottom);
+                if (top == bottom)
+                {
+                    // Last job, race the thieves for it
+                    if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                        pJob = nullptr;
+                    m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+                }
+                return pJob;
+            }
+
+            // Any thread. Returns nullptr when empty or when another thread won the job.
+            TaskJob* Steal()
+            {
+                int64_t top    = m_Top.load(std::memory_order_seq_cst);
+                int64_t bottom = m_Bottom.load(std::memory_order_seq_cst);
+                if (top >= bottom)
+                    return nullptr;
+
+                Ring*    pRing = m_pRing.load(std::memory_order_acquire);
+                TaskJob* pJob  = pRing->Get(top);
+                if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return nullptr;
+                return pJob;
+            }
+
+            // A hint only, as the deque can change right after
+            bool Empty() const
+            {
+                return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed);
+            }
+
+        private:
+            static const int64_t InitialCapacity = 256;
+
+            struct Ring
+            {
+                int64_t                                     Mask;
+                std::unique_ptr<std::atomic<TaskJob*>[]>    Slots;
+
+                Ring(int64_t capacity) : Mask(capacity - 1), Slots(new std::atomic<TaskJob*>[capacity]) {}
+
+                int64_t Capacity() const { return Mask + 1; }
+                TaskJob* Get(int64_t index) const { return Slots[index & Mask].load(std::memory_order_relaxed); }
+                void Put(int64_t index, TaskJob* pJob) { Slots[index & Mask].store(pJob, std::memory_order_relaxed); }
+            };
+
+            Ring* Grow(Ring* pRing, int64_t top, int64_t bottom)
+            {
+                Ring* pNewRing = new Ring(pRing->Capacity() * 2);
+                for (int64_t i = top; i < bottom; ++i)
+                    pNewRing->Put(i, pRing->Get(i));
+
+                m_Rings.emplace_back(pNewRing);
+                m_pRing.store(pNewRing, std::memory_order_release);
+                return pNewRing;
+            }
+
+            alignas(64) std::atomic<int64_t>    m_Top = { 0 };
+            alignas(64) std::atomic<int64_t>    m_Bottom = { 0 };
+            std::atomic<Ring*>                  m_pRing = { nullptr };
+            std::vector<std::unique_ptr<Ring>>  m_Rings = {};   // Owner only
+        };
+
+        // The worker the current thread is, if any
+        thread_local const TaskManager* t_pCurrentTaskManager = nullptr;
+        thread_local uint32_t           t_CurrentWorkerIndex  = 0;
+
+        // Picks where threads that are not workers start looking for work to steal
+        thread_local uint32_t           t_RandomState = 0x9e3779b9u;
+
+        inline uint32_t NextRandom(uint32_t& state)
+        {
+            // xorshift32
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+    }
+
+    struct TaskManager::Worker
+    {
+        WorkStealingDeque   Queues[PriorityCount];
+        TaskJob*            pFreeJobs = nullptr;    // Local job pool, only touched by this worker
+        uint32_t            FreeJobCount = 0;
+        uint32_t            RandomState = 1;        // Picks the first worker to steal from
+        std::thread         Thread;
+    };
+
     TaskManager::TaskManager()
     {
     }
 
     TaskManager::~TaskManager()
     {
+        if (!m_Workers.empty())
+            Shutdown();
     }
 
     int32_t TaskManager::Init(uint32_t threadPoolSize)
     {
-        std::function<void()> pTaskHandler = [this]() { this->TaskExecutor(); };
+        // All workers must exist before any thread starts, as they steal from each other
+        for (uint32_t i = 0; i < threadPoolSize; ++i)
+        {
+            m_Workers.emplace_back(new Worker());
+            m_Workers.back()->RandomState = (i + 1) * 0x9e3779b9u;
+        }
 
         for (uint32_t i = 0; i < threadPoolSize; ++i)
-            m_ThreadPool.emplace_back(pTaskHandler);
+            m_Workers[i]->Thread = std::thread(&TaskManager::TaskExecutor, this, i);
 
         return 0;
     }
 
     void TaskManager::Shutdown()
     {
-        // Before shutting down, ensure no loading is going on in the background, as it can hang
-        while (GetContentManager()->IsCurrentlyLoading()) {}
-
         // Flag all threads to shutdown
         {
-            std::unique_lock<std::mutex> lock(m_CriticalSection);
-            m_ShuttingDown = true;
-            m_QueueCondition.notify_all();
+            std::unique_lock<std::mutex> lock(m_SleepCriticalSection);
+            m_ShuttingDown.store(true);
+            m_SleepCondition.notify_all();
         }
 
         // Wait for all threads to be done
-        std::vector<std::thread>::iterator iter = m_ThreadPool.begin();
-        while (iter != m_ThreadPool.end())
-        {
-            iter->join();
-            iter = m_ThreadPool.erase(iter);
-        }
+        for (auto& pWorker : m_Workers)
+            pWorker->Thread.join();
+        m_Workers.clear();
     }
 
-    void TaskManager::AddTask(Task& newTask) 
-    { 
-        std::unique_lock<std::mutex> lock(m_CriticalSection);
-        m_TaskQueue.push(std::move(newTask));
+    void TaskManager::AddTask(Task& newTask, TaskPriority priority)
+    {
+        TaskJob* pJob = AllocateJob();
+        pJob->pTaskFunction           = std::move(newTask.pTaskFunction);
+        pJob->pTaskParam              = newTask.pTaskParam;
+        pJob->pTaskCompletionCallback = newTask.pTaskCompletionCallback;
+        pJob->Priority                = priority;
 
-        // Wake a single thread to pick up the task
-        m_QueueCondition.notify_one();
+        Schedule(&pJob, 1);
     }
 
-    void TaskManager::AddTaskList(std::queue<Task>& newTaskList)
+    void TaskManager::AddTaskList(std::queue<Task>& newTaskList, TaskPriority priority)
     {
-        std::unique_lock<std::mutex> lock(m_CriticalSection);
+        std::vector<TaskJob*> jobs;
+        jobs.reserve(newTaskList.size());
         while (newTaskList.size())
         {
-            m_TaskQueue.push(std::move(newTaskList.front()));
+            Task& task = newTaskList.front();
+
+            TaskJob* pJob = AllocateJob();
+            pJob->pTaskFunction           = std::move(task.pTaskFunction);
+            pJob->pTaskParam              = task.pTaskParam;
+            pJob->pTaskCompletionCallback = task.pTaskCompletionCallback;
+            pJob->Priority                = priority;
+            jobs.push_back(pJob);
+
             newTaskList.pop();
         }
 
         // Wake up all threads to pick up as many concurrent tasks as possible
-        m_QueueCondition.notify_all();
+        Schedule(jobs.data(), static_cast<uint32_t>(jobs.size()));
     }
 
-    // Runs for each thread and executes any waiting tasks when available
-    void TaskManager::TaskExecutor()
+    void TaskManager::ParallelFor(uint32_t begin, uint32_t end, const RangeFunc& rangeFunction, uint32_t minChunkSize, TaskPriority priority)
+    {
+        if (begin >= end)
+            return;
+
+        const uint32_t count       = end - begin;
+        const uint32_t threadCount = GetWorkerCount() + 1;
+        const uint32_t chunkSize   = minChunkSize ? minChunkSize : std::max(1u, count / (threadCount * ChunksPerThread));
+
+        if (m_Workers.empty() || m_ShuttingDown.load() || count <= chunkSize)
+        {
+            rangeFunction(begin, end);
+            return;
+        }
+
+        ParallelForState state;
+        state.pRangeFunction = &rangeFunction;
+        state.ChunkSize      = chunkSize;
+        state.RemainingCount.store(count);
+
+        auto newRange = [&](uint32_t rangeBegin, uint32_t rangeEnd)
+        {
+            TaskJob* pJob = AllocateJob();
+            pJob->pParallelFor = &state;
+            pJob->RangeBegin   = rangeBegin;
+            pJob->RangeEnd     = rangeEnd;
+            pJob->Priority     = priority;
+            return pJob;
+        };
+
+        // A worker starts on the whole range and splits it as others come to steal. Any other thread has no
+        // deque to be stolen from, so it hands out one piece per worker up front and runs the first itself.
+        if (GetCurrentWorker())
+            Execute(newRange(begin, end));
+        else
+        {
+            const uint32_t pieceCount = std::min(threadCount, (count + chunkSize - 1) / chunkSize);
+
+            std::vector<TaskJob*> pieces;
+            pieces.reserve(pieceCount);
+            for (uint32_t i = 0; i < pieceCount; ++i)
+                pieces.push_back(newRange(begin + static_cast<uint32_t>(static_cast<uint64_t>(count) * i / pieceCount),
+                                          begin + static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / pieceCount)));
+
+            Schedule(pieces.data() + 1, pieceCount - 1);
+            Execute(pieces[0]);
+        }
+
+        // Help until every range has run
+        while (state.RemainingCount.load(std::memory_order_acquire) != 0)
+        {
+            if (!RunPendingTask(priority))
+                std::this_thread::yield();
+        }
+    }
+
+    bool TaskManager::RunPendingTask(TaskPriority lowestPriority)
     {
-        while (true)
+        TaskJob* pJob = FindJob(GetCurrentWorker(), lowestPriority);
+        if (!pJob)
+            return false;
+
+        Execute(pJob);
+        return true;
+    }
+
+    TaskManager::Worker* TaskManager::GetCurrentWorker() const
+    {
+        return t_pCurrentTaskManager == this ? m_Workers[t_CurrentWorkerIndex].get() : nullptr;
+    }
+
+    TaskJob* TaskManager::AllocateJob()
+    {
+        Worker* pWorker = GetCurrentWorker();
+        if (pWorker && pWorker->pFreeJobs)
         {
-            Task taskToExecute;
+            TaskJob* pJob = pWorker->pFreeJobs;
+            pWorker->pFreeJobs = pJob->pNextFree;
+            --pWorker->FreeJobCount;
+            return pJob;
+        }
+
+        std::unique_lock<std::mutex> lock(m_JobPoolCriticalSection);
+        if (!m_pFreeJobs)
+        {
+            m_JobBlocks.emplace_back(new TaskJob[JobBlockSize]);
+            TaskJob* pBlock = m_JobBlocks.back().get();
+            for (uint32_t i = 0; i < JobBlockSize; ++i)
             {
-                // Try to unload a task to execute
-                std::unique_lock<std::mutex> lock(m_CriticalSection);
-                m_QueueCondition.wait(lock, [this] { return !this->m_TaskQueue.empty() || m_ShuttingDown; });    // Sleep until a task is available to execute or we are shutting down
+                pBlock[i].pNextFree = m_pFreeJobs;
+                m_pFreeJobs = &pBlock[i];
+            }
+        }
 
-                if (m_ShuttingDown)
-                    break;
+        TaskJob* pJob = m_pFreeJobs;
+        m_pFreeJobs = pJob->pNextFree;
 
-                // Get the task (if not shutting down
-                taskToExecute = m_TaskQueue.front();
-                m_TaskQueue.pop();
+        // Workers take a batch so the next allocations don't lock
+        if (pWorker)
+        {
+            while (m_pFreeJobs && pWorker->FreeJobCount < LocalJobBatchSize)
+            {
+                TaskJob* pFree = m_pFreeJobs;
+                m_pFreeJobs = pFree->pNextFree;
+                pFree->pNextFree = pWorker->pFreeJobs;
+                pWorker->pFreeJobs = pFree;
+                ++pWorker->FreeJobCount;
             }
+        }
+
+        return pJob;
+    }
 
-            while (taskToExecute.pTaskFunction)
+    void TaskManager::ReleaseJob(TaskJob* pJob)
+    {
+        pJob->pTaskFunction           = nullptr;
+        pJob->pTaskParam              = nullptr;
+        pJob->pTaskCompletionCallback = nullptr;
+        pJob->pGraph                  = nullptr;
+        pJob->pParallelFor            = nullptr;
+        pJob->Successors.clear();
+
+        Worker* pWorker = GetCurrentWorker();
+        if (pWorker)
+        {
+            pJob->pNextFree = pWorker->pFreeJobs;
+            pWorker->pFreeJobs = pJob;
+            if (++pWorker->FreeJobCount < 2 * LocalJobBatchSize)
+                return;
+
+            // Jobs made on one thread and finished on another pile up on the second, so hand a batch back
+            std::unique_lock<std::mutex> lock(m_JobPoolCriticalSection);
+            for (uint32_t i = 0; i < LocalJobBatchSize; ++i)
+            {
+                TaskJob* pFree = pWorker->pFreeJobs;
+                pWorker->pFreeJobs = pFree->pNextFree;
+                pFree->pNextFree = m_pFreeJobs;
+                m_pFreeJobs = pFree;
+            }
+            pWorker->FreeJobCount -= LocalJobBatchSize;
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_JobPoolCriticalSection);
+        pJob->pNextFree = m_pFreeJobs;
+        m_pFreeJobs = pJob;
+    }
+
+    void TaskManager::Schedule(TaskJob* const* ppJobs, uint32_t jobCount)
+    {
+        if (!jobCount)
+            return;
+
+        Worker* pWorker = GetCurrentWorker();
+        if (pWorker)
+        {
+            for (uint32_t i = 0; i < jobCount; ++i)
+                pWorker->Queues[static_cast<uint32_t>(ppJobs[i]->Priority)].Push(ppJobs[i]);
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock(m_SharedQueueCriticalSection);
+            for (uint32_t i = 0; i < jobCount; ++i)
+            {
+                const uint32_t priority = static_cast<uint32_t>(ppJobs[i]->Priority);
+                m_SharedQueues[priority].push(ppJobs[i]);
+                m_SharedJobCount[priority].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Sleeping workers count the jobs under the sleep lock before waiting, and we look for sleepers after
+        // counting the jobs, so either they see the jobs or we see them.
+        m_QueuedJobCount.fetch_add(static_cast<int32_t>(jobCount));
+        if (m_SleepingWorkerCount.load())
+        {
+            std::unique_lock<std::mutex> lock(m_SleepCriticalSection);
+            if (jobCount == 1)
+                m_SleepCondition.notify_one();
+            else
+                m_SleepCondition.notify_all();
+        }
+    }
+
+    TaskJob* TaskManager::FindJob(Worker* pWorker, TaskPriority lowestPriority)
+    {
+        const uint32_t workerCount = GetWorkerCount();
+        uint32_t& randomState = pWorker ? pWorker->RandomState : t_RandomState;
+
+        for (uint32_t priority = 0; priority <= static_cast<uint32_t>(lowestPriority); ++priority)
+        {
+            TaskJob* pJob = nullptr;
+
+            // Our own work first, newest first while it is still in cache
+            if (pWorker)
+                pJob = pWorker->Queues[priority].Pop();
+
+            // Then work added from outside the pool
+            if (!pJob && m_SharedJobCount[priority].load(std::memory_order_relaxed))
             {
-                // Execute the task
-                taskToExecute.pTaskFunction(taskToExecute.pTaskParam);
+                std::unique_lock<std::mutex> lock(m_SharedQueueCriticalSection);
+                if (!m_SharedQueues[priority].empty())
+                {
+                    pJob = m_SharedQueues[priority].front();
+                    m_SharedQueues[priority].pop();
+                    m_SharedJobCount[priority].fetch_sub(1, std::memory_order_relaxed);
+                }
+            }
 
-                // When we are done, if there was a completion callback, tick it down and execute if needed
-                if (taskToExecute.pTaskCompletionCallback)
+            // Then the oldest work of another worker, starting from a random one
+            if (!pJob && workerCount)
+            {
+                const uint32_t start = NextRandom(randomState) % workerCount;
+                for (uint32_t i = 0; i < workerCount && !pJob; ++i)
                 {
-                    // If this was the last task on which we were waiting, execute the completion task now
-                    if (--taskToExecute.pTaskCompletionCallback->TaskCount == 0)
-                    {
-                        auto callbackMemPtr = taskToExecute.pTaskCompletionCallback;
-                        taskToExecute = taskToExecute.pTaskCompletionCallback->CompletionTask;
-                        delete callbackMemPtr;
-                        continue;
-                    }
+                    Worker* pVictim = m_Workers[(start + i) % workerCount].get();
+                    if (pVictim != pWorker)
+                        pJob = pVictim->Queues[priority].Steal();
                 }
+            }
 
-                // No completion task to run, fetch another task or sleep
+            if (pJob)
+            {
+                m_QueuedJobCount.fetch_sub(1);
+                return pJob;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void TaskManager::Execute(TaskJob* pJob)
+    {
+        if (pJob->pParallelFor)
+        {
+            RunRange(pJob);
+            ReleaseJob(pJob);
+            return;
+        }
+
+        // Execute the task
+        pJob->pTaskFunction(pJob->pTaskParam);
+
+        // When we are done, if there was a completion callback, tick it down and execute if needed
+        TaskCompletionCallback* pCompletionCallback = pJob->pTaskCompletionCallback;
+        while (pCompletionCallback && --pCompletionCallback->TaskCount == 0)
+        {
+            // If this was the last task on which we were waiting, execute the completion task now
+            Task completionTask = pCompletionCallback->CompletionTask;
+            delete pCompletionCallback;
+            if (!completionTask.pTaskFunction)
                 break;
+
+            completionTask.pTaskFunction(completionTask.pTaskParam);
+            pCompletionCallback = completionTask.pTaskCompletionCallback;
+        }
+
+        // Schedule the graph nodes this was the last dependency of
+        for (TaskJob* pSuccessor : pJob->Successors)
+        {
+            if (pSuccessor->PendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                Schedule(&pSuccessor, 1);
+        }
+
+        // The graph may be destroyed as soon as its count reaches 0, so that is the last thing we touch
+        TaskGraph* pGraph = pJob->pGraph;
+        ReleaseJob(pJob);
+        if (pGraph)
+            pGraph->m_RemainingNodes.fetch_sub(1, std::memory_order_release);
+    }
+
+    void TaskManager::RunRange(TaskJob* pJob)
+    {
+        ParallelForState* pState = pJob->pParallelFor;
+        const RangeFunc&  rangeFunction = *pState->pRangeFunction;
+        const uint32_t    chunkSize = pState->ChunkSize;
+        uint32_t          begin = pJob->RangeBegin;
+        uint32_t          end = pJob->RangeEnd;
+
+        // Lazy binary splitting: while the rest of the range is worth splitting and nothing of ours is queued
+        // for idle threads to steal, queue its upper half. Otherwise run a chunk and look again. Threads that
+        // are not workers have no deque and just run what they were given.
+        Worker*            pWorker = GetCurrentWorker();
+        WorkStealingDeque* pQueue = pWorker ? &pWorker->Queues[static_cast<uint32_t>(pJob->Priority)] : nullptr;
+        while (end - begin > chunkSize)
+        {
+            if (pQueue && end - begin >= 2 * chunkSize && pQueue->Empty())
+            {
+                const uint32_t middle = begin + (end - begin) / 2;
+
+                TaskJob* pHalf = AllocateJob();
+                pHalf->pParallelFor = pState;
+                pHalf->RangeBegin   = middle;
+                pHalf->RangeEnd     = end;
+                pHalf->Priority     = pJob->Priority;
+                Schedule(&pHalf, 1);
+
+                end = middle;
+                continue;
             }
+
+            rangeFunction(begin, begin + chunkSize);
+            pState->RemainingCount.fetch_sub(chunkSize, std::memory_order_release);
+            begin += chunkSize;
+        }
+
+        // The caller may return as soon as the count reaches 0, so that is the last thing we touch
+        rangeFunction(begin, end);
+        pState->RemainingCount.fetch_sub(end - begin, std::memory_order_release);
+    }
+
+    // Runs for each thread and executes any waiting tasks when available
+    void TaskManager::TaskExecutor(uint32_t workerIndex)
+    {
+        t_pCurrentTaskManager = this;
+        t_CurrentWorkerIndex  = workerIndex;
+        Worker* pWorker = m_Workers[workerIndex].get();
+
+        uint32_t idleCount = 0;
+        while (!m_ShuttingDown.load(std::memory_order_acquire))
+        {
+            TaskJob* pJob = FindJob(pWorker, TaskPriority::Streaming);
+            if (pJob)
+            {
+                Execute(pJob);
+                idleCount = 0;
+                continue;
+            }
+
+            if (++idleCount < IdleSpinCount)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Sleep until a task is available to execute or we are shutting down
+            std::unique_lock<std::mutex> lock(m_SleepCriticalSection);
+            m_SleepingWorkerCount.fetch_add(1);
+            m_SleepCondition.wait(lock, [this] { return m_QueuedJobCount.load() > 0 || m_ShuttingDown.load(); });
+            m_SleepingWorkerCount.fetch_sub(1);
+            idleCount = 0;
+        }
+    }
+
+    TaskGraph::TaskGraph(TaskManager* pTaskManager) :
+        m_pTaskManager(pTaskManager)
+    {
+    }
+
+    TaskGraph::~TaskGraph()
+    {
+        if (m_Submitted)
+            Wait();
+        else
+        {
+            for (TaskJob* pNode : m_Nodes)
+                m_pTaskManager->ReleaseJob(pNode);
+        }
+    }
+
+    uint32_t TaskGraph::AddNode(const Task& task, TaskPriority priority)
+    {
+        assert(!m_Submitted && "Nodes can't be added to a submitted graph");
+
+        TaskJob* pJob = m_pTaskManager->AllocateJob();
+        pJob->pTaskFunction           = task.pTaskFunction;
+        pJob->pTaskParam              = task.pTaskParam;
+        pJob->pTaskCompletionCallback = task.pTaskCompletionCallback;
+        pJob->Priority                = priority;
+        pJob->pGraph                  = this;
+        pJob->PendingDependencies.store(0, std::memory_order_relaxed);
+
+        m_WaitPriority = std::max(m_WaitPriority, priority);
+        m_Nodes.push_back(pJob);
+        return static_cast<uint32_t>(m_Nodes.size() - 1);
+    }
+
+    void TaskGraph::AddDependency(uint32_t before, uint32_t after)
+    {
+        assert(!m_Submitted && "Dependencies can't be added to a submitted graph");
+        assert(before < m_Nodes.size() && after < m_Nodes.size() && before != after);
+
+        m_Nodes[before]->Successors.push_back(m_Nodes[after]);
+        m_Nodes[after]->PendingDependencies.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void TaskGraph::Submit()
+    {
+        assert(!m_Submitted && "A graph can only be submitted once");
+
+        m_Submitted = true;
+        m_RemainingNodes.store(static_cast<uint32_t>(m_Nodes.size()), std::memory_order_relaxed);
+
+        // Find the roots before scheduling any, since a scheduled node can make others ready
+        auto rootEnd = std::partition(m_Nodes.begin(), m_Nodes.end(),
+            [](const TaskJob* pNode) { return pNode->PendingDependencies.load(std::memory_order_relaxed) == 0; });
+        assert((m_Nodes.empty() || rootEnd != m_Nodes.begin()) && "A task graph needs a node without dependencies");
+
+        const uint32_t rootCount = static_cast<uint32_t>(rootEnd - m_Nodes.begin());
+        std::vector<TaskJob*> roots;
+        roots.swap(m_Nodes);
+        m_pTaskManager->Schedule(roots.data(), rootCount);
+    }
+
+    void TaskGraph::Wait()
+    {
+        while (!IsComplete())
+        {
+            if (!m_pTaskManager->RunPendingTask(m_WaitPriority))
+                std::this_thread::yield();
         }
     }
 
@@ -23,19 +23,41 @@
 #pragma once
 
 #include "../misc/helpers.h"
-#include "../misc/threadsafe_queue.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <queue>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <vector>
 
 namespace cauldron
 {
     typedef std::function<void(void*)> TaskFunc;
+    typedef std::function<void(uint32_t, uint32_t)> RangeFunc;
 
     struct TaskCompletionCallback;
+    struct TaskJob;
+    class TaskManager;
+
+    /**
+     * @enum TaskPriority
+     *
+     * Scheduling class of a task. Threads looking for work (including threads helping
+     * while they wait) always take frame-critical work before streaming work.
+     *
+     * @ingroup CauldronCore
+     */
+    enum class TaskPriority : uint32_t
+    {
+        FrameCritical = 0,  ///< Work a frame is waiting on
+        Streaming,          ///< Background work such as content loading
+
+        Count               ///< Priority class count
+    };
 
     /**
      * @struct Task
@@ -79,12 +101,83 @@ namespace cauldron
         TaskCompletionCallback() = delete;
     };
 
+    /**
+     * @class TaskGraph
+     *
+     * A set of tasks with explicit dependency edges. Nodes and edges are added first, then
+     * Submit() schedules the nodes without dependencies, and every node that completes schedules
+     * the successors it was the last dependency of. Nodes come from the task manager's pool, so
+     * building a graph does not allocate once the pool is warm.
+     *
+     * The graph must outlive its execution; the destructor waits for a submitted graph.
+     *
+     * @ingroup CauldronCore
+     */
+    class TaskGraph
+    {
+    public:
+
+        /**
+         * @brief   Constructs an empty graph that will run on the given task manager.
+         */
+        TaskGraph(TaskManager* pTaskManager);
+
+        /**
+         * @brief   Waits for the graph if it was submitted, and returns unsubmitted nodes to the pool.
+         */
+        ~TaskGraph();
+
+        /**
+         * @brief   Adds a node and returns its index. The task's completion callback, if any, is honored as with TaskManager::AddTask.
+         */
+        uint32_t AddNode(const Task& task, TaskPriority priority = TaskPriority::Streaming);
+
+        /**
+         * @brief   Makes node after wait for node before to complete. Only valid before Submit().
+         */
+        void AddDependency(uint32_t before, uint32_t after);
+
+        /**
+         * @brief   Schedules every node without dependencies. The graph can only be submitted once.
+         */
+        void Submit();
+
+        /**
+         * @brief   Runs pending tasks on the calling thread until all the graph's nodes have completed.
+         */
+        void Wait();
+
+        /**
+         * @brief   Returns true once every node of a submitted graph has completed.
+         */
+        bool IsComplete() const { return m_Submitted && m_RemainingNodes.load(std::memory_order_acquire) == 0; }
+
+    private:
+
+        // No Copy, No Move
+        NO_COPY(TaskGraph);
+        NO_MOVE(TaskGraph);
+
+        friend class TaskManager;
+
+        TaskManager*            m_pTaskManager = nullptr;
+        std::vector<TaskJob*>   m_Nodes = {};
+        std::atomic_uint32_t    m_RemainingNodes = { 0 };
+        TaskPriority            m_WaitPriority = TaskPriority::FrameCritical;  // Lowest priority among the nodes, which Wait() helps with
+        bool                    m_Submitted = false;
+    };
+
     /**
      * @class TaskManager
      *
      * The TaskManager instance manages our thread pool. Currently, only loading of content is handled
      * asynchronously (the main loop is single threaded).
      *
+     * Each worker owns a Chase-Lev work-stealing deque per priority class. Tasks added from a worker
+     * (e.g. a glTF load spawning its buffer and texture loads) go to that worker's own deque without
+     * locking, and idle workers steal from the other end. Tasks added from other threads go to a
+     * shared queue per priority class. Workers with nothing to run or steal sleep until work is added.
+     *
      * @ingroup CauldronCore
      */
     class TaskManager
@@ -97,7 +190,7 @@ namespace cauldron
         TaskManager();
 
         /**
-         * @brief   Destructor with default behavior.
+         * @brief   Destructor. Shuts down if needed and frees the task pool.
          */
         virtual ~TaskManager();
 
@@ -108,18 +201,38 @@ namespace cauldron
 
         /**
          * @brief   Shuts down the task manager and joins all threads. Called from framework shut down procedures.
+         *          Tasks still queued are not run.
          */
         void Shutdown();
 
         /**
          * @brief   Enqueues a task for execution.
          */
-        void AddTask(Task& newTask);
+        void AddTask(Task& newTask, TaskPriority priority = TaskPriority::Streaming);
 
         /**
          * @brief   Enqueues multiple tasks for execution.
          */
-        void AddTaskList(std::queue<Task>& newTaskList);
+        void AddTaskList(std::queue<Task>& newTaskList, TaskPriority priority = TaskPriority::Streaming);
+
+        /**
+         * @brief   Calls rangeFunction over sub-ranges covering [begin, end) on the pool and the calling thread,
+         *          and returns once all have run. A range is split in half whenever the thread running it has
+         *          nothing queued for others to steal, down to minChunkSize (0 picks a size from the range and
+         *          the thread count), so the chunking follows how busy the pool is.
+         */
+        void ParallelFor(uint32_t begin, uint32_t end, const RangeFunc& rangeFunction, uint32_t minChunkSize = 0, TaskPriority priority = TaskPriority::FrameCritical);
+
+        /**
+         * @brief   Runs one pending task of the given priority or higher on the calling thread. Returns false if
+         *          none was found. This is how waiting threads help.
+         */
+        bool RunPendingTask(TaskPriority lowestPriority = TaskPriority::Streaming);
+
+        /**
+         * @brief   Returns the number of worker threads.
+         */
+        uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_Workers.size()); }
 
     private:
 
@@ -127,13 +240,38 @@ namespace cauldron
         NO_COPY(TaskManager);
         NO_MOVE(TaskManager);
 
-        void TaskExecutor();
+        friend class TaskGraph;
+
+        struct Worker;
+
+        void TaskExecutor(uint32_t workerIndex);
+
+        Worker* GetCurrentWorker() const;
+        TaskJob* AllocateJob();
+        void ReleaseJob(TaskJob* pJob);
+        void Schedule(TaskJob* const* ppJobs, uint32_t jobCount);
+        TaskJob* FindJob(Worker* pWorker, TaskPriority lowestPriority);
+        void Execute(TaskJob* pJob);
+        void RunRange(TaskJob* pJob);
+
+        std::atomic_bool                        m_ShuttingDown = { false };
+        std::vector<std::unique_ptr<Worker>>    m_Workers;
+
+        // Tasks added from threads that are not workers
+        std::queue<TaskJob*>                    m_SharedQueues[static_cast<uint32_t>(TaskPriority::Count)] = {};
+        std::atomic_uint32_t                    m_SharedJobCount[static_cast<uint32_t>(TaskPriority::Count)] = {};
+        std::mutex                              m_SharedQueueCriticalSection;
+
+        // Jobs queued anywhere and not yet taken, and workers asleep waiting for some
+        std::atomic_int32_t                     m_QueuedJobCount = { 0 };       // Can dip below 0 while a job is taken before its push is counted
+        std::atomic_uint32_t                    m_SleepingWorkerCount = { 0 };
+        std::mutex                              m_SleepCriticalSection;
+        std::condition_variable                 m_SleepCondition;
 
-        bool                        m_ShuttingDown = false;
-        std::vector<std::thread>    m_ThreadPool = {};
-        std::queue<Task>            m_TaskQueue = {};
-        std::mutex                  m_CriticalSection;
-        std::condition_variable     m_QueueCondition;
+        // Job pool shared by all threads; workers keep a local free list in front of it
+        std::vector<std::unique_ptr<TaskJob[]>> m_JobBlocks;
+        TaskJob*                                m_pFreeJobs = nullptr;
+        std::mutex                              m_JobPoolCriticalSection;
     };
 
 } // namespace cauldron
@@ -10,8 +10,8 @@ struct ObjectConstants
     DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
     UINT MaterialIndex;
     UINT LODLevel;
-    UINT ObjPad1;
-    UINT ObjPad2;
+    float MorphStart = FLT_MAX;   // Camera distances over which the grid morphs to half resolution
+    float MorphEnd = FLT_MAX;
 };
 
 struct PassConstants
@@ -46,6 +46,10 @@ struct TerrainConstants
     float TexelSize = 1.0f / 1024.0f;
     
     DirectX::XMFLOAT2 HeightMapSize = { 1024.0f, 1024.0f };
+    DirectX::XMFLOAT2 TileCount = { 1.0f, 1.0f };    // Streamed tile grid
+    
+    UINT StreamingEnabled = 0;
+    float GridResolution = 64.0f;   // Quads per side of the node grid mesh
     DirectX::XMFLOAT2 Padding;
 };
 
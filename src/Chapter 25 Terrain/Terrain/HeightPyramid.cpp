@@ -0,0 +1,168 @@
+//***************************************************************************************
+// HeightPyramid.cpp - Min/max mip pyramid implementation
+//***************************************************************************************
+
+#include "HeightPyramid.h"
+#include <ppl.h>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+void HeightPyramid::Build(const std::vector<float>& heights, UINT width, UINT height)
+{
+    mLevels.clear();
+    if (width == 0 || height == 0 || heights.size() < (size_t)width * height)
+        return;
+
+    // Level 0: each cell bounds the bilinear patch to the next texel (clamped at the edge)
+    Level base;
+    base.Width = width;
+    base.Height = height;
+    base.MinMax.resize((size_t)width * height);
+
+    concurrency::parallel_for(0, (int)height, [&](int z)
+    {
+        const float* row0 = &heights[(size_t)z * width];
+        const float* row1 = &heights[(size_t)min(z + 1, (int)height - 1) * width];
+        XMFLOAT2* out = &base.MinMax[(size_t)z * width];
+
+        for (UINT x = 0; x < width; ++x)
+        {
+            UINT x1 = min(x + 1, width - 1);
+            float a = row0[x], b = row0[x1], c = row1[x], d = row1[x1];
+            out[x].x = min(min(a, b), min(c, d));
+            out[x].y = max(max(a, b), max(c, d));
+        }
+    });
+
+    mLevels.push_back(std::move(base));
+
+    // Coarser levels: 2x2 reduction until a single cell is left
+    while (mLevels.back().Width > 1 || mLevels.back().Height > 1)
+    {
+        const Level& fine = mLevels.back();
+
+        Level coarse;
+        coarse.Width = (fine.Width + 1) / 2;
+        coarse.Height = (fine.Height + 1) / 2;
+        coarse.MinMax.resize((size_t)coarse.Width * coarse.Height);
+
+        concurrency::parallel_for(0, (int)coarse.Height, [&](int z)
+        {
+            UINT fz0 = 2 * z;
+            UINT fz1 = min(fz0 + 1, fine.Height - 1);
+
+            for (UINT x = 0; x < coarse.Width; ++x)
+            {
+                UINT fx0 = 2 * x;
+                UINT fx1 = min(fx0 + 1, fine.Width - 1);
+
+                const XMFLOAT2& a = fine.MinMax[(size_t)fz0 * fine.Width + fx0];
+                const XMFLOAT2& b = fine.MinMax[(size_t)fz0 * fine.Width + fx1];
+                const XMFLOAT2& c = fine.MinMax[(size_t)fz1 * fine.Width + fx0];
+                const XMFLOAT2& d = fine.MinMax[(size_t)fz1 * fine.Width + fx1];
+
+                XMFLOAT2& out = coarse.MinMax[(size_t)z * coarse.Width + x];
+                out.x = min(min(a.x, b.x), min(c.x, d.x));
+                out.y = max(max(a.y, b.y), max(c.y, d.y));
+            }
+        });
+
+        mLevels.push_back(std::move(coarse));
+    }
+}
+
+void HeightPyramid::Widen(UINT x0, UINT z0, UINT width, UINT height, const std::vector<XMFLOAT2>& ranges)
+{
+    if (mLevels.empty() || width == 0 || height == 0 || ranges.size() < (size_t)width * height)
+        return;
+
+    Level& base = mLevels[0];
+    UINT x1 = min(x0 + width, base.Width);
+    UINT z1 = min(z0 + height, base.Height);
+    if (x0 >= x1 || z0 >= z1)
+        return;
+
+    for (UINT z = z0; z < z1; ++z)
+    {
+        for (UINT x = x0; x < x1; ++x)
+        {
+            const XMFLOAT2& range = ranges[(size_t)(z - z0) * width + (x - x0)];
+            XMFLOAT2& cell = base.MinMax[(size_t)z * base.Width + x];
+            cell.x = min(cell.x, range.x);
+            cell.y = max(cell.y, range.y);
+        }
+    }
+
+    // Only the parents of the changed cells need the 2x2 reduction again
+    for (size_t l = 1; l < mLevels.size(); ++l)
+    {
+        const Level& fine = mLevels[l - 1];
+        Level& coarse = mLevels[l];
+        x0 /= 2; z0 /= 2;
+        x1 = (x1 + 1) / 2; z1 = (z1 + 1) / 2;
+
+        for (UINT z = z0; z < z1; ++z)
+        {
+            UINT fz0 = 2 * z;
+            UINT fz1 = min(fz0 + 1, fine.Height - 1);
+
+            for (UINT x = x0; x < x1; ++x)
+            {
+                UINT fx0 = 2 * x;
+                UINT fx1 = min(fx0 + 1, fine.Width - 1);
+
+                const XMFLOAT2& a = fine.MinMax[(size_t)fz0 * fine.Width + fx0];
+                const XMFLOAT2& b = fine.MinMax[(size_t)fz0 * fine.Width + fx1];
+                const XMFLOAT2& c = fine.MinMax[(size_t)fz1 * fine.Width + fx0];
+                const XMFLOAT2& d = fine.MinMax[(size_t)fz1 * fine.Width + fx1];
+
+                XMFLOAT2& out = coarse.MinMax[(size_t)z * coarse.Width + x];
+                out.x = min(min(a.x, b.x), min(c.x, d.x));
+                out.y = max(max(a.y, b.y), max(c.y, d.y));
+            }
+        }
+    }
+}
+
+XMFLOAT2 HeightPyramid::GetCell(UINT level, int x, int z) const
+{
+    const Level& l = mLevels[level];
+    x = max(0, min(x, (int)l.Width - 1));
+    z = max(0, min(z, (int)l.Height - 1));
+    return l.MinMax[(size_t)z * l.Width + x];
+}
+
+bool HeightPyramid::GetRange(float u0, float v0, float u1, float v1, float& minH, float& maxH) const
+{
+    if (mLevels.empty())
+        return false;
+
+    const Level& base = mLevels[0];
+    int x0 = max(0, min((int)floorf(min(u0, u1)), (int)base.Width - 1));
+    int x1 = max(0, min((int)floorf(max(u0, u1)), (int)base.Width - 1));
+    int z0 = max(0, min((int)floorf(min(v0, v1)), (int)base.Height - 1));
+    int z1 = max(0, min((int)floorf(max(v0, v1)), (int)base.Height - 1));
+
+    // Coarsest level at which the rectangle still touches at most 3x3 cells
+    UINT level = 0;
+    while (level + 1 < mLevels.size() &&
+           ((x1 >> level) - (x0 >> level) > 2 || (z1 >> level) - (z0 >> level) > 2))
+    {
+        ++level;
+    }
+
+    minH = FLT_MAX;
+    maxH = -FLT_MAX;
+    for (int z = z0 >> level; z <= (z1 >> level); ++z)
+    {
+        for (int x = x0 >> level; x <= (x1 >> level); ++x)
+        {
+            XMFLOAT2 cell = GetCell(level, x, z);
+            minH = min(minH, cell.x);
+            maxH = max(maxH, cell.y);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+//***************************************************************************************
+// HeightPyramid.h - Min/max mip pyramid over a heightmap
+//
+// Level 0 has one cell per texel; cell (x,z) holds the min/max of texels (x,z)..(x+1,z+1),
+// so it bounds the bilinear surface between them.  Each further level halves the
+// resolution and keeps the min/max of its 2x2 children, which makes the height range
+// of any rectangle a handful of lookups instead of a scan over the texels.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/MathHelper.h"
+#include <vector>
+
+class HeightPyramid
+{
+public:
+    // Heights are row-major, width*height values.  Levels are built in parallel.
+    void Build(const std::vector<float>& heights, UINT width, UINT height);
+    void Clear() { mLevels.clear(); }
+
+    // Grows level 0 cells [x0,x0+width)x[z0,z0+height) to include ranges (row-major,
+    // width*height min/max pairs) and refreshes the coarser cells above them.  Cells
+    // never shrink, so a pyramid built from a coarse level stays conservative as finer
+    // data arrives.
+    void Widen(UINT x0, UINT z0, UINT width, UINT height, const std::vector<DirectX::XMFLOAT2>& ranges);
+
+    bool IsEmpty() const { return mLevels.empty(); }
+    UINT GetLevelCount() const { return (UINT)mLevels.size(); }
+    UINT GetLevelWidth(UINT level) const { return mLevels[level].Width; }
+    UINT GetLevelHeight(UINT level) const { return mLevels[level].Height; }
+
+    // Min (x) and max (y) of a cell; coordinates are clamped to the level.
+    DirectX::XMFLOAT2 GetCell(UINT level, int x, int z) const;
+
+    // Conservative range of the bilinear surface over texel coordinates [u0,u1]x[v0,v1].
+    // Returns false if the pyramid is empty.
+    bool GetRange(float u0, float v0, float u1, float v1, float& minH, float& maxH) const;
+
+private:
+    struct Level
+    {
+        UINT Width = 0;
+        UINT Height = 0;
+        std::vector<DirectX::XMFLOAT2> MinMax; // Interleaved so one fetch returns both
+    };
+
+    std::vector<Level> mLevels;
+};
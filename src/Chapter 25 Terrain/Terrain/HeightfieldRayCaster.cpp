@@ -0,0 +1,270 @@
+//***************************************************************************************
+// HeightfieldRayCaster.cpp - Max-mip heightfield ray casting implementation
+//***************************************************************************************
+
+#include "HeightfieldRayCaster.h"
+#include <ppl.h>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    // Slack in normalized height for the pyramid and clipping tests, so rounding in the
+    // ray's height cannot cull a cell the ray only grazes
+    const float HeightEpsilon = 1e-5f;
+}
+
+void HeightfieldRayCaster::Attach(const std::vector<float>& heights, UINT width, UINT height,
+                                  const HeightPyramid& pyramid, float terrainSize, float minHeight, float maxHeight)
+{
+    if (width == 0 || height == 0 || heights.size() < (size_t)width * height || pyramid.IsEmpty())
+    {
+        Detach();
+        return;
+    }
+
+    mHeights = heights.data();
+    mPyramid = &pyramid;
+    mWidth = width;
+    mHeight = height;
+    mTerrainSize = terrainSize;
+    mMinHeight = minHeight;
+    mHeightScale = (maxHeight != minHeight) ? maxHeight - minHeight : 1.0f;
+}
+
+void HeightfieldRayCaster::Detach()
+{
+    mHeights = nullptr;
+    mPyramid = nullptr;
+    mWidth = mHeight = 0;
+}
+
+bool HeightfieldRayCaster::ToLocal(const HeightfieldRay& ray, LocalRay& r) const
+{
+    // Same mapping as Terrain::GetHeight: u = (x / size + 0.5) * width
+    float sx = mWidth / mTerrainSize;
+    float sz = mHeight / mTerrainSize;
+    r.Ox = ray.Origin.x * sx + mWidth * 0.5f;
+    r.Oz = ray.Origin.z * sz + mHeight * 0.5f;
+    r.Oy = (ray.Origin.y - mMinHeight) / mHeightScale;
+    r.Dx = ray.Direction.x * sx;
+    r.Dz = ray.Direction.z * sz;
+    r.Dy = ray.Direction.y / mHeightScale;
+
+    r.T0 = 0.0f;
+    r.T1 = ray.MaxT;
+
+    // Clip to the texel rectangle, then to the slab between the lowest and highest
+    // surface point: below it the ray has already hit, above it there is nothing
+    XMFLOAT2 range = mPyramid->GetCell(mPyramid->GetLevelCount() - 1, 0, 0);
+    const float origin[3] = { r.Ox, r.Oz, r.Oy };
+    const float dir[3] = { r.Dx, r.Dz, r.Dy };
+    const float lo[3] = { 0.0f, 0.0f, range.x - HeightEpsilon };
+    const float hi[3] = { (float)mWidth, (float)mHeight, range.y + HeightEpsilon };
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (dir[axis] == 0.0f)
+        {
+            if (origin[axis] < lo[axis] || origin[axis] > hi[axis])
+                return false;
+            continue;
+        }
+
+        float ta = (lo[axis] - origin[axis]) / dir[axis];
+        float tb = (hi[axis] - origin[axis]) / dir[axis];
+        r.T0 = max(r.T0, min(ta, tb));
+        r.T1 = min(r.T1, max(ta, tb));
+    }
+
+    return r.T0 <= r.T1;
+}
+
+float HeightfieldRayCaster::Texel(int x, int z) const
+{
+    x = max(0, min(x, (int)mWidth - 1));
+    z = max(0, min(z, (int)mHeight - 1));
+    return mHeights[(size_t)z * mWidth + x];
+}
+
+bool HeightfieldRayCaster::IntersectCell(int x, int z, const LocalRay& r, float t0, float t1, float& t) const
+{
+    // h(s,w) = a + b*s + c*w + e*s*w over the cell, s and w in [0,1]. Along the ray
+    // s and w are linear in t, so ray height minus surface height is a quadratic.
+    // Doubles keep the cancellation in it harmless.
+    double h00 = Texel(x, z), h10 = Texel(x + 1, z);
+    double h01 = Texel(x, z + 1), h11 = Texel(x + 1, z + 1);
+    double a = h00, b = h10 - h00, c = h01 - h00, e = h00 - h10 - h01 + h11;
+
+    double s0 = (double)r.Ox + (double)r.Dx * t0 - x;
+    double w0 = (double)r.Oz + (double)r.Dz * t0 - z;
+    double y0 = (double)r.Oy + (double)r.Dy * t0;
+
+    double C = y0 - (a + b * s0 + c * w0 + e * s0 * w0);
+    double B = r.Dy - (b * r.Dx + c * r.Dz + e * (s0 * r.Dz + w0 * r.Dx));
+    double A = -e * r.Dx * r.Dz;
+    double len = (double)t1 - t0;
+
+    // Already at or below the surface where the ray enters the cell
+    if (C <= 0.0)
+    {
+        t = t0;
+        return true;
+    }
+
+    double root = -1.0;
+    if (fabs(A) * len <= 1e-12 * (fabs(B) + fabs(C)))
+    {
+        if (B < 0.0)
+            root = -C / B;
+    }
+    else
+    {
+        double disc = B * B - 4.0 * A * C;
+        if (disc < 0.0)
+            return false;
+
+        // Stable form: both roots without subtracting nearly equal values
+        double q = -0.5 * (B + (B < 0.0 ? -sqrt(disc) : sqrt(disc)));
+        double r0 = q / A;
+        double r1 = (q != 0.0) ? C / q : r0;
+        if (r0 > r1)
+            std::swap(r0, r1);
+        root = (r0 >= 0.0) ? r0 : r1;
+    }
+
+    if (root < 0.0 || root > len)
+        return false;
+
+    t = (float)(t0 + root);
+    return true;
+}
+
+bool HeightfieldRayCaster::Finish(const HeightfieldRay& ray, bool found, float t, HeightfieldHit& hit) const
+{
+    hit.Hit = found;
+    hit.T = found ? t : 0.0f;
+    hit.Position = {
+        ray.Origin.x + ray.Direction.x * hit.T,
+        ray.Origin.y + ray.Direction.y * hit.T,
+        ray.Origin.z + ray.Direction.z * hit.T
+    };
+    return found;
+}
+
+bool HeightfieldRayCaster::Intersect(const HeightfieldRay& ray, HeightfieldHit& hit) const
+{
+    LocalRay r;
+    if (IsEmpty() || !ToLocal(ray, r))
+        return Finish(ray, false, 0.0f, hit);
+
+    const int top = (int)mPyramid->GetLevelCount() - 1;
+    const int stepX = (r.Dx > 0.0f) ? 1 : -1;
+    const int stepZ = (r.Dz > 0.0f) ? 1 : -1;
+
+    float t = r.T0;
+    int level = top;
+    int cx = max(0, min((int)floorf(r.Ox + r.Dx * t), (int)mWidth - 1)) >> level;
+    int cz = max(0, min((int)floorf(r.Oz + r.Dz * t), (int)mHeight - 1)) >> level;
+
+    for (;;)
+    {
+        // Where the ray leaves the current cell
+        float cellSize = (float)(1 << level);
+        float tx = FLT_MAX, tz = FLT_MAX;
+        if (r.Dx != 0.0f)
+            tx = ((cx + (stepX > 0 ? 1 : 0)) * cellSize - r.Ox) / r.Dx;
+        if (r.Dz != 0.0f)
+            tz = ((cz + (stepZ > 0 ? 1 : 0)) * cellSize - r.Oz) / r.Dz;
+        float tExit = min(min(tx, tz), r.T1);
+
+        // The ray is linear, so its lowest point over the span is at one end
+        float rayMin = min(r.Oy + r.Dy * t, r.Oy + r.Dy * tExit);
+        if (rayMin <= mPyramid->GetCell(level, cx, cz).y + HeightEpsilon)
+        {
+            if (level > 0)
+            {
+                // Descend into the child the ray is in at t
+                --level;
+                float childSize = (float)(1 << level);
+                cx = max(2 * cx, min((int)floorf((r.Ox + r.Dx * t) / childSize), 2 * cx + 1));
+                cz = max(2 * cz, min((int)floorf((r.Oz + r.Dz * t) / childSize), 2 * cz + 1));
+                continue;
+            }
+
+            float hitT;
+            if (IntersectCell(cx, cz, r, t, tExit, hitT))
+                return Finish(ray, true, hitT, hit);
+        }
+
+        if (tExit >= r.T1)
+            return Finish(ray, false, 0.0f, hit);
+
+        // Step to the neighbour; go back up once the step leaves the parent
+        int parentX = cx >> 1, parentZ = cz >> 1;
+        if (tx <= tz)
+            cx += stepX;
+        if (tz <= tx)
+            cz += stepZ;
+        t = max(t, tExit);
+
+        if (level < top && ((cx >> 1) != parentX || (cz >> 1) != parentZ))
+        {
+            ++level;
+            cx >>= 1;
+            cz >>= 1;
+        }
+    }
+}
+
+bool HeightfieldRayCaster::IntersectReference(const HeightfieldRay& ray, HeightfieldHit& hit) const
+{
+    LocalRay r;
+    if (IsEmpty() || !ToLocal(ray, r))
+        return Finish(ray, false, 0.0f, hit);
+
+    const int stepX = (r.Dx > 0.0f) ? 1 : -1;
+    const int stepZ = (r.Dz > 0.0f) ? 1 : -1;
+
+    float t = r.T0;
+    int cx = max(0, min((int)floorf(r.Ox + r.Dx * t), (int)mWidth - 1));
+    int cz = max(0, min((int)floorf(r.Oz + r.Dz * t), (int)mHeight - 1));
+
+    for (;;)
+    {
+        float tx = FLT_MAX, tz = FLT_MAX;
+        if (r.Dx != 0.0f)
+            tx = (cx + (stepX > 0 ? 1 : 0) - r.Ox) / r.Dx;
+        if (r.Dz != 0.0f)
+            tz = (cz + (stepZ > 0 ? 1 : 0) - r.Oz) / r.Dz;
+        float tExit = min(min(tx, tz), r.T1);
+
+        float hitT;
+        if (IntersectCell(cx, cz, r, t, tExit, hitT))
+            return Finish(ray, true, hitT, hit);
+
+        if (tExit >= r.T1)
+            return Finish(ray, false, 0.0f, hit);
+
+        if (tx <= tz)
+            cx += stepX;
+        if (tz <= tx)
+            cz += stepZ;
+        t = max(t, tExit);
+    }
+}
+
+void HeightfieldRayCaster::IntersectBatch(const HeightfieldRay* rays, HeightfieldHit* hits, size_t count) const
+{
+    // Chunks amortize the scheduling; neighbouring rays also touch the same cells
+    const size_t chunkSize = 64;
+    size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    concurrency::parallel_for(size_t(0), chunkCount, [&](size_t chunk)
+    {
+        size_t end = min(count, (chunk + 1) * chunkSize);
+        for (size_t i = chunk * chunkSize; i < end; ++i)
+            Intersect(rays[i], hits[i]);
+    });
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// HeightfieldRayCaster.h - Ray casting against a bilinear heightfield
+//
+// Rays are walked through the max heights of a HeightPyramid: a cell whose maximum is
+// below the ray over the span the ray crosses it is skipped whole, otherwise the walk
+// descends a level. At level 0 the ray is intersected exactly with the bilinear patch
+// between four texels (the same surface Terrain::GetHeight samples), so thin peaks
+// between fixed march steps cannot be missed.
+//
+// The caster only references the heights and pyramid it is attached to; the owner
+// re-attaches whenever they change.
+//***************************************************************************************
+
+#pragma once
+
+#include "HeightPyramid.h"
+#include <cfloat>
+#include <vector>
+
+struct HeightfieldRay
+{
+    DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 Direction = { 0.0f, 0.0f, 1.0f }; // Need not be normalized; T is in its units
+    float MaxT = FLT_MAX;
+};
+
+struct HeightfieldHit
+{
+    bool Hit = false;
+    float T = 0.0f;
+    DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+};
+
+class HeightfieldRayCaster
+{
+public:
+    // Heights are normalized [0,1], row-major; the pyramid must be built from them.
+    // The heightfield spans [-terrainSize/2, terrainSize/2] in x and z, centered at the
+    // origin, with texel i at u = i like Terrain::GetHeight.
+    void Attach(const std::vector<float>& heights, UINT width, UINT height, const HeightPyramid& pyramid,
+                float terrainSize, float minHeight, float maxHeight);
+    void Detach();
+
+    bool IsEmpty() const { return mHeights == nullptr; }
+
+    // First intersection along the ray within [0, MaxT]
+    bool Intersect(const HeightfieldRay& ray, HeightfieldHit& hit) const;
+
+    // Intersect for every ray; rays are split across worker threads
+    void IntersectBatch(const HeightfieldRay* rays, HeightfieldHit* hits, size_t count) const;
+
+    // Reference: visits every level-0 cell the ray crosses, without the pyramid
+    bool IntersectReference(const HeightfieldRay& ray, HeightfieldHit& hit) const;
+
+private:
+    // Ray in texel space: x/z in texels, y in normalized height. T is unchanged.
+    struct LocalRay
+    {
+        float Ox, Oy, Oz;
+        float Dx, Dy, Dz;
+        float T0, T1;        // Part of the ray over the heightfield
+    };
+
+    bool ToLocal(const HeightfieldRay& ray, LocalRay& local) const;
+    bool IntersectCell(int x, int z, const LocalRay& r, float t0, float t1, float& t) const;
+    bool Finish(const HeightfieldRay& ray, bool found, float t, HeightfieldHit& hit) const;
+    float Texel(int x, int z) const;
+
+private:
+    const float* mHeights = nullptr;
+    const HeightPyramid* mPyramid = nullptr;
+    UINT mWidth = 0;
+    UINT mHeight = 0;
+
+    float mTerrainSize = 0.0f;
+    float mMinHeight = 0.0f;
+    float mHeightScale = 1.0f;
+};
@@ -0,0 +1,201 @@
+//***************************************************************************************
+// HeightfieldSampler.cpp - Batched heightfield query implementation
+//***************************************************************************************
+
+#include "HeightfieldSampler.h"
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace
+{
+    HeightfieldSamples Offset(const HeightfieldSamples& out, size_t first)
+    {
+        HeightfieldSamples result;
+        result.Heights = out.Heights ? out.Heights + first : nullptr;
+        result.NormalX = out.NormalX ? out.NormalX + first : nullptr;
+        result.NormalY = out.NormalY ? out.NormalY + first : nullptr;
+        result.NormalZ = out.NormalZ ? out.NormalZ + first : nullptr;
+        result.Slopes = out.Slopes ? out.Slopes + first : nullptr;
+        return result;
+    }
+
+    void XM_CALLCONV Store(float* dst, FXMVECTOR v, size_t lanes)
+    {
+        if (!dst)
+            return;
+
+        if (lanes == 4)
+        {
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dst), v);
+            return;
+        }
+
+        XMFLOAT4 values;
+        XMStoreFloat4(&values, v);
+        const float* src = &values.x;
+        for (size_t k = 0; k < lanes; ++k)
+            dst[k] = src[k];
+    }
+}
+
+void HeightfieldSampler::Attach(const std::vector<float>& heights, UINT width, UINT height,
+                                float terrainSize, float minHeight, float maxHeight)
+{
+    if (width == 0 || height == 0 || heights.size() < (size_t)width * height)
+    {
+        Detach();
+        return;
+    }
+
+    mHeights = heights.data();
+    mWidth = width;
+    mHeight = height;
+    mTerrainSize = terrainSize;
+    mMinHeight = minHeight;
+    mMaxHeight = maxHeight;
+}
+
+void HeightfieldSampler::Detach()
+{
+    mHeights = nullptr;
+    mWidth = mHeight = 0;
+}
+
+XMVECTOR XM_CALLCONV HeightfieldSampler::Height4(FXMVECTOR x, FXMVECTOR z) const
+{
+    const XMVECTOR half = XMVectorReplicate(0.5f);
+    const XMVECTOR size = XMVectorReplicate(mTerrainSize);
+
+    // Same mapping and operation order as Terrain::GetHeight. Clamping to the last texel
+    // gives the same value the scalar path gets by clamping each texel index.
+    XMVECTOR u = XMVectorMultiply(XMVectorAdd(XMVectorDivide(x, size), half), XMVectorReplicate((float)mWidth));
+    XMVECTOR v = XMVectorMultiply(XMVectorAdd(XMVectorDivide(z, size), half), XMVectorReplicate((float)mHeight));
+    u = XMVectorClamp(u, XMVectorZero(), XMVectorReplicate((float)(mWidth - 1)));
+    v = XMVectorClamp(v, XMVectorZero(), XMVectorReplicate((float)(mHeight - 1)));
+
+    XMVECTOR u0 = XMVectorFloor(u);
+    XMVECTOR v0 = XMVectorFloor(v);
+    XMVECTOR fx = XMVectorSubtract(u, u0);
+    XMVECTOR fz = XMVectorSubtract(v, v0);
+
+    XMINT4 ix, iz;
+    XMStoreSInt4(&ix, XMConvertVectorFloatToInt(u0, 0));
+    XMStoreSInt4(&iz, XMConvertVectorFloatToInt(v0, 0));
+
+    // Gather the four corners lane by lane. The indices are clamped again so a NaN
+    // position reads a valid texel instead of arbitrary memory.
+    XMFLOAT4 h00, h10, h01, h11;
+    const int maxX = (int)mWidth - 1, maxZ = (int)mHeight - 1;
+    for (int k = 0; k < 4; ++k)
+    {
+        int x0 = max(0, min((&ix.x)[k], maxX));
+        int z0 = max(0, min((&iz.x)[k], maxZ));
+        int x1 = min(x0 + 1, maxX);
+        const float* row0 = mHeights + (size_t)z0 * mWidth;
+        const float* row1 = mHeights + (size_t)min(z0 + 1, maxZ) * mWidth;
+
+        (&h00.x)[k] = row0[x0];
+        (&h10.x)[k] = row0[x1];
+        (&h01.x)[k] = row1[x0];
+        (&h11.x)[k] = row1[x1];
+    }
+
+    XMVECTOR a = XMLoadFloat4(&h00);
+    XMVECTOR b = XMLoadFloat4(&h10);
+    XMVECTOR c = XMLoadFloat4(&h01);
+    XMVECTOR d = XMLoadFloat4(&h11);
+
+    XMVECTOR h0 = XMVectorAdd(a, XMVectorMultiply(XMVectorSubtract(b, a), fx));
+    XMVECTOR h1 = XMVectorAdd(c, XMVectorMultiply(XMVectorSubtract(d, c), fx));
+    XMVECTOR h = XMVectorAdd(h0, XMVectorMultiply(XMVectorSubtract(h1, h0), fz));
+
+    return XMVectorAdd(XMVectorReplicate(mMinHeight), XMVectorMultiply(h, XMVectorReplicate(mMaxHeight - mMinHeight)));
+}
+
+void XM_CALLCONV HeightfieldSampler::Sample4(FXMVECTOR x, FXMVECTOR z, const HeightfieldSamples& out,
+                                             size_t index, size_t lanes) const
+{
+    if (out.Heights)
+        Store(out.Heights + index, Height4(x, z), lanes);
+
+    bool wantNormal = out.NormalX && out.NormalY && out.NormalZ;
+    if (!wantNormal && !out.Slopes)
+        return;
+
+    // Central differences one texel apart, as in Terrain::GetNormal
+    float delta = mTerrainSize / mWidth;
+    XMVECTOR deltaV = XMVectorReplicate(delta);
+    XMVECTOR hL = Height4(XMVectorSubtract(x, deltaV), z);
+    XMVECTOR hR = Height4(XMVectorAdd(x, deltaV), z);
+    XMVECTOR hD = Height4(x, XMVectorSubtract(z, deltaV));
+    XMVECTOR hU = Height4(x, XMVectorAdd(z, deltaV));
+
+    XMVECTOR nx = XMVectorSubtract(hL, hR);
+    XMVECTOR ny = XMVectorReplicate(2.0f * delta);
+    XMVECTOR nz = XMVectorSubtract(hD, hU);
+    XMVECTOR horizontal = XMVectorAdd(XMVectorMultiply(nx, nx), XMVectorMultiply(nz, nz));
+
+    if (wantNormal)
+    {
+        XMVECTOR length = XMVectorSqrt(XMVectorAdd(horizontal, XMVectorMultiply(ny, ny)));
+        Store(out.NormalX + index, XMVectorDivide(nx, length), lanes);
+        Store(out.NormalY + index, XMVectorDivide(ny, length), lanes);
+        Store(out.NormalZ + index, XMVectorDivide(nz, length), lanes);
+    }
+
+    if (out.Slopes)
+        Store(out.Slopes + index, XMVectorDivide(XMVectorSqrt(horizontal), ny), lanes);
+}
+
+void HeightfieldSampler::Sample(const float* x, const float* z, size_t count, const HeightfieldSamples& out) const
+{
+    if (IsEmpty())
+    {
+        // Flat ground at zero, like Terrain::GetHeight without a heightmap
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (out.Heights) out.Heights[i] = 0.0f;
+            if (out.NormalX && out.NormalY && out.NormalZ)
+            {
+                out.NormalX[i] = 0.0f;
+                out.NormalY[i] = 1.0f;
+                out.NormalZ[i] = 0.0f;
+            }
+            if (out.Slopes) out.Slopes[i] = 0.0f;
+        }
+        return;
+    }
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        Sample4(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(x + i)),
+                XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(z + i)), out, i, 4);
+    }
+
+    if (i < count)
+    {
+        // Pad the last group with its final position; only the valid lanes are stored
+        XMFLOAT4 tailX, tailZ;
+        for (size_t k = 0; k < 4; ++k)
+        {
+            (&tailX.x)[k] = x[min(i + k, count - 1)];
+            (&tailZ.x)[k] = z[min(i + k, count - 1)];
+        }
+        Sample4(XMLoadFloat4(&tailX), XMLoadFloat4(&tailZ), out, i, count - i);
+    }
+}
+
+void HeightfieldSampler::SampleBatch(const float* x, const float* z, size_t count, const HeightfieldSamples& out) const
+{
+    // Multiple of 4 so only the final chunk has a partial group
+    const size_t chunkSize = 1024;
+    size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    concurrency::parallel_for(size_t(0), chunkCount, [&](size_t chunk)
+    {
+        size_t first = chunk * chunkSize;
+        Sample(x + first, z + first, min(chunkSize, count - first), Offset(out, first));
+    });
+}
@@ -0,0 +1,62 @@
+//***************************************************************************************
+// HeightfieldSampler.h - Batched height and normal queries on a bilinear heightfield
+//
+// Answers the same questions as Terrain::GetHeight and Terrain::GetNormal for whole
+// arrays of positions at once, for placing vegetation, projecting decals or moving
+// many agents. Positions come in as separate x and z arrays and are processed four at
+// a time with DirectXMath; the four texel fetches per corner are plain loads from
+// indices computed in vector registers. Heights match Terrain::GetHeight bit for bit.
+//
+// Positions off the heightfield are clamped to its edge, the same as the scalar path.
+// Like HeightfieldRayCaster the sampler only references the heights it is attached to
+// (the array the heightmap texture is uploaded from); the owner re-attaches whenever
+// they change.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/MathHelper.h"
+#include <vector>
+
+// Output arrays for HeightfieldSampler::Sample, each count long. Any of them may be
+// null to skip that result; the normal is written to all three or none.
+struct HeightfieldSamples
+{
+    float* Heights = nullptr;   // World space height
+    float* NormalX = nullptr;   // Unit surface normal
+    float* NormalY = nullptr;
+    float* NormalZ = nullptr;
+    float* Slopes = nullptr;    // Rise over run, 0 on flat ground
+};
+
+class HeightfieldSampler
+{
+public:
+    // Heights are normalized [0,1], row-major, spanning [-terrainSize/2, terrainSize/2]
+    // in x and z with texel i at u = i, like Terrain::GetHeight.
+    void Attach(const std::vector<float>& heights, UINT width, UINT height,
+                float terrainSize, float minHeight, float maxHeight);
+    void Detach();
+
+    bool IsEmpty() const { return mHeights == nullptr; }
+
+    // Samples count positions on the calling thread
+    void Sample(const float* x, const float* z, size_t count, const HeightfieldSamples& out) const;
+
+    // Sample split across worker threads
+    void SampleBatch(const float* x, const float* z, size_t count, const HeightfieldSamples& out) const;
+
+private:
+    DirectX::XMVECTOR XM_CALLCONV Height4(DirectX::FXMVECTOR x, DirectX::FXMVECTOR z) const;
+    void XM_CALLCONV Sample4(DirectX::FXMVECTOR x, DirectX::FXMVECTOR z, const HeightfieldSamples& out,
+                             size_t index, size_t lanes) const;
+
+private:
+    const float* mHeights = nullptr;
+    UINT mWidth = 0;
+    UINT mHeight = 0;
+
+    float mTerrainSize = 0.0f;
+    float mMinHeight = 0.0f;
+    float mMaxHeight = 0.0f;
+};
@@ -0,0 +1,299 @@
+//***************************************************************************************
+// NoiseGenerator.cpp - Seeded Perlin noise implementation
+//
+// The vector paths repeat the scalar arithmetic operation for operation (negation is
+// a sign flip either way), so both produce the same bits for the same input.
+//***************************************************************************************
+
+#include "NoiseGenerator.h"
+#include <ppl.h>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    // Domain offsets of the two warp fields, far enough apart to be uncorrelated
+    const float WarpOffsetX[2] = { 5.2f, 1.3f };
+    const float WarpOffsetZ[2] = { 1.7f, 9.2f };
+
+    float Fade(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+    float Lerp(float a, float b, float t) { return a + t * (b - a); }
+
+    float Grad(int hash, float x, float z)
+    {
+        int h = hash & 3;
+        float u = h < 2 ? x : z;
+        float v = h < 2 ? z : x;
+        return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+    }
+
+    XMVECTOR XM_CALLCONV Fade(FXMVECTOR t)
+    {
+        XMVECTOR inner = XMVectorAdd(XMVectorMultiply(t, XMVectorSubtract(
+            XMVectorMultiply(t, XMVectorReplicate(6.0f)), XMVectorReplicate(15.0f))), XMVectorReplicate(10.0f));
+        return XMVectorMultiply(XMVectorMultiply(XMVectorMultiply(t, t), t), inner);
+    }
+
+    XMVECTOR XM_CALLCONV Lerp(FXMVECTOR a, FXMVECTOR b, FXMVECTOR t)
+    {
+        return XMVectorAdd(a, XMVectorMultiply(t, XMVectorSubtract(b, a)));
+    }
+
+    // Grad for four lanes: the hash bits become a swap mask and two sign masks
+    XMVECTOR XM_CALLCONV Grad(const int* hashes, FXMVECTOR x, FXMVECTOR z)
+    {
+        XMUINT4 swap, signU, signV;
+        UINT* s = &swap.x;
+        UINT* su = &signU.x;
+        UINT* sv = &signV.x;
+        for (int i = 0; i < 4; ++i)
+        {
+            int h = hashes[i] & 3;
+            s[i] = (h < 2) ? 0u : 0xFFFFFFFFu;
+            su[i] = (h & 1) ? 0x80000000u : 0u;
+            sv[i] = (h & 2) ? 0x80000000u : 0u;
+        }
+
+        XMVECTOR swapMask = XMLoadUInt4(&swap);
+        XMVECTOR u = XMVectorSelect(x, z, swapMask);
+        XMVECTOR v = XMVectorSelect(z, x, swapMask);
+        return XMVectorAdd(XMVectorXorInt(u, XMLoadUInt4(&signU)), XMVectorXorInt(v, XMLoadUInt4(&signV)));
+    }
+}
+
+NoiseGenerator::NoiseGenerator(uint32_t seed)
+{
+    SetSeed(seed);
+}
+
+void NoiseGenerator::SetSeed(uint32_t seed)
+{
+    mSeed = seed;
+
+    // Fisher-Yates with a fixed LCG: std::shuffle's use of the engine differs between
+    // standard libraries, this does not
+    int p[256];
+    for (int i = 0; i < 256; ++i)
+        p[i] = i;
+
+    uint32_t state = seed * 2654435761u + 0x9E3779B9u;
+    for (int i = 255; i > 0; --i)
+    {
+        state = state * 1664525u + 1013904223u;
+        int j = (int)((state >> 8) % (uint32_t)(i + 1));
+        std::swap(p[i], p[j]);
+    }
+
+    for (int i = 0; i < 256; ++i)
+    {
+        mPermutation[i] = p[i];
+        mPermutation[256 + i] = p[i];
+    }
+}
+
+float NoiseGenerator::Perlin(float x, float z) const
+{
+    int X = (int)floorf(x) & 255;
+    int Z = (int)floorf(z) & 255;
+
+    x -= floorf(x);
+    z -= floorf(z);
+
+    float u = Fade(x);
+    float v = Fade(z);
+
+    int A = mPermutation[X] + Z;
+    int B = mPermutation[X + 1] + Z;
+
+    return Lerp(
+        Lerp(Grad(mPermutation[A], x, z), Grad(mPermutation[B], x - 1, z), u),
+        Lerp(Grad(mPermutation[A + 1], x, z - 1), Grad(mPermutation[B + 1], x - 1, z - 1), u),
+        v);
+}
+
+XMVECTOR XM_CALLCONV NoiseGenerator::Perlin4(FXMVECTOR xIn, FXMVECTOR zIn) const
+{
+    XMVECTOR fx = XMVectorFloor(xIn);
+    XMVECTOR fz = XMVectorFloor(zIn);
+
+    XMINT4 cellX, cellZ;
+    XMStoreSInt4(&cellX, XMConvertVectorFloatToInt(fx, 0));
+    XMStoreSInt4(&cellZ, XMConvertVectorFloatToInt(fz, 0));
+
+    // Table lookups stay scalar: four corner hashes per lane
+    int h00[4], h10[4], h01[4], h11[4];
+    const int* cx = &cellX.x;
+    const int* cz = &cellZ.x;
+    for (int i = 0; i < 4; ++i)
+    {
+        int X = cx[i] & 255;
+        int Z = cz[i] & 255;
+        int A = mPermutation[X] + Z;
+        int B = mPermutation[X + 1] + Z;
+        h00[i] = mPermutation[A];
+        h10[i] = mPermutation[B];
+        h01[i] = mPermutation[A + 1];
+        h11[i] = mPermutation[B + 1];
+    }
+
+    XMVECTOR one = XMVectorSplatOne();
+    XMVECTOR x = XMVectorSubtract(xIn, fx);
+    XMVECTOR z = XMVectorSubtract(zIn, fz);
+    XMVECTOR x1 = XMVectorSubtract(x, one);
+    XMVECTOR z1 = XMVectorSubtract(z, one);
+
+    XMVECTOR u = Fade(x);
+    XMVECTOR v = Fade(z);
+
+    return Lerp(
+        Lerp(Grad(h00, x, z), Grad(h10, x1, z), u),
+        Lerp(Grad(h01, x, z1), Grad(h11, x1, z1), u),
+        v);
+}
+
+float NoiseGenerator::Fbm(const NoiseDesc& desc, float x, float z) const
+{
+    float value = 0.0f, amplitude = 1.0f, frequency = 1.0f, amplitudeSum = 0.0f;
+    for (int o = 0; o < desc.Octaves; ++o)
+    {
+        value += Perlin(x * frequency, z * frequency) * amplitude;
+        amplitudeSum += amplitude;
+        amplitude *= desc.Gain;
+        frequency *= desc.Lacunarity;
+    }
+    return (amplitudeSum > 0.0f) ? value / amplitudeSum : 0.0f;
+}
+
+XMVECTOR XM_CALLCONV NoiseGenerator::Fbm4(const NoiseDesc& desc, FXMVECTOR x, FXMVECTOR z) const
+{
+    XMVECTOR value = XMVectorZero();
+    float amplitude = 1.0f, frequency = 1.0f, amplitudeSum = 0.0f;
+    for (int o = 0; o < desc.Octaves; ++o)
+    {
+        XMVECTOR f = XMVectorReplicate(frequency);
+        XMVECTOR n = Perlin4(XMVectorMultiply(x, f), XMVectorMultiply(z, f));
+        value = XMVectorAdd(value, XMVectorMultiply(n, XMVectorReplicate(amplitude)));
+        amplitudeSum += amplitude;
+        amplitude *= desc.Gain;
+        frequency *= desc.Lacunarity;
+    }
+    return (amplitudeSum > 0.0f) ? XMVectorDivide(value, XMVectorReplicate(amplitudeSum)) : XMVectorZero();
+}
+
+float NoiseGenerator::Ridged(const NoiseDesc& desc, float x, float z) const
+{
+    float value = 0.0f, amplitude = 1.0f, frequency = 1.0f, amplitudeSum = 0.0f;
+    for (int o = 0; o < desc.Octaves; ++o)
+    {
+        float n = 1.0f - fabsf(Perlin(x * frequency, z * frequency));
+        value += n * n * amplitude;
+        amplitudeSum += amplitude;
+        amplitude *= desc.Gain;
+        frequency *= desc.Lacunarity;
+    }
+    return (amplitudeSum > 0.0f) ? value / amplitudeSum * 2.0f - 1.0f : 0.0f;
+}
+
+XMVECTOR XM_CALLCONV NoiseGenerator::Ridged4(const NoiseDesc& desc, FXMVECTOR x, FXMVECTOR z) const
+{
+    XMVECTOR one = XMVectorSplatOne();
+    XMVECTOR value = XMVectorZero();
+    float amplitude = 1.0f, frequency = 1.0f, amplitudeSum = 0.0f;
+    for (int o = 0; o < desc.Octaves; ++o)
+    {
+        XMVECTOR f = XMVectorReplicate(frequency);
+        XMVECTOR n = XMVectorSubtract(one, XMVectorAbs(Perlin4(XMVectorMultiply(x, f), XMVectorMultiply(z, f))));
+        value = XMVectorAdd(value, XMVectorMultiply(XMVectorMultiply(n, n), XMVectorReplicate(amplitude)));
+        amplitudeSum += amplitude;
+        amplitude *= desc.Gain;
+        frequency *= desc.Lacunarity;
+    }
+    if (amplitudeSum <= 0.0f)
+        return XMVectorZero();
+
+    XMVECTOR normalized = XMVectorDivide(value, XMVectorReplicate(amplitudeSum));
+    return XMVectorSubtract(XMVectorMultiply(normalized, XMVectorReplicate(2.0f)), one);
+}
+
+float NoiseGenerator::Sample(const NoiseDesc& desc, float x, float z) const
+{
+    x *= desc.Frequency;
+    z *= desc.Frequency;
+
+    switch (desc.Type)
+    {
+    case NoiseType::Ridged:
+        return Ridged(desc, x, z);
+
+    case NoiseType::Warped:
+    {
+        float wx = Fbm(desc, x + WarpOffsetX[0], z + WarpOffsetX[1]);
+        float wz = Fbm(desc, x + WarpOffsetZ[0], z + WarpOffsetZ[1]);
+        return Fbm(desc, x + desc.WarpStrength * wx, z + desc.WarpStrength * wz);
+    }
+
+    default:
+        return Fbm(desc, x, z);
+    }
+}
+
+XMVECTOR XM_CALLCONV NoiseGenerator::Sample4(const NoiseDesc& desc, FXMVECTOR xIn, FXMVECTOR zIn) const
+{
+    XMVECTOR frequency = XMVectorReplicate(desc.Frequency);
+    XMVECTOR x = XMVectorMultiply(xIn, frequency);
+    XMVECTOR z = XMVectorMultiply(zIn, frequency);
+
+    switch (desc.Type)
+    {
+    case NoiseType::Ridged:
+        return Ridged4(desc, x, z);
+
+    case NoiseType::Warped:
+    {
+        XMVECTOR wx = Fbm4(desc, XMVectorAdd(x, XMVectorReplicate(WarpOffsetX[0])),
+                                 XMVectorAdd(z, XMVectorReplicate(WarpOffsetX[1])));
+        XMVECTOR wz = Fbm4(desc, XMVectorAdd(x, XMVectorReplicate(WarpOffsetZ[0])),
+                                 XMVectorAdd(z, XMVectorReplicate(WarpOffsetZ[1])));
+        XMVECTOR strength = XMVectorReplicate(desc.WarpStrength);
+        return Fbm4(desc, XMVectorAdd(x, XMVectorMultiply(strength, wx)),
+                          XMVectorAdd(z, XMVectorMultiply(strength, wz)));
+    }
+
+    default:
+        return Fbm4(desc, x, z);
+    }
+}
+
+void NoiseGenerator::Generate(const NoiseDesc& desc, int firstX, int firstZ, UINT width, UINT height,
+                              float texelSize, float* out) const
+{
+    // Blocks of rows keep each worker on contiguous output
+    const UINT rowsPerBlock = 8;
+    UINT blockCount = (height + rowsPerBlock - 1) / rowsPerBlock;
+
+    concurrency::parallel_for(0u, blockCount, [&](UINT block)
+    {
+        XMVECTOR texel = XMVectorReplicate(texelSize);
+        UINT rowEnd = min(height, (block + 1) * rowsPerBlock);
+
+        for (UINT row = block * rowsPerBlock; row < rowEnd; ++row)
+        {
+            XMVECTOR z = XMVectorReplicate((float)(firstZ + (int)row) * texelSize);
+            float* dst = out + (size_t)row * width;
+
+            for (UINT i = 0; i < width; i += 4)
+            {
+                int gx = firstX + (int)i;
+                XMVECTOR x = XMVectorMultiply(
+                    XMVectorSet((float)gx, (float)(gx + 1), (float)(gx + 2), (float)(gx + 3)), texel);
+
+                XMFLOAT4 values;
+                XMStoreFloat4(&values, Sample4(desc, x, z));
+                const float* v = &values.x;
+                for (UINT k = 0; k < 4 && i + k < width; ++k)
+                    dst[i + k] = v[k];
+            }
+        }
+    });
+}
@@ -0,0 +1,67 @@
+//***************************************************************************************
+// NoiseGenerator.h - Seeded Perlin noise and fractal heightfields
+//
+// The permutation table comes from a fixed integer generator, so a seed gives the same
+// heights on every run and machine. Regions are evaluated four samples at a time with
+// DirectXMath (SSE or NEON) and split into row blocks across worker threads; every
+// sample only depends on its own coordinate, so the result does not depend on the
+// thread count, and Sample() is the scalar reference for the same values.
+//
+// Coordinates are integer texel indices times a texel size, so a tile generated on its
+// own matches the same texels generated as part of a larger region bit for bit and
+// neighbouring tiles meet without seams.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/MathHelper.h"
+#include <cstdint>
+
+enum class NoiseType
+{
+    Fbm,        // Sum of octaves of Perlin noise
+    Ridged,     // Octaves of (1 - |noise|)^2: sharp crests
+    Warped      // fBm with its domain offset by two more fBm fields
+};
+
+struct NoiseDesc
+{
+    NoiseType Type = NoiseType::Fbm;
+    float Frequency = 4.0f;     // Cycles of the first octave per unit of coordinate
+    int Octaves = 6;
+    float Lacunarity = 2.0f;    // Frequency multiplier per octave
+    float Gain = 0.5f;          // Amplitude multiplier per octave
+    float WarpStrength = 0.5f;  // Warped only, in first-octave cycles
+};
+
+class NoiseGenerator
+{
+public:
+    explicit NoiseGenerator(uint32_t seed = 1337);
+
+    void SetSeed(uint32_t seed);
+    uint32_t GetSeed() const { return mSeed; }
+
+    // Single octave of 2D Perlin noise, roughly [-1, 1]
+    float Perlin(float x, float z) const;
+
+    // Scalar reference for one sample of the fractal, roughly [-1, 1]
+    float Sample(const NoiseDesc& desc, float x, float z) const;
+
+    // Fills width * height samples, row-major. Sample (i, j) is at
+    // ((firstX + i) * texelSize, (firstZ + j) * texelSize).
+    void Generate(const NoiseDesc& desc, int firstX, int firstZ, UINT width, UINT height,
+                  float texelSize, float* out) const;
+
+private:
+    float Fbm(const NoiseDesc& desc, float x, float z) const;
+    float Ridged(const NoiseDesc& desc, float x, float z) const;
+    DirectX::XMVECTOR XM_CALLCONV Perlin4(DirectX::FXMVECTOR x, DirectX::FXMVECTOR z) const;
+    DirectX::XMVECTOR XM_CALLCONV Fbm4(const NoiseDesc& desc, DirectX::FXMVECTOR x, DirectX::FXMVECTOR z) const;
+    DirectX::XMVECTOR XM_CALLCONV Ridged4(const NoiseDesc& desc, DirectX::FXMVECTOR x, DirectX::FXMVECTOR z) const;
+    DirectX::XMVECTOR XM_CALLCONV Sample4(const NoiseDesc& desc, DirectX::FXMVECTOR x, DirectX::FXMVECTOR z) const;
+
+private:
+    uint32_t mSeed = 0;
+    int mPermutation[512];
+};
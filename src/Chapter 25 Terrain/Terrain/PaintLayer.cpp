@@ -0,0 +1,173 @@
+//***************************************************************************************
+// PaintLayer.cpp - Tiled paint layer implementation
+//***************************************************************************************
+
+#include "PaintLayer.h"
+
+using namespace DirectX;
+
+PaintLayer::PaintLayer(UINT width, UINT height, UINT tileSize)
+    : mWidth(width), mHeight(height), mTileSize(max(4u, tileSize & ~3u))
+{
+    mTilesX = (mWidth + mTileSize - 1) / mTileSize;
+    mTilesY = (mHeight + mTileSize - 1) / mTileSize;
+    mTiles.resize((size_t)mTilesX * mTilesY);
+    mIsDirty.resize(mTiles.size(), false);
+}
+
+UINT* PaintLayer::AllocateTile(UINT tile)
+{
+    if (!mTiles[tile])
+    {
+        mTiles[tile].reset(new UINT[(size_t)mTileSize * mTileSize]());
+        ++mAllocatedTiles;
+    }
+    return mTiles[tile].get();
+}
+
+void PaintLayer::Paint(int centerX, int centerY, int radius, const XMFLOAT3& color, float strength)
+{
+    if (radius <= 0)
+        return;
+
+    // Brush bounding box clipped to the layer
+    int x0 = max(centerX - radius, 0), x1 = min(centerX + radius, (int)mWidth - 1);
+    int y0 = max(centerY - radius, 0), y1 = min(centerY + radius, (int)mHeight - 1);
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    const int tileSize = (int)mTileSize;
+    for (int ty = y0 / tileSize; ty <= y1 / tileSize; ++ty)
+    {
+        for (int tx = x0 / tileSize; tx <= x1 / tileSize; ++tx)
+        {
+            int tileX0 = max(x0, tx * tileSize), tileX1 = min(x1, tx * tileSize + tileSize - 1);
+            int tileY0 = max(y0, ty * tileSize), tileY1 = min(y1, ty * tileSize + tileSize - 1);
+
+            // Corner tiles of the box may miss the disc entirely; texels on its rim get
+            // no paint either
+            int nearX = max(tileX0, min(centerX, tileX1)) - centerX;
+            int nearY = max(tileY0, min(centerY, tileY1)) - centerY;
+            if (nearX * nearX + nearY * nearY >= radius * radius)
+                continue;
+
+            UINT tile = ty * mTilesX + tx;
+            bool changed = PaintTile(tile, tileX0, tileY0, tileX1, tileY1, centerX, centerY, radius, color, strength);
+
+            if (changed && !mIsDirty[tile])
+            {
+                mIsDirty[tile] = true;
+                mDirty.push_back(tile);
+            }
+        }
+    }
+}
+
+bool PaintLayer::PaintTile(UINT tile, int x0, int y0, int x1, int y1, int centerX, int centerY,
+                           int radius, const XMFLOAT3& color, float strength)
+{
+    UINT* data = AllocateTile(tile);
+    const int originX = (int)((tile % mTilesX) * mTileSize);
+    const int originY = (int)((tile / mTilesX) * mTileSize);
+
+    const XMVECTOR laneOffsets = XMVectorSet(0.0f, 1.0f, 2.0f, 3.0f);
+    const XMVECTOR one = XMVectorSplatOne();
+    const XMVECTOR scale = XMVectorReplicate(255.0f);
+    const XMVECTOR byteMask = XMVectorReplicateInt(0xFF);
+    const XMVECTOR radiusV = XMVectorReplicate((float)radius);
+    const XMVECTOR minX = XMVectorReplicate((float)x0);
+    const XMVECTOR maxX = XMVectorReplicate((float)x1);
+    const XMVECTOR centerXV = XMVectorReplicate((float)centerX);
+    const XMVECTOR strengthV = XMVectorReplicate(strength);
+    const XMVECTOR paintR = XMVectorReplicate(color.x);
+    const XMVECTOR paintG = XMVectorReplicate(color.y);
+    const XMVECTOR paintB = XMVectorReplicate(color.z);
+
+    // Groups of four texels start on a multiple of 4 within the tile, so a group never
+    // crosses the tile's row; lanes outside [x0, x1] are masked off
+    const int groupStart = x0 - ((x0 - originX) & 3);
+    bool changed = false;
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        float dy = (float)(y - centerY);
+        XMVECTOR dy2 = XMVectorReplicate(dy * dy);
+        UINT* row = data + (size_t)(y - originY) * mTileSize;
+
+        for (int x = groupStart; x <= x1; x += 4)
+        {
+            XMVECTOR px = XMVectorAdd(XMVectorReplicate((float)x), laneOffsets);
+            XMVECTOR dx = XMVectorSubtract(px, centerXV);
+            XMVECTOR distance = XMVectorSqrt(XMVectorAdd(XMVectorMultiply(dx, dx), dy2));
+
+            XMVECTOR inside = XMVectorAndInt(XMVectorLessOrEqual(distance, radiusV),
+                              XMVectorAndInt(XMVectorGreaterOrEqual(px, minX), XMVectorLessOrEqual(px, maxX)));
+            if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+                continue;
+
+            // Soft brush falloff
+            XMVECTOR alpha = XMVectorSubtract(one, XMVectorDivide(distance, radiusV));
+            alpha = XMVectorMultiply(alpha, alpha); // Quadratic falloff
+            XMVECTOR blend = XMVectorMultiply(alpha, strengthV);
+            XMVECTOR keep = XMVectorSubtract(one, blend);
+
+            // Unpack RGBA8: masking in place and converting with a power-of-two divide
+            // is the same as shifting each channel down first
+            XMVECTOR pixels = XMLoadInt4(reinterpret_cast<const uint32_t*>(row + x - originX));
+            XMVECTOR r = XMVectorDivide(XMConvertVectorUIntToFloat(XMVectorAndInt(pixels, byteMask), 0), scale);
+            XMVECTOR g = XMVectorDivide(XMConvertVectorUIntToFloat(
+                XMVectorAndInt(pixels, XMVectorReplicateInt(0xFF00)), 8), scale);
+            XMVECTOR b = XMVectorDivide(XMConvertVectorUIntToFloat(
+                XMVectorAndInt(pixels, XMVectorReplicateInt(0xFF0000)), 16), scale);
+            XMVECTOR a = XMVectorDivide(XMConvertVectorUIntToFloat(
+                XMVectorAndInt(pixels, XMVectorReplicateInt(0xFF000000)), 24), scale);
+
+            r = XMVectorAdd(XMVectorMultiply(r, keep), XMVectorMultiply(paintR, blend));
+            g = XMVectorAdd(XMVectorMultiply(g, keep), XMVectorMultiply(paintG, blend));
+            b = XMVectorAdd(XMVectorMultiply(b, keep), XMVectorMultiply(paintB, blend));
+            a = XMVectorMin(XMVectorAdd(a, blend), one);
+
+            // Truncate to bytes, then place each in its channel
+            XMVECTOR packed = XMConvertVectorFloatToUInt(XMVectorTruncate(XMVectorMultiply(r, scale)), 0);
+            packed = XMVectorOrInt(packed, XMConvertVectorFloatToUInt(XMVectorTruncate(XMVectorMultiply(g, scale)), 8));
+            packed = XMVectorOrInt(packed, XMConvertVectorFloatToUInt(XMVectorTruncate(XMVectorMultiply(b, scale)), 16));
+            packed = XMVectorOrInt(packed, XMConvertVectorFloatToUInt(XMVectorTruncate(XMVectorMultiply(a, scale)), 24));
+
+            XMVECTOR result = XMVectorSelect(pixels, packed, inside);
+            changed = changed || !XMVector4EqualInt(result, pixels);
+            XMStoreInt4(reinterpret_cast<uint32_t*>(row + x - originX), result);
+        }
+    }
+
+    return changed;
+}
+
+UINT PaintLayer::GetTexel(UINT x, UINT y) const
+{
+    if (x >= mWidth || y >= mHeight)
+        return 0;
+
+    UINT tile = (y / mTileSize) * mTilesX + x / mTileSize;
+    if (!mTiles[tile])
+        return 0;
+    return mTiles[tile][(size_t)(y % mTileSize) * mTileSize + x % mTileSize];
+}
+
+void PaintLayer::TakeDirtyTiles(UINT maxTiles, std::vector<UINT>& tiles)
+{
+    tiles.clear();
+    UINT count = min(maxTiles, (UINT)mDirty.size());
+    tiles.assign(mDirty.begin(), mDirty.begin() + count);
+    mDirty.erase(mDirty.begin(), mDirty.begin() + count);
+
+    for (UINT tile : tiles)
+        mIsDirty[tile] = false;
+}
+
+void PaintLayer::GetTileRect(UINT tile, UINT& x, UINT& y, UINT& width, UINT& height) const
+{
+    x = (tile % mTilesX) * mTileSize;
+    y = (tile / mTilesX) * mTileSize;
+    width = min(mTileSize, mWidth - x);
+    height = min(mTileSize, mHeight - y);
+}
@@ -0,0 +1,72 @@
+//***************************************************************************************
+// PaintLayer.h - Tiled RGBA paint layer for terrain painting
+//
+// The layer is split into square tiles that are only allocated once something is
+// painted on them; tiles never painted stay transparent black, which is also what a
+// freshly created texture holds, so they are never uploaded. Each brush stroke marks
+// the tiles whose texels it changed as dirty and the app uploads just those rectangles.
+//
+// The brush is rasterized four texels at a time with DirectXMath, so it runs on SSE
+// or NEON without separate code paths.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/MathHelper.h"
+#include <vector>
+#include <memory>
+
+class PaintLayer
+{
+public:
+    // Tile size must be a multiple of 4; 64 makes a tile row exactly one 256-byte
+    // upload pitch.
+    PaintLayer(UINT width, UINT height, UINT tileSize = 64);
+
+    PaintLayer(const PaintLayer& rhs) = delete;
+    PaintLayer& operator=(const PaintLayer& rhs) = delete;
+
+    // Soft round brush with quadratic falloff, centered on texel (centerX, centerY).
+    // Blends color into the layer with the given strength at the center.
+    void Paint(int centerX, int centerY, int radius, const DirectX::XMFLOAT3& color, float strength);
+
+    // Texel as R8G8B8A8 (R in the low byte)
+    UINT GetTexel(UINT x, UINT y) const;
+
+    // Removes up to maxTiles dirty tiles from the queue, oldest first
+    void TakeDirtyTiles(UINT maxTiles, std::vector<UINT>& tiles);
+
+    // Texel rectangle of a tile; edge tiles may be smaller than the tile size
+    void GetTileRect(UINT tile, UINT& x, UINT& y, UINT& width, UINT& height) const;
+
+    // TileSize * TileSize texels, row pitch TileSize; nullptr if never painted
+    const UINT* GetTileData(UINT tile) const { return mTiles[tile].get(); }
+
+    UINT GetWidth() const { return mWidth; }
+    UINT GetHeight() const { return mHeight; }
+    UINT GetTileSize() const { return mTileSize; }
+    UINT GetTilesX() const { return mTilesX; }
+    UINT GetTilesY() const { return mTilesY; }
+    UINT GetAllocatedTileCount() const { return mAllocatedTiles; }
+    UINT GetDirtyTileCount() const { return (UINT)mDirty.size(); }
+
+private:
+    UINT* AllocateTile(UINT tile);
+
+    // Returns whether any texel of the tile changed
+    bool PaintTile(UINT tile, int x0, int y0, int x1, int y1, int centerX, int centerY,
+                   int radius, const DirectX::XMFLOAT3& color, float strength);
+
+private:
+    UINT mWidth;
+    UINT mHeight;
+    UINT mTileSize;
+    UINT mTilesX;
+    UINT mTilesY;
+
+    std::vector<std::unique_ptr<UINT[]>> mTiles;   // Row major, nullptr = transparent
+    UINT mAllocatedTiles = 0;
+
+    std::vector<UINT> mDirty;                      // Tiles to upload, in the order painted
+    std::vector<bool> mIsDirty;
+};
@@ -3,37 +3,88 @@
 //***************************************************************************************
 
 #include "QuadTree.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 using namespace DirectX;
 
-// Check if AABB intersects with frustum (6 planes)
-bool BoundingBoxAABB::Intersects(const XMFLOAT4* frustumPlanes) const
-{
-    for (int i = 0; i < 6; ++i)
-    {
-        XMVECTOR plane = XMLoadFloat4(&frustumPlanes[i]);
-        
-        // Get the positive vertex (furthest along plane normal)
-        XMFLOAT3 positiveVertex;
-        positiveVertex.x = (frustumPlanes[i].x >= 0) ? (Center.x + Extents.x) : (Center.x - Extents.x);
-        positiveVertex.y = (frustumPlanes[i].y >= 0) ? (Center.y + Extents.y) : (Center.y - Extents.y);
-        positiveVertex.z = (frustumPlanes[i].z >= 0) ? (Center.z + Extents.z) : (Center.z - Extents.z);
-        
-        // If positive vertex is behind plane, box is outside frustum
-        float distance = frustumPlanes[i].x * positiveVertex.x +
-                        frustumPlanes[i].y * positiveVertex.y +
-                        frustumPlanes[i].z * positiveVertex.z +
-                        frustumPlanes[i].w;
-        
-        if (distance < 0)
-            return false;
+namespace
+{
+    // Where a level starts and stops morphing, as fractions of the way from the
+    // previous level's range to its own
+    const float MorphStartRatio = 0.66f;
+    const float MorphEndRatio = 0.99f;
+
+    // Tests four boxes against the frustum planes at once (one box per lane).
+    // visible: the box's positive vertex is in front of every plane;
+    // inside: the negative vertex is too, so nothing below the box needs testing.
+    void ClassifyBoxes(const XMFLOAT4& centerX, const XMFLOAT4& centerY, const XMFLOAT4& centerZ,
+                       const XMFLOAT4& extentX, const XMFLOAT4& extentY, const XMFLOAT4& extentZ,
+                       const XMFLOAT4* frustumPlanes, XMUINT4& visible, XMUINT4& inside)
+    {
+        XMVECTOR cx = XMLoadFloat4(&centerX);
+        XMVECTOR cy = XMLoadFloat4(&centerY);
+        XMVECTOR cz = XMLoadFloat4(&centerZ);
+        XMVECTOR ex = XMLoadFloat4(&extentX);
+        XMVECTOR ey = XMLoadFloat4(&extentY);
+        XMVECTOR ez = XMLoadFloat4(&extentZ);
+        XMVECTOR zero = XMVectorZero();
+
+        XMVECTOR anyOutside = XMVectorFalseInt();
+        XMVECTOR allInside = XMVectorTrueInt();
+
+        for (int i = 0; i < 6; ++i)
+        {
+            const XMFLOAT4& p = frustumPlanes[i];
+
+            // Signed distance of the centers, and the boxes' projected radius
+            XMVECTOR d = XMVectorMultiplyAdd(XMVectorReplicate(p.x), cx,
+                         XMVectorMultiplyAdd(XMVectorReplicate(p.y), cy,
+                         XMVectorMultiplyAdd(XMVectorReplicate(p.z), cz, XMVectorReplicate(p.w))));
+            XMVECTOR r = XMVectorMultiplyAdd(XMVectorReplicate(fabsf(p.x)), ex,
+                         XMVectorMultiplyAdd(XMVectorReplicate(fabsf(p.y)), ey,
+                         XMVectorMultiply(XMVectorReplicate(fabsf(p.z)), ez)));
+
+            anyOutside = XMVectorOrInt(anyOutside, XMVectorLess(XMVectorAdd(d, r), zero));
+            allInside = XMVectorAndInt(allInside, XMVectorGreaterOrEqual(XMVectorSubtract(d, r), zero));
+        }
+
+        XMStoreUInt4(&visible, XMVectorNotEqualInt(anyOutside, XMVectorTrueInt()));
+        XMStoreUInt4(&inside, allInside);
+    }
+
+    float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+    {
+        float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+        return sqrtf(dx * dx + dy * dy + dz * dz);
+    }
+
+    // Nearest and farthest distance from p to the box [lo, hi]
+    void BoxDistances(const XMFLOAT3& p, const XMFLOAT3& lo, const XMFLOAT3& hi, float& nearest, float& farthest)
+    {
+        const float* pv = &p.x;
+        const float* lv = &lo.x;
+        const float* hv = &hi.x;
+        float nearSq = 0.0f, farSq = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            float below = lv[i] - pv[i], above = pv[i] - hv[i];
+            float d = max(max(below, above), 0.0f);
+            float f = max(fabsf(below), fabsf(above));
+            nearSq += d * d;
+            farSq += f * f;
+        }
+        nearest = sqrtf(nearSq);
+        farthest = sqrtf(farSq);
     }
-    return true;
 }
 
 QuadTree::QuadTree()
-    : mTerrainSize(0), mMinNodeSize(0), mMaxLODLevels(0),
-      mVisibleNodeCount(0), mTotalNodeCount(0), mNextObjectCBIndex(0)
+    : mTerrainSize(0), mMinNodeSize(0), mMaxLODLevels(0), mFrame(0), mHasSelection(false),
+      mLastCameraPos(0, 0, 0), mVisibleNodeCount(0), mTotalNodeCount(0), mEvaluatedNodeCount(0),
+      mNextObjectCBIndex(0)
 {
 }
 
@@ -43,177 +94,498 @@ void QuadTree::Initialize(float terrainSize, float minNodeSize, int maxLODLevels
     mMinNodeSize = minNodeSize;
     mMaxLODLevels = maxLODLevels;
     mTotalNodeCount = 0;
-    
-    // Default LOD distances
-    if (mLODDistances.empty())
+
+    // Build the tree
+    BuildTree();
+}
+
+void QuadTree::BuildTree()
+{
+    mNodes.clear();
+    mVisible.clear();
+    mPrevVisible.clear();
+
+    TerrainNode root;
+    root.Size = mTerrainSize;
+    mNodes.push_back(root);
+
+    // Breadth-first: a node's children are appended together, after every node of
+    // the previous level, so each level is contiguous as well
+    for (size_t i = 0; i < mNodes.size(); ++i)
     {
-        mLODDistances.resize(maxLODLevels);
-        for (int i = 0; i < maxLODLevels; ++i)
+        TerrainNode& node = mNodes[i];
+        node.MinY = -10.0f;  // Default, will be updated from heightmap
+        node.MaxY = 110.0f;
+
+        // Level holds the depth until the pass below turns it around
+        if (node.Size > mMinNodeSize && node.Level < mMaxLODLevels - 1)
         {
-            mLODDistances[i] = minNodeSize * (float)(1 << (maxLODLevels - i - 1)) * 2.0f;
+            float x = node.X, z = node.Z;
+            float halfSize = node.Size * 0.5f;
+            float quarterSize = node.Size * 0.25f;
+            int depth = node.Level + 1;
+
+            node.IsLeaf = false;
+            node.FirstChild = (UINT)mNodes.size();
+
+            // Children: NW, NE, SW, SE
+            const float offsets[4][2] =
+            {
+                { -quarterSize,  quarterSize }, {  quarterSize,  quarterSize },
+                { -quarterSize, -quarterSize }, {  quarterSize, -quarterSize }
+            };
+            for (int c = 0; c < 4; ++c)
+            {
+                TerrainNode child;
+                child.X = x + offsets[c][0];
+                child.Z = z + offsets[c][1];
+                child.Size = halfSize;
+                child.Level = depth;
+                child.Parent = (UINT)i;
+                child.Quadrant = c;
+                mNodes.push_back(child); // May reallocate: node is not used after this
+            }
         }
     }
-    
-    // Build the tree
-    mRoot = std::make_unique<TerrainNode>();
-    BuildTree(mRoot.get(), 0.0f, 0.0f, terrainSize, 0);
-}
-
-void QuadTree::BuildTree(TerrainNode* node, float x, float z, float size, int depth)
-{
-    node->X = x;
-    node->Z = z;
-    node->Size = size;
-    node->LODLevel = depth;
-    node->MaxLOD = mMaxLODLevels - 1;
-    node->MinY = 0.0f;
-    node->MaxY = 100.0f; // Default, will be updated from heightmap
-    
-    // Setup bounding box
-    node->Bounds.Center = XMFLOAT3(x, (node->MinY + node->MaxY) * 0.5f, z);
-    node->Bounds.Extents = XMFLOAT3(size * 0.5f, (node->MaxY - node->MinY) * 0.5f + 10.0f, size * 0.5f);
-    
-    mTotalNodeCount++;
-    
-    // Check if we should subdivide
-    if (size > mMinNodeSize && depth < mMaxLODLevels - 1)
-    {
-        node->IsLeaf = false;
-        float halfSize = size * 0.5f;
-        float quarterSize = size * 0.25f;
-        
-        // Create children: NW, NE, SW, SE
-        node->Children[0] = std::make_unique<TerrainNode>();
-        node->Children[1] = std::make_unique<TerrainNode>();
-        node->Children[2] = std::make_unique<TerrainNode>();
-        node->Children[3] = std::make_unique<TerrainNode>();
-        
-        BuildTree(node->Children[0].get(), x - quarterSize, z + quarterSize, halfSize, depth + 1); // NW
-        BuildTree(node->Children[1].get(), x + quarterSize, z + quarterSize, halfSize, depth + 1); // NE
-        BuildTree(node->Children[2].get(), x - quarterSize, z - quarterSize, halfSize, depth + 1); // SW
-        BuildTree(node->Children[3].get(), x + quarterSize, z - quarterSize, halfSize, depth + 1); // SE
-    }
-    else
-    {
-        node->IsLeaf = true;
+
+    // Level counted so far is the depth; every leaf is at the same depth, so the
+    // last node's depth is the top level
+    int top = mNodes.back().Level;
+    for (auto& node : mNodes)
+    {
+        node.Level = top - node.Level;
+        node.LODLevel = node.Level;
+    }
+
+    mTotalNodeCount = (int)mNodes.size();
+    mChildBounds.resize((mNodes.size() - 1) / 4);
+    UpdateChildBounds();
+}
+
+void QuadTree::UpdateChildBounds()
+{
+    for (size_t i = 0; i < mNodes.size(); ++i)
+    {
+        const TerrainNode& node = mNodes[i];
+        if (node.IsLeaf)
+            continue;
+
+        ChildBounds& b = mChildBounds[ChildGroup(node)];
+        const TerrainNode* c = &mNodes[node.FirstChild];
+        b.CenterX = XMFLOAT4(c[0].X, c[1].X, c[2].X, c[3].X);
+        b.CenterZ = XMFLOAT4(c[0].Z, c[1].Z, c[2].Z, c[3].Z);
+        b.CenterY = XMFLOAT4((c[0].MinY + c[0].MaxY) * 0.5f, (c[1].MinY + c[1].MaxY) * 0.5f,
+                             (c[2].MinY + c[2].MaxY) * 0.5f, (c[3].MinY + c[3].MaxY) * 0.5f);
+        b.ExtentX = XMFLOAT4(c[0].Size * 0.5f, c[1].Size * 0.5f, c[2].Size * 0.5f, c[3].Size * 0.5f);
+        b.ExtentZ = b.ExtentX;
+        b.ExtentY = XMFLOAT4((c[0].MaxY - c[0].MinY) * 0.5f, (c[1].MaxY - c[1].MinY) * 0.5f,
+                             (c[2].MaxY - c[2].MinY) * 0.5f, (c[3].MaxY - c[3].MinY) * 0.5f);
+    }
+
+    // The range constraints depend on the bounds
+    UpdateLODRanges();
+    InvalidateSelection();
+}
+
+void QuadTree::SetLODRanges(const std::vector<float>& ranges)
+{
+    mRequestedRanges = ranges;
+    UpdateLODRanges();
+    InvalidateSelection();
+}
+
+void QuadTree::UpdateLODRanges()
+{
+    int levels = mNodes.empty() ? 0 : mNodes[0].Level + 1;
+
+    // Largest bounding box diagonal on each level
+    std::vector<float> diagonal(levels, 0.0f);
+    for (const auto& node : mNodes)
+    {
+        float height = node.MaxY - node.MinY;
+        diagonal[node.Level] = max(diagonal[node.Level], sqrtf(2.0f * node.Size * node.Size + height * height));
+    }
+
+    // An area drawn at level i reaches at most range i plus a diagonal from the camera,
+    // and every area drawn coarser than level i + 1 starts past range i + 1. Keeping
+    // range i + 1 two diagonals out means those never touch, and puts the start of
+    // level i + 1's morph past anything level i can reach.
+    mLODRanges.assign(levels, FLT_MAX);
+    for (int i = 0; i + 1 < levels; ++i)
+    {
+        float range = (i < (int)mRequestedRanges.size()) ? mRequestedRanges[i] : mMinNodeSize * (float)(2 << i);
+        if (i > 0)
+            range = max(range, mLODRanges[i - 1] + 2.0f * diagonal[i - 1] / MorphStartRatio);
+        mLODRanges[i] = max(range, 0.0f);
+    }
+}
+
+void QuadTree::GetMorphRange(int level, float& start, float& end) const
+{
+    if (level < 0 || level + 1 >= (int)mLODRanges.size())
+    {
+        start = end = FLT_MAX;
+        return;
     }
+
+    float previous = (level > 0) ? mLODRanges[level - 1] : 0.0f;
+    float range = mLODRanges[level];
+    start = previous + (range - previous) * MorphStartRatio;
+    end = previous + (range - previous) * MorphEndRatio;
+}
+
+std::vector<float> QuadTree::ComputeLODRanges(const std::vector<float>& levelErrors, float pixelError,
+                                              float viewportHeight, float fovY)
+{
+    // Pixels per world unit at distance 1
+    float projectionScale = viewportHeight / (2.0f * tanf(fovY * 0.5f));
+
+    std::vector<float> ranges(levelErrors.size(), FLT_MAX);
+    for (size_t i = 0; i + 1 < levelErrors.size(); ++i)
+        ranges[i] = levelErrors[i + 1] * projectionScale / pixelError;
+    return ranges;
+}
+
+void QuadTree::InvalidateSelection()
+{
+    // Reuse needs VisitedFrame == previous frame, which no node has after this
+    for (auto& node : mNodes)
+        node.VisitedFrame = 0;
+    mHasSelection = false;
 }
 
 void QuadTree::Update(const XMFLOAT3& cameraPos, const XMFLOAT4* frustumPlanes)
 {
-    mVisibleNodeCount = 0;
+    if (mNodes.empty())
+        return;
+
+    // Nothing moved: last frame's selection still holds
+    if (mHasSelection &&
+        memcmp(&cameraPos, &mLastCameraPos, sizeof(XMFLOAT3)) == 0 &&
+        memcmp(frustumPlanes, mLastPlanes, sizeof(mLastPlanes)) == 0)
+    {
+        mEvaluatedNodeCount = 0;
+        return;
+    }
+
+    mLastCameraPos = cameraPos;
+    memcpy(mLastPlanes, frustumPlanes, sizeof(mLastPlanes));
+    mHasSelection = true;
+
+    ++mFrame;
+    mVisible.swap(mPrevVisible);
+    mVisible.clear();
+    for (TerrainNode* node : mPrevVisible)
+        node->IsVisible = false;
+
     mNextObjectCBIndex = 0;
-    
-    if (mRoot)
+    mEvaluatedNodeCount = 0;
+
+    // Root: the same test as the children, with the root in every lane
+    const TerrainNode& root = mNodes[0];
+    float cy = (root.MinY + root.MaxY) * 0.5f, ey = (root.MaxY - root.MinY) * 0.5f, e = root.Size * 0.5f;
+    XMUINT4 visible, inside;
+    ClassifyBoxes(XMFLOAT4(root.X, root.X, root.X, root.X), XMFLOAT4(cy, cy, cy, cy),
+                  XMFLOAT4(root.Z, root.Z, root.Z, root.Z), XMFLOAT4(e, e, e, e),
+                  XMFLOAT4(ey, ey, ey, ey), XMFLOAT4(e, e, e, e), frustumPlanes, visible, inside);
+
+    mStack.clear();
+    if (visible.x)
+        mStack.push_back({ 0, inside.x != 0, false });
+
+    while (!mStack.empty())
     {
-        UpdateNode(mRoot.get(), cameraPos, frustumPlanes);
+        StackEntry entry = mStack.back();
+        mStack.pop_back();
+
+        if (entry.PostVisit)
+            FinishNode(entry.Node, cameraPos);
+        else
+            VisitNode(entry.Node, entry.Inside, cameraPos, frustumPlanes);
     }
+
+    mVisibleNodeCount = (int)mVisible.size();
 }
 
-void QuadTree::UpdateNode(TerrainNode* node, const XMFLOAT3& cameraPos, const XMFLOAT4* frustumPlanes)
+void QuadTree::VisitNode(UINT index, bool inside, const XMFLOAT3& cameraPos, const XMFLOAT4* frustumPlanes)
 {
-    // Frustum culling
-    node->IsVisible = node->Bounds.Intersects(frustumPlanes);
-    
-    if (!node->IsVisible)
+    if (ReuseSubtree(index, inside, cameraPos))
         return;
-    
-    // Calculate LOD based on distance
-    int desiredLOD = CalculateLOD(node, cameraPos);
-    node->LODLevel = desiredLOD;
-    
-    // Decide whether to use this node or subdivide
-    if (!node->IsLeaf && ShouldSubdivide(node, cameraPos))
-    {
-        // Use children instead
-        node->IsVisible = false;
-        for (int i = 0; i < 4; ++i)
+
+    TerrainNode& node = mNodes[index];
+    ++mEvaluatedNodeCount;
+
+    node.VisitedFrame = mFrame;
+    node.FirstVisible = (UINT)mVisible.size();
+    node.WasInside = inside;
+    node.LodOrigin = cameraPos;
+
+    // Split where the next finer level's range reaches the node
+    float slack = FLT_MAX;
+    if (node.IsLeaf || !InRange(node, mLODRanges[node.Level - 1], cameraPos, slack))
+    {
+        node.LodSlack = slack;
+        node.LODLevel = node.Level;
+        node.VisibleCount = 1;
+        SelectNode(node);
+        return;
+    }
+
+    node.LodSlack = slack;
+    mStack.push_back({ index, inside, true });
+
+    XMUINT4 visible = { 1, 1, 1, 1 };
+    XMUINT4 childInside = { 1, 1, 1, 1 };
+    if (!inside)
+    {
+        const ChildBounds& b = mChildBounds[ChildGroup(node)];
+        ClassifyBoxes(b.CenterX, b.CenterY, b.CenterZ, b.ExtentX, b.ExtentY, b.ExtentZ,
+                      frustumPlanes, visible, childInside);
+    }
+
+    // Children the finer range does not reach are drawn as quadrants of this node's grid
+    const UINT* v = &visible.x;
+    const UINT* in = &childInside.x;
+    bool visit[4] = {};
+    for (int c = 0; c < 4; ++c)
+    {
+        if (!v[c])
+            continue;
+
+        TerrainNode& child = mNodes[node.FirstChild + c];
+        float childSlack;
+        visit[c] = InRange(child, mLODRanges[node.Level - 1], cameraPos, childSlack);
+        node.LodSlack = min(node.LodSlack, childSlack);
+
+        if (!visit[c])
         {
-            if (node->Children[i])
-            {
-                UpdateNode(node->Children[i].get(), cameraPos, frustumPlanes);
-            }
+            child.LODLevel = node.Level;
+            SelectNode(child);
         }
     }
-    else
+
+    // Pushed in reverse so they are visited NW, NE, SW, SE
+    for (int c = 3; c >= 0; --c)
     {
-        // Use this node for rendering
-        node->ObjectCBIndex = mNextObjectCBIndex++;
-        mVisibleNodeCount++;
+        if (visit[c])
+            mStack.push_back({ node.FirstChild + c, in[c] != 0, false });
     }
 }
 
-int QuadTree::CalculateLOD(const TerrainNode* node, const XMFLOAT3& cameraPos) const
+void QuadTree::FinishNode(UINT index, const XMFLOAT3& cameraPos)
 {
-    // Calculate distance from camera to node center
-    float dx = cameraPos.x - node->X;
-    float dy = cameraPos.y - (node->MinY + node->MaxY) * 0.5f;
-    float dz = cameraPos.z - node->Z;
-    float distance = sqrtf(dx * dx + dy * dy + dz * dz);
-    
-    // Find appropriate LOD level
-    for (int i = 0; i < (int)mLODDistances.size(); ++i)
+    TerrainNode& node = mNodes[index];
+    node.VisibleCount = (UINT)mVisible.size() - node.FirstVisible;
+
+    // A subtree entirely inside was visited completely, so its slack is the least
+    // left over by any child (children reused from an earlier frame have moved on).
+    // Children drawn as quadrants were not visited; their test is in the node's slack.
+    if (node.WasInside)
     {
-        if (distance < mLODDistances[i])
-            return i;
+        for (int c = 0; c < 4; ++c)
+        {
+            const TerrainNode& child = mNodes[node.FirstChild + c];
+            if (child.VisitedFrame == mFrame)
+                node.LodSlack = min(node.LodSlack, child.LodSlack - Distance(cameraPos, child.LodOrigin));
+        }
     }
-    return mMaxLODLevels - 1;
 }
 
-bool QuadTree::ShouldSubdivide(const TerrainNode* node, const XMFLOAT3& cameraPos) const
+bool QuadTree::ReuseSubtree(UINT index, bool inside, const XMFLOAT3& cameraPos)
 {
-    if (node->IsLeaf)
+    TerrainNode& node = mNodes[index];
+
+    // Last frame's range only covers the whole selection if nothing in it was culled
+    // then or now, and the camera has not crossed any of the subtree's thresholds
+    if (!inside || !node.WasInside || node.VisitedFrame + 1 != mFrame ||
+        Distance(cameraPos, node.LodOrigin) >= node.LodSlack)
+    {
         return false;
-    
-    // Calculate distance
-    float dx = cameraPos.x - node->X;
-    float dz = cameraPos.z - node->Z;
-    float distance = sqrtf(dx * dx + dz * dz);
-    
-    // Subdivide if camera is close enough
-    // Use node size as threshold - subdivide when distance < size * factor
-    return distance < node->Size * 1.5f;
+    }
+
+    UINT first = (UINT)mVisible.size();
+    for (UINT i = 0; i < node.VisibleCount; ++i)
+        SelectNode(*mPrevVisible[node.FirstVisible + i]);
+
+    node.VisitedFrame = mFrame;
+    node.FirstVisible = first;
+    return true;
+}
+
+void QuadTree::SelectNode(TerrainNode& node)
+{
+    node.IsVisible = true;
+    node.ObjectCBIndex = mNextObjectCBIndex++;
+    mVisible.push_back(&node);
+}
+
+bool QuadTree::InRange(const TerrainNode& node, float range, const XMFLOAT3& cameraPos, float& slack) const
+{
+    // Distance from the camera to the node's bounds; it changes no faster than the
+    // camera moves, so the answer holds until the camera has moved by the slack
+    float nearest, farthest;
+    float halfSize = node.Size * 0.5f;
+    BoxDistances(cameraPos, XMFLOAT3(node.X - halfSize, node.MinY, node.Z - halfSize),
+                 XMFLOAT3(node.X + halfSize, node.MaxY, node.Z + halfSize), nearest, farthest);
+
+    slack = fabsf(nearest - range);
+    return nearest <= range;
 }
 
 void QuadTree::GetVisibleNodes(std::vector<TerrainNode*>& outNodes)
 {
-    outNodes.clear();
-    outNodes.reserve(mVisibleNodeCount);
-    
-    if (mRoot)
+    outNodes.assign(mVisible.begin(), mVisible.end());
+}
+
+QuadTree::SelectionCheck QuadTree::CheckSelection(const XMFLOAT3& cameraPos) const
+{
+    SelectionCheck check;
+    if (mNodes.empty())
+        return check;
+
+    // Which selected area covers each leaf-sized cell (-1: culled)
+    const int cells = 1 << mNodes[0].Level;
+    const float cellSize = mTerrainSize / cells;
+    const float half = mTerrainSize * 0.5f;
+    std::vector<int> owner((size_t)cells * cells, -1);
+
+    for (size_t i = 0; i < mVisible.size(); ++i)
+    {
+        const TerrainNode& node = *mVisible[i];
+        int x0 = (int)((node.X - node.Size * 0.5f + half) / cellSize + 0.5f);
+        int z0 = (int)((node.Z - node.Size * 0.5f + half) / cellSize + 0.5f);
+        int count = (int)(node.Size / cellSize + 0.5f);
+        for (int z = z0; z < z0 + count; ++z)
+        {
+            for (int x = x0; x < x0 + count; ++x)
+                owner[(size_t)z * cells + x] = (int)i;
+        }
+    }
+
+    auto checkEdge = [&](int a, int b, float x0, float z0, float x1, float z1)
+    {
+        if (a < 0 || b < 0 || a == b)
+            return;
+
+        const TerrainNode& na = *mVisible[a];
+        const TerrainNode& nb = *mVisible[b];
+        ++check.SharedEdges;
+
+        int difference = abs(na.LODLevel - nb.LODLevel);
+        check.MaxLODDifference = max(check.MaxLODDifference, difference);
+        if (difference != 1)
+            return;
+
+        // Heights on the edge lie in both areas' ranges. The finer side must have
+        // finished morphing everywhere on it, the coarser not have started.
+        const TerrainNode& fine = (na.LODLevel < nb.LODLevel) ? na : nb;
+        const TerrainNode& coarse = (na.LODLevel < nb.LODLevel) ? nb : na;
+        float minY = max(na.MinY, nb.MinY), maxY = min(na.MaxY, nb.MaxY);
+        if (minY > maxY)
+        {
+            minY = min(na.MinY, nb.MinY);
+            maxY = max(na.MaxY, nb.MaxY);
+        }
+
+        float nearest, farthest;
+        BoxDistances(cameraPos, XMFLOAT3(x0, minY, z0), XMFLOAT3(x1, maxY, z1), nearest, farthest);
+
+        float fineStart, fineEnd, coarseStart, coarseEnd;
+        GetMorphRange(fine.LODLevel, fineStart, fineEnd);
+        GetMorphRange(coarse.LODLevel, coarseStart, coarseEnd);
+        if (nearest < fineEnd || farthest > coarseStart)
+            ++check.MorphGaps;
+    };
+
+    for (int z = 0; z < cells; ++z)
     {
-        CollectVisibleNodes(mRoot.get(), outNodes);
+        for (int x = 0; x < cells; ++x)
+        {
+            int here = owner[(size_t)z * cells + x];
+            float x0 = x * cellSize - half, z0 = z * cellSize - half;
+            if (x + 1 < cells)
+                checkEdge(here, owner[(size_t)z * cells + x + 1], x0 + cellSize, z0, x0 + cellSize, z0 + cellSize);
+            if (z + 1 < cells)
+                checkEdge(here, owner[(size_t)(z + 1) * cells + x], x0, z0 + cellSize, x0 + cellSize, z0 + cellSize);
+        }
     }
+
+    return check;
 }
 
-void QuadTree::CollectVisibleNodes(TerrainNode* node, std::vector<TerrainNode*>& outNodes)
+void QuadTree::SetHeightRange(float x, float z, float size, float minY, float maxY)
 {
-    if (node->IsVisible)
+    if (mNodes.empty())
+        return;
+
+    float halfSize = size * 0.5f;
+    float x0 = x - halfSize, x1 = x + halfSize;
+    float z0 = z - halfSize, z1 = z + halfSize;
+
+    // Children come after their parents, so walking backwards finishes every
+    // child before the parent merges it
+    for (size_t i = mNodes.size(); i-- > 0;)
     {
-        outNodes.push_back(node);
+        TerrainNode& node = mNodes[i];
+        float nodeHalf = node.Size * 0.5f;
+        float nx0 = node.X - nodeHalf, nx1 = node.X + nodeHalf;
+        float nz0 = node.Z - nodeHalf, nz1 = node.Z + nodeHalf;
+
+        // No overlap: keep the current range
+        if (nx1 <= x0 || nx0 >= x1 || nz1 <= z0 || nz0 >= z1)
+            continue;
+
+        // Fully inside: the region's range applies to the node (and, already, its children)
+        if (nx0 >= x0 && nx1 <= x1 && nz0 >= z0 && nz1 <= z1)
+            SetNodeHeightRange(node, minY, maxY);
+        // Partial overlap: a leaf has to cover both, a parent is rebuilt from its children
+        else if (node.IsLeaf)
+            SetNodeHeightRange(node, min(node.MinY, minY), max(node.MaxY, maxY));
+        else
+            MergeChildHeightRanges(node);
     }
-    else if (!node->IsLeaf)
+
+    UpdateChildBounds();
+}
+
+void QuadTree::UpdateHeightRanges(const HeightRangeQuery& query)
+{
+    // Leaves are queried; the union of the children is at least as tight as querying
+    // the parent's region
+    for (size_t i = mNodes.size(); i-- > 0;)
     {
-        // Check children
-        for (int i = 0; i < 4; ++i)
+        TerrainNode& node = mNodes[i];
+        if (node.IsLeaf)
         {
-            if (node->Children[i])
-            {
-                CollectVisibleNodes(node->Children[i].get(), outNodes);
-            }
+            float minY = 0.0f, maxY = 0.0f;
+            query(node.X, node.Z, node.Size, minY, maxY);
+            SetNodeHeightRange(node, minY, maxY);
+        }
+        else
+        {
+            MergeChildHeightRanges(node);
         }
     }
+
+    UpdateChildBounds();
 }
 
-void QuadTree::SetHeightRange(float x, float z, float size, float minY, float maxY)
+void QuadTree::MergeChildHeightRanges(TerrainNode& node)
 {
-    // TODO: Update height range for nodes in the specified region
-    // For now, just update root
-    if (mRoot)
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    for (int c = 0; c < 4; ++c)
     {
-        mRoot->MinY = minY;
-        mRoot->MaxY = maxY;
-        mRoot->Bounds.Center.y = (minY + maxY) * 0.5f;
-        mRoot->Bounds.Extents.y = (maxY - minY) * 0.5f + 10.0f;
+        const TerrainNode& child = mNodes[node.FirstChild + c];
+        minY = min(minY, child.MinY);
+        maxY = max(maxY, child.MaxY);
     }
+
+    SetNodeHeightRange(node, minY, maxY);
+}
+
+void QuadTree::SetNodeHeightRange(TerrainNode& node, float minY, float maxY)
+{
+    node.MinY = minY;
+    node.MaxY = maxY;
 }
@@ -2,26 +2,29 @@
 // QuadTree.h - QuadTree for terrain LOD management
 //
 // Implements a quadtree structure for:
-// - Level of Detail (LOD) selection based on camera distance
+// - Continuous distance-based LOD selection (CDLOD)
 // - Frustum culling for efficient rendering
 // - Terrain tile management
+//
+// Every node is drawn with the same grid mesh, so a node's level is its depth counted
+// from the leaves. Each level has a range: a node is split where the sphere of the
+// next finer level's range reaches its bounds, and a child outside that sphere is
+// drawn as a quadrant of its parent's grid. Within a level's range vertices morph
+// towards the next coarser grid, finishing before the boundary, so neighbours always
+// differ by at most one level and meet without cracks (see SetLODRanges).
+//
+// Nodes are stored in one array in breadth-first order, so the four children of a
+// node are adjacent and can be frustum tested together. Selection is incremental:
+// a subtree that was entirely inside the frustum and whose LOD decisions cannot have
+// changed since the camera last moved reuses last frame's result.
 //***************************************************************************************
 
 #pragma once
 
-#include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
 #include <vector>
 #include <memory>
-
-// Bounding box for frustum culling
-struct BoundingBoxAABB
-{
-    DirectX::XMFLOAT3 Center;
-    DirectX::XMFLOAT3 Extents;
-    
-    bool Intersects(const DirectX::XMFLOAT4* frustumPlanes) const;
-};
+#include <functional>
 
 // Single terrain node in the quadtree
 struct TerrainNode
@@ -29,23 +32,34 @@ struct TerrainNode
     // Position and size
     float X, Z;           // World position (center)
     float Size;           // Size of this node
-    int LODLevel;         // Current LOD level (0 = highest detail)
-    int MaxLOD;           // Maximum LOD level for this node
-    
-    // Bounding box for culling
-    BoundingBoxAABB Bounds;
     float MinY, MaxY;     // Height range
-    
+    int Level;            // Level of the node's own grid: 0 for leaves, one more per level up
+    int LODLevel;         // Level drawn at when selected: Level, or Level + 1 when drawn
+                          // as a quadrant of the parent's grid
+
     // Tree structure
     bool IsLeaf;
-    std::unique_ptr<TerrainNode> Children[4]; // NW, NE, SW, SE
-    
+    UINT FirstChild;      // Index of the first of the four children (NW, NE, SW, SE), 0 for leaves
+    UINT Parent;          // Index of the parent, 0 for the root
+    int Quadrant;         // Which of the parent's children this is (0-3), -1 for the root
+
     // Rendering
-    bool IsVisible;       // After frustum culling
+    bool IsVisible;       // Selected for rendering this frame
     UINT ObjectCBIndex;   // Index in constant buffer
-    
-    TerrainNode() : X(0), Z(0), Size(0), LODLevel(0), MaxLOD(0),
-                   MinY(0), MaxY(0), IsLeaf(true), IsVisible(false), ObjectCBIndex(0) {}
+
+    // Incremental selection: where the subtree was last evaluated, how far the camera
+    // can move from there before any LOD decision inside it may change, and where its
+    // selected nodes ended up in that frame's list
+    DirectX::XMFLOAT3 LodOrigin;
+    float LodSlack;
+    UINT VisitedFrame;
+    UINT FirstVisible;
+    UINT VisibleCount;
+    bool WasInside;       // Subtree was entirely inside the frustum when evaluated
+
+    TerrainNode() : X(0), Z(0), Size(0), MinY(0), MaxY(0), Level(0), LODLevel(0), IsLeaf(true), FirstChild(0),
+                   Parent(0), Quadrant(-1), IsVisible(false), ObjectCBIndex(0), LodOrigin(0, 0, 0), LodSlack(0),
+                   VisitedFrame(0), FirstVisible(0), VisibleCount(0), WasInside(false) {}
 };
 
 class QuadTree
@@ -53,44 +67,113 @@ class QuadTree
 public:
     QuadTree();
     ~QuadTree() = default;
-    
+
     // Initialize the quadtree
     void Initialize(float terrainSize, float minNodeSize, int maxLODLevels);
-    
+
     // Update LOD based on camera position
     void Update(const DirectX::XMFLOAT3& cameraPos, const DirectX::XMFLOAT4* frustumPlanes);
-    
-    // Get visible nodes for rendering
+
+    // Get visible nodes for rendering. A node whose LODLevel is above its Level stands
+    // for that quadrant of its parent's grid.
     void GetVisibleNodes(std::vector<TerrainNode*>& outNodes);
-    
+    const TerrainNode& GetNode(UINT index) const { return mNodes[index]; }
+
     // Set height range for a region (call after loading heightmap)
     void SetHeightRange(float x, float z, float size, float minY, float maxY);
-    
+
+    // Returns the height range under a square region (center x,z)
+    using HeightRangeQuery = std::function<void(float x, float z, float size, float& minY, float& maxY)>;
+
+    // Fit every node's MinY/MaxY and bounds: leaves are queried, parents merge their children
+    void UpdateHeightRanges(const HeightRangeQuery& query);
+
     // Statistics
     int GetVisibleNodeCount() const { return mVisibleNodeCount; }
     int GetTotalNodeCount() const { return mTotalNodeCount; }
-    
-    // LOD distance thresholds
-    void SetLODDistances(const std::vector<float>& distances) { mLODDistances = distances; }
-    
+    int GetEvaluatedNodeCount() const { return mEvaluatedNodeCount; } // LOD decisions made last Update
+
+    // Requested range of each level, finest first. Ranges are raised where needed so
+    // that neighbouring nodes differ by at most one level and a node has finished
+    // morphing where it meets a coarser neighbour; the top level's range is unbounded.
+    void SetLODRanges(const std::vector<float>& ranges);
+    const std::vector<float>& GetLODRanges() const { return mLODRanges; }
+    int GetLevelCount() const { return (int)mLODRanges.size(); }
+
+    // Distances from the camera over which vertices of a level morph to the next
+    // coarser grid (both FLT_MAX for the top level, which never morphs)
+    void GetMorphRange(int level, float& start, float& end) const;
+
+    // Ranges where each level's error projects to pixelError pixels. levelErrors[i] is
+    // the world-space height error of drawing with the level i grid; level i is drawn
+    // from range i-1 outwards, so that range is where its error becomes acceptable.
+    static std::vector<float> ComputeLODRanges(const std::vector<float>& levelErrors, float pixelError,
+                                               float viewportHeight, float fovY);
+
+    // Checks the current selection: the largest level difference between areas sharing
+    // an edge, and how many shared edges a finer area might reach before it has fully
+    // morphed, or a coarser one after it has started to
+    struct SelectionCheck
+    {
+        int MaxLODDifference = 0;
+        UINT SharedEdges = 0;
+        UINT MorphGaps = 0;
+    };
+    SelectionCheck CheckSelection(const DirectX::XMFLOAT3& cameraPos) const;
+
 private:
-    void BuildTree(TerrainNode* node, float x, float z, float size, int depth);
-    void UpdateNode(TerrainNode* node, const DirectX::XMFLOAT3& cameraPos, 
+    // Bounds of a node's four children, one lane per child, for SIMD frustum tests
+    struct ChildBounds
+    {
+        DirectX::XMFLOAT4 CenterX, CenterY, CenterZ;
+        DirectX::XMFLOAT4 ExtentX, ExtentY, ExtentZ;
+    };
+
+    struct StackEntry
+    {
+        UINT Node;
+        bool Inside;          // Entirely inside the frustum, children need no test
+        bool PostVisit;       // Children done: finish the node's subtree bookkeeping
+    };
+
+    // Children are allocated four at a time after the root
+    static UINT ChildGroup(const TerrainNode& node) { return (node.FirstChild - 1) / 4; }
+
+    void BuildTree();
+    void VisitNode(UINT index, bool inside, const DirectX::XMFLOAT3& cameraPos,
                    const DirectX::XMFLOAT4* frustumPlanes);
-    void CollectVisibleNodes(TerrainNode* node, std::vector<TerrainNode*>& outNodes);
-    int CalculateLOD(const TerrainNode* node, const DirectX::XMFLOAT3& cameraPos) const;
-    bool ShouldSubdivide(const TerrainNode* node, const DirectX::XMFLOAT3& cameraPos) const;
-    
+    void FinishNode(UINT index, const DirectX::XMFLOAT3& cameraPos);
+    bool ReuseSubtree(UINT index, bool inside, const DirectX::XMFLOAT3& cameraPos);
+    void SelectNode(TerrainNode& node);
+    bool InRange(const TerrainNode& node, float range, const DirectX::XMFLOAT3& cameraPos, float& slack) const;
+    void UpdateLODRanges();
+    void SetNodeHeightRange(TerrainNode& node, float minY, float maxY);
+    void MergeChildHeightRanges(TerrainNode& node);
+    void UpdateChildBounds();
+    void InvalidateSelection();
+
 private:
-    std::unique_ptr<TerrainNode> mRoot;
-    
+    std::vector<TerrainNode> mNodes;           // Breadth-first, root at 0
+    std::vector<ChildBounds> mChildBounds;     // Per group of four siblings
+
     float mTerrainSize;
     float mMinNodeSize;
     int mMaxLODLevels;
-    
-    std::vector<float> mLODDistances; // Distance thresholds for each LOD level
-    
+
+    std::vector<float> mRequestedRanges;       // As given to SetLODRanges
+    std::vector<float> mLODRanges;             // Per level, finest first, after the constraints
+
+    // Selection state
+    std::vector<TerrainNode*> mVisible;        // This frame's selection, in draw order
+    std::vector<TerrainNode*> mPrevVisible;    // Last frame's, source for reused subtrees
+    std::vector<StackEntry> mStack;
+    UINT mFrame;
+    bool mHasSelection;
+    DirectX::XMFLOAT3 mLastCameraPos;
+    DirectX::XMFLOAT4 mLastPlanes[6];
+
     int mVisibleNodeCount;
     int mTotalNodeCount;
+    int mEvaluatedNodeCount;
     UINT mNextObjectCBIndex;
 };
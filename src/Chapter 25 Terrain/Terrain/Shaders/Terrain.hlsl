@@ -20,8 +20,8 @@ cbuffer cbPerObject : register(b0)
     float4x4 gTexTransform;
     uint gMaterialIndex;
     uint gLODLevel;
-    uint gObjPad1;
-    uint gObjPad2;
+    float gMorphStart;
+    float gMorphEnd;
 };
 
 cbuffer cbPass : register(b1)
@@ -52,6 +52,9 @@ cbuffer cbTerrain : register(b2)
     float gTerrainSize;
     float gTexelSize;
     float2 gHeightMapSize;
+    float2 gTileCount;
+    uint gStreamingEnabled;
+    float gGridResolution;
     float2 gTerrainPadding;
 };
 
@@ -60,6 +63,11 @@ Texture2D gDiffuseMap : register(t1);
 Texture2D gNormalMap : register(t2);
 Texture2D gPaintMap : register(t3);
 
+// Streamed detail heights (see TileStreamer)
+Texture2D gTilePageTable : register(t4);
+Texture2D gTileAtlas : register(t5);
+Texture2D gTileBaseMap : register(t6);
+
 SamplerState gsamLinearWrap : register(s0);
 SamplerState gsamLinearClamp : register(s1);
 
@@ -78,10 +86,43 @@ struct VertexOut
     float2 TexC : TEXCOORD;
 };
 
+// Normalized height of one streamed tile: from its atlas slot, or from the
+// resident base level when the page table has no slot for it
+float SampleTileHeight(int2 tile, float2 uv)
+{
+    float4 page = gTilePageTable.Load(int3(tile, 0));
+    if (page.x > 0.0f)
+    {
+        float2 tileUV = uv * gTileCount - tile;
+        return gTileAtlas.SampleLevel(gsamLinearClamp, page.zw + tileUV * page.xy, 0).r;
+    }
+    return gTileBaseMap.SampleLevel(gsamLinearClamp, uv, 0).r;
+}
+
+float SampleStreamedHeight(float2 uv)
+{
+    float2 t = uv * gTileCount;
+    int2 tile = min((int2)t, (int2)gTileCount - 1);
+    
+    // Vertices on a tile edge average the tiles sharing it, so neighbours
+    // showing different mip levels still meet without cracks
+    float2 edge = round(t);
+    bool2 onEdge = abs(t - edge) < 1e-4 && edge > 0.0f && edge < gTileCount;
+    if (!any(onEdge))
+        return SampleTileHeight(tile, uv);
+    
+    int2 lo = onEdge ? (int2)edge - 1 : tile;
+    int2 hi = onEdge ? (int2)edge : tile;
+    return 0.25f * (SampleTileHeight(lo, uv) + SampleTileHeight(int2(hi.x, lo.y), uv) +
+                    SampleTileHeight(int2(lo.x, hi.y), uv) + SampleTileHeight(hi, uv));
+}
+
 // Sample height from heightmap
 float SampleHeight(float2 uv)
 {
-    float h = gHeightMap.SampleLevel(gsamLinearClamp, saturate(uv), 0).r;
+    uv = saturate(uv);
+    float h = gStreamingEnabled ? SampleStreamedHeight(uv)
+                                : gHeightMap.SampleLevel(gsamLinearClamp, uv, 0).r;
     return gMinHeight + saturate(h) * (gMaxHeight - gMinHeight);
 }
 
@@ -103,26 +144,34 @@ float3 CalculateNormal(float2 uv)
     return normalize(normal);
 }
 
+// World position of a grid vertex: local UV is in [0,1] over the node's grid
+float4 GridToWorld(float2 localUV, out float2 globalUV)
+{
+    // gTexTransform contains scale and offset to map local UV to global terrain UV
+    globalUV = mul(float4(localUV, 0.0f, 1.0f), gTexTransform).xy;
+    
+    // Local position (mesh is centered at origin, unit size)
+    float4 posW = mul(float4(localUV.x - 0.5f, 0.0f, localUV.y - 0.5f, 1.0f), gWorld);
+    posW.y = SampleHeight(globalUV);
+    return posW;
+}
+
 VertexOut VS(VertexIn vin)
 {
     VertexOut vout;
     
-    // Transform UV using texture transform (for QuadTree node UV mapping)
-    // gTexTransform contains scale and offset to map local UV to global terrain UV
+    // Morph toward the next coarser grid with distance: odd vertices slide onto their
+    // even neighbours, so at the end of the morph range the node matches a coarser
+    // neighbour along their shared edge
     float2 localUV = vin.TexC;
-    float4 transformedUV = mul(float4(localUV, 0.0f, 1.0f), gTexTransform);
-    float2 globalUV = transformedUV.xy;
+    float2 globalUV;
+    float distance = length(GridToWorld(localUV, globalUV).xyz - gEyePosW);
+    float morph = saturate((distance - gMorphStart) / max(gMorphEnd - gMorphStart, 1e-4f));
     
-    // Sample height using global UV
-    float height = SampleHeight(globalUV);
-    
-    // Local position (mesh is centered at origin, unit size)
-    float3 posL = vin.PosL;
-    posL.y = 0;
+    float2 oddOffset = frac(localUV * gGridResolution * 0.5f) * 2.0f / gGridResolution;
+    localUV -= oddOffset * morph;
     
-    // Transform to world space
-    float4 posW = mul(float4(posL, 1.0f), gWorld);
-    posW.y = height;
+    float4 posW = GridToWorld(localUV, globalUV);
     
     vout.PosW = posW.xyz;
     vout.NormalW = CalculateNormal(globalUV);
@@ -4,38 +4,18 @@
 
 #include "Terrain.h"
 #include "../../Common/DDSTextureLoader.h"
+#include "../../Common/DDSDecoder.h"
 #include <fstream>
-#include <random>
 #include <cmath>
 
 using namespace DirectX;
 using Microsoft::WRL::ComPtr;
 
-const char* Terrain::GetLODMeshName(int lod)
-{
-    static const char* names[] = { "lod0", "lod1", "lod2", "lod3", "lod4" };
-    return (lod >= 0 && lod < 5) ? names[lod] : "lod0";
-}
-
 Terrain::Terrain(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
                  float terrainSize, float minHeight, float maxHeight)
     : md3dDevice(device), mTerrainSize(terrainSize), 
       mMinHeight(minHeight), mMaxHeight(maxHeight)
 {
-    // Initialize permutation table for Perlin noise
-    mPermutation.resize(512);
-    std::vector<int> p(256);
-    for (int i = 0; i < 256; ++i) p[i] = i;
-    
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::shuffle(p.begin(), p.end(), gen);
-    
-    for (int i = 0; i < 256; ++i)
-    {
-        mPermutation[i] = p[i];
-        mPermutation[256 + i] = p[i];
-    }
 }
 
 bool Terrain::LoadHeightmap(const std::wstring& filename, UINT width, UINT height, bool is16Bit)
@@ -66,6 +46,7 @@ bool Terrain::LoadHeightmap(const std::wstring& filename, UINT width, UINT heigh
     }
     
     file.close();
+    OnHeightmapChanged();
     return true;
 }
 
@@ -84,20 +65,33 @@ bool Terrain::LoadHeightmapDDS(const std::wstring& filename, ID3D12Device* devic
     mHeightmapWidth = (UINT)texDesc.Width;
     mHeightmapHeight = texDesc.Height;
     
-    // Generate CPU-side heightmap for collision/sampling
-    // For now, generate procedural as fallback for CPU queries
-    mHeightmap.resize(mHeightmapWidth * mHeightmapHeight);
-    for (UINT z = 0; z < mHeightmapHeight; ++z)
+    // Decode the same file on the CPU for collision/sampling and node bounds
+    DDSDecoder::Image image;
+    if (DDSDecoder::LoadFromFile(filename, image) &&
+        image.Width == mHeightmapWidth && image.Height == mHeightmapHeight)
+    {
+        mHeightmap.resize(image.Texels.size());
+        for (size_t i = 0; i < image.Texels.size(); ++i)
+            mHeightmap[i] = image.Texels[i].x;
+    }
+    else
     {
-        for (UINT x = 0; x < mHeightmapWidth; ++x)
+        // Format the decoder does not handle: procedural stand-in for CPU queries
+        OutputDebugStringA("Terrain: could not decode heightmap on CPU, using procedural fallback\n");
+        
+        mHeightmap.resize(mHeightmapWidth * mHeightmapHeight);
+        for (UINT z = 0; z < mHeightmapHeight; ++z)
         {
-            float nx = (float)x / mHeightmapWidth;
-            float nz = (float)z / mHeightmapHeight;
-            // Simple procedural fallback for CPU height queries
-            mHeightmap[z * mHeightmapWidth + x] = PerlinNoise(nx * 4.0f, nz * 4.0f) * 0.5f + 0.5f;
+            for (UINT x = 0; x < mHeightmapWidth; ++x)
+            {
+                float nx = (float)x / mHeightmapWidth;
+                float nz = (float)z / mHeightmapHeight;
+                mHeightmap[z * mHeightmapWidth + x] = mNoise.Perlin(nx * 4.0f, nz * 4.0f) * 0.5f + 0.5f;
+            }
         }
     }
     
+    OnHeightmapChanged();
     return true;
 }
 
@@ -107,35 +101,20 @@ void Terrain::GenerateProceduralHeightmap(UINT width, UINT height, float frequen
     mHeightmapHeight = height;
     mHeightmap.resize(width * height);
     
+    // fBm over [0,1) in both directions, seeded, four samples at a time on all cores
+    NoiseDesc desc;
+    desc.Type = NoiseType::Fbm;
+    desc.Frequency = frequency;
+    desc.Octaves = octaves;
+    mNoise.Generate(desc, 0, 0, width, height, 1.0f / width, mHeightmap.data());
+    
     float maxVal = 0.0f;
     float minVal = 1.0f;
-    
-    for (UINT z = 0; z < height; ++z)
+    for (auto& h : mHeightmap)
     {
-        for (UINT x = 0; x < width; ++x)
-        {
-            float nx = (float)x / width;
-            float nz = (float)z / height;
-            
-            float value = 0.0f;
-            float amplitude = 1.0f;
-            float freq = frequency;
-            float maxAmplitude = 0.0f;
-            
-            for (int o = 0; o < octaves; ++o)
-            {
-                value += PerlinNoise(nx * freq, nz * freq) * amplitude;
-                maxAmplitude += amplitude;
-                amplitude *= 0.5f;
-                freq *= 2.0f;
-            }
-            
-            value = (value / maxAmplitude + 1.0f) * 0.5f;
-            mHeightmap[z * width + x] = value;
-            
-            maxVal = max(maxVal, value);
-            minVal = min(minVal, value);
-        }
+        h = (h + 1.0f) * 0.5f;
+        maxVal = max(maxVal, h);
+        minVal = min(minVal, h);
     }
     
     // Normalize to [0,1]
@@ -145,51 +124,58 @@ void Terrain::GenerateProceduralHeightmap(UINT width, UINT height, float frequen
         for (auto& h : mHeightmap)
             h = (h - minVal) / range;
     }
+    
+    OnHeightmapChanged();
 }
 
-void Terrain::BuildGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList)
+void Terrain::BuildGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, UINT gridResolution)
 {
     mGeometry = std::make_unique<MeshGeometry>();
     mGeometry->Name = "terrainGeo";
     
+    // A multiple of 4, so each quadrant is an even grid that morphs to half resolution
+    // without moving its edge vertices off the edge
+    mGridResolution = max(4u, gridResolution & ~3u);
+    const UINT n = mGridResolution;
+    const UINT halfN = n / 2;
+    
     std::vector<TerrainVertex> allVertices;
     std::vector<std::uint32_t> allIndices;
+    allVertices.reserve((n + 1) * (n + 1));
+    allIndices.reserve(n * n * 6);
     
-    // Build LOD meshes: LOD0=256x256, LOD1=128x128, LOD2=64x64, LOD3=32x32, LOD4=16x16
-    UINT lodSizes[] = { 256, 128, 64, 32, 16 };
-    
-    for (int lod = 0; lod < 5; ++lod)
+    // One grid, unit size, centered at origin; every selected node draws it
+    float step = 1.0f / n;
+    for (UINT z = 0; z <= n; ++z)
     {
-        UINT gridSize = lodSizes[lod];
-        UINT vertexOffset = (UINT)allVertices.size();
-        UINT indexOffset = (UINT)allIndices.size();
-        
-        // Generate grid vertices
-        float step = 1.0f / gridSize;
-        for (UINT z = 0; z <= gridSize; ++z)
+        for (UINT x = 0; x <= n; ++x)
         {
-            for (UINT x = 0; x <= gridSize; ++x)
-            {
-                TerrainVertex v;
-                float u = x * step;
-                float w = z * step;
-                
-                v.Pos = XMFLOAT3(u - 0.5f, 0.0f, w - 0.5f); // Centered at origin, unit size
-                v.Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-                v.TexC = XMFLOAT2(u, w);
-                
-                allVertices.push_back(v);
-            }
+            TerrainVertex v;
+            float u = x * step;
+            float w = z * step;
+            
+            v.Pos = XMFLOAT3(u - 0.5f, 0.0f, w - 0.5f);
+            v.Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+            v.TexC = XMFLOAT2(u, w);
+            
+            allVertices.push_back(v);
         }
-        
-        // Generate indices
-        for (UINT z = 0; z < gridSize; ++z)
+    }
+    
+    // Indices grouped by quadrant in QuadTree child order (NW, NE, SW, SE; +z is
+    // north), so a node can also draw just the quarter of its grid over one child.
+    // Every quad has the same diagonal, which a fully morphed grid reproduces at half
+    // resolution.
+    const UINT quadrantOrigin[4][2] = { { 0, halfN }, { halfN, halfN }, { 0, 0 }, { halfN, 0 } };
+    for (int q = 0; q < 4; ++q)
+    {
+        for (UINT z = quadrantOrigin[q][1]; z < quadrantOrigin[q][1] + halfN; ++z)
         {
-            for (UINT x = 0; x < gridSize; ++x)
+            for (UINT x = quadrantOrigin[q][0]; x < quadrantOrigin[q][0] + halfN; ++x)
             {
-                UINT topLeft = z * (gridSize + 1) + x + vertexOffset;
+                UINT topLeft = z * (n + 1) + x;
                 UINT topRight = topLeft + 1;
-                UINT bottomLeft = (z + 1) * (gridSize + 1) + x + vertexOffset;
+                UINT bottomLeft = (z + 1) * (n + 1) + x;
                 UINT bottomRight = bottomLeft + 1;
                 
                 // Two triangles per quad
@@ -202,15 +188,14 @@ void Terrain::BuildGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmd
                 allIndices.push_back(bottomRight);
             }
         }
-        
-        SubmeshGeometry submesh;
-        submesh.IndexCount = gridSize * gridSize * 6;
-        submesh.StartIndexLocation = indexOffset;
-        submesh.BaseVertexLocation = 0;
-        
-        mGeometry->DrawArgs[GetLODMeshName(lod)] = submesh;
     }
     
+    SubmeshGeometry submesh;
+    submesh.IndexCount = (UINT)allIndices.size();
+    submesh.StartIndexLocation = 0;
+    submesh.BaseVertexLocation = 0;
+    mGeometry->DrawArgs[GetGridMeshName()] = submesh;
+    
     const UINT vbByteSize = (UINT)allVertices.size() * sizeof(TerrainVertex);
     const UINT ibByteSize = (UINT)allIndices.size() * sizeof(std::uint32_t);
     
@@ -276,40 +261,88 @@ XMFLOAT3 Terrain::GetNormal(float x, float z) const
     return normal;
 }
 
-float Terrain::SampleHeight(int x, int z) const
+void Terrain::GetHeightRange(float x, float z, float size, float& minY, float& maxY) const
 {
-    x = max(0, min(x, (int)mHeightmapWidth - 1));
-    z = max(0, min(z, (int)mHeightmapHeight - 1));
-    return mHeightmap[z * mHeightmapWidth + x];
+    float h0 = 0.0f, h1 = 1.0f;
+    
+    // Same mapping as GetHeight, widened by a texel on each side so the range also
+    // covers the GPU's half-texel offset and filtering
+    float halfSize = size * 0.5f;
+    float u0 = ((x - halfSize) / mTerrainSize + 0.5f) * mHeightmapWidth - 1.0f;
+    float u1 = ((x + halfSize) / mTerrainSize + 0.5f) * mHeightmapWidth + 1.0f;
+    float v0 = ((z - halfSize) / mTerrainSize + 0.5f) * mHeightmapHeight - 1.0f;
+    float v1 = ((z + halfSize) / mTerrainSize + 0.5f) * mHeightmapHeight + 1.0f;
+    
+    if (!mHeightPyramid.GetRange(u0, v0, u1, v1, h0, h1))
+    {
+        h0 = 0.0f;
+        h1 = 1.0f;
+    }
+    
+    minY = mMinHeight + h0 * (mMaxHeight - mMinHeight);
+    maxY = mMinHeight + h1 * (mMaxHeight - mMinHeight);
 }
 
-float Terrain::PerlinNoise(float x, float z) const
+std::vector<float> Terrain::ComputeLevelErrors(float leafSize, int levelCount) const
 {
-    int X = (int)floorf(x) & 255;
-    int Z = (int)floorf(z) & 255;
-    
-    x -= floorf(x);
-    z -= floorf(z);
+    std::vector<float> errors(levelCount, 0.0f);
+    if (mSampler.IsEmpty() || mGridResolution == 0)
+        return errors;
     
-    float u = Fade(x);
-    float v = Fade(z);
-    
-    int A = mPermutation[X] + Z;
-    int B = mPermutation[X + 1] + Z;
+    std::vector<float> xs, zs, heights;
+    for (int level = 0; level < levelCount; ++level)
+    {
+        // Heights at half the level's vertex spacing: the even samples are its vertices,
+        // the others lie on its edges and in its cells
+        float spacing = leafSize * (float)(1 << level) / mGridResolution;
+        UINT count = (UINT)(mTerrainSize / spacing) * 2 + 1;
+        size_t total = (size_t)count * count;
+        xs.resize(total);
+        zs.resize(total);
+        heights.resize(total);
+        for (UINT j = 0; j < count; ++j)
+        {
+            for (UINT i = 0; i < count; ++i)
+            {
+                xs[(size_t)j * count + i] = i * spacing * 0.5f - mTerrainSize * 0.5f;
+                zs[(size_t)j * count + i] = j * spacing * 0.5f - mTerrainSize * 0.5f;
+            }
+        }
+        
+        HeightfieldSamples samples;
+        samples.Heights = heights.data();
+        mSampler.SampleBatch(xs.data(), zs.data(), total, samples);
+        
+        // Largest difference between the surface and the level's grid over it
+        float error = 0.0f;
+        auto h = [&](UINT i, UINT j) { return heights[(size_t)j * count + i]; };
+        for (UINT j = 0; j + 2 < count; j += 2)
+        {
+            for (UINT i = 0; i + 2 < count; i += 2)
+            {
+                float h00 = h(i, j), h20 = h(i + 2, j), h02 = h(i, j + 2), h22 = h(i + 2, j + 2);
+                error = max(error, fabsf(h(i + 1, j) - (h00 + h20) * 0.5f));
+                error = max(error, fabsf(h(i, j + 1) - (h00 + h02) * 0.5f));
+                error = max(error, fabsf(h(i + 1, j + 1) - (h20 + h02) * 0.5f)); // On the quad's diagonal
+            }
+        }
+        errors[level] = error;
+    }
     
-    return Lerp(
-        Lerp(Grad(mPermutation[A], x, z), Grad(mPermutation[B], x - 1, z), u),
-        Lerp(Grad(mPermutation[A + 1], x, z - 1), Grad(mPermutation[B + 1], x - 1, z - 1), u),
-        v);
+    return errors;
 }
 
-float Terrain::Fade(float t) const { return t * t * t * (t * (t * 6 - 15) + 10); }
-float Terrain::Lerp(float a, float b, float t) const { return a + t * (b - a); }
+void Terrain::OnHeightmapChanged()
+{
+    mHeightPyramid.Build(mHeightmap, mHeightmapWidth, mHeightmapHeight);
+    mRayCaster.Attach(mHeightmap, mHeightmapWidth, mHeightmapHeight, mHeightPyramid,
+                      mTerrainSize, mMinHeight, mMaxHeight);
+    mSampler.Attach(mHeightmap, mHeightmapWidth, mHeightmapHeight, mTerrainSize, mMinHeight, mMaxHeight);
+}
 
-float Terrain::Grad(int hash, float x, float z) const
+float Terrain::SampleHeight(int x, int z) const
 {
-    int h = hash & 3;
-    float u = h < 2 ? x : z;
-    float v = h < 2 ? z : x;
-    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+    x = max(0, min(x, (int)mHeightmapWidth - 1));
+    z = max(0, min(z, (int)mHeightmapHeight - 1));
+    return mHeightmap[z * mHeightmapWidth + x];
 }
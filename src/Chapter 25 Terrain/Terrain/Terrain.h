@@ -3,8 +3,10 @@
 //
 // Features:
 // - Heightmap-based terrain generation
-// - Multiple LOD levels with different mesh densities
+// - One grid mesh shared by every quadtree node (CDLOD)
 // - Normal map generation from heightmap
+// - Min/max height pyramid for tight node bounds and ray casting
+// - Batched height/normal queries over the same heights
 //***************************************************************************************
 
 #pragma once
@@ -12,6 +14,10 @@
 #include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
 #include "QuadTree.h"
+#include "HeightPyramid.h"
+#include "HeightfieldRayCaster.h"
+#include "HeightfieldSampler.h"
+#include "NoiseGenerator.h"
 #include <vector>
 
 struct TerrainVertex
@@ -34,11 +40,18 @@ public:
     // Load heightmap from DDS file
     bool LoadHeightmapDDS(const std::wstring& filename, ID3D12Device* device, ID3D12GraphicsCommandList* cmdList);
     
-    // Generate procedural heightmap
+    // Generate procedural heightmap (deterministic for a given noise seed)
     void GenerateProceduralHeightmap(UINT width, UINT height, float frequency, int octaves);
+    void SetNoiseSeed(uint32_t seed) { mNoise.SetSeed(seed); }
+    const NoiseGenerator& GetNoise() const { return mNoise; }
     
-    // Build terrain meshes for different LOD levels
-    void BuildGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList);
+    // Build the grid mesh every quadtree node draws: gridResolution quads per side
+    void BuildGeometry(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList, UINT gridResolution);
+    UINT GetGridResolution() const { return mGridResolution; }
+    
+    // World-space height error of drawing the terrain with each level's grid, where
+    // level 0 nodes are leafSize wide and every level up doubles that
+    std::vector<float> ComputeLevelErrors(float leafSize, int levelCount) const;
     
     // Get height at world position
     float GetHeight(float x, float z) const;
@@ -46,12 +59,20 @@ public:
     // Get normal at world position
     DirectX::XMFLOAT3 GetNormal(float x, float z) const;
     
+    // Heights, normals and slopes for many positions at once (see HeightfieldSampler)
+    const HeightfieldSampler& GetSampler() const { return mSampler; }
+    
+    // Get conservative height range under a square region (center x,z)
+    void GetHeightRange(float x, float z, float size, float& minY, float& maxY) const;
+    
     // Accessors
     float GetTerrainSize() const { return mTerrainSize; }
     float GetMinHeight() const { return mMinHeight; }
     float GetMaxHeight() const { return mMaxHeight; }
     UINT GetHeightmapWidth() const { return mHeightmapWidth; }
     UINT GetHeightmapHeight() const { return mHeightmapHeight; }
+    const HeightPyramid& GetHeightPyramid() const { return mHeightPyramid; }
+    const HeightfieldRayCaster& GetRayCaster() const { return mRayCaster; }
     
     // Get mesh geometry for rendering
     MeshGeometry* GetGeometry() { return mGeometry.get(); }
@@ -59,20 +80,16 @@ public:
     // Get heightmap as texture resource
     ID3D12Resource* GetHeightmapResource() { return mHeightmapTexture.Get(); }
     
-    // LOD mesh names
-    static const char* GetLODMeshName(int lod);
+    // Grid mesh name in the geometry's DrawArgs; its indices are in four equal
+    // quadrants, ordered like QuadTree children
+    static const char* GetGridMeshName() { return "grid"; }
     
 private:
     void BuildLODMesh(int lodLevel, UINT gridSize);
     void CalculateNormals();
+    void OnHeightmapChanged();
     float SampleHeight(int x, int z) const;
     
-    // Perlin noise for procedural generation
-    float PerlinNoise(float x, float z) const;
-    float Fade(float t) const;
-    float Lerp(float a, float b, float t) const;
-    float Grad(int hash, float x, float z) const;
-    
 private:
     ID3D12Device* md3dDevice = nullptr;
     
@@ -83,11 +100,15 @@ private:
     UINT mHeightmapWidth = 0;
     UINT mHeightmapHeight = 0;
     std::vector<float> mHeightmap; // Normalized [0,1] heights
+    HeightPyramid mHeightPyramid;  // Min/max of mHeightmap
+    HeightfieldRayCaster mRayCaster; // Over mHeightmap and mHeightPyramid
+    HeightfieldSampler mSampler;     // Over mHeightmap
     
     std::unique_ptr<MeshGeometry> mGeometry;
+    UINT mGridResolution = 0;
     Microsoft::WRL::ComPtr<ID3D12Resource> mHeightmapTexture;
     Microsoft::WRL::ComPtr<ID3D12Resource> mHeightmapUploadBuffer;
     
-    // Permutation table for Perlin noise
-    std::vector<int> mPermutation;
+    // Seeded Perlin noise for procedural generation
+    NoiseGenerator mNoise;
 };
@@ -2,8 +2,9 @@
 // TerrainApp.cpp - Terrain rendering with LOD and Frustum Culling
 // 
 // Features:
-// - Single terrain mesh with multiple LOD levels
-// - Distance-based LOD selection
+// - One grid mesh drawn per selected QuadTree node
+// - Continuous LOD (CDLOD): ranges from screen-space error, geomorphing in the
+//   vertex shader, neighbours at most one level apart
 // - Frustum culling for the entire terrain
 //***************************************************************************************
 
@@ -16,6 +17,9 @@
 #include "FrameResource.h"
 #include "Terrain.h"
 #include "QuadTree.h"
+#include "TerrainTileSet.h"
+#include "TileStreamer.h"
+#include "PaintLayer.h"
 #include <sstream>
 #include <iostream>
 #include <iomanip>
@@ -40,6 +44,8 @@ void CreateConsoleWindow()
     std::cout << "  R/G/B - change paint color" << std::endl;
     std::cout << "  +/- - change brush size" << std::endl;
     std::cout << "  1 - toggle wireframe" << std::endl;
+    std::cout << "  T - toggle streamed detail tiles" << std::endl;
+    std::cout << "  P - start/stop recording a camera path (saved to camera_path.txt on stop)" << std::endl;
     std::cout << "=========================================\n" << std::endl;
 }
 
@@ -49,6 +55,22 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Node grid mesh resolution, QuadTree levels (leaves are 1/16 of the terrain) and
+// the screen-space height error each level's range allows, in pixels
+const UINT gGridResolution = 64;
+const int gLodLevelCount = 5;
+const float gLodPixelError = 2.0f;
+
+// Paint layer resolution (texels per side) and tile uploads allowed per frame
+const UINT gPaintResolution = 2048;
+const UINT gMaxPaintTileUploads = 32;
+
+// Rounds up to a power-of-two alignment (texture upload pitch and placement)
+static UINT64 AlignUp(UINT64 value, UINT64 alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
 // Bounding box for frustum culling
 struct TerrainBoundingBox
 {
@@ -87,8 +109,16 @@ private:
     void BuildFrameResources();
     void DrawTerrain();
     
+    // Detail tile streaming
+    void BuildTileStreaming();
+    void UploadStreamedTiles();
+    void WidenDetailPyramid();
+    QuadTree::HeightRangeQuery GetHeightRangeQuery();
+    void UpdateNodeHeightRanges();
+    void SaveRecordedCameraPath();
+    
     // LOD and Culling
-    int CalculateLOD(float distance);
+    void UpdateLodRanges();
     bool IsInFrustum(const TerrainBoundingBox& box, const XMFLOAT4* planes);
     void ExtractFrustumPlanes(XMFLOAT4* planes, const XMMATRIX& viewProj);
     void PrintDebugInfo();
@@ -126,10 +156,32 @@ private:
     ComPtr<ID3D12Resource> mWhiteTexture;
     ComPtr<ID3D12Resource> mWhiteTextureUpload;
     
-    // Paint texture for mouse drawing
+    // Paint texture for mouse drawing. Strokes go into the tiled CPU layer; only the
+    // tiles they touched are copied to the texture, through a per-frame upload ring.
+    std::unique_ptr<PaintLayer> mPaintLayer;
     ComPtr<ID3D12Resource> mPaintTexture;
-    ComPtr<ID3D12Resource> mPaintUploadBuffer;
-    std::vector<UINT> mPaintData;
+    ComPtr<ID3D12Resource> mPaintUploadBuffers[gNumFrameResources];
+    BYTE* mMappedPaintUploads[gNumFrameResources] = {};
+    std::vector<UINT> mPaintUploadTiles;
+    UINT mPaintTilesUploaded = 0;
+    
+    // Detail tiles (TerrainDetails/001), streamed around the camera. The base map
+    // holds a coarse level of every tile, the atlas the tiles that are resident.
+    TerrainTileSet mTileSet;
+    std::unique_ptr<TileStreamer> mTileStreamer;
+    HeightPyramid mDetailPyramid;
+    bool mStreamingEnabled = false;
+    XMFLOAT3 mLastCameraPos = { 0.0f, 0.0f, 0.0f };
+    ComPtr<ID3D12Resource> mTilePageTable;
+    ComPtr<ID3D12Resource> mTileAtlas;
+    ComPtr<ID3D12Resource> mTileBaseMap;
+    ComPtr<ID3D12Resource> mTileBaseUploadBuffer;
+    ComPtr<ID3D12Resource> mTileUploadBuffers[gNumFrameResources];
+    BYTE* mMappedTileUploads[gNumFrameResources] = {};
+    
+    // Camera path recording for offline replay of the streamer
+    bool mRecordingPath = false;
+    std::vector<CameraPathSample> mCameraPath;
 
     PassConstants mMainPassCB;
     TerrainConstants mTerrainCB;
@@ -143,8 +195,10 @@ private:
     bool mTerrainVisible = true;
     bool mWireframe = false;
     
-    // LOD distances for QuadTree
-    std::vector<float> mLodDistances = { 100.0f, 200.0f, 400.0f, 600.0f, 1000.0f };
+    // Height error of each level's grid, and the LOD ranges it gives at the current
+    // viewport height (before the QuadTree enforces its constraints)
+    std::vector<float> mLevelErrors;
+    std::vector<float> mLodRanges;
     
     // Statistics
     int mLodCounts[5] = { 0, 0, 0, 0, 0 };
@@ -155,16 +209,16 @@ private:
     
     // Mouse painting
     bool mIsPainting = false;
-    bool mPaintTextureNeedsUpdate = false;
     float mBrushSize = 30.0f; // Brush size in world units
     XMFLOAT3 mPaintColor = { 1.0f, 0.0f, 0.0f }; // Red paint
     
     POINT mLastMousePos;
     
     // Ray casting for terrain painting
+    HeightfieldRay GetMouseRay(int mouseX, int mouseY);
     bool RayTerrainIntersect(int mouseX, int mouseY, XMFLOAT3& hitPoint);
     void PaintOnTerrain(const XMFLOAT3& worldPos);
-    void UpdatePaintTexture();
+    void UploadPaintTiles();
 };
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance, PSTR cmdLine, int showCmd)
@@ -199,6 +253,14 @@ TerrainApp::~TerrainApp()
 {
     if (md3dDevice != nullptr)
         FlushCommandQueue();
+    
+    for (int i = 0; i < gNumFrameResources; ++i)
+    {
+        if (mTileUploadBuffers[i] != nullptr)
+            mTileUploadBuffers[i]->Unmap(0, nullptr);
+        if (mPaintUploadBuffers[i] != nullptr)
+            mPaintUploadBuffers[i]->Unmap(0, nullptr);
+    }
 }
 
 bool TerrainApp::Initialize()
@@ -219,7 +281,7 @@ bool TerrainApp::Initialize()
     {
         mTerrain->GenerateProceduralHeightmap(256, 256, 4.0f, 6);
     }
-    mTerrain->BuildGeometry(md3dDevice.Get(), mCommandList.Get());
+    mTerrain->BuildGeometry(md3dDevice.Get(), mCommandList.Get(), gGridResolution);
     
     // Setup terrain bounding box for frustum culling
     float halfSize = mTerrain->GetTerrainSize() * 0.5f;
@@ -227,19 +289,28 @@ bool TerrainApp::Initialize()
     mTerrainBounds.Center = XMFLOAT3(0.0f, mTerrain->GetMinHeight() + halfHeight, 0.0f);
     mTerrainBounds.Extents = XMFLOAT3(halfSize, halfHeight + 10.0f, halfSize);
     
-    // Initialize QuadTree for LOD management
+    // Initialize QuadTree for LOD management; ranges follow from how far off each
+    // level's grid is from the heightmap
+    float minNodeSize = mTerrain->GetTerrainSize() / (float)(1 << (gLodLevelCount - 1));
+    mLevelErrors = mTerrain->ComputeLevelErrors(minNodeSize, gLodLevelCount);
     mQuadTree = std::make_unique<QuadTree>();
-    float minNodeSize = mTerrain->GetTerrainSize() / 8.0f; // Minimum node = 1/8 of terrain
-    mQuadTree->SetLODDistances(mLodDistances);
-    mQuadTree->Initialize(mTerrain->GetTerrainSize(), minNodeSize, 5);
-    mQuadTree->SetHeightRange(0, 0, mTerrain->GetTerrainSize(), 
-                              mTerrain->GetMinHeight(), mTerrain->GetMaxHeight());
+    mQuadTree->Initialize(mTerrain->GetTerrainSize(), minNodeSize, gLodLevelCount);
+    UpdateLodRanges();
+    
+    // Detail tiles, if the tile set is present; streamed heights replace the heightmap
+    BuildTileStreaming();
+    
+    // Fit node bounds to the min/max pyramid of whichever heights are drawn
+    UpdateNodeHeightRanges();
     
     std::cout << "QuadTree initialized:" << std::endl;
     std::cout << "  Terrain size: " << mTerrain->GetTerrainSize() << std::endl;
     std::cout << "  Min node size: " << minNodeSize << std::endl;
     std::cout << "  Total nodes: " << mQuadTree->GetTotalNodeCount() << std::endl;
-    std::cout << std::endl;
+    std::cout << "  LOD ranges:";
+    for (int i = 0; i + 1 < mQuadTree->GetLevelCount(); ++i)
+        std::cout << " " << mQuadTree->GetLODRanges()[i];
+    std::cout << std::endl << std::endl;
     
     OutputDebugStringA("=== Terrain Demo ===\n");
     OutputDebugStringA("QuadTree LOD + Frustum Culling\n");
@@ -263,6 +334,10 @@ void TerrainApp::OnResize()
 {
     D3DApp::OnResize();
     mCamera.SetLens(0.25f * MathHelper::Pi, AspectRatio(), 1.0f, 3000.0f);
+    
+    // Screen-space error depends on the viewport height
+    if (mQuadTree)
+        UpdateLodRanges();
 }
 
 void TerrainApp::Update(const GameTimer& gt)
@@ -295,6 +370,28 @@ void TerrainApp::Update(const GameTimer& gt)
     mVisibleNodes.clear();
     mQuadTree->GetVisibleNodes(mVisibleNodes);
     
+    // Request the detail tiles under the visible nodes and ahead of the camera
+    if (mStreamingEnabled)
+    {
+        XMFLOAT3 velocity = { 0.0f, 0.0f, 0.0f };
+        if (gt.DeltaTime() > 0.0f)
+        {
+            XMStoreFloat3(&velocity, (XMLoadFloat3(&camPos) - XMLoadFloat3(&mLastCameraPos)) / gt.DeltaTime());
+        }
+        mTileStreamer->Update(camPos, velocity, mVisibleNodes);
+        WidenDetailPyramid();
+    }
+    mLastCameraPos = camPos;
+    
+    if (mRecordingPath)
+    {
+        CameraPathSample sample;
+        sample.Time = gt.TotalTime();
+        sample.Position = camPos;
+        sample.Look = mCamera.GetLook3f();
+        mCameraPath.push_back(sample);
+    }
+    
     // Count LOD distribution and culled nodes
     memset(mLodCounts, 0, sizeof(mLodCounts));
     for (const auto* node : mVisibleNodes)
@@ -320,15 +417,10 @@ void TerrainApp::Update(const GameTimer& gt)
     }
 }
 
-int TerrainApp::CalculateLOD(float distance)
+void TerrainApp::UpdateLodRanges()
 {
-    // Now handled by QuadTree, kept for compatibility
-    for (int i = 0; i < (int)mLodDistances.size(); ++i)
-    {
-        if (distance < mLodDistances[i])
-            return i;
-    }
-    return 4;
+    mLodRanges = QuadTree::ComputeLODRanges(mLevelErrors, gLodPixelError, (float)mClientHeight, mCamera.GetFovY());
+    mQuadTree->SetLODRanges(mLodRanges);
 }
 
 bool TerrainApp::IsInFrustum(const TerrainBoundingBox& box, const XMFLOAT4* planes)
@@ -386,6 +478,7 @@ void TerrainApp::PrintDebugInfo()
     std::cout << "Total nodes: " << mQuadTree->GetTotalNodeCount() << std::endl;
     std::cout << "Visible nodes: " << mVisibleNodes.size() << std::endl;
     std::cout << "Culled nodes: " << mCulledNodes << std::endl;
+    std::cout << "Nodes evaluated: " << mQuadTree->GetEvaluatedNodeCount() << std::endl;
     std::cout << std::endl;
     
     std::cout << "--- LOD Distribution ---" << std::endl;
@@ -396,10 +489,26 @@ void TerrainApp::PrintDebugInfo()
     std::cout << "LOD 4 (lowest): " << mLodCounts[4] << " nodes" << std::endl;
     std::cout << std::endl;
     
+    if (mTileStreamer)
+    {
+        const TileStreamer::Stats& stats = mTileStreamer->GetStats();
+        std::cout << "--- Tile Streaming (" << (mStreamingEnabled ? "ON" : "OFF") << ") ---" << std::endl;
+        std::cout << "Resident tiles: " << stats.ResidentTiles << " ("
+                  << stats.MemoryUsed / (1024 * 1024) << " MB, peak " << stats.PeakMemory / (1024 * 1024) << " MB)" << std::endl;
+        std::cout << "Requests: " << stats.Requests << ", in flight: " << stats.InFlight
+                  << ", evictions: " << stats.Evictions << std::endl;
+        std::cout << "Cache hits: " << stats.CacheHits << ", coarse fallbacks: " << stats.CoarseFallbacks << std::endl;
+        std::cout << std::endl;
+    }
+    
     std::cout << "--- Terrain Painting ---" << std::endl;
     std::cout << "Paint mode: " << (mIsPainting ? "ACTIVE" : "inactive") << std::endl;
     std::cout << "Brush size: " << std::fixed << std::setprecision(1) << mBrushSize << std::endl;
     std::cout << "Paint color: RGB(" << mPaintColor.x << ", " << mPaintColor.y << ", " << mPaintColor.z << ")" << std::endl;
+    std::cout << "Paint tiles: " << mPaintLayer->GetAllocatedTileCount() << "/"
+              << mPaintLayer->GetTilesX() * mPaintLayer->GetTilesY() << " allocated, "
+              << mPaintLayer->GetDirtyTileCount() << " pending, "
+              << mPaintTilesUploaded << " uploaded" << std::endl;
     std::cout << "==============================================" << std::endl;
     std::cout << std::endl;
 }
@@ -418,26 +527,12 @@ void TerrainApp::Draw(const GameTimer& gt)
         ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["terrain"].Get()));
     }
 
-    // Update paint texture if needed
-    if (mPaintTextureNeedsUpdate)
+    // Copy the paint tiles changed since the last frame
+    UploadPaintTiles();
+    
+    if (mStreamingEnabled)
     {
-        // Transition to copy destination
-        mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-            mPaintTexture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
-        
-        // Update subresource
-        D3D12_SUBRESOURCE_DATA paintData = {};
-        paintData.pData = mPaintData.data();
-        paintData.RowPitch = 512 * 4; // 4 bytes per pixel
-        paintData.SlicePitch = paintData.RowPitch * 512;
-        
-        UpdateSubresources(mCommandList.Get(), mPaintTexture.Get(), mPaintUploadBuffer.Get(), 0, 0, 1, &paintData);
-        
-        // Transition back to shader resource
-        mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-            mPaintTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-        
-        mPaintTextureNeedsUpdate = false;
+        UploadStreamedTiles();
     }
 
     mCommandList->RSSetViewports(1, &mScreenViewport);
@@ -498,7 +593,11 @@ void TerrainApp::DrawTerrain()
     auto objectCB = mCurrFrameResource->ObjectCB->Resource();
     UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
-    // Draw each visible QuadTree node with its LOD level
+    // Every node draws the same grid; a node drawn at its parent's level draws the
+    // quarter of the parent's grid over itself
+    const SubmeshGeometry& grid = geo->DrawArgs[Terrain::GetGridMeshName()];
+    const UINT quadrantIndexCount = grid.IndexCount / 4;
+    
     for (size_t i = 0; i < mVisibleNodes.size(); ++i)
     {
         const TerrainNode* node = mVisibleNodes[i];
@@ -507,13 +606,16 @@ void TerrainApp::DrawTerrain()
         D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + i * objCBByteSize;
         mCommandList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
-        // Select mesh based on node's LOD level
-        int lod = (node->LODLevel < 4) ? node->LODLevel : 4;
-        const char* lodMesh = Terrain::GetLODMeshName(lod);
-        auto& submesh = geo->DrawArgs[lodMesh];
-
-        mCommandList->DrawIndexedInstanced(submesh.IndexCount, 1, 
-            submesh.StartIndexLocation, submesh.BaseVertexLocation, 0);
+        if (node->LODLevel > node->Level)
+        {
+            mCommandList->DrawIndexedInstanced(quadrantIndexCount, 1,
+                grid.StartIndexLocation + node->Quadrant * quadrantIndexCount, grid.BaseVertexLocation, 0);
+        }
+        else
+        {
+            mCommandList->DrawIndexedInstanced(grid.IndexCount, 1,
+                grid.StartIndexLocation, grid.BaseVertexLocation, 0);
+        }
     }
 }
 
@@ -630,6 +732,39 @@ void TerrainApp::OnKeyboardInput(const GameTimer& gt)
         if (!bKeyPressed) { mPaintColor = { 0.0f, 0.0f, 1.0f }; bKeyPressed = true; std::cout << "Paint color: BLUE" << std::endl; }
     }
     else { bKeyPressed = false; }
+    
+    // Detail tile streaming and camera path recording
+    static bool tKeyPressed = false, pKeyPressed = false;
+    if (GetAsyncKeyState('T') & 0x8000)
+    {
+        if (!tKeyPressed && mTileStreamer)
+        {
+            mStreamingEnabled = !mStreamingEnabled;
+            UpdateNodeHeightRanges();
+            std::cout << "Tile streaming: " << (mStreamingEnabled ? "ON" : "OFF") << std::endl;
+        }
+        tKeyPressed = true;
+    }
+    else { tKeyPressed = false; }
+    
+    if (GetAsyncKeyState('P') & 0x8000)
+    {
+        if (!pKeyPressed)
+        {
+            mRecordingPath = !mRecordingPath;
+            if (mRecordingPath)
+            {
+                mCameraPath.clear();
+                std::cout << "Recording camera path..." << std::endl;
+            }
+            else
+            {
+                SaveRecordedCameraPath();
+            }
+        }
+        pKeyPressed = true;
+    }
+    else { pKeyPressed = false; }
 }
 
 void TerrainApp::UpdateCamera(const GameTimer& gt)
@@ -645,7 +780,11 @@ void TerrainApp::UpdateObjectCBs(const GameTimer& gt)
     // Update constant buffer for each visible QuadTree node
     for (size_t i = 0; i < mVisibleNodes.size(); ++i)
     {
-        const TerrainNode* node = mVisibleNodes[i];
+        // A node drawn at its parent's level uses the parent's grid (one quadrant of it)
+        const TerrainNode* selected = mVisibleNodes[i];
+        const TerrainNode* node = selected;
+        if (selected->LODLevel > selected->Level)
+            node = &mQuadTree->GetNode(selected->Parent);
         
         // Calculate world transform for this node
         // Node position is in world space, node size determines scale
@@ -667,7 +806,8 @@ void TerrainApp::UpdateObjectCBs(const GameTimer& gt)
         XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
         XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
         objConstants.MaterialIndex = 0;
-        objConstants.LODLevel = (node->LODLevel < 4) ? node->LODLevel : 4;
+        objConstants.LODLevel = (selected->LODLevel < 4) ? selected->LODLevel : 4;
+        mQuadTree->GetMorphRange(selected->LODLevel, objConstants.MorphStart, objConstants.MorphEnd);
 
         currObjectCB->CopyData((int)i, objConstants);
     }
@@ -713,6 +853,18 @@ void TerrainApp::UpdateTerrainCB(const GameTimer& gt)
     mTerrainCB.TexelSize = 1.0f / mTerrain->GetHeightmapWidth();
     mTerrainCB.HeightMapSize = XMFLOAT2((float)mTerrain->GetHeightmapWidth(), 
                                          (float)mTerrain->GetHeightmapHeight());
+    mTerrainCB.StreamingEnabled = mStreamingEnabled ? 1 : 0;
+    mTerrainCB.GridResolution = (float)mTerrain->GetGridResolution();
+    
+    if (mStreamingEnabled)
+    {
+        // Normals are taken at the detail resolution
+        UINT resolution = mTileSet.GetTileResolution();
+        mTerrainCB.TileCount = XMFLOAT2((float)mTileSet.GetTilesX(), (float)mTileSet.GetTilesY());
+        mTerrainCB.HeightMapSize = XMFLOAT2((float)(mTileSet.GetTilesX() * resolution),
+                                             (float)(mTileSet.GetTilesY() * resolution));
+        mTerrainCB.TexelSize = 1.0f / mTerrainCB.HeightMapSize.x;
+    }
 
     auto currTerrainCB = mCurrFrameResource->TerrainCB.get();
     currTerrainCB->CopyData(0, mTerrainCB);
@@ -721,7 +873,7 @@ void TerrainApp::UpdateTerrainCB(const GameTimer& gt)
 void TerrainApp::BuildRootSignature()
 {
     CD3DX12_DESCRIPTOR_RANGE texTable;
-    texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 4, 0, 0); // 4 textures now
+    texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 7, 0, 0); // 4 textures + streamed page table, atlas, base map
 
     CD3DX12_ROOT_PARAMETER slotRootParameter[4];
     slotRootParameter[0].InitAsConstantBufferView(0);
@@ -753,20 +905,19 @@ void TerrainApp::BuildRootSignature()
 void TerrainApp::BuildDescriptorHeaps()
 {
     D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-    srvHeapDesc.NumDescriptors = 4; // Added paint texture
+    srvHeapDesc.NumDescriptors = 7; // Paint texture + streamed tile textures
     srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
     srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
     ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
     
-    // Initialize paint texture (512x512 RGBA)
-    UINT paintWidth = 512;
-    UINT paintHeight = 512;
-    mPaintData.resize(paintWidth * paintHeight, 0x00000000); // Transparent black
+    // Paint texture (RGBA). Committed resources start zeroed, which is the layer's
+    // transparent black, so nothing is uploaded until a tile is painted.
+    mPaintLayer = std::make_unique<PaintLayer>(gPaintResolution, gPaintResolution);
     
     D3D12_RESOURCE_DESC paintTexDesc = {};
     paintTexDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    paintTexDesc.Width = paintWidth;
-    paintTexDesc.Height = paintHeight;
+    paintTexDesc.Width = gPaintResolution;
+    paintTexDesc.Height = gPaintResolution;
     paintTexDesc.DepthOrArraySize = 1;
     paintTexDesc.MipLevels = 1;
     paintTexDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -775,22 +926,20 @@ void TerrainApp::BuildDescriptorHeaps()
 
     ThrowIfFailed(md3dDevice->CreateCommittedResource(
         &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
-        &paintTexDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&mPaintTexture)));
-
-    const UINT64 paintUploadSize = GetRequiredIntermediateSize(mPaintTexture.Get(), 0, 1);
-    ThrowIfFailed(md3dDevice->CreateCommittedResource(
-        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
-        &CD3DX12_RESOURCE_DESC::Buffer(paintUploadSize), D3D12_RESOURCE_STATE_GENERIC_READ,
-        nullptr, IID_PPV_ARGS(&mPaintUploadBuffer)));
+        &paintTexDesc, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(&mPaintTexture)));
 
-    D3D12_SUBRESOURCE_DATA paintData = {};
-    paintData.pData = mPaintData.data();
-    paintData.RowPitch = paintWidth * 4; // 4 bytes per pixel (RGBA)
-    paintData.SlicePitch = paintData.RowPitch * paintHeight;
-
-    UpdateSubresources(mCommandList.Get(), mPaintTexture.Get(), mPaintUploadBuffer.Get(), 0, 0, 1, &paintData);
-    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
-        mPaintTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+    // Upload ring: room for gMaxPaintTileUploads tiles per frame resource
+    const UINT64 paintTileBytes = AlignUp(mPaintLayer->GetTileSize() * sizeof(UINT), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) *
+        mPaintLayer->GetTileSize();
+    const UINT64 paintUploadSize = gMaxPaintTileUploads * AlignUp(paintTileBytes, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+    for (int i = 0; i < gNumFrameResources; ++i)
+    {
+        ThrowIfFailed(md3dDevice->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(paintUploadSize), D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, IID_PPV_ARGS(&mPaintUploadBuffers[i])));
+        ThrowIfFailed(mPaintUploadBuffers[i]->Map(0, nullptr, reinterpret_cast<void**>(&mMappedPaintUploads[i])));
+    }
 
     // Load heightmap
     HRESULT hr = DirectX::CreateDDSTextureFromFile12(
@@ -823,18 +972,22 @@ void TerrainApp::BuildDescriptorHeaps()
             &CD3DX12_RESOURCE_DESC::Buffer(uploadSize), D3D12_RESOURCE_STATE_GENERIC_READ,
             nullptr, IID_PPV_ARGS(&mHeightmapUploadBuffer)));
         
-        std::vector<float> heightData(width * height);
+        std::vector<float> worldXs(width * height), worldZs(width * height), heightData(width * height);
         for (UINT z = 0; z < height; ++z)
         {
             for (UINT x = 0; x < width; ++x)
             {
-                float worldX = (float)x / width * mTerrain->GetTerrainSize() - mTerrain->GetTerrainSize() * 0.5f;
-                float worldZ = (float)z / height * mTerrain->GetTerrainSize() - mTerrain->GetTerrainSize() * 0.5f;
-                float h = mTerrain->GetHeight(worldX, worldZ);
-                heightData[z * width + x] = (h - mTerrain->GetMinHeight()) / (mTerrain->GetMaxHeight() - mTerrain->GetMinHeight());
+                worldXs[z * width + x] = (float)x / width * mTerrain->GetTerrainSize() - mTerrain->GetTerrainSize() * 0.5f;
+                worldZs[z * width + x] = (float)z / height * mTerrain->GetTerrainSize() - mTerrain->GetTerrainSize() * 0.5f;
             }
         }
         
+        HeightfieldSamples samples;
+        samples.Heights = heightData.data();
+        mTerrain->GetSampler().SampleBatch(worldXs.data(), worldZs.data(), heightData.size(), samples);
+        for (auto& h : heightData)
+            h = (h - mTerrain->GetMinHeight()) / (mTerrain->GetMaxHeight() - mTerrain->GetMinHeight());
+        
         D3D12_SUBRESOURCE_DATA subData = {};
         subData.pData = heightData.data();
         subData.RowPitch = width * sizeof(float);
@@ -936,6 +1089,18 @@ void TerrainApp::BuildDescriptorHeaps()
     srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     srvDesc.Texture2D.MipLevels = 1;
     md3dDevice->CreateShaderResourceView(mPaintTexture.Get(), &srvDesc, hDescriptor);
+    hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+    
+    // Streamed tiles: page table, atlas, base map (white placeholders without a tile set)
+    ID3D12Resource* tileTextures[] = { mTilePageTable.Get(), mTileAtlas.Get(), mTileBaseMap.Get() };
+    for (ID3D12Resource* texture : tileTextures)
+    {
+        ID3D12Resource* view = texture ? texture : mWhiteTexture.Get();
+        srvDesc.Format = view->GetDesc().Format;
+        srvDesc.Texture2D.MipLevels = 1;
+        md3dDevice->CreateShaderResourceView(view, &srvDesc, hDescriptor);
+        hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+    }
 }
 
 void TerrainApp::BuildShadersAndInputLayout()
@@ -980,8 +1145,8 @@ void TerrainApp::BuildPSOs()
 void TerrainApp::BuildFrameResources()
 {
     // Allocate enough object CBs for all possible QuadTree nodes
-    // QuadTree can have up to ~100 visible nodes at once
-    const UINT maxObjects = 256;
+    // Selected areas never overlap, so there are at most as many as leaves (16 x 16)
+    const UINT maxObjects = 1u << (2 * (gLodLevelCount - 1));
     
     for (int i = 0; i < gNumFrameResources; ++i)
     {
@@ -989,6 +1154,265 @@ void TerrainApp::BuildFrameResources()
     }
 }
 
+void TerrainApp::BuildTileStreaming()
+{
+    if (!mTileSet.Open(L"TerrainDetails/001"))
+    {
+        std::cout << "Tile set TerrainDetails/001 not found, streaming disabled" << std::endl;
+        return;
+    }
+    
+    TileStreamer::Desc desc;
+    desc.TerrainSize = mTerrain->GetTerrainSize();
+    desc.TilesX = mTileSet.GetTilesX();
+    desc.TilesY = mTileSet.GetTilesY();
+    desc.TileResolution = mTileSet.GetTileResolution();
+    desc.BaseMip = min(4u, mTileSet.GetMipCount() - 1);
+    
+    const TerrainTileSet* tileSet = &mTileSet;
+    mTileStreamer = std::make_unique<TileStreamer>(desc,
+        [tileSet](const TileKey& key, std::vector<float>& heights, float& minH, float& maxH)
+        {
+            return tileSet->LoadHeightTile(key.X, key.Y, key.Mip, heights, minH, maxH);
+        });
+    
+    // Base map: every tile at the base mip, always resident
+    std::vector<float> heights;
+    UINT width = 0, height = 0;
+    if (!mTileSet.LoadHeightLevel(desc.BaseMip, heights, width, height))
+    {
+        mTileStreamer.reset();
+        return;
+    }
+    
+    // Node bounds while streaming come from the tiles, since the detail can rise above
+    // what the single heightmap shows. The base mip is a start; WidenDetailPyramid
+    // folds in the finer tiles as they become resident.
+    mDetailPyramid.Build(heights, width, height);
+    
+    const D3D12_RESOURCE_STATES srvState =
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    
+    D3D12_RESOURCE_DESC texDesc = {};
+    texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    texDesc.Width = width;
+    texDesc.Height = height;
+    texDesc.DepthOrArraySize = 1;
+    texDesc.MipLevels = 1;
+    texDesc.Format = DXGI_FORMAT_R32_FLOAT;
+    texDesc.SampleDesc.Count = 1;
+    texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+    
+    ThrowIfFailed(md3dDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
+        &texDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&mTileBaseMap)));
+    
+    const UINT64 baseUploadSize = GetRequiredIntermediateSize(mTileBaseMap.Get(), 0, 1);
+    ThrowIfFailed(md3dDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
+        &CD3DX12_RESOURCE_DESC::Buffer(baseUploadSize), D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr, IID_PPV_ARGS(&mTileBaseUploadBuffer)));
+    
+    D3D12_SUBRESOURCE_DATA baseData = {};
+    baseData.pData = heights.data();
+    baseData.RowPitch = width * sizeof(float);
+    baseData.SlicePitch = baseData.RowPitch * height;
+    
+    UpdateSubresources(mCommandList.Get(), mTileBaseMap.Get(), mTileBaseUploadBuffer.Get(), 0, 0, 1, &baseData);
+    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+        mTileBaseMap.Get(), D3D12_RESOURCE_STATE_COPY_DEST, srvState));
+    
+    // Atlas and page table are filled by UploadStreamedTiles before anything reads them
+    texDesc.Width = mTileStreamer->GetAtlasWidth();
+    texDesc.Height = mTileStreamer->GetAtlasHeight();
+    ThrowIfFailed(md3dDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
+        &texDesc, srvState, nullptr, IID_PPV_ARGS(&mTileAtlas)));
+    
+    texDesc.Width = desc.TilesX;
+    texDesc.Height = desc.TilesY;
+    texDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+    ThrowIfFailed(md3dDevice->CreateCommittedResource(
+        &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE,
+        &texDesc, srvState, nullptr, IID_PPV_ARGS(&mTilePageTable)));
+    
+    // One upload ring entry per frame resource: the page table plus the largest
+    // tiles the streamer may hand out in a frame, each at copy alignment
+    const UINT64 slotSize = desc.TileResolution + 2;
+    const UINT64 tileBytes = AlignUp(slotSize * sizeof(float), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) * slotSize;
+    const UINT64 uploadSize = desc.MaxUploadsPerFrame * (tileBytes + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT) +
+        desc.TilesY * AlignUp(desc.TilesX * sizeof(XMFLOAT4), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT) +
+        D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+    
+    for (int i = 0; i < gNumFrameResources; ++i)
+    {
+        ThrowIfFailed(md3dDevice->CreateCommittedResource(
+            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE,
+            &CD3DX12_RESOURCE_DESC::Buffer(uploadSize), D3D12_RESOURCE_STATE_GENERIC_READ,
+            nullptr, IID_PPV_ARGS(&mTileUploadBuffers[i])));
+        ThrowIfFailed(mTileUploadBuffers[i]->Map(0, nullptr, reinterpret_cast<void**>(&mMappedTileUploads[i])));
+    }
+    
+    mStreamingEnabled = true;
+    
+    std::cout << "Tile streaming: " << desc.TilesX << "x" << desc.TilesY << " tiles of "
+              << desc.TileResolution << "^2, base map " << width << "x" << height << std::endl;
+}
+
+void TerrainApp::UploadStreamedTiles()
+{
+    const auto& uploads = mTileStreamer->GetPendingUploads();
+    if (uploads.empty() && !mTileStreamer->IsPageTableDirty())
+        return;
+    
+    ID3D12Resource* uploadBuffer = mTileUploadBuffers[mCurrFrameResourceIndex].Get();
+    BYTE* mapped = mMappedTileUploads[mCurrFrameResourceIndex];
+    UINT64 offset = 0;
+    
+    // Rows go into this frame's part of the ring (the fence wait in Update guarantees
+    // the GPU is done with it), then a region copy into the texture
+    auto copyRegion = [&](ID3D12Resource* texture, DXGI_FORMAT format, UINT x, UINT y,
+                          UINT width, UINT height, UINT texelBytes, const void* data)
+    {
+        offset = AlignUp(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        footprint.Offset = offset;
+        footprint.Footprint.Format = format;
+        footprint.Footprint.Width = width;
+        footprint.Footprint.Height = height;
+        footprint.Footprint.Depth = 1;
+        footprint.Footprint.RowPitch = (UINT)AlignUp(width * texelBytes, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+        
+        const BYTE* src = static_cast<const BYTE*>(data);
+        for (UINT row = 0; row < height; ++row)
+        {
+            memcpy(mapped + offset + (UINT64)row * footprint.Footprint.RowPitch,
+                   src + (size_t)row * width * texelBytes, (size_t)width * texelBytes);
+        }
+        offset += (UINT64)footprint.Footprint.RowPitch * height;
+        
+        CD3DX12_TEXTURE_COPY_LOCATION dst(texture, 0);
+        CD3DX12_TEXTURE_COPY_LOCATION src(uploadBuffer, footprint);
+        mCommandList->CopyTextureRegion(&dst, x, y, 0, &src, nullptr);
+    };
+    
+    const D3D12_RESOURCE_STATES srvState =
+        D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    
+    CD3DX12_RESOURCE_BARRIER toCopy[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition(mTileAtlas.Get(), srvState, D3D12_RESOURCE_STATE_COPY_DEST),
+        CD3DX12_RESOURCE_BARRIER::Transition(mTilePageTable.Get(), srvState, D3D12_RESOURCE_STATE_COPY_DEST)
+    };
+    mCommandList->ResourceBarrier(_countof(toCopy), toCopy);
+    
+    for (const auto& upload : uploads)
+    {
+        copyRegion(mTileAtlas.Get(), DXGI_FORMAT_R32_FLOAT, upload.X, upload.Y,
+                   upload.Size, upload.Size, sizeof(float), upload.Data);
+    }
+    
+    copyRegion(mTilePageTable.Get(), DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0,
+               mTileSet.GetTilesX(), mTileSet.GetTilesY(), sizeof(XMFLOAT4),
+               mTileStreamer->GetPageTable().data());
+    mTileStreamer->ClearPageTableDirty();
+    
+    CD3DX12_RESOURCE_BARRIER toShader[] =
+    {
+        CD3DX12_RESOURCE_BARRIER::Transition(mTileAtlas.Get(), D3D12_RESOURCE_STATE_COPY_DEST, srvState),
+        CD3DX12_RESOURCE_BARRIER::Transition(mTilePageTable.Get(), D3D12_RESOURCE_STATE_COPY_DEST, srvState)
+    };
+    mCommandList->ResourceBarrier(_countof(toShader), toShader);
+}
+
+void TerrainApp::WidenDetailPyramid()
+{
+    const auto& uploads = mTileStreamer->GetPendingUploads();
+    if (uploads.empty() || mDetailPyramid.IsEmpty())
+        return;
+    
+    const TileStreamer::Desc& desc = mTileStreamer->GetDesc();
+    const UINT cells = max(1u, desc.TileResolution >> desc.BaseMip);
+    std::vector<XMFLOAT2> ranges((size_t)cells * cells);
+    
+    for (const auto& upload : uploads)
+    {
+        // Each pyramid cell takes the texels of the finer tile that cover it and its
+        // bilinear neighbour; the tile's one-texel border supplies those at the edges
+        const int res = (int)upload.Size - 2;
+        const int scale = max(1, res / (int)cells);
+        for (UINT cz = 0; cz < cells; ++cz)
+        {
+            for (UINT cx = 0; cx < cells; ++cx)
+            {
+                int bx0 = max(0, (int)cx * scale + scale / 2);
+                int bz0 = max(0, (int)cz * scale + scale / 2);
+                int bx1 = min(res + 1, (int)(cx + 1) * scale + scale / 2 + 1);
+                int bz1 = min(res + 1, (int)(cz + 1) * scale + scale / 2 + 1);
+                
+                XMFLOAT2 range(FLT_MAX, -FLT_MAX);
+                for (int bz = bz0; bz <= bz1; ++bz)
+                {
+                    for (int bx = bx0; bx <= bx1; ++bx)
+                    {
+                        float h = upload.Data[(size_t)bz * upload.Size + bx];
+                        range.x = min(range.x, h);
+                        range.y = max(range.y, h);
+                    }
+                }
+                ranges[(size_t)cz * cells + cx] = range;
+            }
+        }
+        
+        mDetailPyramid.Widen(upload.Key.X * cells, upload.Key.Y * cells, cells, cells, ranges);
+    }
+    
+    UpdateNodeHeightRanges();
+}
+
+QuadTree::HeightRangeQuery TerrainApp::GetHeightRangeQuery()
+{
+    if (!mStreamingEnabled || mDetailPyramid.IsEmpty())
+    {
+        return [this](float x, float z, float size, float& minY, float& maxY)
+        {
+            mTerrain->GetHeightRange(x, z, size, minY, maxY);
+        };
+    }
+    
+    // Same mapping as Terrain::GetHeightRange, against the detail tiles
+    return [this](float x, float z, float size, float& minY, float& maxY)
+    {
+        float terrainSize = mTerrain->GetTerrainSize();
+        float width = (float)mDetailPyramid.GetLevelWidth(0);
+        float height = (float)mDetailPyramid.GetLevelHeight(0);
+        float halfSize = size * 0.5f;
+        
+        float h0 = 0.0f, h1 = 1.0f;
+        mDetailPyramid.GetRange(((x - halfSize) / terrainSize + 0.5f) * width - 1.0f,
+                                ((z - halfSize) / terrainSize + 0.5f) * height - 1.0f,
+                                ((x + halfSize) / terrainSize + 0.5f) * width + 1.0f,
+                                ((z + halfSize) / terrainSize + 0.5f) * height + 1.0f, h0, h1);
+        
+        float range = mTerrain->GetMaxHeight() - mTerrain->GetMinHeight();
+        minY = mTerrain->GetMinHeight() + h0 * range;
+        maxY = mTerrain->GetMinHeight() + h1 * range;
+    };
+}
+
+void TerrainApp::UpdateNodeHeightRanges()
+{
+    mQuadTree->UpdateHeightRanges(GetHeightRangeQuery());
+}
+
+void TerrainApp::SaveRecordedCameraPath()
+{
+    // Replayed offline through ReplayCameraPath to study the streaming schedule
+    if (!mCameraPath.empty() && SaveCameraPath(L"camera_path.txt", mCameraPath))
+        std::cout << "Camera path saved: camera_path.txt (" << mCameraPath.size() << " samples)" << std::endl;
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 2> TerrainApp::GetStaticSamplers()
 {
     const CD3DX12_STATIC_SAMPLER_DESC linearWrap(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR,
@@ -1000,8 +1424,8 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 2> TerrainApp::GetStaticSamplers()
     return { linearWrap, linearClamp };
 }
 
-// Ray-terrain intersection for mouse picking
-bool TerrainApp::RayTerrainIntersect(int mouseX, int mouseY, XMFLOAT3& hitPoint)
+// Ray from the camera through a pixel, in world space
+HeightfieldRay TerrainApp::GetMouseRay(int mouseX, int mouseY)
 {
     // Convert mouse coordinates to normalized device coordinates [-1, 1]
     float ndcX = (2.0f * mouseX) / mClientWidth - 1.0f;
@@ -1019,66 +1443,23 @@ bool TerrainApp::RayTerrainIntersect(int mouseX, int mouseY, XMFLOAT3& hitPoint)
     XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0.0f, 1.0f), invViewProj);
     XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1.0f, 1.0f), invViewProj);
     
-    // Ray direction
-    XMVECTOR rayDir = XMVector3Normalize(XMVectorSubtract(farPoint, nearPoint));
+    HeightfieldRay ray;
+    XMStoreFloat3(&ray.Origin, nearPoint);
+    XMStoreFloat3(&ray.Direction, XMVector3Normalize(XMVectorSubtract(farPoint, nearPoint)));
+    ray.MaxT = 3000.0f;
+    return ray;
+}
 
-    // Ray-terrain intersection using heightmap
-    XMFLOAT3 rayStart, rayDirection;
-    XMStoreFloat3(&rayStart, nearPoint);
-    XMStoreFloat3(&rayDirection, rayDir);
+// Ray-terrain intersection for mouse picking
+bool TerrainApp::RayTerrainIntersect(int mouseX, int mouseY, XMFLOAT3& hitPoint)
+{
+    // Exact hit on the bilinear heightfield, skipping empty space with the max-height pyramid
+    HeightfieldHit hit;
+    if (!mTerrain->GetRayCaster().Intersect(GetMouseRay(mouseX, mouseY), hit))
+        return false;
 
-    // Step along ray and test height (binary search refinement)
-    float terrainSize = mTerrain->GetTerrainSize();
-    float halfSize = terrainSize * 0.5f;
-    
-    // Coarse search
-    float lastT = 0.0f;
-    for (float t = 1.0f; t < 3000.0f; t += 1.0f)
-    {
-        XMFLOAT3 testPoint = {
-            rayStart.x + rayDirection.x * t,
-            rayStart.y + rayDirection.y * t,
-            rayStart.z + rayDirection.z * t
-        };
-        
-        // Check if point is within terrain bounds
-        if (testPoint.x >= -halfSize && testPoint.x <= halfSize &&
-            testPoint.z >= -halfSize && testPoint.z <= halfSize)
-        {
-            float terrainHeight = mTerrain->GetHeight(testPoint.x, testPoint.z);
-            
-            if (testPoint.y <= terrainHeight)
-            {
-                // Binary search for precise intersection
-                float lo = lastT, hi = t;
-                for (int i = 0; i < 16; ++i)
-                {
-                    float mid = (lo + hi) * 0.5f;
-                    XMFLOAT3 midPoint = {
-                        rayStart.x + rayDirection.x * mid,
-                        rayStart.y + rayDirection.y * mid,
-                        rayStart.z + rayDirection.z * mid
-                    };
-                    float midHeight = mTerrain->GetHeight(midPoint.x, midPoint.z);
-                    if (midPoint.y <= midHeight)
-                        hi = mid;
-                    else
-                        lo = mid;
-                }
-                
-                float finalT = (lo + hi) * 0.5f;
-                hitPoint = {
-                    rayStart.x + rayDirection.x * finalT,
-                    mTerrain->GetHeight(rayStart.x + rayDirection.x * finalT, rayStart.z + rayDirection.z * finalT),
-                    rayStart.z + rayDirection.z * finalT
-                };
-                return true;
-            }
-        }
-        lastT = t;
-    }
-    
-    return false;
+    hitPoint = hit.Position;
+    return true;
 }
 
 // Paint on terrain at world position
@@ -1096,65 +1477,63 @@ void TerrainApp::PaintOnTerrain(const XMFLOAT3& worldPos)
     v = max(0.0f, min(1.0f, v));
     
     // Convert to paint texture coordinates
-    int paintWidth = 512;
-    int paintHeight = 512;
+    int paintWidth = (int)mPaintLayer->GetWidth();
+    int paintHeight = (int)mPaintLayer->GetHeight();
     int centerX = (int)(u * (paintWidth - 1));
     int centerY = (int)(v * (paintHeight - 1));
     
     // Paint with brush - ensure minimum radius of 2 pixels
     int brushRadius = max(2, (int)(mBrushSize * paintWidth / terrainSize));
     
-    for (int y = centerY - brushRadius; y <= centerY + brushRadius; ++y)
+    // Soft brush, half strength at the center; the touched tiles are uploaded next frame
+    mPaintLayer->Paint(centerX, centerY, brushRadius, mPaintColor, 0.5f);
+}
+
+// Copy dirty paint tiles into the texture, at most gMaxPaintTileUploads per frame
+void TerrainApp::UploadPaintTiles()
+{
+    mPaintLayer->TakeDirtyTiles(gMaxPaintTileUploads, mPaintUploadTiles);
+    mPaintTilesUploaded = (UINT)mPaintUploadTiles.size();
+    if (mPaintUploadTiles.empty())
+        return;
+    
+    ID3D12Resource* uploadBuffer = mPaintUploadBuffers[mCurrFrameResourceIndex].Get();
+    BYTE* mapped = mMappedPaintUploads[mCurrFrameResourceIndex];
+    UINT64 offset = 0;
+    
+    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+        mPaintTexture.Get(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST));
+    
+    const UINT tileSize = mPaintLayer->GetTileSize();
+    for (UINT tile : mPaintUploadTiles)
     {
-        for (int x = centerX - brushRadius; x <= centerX + brushRadius; ++x)
+        UINT x, y, width, height;
+        mPaintLayer->GetTileRect(tile, x, y, width, height);
+        
+        offset = AlignUp(offset, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+        
+        D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+        footprint.Offset = offset;
+        footprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        footprint.Footprint.Width = width;
+        footprint.Footprint.Height = height;
+        footprint.Footprint.Depth = 1;
+        footprint.Footprint.RowPitch = (UINT)AlignUp(width * sizeof(UINT), D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+        
+        // A dirty tile has been painted, so its data is allocated
+        const UINT* src = mPaintLayer->GetTileData(tile);
+        for (UINT row = 0; row < height; ++row)
         {
-            if (x >= 0 && x < paintWidth && y >= 0 && y < paintHeight)
-            {
-                // Calculate distance from center
-                float dx = (float)(x - centerX);
-                float dy = (float)(y - centerY);
-                float distance = sqrtf(dx * dx + dy * dy);
-                
-                if (distance <= (float)brushRadius)
-                {
-                    // Soft brush falloff
-                    float alpha = 1.0f - (distance / (float)brushRadius);
-                    alpha = alpha * alpha; // Quadratic falloff
-                    
-                    int index = y * paintWidth + x;
-                    UINT& pixel = mPaintData[index];
-                    
-                    // Extract current color
-                    float currentR = ((pixel >> 0) & 0xFF) / 255.0f;
-                    float currentG = ((pixel >> 8) & 0xFF) / 255.0f;
-                    float currentB = ((pixel >> 16) & 0xFF) / 255.0f;
-                    float currentA = ((pixel >> 24) & 0xFF) / 255.0f;
-                    
-                    // Blend with paint color (stronger paint)
-                    float blendAlpha = alpha * 0.5f; // Paint strength
-                    float newR = currentR * (1.0f - blendAlpha) + mPaintColor.x * blendAlpha;
-                    float newG = currentG * (1.0f - blendAlpha) + mPaintColor.y * blendAlpha;
-                    float newB = currentB * (1.0f - blendAlpha) + mPaintColor.z * blendAlpha;
-                    float newA = min(currentA + blendAlpha, 1.0f);
-                    
-                    // Pack back to UINT
-                    UINT r = (UINT)(newR * 255.0f);
-                    UINT g = (UINT)(newG * 255.0f);
-                    UINT b = (UINT)(newB * 255.0f);
-                    UINT a = (UINT)(newA * 255.0f);
-                    
-                    pixel = (a << 24) | (b << 16) | (g << 8) | r;
-                }
-            }
+            memcpy(mapped + offset + (UINT64)row * footprint.Footprint.RowPitch,
+                   src + (size_t)row * tileSize, width * sizeof(UINT));
         }
+        offset += (UINT64)footprint.Footprint.RowPitch * height;
+        
+        CD3DX12_TEXTURE_COPY_LOCATION dstLocation(mPaintTexture.Get(), 0);
+        CD3DX12_TEXTURE_COPY_LOCATION srcLocation(uploadBuffer, footprint);
+        mCommandList->CopyTextureRegion(&dstLocation, x, y, 0, &srcLocation, nullptr);
     }
     
-    // Mark for update
-    UpdatePaintTexture();
+    mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+        mPaintTexture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
 }
-
-// Update paint texture on GPU
-void TerrainApp::UpdatePaintTexture()
-{
-    mPaintTextureNeedsUpdate = true;
-}
\ No newline at end of file
@@ -0,0 +1,204 @@
+//***************************************************************************************
+// TerrainTileSet.cpp - Gaea tile set implementation
+//***************************************************************************************
+
+#include "TerrainTileSet.h"
+#include "../../Common/DDSDecoder.h"
+#include <fstream>
+
+namespace
+{
+    const wchar_t* LayerName(TerrainTileLayer layer)
+    {
+        switch (layer)
+        {
+        case TerrainTileLayer::Normals:    return L"Normals";
+        case TerrainTileLayer::AO:         return L"AO";
+        case TerrainTileLayer::Weathering: return L"Weathering";
+        default:                           return L"Height";
+        }
+    }
+
+    bool FileExists(const std::wstring& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return file.is_open();
+    }
+}
+
+bool TerrainTileSet::Open(const std::wstring& directory)
+{
+    mDirectory = directory;
+    mTilesX = mTilesY = 0;
+    mTileResolution = mMipCount = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mFileMutex);
+        mFileCache.clear();
+    }
+
+    // Grid size from the first row and column of height tiles
+    int tilesX = 0, tilesY = 0;
+    while (FileExists(GetTilePath(TerrainTileLayer::Height, tilesX, 0)))
+        ++tilesX;
+    while (FileExists(GetTilePath(TerrainTileLayer::Height, 0, tilesY)))
+        ++tilesY;
+
+    if (tilesX == 0 || tilesY == 0)
+        return false;
+
+    mTilesX = tilesX;
+    mTilesY = tilesY;
+
+    FileData first = ReadHeightFile(0, 0);
+    DDSDecoder::Info info;
+    if (!first || !DDSDecoder::GetInfo(first->data(), first->size(), info) || info.Width != info.Height)
+    {
+        mTilesX = mTilesY = 0;
+        return false;
+    }
+
+    mTileResolution = info.Width;
+    mMipCount = info.MipCount;
+    return true;
+}
+
+std::wstring TerrainTileSet::GetTilePath(TerrainTileLayer layer, int x, int y) const
+{
+    const wchar_t* name = LayerName(layer);
+    return mDirectory + L"/" + name + L"/" + name + L"_Out_y" +
+           std::to_wstring(y) + L"_x" + std::to_wstring(x) + L".dds";
+}
+
+TerrainTileSet::FileData TerrainTileSet::ReadHeightFile(int x, int y) const
+{
+    int key = y * max(mTilesX, 1) + x;
+
+    {
+        std::lock_guard<std::mutex> lock(mFileMutex);
+        for (auto it = mFileCache.begin(); it != mFileCache.end(); ++it)
+        {
+            if (it->first == key)
+            {
+                mFileCache.splice(mFileCache.begin(), mFileCache, it);
+                return it->second;
+            }
+        }
+    }
+
+    // Read outside the lock; two threads may read the same file, which is harmless
+    std::ifstream file(GetTilePath(TerrainTileLayer::Height, x, y), std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return nullptr;
+
+    auto data = std::make_shared<std::vector<uint8_t>>((size_t)file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(reinterpret_cast<char*>(data->data()), data->size());
+    if (!file)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    mFileCache.emplace_front(key, data);
+    if (mFileCache.size() > MaxCachedFiles)
+        mFileCache.pop_back();
+    return data;
+}
+
+bool TerrainTileSet::LoadHeightTile(int x, int y, UINT mip, std::vector<float>& heights,
+                                    float& minH, float& maxH) const
+{
+    if (!IsOpen() || x < 0 || y < 0 || x >= mTilesX || y >= mTilesY || mip >= mMipCount)
+        return false;
+
+    const int res = (int)max(1u, mTileResolution >> mip);
+    const int stride = res + 2;
+    heights.assign((size_t)stride * stride, 0.0f);
+
+    // Tile itself plus the edge texels of its 8 neighbours. Border texel (bx, bz)
+    // in [-1, res] maps to tile-local texel (bx, bz); neighbours supply what is outside.
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            int nx = x + dx, ny = y + dy;
+            if (nx < 0 || ny < 0 || nx >= mTilesX || ny >= mTilesY)
+                continue;
+
+            DDSDecoder::Region region;
+            region.X = (dx < 0) ? res - 1 : 0;
+            region.Y = (dy < 0) ? res - 1 : 0;
+            region.Width = (dx == 0) ? res : 1;
+            region.Height = (dy == 0) ? res : 1;
+
+            FileData file = ReadHeightFile(nx, ny);
+            DDSDecoder::Image image;
+            if (!file || !DDSDecoder::LoadRegionFromMemory(file->data(), file->size(), mip, region, image))
+            {
+                // Missing neighbour: the clamp pass below fills its border
+                if (dx == 0 && dy == 0)
+                    return false;
+                continue;
+            }
+
+            int ox = (dx < 0) ? 0 : (dx == 0 ? 1 : res + 1);
+            int oy = (dy < 0) ? 0 : (dy == 0 ? 1 : res + 1);
+            for (UINT row = 0; row < image.Height; ++row)
+            {
+                for (UINT col = 0; col < image.Width; ++col)
+                    heights[(size_t)(oy + row) * stride + ox + col] = image.Texels[(size_t)row * image.Width + col].x;
+            }
+        }
+    }
+
+    // Clamp-to-edge at the terrain border, matching the single texture's sampler
+    int minX = (x == 0) ? 1 : 0, maxX = (x == mTilesX - 1) ? res : res + 1;
+    int minY = (y == 0) ? 1 : 0, maxY = (y == mTilesY - 1) ? res : res + 1;
+    for (int bz = 0; bz < stride; ++bz)
+    {
+        for (int bx = 0; bx < stride; ++bx)
+        {
+            int cx = max(minX, min(bx, maxX));
+            int cz = max(minY, min(bz, maxY));
+            if (cx != bx || cz != bz)
+                heights[(size_t)bz * stride + bx] = heights[(size_t)cz * stride + cx];
+        }
+    }
+
+    minH = FLT_MAX;
+    maxH = -FLT_MAX;
+    for (float h : heights)
+    {
+        minH = min(minH, h);
+        maxH = max(maxH, h);
+    }
+    return true;
+}
+
+bool TerrainTileSet::LoadHeightLevel(UINT mip, std::vector<float>& heights, UINT& width, UINT& height) const
+{
+    if (!IsOpen() || mip >= mMipCount)
+        return false;
+
+    const UINT res = max(1u, mTileResolution >> mip);
+    width = res * mTilesX;
+    height = res * mTilesY;
+    heights.assign((size_t)width * height, 0.0f);
+
+    for (int y = 0; y < mTilesY; ++y)
+    {
+        for (int x = 0; x < mTilesX; ++x)
+        {
+            FileData file = ReadHeightFile(x, y);
+            DDSDecoder::Image image;
+            if (!file || !DDSDecoder::LoadFromMemory(file->data(), file->size(), image, mip))
+                return false;
+
+            for (UINT row = 0; row < res; ++row)
+            {
+                for (UINT col = 0; col < res; ++col)
+                    heights[(size_t)(y * res + row) * width + x * res + col] = image.Texels[(size_t)row * res + col].x;
+            }
+        }
+    }
+    return true;
+}
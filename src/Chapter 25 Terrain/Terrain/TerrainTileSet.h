@@ -0,0 +1,65 @@
+//***************************************************************************************
+// TerrainTileSet.h - Gaea tile set on disk (TerrainDetails/001, 002)
+//
+// A tile set is a grid of DDS tiles per layer, named <Layer>/<Layer>_Out_y{N}_x{M}.dds.
+// Tile (x, y) covers [x/TilesX, (x+1)/TilesX] x [y/TilesY, (y+1)/TilesY] of the terrain's
+// UV space; the tiles are cut from one image without overlap.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+
+enum class TerrainTileLayer
+{
+    Height,
+    Normals,
+    AO,
+    Weathering
+};
+
+class TerrainTileSet
+{
+public:
+    // Probes the height layer to find the grid size and tile format
+    bool Open(const std::wstring& directory);
+
+    bool IsOpen() const { return mTilesX > 0; }
+    int GetTilesX() const { return mTilesX; }
+    int GetTilesY() const { return mTilesY; }
+    UINT GetTileResolution() const { return mTileResolution; }
+    UINT GetMipCount() const { return mMipCount; }
+
+    std::wstring GetTilePath(TerrainTileLayer layer, int x, int y) const;
+
+    // Decodes a height tile at a mip level with a one-texel border copied from the
+    // neighbouring tiles at the same level (clamped at the terrain edge), so filtering
+    // across a tile edge sees the same texels from both sides. heights receives
+    // (res+2)^2 values, res = tile resolution >> mip. Safe to call from any thread.
+    bool LoadHeightTile(int x, int y, UINT mip, std::vector<float>& heights,
+                        float& minH, float& maxH) const;
+
+    // Assembles the whole height layer at one mip level (no borders)
+    bool LoadHeightLevel(UINT mip, std::vector<float>& heights, UINT& width, UINT& height) const;
+
+private:
+    using FileData = std::shared_ptr<const std::vector<uint8_t>>;
+    FileData ReadHeightFile(int x, int y) const;
+
+private:
+    std::wstring mDirectory;
+    int mTilesX = 0;
+    int mTilesY = 0;
+    UINT mTileResolution = 0;
+    UINT mMipCount = 0;
+
+    // Compressed tile files, most recent first. Neighbours are read for their edges,
+    // so keeping the last few files avoids reading each one several times.
+    static const size_t MaxCachedFiles = 16;
+    mutable std::mutex mFileMutex;
+    mutable std::list<std::pair<int, FileData>> mFileCache;
+};
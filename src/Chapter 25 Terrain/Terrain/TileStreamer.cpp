@@ -0,0 +1,494 @@
+//***************************************************************************************
+// TileStreamer.cpp - Height tile streaming implementation
+//***************************************************************************************
+
+#include "TileStreamer.h"
+#include <algorithm>
+#include <fstream>
+#include <cmath>
+#include <climits>
+#include <cstring>
+
+using namespace DirectX;
+
+const uint64_t TileStreamer::InvalidKey;
+
+TileStreamer::TileStreamer(const Desc& desc, TileLoader loader)
+    : mDesc(desc), mLoader(std::move(loader))
+{
+    mDesc.TilesX = max(mDesc.TilesX, 1);
+    mDesc.TilesY = max(mDesc.TilesY, 1);
+    mDesc.MaxRequestsInFlight = max(mDesc.MaxRequestsInFlight, 1u);
+
+    int tileCount = mDesc.TilesX * mDesc.TilesY;
+    mSlotOwners.assign(mDesc.AtlasSlotsX * mDesc.AtlasSlotsY, InvalidKey);
+    mWantedMip.assign(tileCount, UINT_MAX);
+    mTileVisible.assign(tileCount, false);
+    mDisplayed.assign(tileCount, InvalidKey);
+    mPageTable.assign(tileCount, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+}
+
+TileStreamer::~TileStreamer()
+{
+    // Workers write into mLoading, so they must finish before it goes away
+    for (auto& loading : mLoading)
+    {
+        if (loading.Result.valid())
+            loading.Result.wait();
+    }
+}
+
+void TileStreamer::Reset()
+{
+    for (auto& loading : mLoading)
+    {
+        if (loading.Result.valid())
+            loading.Result.wait();
+    }
+    mLoading.clear();
+    mRequests.clear();
+    mCache.clear();
+    mLru.clear();
+    mMemoryUsed = 0;
+
+    std::fill(mSlotOwners.begin(), mSlotOwners.end(), InvalidKey);
+    std::fill(mDisplayed.begin(), mDisplayed.end(), InvalidKey);
+    std::fill(mPageTable.begin(), mPageTable.end(), XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+    mPageTableDirty = true;
+    mUploads.clear();
+    mStats = Stats();
+}
+
+void TileStreamer::Update(const XMFLOAT3& cameraPos, const XMFLOAT3& cameraVelocity,
+                          const std::vector<TerrainNode*>& visibleNodes)
+{
+    ++mFrame;
+    ++mStats.Frames;
+    mUploads.clear();
+
+    CollectFinishedLoads(false);
+    GatherWantedTiles(cameraPos, cameraVelocity, visibleNodes);
+    StartRequests();
+
+    // Synchronous mode: everything requested this frame is resident before the page
+    // table is built, so a replay gives the same result on every run
+    if (!mDesc.Asynchronous)
+        CollectFinishedLoads(true);
+
+    EvictToBudget();
+    UpdatePageTable();
+
+    mStats.InFlight = (UINT)mLoading.size();
+    mStats.ResidentTiles = (UINT)mCache.size();
+    mStats.MemoryUsed = mMemoryUsed;
+}
+
+float TileStreamer::DistanceToTile(const XMFLOAT3& p, int x, int y) const
+{
+    float tileW = mDesc.TerrainSize / mDesc.TilesX;
+    float tileH = mDesc.TerrainSize / mDesc.TilesY;
+    float x0 = -0.5f * mDesc.TerrainSize + x * tileW;
+    float z0 = -0.5f * mDesc.TerrainSize + y * tileH;
+
+    // Horizontal distance to the tile's rectangle; height is left out so flying
+    // higher does not drop detail straight below the camera
+    float dx = max(max(x0 - p.x, p.x - (x0 + tileW)), 0.0f);
+    float dz = max(max(z0 - p.z, p.z - (z0 + tileH)), 0.0f);
+    return sqrtf(dx * dx + dz * dz);
+}
+
+UINT TileStreamer::DesiredMip(float distance) const
+{
+    if (distance <= mDesc.MipDistance)
+        return 0;
+    return (UINT)floorf(log2f(distance / mDesc.MipDistance)) + 1;
+}
+
+void TileStreamer::GatherWantedTiles(const XMFLOAT3& cameraPos, const XMFLOAT3& cameraVelocity,
+                                     const std::vector<TerrainNode*>& visibleNodes)
+{
+    std::fill(mWantedMip.begin(), mWantedMip.end(), UINT_MAX);
+    std::fill(mTileVisible.begin(), mTileVisible.end(), false);
+    mRequests.clear();
+
+    float half = 0.5f * mDesc.TerrainSize;
+    float tileW = mDesc.TerrainSize / mDesc.TilesX;
+    float tileH = mDesc.TerrainSize / mDesc.TilesY;
+
+    auto want = [&](int x, int y, float distance, float priority)
+    {
+        UINT mip = DesiredMip(distance);
+        if (mip >= mDesc.BaseMip)
+            return;
+
+        int index = TileIndex(x, y);
+        if (mip >= mWantedMip[index])
+            return;
+        mWantedMip[index] = mip;
+
+        // Whatever the tile shows now stays cached until the wanted level arrives
+        auto shown = mCache.find(mDisplayed[index]);
+        if (shown != mCache.end())
+            Touch(shown->second);
+
+        // A resident level at least as fine as wanted needs no load
+        for (UINT m = 0; m <= mip; ++m)
+        {
+            auto it = mCache.find(TileKey{ x, y, m }.Hash());
+            if (it != mCache.end())
+            {
+                Touch(it->second);
+                ++mStats.CacheHits;
+                return;
+            }
+        }
+        mRequests.push_back({ TileKey{ x, y, mip }, priority });
+    };
+
+    // Tiles under the visible nodes, by distance to the camera
+    for (const TerrainNode* node : visibleNodes)
+    {
+        float hs = node->Size * 0.5f;
+        int x0 = max(0, (int)floorf((node->X - hs + half) / tileW));
+        int x1 = min(mDesc.TilesX - 1, (int)ceilf((node->X + hs + half) / tileW) - 1);
+        int y0 = max(0, (int)floorf((node->Z - hs + half) / tileH));
+        int y1 = min(mDesc.TilesY - 1, (int)ceilf((node->Z + hs + half) / tileH) - 1);
+
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                mTileVisible[TileIndex(x, y)] = true;
+                float distance = DistanceToTile(cameraPos, x, y);
+                want(x, y, distance, distance);
+            }
+        }
+    }
+
+    // Look-ahead: tiles around where the camera will be, queued after everything visible
+    XMVECTOR velocity = XMLoadFloat3(&cameraVelocity);
+    if (mDesc.PrefetchTime > 0.0f && XMVectorGetX(XMVector3LengthSq(velocity)) > 1e-4f)
+    {
+        XMFLOAT3 predicted;
+        XMStoreFloat3(&predicted, XMLoadFloat3(&cameraPos) + velocity * mDesc.PrefetchTime);
+
+        for (int y = 0; y < mDesc.TilesY; ++y)
+        {
+            for (int x = 0; x < mDesc.TilesX; ++x)
+            {
+                float distance = DistanceToTile(predicted, x, y);
+                if (distance <= mDesc.MipDistance)
+                    want(x, y, distance, mDesc.TerrainSize + distance);
+            }
+        }
+    }
+
+    std::stable_sort(mRequests.begin(), mRequests.end(),
+        [](const Request& a, const Request& b) { return a.Priority < b.Priority; });
+}
+
+void TileStreamer::StartRequests()
+{
+    for (const Request& request : mRequests)
+    {
+        if (mLoading.size() >= mDesc.MaxRequestsInFlight)
+            break;
+
+        uint64_t hash = request.Key.Hash();
+        bool pending = std::any_of(mLoading.begin(), mLoading.end(),
+            [hash](const Loading& l) { return l.Key.Hash() == hash; });
+        if (pending)
+            continue;
+
+        mLoading.emplace_back();
+        Loading& loading = mLoading.back();
+        loading.Key = request.Key;
+
+        // std::list never moves its elements, so the worker can write into them
+        Loading* target = &loading;
+        TileLoader& loader = mLoader;
+        auto work = [target, &loader]()
+        {
+            return loader(target->Key, target->Heights, target->MinH, target->MaxH);
+        };
+        loading.Result = std::async(mDesc.Asynchronous ? std::launch::async : std::launch::deferred, work);
+        ++mStats.Requests;
+    }
+}
+
+void TileStreamer::CollectFinishedLoads(bool wait)
+{
+    for (auto it = mLoading.begin(); it != mLoading.end();)
+    {
+        if (!wait && it->Result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++it;
+            continue;
+        }
+
+        if (it->Result.get())
+            Insert(*it);
+        it = mLoading.erase(it);
+    }
+}
+
+void TileStreamer::Insert(Loading& loading)
+{
+    uint64_t hash = loading.Key.Hash();
+    if (mCache.count(hash))
+        return;
+
+    Entry& entry = mCache[hash];
+    entry.Key = loading.Key;
+    entry.Heights = std::move(loading.Heights);
+    entry.MinH = loading.MinH;
+    entry.MaxH = loading.MaxH;
+    mLru.push_front(hash);
+    entry.LruIt = mLru.begin();
+    entry.LastUsedFrame = mFrame;
+
+    mMemoryUsed += entry.Heights.size() * sizeof(float);
+    mStats.PeakMemory = max(mStats.PeakMemory, mMemoryUsed);
+}
+
+void TileStreamer::Touch(Entry& entry)
+{
+    mLru.splice(mLru.begin(), mLru, entry.LruIt);
+    entry.LastUsedFrame = mFrame;
+}
+
+void TileStreamer::EvictToBudget()
+{
+    // Oldest first; tiles used this frame stay even if that means going over budget
+    while (mMemoryUsed > mDesc.MemoryBudget && !mLru.empty())
+    {
+        uint64_t hash = mLru.back();
+        Entry& entry = mCache[hash];
+        if (entry.LastUsedFrame == mFrame)
+            break;
+
+        if (entry.Slot >= 0)
+            mSlotOwners[entry.Slot] = InvalidKey;
+
+        int index = TileIndex(entry.Key.X, entry.Key.Y);
+        if (mDisplayed[index] == hash)
+            mDisplayed[index] = InvalidKey;
+
+        mMemoryUsed -= entry.Heights.size() * sizeof(float);
+        mLru.pop_back();
+        mCache.erase(hash);
+        ++mStats.Evictions;
+    }
+}
+
+int TileStreamer::AllocateSlot()
+{
+    for (size_t i = 0; i < mSlotOwners.size(); ++i)
+    {
+        if (mSlotOwners[i] == InvalidKey)
+            return (int)i;
+    }
+
+    // Take the slot of the least recently used tile that is not on screen
+    int victim = -1;
+    UINT oldest = mFrame;
+    for (size_t i = 0; i < mSlotOwners.size(); ++i)
+    {
+        const Entry& owner = mCache[mSlotOwners[i]];
+        int index = TileIndex(owner.Key.X, owner.Key.Y);
+        bool shown = mDisplayed[index] == mSlotOwners[i] && mTileVisible[index];
+        if (!shown && owner.LastUsedFrame < oldest)
+        {
+            oldest = owner.LastUsedFrame;
+            victim = (int)i;
+        }
+    }
+
+    if (victim < 0)
+        return -1;
+
+    Entry& owner = mCache[mSlotOwners[victim]];
+    int index = TileIndex(owner.Key.X, owner.Key.Y);
+    if (mDisplayed[index] == mSlotOwners[victim])
+        mDisplayed[index] = InvalidKey;
+    owner.Slot = -1;
+    mSlotOwners[victim] = InvalidKey;
+    return victim;
+}
+
+void TileStreamer::UpdatePageTable()
+{
+    std::vector<XMFLOAT4> previous = mPageTable;
+    float atlasW = (float)GetAtlasWidth();
+    float atlasH = (float)GetAtlasHeight();
+
+    for (int y = 0; y < mDesc.TilesY; ++y)
+    {
+        for (int x = 0; x < mDesc.TilesX; ++x)
+        {
+            int index = TileIndex(x, y);
+            UINT wanted = mWantedMip[index];
+
+            // Finest resident level; a finer one than wanted is still fine to show
+            Entry* best = nullptr;
+            if (wanted != UINT_MAX)
+            {
+                for (UINT mip = 0; mip < mDesc.BaseMip && !best; ++mip)
+                {
+                    auto it = mCache.find(TileKey{ x, y, mip }.Hash());
+                    if (it != mCache.end())
+                        best = &it->second;
+                }
+            }
+
+            if (best && best->Slot < 0)
+            {
+                // New atlas contents are limited per frame; over the limit the tile
+                // keeps what it showed before
+                int slot = (mUploads.size() < mDesc.MaxUploadsPerFrame) ? AllocateSlot() : -1;
+                if (slot >= 0)
+                {
+                    best->Slot = slot;
+                    mSlotOwners[slot] = best->Key.Hash();
+
+                    SlotUpload upload;
+                    upload.Key = best->Key;
+                    upload.X = (slot % mDesc.AtlasSlotsX) * SlotSize();
+                    upload.Y = (slot / mDesc.AtlasSlotsX) * SlotSize();
+                    upload.Size = TileMipResolution(best->Key.Mip) + 2;
+                    upload.Data = best->Heights.data();
+                    mUploads.push_back(upload);
+                    ++mStats.Uploads;
+                }
+                else
+                {
+                    auto it = mCache.find(mDisplayed[index]);
+                    best = (it != mCache.end() && it->second.Slot >= 0) ? &it->second : nullptr;
+                }
+            }
+
+            if (best && best->Slot >= 0)
+            {
+                // Tile UV [0,1] maps to the texels after the border in the tile's slot
+                float res = (float)TileMipResolution(best->Key.Mip);
+                float ox = (float)((best->Slot % mDesc.AtlasSlotsX) * SlotSize() + 1);
+                float oy = (float)((best->Slot / mDesc.AtlasSlotsX) * SlotSize() + 1);
+                mPageTable[index] = XMFLOAT4(res / atlasW, res / atlasH, ox / atlasW, oy / atlasH);
+                mDisplayed[index] = best->Key.Hash();
+                Touch(*best);
+            }
+            else
+            {
+                mPageTable[index] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+                mDisplayed[index] = InvalidKey;
+            }
+
+            if (mTileVisible[index] && wanted != UINT_MAX &&
+                (!best || best->Key.Mip > wanted))
+            {
+                ++mStats.CoarseFallbacks;
+            }
+        }
+    }
+
+    if (memcmp(previous.data(), mPageTable.data(), mPageTable.size() * sizeof(XMFLOAT4)) != 0)
+        mPageTableDirty = true;
+}
+
+//---------------------------------------------------------------------------------------
+// Camera paths
+//---------------------------------------------------------------------------------------
+
+bool SaveCameraPath(const std::wstring& filename, const std::vector<CameraPathSample>& path)
+{
+#ifdef _WIN32
+    std::ofstream file(filename);
+#else
+    // Only MSVC's streams take wide file names; ASCII names pass through unchanged
+    std::ofstream file(std::string(filename.begin(), filename.end()));
+#endif
+    if (!file.is_open())
+        return false;
+
+    for (const CameraPathSample& s : path)
+    {
+        file << s.Time << ' '
+             << s.Position.x << ' ' << s.Position.y << ' ' << s.Position.z << ' '
+             << s.Look.x << ' ' << s.Look.y << ' ' << s.Look.z << '\n';
+    }
+    return (bool)file;
+}
+
+bool LoadCameraPath(const std::wstring& filename, std::vector<CameraPathSample>& path)
+{
+#ifdef _WIN32
+    std::ifstream file(filename);
+#else
+    std::ifstream file(std::string(filename.begin(), filename.end()));
+#endif
+    if (!file.is_open())
+        return false;
+
+    path.clear();
+    CameraPathSample s;
+    while (file >> s.Time >> s.Position.x >> s.Position.y >> s.Position.z
+                >> s.Look.x >> s.Look.y >> s.Look.z)
+    {
+        path.push_back(s);
+    }
+    return !path.empty();
+}
+
+TileStreamer::Stats ReplayCameraPath(TileStreamer& streamer, QuadTree& quadTree,
+                                     const std::vector<CameraPathSample>& path,
+                                     float fovY, float aspect, float nearZ, float farZ,
+                                     const std::function<void(size_t sample)>& afterUpdate)
+{
+    XMMATRIX proj = XMMatrixPerspectiveFovLH(fovY, aspect, nearZ, farZ);
+    std::vector<TerrainNode*> visibleNodes;
+
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        const CameraPathSample& s = path[i];
+
+        XMVECTOR pos = XMLoadFloat3(&s.Position);
+        XMVECTOR look = XMVector3Normalize(XMLoadFloat3(&s.Look));
+        XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+        if (fabsf(XMVectorGetY(look)) > 0.999f)
+            up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+
+        XMFLOAT4X4 M;
+        XMStoreFloat4x4(&M, XMMatrixLookToLH(pos, look, up) * proj);
+
+        // Left, Right, Bottom, Top, Near, Far (same as TerrainApp)
+        XMFLOAT4 planes[6] =
+        {
+            { M._14 + M._11, M._24 + M._21, M._34 + M._31, M._44 + M._41 },
+            { M._14 - M._11, M._24 - M._21, M._34 - M._31, M._44 - M._41 },
+            { M._14 + M._12, M._24 + M._22, M._34 + M._32, M._44 + M._42 },
+            { M._14 - M._12, M._24 - M._22, M._34 - M._32, M._44 - M._42 },
+            { M._13, M._23, M._33, M._43 },
+            { M._14 - M._13, M._24 - M._23, M._34 - M._33, M._44 - M._43 }
+        };
+        for (XMFLOAT4& plane : planes)
+            XMStoreFloat4(&plane, XMPlaneNormalize(XMLoadFloat4(&plane)));
+
+        quadTree.Update(s.Position, planes);
+        visibleNodes.clear();
+        quadTree.GetVisibleNodes(visibleNodes);
+
+        // Velocity from the neighbouring samples, as the app derives it per frame
+        XMFLOAT3 velocity = { 0.0f, 0.0f, 0.0f };
+        if (i > 0 && s.Time > path[i - 1].Time)
+        {
+            XMVECTOR prev = XMLoadFloat3(&path[i - 1].Position);
+            XMStoreFloat3(&velocity, (pos - prev) / (s.Time - path[i - 1].Time));
+        }
+
+        streamer.Update(s.Position, velocity, visibleNodes);
+        if (afterUpdate)
+            afterUpdate(i);
+    }
+
+    return streamer.GetStats();
+}
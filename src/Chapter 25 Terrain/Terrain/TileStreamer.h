@@ -0,0 +1,197 @@
+//***************************************************************************************
+// TileStreamer.h - Height tile streaming with an LRU cache and a GPU page table
+//
+// Keeps the detail tiles near the camera resident at a mip level chosen by distance.
+// Each frame the visible QuadTree nodes are mapped onto the tiles they overlap, missing
+// tiles are requested (nearest first, plus a look-ahead along the camera velocity),
+// finished loads are copied into fixed slots of an atlas texture, and a page table
+// (one texel per tile) tells the shader where each tile lives. Tiles without a slot
+// fall back to an always-resident coarse level of the whole terrain.
+//
+// Loading goes through a TileLoader callback so the scheduler can be driven offline
+// (see ReplayCameraPath) with Asynchronous = false for repeatable results.
+//***************************************************************************************
+
+#pragma once
+
+#include "QuadTree.h"
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <future>
+#include <functional>
+
+struct TileKey
+{
+    int X = 0;
+    int Y = 0;
+    UINT Mip = 0;
+
+    uint64_t Hash() const { return ((uint64_t)(UINT)X << 32) | ((uint64_t)(UINT)Y << 8) | Mip; }
+};
+
+class TileStreamer
+{
+public:
+    struct Desc
+    {
+        float TerrainSize = 512.0f;         // World size of the tile grid, centered at the origin
+        int TilesX = 1;
+        int TilesY = 1;
+        UINT TileResolution = 512;          // Texels per tile side at mip 0
+        UINT BaseMip = 4;                   // Level kept resident by the app; never requested
+        size_t MemoryBudget = 24u << 20;    // Decoded tiles kept in the CPU cache (bytes)
+        UINT AtlasSlotsX = 4;               // Atlas holds AtlasSlotsX * AtlasSlotsY tiles
+        UINT AtlasSlotsY = 4;
+        UINT MaxRequestsInFlight = 4;
+        UINT MaxUploadsPerFrame = 2;
+        float MipDistance = 96.0f;          // Mip 0 inside this distance, +1 per doubling
+        float PrefetchTime = 1.5f;          // Seconds of camera motion to look ahead
+        bool Asynchronous = true;           // false: loads finish inside Update
+    };
+
+    // Fills (res+2)^2 heights (tile plus one-texel border) for a tile and mip level.
+    // Called from worker threads when Asynchronous is set.
+    using TileLoader = std::function<bool(const TileKey& key, std::vector<float>& heights,
+                                          float& minH, float& maxH)>;
+
+    // Atlas region to refresh from CPU memory. Data stays valid until the next Update.
+    struct SlotUpload
+    {
+        TileKey Key;                        // Tile and mip level the slot now holds
+        UINT X = 0;                         // Texel origin in the atlas
+        UINT Y = 0;
+        UINT Size = 0;                      // Width and height in texels
+        const float* Data = nullptr;
+    };
+
+    struct Stats
+    {
+        UINT Frames = 0;
+        UINT Requests = 0;                  // Loads started
+        UINT CacheHits = 0;                 // Wanted tiles already resident
+        UINT Evictions = 0;
+        UINT Uploads = 0;
+        UINT CoarseFallbacks = 0;           // Visible tiles drawn coarser than wanted, summed over frames
+        UINT InFlight = 0;
+        UINT ResidentTiles = 0;
+        size_t MemoryUsed = 0;
+        size_t PeakMemory = 0;
+    };
+
+    TileStreamer(const Desc& desc, TileLoader loader);
+    ~TileStreamer();
+
+    TileStreamer(const TileStreamer& rhs) = delete;
+    TileStreamer& operator=(const TileStreamer& rhs) = delete;
+
+    // Schedules loads for the tiles under the visible nodes and around the predicted
+    // camera position, then refreshes the page table from what is resident.
+    void Update(const DirectX::XMFLOAT3& cameraPos, const DirectX::XMFLOAT3& cameraVelocity,
+                const std::vector<TerrainNode*>& visibleNodes);
+
+    // One entry per tile, row major: xy = scale, zw = offset from tile UV to atlas UV.
+    // Zero scale means the tile has no slot and the base level should be used.
+    const std::vector<DirectX::XMFLOAT4>& GetPageTable() const { return mPageTable; }
+    bool IsPageTableDirty() const { return mPageTableDirty; }
+    void ClearPageTableDirty() { mPageTableDirty = false; }
+
+    const std::vector<SlotUpload>& GetPendingUploads() const { return mUploads; }
+
+    UINT GetAtlasWidth() const { return mDesc.AtlasSlotsX * SlotSize(); }
+    UINT GetAtlasHeight() const { return mDesc.AtlasSlotsY * SlotSize(); }
+    const Desc& GetDesc() const { return mDesc; }
+    const Stats& GetStats() const { return mStats; }
+    bool IsResident(const TileKey& key) const { return mCache.count(key.Hash()) != 0; }
+
+    // Waits for outstanding loads and drops every cached tile
+    void Reset();
+
+private:
+    struct Entry
+    {
+        TileKey Key;
+        std::vector<float> Heights;
+        float MinH = 0.0f;
+        float MaxH = 0.0f;
+        int Slot = -1;
+        UINT LastUsedFrame = 0;
+        std::list<uint64_t>::iterator LruIt;
+    };
+
+    struct Request
+    {
+        TileKey Key;
+        float Priority = 0.0f;              // Smaller loads first
+    };
+
+    struct Loading
+    {
+        TileKey Key;
+        std::future<bool> Result;
+        std::vector<float> Heights;
+        float MinH = 0.0f;
+        float MaxH = 0.0f;
+    };
+
+    UINT SlotSize() const { return mDesc.TileResolution + 2; }
+    UINT TileMipResolution(UINT mip) const { return max(1u, mDesc.TileResolution >> mip); }
+    int TileIndex(int x, int y) const { return y * mDesc.TilesX + x; }
+
+    float DistanceToTile(const DirectX::XMFLOAT3& p, int x, int y) const;
+    UINT DesiredMip(float distance) const;
+    void GatherWantedTiles(const DirectX::XMFLOAT3& cameraPos, const DirectX::XMFLOAT3& cameraVelocity,
+                           const std::vector<TerrainNode*>& visibleNodes);
+    void CollectFinishedLoads(bool wait);
+    void StartRequests();
+    void Insert(Loading& loading);
+    void Touch(Entry& entry);
+    void EvictToBudget();
+    int AllocateSlot();
+    void UpdatePageTable();
+
+private:
+    Desc mDesc;
+    TileLoader mLoader;
+
+    std::unordered_map<uint64_t, Entry> mCache;
+    std::list<uint64_t> mLru;               // Most recently used first
+    size_t mMemoryUsed = 0;
+
+    std::vector<Request> mRequests;
+    std::list<Loading> mLoading;
+
+    static const uint64_t InvalidKey = ~0ull;
+
+    std::vector<uint64_t> mSlotOwners;      // Cache key per atlas slot, InvalidKey = free
+    std::vector<UINT> mWantedMip;           // Per tile this frame; UINT_MAX = not wanted
+    std::vector<bool> mTileVisible;
+    std::vector<uint64_t> mDisplayed;       // Cache key shown per tile, InvalidKey = base level
+
+    std::vector<DirectX::XMFLOAT4> mPageTable;
+    bool mPageTableDirty = true;
+    std::vector<SlotUpload> mUploads;
+
+    UINT mFrame = 0;
+    Stats mStats;
+};
+
+// Camera motion recorded from the app, for replaying the scheduler offline
+struct CameraPathSample
+{
+    float Time = 0.0f;
+    DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 Look = { 0.0f, 0.0f, 1.0f };
+};
+
+// One sample per line: "time px py pz lx ly lz"
+bool SaveCameraPath(const std::wstring& filename, const std::vector<CameraPathSample>& path);
+bool LoadCameraPath(const std::wstring& filename, std::vector<CameraPathSample>& path);
+
+// Runs a recorded path through the QuadTree (LOD + frustum culling with the given
+// projection) and the streamer, one Update per sample, and returns the final stats.
+// afterUpdate, if given, is called with the sample index after each Update.
+TileStreamer::Stats ReplayCameraPath(TileStreamer& streamer, QuadTree& quadTree,
+                                     const std::vector<CameraPathSample>& path,
+                                     float fovY, float aspect, float nearZ, float farZ,
+                                     const std::function<void(size_t sample)>& afterUpdate = nullptr);
@@ -53,9 +53,10 @@ public:
     std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
     std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
 
-    // We cannot update a dynamic vertex buffer until the GPU is done processing
-    // the commands that reference it.  So each frame needs their own.
-    std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
+    // We cannot update the wave heights until the GPU is done processing the
+    // commands that reference them.  So each frame needs their own.  WavesVS
+    // reads them as a raw buffer and rebuilds the rest of the vertex.
+    std::unique_ptr<UploadBuffer<float>> WavesHeights = nullptr;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
@@ -9,7 +9,7 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "FrameResource.h"
-#include "Waves.h"
+#include "../../Common/Waves.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -51,9 +51,18 @@ struct RenderItem
 enum class RenderLayer : int
 {
 	Opaque = 0,
+	Waves,
 	Count
 };
 
+// Root constants of WavesVS, cbWaves in color.hlsl.
+struct WaveStreamConstants
+{
+	UINT RowCount = 0;
+	UINT ColumnCount = 0;
+	float SpatialStep = 0.0f;
+};
+
 class LandAndWavesApp : public D3DApp
 {
 public:
@@ -107,8 +116,6 @@ private:
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
-	RenderItem* mWavesRitem = nullptr;
-
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
@@ -273,6 +280,17 @@ void LandAndWavesApp::Draw(const GameTimer& gt)
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	// The waves are streamed as heights only; WavesVS rebuilds the vertices.
+	WaveStreamConstants waveConstants;
+	waveConstants.RowCount = mWaves->RowCount();
+	waveConstants.ColumnCount = mWaves->ColumnCount();
+	waveConstants.SpatialStep = mWaves->SpatialStep();
+
+	mCommandList->SetPipelineState(mPSOs[mIsWireframe ? "wavesStream_wireframe" : "wavesStream"].Get());
+	mCommandList->SetGraphicsRoot32BitConstants(2, 3, &waveConstants, 0);
+	mCommandList->SetGraphicsRootShaderResourceView(3, mCurrFrameResource->WavesHeights->Resource()->GetGPUVirtualAddress());
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Waves]);
+
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
@@ -435,33 +453,25 @@ void LandAndWavesApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	mWaves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
-	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for(int i = 0; i < mWaves->VertexCount(); ++i)
-	{
-		Vertex v;
-
-		v.Pos = mWaves->Position(i);
-        v.Color = XMFLOAT4(DirectX::Colors::Blue);
-
-		currWavesVB->CopyData(i, v);
-	}
-
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	// Only the heights change, so copy just those for this frame.
+	mWaves->CopyHeights(reinterpret_cast<float*>(mCurrFrameResource->WavesHeights->MappedData()));
 }
 
 void LandAndWavesApp::BuildRootSignature()
 {
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[2];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
 
     // Create root CBV.
     slotRootParameter[0].InitAsConstantBufferView(0);
     slotRootParameter[1].InitAsConstantBufferView(1);
 
+    // Wave grid size and the heights buffer for WavesVS.
+    slotRootParameter[2].InitAsConstants(3, 2);
+    slotRootParameter[3].InitAsShaderResourceView(0);
+
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(2, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     // create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
     ComPtr<ID3DBlob> serializedRootSig = nullptr;
@@ -486,6 +496,7 @@ void LandAndWavesApp::BuildShadersAndInputLayout()
 {
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\color.hlsl", nullptr, "VS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\color.hlsl", nullptr, "PS", "ps_5_0");
+	mShaders["wavesStreamVS"] = d3dUtil::CompileShader(L"Shaders\\color.hlsl", nullptr, "WavesVS", "vs_5_0");
 
     mInputLayout =
     {
@@ -606,7 +617,7 @@ void LandAndWavesApp::BuildWavesGeometryBuffers()
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "waterGeo";
 
-	// Set dynamically.
+	// No vertex buffer; WavesVS builds the vertices from the streamed heights.
 	geo->VertexBufferCPU = nullptr;
 	geo->VertexBufferGPU = nullptr;
 
@@ -670,6 +681,23 @@ void LandAndWavesApp::BuildPSOs()
     D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueWireframePsoDesc = opaquePsoDesc;
     opaqueWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
     ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaqueWireframePsoDesc, IID_PPV_ARGS(&mPSOs["opaque_wireframe"])));
+
+	//
+	// PSOs for the wave grid streamed as heights; WavesVS builds the vertices.
+	//
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesStreamPsoDesc = opaquePsoDesc;
+	wavesStreamPsoDesc.InputLayout = { nullptr, 0 };
+	wavesStreamPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["wavesStreamVS"]->GetBufferPointer()),
+		mShaders["wavesStreamVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesStreamPsoDesc, IID_PPV_ARGS(&mPSOs["wavesStream"])));
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesStreamWireframePsoDesc = wavesStreamPsoDesc;
+	wavesStreamWireframePsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesStreamWireframePsoDesc, IID_PPV_ARGS(&mPSOs["wavesStream_wireframe"])));
 }
 
 void LandAndWavesApp::BuildFrameResources()
@@ -692,9 +720,7 @@ void LandAndWavesApp::BuildRenderItems()
 	wavesRitem->StartIndexLocation = wavesRitem->Geo->DrawArgs["grid"].StartIndexLocation;
 	wavesRitem->BaseVertexLocation = wavesRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
 
-	mWavesRitem = wavesRitem.get();
-
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	mRitemLayer[(int)RenderLayer::Waves].push_back(wavesRitem.get());
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
@@ -722,7 +748,9 @@ void LandAndWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const
 	{
 		auto ri = ritems[i];
 
-		cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+		// The streamed waves have no vertex buffer.
+		if(ri->Geo->VertexBufferGPU != nullptr)
+			cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
 		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
@@ -27,6 +27,16 @@ cbuffer cbPass : register(b1)
     float gDeltaTime;
 };
 
+// Wave grid streamed as heights only, see WavesVS.
+cbuffer cbWaves : register(b2)
+{
+    uint gWaveRowCount;
+    uint gWaveColumnCount;
+    float gWaveSpatialStep;
+};
+
+ByteAddressBuffer gWaveHeights : register(t0);
+
 struct VertexIn
 {
 	float3 PosL  : POSITION;
@@ -53,6 +63,28 @@ VertexOut VS(VertexIn vin)
     return vout;
 }
 
+// Rebuilds a wave grid vertex from its index, laid out like Waves lays out its grid.
+VertexOut WavesVS(uint vertexID : SV_VertexID)
+{
+	VertexOut vout;
+
+    uint row = vertexID / gWaveColumnCount;
+    uint col = vertexID - row*gWaveColumnCount;
+
+    float halfWidth = (gWaveColumnCount - 1)*gWaveSpatialStep*0.5f;
+    float halfDepth = (gWaveRowCount - 1)*gWaveSpatialStep*0.5f;
+    float height = asfloat(gWaveHeights.Load(vertexID << 2));
+    float3 posL = float3(-halfWidth + col*gWaveSpatialStep, height, halfDepth - row*gWaveSpatialStep);
+
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
+    vout.PosH = mul(posW, gViewProj);
+
+    // The water is plain blue.
+    vout.Color = float4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    return vout;
+}
+
 float4 PS(VertexOut pin) : SV_Target
 {
     return pin.Color;
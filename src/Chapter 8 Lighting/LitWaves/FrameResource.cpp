@@ -12,6 +12,8 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
 
     WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
+    WavesHeights = std::make_unique<UploadBuffer<float>>(device, waveVertCount, false);
+    WavesNormals = std::make_unique<UploadBuffer<std::uint32_t>>(device, waveVertCount, false);
 }
 
 FrameResource::~FrameResource()
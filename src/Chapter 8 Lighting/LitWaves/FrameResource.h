@@ -67,6 +67,11 @@ public:
     // the commands that reference it.  So each frame needs their own.
     std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
 
+    // Wave heights (32 or 16 bits each) and packed normals when only those are
+    // streamed; the vertex shader reads them as raw buffers.
+    std::unique_ptr<UploadBuffer<float>> WavesHeights = nullptr;
+    std::unique_ptr<UploadBuffer<std::uint32_t>> WavesNormals = nullptr;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
@@ -2,6 +2,8 @@
 // LitWavesApp.cpp by Frank Luna (C) 2015 All Rights Reserved.
 //
 // Use arrow keys to move light positions.
+// Press H to cycle how the waves are sent to the GPU.
+// Press O to switch between the rippling pond and an FFT ocean.
 //
 //***************************************************************************************
 
@@ -10,7 +12,8 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "FrameResource.h"
-#include "Waves.h"
+#include "../../Common/Waves.h"
+#include "../../Common/Ocean.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -58,9 +61,55 @@ struct RenderItem
 enum class RenderLayer : int
 {
 	Opaque = 0,
+	Waves,
 	Count
 };
 
+// What UpdateWaves uploads each frame.  Vertices is a full vertex per grid point;
+// the other modes send heights only and WavesVS rebuilds the vertex, taking the
+// normals from the packed normals or from the neighbouring heights.
+enum class WaveStreamMode : int
+{
+	Vertices = 0,
+	Heights,
+	HalfHeights,
+	HeightsAndNormals,
+	HalfHeightsAndNormals,
+	Count
+};
+
+// Root constants of WavesVS, cbWaves in Default.hlsl.
+struct WaveStreamConstants
+{
+	UINT RowCount = 0;
+	UINT ColumnCount = 0;
+	float SpatialStep = 0.0f;
+	UINT Flags = 0;
+};
+
+// Matches WAVE_HALF_HEIGHTS and WAVE_PACKED_NORMALS.
+static UINT WaveStreamFlags(WaveStreamMode mode)
+{
+	UINT flags = 0;
+	if(mode == WaveStreamMode::HalfHeights || mode == WaveStreamMode::HalfHeightsAndNormals)
+		flags |= 1;
+	if(mode == WaveStreamMode::HeightsAndNormals || mode == WaveStreamMode::HalfHeightsAndNormals)
+		flags |= 2;
+	return flags;
+}
+
+static UINT WaveStreamBytes(WaveStreamMode mode, int vertexCount)
+{
+	if(mode == WaveStreamMode::Vertices)
+		return vertexCount*sizeof(Vertex);
+
+	UINT flags = WaveStreamFlags(mode);
+	UINT bytesPerVertex = (flags & 1) ? sizeof(HALF) : sizeof(float);
+	if(flags & 2)
+		bytesPerVertex += sizeof(std::uint32_t);
+	return vertexCount*bytesPerVertex;
+}
+
 class LitWavesApp : public D3DApp
 {
 public:
@@ -86,6 +135,7 @@ private:
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void UpdateOcean(const GameTimer& gt);
 
     void BuildRootSignature();
     void BuildShadersAndInputLayout();
@@ -127,6 +177,11 @@ private:
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
 	std::unique_ptr<Waves> mWaves;
+	WaveStreamMode mWaveStreamMode = WaveStreamMode::Heights;
+
+	// Replaces the pond on the same grid when enabled.
+	std::unique_ptr<Ocean> mOcean;
+	bool mOceanMode = false;
 
     PassConstants mMainPassCB;
 
@@ -192,6 +247,16 @@ bool LitWavesApp::Initialize()
 
 	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
 
+	// A light breeze, so the longest waves fit on the grid.  The first patch has one
+	// FFT point per grid vertex.
+	Ocean::Desc oceanDesc;
+	oceanDesc.GridSize = 128;
+	oceanDesc.CascadeCount = 2;
+	oceanDesc.PatchSizes[0] = 128.0f;
+	oceanDesc.PatchSizes[1] = 32.0f;
+	oceanDesc.Wind = XMFLOAT2(6.0f, 2.0f);
+	mOcean = std::make_unique<Ocean>(oceanDesc);
+
     BuildRootSignature();
     BuildShadersAndInputLayout();
 	BuildLandGeometry();
@@ -244,7 +309,10 @@ void LitWavesApp::Update(const GameTimer& gt)
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
-	UpdateWaves(gt);
+	if(mOceanMode)
+		UpdateOcean(gt);
+	else
+		UpdateWaves(gt);
 }
 
 void LitWavesApp::Draw(const GameTimer& gt)
@@ -280,6 +348,21 @@ void LitWavesApp::Draw(const GameTimer& gt)
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	if(!mOceanMode && mWaveStreamMode != WaveStreamMode::Vertices)
+	{
+		WaveStreamConstants waveConstants;
+		waveConstants.RowCount = mWaves->RowCount();
+		waveConstants.ColumnCount = mWaves->ColumnCount();
+		waveConstants.SpatialStep = mWaves->SpatialStep();
+		waveConstants.Flags = WaveStreamFlags(mWaveStreamMode);
+
+		mCommandList->SetPipelineState(mPSOs["wavesStream"].Get());
+		mCommandList->SetGraphicsRoot32BitConstants(3, 4, &waveConstants, 0);
+		mCommandList->SetGraphicsRootShaderResourceView(4, mCurrFrameResource->WavesHeights->Resource()->GetGPUVirtualAddress());
+		mCommandList->SetGraphicsRootShaderResourceView(5, mCurrFrameResource->WavesNormals->Resource()->GetGPUVirtualAddress());
+	}
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Waves]);
+
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
@@ -366,6 +449,36 @@ void LitWavesApp::OnKeyboardInput(const GameTimer& gt)
 		mSunPhi += 1.0f*dt;
 
 	mSunPhi = MathHelper::Clamp(mSunPhi, 0.1f, XM_PIDIV2);
+
+	static bool bHPressed = false;
+	if(GetAsyncKeyState('H') & 0x8000)
+	{
+		if(!bHPressed)
+		{
+			const char* modeNames[] = { "vertices", "heights", "half heights",
+				"heights and normals", "half heights and normals" };
+
+			mWaveStreamMode = (WaveStreamMode)(((int)mWaveStreamMode + 1) % (int)WaveStreamMode::Count);
+
+			std::ostringstream msg;
+			msg << "Waves: streaming " << modeNames[(int)mWaveStreamMode] << ", "
+				<< WaveStreamBytes(mWaveStreamMode, mWaves->VertexCount()) << " bytes per frame\n";
+			OutputDebugStringA(msg.str().c_str());
+		}
+		bHPressed = true;
+	}
+	else
+		bHPressed = false;
+
+	static bool bOPressed = false;
+	if(GetAsyncKeyState('O') & 0x8000)
+	{
+		if(!bOPressed)
+			mOceanMode = !mOceanMode;
+		bOPressed = true;
+	}
+	else
+		bOPressed = false;
 }
 
 void LitWavesApp::UpdateCamera(const GameTimer& gt)
@@ -485,34 +598,79 @@ void LitWavesApp::UpdateWaves(const GameTimer& gt)
 	// Update the wave simulation.
 	mWaves->Update(gt.DeltaTime());
 
-	// Update the wave vertex buffer with the new solution.
+	// Update the wave vertex buffer with the new solution, or only the parts of
+	// it that change.
+	auto currWavesVB = mCurrFrameResource->WavesVB.get();
+	UINT flags = WaveStreamFlags(mWaveStreamMode);
+	if(mWaveStreamMode == WaveStreamMode::Vertices)
+	{
+		for(int i = 0; i < mWaves->VertexCount(); ++i)
+		{
+			Vertex v;
+
+			v.Pos = mWaves->Position(i);
+			v.Normal = mWaves->Normal(i);
+
+			currWavesVB->CopyData(i, v);
+		}
+	}
+	else
+	{
+		BYTE* heights = mCurrFrameResource->WavesHeights->MappedData();
+		if(flags & 1)
+			mWaves->CopyHeightsHalf(reinterpret_cast<HALF*>(heights));
+		else
+			mWaves->CopyHeights(reinterpret_cast<float*>(heights));
+
+		if(flags & 2)
+			mWaves->CopyPackedNormals(reinterpret_cast<std::uint32_t*>(mCurrFrameResource->WavesNormals->MappedData()));
+	}
+
+	// Set the dynamic VB of the wave renderitem to the current frame VB.  It stays
+	// bound when streaming, where the input layout ignores it.
+	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+}
+
+void LitWavesApp::UpdateOcean(const GameTimer& gt)
+{
+	mOcean->Update(gt.TotalTime());
+
+	// The ocean moves the grid points sideways as well, so the full vertices are sent.
 	auto currWavesVB = mCurrFrameResource->WavesVB.get();
 	for(int i = 0; i < mWaves->VertexCount(); ++i)
 	{
+		XMFLOAT3 gridPos = mWaves->Position(i);
+		XMFLOAT3 displacement, normal;
+		mOcean->Sample(gridPos.x, gridPos.z, displacement, normal);
+
 		Vertex v;
 
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
+		v.Pos = XMFLOAT3(gridPos.x + displacement.x, displacement.y, gridPos.z + displacement.z);
+		v.Normal = normal;
 
 		currWavesVB->CopyData(i, v);
 	}
 
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
 	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 }
 
 void LitWavesApp::BuildRootSignature()
 {
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[3];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[6];
 
     // Create root CBV.
     slotRootParameter[0].InitAsConstantBufferView(0);
     slotRootParameter[1].InitAsConstantBufferView(1);
     slotRootParameter[2].InitAsConstantBufferView(2);
 
+    // Wave grid layout and the streamed heights and normals.
+    slotRootParameter[3].InitAsConstants(4, 3);
+    slotRootParameter[4].InitAsShaderResourceView(0);
+    slotRootParameter[5].InitAsShaderResourceView(1);
+
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(3, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
     // create a root signature with a single slot which points to a descriptor range consisting of a single constant buffer
     ComPtr<ID3DBlob> serializedRootSig = nullptr;
@@ -536,6 +694,7 @@ void LitWavesApp::BuildRootSignature()
 void LitWavesApp::BuildShadersAndInputLayout()
 {
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_0");
+	mShaders["wavesStreamVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "WavesVS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_0");
 
     mInputLayout =
@@ -687,6 +846,18 @@ void LitWavesApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+
+	//
+	// PSO for the wave grid streamed as heights; WavesVS builds the vertices.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesStreamPsoDesc = opaquePsoDesc;
+	wavesStreamPsoDesc.InputLayout = { nullptr, 0 };
+	wavesStreamPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["wavesStreamVS"]->GetBufferPointer()),
+		mShaders["wavesStreamVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesStreamPsoDesc, IID_PPV_ARGS(&mPSOs["wavesStream"])));
 }
 
 void LitWavesApp::BuildFrameResources()
@@ -734,7 +905,7 @@ void LitWavesApp::BuildRenderItems()
 
 	mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	mRitemLayer[(int)RenderLayer::Waves].push_back(wavesRitem.get());
 
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
@@ -60,6 +60,21 @@ cbuffer cbPass : register(b2)
     // are spot lights for a maximum of MaxLights per object.
     Light gLights[MaxLights];
 };
+
+// Wave grid streamed as heights only, see WavesVS.
+cbuffer cbWaves : register(b3)
+{
+    uint gWaveRowCount;
+    uint gWaveColumnCount;
+    float gWaveSpatialStep;
+    uint gWaveFlags;
+};
+
+#define WAVE_HALF_HEIGHTS 1
+#define WAVE_PACKED_NORMALS 2
+
+ByteAddressBuffer gWaveHeights : register(t0);
+ByteAddressBuffer gWaveNormals : register(t1);
  
 struct VertexIn
 {
@@ -91,6 +106,56 @@ VertexOut VS(VertexIn vin)
     return vout;
 }
 
+float WaveHeight(uint i)
+{
+    if(gWaveFlags & WAVE_HALF_HEIGHTS)
+    {
+        // Two heights per 32-bit word, the even one in the low half.
+        uint pair = gWaveHeights.Load((i >> 1) << 2);
+        return f16tof32((i & 1) ? (pair >> 16) : pair);
+    }
+
+    return asfloat(gWaveHeights.Load(i << 2));
+}
+
+// Rebuilds a wave grid vertex from its index, laid out like Waves lays out its grid.
+VertexOut WavesVS(uint vertexID : SV_VertexID)
+{
+	VertexOut vout = (VertexOut)0.0f;
+
+    uint row = vertexID / gWaveColumnCount;
+    uint col = vertexID - row*gWaveColumnCount;
+
+    float halfWidth = (gWaveColumnCount - 1)*gWaveSpatialStep*0.5f;
+    float halfDepth = (gWaveRowCount - 1)*gWaveSpatialStep*0.5f;
+    float3 posL = float3(-halfWidth + col*gWaveSpatialStep, WaveHeight(vertexID), halfDepth - row*gWaveSpatialStep);
+
+    // The boundary does not move, so its normal stays straight up.
+    float3 normalL = float3(0.0f, 1.0f, 0.0f);
+    if(gWaveFlags & WAVE_PACKED_NORMALS)
+    {
+        int packed = asint(gWaveNormals.Load(vertexID << 2));
+        float2 xz = max(float2((packed << 16) >> 16, packed >> 16) / 32767.0f, -1.0f);
+        normalL = float3(xz.x, sqrt(saturate(1.0f - dot(xz, xz))), xz.y);
+    }
+    else if(row > 0 && row < gWaveRowCount - 1 && col > 0 && col < gWaveColumnCount - 1)
+    {
+        // Same finite differences as Waves.
+        float l = WaveHeight(vertexID - 1);
+        float r = WaveHeight(vertexID + 1);
+        float t = WaveHeight(vertexID - gWaveColumnCount);
+        float b = WaveHeight(vertexID + gWaveColumnCount);
+        normalL = normalize(float3(l - r, 2.0f*gWaveSpatialStep, b - t));
+    }
+
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
+    vout.PosW = posW.xyz;
+    vout.NormalW = mul(normalL, (float3x3)gWorld);
+    vout.PosH = mul(posW, gViewProj);
+
+    return vout;
+}
+
 float4 PS(VertexOut pin) : SV_Target
 {
     // Interpolating normal can unnormalize it, so renormalize it.
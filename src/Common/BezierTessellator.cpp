@@ -0,0 +1,718 @@
+//***************************************************************************************
+// BezierTessellator.cpp
+//***************************************************************************************
+
+#include "BezierTessellator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+using namespace DirectX;
+
+namespace
+{
+	// 16.16 fixed point, as in the D3D11 reference tessellator.
+	typedef uint32_t Fxp;
+
+	const Fxp FxpOne = 1u << 16;
+	const Fxp FxpOneHalf = 1u << 15;
+
+	const float MaxFactor = 64.0f;
+	const float MaxOddFactor = 63.0f;
+
+	// The smallest step above 1 the fixed point format holds.  An odd inside factor
+	// of 1 turns into this when any other factor is above 1, so that the inside gets
+	// a ring of points to stitch the edges to.
+	const float OddInsideMinimum = 1.0f + 1.0f/65536.0f;
+
+	const uint32_t PatchesPerTask = 32;
+
+	// round(65536 / i) for the segment counts a half factor can have.
+	Fxp FxpReciprocal(uint32_t i)
+	{
+		return (FxpOne + i/2) / i;
+	}
+
+	Fxp FloatToFxp(float f)
+	{
+		return (Fxp)std::lrint((double)f*FxpOne);
+	}
+
+	float FxpToFloat(Fxp f)
+	{
+		return f * (1.0f/FxpOne);
+	}
+
+	Fxp FxpCeil(Fxp f)
+	{
+		return (f + FxpOne - 1) & ~(FxpOne - 1);
+	}
+
+	uint32_t RemoveMsb(uint32_t value)
+	{
+		uint32_t msb = 1u << 31;
+		while(msb != 0 && (value & msb) == 0)
+			msb >>= 1;
+		return value & ~msb;
+	}
+
+	// The points along one edge or axis of the domain for one factor, laid out as
+	// ComputeTessFactorContext and PlacePointIn1D do in the reference tessellator:
+	// each half of the range takes points from the floor and ceiling of half the
+	// factor and blends them by its fraction, so the points move smoothly as the
+	// factor changes and both halves are mirror images in exact arithmetic.
+	class FactorPoints
+	{
+	public:
+		FactorPoints(Fxp factor, bool odd) : mOdd(odd)
+		{
+			Fxp half = (factor + 1)/2;
+			if(odd || half == FxpOneHalf)
+				half += FxpOneHalf;
+
+			Fxp floor = half & ~(FxpOne - 1);
+			Fxp ceil = FxpCeil(half);
+
+			mFraction = half - floor;
+			mHalfPointCount = ceil >> 16;
+
+			if(ceil == floor)
+				mSplitPoint = mHalfPointCount + 1;
+			else if(odd)
+				mSplitPoint = floor == FxpOne ? 0 : (RemoveMsb((floor >> 16) - 1) << 1) + 1;
+			else
+				mSplitPoint = (RemoveMsb(floor >> 16) << 1) + 1;
+
+			uint32_t floorSegments = (floor*2) >> 16;
+			uint32_t ceilSegments = (ceil*2) >> 16;
+			if(odd)
+			{
+				floorSegments -= 1;
+				ceilSegments -= 1;
+			}
+
+			mInvFloorSegments = FxpReciprocal(floorSegments);
+			mInvCeilSegments = FxpReciprocal(ceilSegments);
+
+			if(odd)
+				mPointCount = (FxpCeil(FxpOneHalf + (factor + 1)/2)*2) >> 16;
+			else
+				mPointCount = ((FxpCeil((factor + 1)/2)*2) >> 16) + 1;
+		}
+
+		uint32_t PointCount()const { return mPointCount; }
+
+		float Place(uint32_t point)const
+		{
+			bool flip = point >= mHalfPointCount;
+			if(flip)
+			{
+				point = (mHalfPointCount << 1) - point;
+				if(mOdd)
+					point -= 1;
+			}
+
+			// 16 bit fixed point can't make 0.5 below, so the middle is set here.
+			if(point == mHalfPointCount)
+				return 0.5f;
+
+			uint32_t indexOnCeil = point;
+			uint32_t indexOnFloor = point > mSplitPoint ? point - 1 : point;
+
+			Fxp onFloor = indexOnFloor*mInvFloorSegments;
+			Fxp onCeil = indexOnCeil*mInvCeilSegments;
+
+			Fxp location = (onFloor*(FxpOne - mFraction) + onCeil*mFraction + FxpOneHalf) >> 16;
+			if(flip)
+				location = FxpOne - location;
+
+			return FxpToFloat(location);
+		}
+
+		std::vector<float> Points(uint32_t minCount)const
+		{
+			std::vector<float> points((std::max)(mPointCount, minCount));
+			for(uint32_t i = 0; i < (uint32_t)points.size(); ++i)
+				points[i] = Place(i);
+			return points;
+		}
+
+	private:
+		bool mOdd;
+		Fxp mFraction;
+		uint32_t mHalfPointCount;
+		uint32_t mSplitPoint;
+		Fxp mInvFloorSegments;
+		Fxp mInvCeilSegments;
+		uint32_t mPointCount;
+	};
+
+	// Shares domain points between the triangles that use them and gives every
+	// triangle the clockwise order.
+	class TopologyBuilder
+	{
+	public:
+		explicit TopologyBuilder(BezierTessellator::Topology& topology) : mTopology(topology)
+		{
+		}
+
+		uint32_t Point(float u, float v)
+		{
+			auto it = mIndices.find(std::make_pair(u, v));
+			if(it != mIndices.end())
+				return it->second;
+
+			uint32_t index = (uint32_t)mTopology.Domain.size();
+			mTopology.Domain.push_back(XMFLOAT2(u, v));
+			mIndices[std::make_pair(u, v)] = index;
+			return index;
+		}
+
+		void Triangle(uint32_t a, uint32_t b, uint32_t c)
+		{
+			const XMFLOAT2& pa = mTopology.Domain[a];
+			const XMFLOAT2& pb = mTopology.Domain[b];
+			const XMFLOAT2& pc = mTopology.Domain[c];
+
+			// With v down, clockwise is a positive cross product.  Points that fell
+			// together at small fractional factors give empty triangles; drop them.
+			float area = (pb.x - pa.x)*(pc.y - pa.y) - (pb.y - pa.y)*(pc.x - pa.x);
+			if(area == 0.0f)
+				return;
+
+			if(area < 0.0f)
+				std::swap(b, c);
+
+			mTopology.Indices.push_back(a);
+			mTopology.Indices.push_back(b);
+			mTopology.Indices.push_back(c);
+		}
+
+		// Fills the strip between a row of outer points and a row of inner points,
+		// both ordered by their parameter along the side.
+		void Zip(const std::vector<uint32_t>& outer, const std::vector<float>& outerT,
+			const std::vector<uint32_t>& inner, const std::vector<float>& innerT)
+		{
+			size_t i = 0;
+			size_t j = 0;
+			while(i + 1 < outer.size() || j + 1 < inner.size())
+			{
+				bool advanceOuter = j + 1 == inner.size() ||
+					(i + 1 < outer.size() && outerT[i + 1] <= innerT[j + 1]);
+
+				if(advanceOuter)
+				{
+					Triangle(outer[i], outer[i + 1], inner[j]);
+					++i;
+				}
+				else
+				{
+					Triangle(outer[i], inner[j + 1], inner[j]);
+					++j;
+				}
+			}
+		}
+
+	private:
+		BezierTessellator::Topology& mTopology;
+		std::map<std::pair<float, float>, uint32_t> mIndices;
+	};
+
+	// Ties between a curve and its reverse go to the lexicographically smaller
+	// sequence of control points, so both patches along an edge start from the same
+	// end.
+	bool Reversed(const XMFLOAT3* p[4])
+	{
+		for(int i = 0; i < 4; ++i)
+		{
+			const XMFLOAT3& a = *p[i];
+			const XMFLOAT3& b = *p[3 - i];
+			if(a.x != b.x) return b.x < a.x;
+			if(a.y != b.y) return b.y < a.y;
+			if(a.z != b.z) return b.z < a.z;
+		}
+		return false;
+	}
+
+	XMFLOAT3 EvaluateCurve(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, const XMFLOAT3& p3, float t)
+	{
+		const XMFLOAT3* p[4] = { &p0, &p1, &p2, &p3 };
+		if(Reversed(p))
+		{
+			std::swap(p[0], p[3]);
+			std::swap(p[1], p[2]);
+			t = 1.0f - t;
+		}
+
+		float s = 1.0f - t;
+		float b[4] = { s*s*s, 3.0f*t*s*s, 3.0f*t*t*s, t*t*t };
+
+		XMFLOAT3 result(0.0f, 0.0f, 0.0f);
+		for(int i = 0; i < 4; ++i)
+		{
+			result.x += b[i]*p[i]->x;
+			result.y += b[i]*p[i]->y;
+			result.z += b[i]*p[i]->z;
+		}
+		return result;
+	}
+
+	// Bernstein basis and its derivative for four parameters at once.
+	void Bernstein(FXMVECTOR t, XMVECTOR b[4], XMVECTOR d[4])
+	{
+		const XMVECTOR three = XMVectorReplicate(3.0f);
+		const XMVECTOR six = XMVectorReplicate(6.0f);
+
+		XMVECTOR s = XMVectorSubtract(XMVectorSplatOne(), t);
+		XMVECTOR tt = XMVectorMultiply(t, t);
+		XMVECTOR ss = XMVectorMultiply(s, s);
+		XMVECTOR ts = XMVectorMultiply(t, s);
+
+		b[0] = XMVectorMultiply(ss, s);
+		b[1] = XMVectorMultiply(three, XMVectorMultiply(ts, s));
+		b[2] = XMVectorMultiply(three, XMVectorMultiply(ts, t));
+		b[3] = XMVectorMultiply(tt, t);
+
+		d[0] = XMVectorNegate(XMVectorMultiply(three, ss));
+		d[1] = XMVectorSubtract(XMVectorMultiply(three, ss), XMVectorMultiply(six, ts));
+		d[2] = XMVectorSubtract(XMVectorMultiply(six, ts), XMVectorMultiply(three, tt));
+		d[3] = XMVectorMultiply(three, tt);
+	}
+
+	// Largest second difference of four projected points.  Both terms read the same
+	// from either end, so the two patches along an edge get the same value.
+	float SecondDifference(const XMFLOAT2& p0, const XMFLOAT2& p1, const XMFLOAT2& p2, const XMFLOAT2& p3)
+	{
+		float ax = (p0.x + p2.x) - 2.0f*p1.x;
+		float ay = (p0.y + p2.y) - 2.0f*p1.y;
+		float bx = (p1.x + p3.x) - 2.0f*p2.x;
+		float by = (p1.y + p3.y) - 2.0f*p2.y;
+		return (std::max)(std::sqrt(ax*ax + ay*ay), std::sqrt(bx*bx + by*by));
+	}
+}
+
+BezierTessellator::BezierTessellator(const Desc& desc, ThreadPool* pool) :
+	mDesc(desc), mPool(pool != nullptr ? pool : &ThreadPool::Default())
+{
+}
+
+XMFLOAT3 BezierTessellator::Evaluate(const Patch& patch, float u, float v)
+{
+	auto lerp = [](const XMFLOAT3& a, const XMFLOAT3& b, float t)
+	{
+		return XMFLOAT3(a.x + (b.x - a.x)*t, a.y + (b.y - a.y)*t, a.z + (b.z - a.z)*t);
+	};
+
+	auto casteljau = [&](XMFLOAT3 p[4], float t)
+	{
+		for(int level = 3; level > 0; --level)
+		{
+			for(int i = 0; i < level; ++i)
+				p[i] = lerp(p[i], p[i + 1], t);
+		}
+		return p[0];
+	};
+
+	XMFLOAT3 column[4];
+	for(int row = 0; row < 4; ++row)
+	{
+		XMFLOAT3 p[4] = { patch.P[4*row], patch.P[4*row + 1], patch.P[4*row + 2], patch.P[4*row + 3] };
+		column[row] = casteljau(p, u);
+	}
+
+	return casteljau(column, v);
+}
+
+void BezierTessellator::EvaluateVertices(const Patch& patch, const XMFLOAT2* domain, size_t count, Vertex* vertices)
+{
+	// Every control point coordinate splatted across a vector, for structure of
+	// arrays evaluation of four points at a time.
+	XMVECTOR px[16], py[16], pz[16];
+	for(int i = 0; i < 16; ++i)
+	{
+		px[i] = XMVectorReplicate(patch.P[i].x);
+		py[i] = XMVectorReplicate(patch.P[i].y);
+		pz[i] = XMVectorReplicate(patch.P[i].z);
+	}
+
+	const XMVECTOR epsilon = XMVectorReplicate(1.0e-12f);
+
+	for(size_t first = 0; first < count; first += 4)
+	{
+		// Pad the last group with the last point.
+		XMFLOAT4 u, v;
+		float* us = &u.x;
+		float* vs = &v.x;
+		for(size_t k = 0; k < 4; ++k)
+		{
+			const XMFLOAT2& d = domain[(std::min)(first + k, count - 1)];
+			us[k] = d.x;
+			vs[k] = d.y;
+		}
+
+		XMVECTOR bu[4], du[4], bv[4], dv[4];
+		Bernstein(XMLoadFloat4(&u), bu, du);
+		Bernstein(XMLoadFloat4(&v), bv, dv);
+
+		XMVECTOR pos[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+		XMVECTOR tu[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+		XMVECTOR tv[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+
+		for(int row = 0; row < 4; ++row)
+		{
+			// The row collapsed along u, and its u derivative.
+			XMVECTOR r[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+			XMVECTOR dr[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+			for(int col = 0; col < 4; ++col)
+			{
+				int i = 4*row + col;
+				r[0] = XMVectorMultiplyAdd(bu[col], px[i], r[0]);
+				r[1] = XMVectorMultiplyAdd(bu[col], py[i], r[1]);
+				r[2] = XMVectorMultiplyAdd(bu[col], pz[i], r[2]);
+				dr[0] = XMVectorMultiplyAdd(du[col], px[i], dr[0]);
+				dr[1] = XMVectorMultiplyAdd(du[col], py[i], dr[1]);
+				dr[2] = XMVectorMultiplyAdd(du[col], pz[i], dr[2]);
+			}
+
+			for(int c = 0; c < 3; ++c)
+			{
+				pos[c] = XMVectorMultiplyAdd(bv[row], r[c], pos[c]);
+				tu[c] = XMVectorMultiplyAdd(bv[row], dr[c], tu[c]);
+				tv[c] = XMVectorMultiplyAdd(dv[row], r[c], tv[c]);
+			}
+		}
+
+		// du x dv, normalized, or zero where the patch is degenerate.
+		XMVECTOR n[3];
+		n[0] = XMVectorSubtract(XMVectorMultiply(tu[1], tv[2]), XMVectorMultiply(tu[2], tv[1]));
+		n[1] = XMVectorSubtract(XMVectorMultiply(tu[2], tv[0]), XMVectorMultiply(tu[0], tv[2]));
+		n[2] = XMVectorSubtract(XMVectorMultiply(tu[0], tv[1]), XMVectorMultiply(tu[1], tv[0]));
+
+		XMVECTOR lengthSq = XMVectorMultiplyAdd(n[0], n[0], XMVectorMultiplyAdd(n[1], n[1], XMVectorMultiply(n[2], n[2])));
+		XMVECTOR valid = XMVectorGreater(lengthSq, epsilon);
+		XMVECTOR invLength = XMVectorSelect(XMVectorZero(),
+			XMVectorReciprocal(XMVectorSqrt(XMVectorSelect(XMVectorSplatOne(), lengthSq, valid))), valid);
+
+		XMFLOAT4 out[6];
+		for(int c = 0; c < 3; ++c)
+		{
+			XMStoreFloat4(&out[c], pos[c]);
+			XMStoreFloat4(&out[3 + c], XMVectorMultiply(n[c], invLength));
+		}
+
+		for(size_t k = 0; k < 4 && first + k < count; ++k)
+		{
+			Vertex& vertex = vertices[first + k];
+			vertex.Pos = XMFLOAT3((&out[0].x)[k], (&out[1].x)[k], (&out[2].x)[k]);
+			vertex.Normal = XMFLOAT3((&out[3].x)[k], (&out[4].x)[k], (&out[5].x)[k]);
+			vertex.Domain = domain[first + k];
+		}
+	}
+
+	// Border points again from their edge curve alone, so that the patch on the
+	// other side of the edge computes the same bits.
+	const XMFLOAT3* P = patch.P;
+	for(size_t i = 0; i < count; ++i)
+	{
+		float u = domain[i].x;
+		float v = domain[i].y;
+
+		if(u == 0.0f)
+			vertices[i].Pos = EvaluateCurve(P[0], P[4], P[8], P[12], v);
+		else if(u == 1.0f)
+			vertices[i].Pos = EvaluateCurve(P[3], P[7], P[11], P[15], v);
+		else if(v == 0.0f)
+			vertices[i].Pos = EvaluateCurve(P[0], P[1], P[2], P[3], u);
+		else if(v == 1.0f)
+			vertices[i].Pos = EvaluateCurve(P[12], P[13], P[14], P[15], u);
+	}
+}
+
+BezierTessellator::Factors BezierTessellator::ComputeFactors(const Patch& patch, FXMMATRIX worldViewProj,
+	float width, float height)const
+{
+	// Control points in pixels.  Points behind the eye get a tiny w, which sends
+	// the factors to the maximum.
+	XMFLOAT2 s[16];
+	for(int i = 0; i < 16; ++i)
+	{
+		XMFLOAT4 h;
+		XMStoreFloat4(&h, XMVector3Transform(XMLoadFloat3(&patch.P[i]), worldViewProj));
+
+		float w = (std::max)(h.w, 1.0e-4f);
+		s[i] = XMFLOAT2(0.5f*width*h.x/w, -0.5f*height*h.y/w);
+	}
+
+	// n segments of a cubic are within (1/8)(6D)/n^2 of the curve.
+	float scale = 0.75f/mDesc.PixelTolerance;
+	auto factor = [&](float d) { return std::sqrt(scale*d); };
+
+	auto row = [&](int r) { return SecondDifference(s[4*r], s[4*r + 1], s[4*r + 2], s[4*r + 3]); };
+	auto column = [&](int c) { return SecondDifference(s[c], s[4 + c], s[8 + c], s[12 + c]); };
+
+	Factors factors;
+	factors.Edge[0] = factor(column(0));
+	factors.Edge[1] = factor(row(0));
+	factors.Edge[2] = factor(column(3));
+	factors.Edge[3] = factor(row(3));
+
+	float rows = (std::max)((std::max)(row(0), row(1)), (std::max)(row(2), row(3)));
+	float columns = (std::max)((std::max)(column(0), column(1)), (std::max)(column(2), column(3)));
+	factors.Inside[0] = factor(rows);
+	factors.Inside[1] = factor(columns);
+
+	return factors;
+}
+
+BezierTessellator::Factors BezierTessellator::ProcessFactors(const Factors& factors)const
+{
+	float lower = 1.0f;
+	float upper = MaxFactor;
+	if(mDesc.Partitioning == Partitioning::FractionalEven)
+		lower = 2.0f;
+	else if(mDesc.Partitioning == Partitioning::FractionalOdd)
+		upper = MaxOddFactor;
+
+	// NaN goes to the lower bound.
+	auto clamp = [&](float f, float low) { return !(f > low) ? low : (std::min)(f, upper); };
+
+	Factors processed;
+	bool aboveOne = false;
+	for(int i = 0; i < 4; ++i)
+	{
+		processed.Edge[i] = clamp(factors.Edge[i], lower);
+		aboveOne = aboveOne || processed.Edge[i] > 1.0f;
+	}
+
+	for(int i = 0; i < 2; ++i)
+		aboveOne = aboveOne || clamp(factors.Inside[i], lower) > 1.0f;
+
+	float insideLower = lower;
+	if(mDesc.Partitioning == Partitioning::FractionalOdd && aboveOne)
+		insideLower = OddInsideMinimum;
+
+	for(int i = 0; i < 2; ++i)
+		processed.Inside[i] = clamp(factors.Inside[i], insideLower);
+
+	if(mDesc.Partitioning == Partitioning::Integer)
+	{
+		for(float& f : processed.Edge)
+			f = std::ceil(f);
+		for(float& f : processed.Inside)
+			f = std::ceil(f);
+	}
+
+	return processed;
+}
+
+const BezierTessellator::Topology& BezierTessellator::GetTopology(const Factors& factors)
+{
+	// Round up so that a bucket never has fewer points than its factors ask for.
+	float step = mDesc.BucketStep;
+	Factors bucketed = factors;
+	if(step > 0.0f)
+	{
+		for(float& f : bucketed.Edge)
+			f = std::ceil(f/step)*step;
+		for(float& f : bucketed.Inside)
+			f = std::ceil(f/step)*step;
+	}
+
+	Factors processed = ProcessFactors(bucketed);
+
+	TopologyKey key;
+	for(int i = 0; i < 4; ++i)
+		key[i] = (int32_t)FloatToFxp(processed.Edge[i]);
+	for(int i = 0; i < 2; ++i)
+		key[4 + i] = (int32_t)FloatToFxp(processed.Inside[i]);
+
+	std::lock_guard<std::mutex> lock(mCacheMutex);
+
+	std::unique_ptr<Topology>& topology = mTopologies[key];
+	if(topology == nullptr)
+	{
+		topology.reset(new Topology());
+		BuildTopology(processed, *topology);
+	}
+
+	return *topology;
+}
+
+void BezierTessellator::BuildTopology(const Factors& processed, Topology& topology)const
+{
+	TopologyBuilder builder(topology);
+
+	Fxp edges[4];
+	for(int i = 0; i < 4; ++i)
+		edges[i] = FloatToFxp(processed.Edge[i]);
+
+	Fxp inside[2] = { FloatToFxp(processed.Inside[0]), FloatToFxp(processed.Inside[1]) };
+
+	bool integer = mDesc.Partitioning == Partitioning::Integer;
+	bool odd = mDesc.Partitioning == Partitioning::FractionalOdd;
+
+	// All factors at 1 is a single quad.
+	if(integer || odd)
+	{
+		bool minimum = inside[0] == FxpOne && inside[1] == FxpOne;
+		for(Fxp e : edges)
+			minimum = minimum && e == FxpOne;
+
+		if(minimum)
+		{
+			uint32_t a = builder.Point(0.0f, 0.0f);
+			uint32_t b = builder.Point(1.0f, 0.0f);
+			uint32_t c = builder.Point(1.0f, 1.0f);
+			uint32_t d = builder.Point(0.0f, 1.0f);
+			builder.Triangle(a, b, c);
+			builder.Triangle(a, c, d);
+			return;
+		}
+	}
+
+	// Integer partitioning takes the parity of each factor; an inside factor of 1
+	// counts as even.
+	auto edgeOdd = [&](Fxp f) { return integer ? ((f >> 16) & 1) != 0 : odd; };
+	auto insideOdd = [&](Fxp f) { return integer ? ((f >> 16) & 1) != 0 && f != FxpOne : odd; };
+
+	std::vector<float> edgeT[4];
+	for(int i = 0; i < 4; ++i)
+		edgeT[i] = FactorPoints(edges[i], edgeOdd(edges[i])).Points(2);
+
+	// The inside needs a ring of points inside the border on every side: two on an
+	// odd axis, the middle on an even one.
+	bool oddU = insideOdd(inside[0]);
+	bool oddV = insideOdd(inside[1]);
+	std::vector<float> a = FactorPoints(inside[0], oddU).Points(oddU ? 4 : 3);
+	std::vector<float> b = FactorPoints(inside[1], oddV).Points(oddV ? 4 : 3);
+
+	size_t na = a.size();
+	size_t nb = b.size();
+
+	// An odd inside factor a step above 1 puts the ring on the border, where its
+	// points would make T-junctions with the neighboring patch.  Move it one fixed
+	// point step in.
+	for(std::vector<float>* axis : { &a, &b })
+	{
+		std::vector<float>& t = *axis;
+		if(t[1] == 0.0f)
+		{
+			t[1] = FxpToFloat(1);
+			t[t.size() - 2] = FxpToFloat(FxpOne - 1);
+		}
+	}
+
+	// The inner grid.
+	std::vector<uint32_t> grid(na*nb);
+	for(size_t j = 1; j + 1 < nb; ++j)
+	{
+		for(size_t i = 1; i + 1 < na; ++i)
+			grid[j*na + i] = builder.Point(a[i], b[j]);
+	}
+
+	for(size_t j = 1; j + 2 < nb; ++j)
+	{
+		for(size_t i = 1; i + 2 < na; ++i)
+		{
+			uint32_t p00 = grid[j*na + i];
+			uint32_t p10 = grid[j*na + i + 1];
+			uint32_t p01 = grid[(j + 1)*na + i];
+			uint32_t p11 = grid[(j + 1)*na + i + 1];
+			builder.Triangle(p00, p10, p11);
+			builder.Triangle(p00, p11, p01);
+		}
+	}
+
+	// Each edge against the side of the grid next to it.
+	std::vector<uint32_t> outer, inner;
+	std::vector<float> innerT;
+
+	for(int e = 0; e < 4; ++e)
+	{
+		// Edge 0 and 2 run along v at u == 0 and 1; edge 1 and 3 along u at v == 0
+		// and 1.
+		bool alongV = e == 0 || e == 2;
+		float fixed = e < 2 ? 0.0f : 1.0f;
+
+		const std::vector<float>& t = edgeT[e];
+		outer.clear();
+		for(float te : t)
+			outer.push_back(alongV ? builder.Point(fixed, te) : builder.Point(te, fixed));
+
+		inner.clear();
+		innerT.clear();
+		if(alongV)
+		{
+			size_t i = e == 0 ? 1 : na - 2;
+			for(size_t j = 1; j + 1 < nb; ++j)
+			{
+				inner.push_back(grid[j*na + i]);
+				innerT.push_back(b[j]);
+			}
+		}
+		else
+		{
+			size_t j = e == 1 ? 1 : nb - 2;
+			for(size_t i = 1; i + 1 < na; ++i)
+			{
+				inner.push_back(grid[j*na + i]);
+				innerT.push_back(a[i]);
+			}
+		}
+
+		builder.Zip(outer, t, inner, innerT);
+	}
+}
+
+void BezierTessellator::Tessellate(const Patch* patches, uint32_t count, FXMMATRIX worldViewProj,
+	float width, float height, Mesh& mesh)
+{
+	XMMATRIX transform = worldViewProj;
+	std::vector<const Topology*> topologies(count);
+
+	uint32_t taskCount = (count + PatchesPerTask - 1) / PatchesPerTask;
+	mPool->ParallelFor(taskCount, [&](uint32_t task)
+	{
+		uint32_t first = task*PatchesPerTask;
+		uint32_t last = (std::min)(count, first + PatchesPerTask);
+		for(uint32_t i = first; i < last; ++i)
+			topologies[i] = &GetTopology(ComputeFactors(patches[i], transform, width, height));
+	});
+
+	std::vector<uint32_t> indexStart(count + 1);
+	mesh.PatchVertexStart.resize(count + 1);
+	mesh.PatchVertexStart[0] = 0;
+	indexStart[0] = 0;
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		mesh.PatchVertexStart[i + 1] = mesh.PatchVertexStart[i] + (uint32_t)topologies[i]->Domain.size();
+		indexStart[i + 1] = indexStart[i] + (uint32_t)topologies[i]->Indices.size();
+	}
+
+	mesh.Vertices.resize(mesh.PatchVertexStart[count]);
+	mesh.Indices.resize(indexStart[count]);
+
+	mPool->ParallelFor(taskCount, [&](uint32_t task)
+	{
+		uint32_t first = task*PatchesPerTask;
+		uint32_t last = (std::min)(count, first + PatchesPerTask);
+		for(uint32_t i = first; i < last; ++i)
+		{
+			const Topology& topology = *topologies[i];
+			uint32_t base = mesh.PatchVertexStart[i];
+
+			EvaluateVertices(patches[i], topology.Domain.data(), topology.Domain.size(), &mesh.Vertices[base]);
+
+			uint32_t* indices = mesh.Indices.data() + indexStart[i];
+			for(size_t k = 0; k < topology.Indices.size(); ++k)
+				indices[k] = base + topology.Indices[k];
+		}
+	});
+}
+
+size_t BezierTessellator::CachedTopologyCount()const
+{
+	std::lock_guard<std::mutex> lock(mCacheMutex);
+	return mTopologies.size();
+}
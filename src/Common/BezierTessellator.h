@@ -0,0 +1,148 @@
+//***************************************************************************************
+// BezierTessellator.h
+//
+// Tessellates bicubic Bezier patches on the CPU, the way the BezierPatch sample's hull
+// shader and the fixed function tessellator do on the GPU, so it can serve as a
+// reference for the shaders and as a fallback for models with many patches.
+//
+// Tessellation factors come from a screen space flatness bound.  A cubic's second
+// derivative is at most 6 D, where D is the largest second difference of its control
+// points, and n equal segments stray from the curve by at most 1/8 (1/n)^2 times the
+// second derivative; the factor is the n that keeps this under a tolerance in pixels,
+// with D measured on the projected control points.  An edge's factor depends only on
+// the four control points of that edge, so patches that share an edge agree on it.
+// The inside factors take the largest D over the rows or columns, which bounds every
+// iso-curve of the patch.
+//
+// The factors are then clamped and rounded as D3D does for the chosen partitioning,
+// and the points along each edge and axis are placed with the 16.16 fixed point
+// arithmetic of the D3D11 reference tessellator, so a domain location here is the
+// one SV_DomainLocation gives.  The triangles between the edges and the inner grid
+// are a simple zip of the two rows of points rather than D3D's stitching tables.
+//
+// Triangulations depend only on the factors.  Factors are rounded up to a bucket
+// step and one triangulation (domain points and indices) is cached per bucket;
+// each patch then only evaluates its points.  Points are evaluated four at a time
+// with Bernstein polynomials in DirectXMath vectors.  Points on the patch border are
+// evaluated again from the edge curve alone, always starting from the same end, so
+// neighboring patches produce bit identical border vertices and the mesh is
+// watertight.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class ThreadPool;
+
+class BezierTessellator
+{
+public:
+	// The hull shader's [partitioning] attribute.  pow2 is left out: the fixed
+	// function tessellator treats it as integer.
+	enum class Partitioning
+	{
+		Integer,
+		FractionalOdd,
+		FractionalEven
+	};
+
+	// Control points row by row: P[4*row + column].  u runs along a row and v down
+	// the columns, as in BezierTessellation.hlsl.
+	struct Patch
+	{
+		DirectX::XMFLOAT3 P[16];
+	};
+
+	// In SV_TessFactor order: Edge[0] is u == 0, Edge[1] v == 0, Edge[2] u == 1 and
+	// Edge[3] v == 1.  Inside[0] is along u and Inside[1] along v.
+	struct Factors
+	{
+		float Edge[4];
+		float Inside[2];
+	};
+
+	struct Vertex
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+		DirectX::XMFLOAT2 Domain;
+	};
+
+	// Domain points and triangles for one set of factors.  Triangles are clockwise
+	// with u to the right and v down, as triangle_cw gives.
+	struct Topology
+	{
+		std::vector<DirectX::XMFLOAT2> Domain;
+		std::vector<uint32_t> Indices;
+	};
+
+	struct Mesh
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<uint32_t> Indices;
+
+		// The vertices of patch i are [PatchVertexStart[i], PatchVertexStart[i + 1]).
+		std::vector<uint32_t> PatchVertexStart;
+	};
+
+	struct Desc
+	{
+		BezierTessellator::Partitioning Partitioning = BezierTessellator::Partitioning::FractionalOdd;
+
+		// Largest distance in pixels between the surface and its triangles.
+		float PixelTolerance = 0.5f;
+
+		// Factors are rounded up to a multiple of this before a triangulation is
+		// looked up.  Integer partitioning rounds to whole numbers anyway.
+		float BucketStep = 0.25f;
+	};
+
+	// pool defaults to ThreadPool::Default().
+	explicit BezierTessellator(const Desc& desc, ThreadPool* pool = nullptr);
+
+	const Desc& GetDesc()const { return mDesc; }
+
+	// The point at (u, v) by de Casteljau's algorithm; the reference for the
+	// vectorized evaluation.
+	static DirectX::XMFLOAT3 Evaluate(const Patch& patch, float u, float v);
+
+	// Positions and normals at count domain points.  The normal is du x dv.
+	static void EvaluateVertices(const Patch& patch, const DirectX::XMFLOAT2* domain, size_t count, Vertex* vertices);
+
+	// Factors from the flatness bound.  worldViewProj takes the control points to
+	// clip space; width and height are the viewport in pixels.
+	Factors ComputeFactors(const Patch& patch, DirectX::FXMMATRIX worldViewProj, float width, float height)const;
+
+	// The factors the D3D tessellator works with after it clamps and rounds them.
+	Factors ProcessFactors(const Factors& factors)const;
+
+	// The triangulation for these factors, built on first use.  Safe to call from
+	// several threads.
+	const Topology& GetTopology(const Factors& factors);
+
+	// Tessellates count patches into one mesh.
+	void Tessellate(const Patch* patches, uint32_t count, DirectX::FXMMATRIX worldViewProj,
+		float width, float height, Mesh& mesh);
+
+	size_t CachedTopologyCount()const;
+
+private:
+	// The processed factors in 16.16 fixed point.
+	typedef std::array<int32_t, 6> TopologyKey;
+
+	void BuildTopology(const Factors& processed, Topology& topology)const;
+
+private:
+	Desc mDesc;
+	ThreadPool* mPool;
+
+	mutable std::mutex mCacheMutex;
+	std::map<TopologyKey, std::unique_ptr<Topology>> mTopologies;
+};
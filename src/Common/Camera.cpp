@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "Camera.h"
+#include <cassert>
 
 using namespace DirectX;
 
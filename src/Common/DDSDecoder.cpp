@@ -0,0 +1,784 @@
+//***************************************************************************************
+// DDSDecoder.cpp
+//***************************************************************************************
+
+#include "DDSDecoder.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	// DXGI_FORMAT values, kept local so the decoder does not need the D3D headers.
+	enum : uint32_t
+	{
+		FormatR32G32B32A32Float = 2,
+		FormatR16G16B16A16Float = 10,
+		FormatR16G16B16A16Unorm = 11,
+		FormatR8G8B8A8Unorm     = 28,
+		FormatR8G8B8A8UnormSrgb = 29,
+		FormatR32Float          = 41,
+		FormatR8G8Unorm         = 49,
+		FormatR16Float          = 54,
+		FormatR16Unorm          = 56,
+		FormatR8Unorm           = 61,
+		FormatBC1Unorm          = 71,
+		FormatBC1UnormSrgb      = 72,
+		FormatBC4Unorm          = 80,
+		FormatB8G8R8A8Unorm     = 87,
+		FormatB8G8R8A8UnormSrgb = 91,
+		FormatBC7Unorm          = 98,
+		FormatBC7UnormSrgb      = 99
+	};
+
+	const uint32_t DDSMagic = 0x20534444; // "DDS "
+
+	const uint32_t DDPFFourCC    = 0x4;
+	const uint32_t DDPFRGB       = 0x40;
+	const uint32_t DDPFLuminance = 0x20000;
+
+	const uint32_t DDSCaps2Cubemap = 0x200;
+	const uint32_t DDSCaps2AllFaces = 0xfc00;
+
+	const uint32_t D3D10ResourceDimensionTexture2D = 3;
+	const uint32_t D3D10ResourceMiscTextureCube = 0x4;
+
+	struct DDSPixelFormat
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct DDSHeader
+	{
+		uint32_t Size;
+		uint32_t Flags;
+		uint32_t Height;
+		uint32_t Width;
+		uint32_t PitchOrLinearSize;
+		uint32_t Depth;
+		uint32_t MipMapCount;
+		uint32_t Reserved1[11];
+		DDSPixelFormat PixelFormat;
+		uint32_t Caps;
+		uint32_t Caps2;
+		uint32_t Caps3;
+		uint32_t Caps4;
+		uint32_t Reserved2;
+	};
+
+	struct DDSHeaderDXT10
+	{
+		uint32_t DxgiFormat;
+		uint32_t ResourceDimension;
+		uint32_t MiscFlag;
+		uint32_t ArraySize;
+		uint32_t MiscFlags2;
+	};
+
+	static_assert(sizeof(DDSHeader) == 124, "DDS header size mismatch");
+	static_assert(sizeof(DDSHeaderDXT10) == 20, "DDS DX10 header size mismatch");
+
+	constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) |
+			((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+	}
+
+	uint32_t FormatFromLegacyPixelFormat(const DDSPixelFormat& pf)
+	{
+		if(pf.Flags & DDPFFourCC)
+		{
+			switch(pf.FourCC)
+			{
+			case MakeFourCC('D', 'X', 'T', '1'): return FormatBC1Unorm;
+			case MakeFourCC('A', 'T', 'I', '1'):
+			case MakeFourCC('B', 'C', '4', 'U'): return FormatBC4Unorm;
+			case 36:  return FormatR16G16B16A16Unorm; // D3DFMT_A16B16G16R16
+			case 111: return FormatR16Float;          // D3DFMT_R16F
+			case 113: return FormatR16G16B16A16Float; // D3DFMT_A16B16G16R16F
+			case 114: return FormatR32Float;          // D3DFMT_R32F
+			case 116: return FormatR32G32B32A32Float; // D3DFMT_A32B32G32R32F
+			}
+			return 0;
+		}
+
+		if((pf.Flags & DDPFRGB) && pf.RGBBitCount == 32)
+		{
+			if(pf.RBitMask == 0x000000ff && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x00ff0000)
+				return FormatR8G8B8A8Unorm;
+			if(pf.RBitMask == 0x00ff0000 && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x000000ff)
+				return FormatB8G8R8A8Unorm;
+		}
+
+		if(pf.Flags & DDPFLuminance)
+		{
+			if(pf.RGBBitCount == 8 && pf.RBitMask == 0xff)
+				return FormatR8Unorm;
+			if(pf.RGBBitCount == 16 && pf.RBitMask == 0xffff)
+				return FormatR16Unorm;
+		}
+
+		return 0;
+	}
+
+	bool IsBlockCompressed(uint32_t format, uint32_t& blockBytes)
+	{
+		switch(format)
+		{
+		case FormatBC1Unorm:
+		case FormatBC1UnormSrgb:
+		case FormatBC4Unorm:
+			blockBytes = 8;
+			return true;
+		case FormatBC7Unorm:
+		case FormatBC7UnormSrgb:
+			blockBytes = 16;
+			return true;
+		}
+		return false;
+	}
+
+	uint32_t BytesPerTexel(uint32_t format)
+	{
+		switch(format)
+		{
+		case FormatR32G32B32A32Float: return 16;
+		case FormatR16G16B16A16Float:
+		case FormatR16G16B16A16Unorm: return 8;
+		case FormatR8G8B8A8Unorm:
+		case FormatR8G8B8A8UnormSrgb:
+		case FormatB8G8R8A8Unorm:
+		case FormatB8G8R8A8UnormSrgb:
+		case FormatR32Float:          return 4;
+		case FormatR8G8Unorm:
+		case FormatR16Float:
+		case FormatR16Unorm:          return 2;
+		case FormatR8Unorm:           return 1;
+		}
+		return 0;
+	}
+
+	template<typename T>
+	T ReadValue(const uint8_t* p)
+	{
+		T v;
+		std::memcpy(&v, p, sizeof(T));
+		return v;
+	}
+
+	XMFLOAT4 DecodeTexel(uint32_t format, const uint8_t* p)
+	{
+		const float inv8 = 1.0f / 255.0f;
+		const float inv16 = 1.0f / 65535.0f;
+
+		switch(format)
+		{
+		case FormatR32G32B32A32Float:
+			return XMFLOAT4(ReadValue<float>(p), ReadValue<float>(p + 4), ReadValue<float>(p + 8), ReadValue<float>(p + 12));
+		case FormatR16G16B16A16Float:
+			return XMFLOAT4(
+				XMConvertHalfToFloat(ReadValue<HALF>(p)), XMConvertHalfToFloat(ReadValue<HALF>(p + 2)),
+				XMConvertHalfToFloat(ReadValue<HALF>(p + 4)), XMConvertHalfToFloat(ReadValue<HALF>(p + 6)));
+		case FormatR16G16B16A16Unorm:
+			return XMFLOAT4(
+				ReadValue<uint16_t>(p) * inv16, ReadValue<uint16_t>(p + 2) * inv16,
+				ReadValue<uint16_t>(p + 4) * inv16, ReadValue<uint16_t>(p + 6) * inv16);
+		case FormatR8G8B8A8Unorm:
+		case FormatR8G8B8A8UnormSrgb:
+			return XMFLOAT4(p[0] * inv8, p[1] * inv8, p[2] * inv8, p[3] * inv8);
+		case FormatB8G8R8A8Unorm:
+		case FormatB8G8R8A8UnormSrgb:
+			return XMFLOAT4(p[2] * inv8, p[1] * inv8, p[0] * inv8, p[3] * inv8);
+		case FormatR32Float:
+			return XMFLOAT4(ReadValue<float>(p), 0.0f, 0.0f, 1.0f);
+		case FormatR8G8Unorm:
+			return XMFLOAT4(p[0] * inv8, p[1] * inv8, 0.0f, 1.0f);
+		case FormatR16Float:
+			return XMFLOAT4(XMConvertHalfToFloat(ReadValue<HALF>(p)), 0.0f, 0.0f, 1.0f);
+		case FormatR16Unorm:
+			return XMFLOAT4(ReadValue<uint16_t>(p) * inv16, 0.0f, 0.0f, 1.0f);
+		case FormatR8Unorm:
+			return XMFLOAT4(p[0] * inv8, 0.0f, 0.0f, 1.0f);
+		}
+		return XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
+	//
+	// BC7 tables, from the BC7 format specification.
+	//
+
+	// Subset of each texel for the 2-subset partitions, one bit per texel.
+	const uint16_t BC7Partitions2[64] =
+	{
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+		0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+		0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+		0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+		0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+	};
+
+	// Subset of each texel for the 3-subset partitions.
+	const uint8_t BC7Partitions3[64][16] =
+	{
+		{ 0,0,1,1, 0,0,1,1, 0,2,2,1, 2,2,2,2 }, { 0,0,0,1, 0,0,1,1, 2,2,1,1, 2,2,2,1 },
+		{ 0,0,0,0, 2,0,0,1, 2,2,1,1, 2,2,1,1 }, { 0,2,2,2, 0,0,2,2, 0,0,1,1, 0,1,1,1 },
+		{ 0,0,0,0, 0,0,0,0, 1,1,2,2, 1,1,2,2 }, { 0,0,1,1, 0,0,1,1, 0,0,2,2, 0,0,2,2 },
+		{ 0,0,2,2, 0,0,2,2, 1,1,1,1, 1,1,1,1 }, { 0,0,1,1, 0,0,1,1, 2,2,1,1, 2,2,1,1 },
+		{ 0,0,0,0, 0,0,0,0, 1,1,1,1, 2,2,2,2 }, { 0,0,0,0, 1,1,1,1, 1,1,1,1, 2,2,2,2 },
+		{ 0,0,0,0, 1,1,1,1, 2,2,2,2, 2,2,2,2 }, { 0,0,1,2, 0,0,1,2, 0,0,1,2, 0,0,1,2 },
+		{ 0,1,1,2, 0,1,1,2, 0,1,1,2, 0,1,1,2 }, { 0,1,2,2, 0,1,2,2, 0,1,2,2, 0,1,2,2 },
+		{ 0,0,1,1, 0,1,1,2, 1,1,2,2, 1,2,2,2 }, { 0,0,1,1, 2,0,0,1, 2,2,0,0, 2,2,2,0 },
+		{ 0,0,0,1, 0,0,1,1, 0,1,1,2, 1,1,2,2 }, { 0,1,1,1, 0,0,1,1, 2,0,0,1, 2,2,0,0 },
+		{ 0,0,0,0, 1,1,2,2, 1,1,2,2, 1,1,2,2 }, { 0,0,2,2, 0,0,2,2, 0,0,2,2, 1,1,1,1 },
+		{ 0,1,1,1, 0,1,1,1, 0,2,2,2, 0,2,2,2 }, { 0,0,0,1, 0,0,0,1, 2,2,2,1, 2,2,2,1 },
+		{ 0,0,0,0, 0,0,1,1, 0,1,2,2, 0,1,2,2 }, { 0,0,0,0, 1,1,0,0, 2,2,1,0, 2,2,1,0 },
+		{ 0,1,2,2, 0,1,2,2, 0,0,1,1, 0,0,0,0 }, { 0,0,1,2, 0,0,1,2, 1,1,2,2, 2,2,2,2 },
+		{ 0,1,1,0, 1,2,2,1, 1,2,2,1, 0,1,1,0 }, { 0,0,0,0, 0,1,1,0, 1,2,2,1, 1,2,2,1 },
+		{ 0,0,2,2, 1,1,0,2, 1,1,0,2, 0,0,2,2 }, { 0,1,1,0, 0,1,1,0, 2,0,0,2, 2,2,2,2 },
+		{ 0,0,1,1, 0,1,2,2, 0,1,2,2, 0,0,1,1 }, { 0,0,0,0, 2,0,0,0, 2,2,1,1, 2,2,2,1 },
+		{ 0,0,0,0, 0,0,0,2, 1,1,2,2, 1,2,2,2 }, { 0,2,2,2, 0,0,2,2, 0,0,1,2, 0,0,1,1 },
+		{ 0,0,1,1, 0,0,1,2, 0,0,2,2, 0,2,2,2 }, { 0,1,2,0, 0,1,2,0, 0,1,2,0, 0,1,2,0 },
+		{ 0,0,0,0, 1,1,1,1, 2,2,2,2, 0,0,0,0 }, { 0,1,2,0, 1,2,0,1, 2,0,1,2, 0,1,2,0 },
+		{ 0,1,2,0, 2,0,1,2, 1,2,0,1, 0,1,2,0 }, { 0,0,1,1, 2,2,0,0, 1,1,2,2, 0,0,1,1 },
+		{ 0,0,1,1, 1,1,2,2, 2,2,0,0, 0,0,1,1 }, { 0,1,0,1, 0,1,0,1, 2,2,2,2, 2,2,2,2 },
+		{ 0,0,0,0, 0,0,0,0, 2,1,2,1, 2,1,2,1 }, { 0,0,2,2, 1,1,2,2, 0,0,2,2, 1,1,2,2 },
+		{ 0,0,2,2, 0,0,1,1, 0,0,2,2, 0,0,1,1 }, { 0,2,2,0, 1,2,2,1, 0,2,2,0, 1,2,2,1 },
+		{ 0,1,0,1, 2,2,2,2, 2,2,2,2, 0,1,0,1 }, { 0,0,0,0, 2,1,2,1, 2,1,2,1, 2,1,2,1 },
+		{ 0,1,0,1, 0,1,0,1, 0,1,0,1, 2,2,2,2 }, { 0,2,2,2, 0,1,1,1, 0,2,2,2, 0,1,1,1 },
+		{ 0,0,0,2, 1,1,1,2, 0,0,0,2, 1,1,1,2 }, { 0,0,0,0, 2,1,1,2, 2,1,1,2, 2,1,1,2 },
+		{ 0,2,2,2, 0,1,1,1, 0,1,1,1, 0,2,2,2 }, { 0,0,0,2, 1,1,1,2, 1,1,1,2, 0,0,0,2 },
+		{ 0,1,1,0, 0,1,1,0, 0,1,1,0, 2,2,2,2 }, { 0,0,0,0, 0,0,0,0, 2,1,1,2, 2,1,1,2 },
+		{ 0,1,1,0, 0,1,1,0, 2,2,2,2, 2,2,2,2 }, { 0,0,2,2, 0,0,1,1, 0,0,1,1, 0,0,2,2 },
+		{ 0,0,2,2, 1,1,2,2, 1,1,2,2, 0,0,2,2 }, { 0,0,0,0, 0,0,0,0, 0,0,0,0, 2,1,1,2 },
+		{ 0,0,0,2, 0,0,0,1, 0,0,0,2, 0,0,0,1 }, { 0,2,2,2, 1,2,2,2, 0,2,2,2, 1,2,2,2 },
+		{ 0,1,0,1, 2,2,2,2, 2,2,2,2, 2,2,2,2 }, { 0,1,1,1, 2,0,1,1, 2,2,0,1, 2,2,2,0 }
+	};
+
+	// Anchor texel of subset 1 for the 2-subset partitions.
+	const uint8_t BC7Anchors2[64] =
+	{
+		15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+		15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+		15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+		 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15
+	};
+
+	// Anchor texels of subsets 1 and 2 for the 3-subset partitions.
+	const uint8_t BC7Anchors3a[64] =
+	{
+		 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+		 3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+		 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+		 3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3
+	};
+
+	const uint8_t BC7Anchors3b[64] =
+	{
+		15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+		15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+		15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+		15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8
+	};
+
+	const uint8_t BC7Weights2[4] = { 0, 21, 43, 64 };
+	const uint8_t BC7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const uint8_t BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct BC7ModeInfo
+	{
+		uint8_t Subsets;
+		uint8_t PartitionBits;
+		uint8_t RotationBits;
+		uint8_t IndexSelectionBits;
+		uint8_t ColorBits;
+		uint8_t AlphaBits;
+		uint8_t EndpointPBits;
+		uint8_t SharedPBits;
+		uint8_t IndexBits;
+		uint8_t IndexBits2;
+	};
+
+	const BC7ModeInfo BC7Modes[8] =
+	{
+		{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+		{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+		{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+		{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+		{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+		{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+		{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+		{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+	};
+
+	class BlockBits
+	{
+	public:
+		explicit BlockBits(const uint8_t block[16])
+		{
+			std::memcpy(&mLo, block, 8);
+			std::memcpy(&mHi, block + 8, 8);
+		}
+
+		uint32_t Read(uint32_t count)
+		{
+			if(count == 0)
+				return 0;
+
+			uint64_t value;
+			if(mPos >= 64)
+				value = mHi >> (mPos - 64);
+			else if(mPos == 0)
+				value = mLo;
+			else
+				value = (mLo >> mPos) | (mHi << (64 - mPos));
+
+			mPos += count;
+			return (uint32_t)(value & ((1ull << count) - 1));
+		}
+
+	private:
+		uint64_t mLo = 0;
+		uint64_t mHi = 0;
+		uint32_t mPos = 0;
+	};
+
+	const uint8_t* BC7Weights(uint32_t indexBits)
+	{
+		return indexBits == 2 ? BC7Weights2 : (indexBits == 3 ? BC7Weights3 : BC7Weights4);
+	}
+
+	uint8_t BC7Interpolate(uint32_t e0, uint32_t e1, uint32_t index, uint32_t indexBits)
+	{
+		uint32_t w = BC7Weights(indexBits)[index];
+		return (uint8_t)(((64 - w) * e0 + w * e1 + 32) >> 6);
+	}
+
+	uint8_t ExpandBits(uint32_t value, uint32_t bits)
+	{
+		value <<= (8 - bits);
+		return (uint8_t)(value | (value >> bits));
+	}
+
+	uint8_t Expand565(uint32_t value, uint32_t bits)
+	{
+		return bits == 5 ? (uint8_t)((value << 3) | (value >> 2)) : (uint8_t)((value << 2) | (value >> 4));
+	}
+
+	size_t MipByteSize(uint32_t format, uint32_t width, uint32_t height)
+	{
+		uint32_t blockBytes = 0;
+		if(IsBlockCompressed(format, blockBytes))
+			return (size_t)std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * blockBytes;
+		return (size_t)width * height * BytesPerTexel(format);
+	}
+
+	bool ParseHeader(const uint8_t* data, size_t size, DDSDecoder::Info& info, size_t& offset)
+	{
+		if(size < sizeof(uint32_t) + sizeof(DDSHeader) || ReadValue<uint32_t>(data) != DDSMagic)
+			return false;
+
+		DDSHeader header = ReadValue<DDSHeader>(data + sizeof(uint32_t));
+		if(header.Size != sizeof(DDSHeader) || header.PixelFormat.Size != sizeof(DDSPixelFormat))
+			return false;
+
+		offset = sizeof(uint32_t) + sizeof(DDSHeader);
+		uint32_t format = 0;
+		uint32_t arraySize = 1;
+		bool cube = false;
+
+		if((header.PixelFormat.Flags & DDPFFourCC) && header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			if(size < offset + sizeof(DDSHeaderDXT10))
+				return false;
+
+			DDSHeaderDXT10 dx10 = ReadValue<DDSHeaderDXT10>(data + offset);
+			if(dx10.ResourceDimension != D3D10ResourceDimensionTexture2D)
+				return false;
+
+			format = dx10.DxgiFormat;
+			cube = (dx10.MiscFlag & D3D10ResourceMiscTextureCube) != 0;
+			arraySize = std::max(1u, dx10.ArraySize) * (cube ? 6 : 1);
+			offset += sizeof(DDSHeaderDXT10);
+		}
+		else
+		{
+			format = FormatFromLegacyPixelFormat(header.PixelFormat);
+
+			// Legacy cube maps must have all six faces; D3D can't create partial ones.
+			if(header.Caps2 & DDSCaps2Cubemap)
+			{
+				if((header.Caps2 & DDSCaps2AllFaces) != DDSCaps2AllFaces)
+					return false;
+				cube = true;
+				arraySize = 6;
+			}
+		}
+
+		if(!DDSDecoder::IsFormatSupported(format) || header.Width == 0 || header.Height == 0)
+			return false;
+
+		info.Width = header.Width;
+		info.Height = header.Height;
+		info.MipCount = std::max(1u, header.MipMapCount);
+		info.Format = format;
+		info.ArraySize = arraySize;
+		info.IsCube = cube;
+		return true;
+	}
+}
+
+void DDSDecoder::DecodeBC1Block(const uint8_t block[8], uint8_t rgba[16][4])
+{
+	uint16_t c0 = ReadValue<uint16_t>(block);
+	uint16_t c1 = ReadValue<uint16_t>(block + 2);
+	uint32_t indices = ReadValue<uint32_t>(block + 4);
+
+	uint8_t palette[4][4];
+	palette[0][0] = Expand565(c0 >> 11, 5);
+	palette[0][1] = Expand565((c0 >> 5) & 0x3f, 6);
+	palette[0][2] = Expand565(c0 & 0x1f, 5);
+	palette[1][0] = Expand565(c1 >> 11, 5);
+	palette[1][1] = Expand565((c1 >> 5) & 0x3f, 6);
+	palette[1][2] = Expand565(c1 & 0x1f, 5);
+	palette[0][3] = palette[1][3] = 255;
+
+	for(int c = 0; c < 3; ++c)
+	{
+		if(c0 > c1)
+		{
+			palette[2][c] = (uint8_t)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+			palette[3][c] = (uint8_t)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+		}
+		else
+		{
+			palette[2][c] = (uint8_t)((palette[0][c] + palette[1][c]) / 2);
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = (c0 > c1) ? 255 : 0;
+
+	for(int i = 0; i < 16; ++i)
+		std::memcpy(rgba[i], palette[(indices >> (2 * i)) & 3], 4);
+}
+
+void DDSDecoder::DecodeBC4Block(const uint8_t block[8], uint8_t rgba[16][4])
+{
+	uint32_t r0 = block[0];
+	uint32_t r1 = block[1];
+
+	uint8_t palette[8];
+	palette[0] = (uint8_t)r0;
+	palette[1] = (uint8_t)r1;
+	if(r0 > r1)
+	{
+		for(uint32_t i = 1; i < 7; ++i)
+			palette[i + 1] = (uint8_t)(((7 - i) * r0 + i * r1 + 3) / 7);
+	}
+	else
+	{
+		for(uint32_t i = 1; i < 5; ++i)
+			palette[i + 1] = (uint8_t)(((5 - i) * r0 + i * r1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t indices = 0;
+	std::memcpy(&indices, block + 2, 6);
+
+	for(int i = 0; i < 16; ++i)
+	{
+		rgba[i][0] = palette[(indices >> (3 * i)) & 7];
+		rgba[i][1] = 0;
+		rgba[i][2] = 0;
+		rgba[i][3] = 255;
+	}
+}
+
+void DDSDecoder::DecodeBC7Block(const uint8_t block[16], uint8_t rgba[16][4])
+{
+	uint32_t mode = 0;
+	while(mode < 8 && (block[0] & (1u << mode)) == 0)
+		++mode;
+
+	// Reserved mode; the specification decodes it to transparent black.
+	if(mode == 8)
+	{
+		std::memset(rgba, 0, 16 * 4);
+		return;
+	}
+
+	const BC7ModeInfo& info = BC7Modes[mode];
+	BlockBits bits(block);
+	bits.Read(mode + 1);
+
+	uint32_t partition = bits.Read(info.PartitionBits);
+	uint32_t rotation = bits.Read(info.RotationBits);
+	uint32_t indexSelection = bits.Read(info.IndexSelectionBits);
+
+	// Endpoints [subset][endpoint][channel].
+	uint32_t endpoints[3][2][4] = {};
+	for(uint32_t c = 0; c < 3; ++c)
+		for(uint32_t s = 0; s < info.Subsets; ++s)
+			for(uint32_t e = 0; e < 2; ++e)
+				endpoints[s][e][c] = bits.Read(info.ColorBits);
+
+	if(info.AlphaBits > 0)
+	{
+		for(uint32_t s = 0; s < info.Subsets; ++s)
+			for(uint32_t e = 0; e < 2; ++e)
+				endpoints[s][e][3] = bits.Read(info.AlphaBits);
+	}
+
+	uint32_t colorBits = info.ColorBits;
+	uint32_t alphaBits = info.AlphaBits;
+	if(info.EndpointPBits || info.SharedPBits)
+	{
+		for(uint32_t s = 0; s < info.Subsets; ++s)
+		{
+			uint32_t sharedBit = info.SharedPBits ? bits.Read(1) : 0;
+			for(uint32_t e = 0; e < 2; ++e)
+			{
+				uint32_t pBit = info.EndpointPBits ? bits.Read(1) : sharedBit;
+				for(uint32_t c = 0; c < 4; ++c)
+					endpoints[s][e][c] = (endpoints[s][e][c] << 1) | pBit;
+			}
+		}
+
+		++colorBits;
+		if(alphaBits > 0)
+			++alphaBits;
+	}
+
+	for(uint32_t s = 0; s < info.Subsets; ++s)
+	{
+		for(uint32_t e = 0; e < 2; ++e)
+		{
+			for(uint32_t c = 0; c < 3; ++c)
+				endpoints[s][e][c] = ExpandBits(endpoints[s][e][c], colorBits);
+			endpoints[s][e][3] = alphaBits > 0 ? ExpandBits(endpoints[s][e][3], alphaBits) : 255;
+		}
+	}
+
+	uint32_t subsetOf[16];
+	for(uint32_t i = 0; i < 16; ++i)
+	{
+		if(info.Subsets == 2)
+			subsetOf[i] = (BC7Partitions2[partition] >> i) & 1;
+		else if(info.Subsets == 3)
+			subsetOf[i] = BC7Partitions3[partition][i];
+		else
+			subsetOf[i] = 0;
+	}
+
+	// The anchor texel of each subset stores its index with the top bit dropped.
+	uint32_t anchors[3] = { 0, 0, 0 };
+	if(info.Subsets == 2)
+		anchors[1] = BC7Anchors2[partition];
+	else if(info.Subsets == 3)
+	{
+		anchors[1] = BC7Anchors3a[partition];
+		anchors[2] = BC7Anchors3b[partition];
+	}
+
+	uint32_t indices[16];
+	for(uint32_t i = 0; i < 16; ++i)
+	{
+		bool isAnchor = (i == anchors[subsetOf[i]]);
+		indices[i] = bits.Read(info.IndexBits - (isAnchor ? 1 : 0));
+	}
+
+	uint32_t indices2[16] = {};
+	if(info.IndexBits2 > 0)
+	{
+		for(uint32_t i = 0; i < 16; ++i)
+			indices2[i] = bits.Read(info.IndexBits2 - (i == 0 ? 1 : 0));
+	}
+
+	for(uint32_t i = 0; i < 16; ++i)
+	{
+		const uint32_t (&ep)[2][4] = endpoints[subsetOf[i]];
+
+		uint32_t colorIndex = indices[i];
+		uint32_t colorIndexBits = info.IndexBits;
+		uint32_t alphaIndex = indices[i];
+		uint32_t alphaIndexBits = info.IndexBits;
+
+		if(info.IndexBits2 > 0)
+		{
+			if(indexSelection == 0)
+			{
+				alphaIndex = indices2[i];
+				alphaIndexBits = info.IndexBits2;
+			}
+			else
+			{
+				colorIndex = indices2[i];
+				colorIndexBits = info.IndexBits2;
+			}
+		}
+
+		for(uint32_t c = 0; c < 3; ++c)
+			rgba[i][c] = BC7Interpolate(ep[0][c], ep[1][c], colorIndex, colorIndexBits);
+		rgba[i][3] = BC7Interpolate(ep[0][3], ep[1][3], alphaIndex, alphaIndexBits);
+
+		if(rotation > 0)
+			std::swap(rgba[i][3], rgba[i][rotation - 1]);
+	}
+}
+
+bool DDSDecoder::IsFormatSupported(uint32_t dxgiFormat)
+{
+	uint32_t blockBytes;
+	return IsBlockCompressed(dxgiFormat, blockBytes) || BytesPerTexel(dxgiFormat) > 0;
+}
+
+bool DDSDecoder::GetInfo(const uint8_t* data, size_t size, Info& info)
+{
+	size_t offset;
+	return ParseHeader(data, size, info, offset);
+}
+
+bool DDSDecoder::LoadFromFile(const std::wstring& filename, Image& image, uint32_t mipLevel, uint32_t arraySlice)
+{
+#ifdef _WIN32
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+#else
+	// Only MSVC's streams take wide file names; ASCII names pass through unchanged.
+	std::ifstream file(std::string(filename.begin(), filename.end()), std::ios::binary | std::ios::ate);
+#endif
+	if(!file.is_open())
+		return false;
+
+	std::streamoff size = file.tellg();
+	if(size <= 0)
+		return false;
+
+	std::vector<uint8_t> data((size_t)size);
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(data.data()), size);
+	if(!file)
+		return false;
+
+	return LoadFromMemory(data.data(), data.size(), image, mipLevel, arraySlice);
+}
+
+bool DDSDecoder::LoadFromMemory(const uint8_t* data, size_t size, Image& image, uint32_t mipLevel, uint32_t arraySlice)
+{
+	return LoadRegionFromMemory(data, size, mipLevel, Region(), image, arraySlice);
+}
+
+bool DDSDecoder::LoadRegionFromMemory(const uint8_t* data, size_t size, uint32_t mipLevel,
+	const Region& region, Image& image, uint32_t arraySlice)
+{
+	Info info;
+	size_t offset = 0;
+	if(!ParseHeader(data, size, info, offset) || mipLevel >= info.MipCount || arraySlice >= info.ArraySize)
+		return false;
+
+	const uint32_t format = info.Format;
+	uint32_t blockBytes = 0;
+	const bool compressed = IsBlockCompressed(format, blockBytes);
+
+	// Slices are stored one after the other, each with its whole mip chain
+	uint32_t width = info.Width;
+	uint32_t height = info.Height;
+	size_t sliceBytes = 0;
+	for(uint32_t mip = 0; mip < info.MipCount; ++mip)
+	{
+		sliceBytes += MipByteSize(format, width, height);
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+	offset += sliceBytes * arraySlice;
+
+	// Skip the finer levels
+	width = info.Width;
+	height = info.Height;
+	for(uint32_t mip = 0; mip < mipLevel; ++mip)
+	{
+		offset += MipByteSize(format, width, height);
+		width = std::max(1u, width / 2);
+		height = std::max(1u, height / 2);
+	}
+
+	if(offset > size || size - offset < MipByteSize(format, width, height))
+		return false;
+
+	uint32_t x0 = region.X;
+	uint32_t y0 = region.Y;
+	uint32_t w = region.Width ? region.Width : width;
+	uint32_t h = region.Height ? region.Height : height;
+	if(x0 >= width || y0 >= height || w > width - x0 || h > height - y0)
+		return false;
+
+	const uint8_t* src = data + offset;
+
+	image.Width = w;
+	image.Height = h;
+	image.Format = format;
+	image.Texels.resize((size_t)w * h);
+
+	if(compressed)
+	{
+		const uint32_t blocksX = (width + 3) / 4;
+		const float inv8 = 1.0f / 255.0f;
+		uint8_t rgba[16][4];
+
+		for(uint32_t by = y0 / 4; by <= (y0 + h - 1) / 4; ++by)
+		{
+			for(uint32_t bx = x0 / 4; bx <= (x0 + w - 1) / 4; ++bx)
+			{
+				const uint8_t* block = src + ((size_t)by * blocksX + bx) * blockBytes;
+				switch(format)
+				{
+				case FormatBC1Unorm:
+				case FormatBC1UnormSrgb: DecodeBC1Block(block, rgba); break;
+				case FormatBC4Unorm:     DecodeBC4Block(block, rgba); break;
+				default:                 DecodeBC7Block(block, rgba); break;
+				}
+
+				// Copy the part of the block that falls inside the region
+				const uint32_t tx0 = std::max(bx * 4, x0);
+				const uint32_t tx1 = std::min(bx * 4 + 4, x0 + w);
+				const uint32_t ty0 = std::max(by * 4, y0);
+				const uint32_t ty1 = std::min(by * 4 + 4, y0 + h);
+				for(uint32_t y = ty0; y < ty1; ++y)
+				{
+					for(uint32_t x = tx0; x < tx1; ++x)
+					{
+						const uint8_t* t = rgba[(y - by * 4) * 4 + (x - bx * 4)];
+						image.Texels[(size_t)(y - y0) * w + (x - x0)] =
+							XMFLOAT4(t[0] * inv8, t[1] * inv8, t[2] * inv8, t[3] * inv8);
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		const uint32_t texelBytes = BytesPerTexel(format);
+		for(uint32_t y = 0; y < h; ++y)
+		{
+			const uint8_t* row = src + ((size_t)(y0 + y) * width + x0) * texelBytes;
+			for(uint32_t x = 0; x < w; ++x)
+				image.Texels[(size_t)y * w + x] = DecodeTexel(format, row + (size_t)x * texelBytes);
+		}
+	}
+
+	return true;
+}
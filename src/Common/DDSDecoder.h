@@ -0,0 +1,73 @@
+//***************************************************************************************
+// DDSDecoder.h
+//
+// Decodes a mip level (or part of one) of a 2D DDS image into floating point texels on the CPU.
+// Arrays and cube maps are read one slice at a time; a cube map is six slices per cube,
+// in the order +X, -X, +Y, -Y, +Z, -Z.
+// DDSTextureLoader only creates GPU resources; this is for the cases where the CPU
+// needs the same data (collision heights, bounds, baking).
+//
+// Supported formats: R8/R8G8/R8G8B8A8/B8G8R8A8 UNORM, R16/R16G16B16A16 UNORM,
+// R16/R16G16B16A16 FLOAT, R32/R32G32B32A32 FLOAT, BC1, BC4 and BC7, with either a
+// DX10 header or the equivalent legacy header.  UNORM data is returned in [0,1].
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace DDSDecoder
+{
+	struct Image
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+
+		// DXGI_FORMAT of the file.
+		uint32_t Format = 0;
+
+		// Width*Height texels, row major.  Missing channels are 0 (alpha 1).
+		std::vector<DirectX::XMFLOAT4> Texels;
+	};
+
+	struct Info
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t MipCount = 0;
+		uint32_t Format = 0;
+
+		// 2D slices in the file, counting each cube face.
+		uint32_t ArraySize = 1;
+		bool IsCube = false;
+	};
+
+	// Sub-rectangle of a mip level in texels.  A zero size means the whole level.
+	struct Region
+	{
+		uint32_t X = 0;
+		uint32_t Y = 0;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+	};
+
+	bool GetInfo(const uint8_t* data, size_t size, Info& info);
+
+	bool LoadFromFile(const std::wstring& filename, Image& image, uint32_t mipLevel = 0, uint32_t arraySlice = 0);
+	bool LoadFromMemory(const uint8_t* data, size_t size, Image& image, uint32_t mipLevel = 0, uint32_t arraySlice = 0);
+
+	// Decodes only the texels inside region; block compressed data decodes just the
+	// blocks it touches, so reading a tile's edge is cheap.
+	bool LoadRegionFromMemory(const uint8_t* data, size_t size, uint32_t mipLevel,
+		const Region& region, Image& image, uint32_t arraySlice = 0);
+
+	bool IsFormatSupported(uint32_t dxgiFormat);
+
+	// Block decoders; each writes a 4x4 block of RGBA8 texels in row order.
+	void DecodeBC1Block(const uint8_t block[8], uint8_t rgba[16][4]);
+	void DecodeBC4Block(const uint8_t block[8], uint8_t rgba[16][4]);
+	void DecodeBC7Block(const uint8_t block[16], uint8_t rgba[16][4]);
+}
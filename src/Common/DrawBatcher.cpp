@@ -0,0 +1,179 @@
+//***************************************************************************************
+// DrawBatcher.cpp
+//***************************************************************************************
+
+#include "DrawBatcher.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	inline uint64_t Field(uint32_t value, uint32_t bits, uint32_t shift)
+	{
+		assert(value < (1u << bits));
+		return (uint64_t)(value & ((1u << bits) - 1)) << shift;
+	}
+
+	inline bool SameState(const DrawBatcher::Draw& a, const DrawBatcher::Draw& b, bool materialPerInstance)
+	{
+		return a.Layer == b.Layer && a.Pso == b.Pso && (materialPerInstance || a.Material == b.Material) &&
+			a.Geometry == b.Geometry && a.Mesh == b.Mesh;
+	}
+}
+
+DrawBatcher::DrawBatcher(const Desc& desc) :
+	mDesc(desc)
+{
+}
+
+void DrawBatcher::Clear()
+{
+	mDraws.clear();
+	mEntries.clear();
+	mOrder.clear();
+	mBatches.clear();
+	mStats = Stats();
+}
+
+uint32_t DrawBatcher::Add(const Draw& draw)
+{
+	mDraws.push_back(draw);
+	return (uint32_t)mDraws.size() - 1;
+}
+
+uint64_t DrawBatcher::Key(const Draw& draw)const
+{
+	const uint32_t maxDepth = (1u << DepthBits) - 1;
+
+	float t = draw.Depth / mDesc.FarZ;
+	t = (std::min)((std::max)(t, 0.0f), 1.0f);
+	uint32_t depth = (uint32_t)(t*maxDepth + 0.5f);
+
+	uint64_t key = Field(draw.Layer, LayerBits, 64 - LayerBits);
+	uint32_t shift = 64 - LayerBits;
+
+	if(draw.Layer < 32 && (mDesc.BackToFrontLayers >> draw.Layer) & 1)
+	{
+		key |= Field(maxDepth - depth, DepthBits, shift -= DepthBits);
+		key |= Field(draw.Pso, PsoBits, shift -= PsoBits);
+		key |= Field(draw.Material, MaterialBits, shift -= MaterialBits);
+		key |= Field(draw.Geometry, GeometryBits, shift -= GeometryBits);
+		key |= Field(draw.Mesh, MeshBits, shift -= MeshBits);
+	}
+	else
+	{
+		key |= Field(draw.Pso, PsoBits, shift -= PsoBits);
+		key |= Field(draw.Material, MaterialBits, shift -= MaterialBits);
+		key |= Field(draw.Geometry, GeometryBits, shift -= GeometryBits);
+		key |= Field(draw.Mesh, MeshBits, shift -= MeshBits);
+		key |= Field(depth, DepthBits, shift -= DepthBits);
+	}
+
+	return key;
+}
+
+void DrawBatcher::RadixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch)
+{
+	const size_t count = entries.size();
+	scratch.resize(count);
+	if(count < 2)
+		return;
+
+	// All eight histograms in one read of the keys.
+	uint32_t histograms[8][256] = {};
+	for(const Entry& e : entries)
+	{
+		for(int pass = 0; pass < 8; ++pass)
+			++histograms[pass][(e.Key >> (pass*8)) & 0xff];
+	}
+
+	Entry* src = entries.data();
+	Entry* dst = scratch.data();
+	for(int pass = 0; pass < 8; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+		const uint32_t shift = pass*8;
+
+		// Every key has the same byte here, so the pass would copy them in order.
+		if(histogram[(src[0].Key >> shift) & 0xff] == count)
+			continue;
+
+		uint32_t offset = 0;
+		for(int bucket = 0; bucket < 256; ++bucket)
+		{
+			uint32_t n = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += n;
+		}
+
+		for(size_t i = 0; i < count; ++i)
+			dst[histogram[(src[i].Key >> shift) & 0xff]++] = src[i];
+
+		std::swap(src, dst);
+	}
+
+	// An odd number of passes leaves the result in scratch.
+	if(src != entries.data())
+		entries.swap(scratch);
+}
+
+void DrawBatcher::Build()
+{
+	const uint32_t count = (uint32_t)mDraws.size();
+
+	mEntries.resize(count);
+	for(uint32_t i = 0; i < count; ++i)
+		mEntries[i] = { Key(mDraws[i]), i };
+
+	RadixSort(mEntries, mScratch);
+
+	mOrder.resize(count);
+	mBatches.clear();
+	mStats = Stats();
+
+	const Draw* last = nullptr;
+	for(uint32_t k = 0; k < count; ++k)
+	{
+		const uint32_t index = mEntries[k].Index;
+		const Draw& draw = mDraws[index];
+		mOrder[k] = index;
+
+		if(mDesc.Instancing && last != nullptr && SameState(*last, draw, mDesc.MaterialPerInstance))
+		{
+			++mBatches.back().Count;
+			continue;
+		}
+
+		Batch batch;
+		batch.First = k;
+		batch.Count = 1;
+		batch.PsoChanged = last == nullptr || last->Pso != draw.Pso;
+		batch.MaterialChanged = !mDesc.MaterialPerInstance && (last == nullptr || last->Material != draw.Material);
+		batch.GeometryChanged = last == nullptr || last->Geometry != draw.Geometry;
+		mBatches.push_back(batch);
+
+		++mStats.Draws;
+		mStats.PsoChanges += batch.PsoChanged ? 1 : 0;
+		mStats.MaterialChanges += batch.MaterialChanged ? 1 : 0;
+		mStats.GeometryChanges += batch.GeometryChanged ? 1 : 0;
+
+		last = &draw;
+	}
+}
+
+DrawBatcher::Stats DrawBatcher::UnsortedStats()const
+{
+	Stats stats;
+
+	const Draw* last = nullptr;
+	for(const Draw& draw : mDraws)
+	{
+		++stats.Draws;
+		stats.PsoChanges += last == nullptr || last->Pso != draw.Pso ? 1 : 0;
+		stats.MaterialChanges += mDesc.MaterialPerInstance ? 0 : 1;
+		++stats.GeometryChanges;
+		last = &draw;
+	}
+
+	return stats;
+}
@@ -0,0 +1,153 @@
+//***************************************************************************************
+// DrawBatcher.h
+//
+// Orders a frame's draws by a 64-bit sort key and groups them into batches, so the
+// command list only binds what changed from one draw to the next and items sharing a
+// mesh and a material go out as one instanced draw.
+//
+// The key is, from the top bit down:
+//
+//   layer 4 | pso 8 | material 12 | geometry 12 | mesh 12 | depth 16
+//
+// so draws sort by layer first, then by the state that is dearest to change.  Depth
+// is the view space distance quantized over [0, FarZ] and sorts front to back, which
+// only reorders draws whose state is the same anyway.  Layers listed in
+// BackToFrontLayers (blended ones) move inverted depth up under the layer instead, so
+// they draw back to front and keep their state grouping only where it is free.
+//
+// Keys are sorted with an LSD radix sort, eight bits per pass; passes whose byte is
+// the same in every key are skipped, which with a handful of state ids and one layer
+// leaves three or four of the eight.  The sort is stable, so draws with equal keys
+// keep the order they were added in.
+//
+// Consecutive sorted draws with the same layer, pso, material, geometry and mesh form
+// one batch.  Order() lists the added draws batch by batch, which is the order to
+// write per-instance data in: batch b reads instances [First, First + Count) of it.
+// When the shader reads the material from the instance data (MaterialPerInstance),
+// draws that differ only in material share a batch; the material stays in the key so
+// the instances of a batch still come grouped by material.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class DrawBatcher
+{
+public:
+	static const uint32_t LayerBits = 4;
+	static const uint32_t PsoBits = 8;
+	static const uint32_t MaterialBits = 12;
+	static const uint32_t GeometryBits = 12;
+	static const uint32_t MeshBits = 12;
+	static const uint32_t DepthBits = 16;
+
+	struct Desc
+	{
+		// View depth that maps to the largest quantized depth; farther draws clamp to it.
+		float FarZ = 1000.0f;
+
+		// Bit l set sorts layer l back to front.
+		uint32_t BackToFrontLayers = 0;
+
+		// When false every draw is its own batch, so only the sort and the skipped
+		// bindings remain.
+		bool Instancing = true;
+
+		// Set when the material index comes with each instance rather than being bound
+		// per draw: a change of material then neither splits a batch nor counts as a
+		// binding.
+		bool MaterialPerInstance = false;
+	};
+
+	// Ids are the caller's, small integers that fit their fields.
+	struct Draw
+	{
+		uint32_t Layer = 0;
+		uint32_t Pso = 0;
+		uint32_t Material = 0;
+
+		// Vertex and index buffers.
+		uint32_t Geometry = 0;
+
+		// Index range within Geometry, i.e. the DrawIndexedInstanced arguments.
+		uint32_t Mesh = 0;
+
+		// View space depth of the draw, usually of its bounds' center.
+		float Depth = 0.0f;
+	};
+
+	struct Batch
+	{
+		// Range of Order().
+		uint32_t First = 0;
+		uint32_t Count = 0;
+
+		// What differs from the batch before; all true for the first batch, except
+		// MaterialChanged, which is always false with MaterialPerInstance.
+		bool PsoChanged = false;
+		bool MaterialChanged = false;
+		bool GeometryChanged = false;
+	};
+
+	struct Stats
+	{
+		uint32_t Draws = 0;
+		uint32_t PsoChanges = 0;
+		uint32_t MaterialChanges = 0;
+		uint32_t GeometryChanges = 0;
+
+		uint32_t StateChanges()const { return PsoChanges + MaterialChanges + GeometryChanges; }
+	};
+
+	struct Entry
+	{
+		uint64_t Key;
+		uint32_t Index;
+	};
+
+	explicit DrawBatcher(const Desc& desc);
+	DrawBatcher(const DrawBatcher& rhs) = delete;
+	DrawBatcher& operator=(const DrawBatcher& rhs) = delete;
+
+	const Desc& GetDesc()const { return mDesc; }
+
+	// Forgets the draws of the last frame.
+	void Clear();
+
+	// Returns the draw's index, which Order() refers to.
+	uint32_t Add(const Draw& draw);
+
+	// Sorts the draws added since Clear and makes the batches.
+	void Build();
+
+	uint32_t DrawCount()const { return (uint32_t)mDraws.size(); }
+	const Draw& GetDraw(uint32_t index)const { return mDraws[index]; }
+
+	const std::vector<uint32_t>& Order()const { return mOrder; }
+	const std::vector<Batch>& Batches()const { return mBatches; }
+
+	// The last Build's bindings and draws.
+	const Stats& GetStats()const { return mStats; }
+
+	// What drawing in the order added costs when every draw binds its geometry and
+	// material (unless MaterialPerInstance), and the pso only when it changes; the loop
+	// Build replaces.
+	Stats UnsortedStats()const;
+
+	uint64_t Key(const Draw& draw)const;
+
+	// Stable sort of entries by Key; scratch is resized to match.
+	static void RadixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch);
+
+private:
+	Desc mDesc;
+
+	std::vector<Draw> mDraws;
+	std::vector<Entry> mEntries;
+	std::vector<Entry> mScratch;
+	std::vector<uint32_t> mOrder;
+	std::vector<Batch> mBatches;
+	Stats mStats;
+};
@@ -0,0 +1,529 @@
+//***************************************************************************************
+// EnvironmentBaker.cpp
+//***************************************************************************************
+
+#include "EnvironmentBaker.h"
+#include "SampleSets.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t FormatR32G32B32A32Float = 2;
+
+	const uint32_t RowsPerTask = 16;
+
+	// Faces smaller than this aren't prefiltered; see Desc::SpecularSize.
+	const uint32_t MinSpecularSize = 4;
+
+	// Clamped cosine convolution over pi, per band.
+	const float IrradianceBand[3] = { 1.0f, 2.0f/3.0f, 0.25f };
+
+	// The nine real SH basis functions at a unit direction.
+	void ShBasis(float x, float y, float z, float basis[9])
+	{
+		basis[0] = 0.282095f;
+		basis[1] = 0.488603f*y;
+		basis[2] = 0.488603f*z;
+		basis[3] = 0.488603f*x;
+		basis[4] = 1.092548f*x*y;
+		basis[5] = 1.092548f*y*z;
+		basis[6] = 0.315392f*(3.0f*z*z - 1.0f);
+		basis[7] = 1.092548f*x*z;
+		basis[8] = 0.546274f*(x*x - y*y);
+	}
+
+	// A face direction from the face coordinates (a, b) in [-1,1] and the major axis
+	// component c.  It is unit length when (a, b, c) is.
+	XMVECTOR XM_CALLCONV FaceDirection(int face, float a, float b, float c)
+	{
+		switch(face)
+		{
+		case 0:  return XMVectorSet(c, -b, -a, 0.0f);
+		case 1:  return XMVectorSet(-c, -b, a, 0.0f);
+		case 2:  return XMVectorSet(a, c, b, 0.0f);
+		case 3:  return XMVectorSet(a, -c, -b, 0.0f);
+		case 4:  return XMVectorSet(a, -b, c, 0.0f);
+		default: return XMVectorSet(-a, -b, -c, 0.0f);
+		}
+	}
+
+	// Signed area of the spherical quad from the face center to (a, b) on the unit
+	// cube face.
+	float AreaElement(float a, float b)
+	{
+		return atan2f(a*b, sqrtf(a*a + b*b + 1.0f));
+	}
+
+	uint32_t Log2(uint32_t value)
+	{
+		uint32_t log = 0;
+		while(value > 1)
+		{
+			value >>= 1;
+			++log;
+		}
+		return log;
+	}
+
+	// GGX half vector in tangent space (z along the normal) for the sample point
+	// (u0, u1) and alpha = roughness^2.
+	XMVECTOR XM_CALLCONV ImportanceSampleGgx(float u0, float u1, float alpha)
+	{
+		float phi = XM_2PI*u0;
+		float cosTheta = sqrtf((1.0f - u1) / (1.0f + (alpha*alpha - 1.0f)*u1));
+		float sinTheta = sqrtf(1.0f - cosTheta*cosTheta);
+		return XMVectorSet(sinTheta*cosf(phi), sinTheta*sinf(phi), cosTheta, 0.0f);
+	}
+
+	// Bilinear lookup of face coordinates (u, v) in [0,1], clamped at the face edges.
+	XMVECTOR XM_CALLCONV SampleFace(const DDSDecoder::Image& image, float u, float v)
+	{
+		const uint32_t size = image.Width;
+		float x = (std::min)((std::max)(u*size - 0.5f, 0.0f), (float)(size - 1));
+		float y = (std::min)((std::max)(v*size - 0.5f, 0.0f), (float)(size - 1));
+
+		uint32_t x0 = (uint32_t)x;
+		uint32_t y0 = (uint32_t)y;
+		uint32_t x1 = (std::min)(x0 + 1, size - 1);
+		uint32_t y1 = (std::min)(y0 + 1, size - 1);
+		float fx = x - x0;
+		float fy = y - y0;
+
+		const XMFLOAT4* texels = image.Texels.data();
+		XMVECTOR top = XMVectorLerp(XMLoadFloat4(&texels[y0*size + x0]), XMLoadFloat4(&texels[y0*size + x1]), fx);
+		XMVECTOR bottom = XMVectorLerp(XMLoadFloat4(&texels[y1*size + x0]), XMLoadFloat4(&texels[y1*size + x1]), fx);
+		return XMVectorLerp(top, bottom, fy);
+	}
+
+	// GGX lobe sample of the prefilter: the light direction in tangent space, its
+	// weight N.L and the source mip to read.
+	struct SpecularSample
+	{
+		XMFLOAT3 L;
+		float NdotL;
+		float Lod;
+	};
+}
+
+struct EnvironmentBaker::Tables
+{
+	uint32_t Size = 0;
+
+	// Per texel of a face: the normalized face coordinates and major axis component,
+	// which FaceDirection turns into the direction on any face, and the solid angle.
+	std::vector<XMFLOAT4> Texels;
+};
+
+EnvironmentBaker::EnvironmentBaker(const Desc& desc, ThreadPool* pool) :
+	mDesc(desc)
+{
+	mPool = pool != nullptr ? pool : &ThreadPool::Default();
+}
+
+EnvironmentBaker::~EnvironmentBaker()
+{
+}
+
+XMVECTOR XM_CALLCONV EnvironmentBaker::TexelDirection(int face, uint32_t x, uint32_t y, uint32_t size)
+{
+	float a = 2.0f*(x + 0.5f) / size - 1.0f;
+	float b = 2.0f*(y + 0.5f) / size - 1.0f;
+	return XMVector3Normalize(FaceDirection(face, a, b, 1.0f));
+}
+
+float EnvironmentBaker::TexelSolidAngle(uint32_t x, uint32_t y, uint32_t size)
+{
+	float a0 = 2.0f*x / size - 1.0f;
+	float b0 = 2.0f*y / size - 1.0f;
+	float a1 = 2.0f*(x + 1) / size - 1.0f;
+	float b1 = 2.0f*(y + 1) / size - 1.0f;
+	return AreaElement(a0, b0) - AreaElement(a0, b1) - AreaElement(a1, b0) + AreaElement(a1, b1);
+}
+
+int XM_CALLCONV EnvironmentBaker::DirectionToFace(FXMVECTOR direction, float& u, float& v)
+{
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, direction);
+	float ax = fabsf(d.x);
+	float ay = fabsf(d.y);
+	float az = fabsf(d.z);
+
+	int face;
+	float a, b, major;
+	if(ax >= ay && ax >= az)
+	{
+		face = d.x > 0.0f ? 0 : 1;
+		a = d.x > 0.0f ? -d.z : d.z;
+		b = -d.y;
+		major = ax;
+	}
+	else if(ay >= az)
+	{
+		face = d.y > 0.0f ? 2 : 3;
+		a = d.x;
+		b = d.y > 0.0f ? d.z : -d.z;
+		major = ay;
+	}
+	else
+	{
+		face = d.z > 0.0f ? 4 : 5;
+		a = d.z > 0.0f ? d.x : -d.x;
+		b = -d.y;
+		major = az;
+	}
+
+	u = 0.5f*(a / major + 1.0f);
+	v = 0.5f*(b / major + 1.0f);
+	return face;
+}
+
+const EnvironmentBaker::Tables& EnvironmentBaker::GetTables(uint32_t size)
+{
+	for(const auto& tables : mTables)
+	{
+		if(tables->Size == size)
+			return *tables;
+	}
+
+	std::unique_ptr<Tables> tables(new Tables());
+	tables->Size = size;
+	tables->Texels.resize((size_t)size*size);
+	for(uint32_t y = 0; y < size; ++y)
+	{
+		for(uint32_t x = 0; x < size; ++x)
+		{
+			float a = 2.0f*(x + 0.5f) / size - 1.0f;
+			float b = 2.0f*(y + 0.5f) / size - 1.0f;
+			float c = 1.0f / sqrtf(a*a + b*b + 1.0f);
+			tables->Texels[(size_t)y*size + x] = XMFLOAT4(a*c, b*c, c, TexelSolidAngle(x, y, size));
+		}
+	}
+
+	mTables.push_back(std::move(tables));
+	return *mTables.back();
+}
+
+EnvironmentBaker::SH9 EnvironmentBaker::ProjectSH(const CubeMap& cube)
+{
+	const XMFLOAT4* faces[FaceCount];
+	for(int face = 0; face < FaceCount; ++face)
+		faces[face] = cube.Face(face).Texels.data();
+	return ProjectSH(faces, cube.Size, cube.Size*sizeof(XMFLOAT4));
+}
+
+EnvironmentBaker::SH9 EnvironmentBaker::ProjectSH(const XMFLOAT4* const faces[FaceCount], uint32_t size, uint32_t rowPitch)
+{
+	const Tables& tables = GetTables(size);
+	const uint32_t tilesPerFace = (size + RowsPerTask - 1) / RowsPerTask;
+
+	// One partial sum per tile, added up in order afterwards.
+	std::vector<XMFLOAT4> partial((size_t)FaceCount*tilesPerFace*9);
+
+	mPool->ParallelFor(FaceCount*tilesPerFace, [&](uint32_t task)
+	{
+		const int face = (int)(task / tilesPerFace);
+		const uint32_t firstRow = (task % tilesPerFace)*RowsPerTask;
+		const uint32_t lastRow = (std::min)(size, firstRow + RowsPerTask);
+
+		XMVECTOR sum[9];
+		for(int k = 0; k < 9; ++k)
+			sum[k] = XMVectorZero();
+
+		for(uint32_t y = firstRow; y < lastRow; ++y)
+		{
+			const XMFLOAT4* row = reinterpret_cast<const XMFLOAT4*>(
+				reinterpret_cast<const uint8_t*>(faces[face]) + (size_t)y*rowPitch);
+			const XMFLOAT4* texel = &tables.Texels[(size_t)y*size];
+
+			for(uint32_t x = 0; x < size; ++x)
+			{
+				XMFLOAT3 d;
+				XMStoreFloat3(&d, FaceDirection(face, texel[x].x, texel[x].y, texel[x].z));
+
+				float basis[9];
+				ShBasis(d.x, d.y, d.z, basis);
+
+				XMVECTOR color = XMVectorScale(XMLoadFloat4(&row[x]), texel[x].w);
+				for(int k = 0; k < 9; ++k)
+					sum[k] = XMVectorMultiplyAdd(color, XMVectorReplicate(basis[k]), sum[k]);
+			}
+		}
+
+		for(int k = 0; k < 9; ++k)
+			XMStoreFloat4(&partial[(size_t)task*9 + k], sum[k]);
+	});
+
+	XMVECTOR total[9];
+	for(int k = 0; k < 9; ++k)
+		total[k] = XMVectorZero();
+	for(size_t i = 0; i < partial.size(); ++i)
+		total[i % 9] = XMVectorAdd(total[i % 9], XMLoadFloat4(&partial[i]));
+
+	SH9 sh;
+	for(int k = 0; k < 9; ++k)
+		XMStoreFloat4(&sh.C[k], XMVectorSetW(total[k], 0.0f));
+	return sh;
+}
+
+EnvironmentBaker::SH9 EnvironmentBaker::IrradianceSH(const SH9& radiance)
+{
+	SH9 sh;
+	for(int k = 0; k < 9; ++k)
+	{
+		float band = IrradianceBand[k == 0 ? 0 : (k < 4 ? 1 : 2)];
+		XMStoreFloat4(&sh.C[k], XMVectorScale(XMLoadFloat4(&radiance.C[k]), band));
+	}
+	return sh;
+}
+
+XMVECTOR XM_CALLCONV EnvironmentBaker::EvaluateSH(const SH9& sh, FXMVECTOR direction)
+{
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, XMVector3Normalize(direction));
+
+	float basis[9];
+	ShBasis(d.x, d.y, d.z, basis);
+
+	XMVECTOR result = XMVectorZero();
+	for(int k = 0; k < 9; ++k)
+		result = XMVectorMultiplyAdd(XMLoadFloat4(&sh.C[k]), XMVectorReplicate(basis[k]), result);
+	return result;
+}
+
+void EnvironmentBaker::GenerateMips(CubeMap& cube)
+{
+	const uint32_t mipCount = Log2(cube.Size) + 1;
+
+	std::vector<DDSDecoder::Image> faces((size_t)FaceCount*mipCount);
+	for(int face = 0; face < FaceCount; ++face)
+		faces[face*mipCount] = std::move(cube.Face(face));
+
+	mPool->ParallelFor(FaceCount, [&](uint32_t face)
+	{
+		for(uint32_t mip = 1; mip < mipCount; ++mip)
+		{
+			const DDSDecoder::Image& src = faces[face*mipCount + mip - 1];
+			DDSDecoder::Image& dst = faces[face*mipCount + mip];
+
+			const uint32_t size = src.Width / 2;
+			dst.Width = size;
+			dst.Height = size;
+			dst.Format = FormatR32G32B32A32Float;
+			dst.Texels.resize((size_t)size*size);
+
+			for(uint32_t y = 0; y < size; ++y)
+			{
+				const XMFLOAT4* row0 = &src.Texels[(size_t)(2*y)*src.Width];
+				const XMFLOAT4* row1 = row0 + src.Width;
+				for(uint32_t x = 0; x < size; ++x)
+				{
+					XMVECTOR sum = XMVectorAdd(
+						XMVectorAdd(XMLoadFloat4(&row0[2*x]), XMLoadFloat4(&row0[2*x + 1])),
+						XMVectorAdd(XMLoadFloat4(&row1[2*x]), XMLoadFloat4(&row1[2*x + 1])));
+					XMStoreFloat4(&dst.Texels[(size_t)y*size + x], XMVectorScale(sum, 0.25f));
+				}
+			}
+		}
+	});
+
+	cube.MipCount = mipCount;
+	cube.Faces = std::move(faces);
+}
+
+EnvironmentBaker::CubeMap EnvironmentBaker::PrefilterSpecular(const CubeMap& cube)
+{
+	// The source needs its whole chain for the lookups.
+	CubeMap source;
+	const CubeMap* src = &cube;
+	if(cube.MipCount != Log2(cube.Size) + 1)
+	{
+		source.Size = cube.Size;
+		source.MipCount = 1;
+		for(int face = 0; face < FaceCount; ++face)
+			source.Faces.push_back(cube.Face(face));
+		GenerateMips(source);
+		src = &source;
+	}
+
+	const uint32_t sourceMip = mDesc.SpecularSize != 0 && mDesc.SpecularSize < cube.Size ?
+		Log2(cube.Size) - Log2(mDesc.SpecularSize) : 0;
+	const uint32_t size = cube.Size >> sourceMip;
+
+	CubeMap result;
+	result.Size = size;
+	result.MipCount = size > MinSpecularSize ? Log2(size / MinSpecularSize) + 1 : 1;
+	result.Faces.resize((size_t)FaceCount*result.MipCount);
+
+	// The samples depend on the roughness alone: with N = V the lobe is the same
+	// about every normal.
+	const uint32_t sampleCount = (std::max)(mDesc.SpecularSamples, 1u);
+	const float topTexelSolidAngle = 4.0f*XM_PI / (6.0f*cube.Size*cube.Size);
+	const float maxLod = (float)(src->MipCount - 1);
+
+	std::vector<std::vector<SpecularSample>> samples(result.MipCount);
+	for(uint32_t mip = 1; mip < result.MipCount; ++mip)
+	{
+		float roughness = (float)mip / (result.MipCount - 1);
+		float alpha = roughness*roughness;
+
+		for(uint32_t i = 0; i < sampleCount; ++i)
+		{
+			XMFLOAT3 h;
+			XMStoreFloat3(&h, ImportanceSampleGgx((float)i / sampleCount, SampleSets::RadicalInverse2(i), alpha));
+
+			// L = 2 (N.H) H - N with N = (0, 0, 1)
+			float NdotH = h.z;
+			SpecularSample sample;
+			sample.L = XMFLOAT3(2.0f*NdotH*h.x, 2.0f*NdotH*h.y, 2.0f*NdotH*NdotH - 1.0f);
+			sample.NdotL = sample.L.z;
+			if(sample.NdotL <= 0.0f)
+				continue;
+
+			// pdf = D(N.H) N.H / (4 V.H), and V.H = N.H here.
+			float d = alpha*alpha / (XM_PI*powf(NdotH*NdotH*(alpha*alpha - 1.0f) + 1.0f, 2.0f));
+			float pdf = d*0.25f;
+			float sampleSolidAngle = 1.0f / (sampleCount*pdf + 0.0001f);
+			sample.Lod = (std::min)((std::max)(0.5f*log2f(sampleSolidAngle / topTexelSolidAngle) + 1.0f, 0.0f), maxLod);
+
+			samples[mip].push_back(sample);
+		}
+	}
+
+	// Tiles of rows of every face of every mip.
+	struct Tile
+	{
+		uint32_t Mip;
+		int Face;
+		uint32_t FirstRow;
+	};
+
+	std::vector<Tile> tiles;
+	for(uint32_t mip = 0; mip < result.MipCount; ++mip)
+	{
+		const uint32_t mipSize = size >> mip;
+		for(int face = 0; face < FaceCount; ++face)
+		{
+			DDSDecoder::Image& image = result.Face(face, mip);
+			image.Width = mipSize;
+			image.Height = mipSize;
+			image.Format = FormatR32G32B32A32Float;
+			image.Texels.resize((size_t)mipSize*mipSize);
+
+			for(uint32_t y = 0; y < mipSize; y += RowsPerTask)
+				tiles.push_back({ mip, face, y });
+		}
+	}
+
+	mPool->ParallelFor((uint32_t)tiles.size(), [&](uint32_t task)
+	{
+		const Tile& tile = tiles[task];
+		DDSDecoder::Image& image = result.Face(tile.Face, tile.Mip);
+		const uint32_t mipSize = image.Width;
+		const uint32_t lastRow = (std::min)(mipSize, tile.FirstRow + RowsPerTask);
+
+		// Roughness 0 is the source itself.
+		if(tile.Mip == 0)
+		{
+			const DDSDecoder::Image& top = src->Face(tile.Face, sourceMip);
+			std::copy(top.Texels.begin() + (size_t)tile.FirstRow*mipSize,
+				top.Texels.begin() + (size_t)lastRow*mipSize, image.Texels.begin() + (size_t)tile.FirstRow*mipSize);
+			return;
+		}
+
+		const std::vector<SpecularSample>& lobe = samples[tile.Mip];
+		for(uint32_t y = tile.FirstRow; y < lastRow; ++y)
+		{
+			for(uint32_t x = 0; x < mipSize; ++x)
+			{
+				XMVECTOR n = TexelDirection(tile.Face, x, y, mipSize);
+				XMVECTOR up = fabsf(XMVectorGetZ(n)) < 0.999f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+				XMVECTOR tangentX = XMVector3Normalize(XMVector3Cross(up, n));
+				XMVECTOR tangentY = XMVector3Cross(n, tangentX);
+
+				XMVECTOR sum = XMVectorZero();
+				float weight = 0.0f;
+				for(const SpecularSample& sample : lobe)
+				{
+					XMVECTOR l = XMVectorMultiplyAdd(tangentX, XMVectorReplicate(sample.L.x),
+						XMVectorMultiplyAdd(tangentY, XMVectorReplicate(sample.L.y), XMVectorScale(n, sample.L.z)));
+
+					float u, v;
+					int face = DirectionToFace(l, u, v);
+
+					// Trilinear between the two source mips around the lod.
+					uint32_t lod0 = (uint32_t)sample.Lod;
+					uint32_t lod1 = (std::min)(lod0 + 1, src->MipCount - 1);
+					XMVECTOR color = XMVectorLerp(SampleFace(src->Face(face, lod0), u, v),
+						SampleFace(src->Face(face, lod1), u, v), sample.Lod - lod0);
+
+					sum = XMVectorMultiplyAdd(color, XMVectorReplicate(sample.NdotL), sum);
+					weight += sample.NdotL;
+				}
+
+				XMStoreFloat4(&image.Texels[(size_t)y*mipSize + x], XMVectorScale(sum, weight > 0.0f ? 1.0f / weight : 0.0f));
+			}
+		}
+	});
+
+	return result;
+}
+
+DDSDecoder::Image EnvironmentBaker::IntegrateBrdf()
+{
+	const uint32_t size = mDesc.BrdfLutSize;
+	const uint32_t sampleCount = (std::max)(mDesc.BrdfLutSamples, 1u);
+
+	DDSDecoder::Image lut;
+	lut.Width = size;
+	lut.Height = size;
+	lut.Format = FormatR32G32B32A32Float;
+	lut.Texels.resize((size_t)size*size);
+
+	mPool->ParallelFor((size + RowsPerTask - 1) / RowsPerTask, [&](uint32_t task)
+	{
+		const uint32_t lastRow = (std::min)(size, (task + 1)*RowsPerTask);
+		for(uint32_t y = task*RowsPerTask; y < lastRow; ++y)
+		{
+			const float roughness = (y + 0.5f) / size;
+			const float alpha = roughness*roughness;
+
+			// Schlick-Smith with k = alpha / 2 for image based lighting.
+			const float k = alpha*0.5f;
+
+			for(uint32_t x = 0; x < size; ++x)
+			{
+				const float NdotV = (x + 0.5f) / size;
+				XMVECTOR v = XMVectorSet(sqrtf(1.0f - NdotV*NdotV), 0.0f, NdotV, 0.0f);
+
+				float scale = 0.0f;
+				float bias = 0.0f;
+				for(uint32_t i = 0; i < sampleCount; ++i)
+				{
+					XMVECTOR h = ImportanceSampleGgx((float)i / sampleCount, SampleSets::RadicalInverse2(i), alpha);
+					float VdotH = XMVectorGetX(XMVector3Dot(v, h));
+					XMVECTOR l = XMVectorSubtract(XMVectorScale(h, 2.0f*VdotH), v);
+
+					float NdotL = XMVectorGetZ(l);
+					float NdotH = XMVectorGetZ(h);
+					if(NdotL <= 0.0f)
+						continue;
+
+					float g = (NdotV / (NdotV*(1.0f - k) + k)) * (NdotL / (NdotL*(1.0f - k) + k));
+					float visibility = g*VdotH / (NdotH*NdotV);
+					float fresnel = powf(1.0f - VdotH, 5.0f);
+
+					scale += (1.0f - fresnel)*visibility;
+					bias += fresnel*visibility;
+				}
+
+				lut.Texels[(size_t)y*size + x] = XMFLOAT4(scale / sampleCount, bias / sampleCount, 0.0f, 1.0f);
+			}
+		}
+	});
+
+	return lut;
+}
@@ -0,0 +1,129 @@
+//***************************************************************************************
+// EnvironmentBaker.h
+//
+// Bakes the image based lighting inputs from a cube map on the CPU: L2 spherical
+// harmonics for diffuse irradiance, a GGX prefiltered mip chain for specular, and the
+// split-sum BRDF lookup table that goes with it (Karis, "Real Shading in Unreal
+// Engine 4").
+//
+// Cube maps are six square faces in CubeMapFace order (+X, -X, +Y, -Y, +Z, -Z) with
+// the D3D face orientation, the order DDS files store them in.
+//
+// Projection weights every texel by its exact solid angle, so the SH of a constant
+// environment is that constant whatever the face size.  The weights and directions
+// of a face's texels are made once per face size and kept, which leaves the nine basis
+// values and a multiply-add of the texel colour into nine DirectXMath vectors per
+// texel; that is the runtime path for probes redrawn every few frames, which only
+// need a small face (16x16 is plenty for L2).
+//
+// The specular chain is prefiltered for roughness mip / (mipCount - 1), with N = V = R
+// as usual.  Each texel importance samples the GGX lobe with the Hammersley set, and
+// every sample reads the box filtered source mip whose texels cover about the solid
+// angle the sample stands for (filtered importance sampling, Krivanek and Colbert),
+// which is what keeps a few hundred samples free of fireflies.  Lookups are bilinear
+// within a face and clamp at its edges.
+//
+// All three split their work into tiles of face rows on a ThreadPool and add the
+// tiles' results up in order, so the output does not depend on the thread count.
+//***************************************************************************************
+
+#pragma once
+
+#include "DDSDecoder.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+class EnvironmentBaker
+{
+public:
+	static const int FaceCount = 6;
+
+	// Face images in CubeMapFace order; faces[face*MipCount + mip] when there are mips,
+	// as DDS files lay them out.
+	struct CubeMap
+	{
+		uint32_t Size = 0;
+		uint32_t MipCount = 0;
+		std::vector<DDSDecoder::Image> Faces;
+
+		const DDSDecoder::Image& Face(int face, uint32_t mip = 0)const { return Faces[face*MipCount + mip]; }
+		DDSDecoder::Image& Face(int face, uint32_t mip = 0) { return Faces[face*MipCount + mip]; }
+	};
+
+	// Nine RGB coefficients, bands 0 to 2 in the usual order (l, m = 0,0; 1,-1; 1,0;
+	// 1,1; 2,-2; 2,-1; 2,0; 2,1; 2,2).  The w components are unused.
+	struct SH9
+	{
+		DirectX::XMFLOAT4 C[9];
+	};
+
+	struct Desc
+	{
+		// GGX samples per texel of the prefiltered chain.
+		uint32_t SpecularSamples = 256;
+
+		// Size of the prefiltered chain's top face; 0 keeps the source size.  The chain
+		// goes down to 4x4, below which the faces are too coarse to filter.
+		uint32_t SpecularSize = 0;
+
+		uint32_t BrdfLutSize = 128;
+		uint32_t BrdfLutSamples = 1024;
+	};
+
+	// pool defaults to ThreadPool::Default().
+	explicit EnvironmentBaker(const Desc& desc, ThreadPool* pool = nullptr);
+	~EnvironmentBaker();
+	EnvironmentBaker(const EnvironmentBaker& rhs) = delete;
+	EnvironmentBaker& operator=(const EnvironmentBaker& rhs) = delete;
+
+	const Desc& GetDesc()const { return mDesc; }
+
+	// Radiance SH of the top mip of a cube map.  Keeps the projection weights for the
+	// face size, so calling this every frame on one size does no setup.
+	SH9 ProjectSH(const CubeMap& cube);
+
+	// Radiance SH of six size x size faces given as pointers to rows of RGBA float
+	// texels, rowPitch bytes apart; what a readback of a probe gives.
+	SH9 ProjectSH(const DirectX::XMFLOAT4* const faces[FaceCount], uint32_t size, uint32_t rowPitch);
+
+	// Convolves radiance SH with the clamped cosine and divides by pi, so that
+	// EvaluateSH of the result in direction n is the radiance a white Lambertian
+	// surface facing n reflects.
+	static SH9 IrradianceSH(const SH9& radiance);
+
+	static DirectX::XMVECTOR XM_CALLCONV EvaluateSH(const SH9& sh, DirectX::FXMVECTOR direction);
+
+	// Box filters the top mip of a cube map down to 1x1, replacing any mips it has.
+	// The face size must be a power of two.
+	void GenerateMips(CubeMap& cube);
+
+	// GGX prefiltered chain of a cube map whose faces are powers of two.
+	CubeMap PrefilterSpecular(const CubeMap& cube);
+
+	// Split-sum BRDF table: x is N.V, y is roughness, red the scale and green the bias
+	// applied to F0.
+	DDSDecoder::Image IntegrateBrdf();
+
+	// Unit direction through the center of texel (x, y) of a face of the given size,
+	// and the solid angle the texel covers.
+	static DirectX::XMVECTOR XM_CALLCONV TexelDirection(int face, uint32_t x, uint32_t y, uint32_t size);
+	static float TexelSolidAngle(uint32_t x, uint32_t y, uint32_t size);
+
+	// Face and [0,1] face coordinates a direction falls on.
+	static int XM_CALLCONV DirectionToFace(DirectX::FXMVECTOR direction, float& u, float& v);
+
+private:
+	struct Tables;
+
+	const Tables& GetTables(uint32_t size);
+
+	Desc mDesc;
+	ThreadPool* mPool = nullptr;
+
+	// Texel directions and solid angles, one set per face size projected.
+	std::vector<std::unique_ptr<Tables>> mTables;
+};
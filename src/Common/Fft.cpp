@@ -0,0 +1,236 @@
+//***************************************************************************************
+// Fft.cpp
+//***************************************************************************************
+
+#include "Fft.h"
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	inline XMVECTOR Load4(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	inline void Store4(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+}
+
+Fft::Fft(uint32_t n)
+	: mSize(n)
+{
+	assert(n >= ColumnsPerTask && (n & (n - 1)) == 0);
+
+	while((1u << mLog2Size) < n)
+		++mLog2Size;
+
+	mBitReverse.resize(n);
+	for(uint32_t i = 0; i < n; ++i)
+	{
+		uint32_t reversed = 0;
+		for(uint32_t b = 0; b < mLog2Size; ++b)
+			reversed |= ((i >> b) & 1) << (mLog2Size - 1 - b);
+		mBitReverse[i] = reversed;
+	}
+
+	// Worked out in double so the table is the same whichever way it is indexed.
+	mCos.resize(n);
+	mSin.resize(n);
+	for(uint32_t m = 0; m < n; ++m)
+	{
+		double angle = 2.0 * 3.14159265358979323846 * m / n;
+		mCos[m] = (float)cos(angle);
+		mSin[m] = (float)sin(angle);
+	}
+}
+
+void Fft::Transform2D(float* re, float* im, bool inverse, ThreadPool* pool)const
+{
+	if(pool == nullptr)
+		pool = &ThreadPool::Default();
+
+	uint32_t taskCount = mSize / ColumnsPerTask;
+	auto columns = [this, re, im, inverse](uint32_t task)
+	{
+		TransformColumns(re, im, task*ColumnsPerTask, inverse);
+	};
+
+	auto rows = [this, re, im, inverse](uint32_t task)
+	{
+		TransformRows(re, im, task*ColumnsPerTask, inverse);
+	};
+
+	pool->ParallelFor(taskCount, columns);
+	pool->ParallelFor(taskCount, rows);
+}
+
+void Fft::TransformColumns(float* re, float* im, uint32_t column, bool inverse)const
+{
+	const uint32_t n = mSize;
+	const uint32_t stride = ColumnsPerTask;
+
+	float* lineRe;
+	float* lineIm;
+	Scratch(lineRe, lineIm);
+
+	for(uint32_t i = 0; i < n; ++i)
+	{
+		uint32_t j = mBitReverse[i];
+		std::copy(re + i*n + column, re + i*n + column + stride, lineRe + j*stride);
+		std::copy(im + i*n + column, im + i*n + column + stride, lineIm + j*stride);
+	}
+
+	RunPasses(lineRe, lineIm, inverse);
+
+	for(uint32_t i = 0; i < n; ++i)
+	{
+		std::copy(lineRe + i*stride, lineRe + (i + 1)*stride, re + i*n + column);
+		std::copy(lineIm + i*stride, lineIm + (i + 1)*stride, im + i*n + column);
+	}
+}
+
+void Fft::TransformRows(float* re, float* im, uint32_t row, bool inverse)const
+{
+	const uint32_t n = mSize;
+	const uint32_t stride = ColumnsPerTask;
+
+	float* lineRe;
+	float* lineIm;
+	Scratch(lineRe, lineIm);
+
+	// Transposed on the way in and out, reading and writing the rows in order.
+	for(uint32_t r = 0; r < stride; ++r)
+	{
+		const float* srcRe = re + (row + r)*n;
+		const float* srcIm = im + (row + r)*n;
+		for(uint32_t i = 0; i < n; ++i)
+		{
+			uint32_t j = mBitReverse[i];
+			lineRe[j*stride + r] = srcRe[i];
+			lineIm[j*stride + r] = srcIm[i];
+		}
+	}
+
+	RunPasses(lineRe, lineIm, inverse);
+
+	for(uint32_t r = 0; r < stride; ++r)
+	{
+		float* dstRe = re + (row + r)*n;
+		float* dstIm = im + (row + r)*n;
+		for(uint32_t i = 0; i < n; ++i)
+		{
+			dstRe[i] = lineRe[i*stride + r];
+			dstIm[i] = lineIm[i*stride + r];
+		}
+	}
+}
+
+void Fft::Scratch(float*& lineRe, float*& lineIm)const
+{
+	static thread_local std::vector<float> scratch;
+	scratch.resize(2*mSize*ColumnsPerTask);
+	lineRe = scratch.data();
+	lineIm = lineRe + mSize*ColumnsPerTask;
+}
+
+void Fft::RunPasses(float* lineRe, float* lineIm, bool inverse)const
+{
+	const uint32_t n = mSize;
+	const uint32_t stride = ColumnsPerTask;
+
+	uint32_t h = 1;
+	if(mLog2Size & 1)
+	{
+		// Single radix-2 stage; all its twiddles are 1.
+		for(uint32_t g = 0; g < n; g += 2)
+		{
+			float* r0 = lineRe + g*stride;
+			float* i0 = lineIm + g*stride;
+			float* r1 = r0 + stride;
+			float* i1 = i0 + stride;
+			for(uint32_t c = 0; c < ColumnsPerTask; c += 4)
+			{
+				XMVECTOR ar = Load4(r0 + c), ai = Load4(i0 + c);
+				XMVECTOR br = Load4(r1 + c), bi = Load4(i1 + c);
+				Store4(r0 + c, ar + br);
+				Store4(i0 + c, ai + bi);
+				Store4(r1 + c, ar - br);
+				Store4(i1 + c, ai - bi);
+			}
+		}
+		h = 2;
+	}
+
+	// Stages h and 2h at once as one radix-4 butterfly.  After the bit reversal the
+	// four runs of h points hold the transforms of the samples 4m, 4m + 2, 4m + 1
+	// and 4m + 3, so with W = W(4h) they take the twiddles 1, W^2k, W^k and W^3k.
+	// The outputs k + h and k + 3h also pick up W^h = -i (+i for the inverse).
+	for(; h < n; h *= 4)
+	{
+		const uint32_t step = n / (4*h);
+		const float sign = inverse ? 1.0f : -1.0f;
+
+		for(uint32_t k = 0; k < h; ++k)
+		{
+			XMVECTOR w1r = XMVectorReplicate(mCos[2*k*step]);
+			XMVECTOR w1i = XMVectorReplicate(sign*mSin[2*k*step]);
+			XMVECTOR w2r = XMVectorReplicate(mCos[k*step]);
+			XMVECTOR w2i = XMVectorReplicate(sign*mSin[k*step]);
+			XMVECTOR w3r = XMVectorReplicate(mCos[3*k*step]);
+			XMVECTOR w3i = XMVectorReplicate(sign*mSin[3*k*step]);
+
+			for(uint32_t g = 0; g < n; g += 4*h)
+			{
+				float* r0 = lineRe + (g + k)*stride;
+				float* i0 = lineIm + (g + k)*stride;
+				float* r1 = r0 + h*stride;
+				float* i1 = i0 + h*stride;
+				float* r2 = r1 + h*stride;
+				float* i2 = i1 + h*stride;
+				float* r3 = r2 + h*stride;
+				float* i3 = i2 + h*stride;
+
+				for(uint32_t c = 0; c < ColumnsPerTask; c += 4)
+				{
+					XMVECTOR x0r = Load4(r0 + c), x0i = Load4(i0 + c);
+					XMVECTOR x1r = Load4(r1 + c), x1i = Load4(i1 + c);
+					XMVECTOR x2r = Load4(r2 + c), x2i = Load4(i2 + c);
+					XMVECTOR x3r = Load4(r3 + c), x3i = Load4(i3 + c);
+
+					XMVECTOR t1r = x1r*w1r - x1i*w1i;
+					XMVECTOR t1i = x1r*w1i + x1i*w1r;
+					XMVECTOR t2r = x2r*w2r - x2i*w2i;
+					XMVECTOR t2i = x2r*w2i + x2i*w2r;
+					XMVECTOR t3r = x3r*w3r - x3i*w3i;
+					XMVECTOR t3i = x3r*w3i + x3i*w3r;
+
+					XMVECTOR a0r = x0r + t1r, a0i = x0i + t1i;
+					XMVECTOR a1r = x0r - t1r, a1i = x0i - t1i;
+					XMVECTOR sr = t2r + t3r, si = t2i + t3i;
+					XMVECTOR dr = t2r - t3r, di = t2i - t3i;
+
+					// Times -i: (r, i) -> (i, -r); times +i: (r, i) -> (-i, r).
+					XMVECTOR vr = inverse ? -di : di;
+					XMVECTOR vi = inverse ? dr : -dr;
+
+					Store4(r0 + c, a0r + sr);
+					Store4(i0 + c, a0i + si);
+					Store4(r2 + c, a0r - sr);
+					Store4(i2 + c, a0i - si);
+					Store4(r1 + c, a1r + vr);
+					Store4(i1 + c, a1i + vi);
+					Store4(r3 + c, a1r - vr);
+					Store4(i3 + c, a1i - vi);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,67 @@
+//***************************************************************************************
+// Fft.h
+//
+// Complex fast Fourier transforms of power of two sizes, with the real and imaginary
+// parts in separate float arrays.
+//
+// The transforms are decimation in time.  The input is put in bit reversed order and
+// then merged in passes that each do two radix-2 stages at once: the radix-4 butterfly
+// needs three complex multiplies where two radix-2 stages need four.  A size with an
+// odd number of stages starts with one radix-2 pass.
+//
+// A 2D transform runs the 1D transform down the columns and then along the rows,
+// sixteen lines at a time.  The lines are copied side by side into a small buffer,
+// so that each butterfly works on four lines per DirectXMath vector and the passes
+// do not stride through the whole array.  Every line goes through the same
+// operations no matter which thread runs it, so the results do not depend on the
+// thread count.
+//
+// No scaling is applied: an inverse transform of a forward transform multiplies the
+// input by the number of points.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+class Fft
+{
+public:
+	// n is a power of two, at least 16.
+	explicit Fft(uint32_t n);
+
+	uint32_t Size()const { return mSize; }
+
+	// In place transform of n x n points stored row by row.  The forward transform
+	// uses e^(-2 pi i jk/n), the inverse e^(+2 pi i jk/n).  pool defaults to
+	// ThreadPool::Default().
+	void Transform2D(float* re, float* im, bool inverse, ThreadPool* pool = nullptr)const;
+
+private:
+	// Transform columns [column, column + ColumnsPerTask) or rows [row, row +
+	// ColumnsPerTask) of an n x n array.
+	void TransformColumns(float* re, float* im, uint32_t column, bool inverse)const;
+	void TransformRows(float* re, float* im, uint32_t row, bool inverse)const;
+
+	// n lines of ColumnsPerTask floats for each part, one buffer per thread.
+	void Scratch(float*& lineRe, float*& lineIm)const;
+
+	// Transforms ColumnsPerTask interleaved lines that are in bit reversed order.
+	void RunPasses(float* lineRe, float* lineIm, bool inverse)const;
+
+private:
+	// Lines per task; a full cache line of each row.
+	static const uint32_t ColumnsPerTask = 16;
+
+	uint32_t mSize = 0;
+	uint32_t mLog2Size = 0;
+
+	std::vector<uint32_t> mBitReverse;
+
+	// cos and sin of 2 pi m/n.
+	std::vector<float> mCos;
+	std::vector<float> mSin;
+};
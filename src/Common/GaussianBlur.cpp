@@ -0,0 +1,330 @@
+//***************************************************************************************
+// GaussianBlur.cpp
+//***************************************************************************************
+
+#include "GaussianBlur.h"
+#include "ThreadPool.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	// DXGI_FORMAT values, kept local so the blur does not need the D3D headers.
+	enum : uint32_t
+	{
+		FormatR32G32B32A32Float = 2,
+		FormatR16G16B16A16Float = 10,
+		FormatR8G8B8A8Unorm     = 28
+	};
+
+	// Rows per horizontal task, columns per vertical task.
+	const uint32_t RowsPerTask = 16;
+	const uint32_t ColumnsPerTask = 16;
+
+	// Largest sigma Auto blurs with the exact kernel.
+	const float ExactSigmaLimit = 2.5f;
+
+	// Boxes per extended box blur.  Three leave visible corners in the kernel, more
+	// than four cost more than they gain.
+	const int BoxPasses = 4;
+
+	struct Kernel
+	{
+		GaussianBlur::Method Method = GaussianBlur::Method::Exact;
+
+		// Exact: weights[0] is the centre and weights[k] the taps at +-k.
+		int Radius = 0;
+		std::vector<XMVECTOR> Weights;
+
+		// Extended box: 2*BoxRadius + 1 taps of BoxWeight and one tap of BoxOuterWeight
+		// on each side.
+		int BoxRadius = 0;
+		XMVECTOR BoxWeight;
+		XMVECTOR BoxOuterWeight;
+
+		// Pixels a line needs past each edge.
+		int Pad = 0;
+	};
+
+	Kernel BuildKernel(float sigma, GaussianBlur::Method method)
+	{
+		Kernel kernel;
+		kernel.Method = method;
+
+		if(method == GaussianBlur::Method::Exact)
+		{
+			kernel.Radius = GaussianBlur::ExactRadius(sigma);
+			auto weights = GaussianBlur::GaussWeights(sigma, kernel.Radius);
+			for(int k = 0; k <= kernel.Radius; ++k)
+				kernel.Weights.push_back(XMVectorReplicate(weights[kernel.Radius + k]));
+			kernel.Pad = kernel.Radius;
+		}
+		else
+		{
+			// Each box takes a quarter of the variance.  The widest plain box with no
+			// more than that variance is widened by the outer taps, whose weight
+			// makes up the rest.
+			double variance = (double)sigma*sigma / BoxPasses;
+			int r = (int)floor(0.5*sqrt(12.0*variance + 1.0) - 0.5);
+			double alpha = (2*r + 1) * (r*(r + 1) - 3.0*variance) / (6.0*(variance - (r + 1)*(r + 1)));
+			double weight = 1.0 / (2*r + 1 + 2.0*alpha);
+
+			kernel.BoxRadius = r;
+			kernel.BoxWeight = XMVectorReplicate((float)weight);
+			kernel.BoxOuterWeight = XMVectorReplicate((float)(alpha*weight));
+			kernel.Pad = BoxPasses*(r + 1);
+		}
+
+		return kernel;
+	}
+
+	// Two lines of count + 2*pad pixels, one pair per thread.
+	void Scratch(uint32_t size, XMVECTOR*& a, XMVECTOR*& b)
+	{
+		static thread_local std::vector<XMVECTOR> scratch;
+		if(scratch.size() < 2*size)
+			scratch.resize(2*size);
+		a = scratch.data();
+		b = a + size;
+	}
+
+	// Interleaved pixels of a strip of columns, one per thread.
+	XMVECTOR* StripScratch(uint32_t size)
+	{
+		static thread_local std::vector<XMVECTOR> scratch;
+		if(scratch.size() < size)
+			scratch.resize(size);
+		return scratch.data();
+	}
+
+	inline XMVECTOR LoadPixel(const uint8_t* row, uint32_t x, uint32_t format)
+	{
+		if(format == FormatR8G8B8A8Unorm)
+			return XMLoadUByteN4(reinterpret_cast<const XMUBYTEN4*>(row) + x);
+		if(format == FormatR32G32B32A32Float)
+			return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row) + x);
+		return XMLoadHalf4(reinterpret_cast<const XMHALF4*>(row) + x);
+	}
+
+	inline void StorePixel(uint8_t* row, uint32_t x, uint32_t format, FXMVECTOR v)
+	{
+		if(format == FormatR8G8B8A8Unorm)
+		{
+			// Rounded to nearest here; the normalized store truncates.
+			XMVECTOR scaled = XMVectorRound(XMVectorScale(XMVectorSaturate(v), 255.0f));
+			XMStoreUByte4(reinterpret_cast<XMUBYTE4*>(row) + x, scaled);
+		}
+		else if(format == FormatR32G32B32A32Float)
+		{
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(row) + x, v);
+		}
+		else
+		{
+			XMStoreHalf4(reinterpret_cast<XMHALF4*>(row) + x, v);
+		}
+	}
+
+	// Repeats the first and last of the count pixels at line[pad] over the pads.
+	void ClampEdges(XMVECTOR* line, uint32_t count, int pad)
+	{
+		std::fill(line, line + pad, line[pad]);
+		std::fill(line + pad + count, line + 2*pad + count, line[pad + count - 1]);
+	}
+
+	// Blurs the count pixels at a[kernel.Pad], with the pads filled, and returns
+	// where the result starts, in a or b.
+	const XMVECTOR* FilterLine(const Kernel& kernel, XMVECTOR* a, XMVECTOR* b, uint32_t count)
+	{
+		const int n = (int)count;
+
+		if(kernel.Method == GaussianBlur::Method::Exact)
+		{
+			const int r = kernel.Radius;
+			const XMVECTOR* src = a + r;
+			for(int i = 0; i < n; ++i)
+			{
+				// The kernel is symmetric, so the taps on both sides share a multiply.
+				XMVECTOR sum = XMVectorMultiply(src[i], kernel.Weights[0]);
+				for(int k = 1; k <= r; ++k)
+					sum = XMVectorMultiplyAdd(XMVectorAdd(src[i - k], src[i + k]), kernel.Weights[k], sum);
+				b[i] = sum;
+			}
+			return b;
+		}
+
+		// Every box shortens the valid part of the line by r + 1 pixels on each side,
+		// so after the last box exactly the count pixels are left.
+		const int r = kernel.BoxRadius;
+		const int outer = r + 1;
+		const int length = n + 2*kernel.Pad;
+
+		XMVECTOR* src = a;
+		XMVECTOR* dst = b;
+		for(int pass = 0; pass < BoxPasses; ++pass)
+		{
+			int first = (pass + 1)*outer;
+			int last = length - (pass + 1)*outer;
+
+			XMVECTOR sum = XMVectorZero();
+			for(int k = first - r; k <= first + r; ++k)
+				sum = XMVectorAdd(sum, src[k]);
+
+			for(int i = first; i < last; ++i)
+			{
+				XMVECTOR ends = XMVectorAdd(src[i - outer], src[i + outer]);
+				dst[i] = XMVectorMultiplyAdd(ends, kernel.BoxOuterWeight, XMVectorMultiply(sum, kernel.BoxWeight));
+
+				// Slide the window one pixel.
+				sum = XMVectorAdd(sum, XMVectorSubtract(src[i + outer], src[i - r]));
+			}
+
+			std::swap(src, dst);
+		}
+
+		return src + kernel.Pad;
+	}
+}
+
+GaussianBlur::GaussianBlur(ThreadPool* pool)
+{
+	mPool = pool != nullptr ? pool : &ThreadPool::Default();
+}
+
+bool GaussianBlur::IsFormatSupported(uint32_t dxgiFormat)
+{
+	return dxgiFormat == FormatR8G8B8A8Unorm || dxgiFormat == FormatR16G16B16A16Float ||
+		dxgiFormat == FormatR32G32B32A32Float;
+}
+
+GaussianBlur::Method GaussianBlur::ChooseMethod(float sigma)
+{
+	return sigma <= ExactSigmaLimit ? Method::Exact : Method::ExtendedBox;
+}
+
+int GaussianBlur::ExactRadius(float sigma)
+{
+	return sigma > 0.0f ? (int)ceilf(3.0f*sigma) : 0;
+}
+
+std::vector<float> GaussianBlur::GaussWeights(float sigma, int radius)
+{
+	std::vector<float> weights(2*radius + 1, 0.0f);
+	if(radius == 0 || sigma <= 0.0f)
+	{
+		weights[radius] = 1.0f;
+		return weights;
+	}
+
+	float twoSigma2 = 2.0f*sigma*sigma;
+
+	float weightSum = 0.0f;
+	for(int i = -radius; i <= radius; ++i)
+	{
+		float x = (float)i;
+		weights[i + radius] = expf(-x*x / twoSigma2);
+		weightSum += weights[i + radius];
+	}
+
+	// Divide by the sum so all the weights add up to 1.0.
+	for(auto& w : weights)
+		w /= weightSum;
+
+	return weights;
+}
+
+bool GaussianBlur::Blur(const void* src, void* dst, uint32_t width, uint32_t height, uint32_t rowPitch,
+	uint32_t dxgiFormat, float sigma, Method method)
+{
+	if(!IsFormatSupported(dxgiFormat))
+		return false;
+
+	if(width == 0 || height == 0)
+		return true;
+
+	if(method == Method::Auto)
+		method = ChooseMethod(sigma);
+
+	const Kernel kernel = BuildKernel(sigma, method);
+	const uint32_t format = dxgiFormat;
+	const uint8_t* srcBytes = static_cast<const uint8_t*>(src);
+	uint8_t* dstBytes = static_cast<uint8_t*>(dst);
+
+	mImage.resize((size_t)width*height);
+	XMFLOAT4* image = mImage.data();
+
+	//
+	// Rows, from the source into mImage.
+	//
+
+	mPool->ParallelFor((height + RowsPerTask - 1) / RowsPerTask, [&](uint32_t task)
+	{
+		XMVECTOR* a;
+		XMVECTOR* b;
+		Scratch(width + 2*kernel.Pad, a, b);
+
+		uint32_t lastRow = (std::min)(height, (task + 1)*RowsPerTask);
+		for(uint32_t y = task*RowsPerTask; y < lastRow; ++y)
+		{
+			const uint8_t* row = srcBytes + (size_t)y*rowPitch;
+			for(uint32_t x = 0; x < width; ++x)
+				a[kernel.Pad + x] = LoadPixel(row, x, format);
+			ClampEdges(a, width, kernel.Pad);
+
+			const XMVECTOR* result = FilterLine(kernel, a, b, width);
+
+			XMFLOAT4* out = image + (size_t)y*width;
+			for(uint32_t x = 0; x < width; ++x)
+				XMStoreFloat4(out + x, result[x]);
+		}
+	});
+
+	//
+	// Columns, from mImage into the destination.
+	//
+
+	mPool->ParallelFor((width + ColumnsPerTask - 1) / ColumnsPerTask, [&](uint32_t task)
+	{
+		const uint32_t lineSize = height + 2*kernel.Pad;
+
+		XMVECTOR* a;
+		XMVECTOR* b;
+		Scratch(lineSize, a, b);
+		XMVECTOR* strip = StripScratch(height*ColumnsPerTask);
+
+		uint32_t firstColumn = task*ColumnsPerTask;
+		uint32_t columns = (std::min)(ColumnsPerTask, width - firstColumn);
+
+		// Read the strip a row at a time, then filter it a column at a time.
+		for(uint32_t y = 0; y < height; ++y)
+		{
+			const XMFLOAT4* in = image + (size_t)y*width + firstColumn;
+			for(uint32_t c = 0; c < columns; ++c)
+				strip[y*ColumnsPerTask + c] = XMLoadFloat4(in + c);
+		}
+
+		for(uint32_t c = 0; c < columns; ++c)
+		{
+			for(uint32_t y = 0; y < height; ++y)
+				a[kernel.Pad + y] = strip[y*ColumnsPerTask + c];
+			ClampEdges(a, height, kernel.Pad);
+
+			const XMVECTOR* result = FilterLine(kernel, a, b, height);
+
+			for(uint32_t y = 0; y < height; ++y)
+				strip[y*ColumnsPerTask + c] = result[y];
+		}
+
+		for(uint32_t y = 0; y < height; ++y)
+		{
+			uint8_t* row = dstBytes + (size_t)y*rowPitch;
+			for(uint32_t c = 0; c < columns; ++c)
+				StorePixel(row, firstColumn + c, format, strip[y*ColumnsPerTask + c]);
+		}
+	});
+
+	return true;
+}
@@ -0,0 +1,69 @@
+//***************************************************************************************
+// GaussianBlur.h
+//
+// Separable Gaussian blur of RGBA images on the CPU, for post-processing without the
+// GPU and as a reference to check the compute shader blur against.
+//
+// Small sigmas use the sampled Gaussian itself, with a radius of 3 sigma, so the cost
+// per pixel grows with sigma.  Large sigmas use extended box filters after Gwosdek et
+// al., "Theoretical Foundations of Gaussian Convolution by Extended Box Filtering":
+// four box filters in a row approach a Gaussian, and a fractional weight on the two
+// outer taps of each box makes the variance come out exactly sigma^2.  A box is a
+// running sum, so its cost per pixel does not depend on the radius.
+//
+// The image is blurred along the rows and then down the columns, with both passes
+// split into tiles on a ThreadPool.  A pixel is one DirectXMath vector, so the four
+// channels are filtered together, and the columns are copied out sixteen at a time so
+// the vertical pass reads whole cache lines.  Pixels past the edges repeat the edge
+// pixel, as the compute shader's clamped loads do.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+class GaussianBlur
+{
+public:
+	enum class Method
+	{
+		// Exact up to a sigma of 2.5, the largest the compute shader's kernel takes,
+		// and extended boxes above.
+		Auto,
+		Exact,
+		ExtendedBox
+	};
+
+	// pool defaults to ThreadPool::Default().
+	explicit GaussianBlur(ThreadPool* pool = nullptr);
+	GaussianBlur(const GaussianBlur& rhs) = delete;
+	GaussianBlur& operator=(const GaussianBlur& rhs) = delete;
+
+	// Blurs a width x height image whose rows are rowPitch bytes apart.  src and dst
+	// may be the same image.  The format is a DXGI_FORMAT; R8G8B8A8_UNORM,
+	// R16G16B16A16_FLOAT and R32G32B32A32_FLOAT are supported.  Returns false for
+	// other formats.
+	bool Blur(const void* src, void* dst, uint32_t width, uint32_t height, uint32_t rowPitch,
+		uint32_t dxgiFormat, float sigma, Method method = Method::Auto);
+
+	static bool IsFormatSupported(uint32_t dxgiFormat);
+
+	// Method Auto picks for sigma.
+	static Method ChooseMethod(float sigma);
+
+	// Radius of the exact kernel for sigma.
+	static int ExactRadius(float sigma);
+
+	// Sampled Gaussian, 2*radius + 1 weights that add up to 1.
+	static std::vector<float> GaussWeights(float sigma, int radius);
+
+private:
+	ThreadPool* mPool = nullptr;
+
+	// The image after the horizontal pass, row by row.
+	std::vector<DirectX::XMFLOAT4> mImage;
+};
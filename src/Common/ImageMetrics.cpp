@@ -0,0 +1,337 @@
+//***************************************************************************************
+// ImageMetrics.cpp
+//***************************************************************************************
+
+#include "ImageMetrics.h"
+#include "GaussianBlur.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t FormatR32G32B32A32Float = 2;
+
+	const uint32_t RowsPerTask = 16;
+
+	// SSIM window and stabilizing constants for values in [0,1].
+	const float SsimSigma = 1.5f;
+	const float SsimC1 = 0.01f*0.01f;
+	const float SsimC2 = 0.03f*0.03f;
+
+	// FLIP's contrast sensitivity filters, each a Gaussian exp(-pi^2 x^2 / b) with x in
+	// degrees.  Blue-yellow is a sum of two Gaussians in FLIP; this b has the same
+	// variance.
+	const float FlipAchromaticB = 0.0047f;
+	const float FlipRedGreenB = 0.0053f;
+	const float FlipBlueYellowB = 0.0357f;
+
+	// Width in degrees of the edge detector, whose Gaussian has half that sigma.
+	const float FlipEdgeWidth = 0.082f;
+
+	// Exponents and the knee of the colour error remap.
+	const float FlipColorExponent = 0.7f;
+	const float FlipFeatureExponent = 0.5f;
+	const float FlipRemapInput = 0.4f;
+	const float FlipRemapOutput = 0.95f;
+
+	// D65 white in XYZ.
+	const XMVECTORF32 WhiteXYZ = { { { 0.950428545f, 1.0f, 1.088900371f, 1.0f } } };
+
+	// Row vector transforms, v*M.
+	const XMMATRIX LinearRGBToXYZ(
+		0.4124564f, 0.2126729f, 0.0193339f, 0.0f,
+		0.3575761f, 0.7151522f, 0.1191920f, 0.0f,
+		0.1804375f, 0.0721750f, 0.9503041f, 0.0f,
+		0.0f,       0.0f,       0.0f,       1.0f);
+
+	const XMMATRIX XYZToLinearRGB(
+		 3.2404542f, -0.9692660f,  0.0556434f, 0.0f,
+		-1.5371385f,  1.8760108f, -0.2040259f, 0.0f,
+		-0.4985314f,  0.0415560f,  1.0572252f, 0.0f,
+		 0.0f,        0.0f,        0.0f,       1.0f);
+
+	// Runs rows(first, last) over row tiles and returns the sum of what the tiles
+	// return, added in tile order.
+	template<typename RowsFunction>
+	double SumRows(ThreadPool* pool, uint32_t height, const RowsFunction& rows)
+	{
+		uint32_t taskCount = (height + RowsPerTask - 1) / RowsPerTask;
+		std::vector<double> sums(taskCount, 0.0);
+
+		pool->ParallelFor(taskCount, [&](uint32_t task)
+		{
+			uint32_t first = task*RowsPerTask;
+			sums[task] = rows(first, (std::min)(height, first + RowsPerTask));
+		});
+
+		double sum = 0.0;
+		for(double s : sums)
+			sum += s;
+		return sum;
+	}
+
+	// Same weights as CalcLuminance in the Sobel shader.
+	inline float Luma(const XMFLOAT4& c)
+	{
+		return 0.299f*c.x + 0.587f*c.y + 0.114f*c.z;
+	}
+
+	inline float SrgbToLinear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline float LabCurve(float t)
+	{
+		const float delta = 6.0f / 29.0f;
+		return t > delta*delta*delta ? cbrtf(t) : t / (3.0f*delta*delta) + 4.0f / 29.0f;
+	}
+
+	// sRGB colour to (Yy, Cx, Cz), FLIP's linear opponent space, with the luminance
+	// Y/Yn in w for the edge detector.
+	XMVECTOR SrgbToYCxCz(const XMFLOAT4& c)
+	{
+		XMVECTOR linear = XMVectorSet(SrgbToLinear(c.x), SrgbToLinear(c.y), SrgbToLinear(c.z), 0.0f);
+		XMFLOAT4 xyz;
+		XMStoreFloat4(&xyz, XMVectorDivide(XMVector3TransformNormal(linear, LinearRGBToXYZ), WhiteXYZ));
+
+		return XMVectorSet(116.0f*xyz.y - 16.0f, 500.0f*(xyz.x - xyz.y), 200.0f*(xyz.y - xyz.z), xyz.y);
+	}
+
+	// Filtered (Yy, Cx, Cz) back to a displayable colour, and on to L*a*b* with the
+	// Hunt effect: colours look less saturated when they are dark.
+	XMVECTOR YCxCzToHuntLab(float yy, float cx, float cz)
+	{
+		float y = (yy + 16.0f) / 116.0f;
+		XMVECTOR xyz = XMVectorMultiply(XMVectorSet(cx / 500.0f + y, y, y - cz / 200.0f, 0.0f), WhiteXYZ);
+		XMVECTOR rgb = XMVectorSaturate(XMVector3TransformNormal(xyz, XYZToLinearRGB));
+
+		XMFLOAT4 t;
+		XMStoreFloat4(&t, XMVectorDivide(XMVector3TransformNormal(rgb, LinearRGBToXYZ), WhiteXYZ));
+		float fx = LabCurve(t.x);
+		float fy = LabCurve(t.y);
+		float fz = LabCurve(t.z);
+
+		float l = 116.0f*fy - 16.0f;
+		return XMVectorSet(l, 0.01f*l*500.0f*(fx - fy), 0.01f*l*200.0f*(fy - fz), 0.0f);
+	}
+
+	// Distance that weighs lightness and chroma apart, which suits large differences
+	// better than the Euclidean one.
+	inline float HyAB(FXMVECTOR a, FXMVECTOR b)
+	{
+		XMVECTOR d = XMVectorSubtract(a, b);
+		float dl = fabsf(XMVectorGetX(d));
+		float dab = XMVectorGetX(XMVector2Length(XMVectorSwizzle<1, 2, 0, 3>(d)));
+		return dl + dab;
+	}
+
+	void Blur(GaussianBlur& blur, std::vector<XMFLOAT4>& image, uint32_t width, uint32_t height, float sigma)
+	{
+		blur.Blur(image.data(), image.data(), width, height, width*sizeof(XMFLOAT4),
+			FormatR32G32B32A32Float, sigma, GaussianBlur::Method::Exact);
+	}
+}
+
+double ImageMetrics::MeanSquaredError(const XMFLOAT4* reference, const XMFLOAT4* test,
+	uint32_t width, uint32_t height, bool includeAlpha, ThreadPool* pool)
+{
+	if(pool == nullptr)
+		pool = &ThreadPool::Default();
+
+	XMVECTOR mask = includeAlpha ? XMVectorTrueInt() : XMVectorSelectControl(1, 1, 1, 0);
+
+	double sum = SumRows(pool, height, [&](uint32_t first, uint32_t last)
+	{
+		double tileSum = 0.0;
+		for(uint32_t y = first; y < last; ++y)
+		{
+			// A row is summed in float, which holds plenty for one row.
+			XMVECTOR rowSum = XMVectorZero();
+			for(uint32_t i = y*width; i < (y + 1)*width; ++i)
+			{
+				XMVECTOR d = XMVectorSubtract(XMLoadFloat4(&reference[i]), XMLoadFloat4(&test[i]));
+				rowSum = XMVectorMultiplyAdd(d, d, rowSum);
+			}
+			rowSum = XMVectorAndInt(rowSum, mask);
+			tileSum += XMVectorGetX(XMVector4Dot(rowSum, XMVectorSplatOne()));
+		}
+		return tileSum;
+	});
+
+	return sum / ((double)width*height*(includeAlpha ? 4 : 3));
+}
+
+double ImageMetrics::Psnr(double meanSquaredError, double peak)
+{
+	if(meanSquaredError <= 0.0)
+		return std::numeric_limits<double>::infinity();
+	return 10.0*log10(peak*peak / meanSquaredError);
+}
+
+double ImageMetrics::Ssim(const XMFLOAT4* reference, const XMFLOAT4* test,
+	uint32_t width, uint32_t height, std::vector<float>* map, ThreadPool* pool)
+{
+	if(pool == nullptr)
+		pool = &ThreadPool::Default();
+
+	const size_t count = (size_t)width*height;
+
+	// The five local means SSIM needs, from two blurs: (x, y, x^2, y^2) and (xy).
+	std::vector<XMFLOAT4> moments(count);
+	std::vector<XMFLOAT4> products(count);
+	pool->ParallelFor((height + RowsPerTask - 1) / RowsPerTask, [&](uint32_t task)
+	{
+		size_t first = (size_t)task*RowsPerTask*width;
+		size_t last = (std::min)(count, first + RowsPerTask*width);
+		for(size_t i = first; i < last; ++i)
+		{
+			float x = Luma(reference[i]);
+			float y = Luma(test[i]);
+			moments[i] = XMFLOAT4(x, y, x*x, y*y);
+			products[i] = XMFLOAT4(x*y, 0.0f, 0.0f, 0.0f);
+		}
+	});
+
+	GaussianBlur blur(pool);
+	Blur(blur, moments, width, height, SsimSigma);
+	Blur(blur, products, width, height, SsimSigma);
+
+	if(map != nullptr)
+		map->resize(count);
+
+	double sum = SumRows(pool, height, [&](uint32_t first, uint32_t last)
+	{
+		double tileSum = 0.0;
+		for(size_t i = (size_t)first*width; i < (size_t)last*width; ++i)
+		{
+			const XMFLOAT4& m = moments[i];
+			float varianceX = m.z - m.x*m.x;
+			float varianceY = m.w - m.y*m.y;
+			float covariance = products[i].x - m.x*m.y;
+
+			float ssim = (2.0f*m.x*m.y + SsimC1)*(2.0f*covariance + SsimC2) /
+				((m.x*m.x + m.y*m.y + SsimC1)*(varianceX + varianceY + SsimC2));
+
+			if(map != nullptr)
+				(*map)[i] = ssim;
+			tileSum += ssim;
+		}
+		return tileSum;
+	});
+
+	return sum / count;
+}
+
+double ImageMetrics::Flip(const XMFLOAT4* reference, const XMFLOAT4* test,
+	uint32_t width, uint32_t height, float pixelsPerDegree, std::vector<float>* map, ThreadPool* pool)
+{
+	if(pool == nullptr)
+		pool = &ThreadPool::Default();
+
+	const size_t count = (size_t)width*height;
+	const float pi = 3.1415926535f;
+
+	// Gaussian sigma in pixels of a filter exp(-pi^2 x^2 / b).
+	auto sigma = [pixelsPerDegree, pi](float b)
+	{
+		return pixelsPerDegree*sqrtf(b / (2.0f*pi*pi));
+	};
+	const float edgeSigma = 0.5f*FlipEdgeWidth*pixelsPerDegree;
+
+	// Central differences of the blurred luminance, scaled so that a unit step gives
+	// an edge of 1.
+	auto edgeWeights = GaussianBlur::GaussWeights(edgeSigma, GaussianBlur::ExactRadius(edgeSigma));
+	int edgeRadius = (int)edgeWeights.size() / 2;
+	float edgeScale = edgeWeights.size() > 1 ?
+		1.0f / (edgeWeights[edgeRadius] + edgeWeights[edgeRadius + 1]) : 0.5f;
+
+	// Each channel has its own filter, so each gets its own blur of the whole image:
+	// x achromatic, y red-green, z blue-yellow and w the edge detector's luminance.
+	const float sigmas[4] = { sigma(FlipAchromaticB), sigma(FlipRedGreenB), sigma(FlipBlueYellowB), edgeSigma };
+
+	GaussianBlur blur(pool);
+	std::vector<XMFLOAT4> filtered[2];
+	const XMFLOAT4* images[2] = { reference, test };
+	for(int k = 0; k < 2; ++k)
+	{
+		std::vector<XMFLOAT4> opponent(count);
+		pool->ParallelFor((height + RowsPerTask - 1) / RowsPerTask, [&](uint32_t task)
+		{
+			size_t first = (size_t)task*RowsPerTask*width;
+			size_t last = (std::min)(count, first + RowsPerTask*width);
+			for(size_t i = first; i < last; ++i)
+				XMStoreFloat4(&opponent[i], SrgbToYCxCz(images[k][i]));
+		});
+
+		filtered[k].resize(count);
+		std::vector<XMFLOAT4> channel;
+		for(int c = 0; c < 4; ++c)
+		{
+			channel = opponent;
+			Blur(blur, channel, width, height, sigmas[c]);
+			for(size_t i = 0; i < count; ++i)
+				(&filtered[k][i].x)[c] = (&channel[i].x)[c];
+		}
+	}
+
+	// Largest colour error, between green and blue.
+	XMFLOAT4 green, blue;
+	XMStoreFloat4(&green, SrgbToYCxCz(XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f)));
+	XMStoreFloat4(&blue, SrgbToYCxCz(XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f)));
+	float colorMax = powf(HyAB(YCxCzToHuntLab(green.x, green.y, green.z), YCxCzToHuntLab(blue.x, blue.y, blue.z)),
+		FlipColorExponent);
+
+	if(map != nullptr)
+		map->resize(count);
+
+	double sum = SumRows(pool, height, [&](uint32_t first, uint32_t last)
+	{
+		double tileSum = 0.0;
+		for(uint32_t y = first; y < last; ++y)
+		{
+			uint32_t up = y > 0 ? y - 1 : 0;
+			uint32_t down = (std::min)(y + 1, height - 1);
+			for(uint32_t x = 0; x < width; ++x)
+			{
+				size_t i = (size_t)y*width + x;
+				const XMFLOAT4& r = filtered[0][i];
+				const XMFLOAT4& t = filtered[1][i];
+
+				// Colour error, compressed so that small errors count for more.
+				float color = powf(HyAB(YCxCzToHuntLab(r.x, r.y, r.z), YCxCzToHuntLab(t.x, t.y, t.z)),
+					FlipColorExponent) / colorMax;
+				color = color < FlipRemapInput ?
+					color*FlipRemapOutput / FlipRemapInput :
+					FlipRemapOutput + (color - FlipRemapInput) / (1.0f - FlipRemapInput)*(1.0f - FlipRemapOutput);
+
+				// Edge strength of both images.
+				uint32_t left = x > 0 ? x - 1 : 0;
+				uint32_t right = (std::min)(x + 1, width - 1);
+				float edge[2];
+				for(int k = 0; k < 2; ++k)
+				{
+					const XMFLOAT4* f = filtered[k].data();
+					float gx = f[(size_t)y*width + right].w - f[(size_t)y*width + left].w;
+					float gy = f[(size_t)down*width + x].w - f[(size_t)up*width + x].w;
+					edge[k] = edgeScale*sqrtf(gx*gx + gy*gy);
+				}
+				float feature = powf((std::min)(1.0f, fabsf(edge[0] - edge[1]) / sqrtf(2.0f)), FlipFeatureExponent);
+
+				// Colour errors on differing edges stand out more.
+				float error = powf((std::min)(1.0f, color), 1.0f - feature);
+
+				if(map != nullptr)
+					(*map)[i] = error;
+				tileSum += error;
+			}
+		}
+		return tileSum;
+	});
+
+	return sum / count;
+}
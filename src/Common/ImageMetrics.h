@@ -0,0 +1,55 @@
+//***************************************************************************************
+// ImageMetrics.h
+//
+// Measures of how far a test image is from a reference image, to check that a
+// rewritten post-processing pass still produces what the old one did:
+//
+//   MeanSquaredError and Psnr: plain per-channel error.
+//   Ssim: structural similarity of the luminance (Wang et al., "Image Quality
+//     Assessment: From Error Visibility to Structural Similarity"), with the usual
+//     Gaussian window of sigma 1.5 pixels.
+//   Flip: a perceptual difference map after NVIDIA's FLIP (Andersson et al., "FLIP: A
+//     Difference Evaluator for Alternating Images").  The images are filtered the way
+//     the eye blurs colour at the given viewing distance, compared in a perceptual
+//     colour space, and the error is raised where the edges differ.  The eye's filters
+//     are approximated by Gaussians and only edges are compared, not points, so the
+//     numbers are close to FLIP's but not the same.
+//
+// Images are width x height texels, row by row, as DDSDecoder returns them.  Flip
+// takes its inputs as sRGB encoded colours in [0,1]; the other measures use the stored
+// values as they are.  The work is split into rows on a ThreadPool, and partial sums
+// are added in a fixed order, so the results do not depend on the thread count.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+namespace ImageMetrics
+{
+	// Mean of the squared differences of the RGB channels, and alpha if includeAlpha.
+	// pool defaults to ThreadPool::Default() here and below.
+	double MeanSquaredError(const DirectX::XMFLOAT4* reference, const DirectX::XMFLOAT4* test,
+		uint32_t width, uint32_t height, bool includeAlpha = false, ThreadPool* pool = nullptr);
+
+	// Peak signal to noise ratio in dB for a mean squared error; infinite for equal
+	// images.
+	double Psnr(double meanSquaredError, double peak = 1.0);
+
+	// Mean SSIM, 1 for equal images.  If map is not null it receives the SSIM of each
+	// pixel.
+	double Ssim(const DirectX::XMFLOAT4* reference, const DirectX::XMFLOAT4* test,
+		uint32_t width, uint32_t height, std::vector<float>* map = nullptr, ThreadPool* pool = nullptr);
+
+	// Mean perceptual difference in [0,1], 0 for equal images.  pixelsPerDegree is how
+	// many pixels cover one degree of the viewer's field of view; 67 is a 0.7 m wide
+	// 4K monitor seen from 0.7 m, the default of FLIP.  If map is not null it receives
+	// the difference of each pixel.
+	double Flip(const DirectX::XMFLOAT4* reference, const DirectX::XMFLOAT4* test,
+		uint32_t width, uint32_t height, float pixelsPerDegree = 67.0f,
+		std::vector<float>* map = nullptr, ThreadPool* pool = nullptr);
+}
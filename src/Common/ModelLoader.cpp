@@ -0,0 +1,474 @@
+//***************************************************************************************
+// ModelLoader.cpp
+//***************************************************************************************
+
+#include "ModelLoader.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t SidecarMagic = 0x4c444d4c; // "LMDL"
+
+	// Bump when the layout below changes, so old sidecars are remade.
+	const uint32_t SidecarVersion = 1;
+
+	// Followed by the positions, the normals and the indices.
+	struct SidecarHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t SourceSize;
+		int64_t SourceTime;
+		uint32_t VertexCount;
+		uint32_t IndexCount;
+		XMFLOAT3 BoundsCenter;
+		XMFLOAT3 BoundsExtents;
+	};
+
+	// Size and modification time of a file.
+	bool FileStamp(const std::string& filename, uint64_t& size, int64_t& time)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if(_stat64(filename.c_str(), &info) != 0)
+			return false;
+#else
+		struct stat info;
+		if(stat(filename.c_str(), &info) != 0)
+			return false;
+#endif
+		size = (uint64_t)info.st_size;
+		time = (int64_t)info.st_mtime;
+		return true;
+	}
+
+	// A read only view of a whole file.
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& filename)
+		{
+#ifdef _WIN32
+			mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if(mFile == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER size;
+			if(!GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+				return;
+
+			mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if(mMapping == nullptr)
+				return;
+
+			mData = static_cast<const uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+			if(mData != nullptr)
+				mSize = (size_t)size.QuadPart;
+#else
+			mFile = open(filename.c_str(), O_RDONLY);
+			if(mFile < 0)
+				return;
+
+			struct stat info;
+			if(fstat(mFile, &info) != 0 || info.st_size == 0)
+				return;
+
+			void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, mFile, 0);
+			if(data == MAP_FAILED)
+				return;
+
+			mData = static_cast<const uint8_t*>(data);
+			mSize = (size_t)info.st_size;
+#endif
+		}
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if(mData != nullptr)
+				UnmapViewOfFile(mData);
+			if(mMapping != nullptr)
+				CloseHandle(mMapping);
+			if(mFile != INVALID_HANDLE_VALUE)
+				CloseHandle(mFile);
+#else
+			if(mData != nullptr)
+				munmap(const_cast<uint8_t*>(mData), mSize);
+			if(mFile >= 0)
+				close(mFile);
+#endif
+		}
+
+		MappedFile(const MappedFile& rhs) = delete;
+		MappedFile& operator=(const MappedFile& rhs) = delete;
+
+		const uint8_t* Data()const { return mData; }
+		size_t Size()const { return mSize; }
+
+	private:
+#ifdef _WIN32
+		HANDLE mFile = INVALID_HANDLE_VALUE;
+		HANDLE mMapping = nullptr;
+#else
+		int mFile = -1;
+#endif
+		const uint8_t* mData = nullptr;
+		size_t mSize = 0;
+	};
+
+	// Scans the numbers and labels of the text format.  Every read skips leading
+	// white space and fails at the end of the text.
+	class Scanner
+	{
+	public:
+		Scanner(const char* text, size_t size) : mPos(text), mEnd(text + size) {}
+
+		// Skips a run of anything but white space: a label or a brace.
+		bool SkipWord()
+		{
+			SkipSpace();
+			const char* start = mPos;
+			while(mPos < mEnd && !IsSpace(*mPos))
+				++mPos;
+			return mPos != start;
+		}
+
+		bool ReadUInt(uint32_t& value)
+		{
+			SkipSpace();
+			const char* start = mPos;
+			uint64_t result = 0;
+			while(mPos < mEnd && IsDigit(*mPos) && result <= 0xffffffffu)
+				result = result*10 + (uint32_t)(*mPos++ - '0');
+
+			value = (uint32_t)result;
+			return mPos != start && result <= 0xffffffffu;
+		}
+
+		bool ReadInt(int32_t& value)
+		{
+			SkipSpace();
+			bool negative = mPos < mEnd && *mPos == '-';
+			if(negative)
+				++mPos;
+
+			uint32_t magnitude;
+			if(!ReadUIntNoSpace(magnitude) || magnitude > 0x7fffffffu + (negative ? 1u : 0u))
+				return false;
+
+			value = negative ? (int32_t)(0u - magnitude) : (int32_t)magnitude;
+			return true;
+		}
+
+		// Decimal floats with an optional sign, fraction and exponent.  Up to 15
+		// significant digits and a power of ten within +-22, the value is one correctly
+		// rounded double division or product; anything else goes to strtof.
+		bool ReadFloat(float& value)
+		{
+			SkipSpace();
+			const char* start = mPos;
+
+			bool negative = false;
+			if(mPos < mEnd && (*mPos == '-' || *mPos == '+'))
+				negative = *mPos++ == '-';
+
+			uint64_t mantissa = 0;
+			int digits = 0;
+			int exponent = 0;
+			bool any = false;
+
+			while(mPos < mEnd && IsDigit(*mPos))
+			{
+				Accumulate(*mPos++, mantissa, digits, exponent, false);
+				any = true;
+			}
+			if(mPos < mEnd && *mPos == '.')
+			{
+				++mPos;
+				while(mPos < mEnd && IsDigit(*mPos))
+				{
+					Accumulate(*mPos++, mantissa, digits, exponent, true);
+					any = true;
+				}
+			}
+			if(!any)
+				return false;
+
+			if(mPos < mEnd && (*mPos == 'e' || *mPos == 'E'))
+			{
+				++mPos;
+				bool negativeExponent = false;
+				if(mPos < mEnd && (*mPos == '-' || *mPos == '+'))
+					negativeExponent = *mPos++ == '-';
+
+				uint32_t e;
+				if(!ReadUIntNoSpace(e))
+					return false;
+				exponent += negativeExponent ? -(int)(std::min)(e, 9999u) : (int)(std::min)(e, 9999u);
+			}
+
+			if(digits > 15 || exponent < -22 || exponent > 22)
+				return ReadFloatSlow(start, value);
+
+			double result = (double)mantissa;
+			if(exponent < 0)
+				result /= Pow10[-exponent];
+			else
+				result *= Pow10[exponent];
+
+			value = (float)(negative ? -result : result);
+			return true;
+		}
+
+	private:
+		static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; }
+		static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+		void SkipSpace()
+		{
+			while(mPos < mEnd && IsSpace(*mPos))
+				++mPos;
+		}
+
+		bool ReadUIntNoSpace(uint32_t& value)
+		{
+			return (mPos < mEnd && IsDigit(*mPos)) && ReadUInt(value);
+		}
+
+		// Leading zeros don't count as significant digits; fraction digits move the
+		// exponent down.
+		static void Accumulate(char c, uint64_t& mantissa, int& digits, int& exponent, bool fraction)
+		{
+			if(mantissa == 0 && c == '0')
+			{
+				if(fraction)
+					--exponent;
+				return;
+			}
+
+			if(digits < 19)
+			{
+				mantissa = mantissa*10 + (uint64_t)(c - '0');
+				if(fraction)
+					--exponent;
+			}
+			else if(!fraction)
+			{
+				++exponent;
+			}
+			++digits;
+		}
+
+		// strtof on a copy of the token, which isn't null terminated in the text.
+		bool ReadFloatSlow(const char* start, float& value)
+		{
+			char token[64];
+			size_t length = (size_t)(mPos - start);
+			if(length >= sizeof(token))
+				return false;
+
+			std::memcpy(token, start, length);
+			token[length] = '\0';
+			value = strtof(token, nullptr);
+			return true;
+		}
+
+		static const double Pow10[23];
+
+		const char* mPos;
+		const char* mEnd;
+	};
+
+	const double Scanner::Pow10[23] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	void ComputeBounds(ModelData& model)
+	{
+		XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+		for(const XMFLOAT3& p : model.Positions)
+		{
+			XMVECTOR P = XMLoadFloat3(&p);
+			vMin = XMVectorMin(vMin, P);
+			vMax = XMVectorMax(vMax, P);
+		}
+
+		if(model.Positions.empty())
+			vMin = vMax = XMVectorZero();
+
+		XMStoreFloat3(&model.Bounds.Center, XMVectorScale(XMVectorAdd(vMin, vMax), 0.5f));
+		XMStoreFloat3(&model.Bounds.Extents, XMVectorScale(XMVectorSubtract(vMax, vMin), 0.5f));
+	}
+}
+
+std::string ModelLoader::SidecarName(const std::string& filename)
+{
+	return filename + ".bin";
+}
+
+bool ModelLoader::ParseText(const char* text, size_t size, ModelData& model)
+{
+	Scanner scanner(text, size);
+
+	// "VertexCount: n TriangleCount: m VertexList (pos, normal) {"
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+	if(!scanner.SkipWord() || !scanner.ReadUInt(vertexCount) ||
+		!scanner.SkipWord() || !scanner.ReadUInt(triangleCount))
+		return false;
+
+	for(int i = 0; i < 4; ++i)
+	{
+		if(!scanner.SkipWord())
+			return false;
+	}
+
+	// Counts past what the text could hold are a damaged header, not a huge model.
+	if(vertexCount > size / 12 || triangleCount > size / 6)
+		return false;
+
+	model.Positions.resize(vertexCount);
+	model.Normals.resize(vertexCount);
+	for(uint32_t i = 0; i < vertexCount; ++i)
+	{
+		XMFLOAT3& p = model.Positions[i];
+		XMFLOAT3& n = model.Normals[i];
+		if(!scanner.ReadFloat(p.x) || !scanner.ReadFloat(p.y) || !scanner.ReadFloat(p.z) ||
+			!scanner.ReadFloat(n.x) || !scanner.ReadFloat(n.y) || !scanner.ReadFloat(n.z))
+			return false;
+	}
+
+	// "} TriangleList {"
+	for(int i = 0; i < 3; ++i)
+	{
+		if(!scanner.SkipWord())
+			return false;
+	}
+
+	model.Indices.resize((size_t)3*triangleCount);
+	for(int32_t& index : model.Indices)
+	{
+		if(!scanner.ReadInt(index))
+			return false;
+	}
+
+	ComputeBounds(model);
+	return true;
+}
+
+bool ModelLoader::LoadText(const std::string& filename, ModelData& model)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if(!file.is_open())
+		return false;
+
+	std::streamoff size = file.tellg();
+	if(size <= 0)
+		return false;
+
+	std::vector<char> text((size_t)size);
+	file.seekg(0, std::ios::beg);
+	file.read(text.data(), size);
+	if(!file)
+		return false;
+
+	return ParseText(text.data(), text.size(), model);
+}
+
+bool ModelLoader::LoadSidecar(const std::string& filename, ModelData& model)
+{
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if(!FileStamp(filename, sourceSize, sourceTime))
+		return false;
+
+	MappedFile file(SidecarName(filename));
+	if(file.Data() == nullptr || file.Size() < sizeof(SidecarHeader))
+		return false;
+
+	SidecarHeader header;
+	std::memcpy(&header, file.Data(), sizeof(header));
+	if(header.Magic != SidecarMagic || header.Version != SidecarVersion ||
+		header.SourceSize != sourceSize || header.SourceTime != sourceTime)
+		return false;
+
+	const size_t vertexBytes = (size_t)header.VertexCount*sizeof(XMFLOAT3);
+	const size_t indexBytes = (size_t)header.IndexCount*sizeof(int32_t);
+	if(file.Size() != sizeof(SidecarHeader) + 2*vertexBytes + indexBytes)
+		return false;
+
+	const uint8_t* data = file.Data() + sizeof(SidecarHeader);
+	model.Positions.resize(header.VertexCount);
+	model.Normals.resize(header.VertexCount);
+	model.Indices.resize(header.IndexCount);
+	std::memcpy(model.Positions.data(), data, vertexBytes);
+	std::memcpy(model.Normals.data(), data + vertexBytes, vertexBytes);
+	std::memcpy(model.Indices.data(), data + 2*vertexBytes, indexBytes);
+	model.Bounds.Center = header.BoundsCenter;
+	model.Bounds.Extents = header.BoundsExtents;
+	return true;
+}
+
+bool ModelLoader::SaveSidecar(const std::string& filename, const ModelData& model)
+{
+	SidecarHeader header = {};
+	header.Magic = SidecarMagic;
+	header.Version = SidecarVersion;
+	if(!FileStamp(filename, header.SourceSize, header.SourceTime))
+		return false;
+	header.VertexCount = (uint32_t)model.Positions.size();
+	header.IndexCount = (uint32_t)model.Indices.size();
+	header.BoundsCenter = model.Bounds.Center;
+	header.BoundsExtents = model.Bounds.Extents;
+
+	std::ofstream file(SidecarName(filename), std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+		return false;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(model.Positions.data()), model.Positions.size()*sizeof(XMFLOAT3));
+	file.write(reinterpret_cast<const char*>(model.Normals.data()), model.Normals.size()*sizeof(XMFLOAT3));
+	file.write(reinterpret_cast<const char*>(model.Indices.data()), model.Indices.size()*sizeof(int32_t));
+	return (bool)file;
+}
+
+bool ModelLoader::Load(const std::string& filename, ModelData& model, Source* source)
+{
+	if(LoadSidecar(filename, model))
+	{
+		if(source != nullptr)
+			*source = Source::Sidecar;
+		return true;
+	}
+
+	if(!LoadText(filename, model))
+		return false;
+
+	// A half written sidecar fails its size check next time, so a failure here needs
+	// no cleanup.
+	SaveSidecar(filename, model);
+
+	if(source != nullptr)
+		*source = Source::Text;
+	return true;
+}
@@ -0,0 +1,70 @@
+//***************************************************************************************
+// ModelLoader.h
+//
+// Loads the chapter models (Models/skull.txt, Models/car.txt), which are text:
+//
+//   VertexCount: n
+//   TriangleCount: m
+//   VertexList (pos, normal)
+//   {
+//       px py pz nx ny nz        n lines
+//   }
+//   TriangleList
+//   {
+//       i0 i1 i2                 m lines
+//   }
+//
+// Reading the skull's 2.8 MB with iostream extraction took most of the samples'
+// startup.  This reads the file whole and scans it with a number parser of its own.
+// Numbers whose digits fit a double exactly take one double operation and a rounding
+// to float; the rest go to strtof.  The ModelLoader module tests check that both
+// models come out bit for bit as iostream reads them.
+//
+// Load also writes a binary sidecar next to the text the first time, e.g.
+// Models/skull.txt.bin, holding the arrays and the bounds, and later loads map that
+// file and copy the arrays straight out.  The sidecar records the size and time of
+// the text it was made from and is remade when either changes.  Failing to write it
+// (a read only folder) is not an error; the model is parsed from text each time.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ModelData
+{
+	std::vector<DirectX::XMFLOAT3> Positions;
+	std::vector<DirectX::XMFLOAT3> Normals;
+
+	// Three per triangle.
+	std::vector<std::int32_t> Indices;
+
+	// Axis aligned bounds of the positions.
+	DirectX::BoundingBox Bounds;
+};
+
+namespace ModelLoader
+{
+	enum class Source
+	{
+		Text,
+		Sidecar
+	};
+
+	// Loads from the sidecar when it is up to date, and otherwise parses the text and
+	// writes the sidecar.  source, if given, says which was read.
+	bool Load(const std::string& filename, ModelData& model, Source* source = nullptr);
+
+	// Parses the text alone; no sidecar is read or written.
+	bool LoadText(const std::string& filename, ModelData& model);
+	bool ParseText(const char* text, size_t size, ModelData& model);
+
+	// Reads the sidecar of filename, failing when it is missing, stale or damaged.
+	bool LoadSidecar(const std::string& filename, ModelData& model);
+	bool SaveSidecar(const std::string& filename, const ModelData& model);
+
+	std::string SidecarName(const std::string& filename);
+}
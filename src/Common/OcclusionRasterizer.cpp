@@ -0,0 +1,490 @@
+//***************************************************************************************
+// OcclusionRasterizer.cpp
+//***************************************************************************************
+
+#include "OcclusionRasterizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Vertices transformed, or triangles set up, per parallel task.
+	const uint32_t ChunkSize = 4096;
+
+	XMFLOAT4 Lerp(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+	{
+		return XMFLOAT4(
+			a.x + (b.x - a.x)*t,
+			a.y + (b.y - a.y)*t,
+			a.z + (b.z - a.z)*t,
+			a.w + (b.w - a.w)*t);
+	}
+}
+
+void OcclusionRasterizer::Resize(uint32_t width, uint32_t height)
+{
+	mWidth = (std::max)(width, 1u);
+	mHeight = (std::max)(height, 1u);
+
+	mBinsX = (mWidth + BinSize - 1) / BinSize;
+	mBinsY = (mHeight + BinSize - 1) / BinSize;
+	mBufferWidth = mBinsX * BinSize;
+	mBufferHeight = mBinsY * BinSize;
+	mBins.assign(mBinsX * mBinsY, std::vector<uint32_t>());
+
+	mLevels.clear();
+	mLevelWidth.clear();
+	mLevelHeight.clear();
+
+	uint32_t w = mBufferWidth;
+	uint32_t h = mBufferHeight;
+	for(;;)
+	{
+		mLevels.push_back(std::vector<float>((size_t)w * h, 1.0f));
+		mLevelWidth.push_back(w);
+		mLevelHeight.push_back(h);
+
+		if(w == 1 && h == 1)
+			break;
+
+		w = (w + 1) / 2;
+		h = (h + 1) / 2;
+	}
+}
+
+void OcclusionRasterizer::Clear()
+{
+	mOccluders.clear();
+	mTriangles.clear();
+
+	for(auto& level : mLevels)
+		std::fill(level.begin(), level.end(), 1.0f);
+}
+
+void OcclusionRasterizer::AddOccluder(const void* positions, uint32_t vertexStride, uint32_t vertexCount,
+	const uint32_t* indices, uint32_t indexCount, FXMMATRIX worldViewProj)
+{
+	Occluder occluder;
+	occluder.Positions = static_cast<const uint8_t*>(positions);
+	occluder.VertexStride = vertexStride;
+	occluder.VertexCount = vertexCount;
+	occluder.Indices = indices;
+	occluder.IndexCount = indexCount - indexCount % 3;
+	XMStoreFloat4x4(&occluder.WorldViewProj, worldViewProj);
+
+	mOccluders.push_back(occluder);
+}
+
+void OcclusionRasterizer::SetupTriangles()
+{
+	size_t occluderCount = mOccluders.size();
+
+	// Offsets of each occluder's vertices and triangles in the flattened lists.
+	std::vector<size_t> vertexOffset(occluderCount + 1, 0);
+	std::vector<size_t> triangleOffset(occluderCount + 1, 0);
+	for(size_t i = 0; i < occluderCount; ++i)
+	{
+		vertexOffset[i + 1] = vertexOffset[i] + mOccluders[i].VertexCount;
+		triangleOffset[i + 1] = triangleOffset[i] + mOccluders[i].IndexCount / 3;
+	}
+
+	// Finds the occluder holding flattened element i.
+	auto findOccluder = [](const std::vector<size_t>& offsets, size_t i)
+	{
+		return (size_t)(std::upper_bound(offsets.begin(), offsets.end(), i) - offsets.begin()) - 1;
+	};
+
+	size_t vertexCount = vertexOffset[occluderCount];
+	mClipVertices.resize(vertexCount);
+
+	uint32_t vertexChunks = (uint32_t)((vertexCount + ChunkSize - 1) / ChunkSize);
+	concurrency::parallel_for(0u, vertexChunks, [&](uint32_t chunk)
+	{
+		size_t first = (size_t)chunk * ChunkSize;
+		size_t last = (std::min)(first + ChunkSize, vertexCount);
+
+		size_t o = findOccluder(vertexOffset, first);
+		while(first < last)
+		{
+			// Skip occluders without vertices.
+			while(vertexOffset[o + 1] <= first)
+				++o;
+
+			const Occluder& occluder = mOccluders[o];
+			XMMATRIX worldViewProj = XMLoadFloat4x4(&occluder.WorldViewProj);
+
+			size_t end = (std::min)(last, vertexOffset[o + 1]);
+			for(size_t i = first; i < end; ++i)
+			{
+				const XMFLOAT3* p = reinterpret_cast<const XMFLOAT3*>(
+					occluder.Positions + (i - vertexOffset[o]) * occluder.VertexStride);
+				XMStoreFloat4(&mClipVertices[i], XMVector3Transform(XMLoadFloat3(p), worldViewProj));
+			}
+
+			first = end;
+		}
+	});
+
+	size_t triangleCount = triangleOffset[occluderCount];
+	uint32_t triangleChunks = (uint32_t)((triangleCount + ChunkSize - 1) / ChunkSize);
+	std::vector<std::vector<Triangle>> chunkTriangles(triangleChunks);
+
+	concurrency::parallel_for(0u, triangleChunks, [&](uint32_t chunk)
+	{
+		size_t first = (size_t)chunk * ChunkSize;
+		size_t last = (std::min)(first + ChunkSize, triangleCount);
+
+		std::vector<Triangle>& out = chunkTriangles[chunk];
+		out.reserve(last - first);
+
+		size_t o = findOccluder(triangleOffset, first);
+		while(first < last)
+		{
+			while(triangleOffset[o + 1] <= first)
+				++o;
+
+			const Occluder& occluder = mOccluders[o];
+			const XMFLOAT4* clip = mClipVertices.data() + vertexOffset[o];
+
+			size_t end = (std::min)(last, triangleOffset[o + 1]);
+			for(size_t t = first; t < end; ++t)
+			{
+				const uint32_t* tri = occluder.Indices + (t - triangleOffset[o]) * 3;
+				if(tri[0] >= occluder.VertexCount || tri[1] >= occluder.VertexCount || tri[2] >= occluder.VertexCount)
+					continue;
+
+				ClipAndSetup(clip[tri[0]], clip[tri[1]], clip[tri[2]], out);
+			}
+
+			first = end;
+		}
+	});
+
+	mTriangles.clear();
+	for(const auto& out : chunkTriangles)
+		mTriangles.insert(mTriangles.end(), out.begin(), out.end());
+}
+
+void OcclusionRasterizer::ClipAndSetup(const XMFLOAT4& v0, const XMFLOAT4& v1, const XMFLOAT4& v2,
+	std::vector<Triangle>& out)const
+{
+	// Entirely outside one of the frustum planes.
+	if((v0.x > v0.w && v1.x > v1.w && v2.x > v2.w) ||
+	   (v0.x < -v0.w && v1.x < -v1.w && v2.x < -v2.w) ||
+	   (v0.y > v0.w && v1.y > v1.w && v2.y > v2.w) ||
+	   (v0.y < -v0.w && v1.y < -v1.w && v2.y < -v2.w) ||
+	   (v0.z > v0.w && v1.z > v1.w && v2.z > v2.w) ||
+	   (v0.z < 0.0f && v1.z < 0.0f && v2.z < 0.0f))
+		return;
+
+	if(v0.z >= 0.0f && v1.z >= 0.0f && v2.z >= 0.0f)
+	{
+		XMFLOAT4 clip[3] = { v0, v1, v2 };
+		SetupTriangle(clip, out);
+		return;
+	}
+
+	// Clip against the near plane z = 0.  One vertex behind it leaves a quad, two
+	// leave a triangle.
+	const XMFLOAT4* in[3] = { &v0, &v1, &v2 };
+	XMFLOAT4 polygon[4];
+	int count = 0;
+	for(int i = 0; i < 3; ++i)
+	{
+		const XMFLOAT4& a = *in[i];
+		const XMFLOAT4& b = *in[(i + 1) % 3];
+
+		if(a.z >= 0.0f)
+			polygon[count++] = a;
+
+		if((a.z >= 0.0f) != (b.z >= 0.0f))
+			polygon[count++] = Lerp(a, b, a.z / (a.z - b.z));
+	}
+
+	for(int i = 1; i + 1 < count; ++i)
+	{
+		XMFLOAT4 clip[3] = { polygon[0], polygon[i], polygon[i + 1] };
+		SetupTriangle(clip, out);
+	}
+}
+
+void OcclusionRasterizer::SetupTriangle(const XMFLOAT4 clip[3], std::vector<Triangle>& out)const
+{
+	float x[3], y[3], z[3];
+	for(int i = 0; i < 3; ++i)
+	{
+		float invW = 1.0f / clip[i].w;
+		x[i] = (clip[i].x*invW*0.5f + 0.5f)*mWidth;
+		y[i] = (0.5f - clip[i].y*invW*0.5f)*mHeight;
+		z[i] = clip[i].z*invW;
+	}
+
+	// Twice the signed area; positive for a clockwise triangle with y pointing down.
+	// Back faces, degenerate triangles and NaNs all fail the test.
+	float area = (x[1] - x[0])*(y[2] - y[0]) - (x[2] - x[0])*(y[1] - y[0]);
+	if(!(area > 0.0f))
+		return;
+
+	// Pixels whose centers can be inside.  Clamp before converting, the projected
+	// positions of triangles near the camera can be far off screen.
+	float minX = (std::min)((std::min)(x[0], x[1]), x[2]) - 0.5f;
+	float maxX = (std::max)((std::max)(x[0], x[1]), x[2]) - 0.5f;
+	float minY = (std::min)((std::min)(y[0], y[1]), y[2]) - 0.5f;
+	float maxY = (std::max)((std::max)(y[0], y[1]), y[2]) - 0.5f;
+
+	Triangle tri;
+	tri.MinX = (int)std::ceil((std::max)(minX, 0.0f));
+	tri.MinY = (int)std::ceil((std::max)(minY, 0.0f));
+	tri.MaxX = (int)std::floor((std::min)(maxX, (float)mWidth - 1.0f));
+	tri.MaxY = (int)std::floor((std::min)(maxY, (float)mHeight - 1.0f));
+
+	// Small triangles between pixel centers cover nothing.
+	if(tri.MinX > tri.MaxX || tri.MinY > tri.MaxY)
+		return;
+
+	// Edge k runs from vertex k to vertex k+1 and is zero on that edge and equal to
+	// area at the opposite vertex.
+	for(int k = 0; k < 3; ++k)
+	{
+		int j = (k + 1) % 3;
+		tri.EdgeA[k] = y[k] - y[j];
+		tri.EdgeB[k] = x[j] - x[k];
+		tri.EdgeC[k] = -(tri.EdgeA[k]*x[k] + tri.EdgeB[k]*y[k]);
+	}
+
+	// The barycentric weight of vertex 1 is edge 2 over the area, of vertex 2 edge 0.
+	float invArea = 1.0f / area;
+	float dz1 = (z[1] - z[0])*invArea;
+	float dz2 = (z[2] - z[0])*invArea;
+	tri.DepthA = dz1*tri.EdgeA[2] + dz2*tri.EdgeA[0];
+	tri.DepthB = dz1*tri.EdgeB[2] + dz2*tri.EdgeB[0];
+	tri.DepthC = z[0] + dz1*tri.EdgeC[2] + dz2*tri.EdgeC[0];
+
+	out.push_back(tri);
+}
+
+void OcclusionRasterizer::RasterizeTriangle(const Triangle& tri, int minX, int minY, int maxX, int maxY)
+{
+	float* depth = mLevels[0].data();
+
+	// Groups of four start on multiples of four.  Bins are multiples of four wide, so
+	// a group never crosses into another thread's bin, and the binned and serial paths
+	// evaluate exactly the same pixels.
+	int startX = minX & ~3;
+	XMVECTOR startPx = XMVectorAdd(XMVectorReplicate((float)startX), XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f));
+	XMVECTOR step = XMVectorReplicate(4.0f);
+
+	XMVECTOR a0 = XMVectorReplicate(tri.EdgeA[0]);
+	XMVECTOR a1 = XMVectorReplicate(tri.EdgeA[1]);
+	XMVECTOR a2 = XMVectorReplicate(tri.EdgeA[2]);
+	XMVECTOR depthA = XMVectorReplicate(tri.DepthA);
+	XMVECTOR zero = XMVectorZero();
+
+	for(int y = minY; y <= maxY; ++y)
+	{
+		float py = (float)y + 0.5f;
+		XMVECTOR row0 = XMVectorReplicate(tri.EdgeB[0]*py + tri.EdgeC[0]);
+		XMVECTOR row1 = XMVectorReplicate(tri.EdgeB[1]*py + tri.EdgeC[1]);
+		XMVECTOR row2 = XMVectorReplicate(tri.EdgeB[2]*py + tri.EdgeC[2]);
+		XMVECTOR rowDepth = XMVectorReplicate(tri.DepthB*py + tri.DepthC);
+
+		float* depthRow = depth + (size_t)y * mBufferWidth;
+
+		XMVECTOR px = startPx;
+		for(int x = startX; x <= maxX; x += 4)
+		{
+			XMVECTOR e0 = XMVectorMultiplyAdd(a0, px, row0);
+			XMVECTOR e1 = XMVectorMultiplyAdd(a1, px, row1);
+			XMVECTOR e2 = XMVectorMultiplyAdd(a2, px, row2);
+
+			XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(
+				XMVectorGreaterOrEqual(e0, zero),
+				XMVectorGreaterOrEqual(e1, zero)),
+				XMVectorGreaterOrEqual(e2, zero));
+
+			if(XMVector4NotEqualInt(inside, zero))
+			{
+				XMFLOAT4* dst = reinterpret_cast<XMFLOAT4*>(depthRow + x);
+				XMVECTOR current = XMLoadFloat4(dst);
+				XMVECTOR z = XMVectorMultiplyAdd(depthA, px, rowDepth);
+				XMStoreFloat4(dst, XMVectorSelect(current, XMVectorMin(current, z), inside));
+			}
+
+			px = XMVectorAdd(px, step);
+		}
+	}
+}
+
+void OcclusionRasterizer::Rasterize()
+{
+	std::fill(mLevels[0].begin(), mLevels[0].end(), 1.0f);
+
+	SetupTriangles();
+
+	for(auto& bin : mBins)
+		bin.clear();
+
+	for(uint32_t i = 0; i < (uint32_t)mTriangles.size(); ++i)
+	{
+		const Triangle& tri = mTriangles[i];
+		for(uint32_t by = tri.MinY / BinSize; by <= tri.MaxY / BinSize; ++by)
+		{
+			for(uint32_t bx = tri.MinX / BinSize; bx <= tri.MaxX / BinSize; ++bx)
+				mBins[by*mBinsX + bx].push_back(i);
+		}
+	}
+
+	concurrency::parallel_for(0u, (uint32_t)mBins.size(), [&](uint32_t b)
+	{
+		int binMinX = (int)((b % mBinsX) * BinSize);
+		int binMinY = (int)((b / mBinsX) * BinSize);
+		int binMaxX = binMinX + (int)BinSize - 1;
+		int binMaxY = binMinY + (int)BinSize - 1;
+
+		for(uint32_t i : mBins[b])
+		{
+			const Triangle& tri = mTriangles[i];
+			RasterizeTriangle(tri,
+				(std::max)(tri.MinX, binMinX), (std::max)(tri.MinY, binMinY),
+				(std::min)(tri.MaxX, binMaxX), (std::min)(tri.MaxY, binMaxY));
+		}
+	});
+
+	BuildPyramid();
+}
+
+void OcclusionRasterizer::RasterizeSerial()
+{
+	std::fill(mLevels[0].begin(), mLevels[0].end(), 1.0f);
+
+	SetupTriangles();
+
+	for(const Triangle& tri : mTriangles)
+		RasterizeTriangle(tri, tri.MinX, tri.MinY, tri.MaxX, tri.MaxY);
+
+	BuildPyramid();
+}
+
+void OcclusionRasterizer::BuildPyramid()
+{
+	for(size_t level = 1; level < mLevels.size(); ++level)
+	{
+		const float* src = mLevels[level - 1].data();
+		float* dst = mLevels[level].data();
+
+		uint32_t srcWidth = mLevelWidth[level - 1];
+		uint32_t srcHeight = mLevelHeight[level - 1];
+
+		for(uint32_t y = 0; y < mLevelHeight[level]; ++y)
+		{
+			const float* row0 = src + (size_t)(2 * y) * srcWidth;
+			const float* row1 = src + (size_t)(std::min)(2 * y + 1, srcHeight - 1) * srcWidth;
+
+			for(uint32_t x = 0; x < mLevelWidth[level]; ++x)
+			{
+				uint32_t x0 = 2 * x;
+				uint32_t x1 = (std::min)(x0 + 1, srcWidth - 1);
+				dst[(size_t)y * mLevelWidth[level] + x] =
+					(std::max)((std::max)(row0[x0], row0[x1]), (std::max)(row1[x0], row1[x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionRasterizer::IsVisible(const BoundingBox& box, FXMMATRIX viewProj, bool fullResolution)const
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+
+	XMVECTOR ndcMin = XMVectorReplicate(+FLT_MAX);
+	XMVECTOR ndcMax = XMVectorReplicate(-FLT_MAX);
+	for(size_t i = 0; i < BoundingBox::CORNER_COUNT; ++i)
+	{
+		XMVECTOR p = XMVector3Transform(XMLoadFloat3(&corners[i]), viewProj);
+
+		// The box reaches in front of the near plane and cannot be projected.
+		if(XMVectorGetZ(p) < 0.0f)
+			return true;
+
+		p = XMVectorDivide(p, XMVectorSplatW(p));
+		ndcMin = XMVectorMin(ndcMin, p);
+		ndcMax = XMVectorMax(ndcMax, p);
+	}
+
+	XMFLOAT3 minP, maxP;
+	XMStoreFloat3(&minP, ndcMin);
+	XMStoreFloat3(&maxP, ndcMax);
+
+	return IsRectVisible(minP.x, minP.y, maxP.x, maxP.y, minP.z, fullResolution);
+}
+
+bool OcclusionRasterizer::IsVisible(const BoundingSphere& sphere, FXMMATRIX viewProj)const
+{
+	BoundingBox box(sphere.Center, XMFLOAT3(sphere.Radius, sphere.Radius, sphere.Radius));
+	return IsVisible(box, viewProj);
+}
+
+void OcclusionRasterizer::TestBoxes(const BoundingBox* boxes, size_t count, FXMMATRIX viewProj, uint8_t* visible)const
+{
+	XMFLOAT4X4 viewProjF;
+	XMStoreFloat4x4(&viewProjF, viewProj);
+
+	const uint32_t boxesPerTask = 256;
+	uint32_t taskCount = (uint32_t)((count + boxesPerTask - 1) / boxesPerTask);
+	concurrency::parallel_for(0u, taskCount, [&](uint32_t task)
+	{
+		XMMATRIX m = XMLoadFloat4x4(&viewProjF);
+
+		size_t first = (size_t)task * boxesPerTask;
+		size_t last = (std::min)(first + boxesPerTask, count);
+		for(size_t i = first; i < last; ++i)
+			visible[i] = IsVisible(boxes[i], m) ? 1 : 0;
+	});
+}
+
+bool OcclusionRasterizer::IsRectVisible(float minX, float minY, float maxX, float maxY, float minZ, bool fullResolution)const
+{
+	// Off screen or beyond the far plane.
+	if(maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f || minZ > 1.0f)
+		return false;
+
+	if(mLevels.empty())
+		return true;
+
+	// Every pixel the rectangle touches, not just those whose centers it covers.
+	float sx0 = (minX*0.5f + 0.5f)*mWidth;
+	float sx1 = (maxX*0.5f + 0.5f)*mWidth;
+	float sy0 = (0.5f - maxY*0.5f)*mHeight;
+	float sy1 = (0.5f - minY*0.5f)*mHeight;
+
+	uint32_t x0 = (uint32_t)(std::max)(sx0, 0.0f);
+	uint32_t x1 = (uint32_t)(std::min)(sx1, (float)mWidth - 1.0f);
+	uint32_t y0 = (uint32_t)(std::max)(sy0, 0.0f);
+	uint32_t y1 = (uint32_t)(std::min)(sy1, (float)mHeight - 1.0f);
+
+	// The finest level where the rectangle spans at most 4x4 texels.
+	size_t level = 0;
+	if(!fullResolution)
+	{
+		while(level + 1 < mLevels.size() &&
+			((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+			++level;
+	}
+
+	const float* depth = mLevels[level].data();
+	uint32_t pitch = mLevelWidth[level];
+	for(uint32_t y = y0 >> level; y <= (y1 >> level); ++y)
+	{
+		for(uint32_t x = x0 >> level; x <= (x1 >> level); ++x)
+		{
+			if(depth[(size_t)y * pitch + x] >= minZ)
+				return true;
+		}
+	}
+
+	return false;
+}
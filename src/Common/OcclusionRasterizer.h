@@ -0,0 +1,121 @@
+//***************************************************************************************
+// OcclusionRasterizer.h
+//
+// Software depth rasterizer for occlusion culling on the CPU.  A few occluder meshes
+// are rasterized into a small depth buffer, and the bounds of instances or meshlets
+// are tested against a max-depth pyramid built from it.
+//
+// The screen is split into 32x32 pixel bins.  Triangles are clipped to the near
+// plane, back faces are culled, and each remaining triangle is set up once and listed
+// in every bin it overlaps.  Bins are then rasterized in parallel, four pixels at a
+// time with DirectXMath, so no two threads touch the same pixel.
+//
+// Depth is post-projection z/w, 0 at the near plane, cleared to 1.  Coverage is
+// sampled at pixel centers like the GPU does.  A query reports a box hidden only if
+// every depth texel its screen rectangle touches is nearer than the box's nearest
+// point, so the answer is conservative with respect to the rasterized depth.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class OcclusionRasterizer
+{
+public:
+	// The depth buffer is padded to whole bins; queries only use width x height.
+	void Resize(uint32_t width, uint32_t height);
+
+	// Forgets the queued occluders and clears depth, so nothing is hidden.
+	void Clear();
+
+	// Queues a triangle list for the next Rasterize.  positions points at the first vertex
+	// position, vertexStride bytes apart.  The data must stay valid until Rasterize returns.
+	// Front faces are clockwise, as in the default D3D12 rasterizer state.
+	void AddOccluder(const void* positions, uint32_t vertexStride, uint32_t vertexCount,
+		const uint32_t* indices, uint32_t indexCount, DirectX::FXMMATRIX worldViewProj);
+
+	// Clears depth, rasterizes the queued occluders on worker threads and builds the
+	// depth pyramid.
+	void Rasterize();
+
+	// Same result on the calling thread, one whole triangle at a time, without bins.
+	// Used to check the binned path.
+	void RasterizeSerial();
+
+	// False if the box or sphere is behind the occluders or off screen.  fullResolution
+	// reads every depth texel under the box instead of a coarse pyramid level; it is
+	// slower and only hides more, and is used to check the pyramid.
+	bool IsVisible(const DirectX::BoundingBox& box, DirectX::FXMMATRIX viewProj, bool fullResolution = false)const;
+	bool IsVisible(const DirectX::BoundingSphere& sphere, DirectX::FXMMATRIX viewProj)const;
+
+	// IsVisible for many world space boxes, split across worker threads.  visible
+	// receives 1 or 0 per box.
+	void TestBoxes(const DirectX::BoundingBox* boxes, size_t count, DirectX::FXMMATRIX viewProj, uint8_t* visible)const;
+
+	uint32_t Width()const { return mWidth; }
+	uint32_t Height()const { return mHeight; }
+
+	// Triangles that reached the rasterizer in the last Rasterize, after clipping and culling.
+	uint32_t TriangleCount()const { return (uint32_t)mTriangles.size(); }
+
+	// Full resolution depth, DepthPitch() floats per row.
+	const float* GetDepth()const { return mLevels.empty() ? nullptr : mLevels[0].data(); }
+	uint32_t DepthPitch()const { return mBufferWidth; }
+
+private:
+	struct Occluder
+	{
+		const uint8_t* Positions = nullptr;
+		uint32_t VertexStride = 0;
+		uint32_t VertexCount = 0;
+		const uint32_t* Indices = nullptr;
+		uint32_t IndexCount = 0;
+		DirectX::XMFLOAT4X4 WorldViewProj;
+	};
+
+	struct Triangle
+	{
+		// Edge functions A*x + B*y + C, positive inside, and depth as a plane in x and y.
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float DepthA, DepthB, DepthC;
+
+		// Pixels whose centers may be covered, inclusive, clamped to the screen.
+		int MinX, MinY, MaxX, MaxY;
+	};
+
+	void SetupTriangles();
+	void SetupTriangle(const DirectX::XMFLOAT4 clip[3], std::vector<Triangle>& out)const;
+	void ClipAndSetup(const DirectX::XMFLOAT4& v0, const DirectX::XMFLOAT4& v1, const DirectX::XMFLOAT4& v2,
+		std::vector<Triangle>& out)const;
+	void RasterizeTriangle(const Triangle& tri, int minX, int minY, int maxX, int maxY);
+	void BuildPyramid();
+
+	bool IsRectVisible(float minX, float minY, float maxX, float maxY, float minZ, bool fullResolution)const;
+
+private:
+	static const uint32_t BinSize = 32;
+
+	uint32_t mWidth = 0;
+	uint32_t mHeight = 0;
+	uint32_t mBufferWidth = 0;
+	uint32_t mBufferHeight = 0;
+	uint32_t mBinsX = 0;
+	uint32_t mBinsY = 0;
+
+	std::vector<Occluder> mOccluders;
+	std::vector<DirectX::XMFLOAT4> mClipVertices;
+	std::vector<Triangle> mTriangles;
+	std::vector<std::vector<uint32_t>> mBins;
+
+	// Level 0 is the depth buffer; each further level holds the farthest depth of
+	// 2x2 texels of the one before.
+	std::vector<std::vector<float>> mLevels;
+	std::vector<uint32_t> mLevelWidth;
+	std::vector<uint32_t> mLevelHeight;
+};
@@ -0,0 +1,241 @@
+//***************************************************************************************
+// Ocean.cpp
+//***************************************************************************************
+
+#include "Ocean.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	const float Pi = 3.1415926535f;
+
+	// Spectrum rows per task.
+	const uint32_t RowsPerTask = 16;
+
+	// A cascade hands the waves longer than this many of its own wavelengths over
+	// to the next larger patch, which has them in finer steps of k.
+	const float CascadeOverlap = 6.0f;
+
+	// A pair of independent standard normal numbers.
+	void Gaussians(std::mt19937& rng, float& g1, float& g2)
+	{
+		double u1 = (rng() + 0.5) / 4294967296.0;
+		double u2 = (rng() + 0.5) / 4294967296.0;
+		double r = sqrt(-2.0*log(u1));
+		g1 = (float)(r*cos(2.0*3.14159265358979323846*u2));
+		g2 = (float)(r*sin(2.0*3.14159265358979323846*u2));
+	}
+}
+
+Ocean::Ocean(const Desc& desc, ThreadPool* pool)
+	: mDesc(desc)
+{
+	assert(desc.CascadeCount >= 1 && desc.CascadeCount <= MaxCascades);
+
+	mPool = pool != nullptr ? pool : &ThreadPool::Default();
+	mFft = std::make_unique<Fft>(desc.GridSize);
+
+	mCascades.resize(desc.CascadeCount);
+	for(uint32_t c = 0; c < desc.CascadeCount; ++c)
+		InitCascade(mCascades[c], c);
+}
+
+float Ocean::Phillips(float kx, float kz, const Desc& desc)
+{
+	float k2 = kx*kx + kz*kz;
+	float windSpeed2 = desc.Wind.x*desc.Wind.x + desc.Wind.y*desc.Wind.y;
+	if(k2 < 1e-12f || windSpeed2 < 1e-12f)
+		return 0.0f;
+
+	// Largest wave the wind can raise.
+	float L = windSpeed2 / desc.Gravity;
+
+	// Waves across the wind are weaker.
+	float kDotW = kx*desc.Wind.x + kz*desc.Wind.y;
+	float cos2 = kDotW*kDotW / (k2*windSpeed2);
+
+	// Tessendorf's damping of waves much shorter than L.
+	float l = 0.001f*L;
+
+	return desc.Amplitude * expf(-1.0f / (k2*L*L)) / (k2*k2) * cos2 * expf(-k2*l*l);
+}
+
+void Ocean::InitCascade(Cascade& cascade, uint32_t index)
+{
+	const uint32_t n = mDesc.GridSize;
+	const float patchSize = mDesc.PatchSizes[index];
+	const float dk = 2.0f*Pi / patchSize;
+
+	cascade.PatchSize = patchSize;
+
+	cascade.K.resize(n);
+	for(uint32_t i = 0; i < n; ++i)
+		cascade.K[i] = dk * (i < n/2 ? (float)i : (float)i - (float)n);
+
+	// Band of |k| this cascade keeps.  The boundary with the next cascade is below
+	// the Nyquist frequency of this one, so every band is fully resolved.
+	auto boundary = [this, n](uint32_t c)
+	{
+		float handOver = CascadeOverlap * 2.0f*Pi / mDesc.PatchSizes[c + 1];
+		float nyquist = Pi * n / mDesc.PatchSizes[c];
+		return (std::min)(handOver, nyquist);
+	};
+	float kMin = index > 0 ? boundary(index - 1) : 0.0f;
+	float kMax = index + 1 < mDesc.CascadeCount ? boundary(index) : FLT_MAX;
+
+	cascade.H0.Re.resize(n*n);
+	cascade.H0.Im.resize(n*n);
+	cascade.Omega.resize(n*n);
+
+	// Random numbers are drawn for every point so that the band limits do not
+	// change which numbers the kept waves get.
+	std::mt19937 rng(mDesc.Seed + 0x9e3779b9u*index);
+	for(uint32_t i = 0; i < n; ++i)
+	{
+		for(uint32_t j = 0; j < n; ++j)
+		{
+			float g1, g2;
+			Gaussians(rng, g1, g2);
+
+			float kx = cascade.K[j];
+			float kz = cascade.K[i];
+			float k = sqrtf(kx*kx + kz*kz);
+
+			// The Nyquist row and column have no mirror image, so they are left out
+			// to keep the fields real.
+			float amplitude = 0.0f;
+			if(i != n/2 && j != n/2 && k >= kMin && k < kMax)
+				amplitude = sqrtf(0.5f*Phillips(kx, kz, mDesc)) * dk;
+
+			cascade.H0.Re[i*n + j] = g1*amplitude;
+			cascade.H0.Im[i*n + j] = g2*amplitude;
+
+			// Deep water dispersion.
+			cascade.Omega[i*n + j] = sqrtf(mDesc.Gravity*k);
+		}
+	}
+
+	cascade.H0MinusConj.Re.resize(n*n);
+	cascade.H0MinusConj.Im.resize(n*n);
+	for(uint32_t i = 0; i < n; ++i)
+	{
+		for(uint32_t j = 0; j < n; ++j)
+		{
+			uint32_t mirror = ((n - i) & (n - 1))*n + ((n - j) & (n - 1));
+			cascade.H0MinusConj.Re[i*n + j] = cascade.H0.Re[mirror];
+			cascade.H0MinusConj.Im[i*n + j] = -cascade.H0.Im[mirror];
+		}
+	}
+
+	for(ComplexField* field : { &cascade.HeightSlopeX, &cascade.DisplacementXZ, &cascade.SlopeZ })
+	{
+		field->Re.assign(n*n, 0.0f);
+		field->Im.assign(n*n, 0.0f);
+	}
+}
+
+void Ocean::Update(float time)
+{
+	for(auto& cascade : mCascades)
+		UpdateCascade(cascade, time);
+}
+
+void Ocean::UpdateCascade(Cascade& cascade, float time)
+{
+	const uint32_t n = mDesc.GridSize;
+
+	mPool->ParallelFor(n / RowsPerTask, [this, &cascade, time, n](uint32_t task)
+	{
+		for(uint32_t i = task*RowsPerTask; i < (task + 1)*RowsPerTask; ++i)
+		{
+			for(uint32_t j = 0; j < n; ++j)
+			{
+				uint32_t idx = i*n + j;
+
+				// h(k, t) = h0(k) e^(i w t) + conj(h0(-k)) e^(-i w t)
+				float wt = cascade.Omega[idx]*time;
+				float c = cosf(wt);
+				float s = sinf(wt);
+				float ar = cascade.H0.Re[idx], ai = cascade.H0.Im[idx];
+				float br = cascade.H0MinusConj.Re[idx], bi = cascade.H0MinusConj.Im[idx];
+				float hr = ar*c - ai*s + br*c + bi*s;
+				float hi = ar*s + ai*c + bi*c - br*s;
+
+				float kx = cascade.K[j];
+				float kz = cascade.K[i];
+				float k = sqrtf(kx*kx + kz*kz);
+				float invK = k > 0.0f ? 1.0f / k : 0.0f;
+
+				// Slopes i k h, and displacements i (k/|k|) h, which move the points
+				// toward the crests.
+				float sxr = -kx*hi, sxi = kx*hr;
+				float szr = -kz*hi, szi = kz*hr;
+				float dxr = -kx*invK*hi, dxi = kx*invK*hr;
+				float dzr = -kz*invK*hi, dzi = kz*invK*hr;
+
+				// Pack two real fields as a + i b.
+				cascade.HeightSlopeX.Re[idx] = hr - sxi;
+				cascade.HeightSlopeX.Im[idx] = hi + sxr;
+				cascade.DisplacementXZ.Re[idx] = dxr - dzi;
+				cascade.DisplacementXZ.Im[idx] = dxi + dzr;
+				cascade.SlopeZ.Re[idx] = szr;
+				cascade.SlopeZ.Im[idx] = szi;
+			}
+		}
+	});
+
+	mFft->Transform2D(cascade.HeightSlopeX.Re.data(), cascade.HeightSlopeX.Im.data(), true, mPool);
+	mFft->Transform2D(cascade.DisplacementXZ.Re.data(), cascade.DisplacementXZ.Im.data(), true, mPool);
+	mFft->Transform2D(cascade.SlopeZ.Re.data(), cascade.SlopeZ.Im.data(), true, mPool);
+}
+
+void Ocean::Sample(float x, float z, XMFLOAT3& displacement, XMFLOAT3& normal)const
+{
+	const uint32_t n = mDesc.GridSize;
+	const uint32_t mask = n - 1;
+
+	float height = 0.0f;
+	float dx = 0.0f, dz = 0.0f;
+	float sx = 0.0f, sz = 0.0f;
+
+	for(const auto& cascade : mCascades)
+	{
+		float u = x * n / cascade.PatchSize;
+		float v = z * n / cascade.PatchSize;
+		float fu = floorf(u);
+		float fv = floorf(v);
+		float tu = u - fu;
+		float tv = v - fv;
+
+		// The patch repeats, so the indices wrap.
+		uint32_t j0 = (uint32_t)(int)fu & mask;
+		uint32_t i0 = (uint32_t)(int)fv & mask;
+		uint32_t j1 = (j0 + 1) & mask;
+		uint32_t i1 = (i0 + 1) & mask;
+
+		auto bilerp = [&](const std::vector<float>& f)
+		{
+			float top = f[i0*n + j0] + (f[i0*n + j1] - f[i0*n + j0])*tu;
+			float bottom = f[i1*n + j0] + (f[i1*n + j1] - f[i1*n + j0])*tu;
+			return top + (bottom - top)*tv;
+		};
+
+		height += bilerp(cascade.HeightSlopeX.Re);
+		sx += bilerp(cascade.HeightSlopeX.Im);
+		dx += bilerp(cascade.DisplacementXZ.Re);
+		dz += bilerp(cascade.DisplacementXZ.Im);
+		sz += bilerp(cascade.SlopeZ.Re);
+	}
+
+	displacement = XMFLOAT3(mDesc.Choppiness*dx, height, mDesc.Choppiness*dz);
+
+	// Normal of the height field; the horizontal displacement is left out.
+	XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(-sx, 1.0f, -sz, 0.0f)));
+}
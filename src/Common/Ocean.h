@@ -0,0 +1,119 @@
+//***************************************************************************************
+// Ocean.h
+//
+// Deep water ocean surface built from a wave spectrum, after Tessendorf, "Simulating
+// Ocean Water".  Unlike Waves, which steps a local wave equation and only carries the
+// ripples it is disturbed with, the surface here is a sum of sine waves whose
+// amplitudes follow the Phillips spectrum for a given wind.  Each frame the spectrum
+// is advanced in closed form and taken back to heights with inverse FFTs, so the
+// cost per frame does not grow with how long the simulation has run.
+//
+// Each cascade is a square patch with its own FFT grid.  The fields repeat over the
+// patch, so a patch tiles without seams.  Larger patches carry the long swell and
+// smaller ones the short waves.  Every cascade keeps only its own band of wave
+// numbers, so no wave is counted twice.
+//
+// The random amplitudes come from a std::mt19937 (fully specified by the standard)
+// and a Box-Muller transform, and the FFTs give the same results on any thread
+// count, so a given Desc and time always produce the same surface.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Fft.h"
+
+class ThreadPool;
+
+class Ocean
+{
+public:
+	static const uint32_t MaxCascades = 4;
+
+	struct Desc
+	{
+		// FFT grid per cascade, a power of two.
+		uint32_t GridSize = 256;
+
+		// Patch sizes in meters, largest first.
+		uint32_t CascadeCount = 3;
+		float PatchSizes[MaxCascades] = { 250.0f, 37.0f, 7.0f, 1.5f };
+
+		// Wind velocity on the xz plane in meters per second.
+		DirectX::XMFLOAT2 Wind = { 12.0f, 4.0f };
+
+		// Scales the spectrum.  With 0.001 the waves are about as high as those of a
+		// sea the wind has been blowing over for a long time.
+		float Amplitude = 0.001f;
+
+		// Scales the horizontal displacement that sharpens the crests; 0 gives
+		// plain sine waves.
+		float Choppiness = 1.0f;
+
+		float Gravity = 9.81f;
+		uint32_t Seed = 1;
+	};
+
+	// pool defaults to ThreadPool::Default().
+	explicit Ocean(const Desc& desc, ThreadPool* pool = nullptr);
+	Ocean(const Ocean& rhs) = delete;
+	Ocean& operator=(const Ocean& rhs) = delete;
+
+	const Desc& GetDesc()const { return mDesc; }
+
+	// Evaluates every cascade at the given time in seconds.
+	void Update(float time);
+
+	// Sum of the cascades at (x, z), filtered bilinearly.  displacement is the offset
+	// of the surface point over (x, 0, z), normal the unit surface normal.
+	void Sample(float x, float z, DirectX::XMFLOAT3& displacement, DirectX::XMFLOAT3& normal)const;
+
+	// Fields of one cascade, GridSize x GridSize floats each.  Row i and column j
+	// hold the point (j, i)*PatchSize/GridSize on the patch.
+	const float* Heights(uint32_t cascade)const { return mCascades[cascade].HeightSlopeX.Re.data(); }
+	const float* DisplacementsX(uint32_t cascade)const { return mCascades[cascade].DisplacementXZ.Re.data(); }
+	const float* DisplacementsZ(uint32_t cascade)const { return mCascades[cascade].DisplacementXZ.Im.data(); }
+	const float* SlopesX(uint32_t cascade)const { return mCascades[cascade].HeightSlopeX.Im.data(); }
+	const float* SlopesZ(uint32_t cascade)const { return mCascades[cascade].SlopeZ.Re.data(); }
+
+	// Phillips spectrum at wave vector (kx, kz).
+	static float Phillips(float kx, float kz, const Desc& desc);
+
+private:
+	struct ComplexField
+	{
+		std::vector<float> Re;
+		std::vector<float> Im;
+	};
+
+	struct Cascade
+	{
+		float PatchSize = 0.0f;
+
+		// Wave numbers of the grid rows and columns, in FFT order.
+		std::vector<float> K;
+
+		// h0(k) and conj(h0(-k)), and the angular frequency of each wave.
+		ComplexField H0;
+		ComplexField H0MinusConj;
+		std::vector<float> Omega;
+
+		// The fields are real, so they go through the inverse FFT in pairs, one
+		// as the real and one as the imaginary part.
+		ComplexField HeightSlopeX;
+		ComplexField DisplacementXZ;
+		ComplexField SlopeZ;
+	};
+
+	void InitCascade(Cascade& cascade, uint32_t index);
+	void UpdateCascade(Cascade& cascade, float time);
+
+private:
+	Desc mDesc;
+	ThreadPool* mPool = nullptr;
+	std::unique_ptr<Fft> mFft;
+	std::vector<Cascade> mCascades;
+};
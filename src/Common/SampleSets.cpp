@@ -0,0 +1,357 @@
+//***************************************************************************************
+// SampleSets.cpp
+//***************************************************************************************
+
+#include "SampleSets.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	const float Pi = 3.1415926535f;
+
+	// Top 24 bits of a 32-bit fraction as a float in [0,1).  Converting all 32 bits
+	// would round values just under 1 up to 1.
+	inline float BitsToUnitFloat(uint32_t bits)
+	{
+		return (bits >> 8) * (1.0f / 16777216.0f);
+	}
+
+	class VoidAndCluster
+	{
+	public:
+		VoidAndCluster(uint32_t size, uint32_t depth, float sigma, float temporalSigma);
+
+		// The rank of every texel, a permutation of [0, texel count).
+		std::vector<uint32_t> Run(uint32_t seed);
+
+	private:
+		// Turns a texel on or off, adds or takes away its Gaussian from the energy of
+		// the texels around it, and updates the rows it reached.
+		void Set(uint32_t index, bool on);
+
+		// Finds the tightest cluster and the largest void of a row again.
+		void UpdateRow(uint32_t row);
+
+		// With cluster, the on texel with the most energy (the tightest cluster);
+		// otherwise the off texel with the least (the largest void).  Ties go to the
+		// lowest index.
+		uint32_t Find(bool cluster)const;
+
+	private:
+		struct Tap
+		{
+			int32_t Dx;
+			int32_t Dy;
+			int32_t Dz;
+			float Weight;
+		};
+
+		uint32_t mSize;
+		uint32_t mDepth;
+		uint32_t mCount;
+		int32_t mRadius;
+		int32_t mTemporalRadius;
+
+		std::vector<Tap> mTaps;
+		std::vector<uint8_t> mPattern;
+		std::vector<float> mEnergy;
+
+		// The tightest cluster and largest void of each row of each slice, or
+		// UINT32_MAX.  A texel only changes the energy of a few rows, so a search
+		// goes through one entry per row instead of every texel.
+		std::vector<uint32_t> mRowCluster;
+		std::vector<uint32_t> mRowVoid;
+	};
+
+	VoidAndCluster::VoidAndCluster(uint32_t size, uint32_t depth, float sigma, float temporalSigma) :
+		mSize(size), mDepth(depth), mCount(size*size*depth)
+	{
+		// The Gaussians are cut off at 3 sigma, and at half the map so that no
+		// texel is reached twice around the wrap.
+		mRadius = (std::min)((int32_t)std::ceil(3.0f*sigma), (int32_t)(size - 1)/2);
+		mTemporalRadius = (std::min)((int32_t)std::ceil(3.0f*temporalSigma), (int32_t)(depth - 1)/2);
+		int32_t radius = mRadius;
+		int32_t temporalRadius = mTemporalRadius;
+
+		// Texels repel the texels around them in their own slice, and the same texel
+		// in the slices around theirs (Wolfe et al., "Spatiotemporal Blue Noise
+		// Masks"), but not other texels in other slices.
+		for(int32_t dy = -radius; dy <= radius; ++dy)
+		{
+			for(int32_t dx = -radius; dx <= radius; ++dx)
+				mTaps.push_back({ dx, dy, 0, std::exp(-(float)(dx*dx + dy*dy) / (2.0f*sigma*sigma)) });
+		}
+
+		for(int32_t dz = -temporalRadius; dz <= temporalRadius; ++dz)
+		{
+			if(dz != 0)
+				mTaps.push_back({ 0, 0, dz, std::exp(-(float)(dz*dz) / (2.0f*temporalSigma*temporalSigma)) });
+		}
+
+	}
+
+	std::vector<uint32_t> VoidAndCluster::Run(uint32_t seed)
+	{
+		mPattern.assign(mCount, 0);
+		mEnergy.assign(mCount, 0.0f);
+		mRowCluster.assign(mSize*mDepth, UINT32_MAX);
+		mRowVoid.resize(mSize*mDepth);
+		for(uint32_t row = 0; row < mSize*mDepth; ++row)
+			mRowVoid[row] = row*mSize;
+
+		// Initial binary pattern: a tenth of the texels, picked by a partial
+		// Fisher-Yates shuffle.  The modulo keeps the picks independent of the
+		// library's distribution classes, which the standard leaves unspecified.
+		uint32_t onCount = (std::max)(1u, mCount / 10);
+
+		std::mt19937 random(seed);
+		std::vector<uint32_t> order(mCount);
+		std::iota(order.begin(), order.end(), 0u);
+		for(uint32_t i = 0; i < onCount; ++i)
+		{
+			std::swap(order[i], order[i + random() % (mCount - i)]);
+			Set(order[i], true);
+		}
+
+		// Move the tightest cluster into the largest void until the largest void is
+		// where the cluster came from.
+		for(uint32_t step = 0; step < mCount; ++step)
+		{
+			uint32_t cluster = Find(true);
+			Set(cluster, false);
+
+			uint32_t gap = Find(false);
+			Set(gap, true);
+
+			if(gap == cluster)
+				break;
+		}
+
+		std::vector<uint8_t> prototype = mPattern;
+		std::vector<float> prototypeEnergy = mEnergy;
+		std::vector<uint32_t> prototypeClusters = mRowCluster;
+		std::vector<uint32_t> prototypeVoids = mRowVoid;
+		std::vector<uint32_t> ranks(mCount);
+
+		// Phase 1: take the tightest clusters out of the prototype, ranking them
+		// from onCount - 1 down to 0.
+		for(uint32_t rank = onCount; rank-- > 0; )
+		{
+			uint32_t cluster = Find(true);
+			Set(cluster, false);
+			ranks[cluster] = rank;
+		}
+
+		// Phases 2 and 3: fill the largest voids from the prototype up.  Past half
+		// the texels Ulichney swaps the roles of on and off and removes the tightest
+		// clusters of off texels; with a fixed set of taps the energy of the off
+		// texels is a constant minus the energy of the on texels, so that is the
+		// same texel as the largest void.
+		mPattern.swap(prototype);
+		mEnergy.swap(prototypeEnergy);
+		mRowCluster.swap(prototypeClusters);
+		mRowVoid.swap(prototypeVoids);
+
+		for(uint32_t rank = onCount; rank < mCount; ++rank)
+		{
+			uint32_t gap = Find(false);
+			Set(gap, true);
+			ranks[gap] = rank;
+		}
+
+		return ranks;
+	}
+
+	void VoidAndCluster::Set(uint32_t index, bool on)
+	{
+		mPattern[index] = on ? 1 : 0;
+
+		int32_t size = (int32_t)mSize;
+		int32_t depth = (int32_t)mDepth;
+		int32_t x = (int32_t)(index % mSize);
+		int32_t y = (int32_t)(index / mSize % mSize);
+		int32_t z = (int32_t)(index / (mSize*mSize));
+
+		for(const Tap& tap : mTaps)
+		{
+			int32_t tx = (x + tap.Dx + size) % size;
+			int32_t ty = (y + tap.Dy + size) % size;
+			int32_t tz = (z + tap.Dz + depth) % depth;
+
+			float& energy = mEnergy[((size_t)tz*size + ty)*size + tx];
+			energy += on ? tap.Weight : -tap.Weight;
+		}
+
+		// The rows of the slice within the spatial radius, and the texel's own row
+		// in the slices within the temporal radius.
+		for(int32_t dy = -mRadius; dy <= mRadius; ++dy)
+			UpdateRow((uint32_t)(z*size + (y + dy + size) % size));
+
+		for(int32_t dz = -mTemporalRadius; dz <= mTemporalRadius; ++dz)
+		{
+			if(dz != 0)
+				UpdateRow((uint32_t)((z + dz + depth) % depth*size + y));
+		}
+	}
+
+	void VoidAndCluster::UpdateRow(uint32_t row)
+	{
+		uint32_t cluster = UINT32_MAX;
+		uint32_t gap = UINT32_MAX;
+
+		for(uint32_t i = row*mSize; i < (row + 1)*mSize; ++i)
+		{
+			if(mPattern[i] != 0)
+			{
+				if(cluster == UINT32_MAX || mEnergy[i] > mEnergy[cluster])
+					cluster = i;
+			}
+			else
+			{
+				if(gap == UINT32_MAX || mEnergy[i] < mEnergy[gap])
+					gap = i;
+			}
+		}
+
+		mRowCluster[row] = cluster;
+		mRowVoid[row] = gap;
+	}
+
+	uint32_t VoidAndCluster::Find(bool cluster)const
+	{
+		const std::vector<uint32_t>& rows = cluster ? mRowCluster : mRowVoid;
+
+		// Rows hold increasing indices, so taking only strictly better rows keeps the
+		// lowest index on a tie.
+		uint32_t best = UINT32_MAX;
+		for(uint32_t i : rows)
+		{
+			if(i == UINT32_MAX)
+				continue;
+
+			if(best == UINT32_MAX || (cluster ? mEnergy[i] > mEnergy[best] : mEnergy[i] < mEnergy[best]))
+				best = i;
+		}
+
+		return best;
+	}
+}
+
+float SampleSets::RadicalInverse2(uint32_t i)
+{
+	i = (i << 16) | (i >> 16);
+	i = ((i & 0x00ff00ff) << 8) | ((i & 0xff00ff00) >> 8);
+	i = ((i & 0x0f0f0f0f) << 4) | ((i & 0xf0f0f0f0) >> 4);
+	i = ((i & 0x33333333) << 2) | ((i & 0xcccccccc) >> 2);
+	i = ((i & 0x55555555) << 1) | ((i & 0xaaaaaaaa) >> 1);
+	return BitsToUnitFloat(i);
+}
+
+float SampleSets::RadicalInverse3(uint32_t i)
+{
+	double value = 0.0;
+	double digit = 1.0 / 3.0;
+	for(; i != 0; i /= 3)
+	{
+		value += (i % 3)*digit;
+		digit /= 3.0;
+	}
+
+	// Keep values just under 1 from rounding up to it.
+	return (std::min)((float)value, 0.99999994f);
+}
+
+float SampleSets::Sobol2(uint32_t i)
+{
+	// Direction numbers of the primitive polynomial x + 1: each is the last one
+	// xor itself shifted right by one.
+	uint32_t bits = 0;
+	for(uint32_t v = 1u << 31; i != 0; i >>= 1, v ^= v >> 1)
+	{
+		if(i & 1)
+			bits ^= v;
+	}
+	return BitsToUnitFloat(bits);
+}
+
+std::vector<XMFLOAT4> SampleSets::HemisphereKernel(uint32_t count, Sequence sequence, float minLength)
+{
+	std::vector<XMFLOAT4> kernel(count);
+
+	for(uint32_t i = 0; i < count; ++i)
+	{
+		float u0, u1;
+		if(sequence == Sequence::Hammersley)
+		{
+			u0 = (i + 0.5f) / count;
+			u1 = RadicalInverse2(i);
+		}
+		else
+		{
+			u0 = RadicalInverse2(i);
+			u1 = Sobol2(i);
+		}
+
+		// A uniform point on the unit disk lifted onto the hemisphere has a density
+		// proportional to the cosine of its angle with +z.
+		float r = std::sqrt(u0);
+		float phi = 2.0f*Pi*u1;
+		float z = std::sqrt((std::max)(0.0f, 1.0f - u0));
+
+		float length = minLength + (1.0f - minLength)*RadicalInverse3(i);
+
+		kernel[i] = XMFLOAT4(length*r*std::cos(phi), length*r*std::sin(phi), length*z, 0.0f);
+	}
+
+	return kernel;
+}
+
+void SampleSets::SortByLength(std::vector<XMFLOAT4>& kernel)
+{
+	auto lengthSq = [](const XMFLOAT4& k) { return k.x*k.x + k.y*k.y + k.z*k.z; };
+	std::stable_sort(kernel.begin(), kernel.end(),
+		[&](const XMFLOAT4& a, const XMFLOAT4& b) { return lengthSq(a) < lengthSq(b); });
+}
+
+std::vector<float> SampleSets::BlueNoise(uint32_t size, uint32_t seed, float sigma)
+{
+	VoidAndCluster method(size, 1, sigma, 1.0f);
+	std::vector<uint32_t> ranks = method.Run(seed);
+
+	std::vector<float> values(ranks.size());
+	for(size_t i = 0; i < ranks.size(); ++i)
+		values[i] = (ranks[i] + 0.5f) / ranks.size();
+
+	return values;
+}
+
+std::vector<float> SampleSets::SpatiotemporalBlueNoise(uint32_t size, uint32_t depth, uint32_t seed,
+	float sigma, float temporalSigma)
+{
+	VoidAndCluster method(size, depth, sigma, temporalSigma);
+	std::vector<uint32_t> ranks = method.Run(seed);
+
+	// The ranks are spread over the whole stack, so a slice may hold more low ranks
+	// than another.  Rank each slice again to give every slice all the values.
+	uint32_t sliceCount = size*size;
+	std::vector<float> values(ranks.size());
+	std::vector<uint32_t> order(sliceCount);
+
+	for(uint32_t slice = 0; slice < depth; ++slice)
+	{
+		const uint32_t* sliceRanks = &ranks[(size_t)slice*sliceCount];
+
+		std::iota(order.begin(), order.end(), 0u);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sliceRanks[a] < sliceRanks[b]; });
+
+		for(uint32_t k = 0; k < sliceCount; ++k)
+			values[(size_t)slice*sliceCount + order[k]] = (k + 0.5f) / sliceCount;
+	}
+
+	return values;
+}
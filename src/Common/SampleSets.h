@@ -0,0 +1,72 @@
+//***************************************************************************************
+// SampleSets.h
+//
+// Deterministic sample sets for stochastic effects such as SSAO: low discrepancy
+// kernels on the hemisphere and blue noise threshold maps.
+//
+// The kernels come from the Hammersley set or the 2D Sobol sequence, mapped to the
+// +z hemisphere with a cosine weighted density (Malley's method), and take their
+// lengths from a third, base 3, radical inverse.  Sobol points are progressive: the
+// first 2^k points of any kernel are themselves well stratified, so a shader may use
+// a prefix of the set.  Hammersley points are better spread for a fixed count but
+// only as a whole.
+//
+// Blue noise maps are built with Ulichney's void and cluster method.  Distances wrap
+// around the edges, so the maps tile without seams.  Each value in [0,1) appears
+// once per map, (rank + 0.5) / texel count, so thresholding the map at t lights a
+// fraction t of the texels with as even a spacing as the method finds.  The
+// spatiotemporal variant runs the method over a stack of slices with separate
+// spatial and temporal Gaussians and then ranks each slice again on its own: every
+// slice is a blue noise map, and the values one texel takes over the slices are
+// spread as well, which is what temporal accumulation wants.
+//
+// The only random choice, the initial pattern, comes from a std::mt19937 (fully
+// specified by the standard), and ties are broken by the lowest index, so a seed
+// always gives the same map on any compiler.
+//
+// The energy of every texel is kept up to date as texels are turned on and off, and
+// so are the tightest cluster and largest void of every row, so each step costs the
+// rows a Gaussian reaches plus one look per row rather than a pass over the map.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+namespace SampleSets
+{
+	enum class Sequence
+	{
+		Hammersley,
+		Sobol
+	};
+
+	// The base 2 radical inverse (van der Corput sequence) of i, in [0,1).
+	float RadicalInverse2(uint32_t i);
+
+	// The base 3 radical inverse of i, in [0,1).
+	float RadicalInverse3(uint32_t i);
+
+	// The second dimension of the Sobol sequence, whose first is RadicalInverse2.
+	float Sobol2(uint32_t i);
+
+	// count offsets in the +z hemisphere.  xyz is a unit direction, cosine weighted
+	// about +z, times a length in [minLength, 1]; w is 0.
+	std::vector<DirectX::XMFLOAT4> HemisphereKernel(uint32_t count, Sequence sequence,
+		float minLength = 0.25f);
+
+	// Orders a kernel from its shortest offset to its longest.  The set stays the same
+	// but its prefixes are no longer spread out, so sort a kernel of the count used.
+	void SortByLength(std::vector<DirectX::XMFLOAT4>& kernel);
+
+	// size x size threshold map, row by row.  sigma is the width in texels of the
+	// Gaussian the method measures clusters and voids with; 1.5 is Ulichney's choice.
+	std::vector<float> BlueNoise(uint32_t size, uint32_t seed = 1, float sigma = 1.5f);
+
+	// depth slices of size x size, slice by slice.  temporalSigma is the width of the
+	// Gaussian across slices, in slices.
+	std::vector<float> SpatiotemporalBlueNoise(uint32_t size, uint32_t depth, uint32_t seed = 1,
+		float sigma = 1.9f, float temporalSigma = 1.9f);
+}
@@ -0,0 +1,124 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+
+namespace
+{
+	// Set on pool workers so nested loops run inline instead of waiting on the pool
+	// they are running on.
+	thread_local bool tInsideLoop = false;
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+	: mNext(0), mDone(0)
+{
+	if(threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if(threadCount == 0)
+		threadCount = 1;
+
+	for(uint32_t i = 1; i < threadCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+
+	for(auto& worker : mWorkers)
+		worker.join();
+}
+
+ThreadPool& ThreadPool::Default()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task)
+{
+	if(count == 0)
+		return;
+
+	if(mWorkers.empty() || count == 1 || tInsideLoop)
+	{
+		for(uint32_t i = 0; i < count; ++i)
+			task(i);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit(mSubmitMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTask = &task;
+		mCount = count;
+		mNext.store(0);
+		mDone.store(0);
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	tInsideLoop = true;
+	RunTasks();
+	tInsideLoop = false;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	mFinished.wait(lock, [this]() { return mDone.load() == mCount && mActive == 0; });
+	mTask = nullptr;
+}
+
+void ThreadPool::WorkerLoop()
+{
+	tInsideLoop = true;
+
+	uint64_t seen = 0;
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&]() { return mStop || mGeneration != seen; });
+			if(mStop)
+				return;
+
+			seen = mGeneration;
+			if(mTask == nullptr)
+				continue;
+			++mActive;
+		}
+
+		RunTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			--mActive;
+		}
+		mFinished.notify_all();
+	}
+}
+
+void ThreadPool::RunTasks()
+{
+	for(;;)
+	{
+		uint32_t i = mNext.fetch_add(1);
+		if(i >= mCount)
+			return;
+
+		(*mTask)(i);
+
+		if(mDone.fetch_add(1) + 1 == mCount)
+		{
+			// Take the lock so the notification cannot slip in between the caller
+			// checking the count and going to sleep.
+			std::lock_guard<std::mutex> lock(mMutex);
+			mFinished.notify_all();
+		}
+	}
+}
@@ -0,0 +1,67 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// A fixed set of worker threads built on the standard library, for data parallel loops
+// that must also build outside Windows, where the PPL (concurrency::parallel_for) the
+// samples otherwise use is not available.
+//
+// ParallelFor hands out indices one at a time from a shared counter, so tasks should be
+// coarse (a tile of rows, not a single element).  The calling thread works on the loop
+// too and returns once every index has run.  Loops are run one at a time; a ParallelFor
+// issued from inside a task runs on the calling worker without going through the pool.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// threadCount counts the calling thread, so threadCount - 1 workers are started.
+	// 0 uses one thread per hardware thread.
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+	// Threads that take part in a loop, including the caller.
+	uint32_t ThreadCount()const { return (uint32_t)mWorkers.size() + 1; }
+
+	// Runs task(i) for every i in [0, count) and waits for all of them.
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& task);
+
+	// Shared pool with one thread per hardware thread, started on first use.
+	static ThreadPool& Default();
+
+private:
+	void WorkerLoop();
+	void RunTasks();
+
+private:
+	std::vector<std::thread> mWorkers;
+
+	// Serializes loops issued from different threads.
+	std::mutex mSubmitMutex;
+
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mFinished;
+	uint64_t mGeneration = 0;
+	bool mStop = false;
+
+	// The loop being run.  Workers that joined it are counted in mActive, and the
+	// next loop is not posted until they have all left.
+	const std::function<void(uint32_t)>* mTask = nullptr;
+	uint32_t mCount = 0;
+	std::atomic<uint32_t> mNext;
+	std::atomic<uint32_t> mDone;
+	uint32_t mActive = 0;
+};
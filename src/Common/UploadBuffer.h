@@ -57,6 +57,13 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Start of the mapped memory, for filling a whole buffer at once.  Constant
+    // buffer elements are padded, so use CopyData for those.
+    BYTE* MappedData()
+    {
+        return mMappedData;
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
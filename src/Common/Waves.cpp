@@ -0,0 +1,296 @@
+//***************************************************************************************
+// Waves.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include "Waves.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <vector>
+#include <cassert>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	inline XMVECTOR Load4(const float* p)
+	{
+		return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p));
+	}
+
+	inline void Store4(float* p, FXMVECTOR v)
+	{
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(p), v);
+	}
+}
+
+Waves::Waves(int m, int n, float dx, float dt, float speed, float damping, ThreadPool* pool)
+{
+    mNumRows = m;
+    mNumCols = n;
+
+    mVertexCount = m*n;
+    mTriangleCount = (m - 1)*(n - 1) * 2;
+
+    mTimeStep = dt;
+    mSpatialStep = dx;
+
+    mPool = pool != nullptr ? pool : &ThreadPool::Default();
+
+    float d = damping*dt + 2.0f;
+    float e = (speed*speed)*(dt*dt) / (dx*dx);
+    mK1 = (damping*dt - 2.0f) / d;
+    mK2 = (4.0f - 8.0f*e) / d;
+    mK3 = (2.0f*e) / d;
+
+    // The grid starts flat, with boundaries that stay at zero height.
+    mPrevSolution.assign(m*n, 0.0f);
+    mCurrSolution.assign(m*n, 0.0f);
+    mNormalX.assign(m*n, 0.0f);
+    mNormalY.assign(m*n, 1.0f);
+    mNormalZ.assign(m*n, 0.0f);
+    mTangentX.assign(m*n, 1.0f);
+    mTangentY.assign(m*n, 0.0f);
+
+    mHalfWidth = (n - 1)*dx*0.5f;
+    mHalfDepth = (m - 1)*dx*0.5f;
+}
+
+Waves::~Waves()
+{
+}
+
+int Waves::RowCount()const
+{
+	return mNumRows;
+}
+
+int Waves::ColumnCount()const
+{
+	return mNumCols;
+}
+
+int Waves::VertexCount()const
+{
+	return mVertexCount;
+}
+
+int Waves::TriangleCount()const
+{
+	return mTriangleCount;
+}
+
+float Waves::Width()const
+{
+	return mNumCols*mSpatialStep;
+}
+
+float Waves::Depth()const
+{
+	return mNumRows*mSpatialStep;
+}
+
+float Waves::SpatialStep()const
+{
+	return mSpatialStep;
+}
+
+void Waves::Update(float dt)
+{
+	// Accumulate time.
+	mTime += dt;
+
+	// Only update the simulation at the specified time step.
+	if( mTime >= mTimeStep )
+	{
+		Step();
+
+		mTime = 0.0f; // reset time
+	}
+}
+
+void Waves::Step()
+{
+	// Only update interior points; we use zero boundary conditions.
+	int interiorRows = mNumRows - 2;
+	if(interiorRows <= 0)
+		return;
+
+	uint32_t tileCount = (uint32_t)((interiorRows + TileRows - 1) / TileRows);
+
+	mPool->ParallelFor(tileCount, [this, interiorRows](uint32_t tile)
+	{
+		int first = 1 + (int)tile*TileRows;
+		int last = first + (std::min)(TileRows, interiorRows - (int)tile*TileRows) - 1;
+
+		// Normals of a row need the new heights of the rows on both sides, so they
+		// trail the height update by one row.  The tile's first and last rows also
+		// need rows of the neighbouring tiles and are done below.
+		for(int i = first; i <= last; ++i)
+		{
+			UpdateRow(i);
+			if(i - 1 > first)
+				ComputeNormalsRow(i - 1);
+		}
+	});
+
+	mPool->ParallelFor(tileCount, [this, interiorRows](uint32_t tile)
+	{
+		int first = 1 + (int)tile*TileRows;
+		int last = first + (std::min)(TileRows, interiorRows - (int)tile*TileRows) - 1;
+
+		ComputeNormalsRow(first);
+		if(last != first)
+			ComputeNormalsRow(last);
+	});
+
+	// We just overwrote the previous buffer with the new data, so
+	// this data needs to become the current solution and the old
+	// current solution becomes the new previous solution.
+	std::swap(mPrevSolution, mCurrSolution);
+}
+
+void Waves::UpdateRow(int i)
+{
+	// After this update we will be discarding the old previous
+	// buffer, so overwrite that buffer with the new update.
+	// Note how we can do this inplace (read/write to same element)
+	// because we won't need prev_ij again and the assignment happens last.
+
+	// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+	// Moreover, our +z axis goes "down"; this is just to
+	// keep consistent with our row indices going down.
+
+	const int n = mNumCols;
+	float* prev = &mPrevSolution[i*n];
+	const float* curr = &mCurrSolution[i*n];
+	const float* up = curr - n;
+	const float* down = curr + n;
+
+	// Multiplies and adds are kept apart, as in the scalar tail, so a fused
+	// multiply-add cannot change the rounding.
+	XMVECTOR k1 = XMVectorReplicate(mK1);
+	XMVECTOR k2 = XMVectorReplicate(mK2);
+	XMVECTOR k3 = XMVectorReplicate(mK3);
+
+	int j = 1;
+	for(; j + 4 <= n - 1; j += 4)
+	{
+		XMVECTOR neighbours = XMVectorAdd(XMVectorAdd(XMVectorAdd(
+			Load4(down + j), Load4(up + j)), Load4(curr + j + 1)), Load4(curr + j - 1));
+
+		XMVECTOR h = XMVectorAdd(XMVectorAdd(
+			XMVectorMultiply(k1, Load4(prev + j)),
+			XMVectorMultiply(k2, Load4(curr + j))),
+			XMVectorMultiply(k3, neighbours));
+
+		Store4(prev + j, h);
+	}
+
+	for(; j < n - 1; ++j)
+	{
+		prev[j] =
+			mK1*prev[j] +
+			mK2*curr[j] +
+			mK3*(down[j] + up[j] + curr[j + 1] + curr[j - 1]);
+	}
+}
+
+void Waves::ComputeNormalsRow(int i)
+{
+	//
+	// Compute normals using finite difference scheme, from the new heights,
+	// which are still in the previous buffer.
+	//
+	const int n = mNumCols;
+	const float* h = &mPrevSolution[i*n];
+	const float* up = h - n;
+	const float* down = h + n;
+	float* nx = &mNormalX[i*n];
+	float* ny = &mNormalY[i*n];
+	float* nz = &mNormalZ[i*n];
+	float* tx = &mTangentX[i*n];
+	float* ty = &mTangentY[i*n];
+
+	const float twoDx = 2.0f*mSpatialStep;
+	XMVECTOR twoDxV = XMVectorReplicate(twoDx);
+	XMVECTOR twoDxSq = XMVectorMultiply(twoDxV, twoDxV);
+
+	int j = 1;
+	for(; j + 4 <= n - 1; j += 4)
+	{
+		XMVECTOR l = Load4(h + j - 1);
+		XMVECTOR r = Load4(h + j + 1);
+		XMVECTOR t = Load4(up + j);
+		XMVECTOR b = Load4(down + j);
+
+		// Normal (l - r, 2dx, b - t), tangent (2dx, r - l, 0).
+		XMVECTOR dx = XMVectorSubtract(l, r);
+		XMVECTOR dz = XMVectorSubtract(b, t);
+
+		XMVECTOR normalLength = XMVectorSqrt(XMVectorAdd(XMVectorAdd(
+			XMVectorMultiply(dx, dx), twoDxSq), XMVectorMultiply(dz, dz)));
+		Store4(nx + j, XMVectorDivide(dx, normalLength));
+		Store4(ny + j, XMVectorDivide(twoDxV, normalLength));
+		Store4(nz + j, XMVectorDivide(dz, normalLength));
+
+		XMVECTOR tangentLength = XMVectorSqrt(XMVectorAdd(twoDxSq, XMVectorMultiply(dx, dx)));
+		Store4(tx + j, XMVectorDivide(twoDxV, tangentLength));
+		Store4(ty + j, XMVectorDivide(XMVectorNegate(dx), tangentLength));
+	}
+
+	for(; j < n - 1; ++j)
+	{
+		float dx = h[j - 1] - h[j + 1];
+		float dz = down[j] - up[j];
+
+		float normalLength = sqrtf(dx*dx + twoDx*twoDx + dz*dz);
+		nx[j] = dx / normalLength;
+		ny[j] = twoDx / normalLength;
+		nz[j] = dz / normalLength;
+
+		float tangentLength = sqrtf(twoDx*twoDx + dx*dx);
+		tx[j] = twoDx / tangentLength;
+		ty[j] = -dx / tangentLength;
+	}
+}
+
+void Waves::CopyHeights(float* dst)const
+{
+	std::memcpy(dst, mCurrSolution.data(), mVertexCount*sizeof(float));
+}
+
+void Waves::CopyHeightsHalf(HALF* dst)const
+{
+	XMConvertFloatToHalfStream(dst, sizeof(HALF), mCurrSolution.data(), sizeof(float), mVertexCount);
+}
+
+void Waves::CopyPackedNormals(std::uint32_t* dst)const
+{
+	// Round to nearest; the normal is unit length, so no clamping is needed.
+	for(int i = 0; i < mVertexCount; ++i)
+	{
+		float x = mNormalX[i]*32767.0f;
+		float z = mNormalZ[i]*32767.0f;
+		std::int16_t sx = (std::int16_t)(x < 0.0f ? x - 0.5f : x + 0.5f);
+		std::int16_t sz = (std::int16_t)(z < 0.0f ? z - 0.5f : z + 0.5f);
+		dst[i] = (std::uint32_t)(std::uint16_t)sx | ((std::uint32_t)(std::uint16_t)sz << 16);
+	}
+}
+
+void Waves::Disturb(int i, int j, float magnitude)
+{
+	// Don't disturb boundaries.
+	assert(i > 1 && i < mNumRows-2);
+	assert(j > 1 && j < mNumCols-2);
+
+	float halfMag = 0.5f*magnitude;
+
+	// Disturb the ijth vertex height and its neighbors.
+	mCurrSolution[i*mNumCols+j]     += magnitude;
+	mCurrSolution[i*mNumCols+j+1]   += halfMag;
+	mCurrSolution[i*mNumCols+j-1]   += halfMag;
+	mCurrSolution[(i+1)*mNumCols+j] += halfMag;
+	mCurrSolution[(i-1)*mNumCols+j] += halfMag;
+}
@@ -0,0 +1,119 @@
+//***************************************************************************************
+// Waves.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Performs the calculations for the wave simulation.  After the simulation has been
+// updated, the client must copy the current solution into vertex buffers for rendering.
+// This class only does the calculations, it does not do any drawing.
+//
+// The grid keeps only what changes: the previous and current heights, the unit
+// normals and the x tangents, each as its own float array.  The x and z of a grid
+// point are fixed and worked out by Position.
+//
+// A step splits the interior rows into tiles and runs them on a ThreadPool.  A tile
+// updates its heights four columns at a time and computes the normals and tangents of
+// a row as soon as the rows on both sides of it are done, while they are still in
+// cache.  Only the first and last row of each tile wait for the neighbouring tiles.
+// The heights come out bit for bit the same as the per-point loop this replaces,
+// since every sum is formed in the same order.
+//***************************************************************************************
+
+#ifndef WAVES_H
+#define WAVES_H
+
+#include <vector>
+#include <cstdint>
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+class ThreadPool;
+
+class Waves
+{
+public:
+    // pool defaults to ThreadPool::Default().
+    Waves(int m, int n, float dx, float dt, float speed, float damping, ThreadPool* pool = nullptr);
+    Waves(const Waves& rhs) = delete;
+    Waves& operator=(const Waves& rhs) = delete;
+    ~Waves();
+
+	int RowCount()const;
+	int ColumnCount()const;
+	int VertexCount()const;
+	int TriangleCount()const;
+	float Width()const;
+	float Depth()const;
+	float SpatialStep()const;
+
+	// Returns the solution at the ith grid point.
+    DirectX::XMFLOAT3 Position(int i)const
+    {
+        int row = i / mNumCols;
+        int col = i - row*mNumCols;
+        return DirectX::XMFLOAT3(-mHalfWidth + col*mSpatialStep, mCurrSolution[i], mHalfDepth - row*mSpatialStep);
+    }
+
+	// Returns the solution normal at the ith grid point.
+    DirectX::XMFLOAT3 Normal(int i)const { return DirectX::XMFLOAT3(mNormalX[i], mNormalY[i], mNormalZ[i]); }
+
+	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
+    DirectX::XMFLOAT3 TangentX(int i)const { return DirectX::XMFLOAT3(mTangentX[i], mTangentY[i], 0.0f); }
+
+	// Current heights, RowCount()*ColumnCount() floats, row by row.
+	const float* Heights()const { return mCurrSolution.data(); }
+
+	// Streaming to the GPU.  Only the heights change from frame to frame; the x and z
+	// of a grid point follow from its index, so a shader can rebuild the rest of the
+	// vertex from the vertex ID.  Each writes VertexCount() values to dst.
+	void CopyHeights(float* dst)const;
+	void CopyHeightsHalf(DirectX::PackedVector::HALF* dst)const;
+
+	// Normal x in the low and z in the high 16 bits, as snorms.  The normals all
+	// point up, so y = sqrt(1 - x*x - z*z).
+	void CopyPackedNormals(std::uint32_t* dst)const;
+
+	void Update(float dt);
+	void Disturb(int i, int j, float magnitude);
+
+	// Advances the simulation by one time step regardless of the elapsed time.
+	void Step();
+
+private:
+	void UpdateRow(int i);
+	void ComputeNormalsRow(int i);
+
+private:
+    // Rows per task.  Three rows of both height grids stay in cache while a tile
+    // runs, even for very wide grids.
+    static const int TileRows = 16;
+
+    int mNumRows = 0;
+    int mNumCols = 0;
+
+    int mVertexCount = 0;
+    int mTriangleCount = 0;
+
+    // Simulation constants we can precompute.
+    float mK1 = 0.0f;
+    float mK2 = 0.0f;
+    float mK3 = 0.0f;
+
+    float mTimeStep = 0.0f;
+    float mSpatialStep = 0.0f;
+    float mHalfWidth = 0.0f;
+    float mHalfDepth = 0.0f;
+
+    // Time accumulated since the last step.
+    float mTime = 0.0f;
+
+    ThreadPool* mPool = nullptr;
+
+    std::vector<float> mPrevSolution;
+    std::vector<float> mCurrSolution;
+    std::vector<float> mNormalX;
+    std::vector<float> mNormalY;
+    std::vector<float> mNormalZ;
+    std::vector<float> mTangentX;
+    std::vector<float> mTangentY;
+};
+
+#endif // WAVES_H
@@ -0,0 +1,722 @@
+//***************************************************************************************
+// ImageCheck.cpp
+//
+// Command line checks for post-processing output, so a rewritten kernel can be held
+// to both the images and the speed of the one it replaces.  Needs no GPU and builds
+// outside Windows, e.g.
+//
+//   g++ -std=c++14 -O2 -msse4.1 -I<DirectXMath>/Inc -pthread ImageCheck.cpp ImageIO.cpp ReferencePasses.cpp
+//       ../../Common/{DDSDecoder,EnvironmentBaker,Fft,GaussianBlur,ImageMetrics,SampleSets,ThreadPool}.cpp
+//
+// where DirectXMath is https://github.com/microsoft/DirectXMath, which also needs its
+// sal.h stand-in on Linux.
+//
+// Usage:
+//   ImageCheck compare <reference> <test> [options]
+//       --diff <file>        write the perceptual difference map
+//       --ssim-map <file>    write the SSIM map
+//       --ppd <n>            pixels per degree for the perceptual difference (67)
+//       --min-psnr <dB>      fail below this PSNR
+//       --min-ssim <v>       fail below this mean SSIM
+//       --max-flip <v>       fail above this mean perceptual difference
+//   ImageCheck sobel <input> <output> [--composite <file>]
+//   ImageCheck blur <input> <output> --sigma <s> [--method auto|exact|box]
+//   ImageCheck bench <input> [--repeat <n>] [--min-mps <pass>=<MP/s>]...
+//   ImageCheck noise <output> [options]
+//       --size <n>           map size, a power of two of at least 16 (64)
+//       --depth <n>          slices of spatiotemporal noise, stacked downwards (1)
+//       --seed <n>           seed of the red channel; green, blue and alpha take the
+//                            next three (1)
+//       --max-low-power <v>  fail when the low frequency power of a channel, relative
+//                            to the mean, is above this (white noise gives about 1)
+//   ImageCheck bake <cube> <output prefix> [options]
+//                            writes <prefix>_specular.dds, <prefix>_brdf.dds and the
+//                            irradiance SH as <prefix>_sh.hlsli.  <cube> is a cube map
+//                            .dds or a latitude-longitude panorama.
+//       --face-size <n>      face size panoramas are resampled to (256)
+//       --specular-size <n>  top face of the prefiltered chain (the source size)
+//       --samples <n>        GGX samples per prefiltered texel (256)
+//       --lut-size <n>       BRDF table size (128)
+//       --runtime-size <n>   face size the runtime SH projection is timed at (16)
+//       --max-sh-error <v>   fail when the irradiance from the runtime size differs
+//                            from the full size one by more than this, relative
+//
+// The other commands take --size <w>x<h> for .raw inputs.  Every command takes --json <file> to write its
+// report there instead of to stdout.  The exit code is 0 on success, 1 when a
+// threshold fails and 2 for bad arguments or files.
+//***************************************************************************************
+
+#include "ImageIO.h"
+#include "ReferencePasses.h"
+#include "../../Common/EnvironmentBaker.h"
+#include "../../Common/Fft.h"
+#include "../../Common/GaussianBlur.h"
+#include "../../Common/ImageMetrics.h"
+#include "../../Common/SampleSets.h"
+#include "../../Common/ThreadPool.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t FormatR32G32B32A32Float = 2;
+
+	const int ExitPass = 0;
+	const int ExitFail = 1;
+	const int ExitError = 2;
+
+	// Options after the positional arguments, all of the form --name value.
+	struct Options
+	{
+		std::vector<std::string> Positional;
+		std::multimap<std::string, std::string> Named;
+
+		bool Has(const std::string& name)const { return Named.count(name) != 0; }
+
+		std::string Get(const std::string& name, const std::string& fallback = std::string())const
+		{
+			auto it = Named.find(name);
+			return it != Named.end() ? it->second : fallback;
+		}
+
+		double GetNumber(const std::string& name, double fallback)const
+		{
+			return Has(name) ? atof(Get(name).c_str()) : fallback;
+		}
+	};
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for(int i = 2; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			if(arg.compare(0, 2, "--") == 0)
+			{
+				if(i + 1 >= argc)
+					return false;
+				options.Named.emplace(arg.substr(2), argv[++i]);
+			}
+			else
+			{
+				options.Positional.push_back(arg);
+			}
+		}
+		return true;
+	}
+
+	// A flat JSON object, written in the order the fields are added.
+	class JsonReport
+	{
+	public:
+		void Add(const std::string& key, const std::string& value)
+		{
+			std::string escaped;
+			for(char c : value)
+			{
+				if(c == '"' || c == '\\')
+					escaped += '\\';
+				escaped += c;
+			}
+			mFields.emplace_back(key, "\"" + escaped + "\"");
+		}
+
+		// Infinite or NaN values, which JSON has no numbers for, are written as null.
+		void Add(const std::string& key, double value)
+		{
+			std::ostringstream s;
+			s.precision(9);
+			if(std::isfinite(value))
+				s << value;
+			else
+				s << "null";
+			mFields.emplace_back(key, s.str());
+		}
+
+		void AddBool(const std::string& key, bool value)
+		{
+			mFields.emplace_back(key, value ? "true" : "false");
+		}
+
+		bool Write(const Options& options)const
+		{
+			std::ostringstream s;
+			s << "{\n";
+			for(size_t i = 0; i < mFields.size(); ++i)
+				s << "  \"" << mFields[i].first << "\": " << mFields[i].second << (i + 1 < mFields.size() ? ",\n" : "\n");
+			s << "}\n";
+
+			if(!options.Has("json"))
+			{
+				std::cout << s.str();
+				return true;
+			}
+
+			std::ofstream file(options.Get("json"));
+			file << s.str();
+			return (bool)file;
+		}
+
+	private:
+		std::vector<std::pair<std::string, std::string>> mFields;
+	};
+
+	double Seconds(const std::function<void()>& work)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		work();
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	bool ReadImage(const std::string& path, const Options& options, DDSDecoder::Image& image)
+	{
+		uint32_t width = 0, height = 0;
+		if(options.Has("size"))
+			sscanf(options.Get("size").c_str(), "%ux%u", &width, &height);
+
+		if(!ImageIO::Load(path, image, width, height))
+		{
+			std::cerr << "Cannot load " << path << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	bool WriteImage(const std::string& path, const DDSDecoder::Image& image)
+	{
+		if(!ImageIO::Save(path, image))
+		{
+			std::cerr << "Cannot save " << path << "\n";
+			return false;
+		}
+		return true;
+	}
+
+	// A map of values in [0,1] as a grey image.
+	bool SaveMap(const std::string& path, const std::vector<float>& map, uint32_t width, uint32_t height)
+	{
+		DDSDecoder::Image image;
+		image.Width = width;
+		image.Height = height;
+		image.Format = FormatR32G32B32A32Float;
+		image.Texels.resize(map.size());
+		for(size_t i = 0; i < map.size(); ++i)
+			image.Texels[i] = XMFLOAT4(map[i], map[i], map[i], 1.0f);
+		return WriteImage(path, image);
+	}
+
+	int Compare(const Options& options)
+	{
+		if(options.Positional.size() != 2)
+			return ExitError;
+
+		DDSDecoder::Image reference, test;
+		if(!ReadImage(options.Positional[0], options, reference) || !ReadImage(options.Positional[1], options, test))
+			return ExitError;
+
+		if(reference.Width != test.Width || reference.Height != test.Height)
+		{
+			std::cerr << "The images differ in size\n";
+			return ExitError;
+		}
+
+		const uint32_t width = reference.Width;
+		const uint32_t height = reference.Height;
+		const XMFLOAT4* r = reference.Texels.data();
+		const XMFLOAT4* t = test.Texels.data();
+
+		double mse = 0.0, ssim = 0.0, flip = 0.0;
+		std::vector<float> ssimMap, flipMap;
+		float pixelsPerDegree = (float)options.GetNumber("ppd", 67.0);
+
+		double mseTime = Seconds([&]() { mse = ImageMetrics::MeanSquaredError(r, t, width, height); });
+		double ssimTime = Seconds([&]() { ssim = ImageMetrics::Ssim(r, t, width, height, &ssimMap); });
+		double flipTime = Seconds([&]() { flip = ImageMetrics::Flip(r, t, width, height, pixelsPerDegree, &flipMap); });
+		double psnr = ImageMetrics::Psnr(mse);
+
+		float flipMax = 0.0f;
+		for(float e : flipMap)
+			flipMax = (std::max)(flipMax, e);
+
+		if(options.Has("diff") && !SaveMap(options.Get("diff"), flipMap, width, height))
+			return ExitError;
+		if(options.Has("ssim-map") && !SaveMap(options.Get("ssim-map"), ssimMap, width, height))
+			return ExitError;
+
+		// An absent threshold always passes.
+		bool pass = psnr >= options.GetNumber("min-psnr", -INFINITY) &&
+			ssim >= options.GetNumber("min-ssim", -INFINITY) &&
+			flip <= options.GetNumber("max-flip", INFINITY);
+
+		JsonReport report;
+		report.Add("command", "compare");
+		report.Add("reference", options.Positional[0]);
+		report.Add("test", options.Positional[1]);
+		report.Add("width", width);
+		report.Add("height", height);
+		report.Add("mse", mse);
+		report.Add("psnr", psnr);
+		report.Add("ssim", ssim);
+		report.Add("flip_mean", flip);
+		report.Add("flip_max", flipMax);
+		report.Add("pixels_per_degree", pixelsPerDegree);
+		report.Add("mse_ms", mseTime*1000.0);
+		report.Add("ssim_ms", ssimTime*1000.0);
+		report.Add("flip_ms", flipTime*1000.0);
+		report.AddBool("pass", pass);
+		if(!report.Write(options))
+			return ExitError;
+
+		return pass ? ExitPass : ExitFail;
+	}
+
+	int Sobel(const Options& options)
+	{
+		if(options.Positional.size() != 2)
+			return ExitError;
+
+		DDSDecoder::Image input, edges;
+		if(!ReadImage(options.Positional[0], options, input))
+			return ExitError;
+
+		double sobelTime = Seconds([&]() { ReferencePasses::Sobel(input, edges); });
+		if(!WriteImage(options.Positional[1], edges))
+			return ExitError;
+
+		JsonReport report;
+		report.Add("command", "sobel");
+		report.Add("input", options.Positional[0]);
+		report.Add("output", options.Positional[1]);
+		report.Add("sobel_ms", sobelTime*1000.0);
+
+		if(options.Has("composite"))
+		{
+			DDSDecoder::Image composite;
+			double compositeTime = Seconds([&]() { ReferencePasses::Composite(input, edges, composite); });
+			if(!WriteImage(options.Get("composite"), composite))
+				return ExitError;
+
+			report.Add("composite", options.Get("composite"));
+			report.Add("composite_ms", compositeTime*1000.0);
+		}
+
+		return report.Write(options) ? ExitPass : ExitError;
+	}
+
+	bool ParseMethod(const std::string& name, GaussianBlur::Method& method)
+	{
+		if(name == "auto")
+			method = GaussianBlur::Method::Auto;
+		else if(name == "exact")
+			method = GaussianBlur::Method::Exact;
+		else if(name == "box")
+			method = GaussianBlur::Method::ExtendedBox;
+		else
+			return false;
+		return true;
+	}
+
+	int Blur(const Options& options)
+	{
+		GaussianBlur::Method method;
+		if(options.Positional.size() != 2 || !options.Has("sigma") || !ParseMethod(options.Get("method", "auto"), method))
+			return ExitError;
+
+		DDSDecoder::Image image;
+		if(!ReadImage(options.Positional[0], options, image))
+			return ExitError;
+
+		float sigma = (float)options.GetNumber("sigma", 0.0);
+		GaussianBlur blur;
+		double blurTime = Seconds([&]() {
+			blur.Blur(image.Texels.data(), image.Texels.data(), image.Width, image.Height,
+				image.Width*sizeof(XMFLOAT4), FormatR32G32B32A32Float, sigma, method);
+		});
+
+		if(!WriteImage(options.Positional[1], image))
+			return ExitError;
+
+		JsonReport report;
+		report.Add("command", "blur");
+		report.Add("input", options.Positional[0]);
+		report.Add("output", options.Positional[1]);
+		report.Add("sigma", sigma);
+		report.Add("method", options.Get("method", "auto"));
+		report.Add("blur_ms", blurTime*1000.0);
+		return report.Write(options) ? ExitPass : ExitError;
+	}
+
+	int Bench(const Options& options)
+	{
+		if(options.Positional.size() != 1)
+			return ExitError;
+
+		DDSDecoder::Image input;
+		if(!ReadImage(options.Positional[0], options, input))
+			return ExitError;
+
+		const uint32_t width = input.Width;
+		const uint32_t height = input.Height;
+		const double megapixels = (double)width*height / 1.0e6;
+		const int repeat = (std::max)(1, (int)options.GetNumber("repeat", 5));
+
+		DDSDecoder::Image edges, composite, blurred = input;
+		GaussianBlur blur;
+		auto blurPass = [&](float sigma, GaussianBlur::Method method)
+		{
+			return [&blur, &blurred, sigma, method]()
+			{
+				blur.Blur(blurred.Texels.data(), blurred.Texels.data(), blurred.Width, blurred.Height,
+					blurred.Width*sizeof(XMFLOAT4), FormatR32G32B32A32Float, sigma, method);
+			};
+		};
+
+		const XMFLOAT4* a = input.Texels.data();
+		std::vector<std::pair<std::string, std::function<void()>>> passes =
+		{
+			{ "sobel", [&]() { ReferencePasses::Sobel(input, edges); } },
+			{ "composite", [&]() { ReferencePasses::Composite(input, edges, composite); } },
+			{ "blur_exact_2.5", blurPass(2.5f, GaussianBlur::Method::Exact) },
+			{ "blur_box_16", blurPass(16.0f, GaussianBlur::Method::ExtendedBox) },
+			{ "mse", [&]() { ImageMetrics::MeanSquaredError(a, edges.Texels.data(), width, height); } },
+			{ "ssim", [&]() { ImageMetrics::Ssim(a, edges.Texels.data(), width, height); } },
+			{ "flip", [&]() { ImageMetrics::Flip(a, edges.Texels.data(), width, height); } }
+		};
+
+		// Gates of the form pass=MP/s.
+		std::map<std::string, double> minimums;
+		auto range = options.Named.equal_range("min-mps");
+		for(auto it = range.first; it != range.second; ++it)
+		{
+			size_t equals = it->second.find('=');
+			if(equals == std::string::npos)
+				return ExitError;
+			minimums[it->second.substr(0, equals)] = atof(it->second.c_str() + equals + 1);
+		}
+
+		JsonReport report;
+		report.Add("command", "bench");
+		report.Add("input", options.Positional[0]);
+		report.Add("width", width);
+		report.Add("height", height);
+		report.Add("threads", ThreadPool::Default().ThreadCount());
+		report.Add("repeat", repeat);
+
+		// The best of the runs, which is the least disturbed by the rest of the machine.
+		bool pass = true;
+		for(auto& p : passes)
+		{
+			p.second();
+			double best = INFINITY;
+			for(int i = 0; i < repeat; ++i)
+				best = (std::min)(best, Seconds(p.second));
+
+			double rate = megapixels / best;
+			report.Add(p.first + "_ms", best*1000.0);
+			report.Add(p.first + "_mps", rate);
+
+			auto minimum = minimums.find(p.first);
+			if(minimum != minimums.end() && rate < minimum->second)
+				pass = false;
+		}
+
+		report.AddBool("pass", pass);
+		if(!report.Write(options))
+			return ExitError;
+		return pass ? ExitPass : ExitFail;
+	}
+
+	// Power of an n x n map with its mean taken out, averaged over rings of the
+	// frequency plane; ring r holds the frequencies whose length rounds to r.
+	std::vector<double> RadialPower(const float* values, uint32_t n)
+	{
+		double mean = 0.0;
+		for(uint32_t i = 0; i < n*n; ++i)
+			mean += values[i];
+		mean /= n*n;
+
+		std::vector<float> re(n*n), im(n*n, 0.0f);
+		for(uint32_t i = 0; i < n*n; ++i)
+			re[i] = (float)(values[i] - mean);
+
+		Fft fft(n);
+		fft.Transform2D(re.data(), im.data(), false);
+
+		std::vector<double> power(n/2 + 1, 0.0);
+		std::vector<uint32_t> counts(n/2 + 1, 0);
+		for(uint32_t y = 0; y < n; ++y)
+		{
+			for(uint32_t x = 0; x < n; ++x)
+			{
+				int kx = x < n/2 ? (int)x : (int)x - (int)n;
+				int ky = y < n/2 ? (int)y : (int)y - (int)n;
+				uint32_t ring = (uint32_t)(std::sqrt((double)(kx*kx + ky*ky)) + 0.5);
+				if(ring > n/2)
+					continue;
+
+				size_t i = (size_t)y*n + x;
+				power[ring] += ((double)re[i]*re[i] + (double)im[i]*im[i]) / (n*n);
+				++counts[ring];
+			}
+		}
+
+		for(uint32_t r = 0; r <= n/2; ++r)
+			power[r] = counts[r] != 0 ? power[r] / counts[r] : 0.0;
+		return power;
+	}
+
+	// Mean power of the rings up to n/8 over the mean of all the rings but the
+	// constant one.  Blue noise has little power at low frequencies, so this is well
+	// below the 1 white noise gives.
+	double LowFrequencyPower(const float* values, uint32_t n)
+	{
+		std::vector<double> power = RadialPower(values, n);
+
+		double low = 0.0, all = 0.0;
+		for(uint32_t r = 1; r <= n/2; ++r)
+		{
+			all += power[r];
+			if(r <= n/8)
+				low += power[r];
+		}
+		return (low / (n/8)) / (all / (n/2));
+	}
+
+	int Noise(const Options& options)
+	{
+		if(options.Positional.size() != 1)
+			return ExitError;
+
+		const uint32_t size = (uint32_t)options.GetNumber("size", 64);
+		const uint32_t depth = (uint32_t)options.GetNumber("depth", 1);
+		const uint32_t seed = (uint32_t)options.GetNumber("seed", 1);
+		if(size < 16 || (size & (size - 1)) != 0 || depth == 0)
+			return ExitError;
+
+		// One independent map per channel.
+		std::vector<float> channels[4];
+		double noiseTime = Seconds([&]()
+		{
+			for(uint32_t c = 0; c < 4; ++c)
+			{
+				channels[c] = depth == 1 ?
+					SampleSets::BlueNoise(size, seed + c) :
+					SampleSets::SpatiotemporalBlueNoise(size, depth, seed + c);
+			}
+		});
+
+		DDSDecoder::Image image;
+		image.Width = size;
+		image.Height = size*depth;
+		image.Format = FormatR32G32B32A32Float;
+		image.Texels.resize(channels[0].size());
+		for(size_t i = 0; i < image.Texels.size(); ++i)
+			image.Texels[i] = XMFLOAT4(channels[0][i], channels[1][i], channels[2][i], channels[3][i]);
+
+		if(!WriteImage(options.Positional[0], image))
+			return ExitError;
+
+		// White noise of the same size for scale: the ranks in a random order.
+		std::vector<float> white(size*size);
+		std::iota(white.begin(), white.end(), 0.0f);
+		std::mt19937 random(seed);
+		for(uint32_t i = size*size - 1; i > 0; --i)
+			std::swap(white[i], white[random() % (i + 1)]);
+
+		JsonReport report;
+		report.Add("command", "noise");
+		report.Add("output", options.Positional[0]);
+		report.Add("size", size);
+		report.Add("depth", depth);
+		report.Add("seed", seed);
+		report.Add("noise_ms", noiseTime*1000.0);
+		report.Add("white_low_power", LowFrequencyPower(white.data(), size));
+
+		// Every slice of every channel is checked; the worst one is reported.
+		double worst = 0.0;
+		for(uint32_t c = 0; c < 4; ++c)
+			for(uint32_t slice = 0; slice < depth; ++slice)
+				worst = (std::max)(worst, LowFrequencyPower(&channels[c][(size_t)slice*size*size], size));
+		report.Add("low_power_max", worst);
+
+		// Across slices, the mean step a texel takes from one slice to the next;
+		// independent values give 1/3.
+		if(depth > 1)
+		{
+			double step = 0.0;
+			for(uint32_t c = 0; c < 4; ++c)
+				for(uint32_t slice = 0; slice < depth; ++slice)
+					for(uint32_t i = 0; i < size*size; ++i)
+						step += std::fabs(channels[c][(size_t)slice*size*size + i] -
+							channels[c][(size_t)((slice + 1) % depth)*size*size + i]);
+			report.Add("temporal_step_mean", step / (4.0*depth*size*size));
+		}
+
+		bool pass = worst <= options.GetNumber("max-low-power", INFINITY);
+		report.AddBool("pass", pass);
+		if(!report.Write(options))
+			return ExitError;
+		return pass ? ExitPass : ExitFail;
+	}
+
+	// The SH as an HLSL array, for a shader to #include.
+	bool WriteSH(const std::string& path, const EnvironmentBaker::SH9& sh)
+	{
+		std::ofstream file(path);
+		file.precision(9);
+		file << "// L2 irradiance SH baked by ImageCheck; see EnvironmentBaker::IrradianceSH.\n";
+		file << "static const float3 gIrradianceSH[9] =\n{\n";
+		for(int k = 0; k < 9; ++k)
+			file << "    float3(" << sh.C[k].x << ", " << sh.C[k].y << ", " << sh.C[k].z << ")" << (k < 8 ? ",\n" : "\n");
+		file << "};\n";
+		return (bool)file;
+	}
+
+	int Bake(const Options& options)
+	{
+		if(options.Positional.size() != 2)
+			return ExitError;
+
+		const std::string& prefix = options.Positional[1];
+		const uint32_t runtimeSize = (uint32_t)options.GetNumber("runtime-size", 16);
+
+		EnvironmentBaker::CubeMap cube;
+		if(!ImageIO::LoadCube(options.Positional[0], cube, (uint32_t)options.GetNumber("face-size", 256)))
+		{
+			std::cerr << "Cannot load " << options.Positional[0] << "\n";
+			return ExitError;
+		}
+
+		// The mips and the runtime size need whole halvings.
+		const uint32_t size = cube.Size;
+		if((size & (size - 1)) != 0 || runtimeSize == 0 || runtimeSize > size || (runtimeSize & (runtimeSize - 1)) != 0)
+			return ExitError;
+
+		EnvironmentBaker::Desc desc;
+		desc.SpecularSamples = (uint32_t)options.GetNumber("samples", desc.SpecularSamples);
+		desc.SpecularSize = (uint32_t)options.GetNumber("specular-size", desc.SpecularSize);
+		desc.BrdfLutSize = (uint32_t)options.GetNumber("lut-size", desc.BrdfLutSize);
+		EnvironmentBaker baker(desc);
+
+		EnvironmentBaker::SH9 irradiance;
+		double shTime = Seconds([&]() { irradiance = EnvironmentBaker::IrradianceSH(baker.ProjectSH(cube)); });
+
+		baker.GenerateMips(cube);
+
+		EnvironmentBaker::CubeMap specular;
+		double specularTime = Seconds([&]() { specular = baker.PrefilterSpecular(cube); });
+
+		DDSDecoder::Image lut;
+		double lutTime = Seconds([&]() { lut = baker.IntegrateBrdf(); });
+
+		if(!ImageIO::SaveCube(prefix + "_specular.dds", specular) || !WriteImage(prefix + "_brdf.dds", lut) ||
+			!WriteSH(prefix + "_sh.hlsli", irradiance))
+		{
+			std::cerr << "Cannot save " << prefix << "_*\n";
+			return ExitError;
+		}
+
+		// The runtime path: the same projection of a mip the size of a probe's readback.
+		const XMFLOAT4* faces[EnvironmentBaker::FaceCount];
+		uint32_t runtimeMip = 0;
+		while((size >> runtimeMip) > runtimeSize)
+			++runtimeMip;
+		for(int face = 0; face < EnvironmentBaker::FaceCount; ++face)
+			faces[face] = cube.Face(face, runtimeMip).Texels.data();
+
+		const int repeat = 100;
+		EnvironmentBaker::SH9 runtime;
+		baker.ProjectSH(faces, runtimeSize, runtimeSize*sizeof(XMFLOAT4));
+		double runtimeTime = Seconds([&]()
+		{
+			for(int i = 0; i < repeat; ++i)
+				runtime = baker.ProjectSH(faces, runtimeSize, runtimeSize*sizeof(XMFLOAT4));
+		}) / repeat;
+		runtime = EnvironmentBaker::IrradianceSH(runtime);
+
+		// Irradiance of both along the 26 directions to the cube's faces, edges and
+		// corners, against the largest of the full size one.
+		double largest = 0.0, difference = 0.0;
+		for(int z = -1; z <= 1; ++z)
+			for(int y = -1; y <= 1; ++y)
+				for(int x = -1; x <= 1; ++x)
+				{
+					if(x == 0 && y == 0 && z == 0)
+						continue;
+
+					XMVECTOR n = XMVectorSet((float)x, (float)y, (float)z, 0.0f);
+					XMVECTOR full = EnvironmentBaker::EvaluateSH(irradiance, n);
+					XMVECTOR reduced = EnvironmentBaker::EvaluateSH(runtime, n);
+					largest = (std::max)(largest, (double)XMVectorGetX(XMVector3Length(full)));
+					difference = (std::max)(difference, (double)XMVectorGetX(XMVector3Length(XMVectorSubtract(full, reduced))));
+				}
+		double shError = largest > 0.0 ? difference / largest : 0.0;
+
+		JsonReport report;
+		report.Add("command", "bake");
+		report.Add("input", options.Positional[0]);
+		report.Add("face_size", size);
+		report.Add("specular_size", specular.Size);
+		report.Add("specular_mips", specular.MipCount);
+		report.Add("samples", desc.SpecularSamples);
+		report.Add("sh_ms", shTime*1000.0);
+		report.Add("specular_ms", specularTime*1000.0);
+		report.Add("lut_ms", lutTime*1000.0);
+		report.Add("runtime_size", runtimeSize);
+		report.Add("runtime_sh_ms", runtimeTime*1000.0);
+		report.Add("runtime_sh_error", shError);
+		report.Add("irradiance_mean_r", irradiance.C[0].x*0.282095);
+		report.Add("irradiance_mean_g", irradiance.C[0].y*0.282095);
+		report.Add("irradiance_mean_b", irradiance.C[0].z*0.282095);
+
+		// A smooth surface seen head on reflects all of F0 and nothing else.
+		const XMFLOAT4& smooth = lut.Texels[lut.Width - 1];
+		report.Add("lut_smooth_scale", smooth.x);
+		report.Add("lut_smooth_bias", smooth.y);
+
+		bool pass = shError <= options.GetNumber("max-sh-error", INFINITY);
+		report.AddBool("pass", pass);
+		if(!report.Write(options))
+			return ExitError;
+		return pass ? ExitPass : ExitFail;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if(argc < 2 || !ParseOptions(argc, argv, options))
+	{
+		std::cerr << "Usage: ImageCheck compare|sobel|blur|bench|noise|bake ... (see ImageCheck.cpp)\n";
+		return ExitError;
+	}
+
+	std::string command = argv[1];
+	int result = ExitError;
+	if(command == "compare")
+		result = Compare(options);
+	else if(command == "sobel")
+		result = Sobel(options);
+	else if(command == "blur")
+		result = Blur(options);
+	else if(command == "bench")
+		result = Bench(options);
+	else if(command == "noise")
+		result = Noise(options);
+	else if(command == "bake")
+		result = Bake(options);
+
+	if(result == ExitError)
+		std::cerr << "ImageCheck " << command << " failed\n";
+	return result;
+}
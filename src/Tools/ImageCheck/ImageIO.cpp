@@ -0,0 +1,344 @@
+//***************************************************************************************
+// ImageIO.cpp
+//***************************************************************************************
+
+#include "ImageIO.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// The stb headers the TAA sample's Cauldron framework already ships.
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../../Chapter 24 TAA/TAA/Kits/OpenSource/stb/stb_image.h"
+#include "../../Chapter 24 TAA/TAA/Kits/OpenSource/stb/stb_image_write.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// DXGI_FORMAT_R32G32B32A32_FLOAT
+	const uint32_t FormatR32G32B32A32Float = 2;
+
+	std::string Extension(const std::string& path)
+	{
+		size_t dot = path.find_last_of('.');
+		if(dot == std::string::npos)
+			return std::string();
+
+		std::string ext = path.substr(dot + 1);
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+		return ext;
+	}
+
+	bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if(!file.is_open())
+			return false;
+
+		std::streamoff size = file.tellg();
+		if(size <= 0)
+			return false;
+
+		data.resize((size_t)size);
+		file.seekg(0, std::ios::beg);
+		file.read(reinterpret_cast<char*>(data.data()), size);
+		return (bool)file;
+	}
+
+	bool LoadStb(const std::string& path, DDSDecoder::Image& image)
+	{
+		int width, height, components;
+		const char* name = path.c_str();
+
+		if(stbi_is_hdr(name))
+		{
+			float* texels = stbi_loadf(name, &width, &height, &components, 4);
+			if(texels == nullptr)
+				return false;
+			image.Texels.assign(reinterpret_cast<XMFLOAT4*>(texels), reinterpret_cast<XMFLOAT4*>(texels) + width*height);
+			stbi_image_free(texels);
+		}
+		else if(stbi_is_16_bit(name))
+		{
+			stbi_us* texels = stbi_load_16(name, &width, &height, &components, 4);
+			if(texels == nullptr)
+				return false;
+			image.Texels.resize(width*height);
+			for(int i = 0; i < width*height; ++i)
+			{
+				const stbi_us* t = texels + 4*i;
+				image.Texels[i] = XMFLOAT4(t[0] / 65535.0f, t[1] / 65535.0f, t[2] / 65535.0f, t[3] / 65535.0f);
+			}
+			stbi_image_free(texels);
+		}
+		else
+		{
+			stbi_uc* texels = stbi_load(name, &width, &height, &components, 4);
+			if(texels == nullptr)
+				return false;
+			image.Texels.resize(width*height);
+			for(int i = 0; i < width*height; ++i)
+			{
+				const stbi_uc* t = texels + 4*i;
+				image.Texels[i] = XMFLOAT4(t[0] / 255.0f, t[1] / 255.0f, t[2] / 255.0f, t[3] / 255.0f);
+			}
+			stbi_image_free(texels);
+		}
+
+		image.Width = (uint32_t)width;
+		image.Height = (uint32_t)height;
+		image.Format = FormatR32G32B32A32Float;
+		return true;
+	}
+
+	// "PF" (RGB) or "Pf" (grey), the size, and a scale whose sign gives the byte
+	// order.  Rows go from the bottom up.
+	bool LoadPfm(const std::vector<uint8_t>& data, DDSDecoder::Image& image)
+	{
+		std::string text(reinterpret_cast<const char*>(data.data()), (std::min)(data.size(), (size_t)256));
+		std::istringstream header(text);
+
+		std::string magic;
+		int width = 0, height = 0;
+		float scale = 0.0f;
+		header >> magic >> width >> height >> scale;
+		if(!header || (magic != "PF" && magic != "Pf") || width <= 0 || height <= 0 || scale >= 0.0f)
+			return false;
+
+		// A single whitespace character follows the scale.
+		size_t offset = (size_t)header.tellg() + 1;
+		int channels = magic == "PF" ? 3 : 1;
+		if(data.size() < offset + (size_t)width*height*channels*sizeof(float))
+			return false;
+
+		const float* values = reinterpret_cast<const float*>(data.data() + offset);
+		image.Texels.resize(width*height);
+		for(int y = 0; y < height; ++y)
+		{
+			for(int x = 0; x < width; ++x)
+			{
+				const float* v = values + ((size_t)(height - 1 - y)*width + x)*channels;
+				image.Texels[y*width + x] = channels == 3 ?
+					XMFLOAT4(v[0], v[1], v[2], 1.0f) : XMFLOAT4(v[0], v[0], v[0], 1.0f);
+			}
+		}
+
+		image.Width = (uint32_t)width;
+		image.Height = (uint32_t)height;
+		image.Format = FormatR32G32B32A32Float;
+		return true;
+	}
+
+	// Writes count images of the same format one after the other: a 2D image, or the
+	// faces of a cube map, each with its mipCount mips.
+	bool SaveDds(const std::string& path, const DDSDecoder::Image* images, uint32_t count, uint32_t mipCount, bool cube)
+	{
+		// Magic, a 124 byte header with a DX10 pixel format, and the DX10 header.
+		uint32_t header[1 + 31 + 5] = {};
+		header[0] = 0x20534444;                   // "DDS "
+		header[1] = 124;                          // size
+		header[2] = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000; // caps, height, width, pitch, pixel format
+		header[3] = images[0].Height;
+		header[4] = images[0].Width;
+		header[5] = images[0].Width*sizeof(XMFLOAT4); // pitch
+		header[7] = mipCount;                     // mip count
+		header[19] = 32;                          // pixel format size
+		header[20] = 0x4;                         // four cc
+		header[21] = 0x30315844;                  // "DX10"
+		header[27] = 0x1000;                      // texture
+		header[32] = FormatR32G32B32A32Float;
+		header[33] = 3;                           // 2D texture
+		header[35] = 1;                           // array size
+
+		if(mipCount > 1)
+		{
+			header[2] |= 0x20000;                 // mip count
+			header[27] |= 0x8 | 0x400000;         // complex, mip map
+		}
+		if(cube)
+		{
+			header[27] |= 0x8;                    // complex
+			header[28] = 0x200 | 0xfc00;          // cube map, all faces
+			header[34] = 0x4;                     // texture cube
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(header), sizeof(header));
+		for(uint32_t i = 0; i < count; ++i)
+			file.write(reinterpret_cast<const char*>(images[i].Texels.data()), images[i].Texels.size()*sizeof(XMFLOAT4));
+		return (bool)file;
+	}
+
+	// Resamples a latitude-longitude panorama (u along the azimuth from -Z towards
+	// +X, v from +Y down) to a cube map with bilinear lookups.
+	void PanoramaToCube(const DDSDecoder::Image& panorama, uint32_t faceSize, EnvironmentBaker::CubeMap& cube)
+	{
+		cube.Size = faceSize;
+		cube.MipCount = 1;
+		cube.Faces.resize(EnvironmentBaker::FaceCount);
+
+		const uint32_t width = panorama.Width;
+		const uint32_t height = panorama.Height;
+		auto texel = [&](int x, int y)
+		{
+			x = (x % (int)width + (int)width) % (int)width;
+			y = (std::min)((std::max)(y, 0), (int)height - 1);
+			return XMLoadFloat4(&panorama.Texels[(size_t)y*width + x]);
+		};
+
+		for(int face = 0; face < EnvironmentBaker::FaceCount; ++face)
+		{
+			DDSDecoder::Image& image = cube.Face(face);
+			image.Width = faceSize;
+			image.Height = faceSize;
+			image.Format = FormatR32G32B32A32Float;
+			image.Texels.resize((size_t)faceSize*faceSize);
+
+			for(uint32_t y = 0; y < faceSize; ++y)
+			{
+				for(uint32_t x = 0; x < faceSize; ++x)
+				{
+					XMFLOAT3 d;
+					XMStoreFloat3(&d, EnvironmentBaker::TexelDirection(face, x, y, faceSize));
+
+					float u = 0.5f + atan2f(d.x, -d.z) / XM_2PI;
+					float v = acosf((std::min)((std::max)(d.y, -1.0f), 1.0f)) / XM_PI;
+					float px = u*width - 0.5f;
+					float py = v*height - 0.5f;
+					int x0 = (int)floorf(px);
+					int y0 = (int)floorf(py);
+					float fx = px - x0;
+					float fy = py - y0;
+
+					XMVECTOR top = XMVectorLerp(texel(x0, y0), texel(x0 + 1, y0), fx);
+					XMVECTOR bottom = XMVectorLerp(texel(x0, y0 + 1), texel(x0 + 1, y0 + 1), fx);
+					XMStoreFloat4(&image.Texels[(size_t)y*faceSize + x], XMVectorLerp(top, bottom, fy));
+				}
+			}
+		}
+	}
+
+	bool SavePng(const std::string& path, const DDSDecoder::Image& image)
+	{
+		std::vector<uint8_t> texels(image.Texels.size()*4);
+		for(size_t i = 0; i < image.Texels.size(); ++i)
+		{
+			const float* c = &image.Texels[i].x;
+			for(int k = 0; k < 4; ++k)
+				texels[4*i + k] = (uint8_t)((std::min)((std::max)(c[k], 0.0f), 1.0f)*255.0f + 0.5f);
+		}
+
+		return stbi_write_png(path.c_str(), (int)image.Width, (int)image.Height, 4,
+			texels.data(), (int)image.Width*4) != 0;
+	}
+
+	bool SavePfm(const std::string& path, const DDSDecoder::Image& image)
+	{
+		std::ofstream file(path, std::ios::binary);
+		file << "PF\n" << image.Width << " " << image.Height << "\n-1.0\n";
+
+		std::vector<float> row(image.Width*3);
+		for(uint32_t y = 0; y < image.Height; ++y)
+		{
+			const XMFLOAT4* texels = &image.Texels[(size_t)(image.Height - 1 - y)*image.Width];
+			for(uint32_t x = 0; x < image.Width; ++x)
+			{
+				row[3*x + 0] = texels[x].x;
+				row[3*x + 1] = texels[x].y;
+				row[3*x + 2] = texels[x].z;
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), row.size()*sizeof(float));
+		}
+		return (bool)file;
+	}
+}
+
+bool ImageIO::Load(const std::string& path, DDSDecoder::Image& image, uint32_t rawWidth, uint32_t rawHeight)
+{
+	std::string ext = Extension(path);
+	if(ext != "dds" && ext != "pfm" && ext != "raw")
+		return LoadStb(path, image);
+
+	std::vector<uint8_t> data;
+	if(!ReadFile(path, data))
+		return false;
+
+	if(ext == "dds")
+		return DDSDecoder::LoadFromMemory(data.data(), data.size(), image);
+
+	if(ext == "pfm")
+		return LoadPfm(data, image);
+
+	size_t count = (size_t)rawWidth*rawHeight;
+	if(count == 0 || data.size() != count*sizeof(XMFLOAT4))
+		return false;
+
+	image.Width = rawWidth;
+	image.Height = rawHeight;
+	image.Format = FormatR32G32B32A32Float;
+	image.Texels.resize(count);
+	std::memcpy(image.Texels.data(), data.data(), data.size());
+	return true;
+}
+
+bool ImageIO::Save(const std::string& path, const DDSDecoder::Image& image)
+{
+	std::string ext = Extension(path);
+	if(ext == "dds")
+		return SaveDds(path, &image, 1, 1, false);
+	if(ext == "png")
+		return SavePng(path, image);
+	if(ext == "pfm")
+		return SavePfm(path, image);
+	if(ext == "raw")
+	{
+		std::ofstream file(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(image.Texels.data()), image.Texels.size()*sizeof(XMFLOAT4));
+		return (bool)file;
+	}
+	return false;
+}
+
+bool ImageIO::LoadCube(const std::string& path, EnvironmentBaker::CubeMap& cube, uint32_t faceSize)
+{
+	if(Extension(path) == "dds")
+	{
+		std::vector<uint8_t> data;
+		DDSDecoder::Info info;
+		if(!ReadFile(path, data) || !DDSDecoder::GetInfo(data.data(), data.size(), info))
+			return false;
+
+		if(info.IsCube)
+		{
+			cube.Size = info.Width;
+			cube.MipCount = 1;
+			cube.Faces.resize(EnvironmentBaker::FaceCount);
+			for(int face = 0; face < EnvironmentBaker::FaceCount; ++face)
+			{
+				if(!DDSDecoder::LoadFromMemory(data.data(), data.size(), cube.Face(face), 0, face))
+					return false;
+			}
+			return true;
+		}
+	}
+
+	DDSDecoder::Image panorama;
+	if(faceSize == 0 || !Load(path, panorama))
+		return false;
+
+	PanoramaToCube(panorama, faceSize, cube);
+	return true;
+}
+
+bool ImageIO::SaveCube(const std::string& path, const EnvironmentBaker::CubeMap& cube)
+{
+	if(Extension(path) != "dds" || cube.Faces.empty())
+		return false;
+	return SaveDds(path, cube.Faces.data(), (uint32_t)cube.Faces.size(), cube.MipCount, true);
+}
@@ -0,0 +1,36 @@
+//***************************************************************************************
+// ImageIO.h
+//
+// Reads and writes whole images as floating point texels, for comparing the output of
+// a pass with a reference outside the samples.
+//
+//   .dds   read through DDSDecoder (any format it supports), written as
+//          R32G32B32A32_FLOAT so nothing is lost.
+//   .png   and the other formats stb_image reads (.tga, .bmp, .jpg, .hdr) for reading;
+//          .png is written as 8-bit RGBA.  8 and 16-bit values map to [0,1] as
+//          stored, without an sRGB conversion.
+//   .pfm   portable float map, RGB or grey.  Written as RGB.
+//   .raw   RGBA32F texels with no header, row by row; the size has to be given.
+//
+// Cube maps are read from cube map .dds files, or from any other image taken as a
+// latitude-longitude panorama, and written as R32G32B32A32_FLOAT .dds cube maps with
+// their mips.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/DDSDecoder.h"
+#include "../../Common/EnvironmentBaker.h"
+#include <string>
+
+namespace ImageIO
+{
+	// rawWidth and rawHeight are only used for .raw files.
+	bool Load(const std::string& path, DDSDecoder::Image& image, uint32_t rawWidth = 0, uint32_t rawHeight = 0);
+	bool Save(const std::string& path, const DDSDecoder::Image& image);
+
+	// faceSize is the face size panoramas are resampled to; cube map files keep theirs.
+	// Only the top mip is read.
+	bool LoadCube(const std::string& path, EnvironmentBaker::CubeMap& cube, uint32_t faceSize = 0);
+	bool SaveCube(const std::string& path, const EnvironmentBaker::CubeMap& cube);
+}
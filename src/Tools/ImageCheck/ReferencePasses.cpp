@@ -0,0 +1,99 @@
+//***************************************************************************************
+// ReferencePasses.cpp
+//***************************************************************************************
+
+#include "ReferencePasses.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <functional>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t FormatR32G32B32A32Float = 2;
+
+	const uint32_t RowsPerTask = 16;
+
+	void ForEachRowTile(ThreadPool* pool, uint32_t height, const std::function<void(uint32_t, uint32_t)>& rows)
+	{
+		if(pool == nullptr)
+			pool = &ThreadPool::Default();
+
+		pool->ParallelFor((height + RowsPerTask - 1) / RowsPerTask, [&](uint32_t task)
+		{
+			uint32_t first = task*RowsPerTask;
+			rows(first, (std::min)(height, first + RowsPerTask));
+		});
+	}
+}
+
+void ReferencePasses::Sobel(const DDSDecoder::Image& input, DDSDecoder::Image& output, ThreadPool* pool)
+{
+	const int width = (int)input.Width;
+	const int height = (int)input.Height;
+
+	output.Width = input.Width;
+	output.Height = input.Height;
+	output.Format = FormatR32G32B32A32Float;
+	output.Texels.resize(input.Texels.size());
+
+	auto load = [&](int x, int y)
+	{
+		if(x < 0 || y < 0 || x >= width || y >= height)
+			return XMVectorZero();
+		return XMLoadFloat4(&input.Texels[y*width + x]);
+	};
+
+	const XMVECTOR two = XMVectorReplicate(2.0f);
+	const XMVECTOR luminance = XMVectorSet(0.299f, 0.587f, 0.114f, 0.0f);
+
+	ForEachRowTile(pool, input.Height, [&](uint32_t first, uint32_t last)
+	{
+		for(int y = (int)first; y < (int)last; ++y)
+		{
+			for(int x = 0; x < width; ++x)
+			{
+				// c[i][j] is the texel at (x - 1 + j, y - 1 + i), as in the shader.
+				XMVECTOR c[3][3];
+				for(int i = 0; i < 3; ++i)
+					for(int j = 0; j < 3; ++j)
+						c[i][j] = load(x - 1 + j, y - 1 + i);
+
+				XMVECTOR gx = XMVectorSubtract(
+					XMVectorAdd(XMVectorAdd(c[0][2], XMVectorMultiply(two, c[1][2])), c[2][2]),
+					XMVectorAdd(XMVectorAdd(c[0][0], XMVectorMultiply(two, c[1][0])), c[2][0]));
+
+				// The shader's Gy takes c[2][1] where the Sobel kernel has c[2][2]; the
+				// reference has to match the shader, not the textbook.
+				XMVECTOR gy = XMVectorSubtract(
+					XMVectorAdd(XMVectorAdd(c[0][0], XMVectorMultiply(two, c[0][1])), c[0][2]),
+					XMVectorAdd(XMVectorAdd(c[2][0], XMVectorMultiply(two, c[2][1])), c[2][1]));
+
+				XMVECTOR magnitude = XMVectorSqrt(XMVectorAdd(XMVectorMultiply(gx, gx), XMVectorMultiply(gy, gy)));
+				XMVECTOR edge = XMVectorSubtract(XMVectorSplatOne(),
+					XMVectorSaturate(XMVector3Dot(magnitude, luminance)));
+
+				XMStoreFloat4(&output.Texels[y*width + x], edge);
+			}
+		}
+	});
+}
+
+void ReferencePasses::Composite(const DDSDecoder::Image& base, const DDSDecoder::Image& edges,
+	DDSDecoder::Image& output, ThreadPool* pool)
+{
+	output.Width = base.Width;
+	output.Height = base.Height;
+	output.Format = FormatR32G32B32A32Float;
+	output.Texels.resize(base.Texels.size());
+
+	ForEachRowTile(pool, base.Height, [&](uint32_t first, uint32_t last)
+	{
+		for(size_t i = (size_t)first*base.Width; i < (size_t)last*base.Width; ++i)
+		{
+			XMVECTOR c = XMVectorMultiply(XMLoadFloat4(&base.Texels[i]), XMLoadFloat4(&edges.Texels[i]));
+			XMStoreFloat4(&output.Texels[i], c);
+		}
+	});
+}
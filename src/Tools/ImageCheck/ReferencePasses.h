@@ -0,0 +1,24 @@
+//***************************************************************************************
+// ReferencePasses.h
+//
+// CPU versions of the SobelFilter sample's post-processing passes, written to give
+// what the shaders give, so a rewritten shader can be compared with them.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/DDSDecoder.h"
+
+class ThreadPool;
+
+namespace ReferencePasses
+{
+	// SobelCS in Sobel.hlsl: edges black, the rest white.  Texels outside the image
+	// read as 0, as out of range loads do on the GPU.  pool defaults to
+	// ThreadPool::Default().
+	void Sobel(const DDSDecoder::Image& input, DDSDecoder::Image& output, ThreadPool* pool = nullptr);
+
+	// PS in Composite.hlsl: the base image times the edge image.  Both have the same size.
+	void Composite(const DDSDecoder::Image& base, const DDSDecoder::Image& edges, DDSDecoder::Image& output,
+		ThreadPool* pool = nullptr);
+}
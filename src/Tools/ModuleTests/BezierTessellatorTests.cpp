@@ -0,0 +1,310 @@
+//***************************************************************************************
+// BezierTessellatorTests.cpp
+//
+// The vectorized evaluation against de Casteljau, the factors against the D3D clamp
+// and rounding rules, and every triangulation against the unit square it must tile.
+// On a grid of patches cut from one lattice, the vertices two patches put on their
+// shared edge must be the very same, and the mesh must be the same bit for bit on
+// one thread and on four.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/BezierTessellator.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// A grid of patches over a rolling surface.  The control points come from one
+	// lattice, so neighbors share their border points as the patches of a model do.
+	std::vector<BezierTessellator::Patch> MakePatchGrid(int gridSize)
+	{
+		const int latticeSize = 3*gridSize + 1;
+		std::vector<XMFLOAT3> lattice(latticeSize*latticeSize);
+		for(int j = 0; j < latticeSize; ++j)
+		{
+			for(int i = 0; i < latticeSize; ++i)
+			{
+				float x = (i - latticeSize/2)*0.25f;
+				float z = (j - latticeSize/2)*0.25f;
+				lattice[j*latticeSize + i] = XMFLOAT3(x, 1.5f*sinf(0.4f*x)*cosf(0.3f*z), z);
+			}
+		}
+
+		std::vector<BezierTessellator::Patch> patches(gridSize*gridSize);
+		for(int pj = 0; pj < gridSize; ++pj)
+		{
+			for(int pi = 0; pi < gridSize; ++pi)
+			{
+				for(int row = 0; row < 4; ++row)
+					for(int col = 0; col < 4; ++col)
+						patches[pj*gridSize + pi].P[4*row + col] = lattice[(3*pj + row)*latticeSize + 3*pi + col];
+			}
+		}
+		return patches;
+	}
+
+	// The vertices of patch p on one edge, sorted.
+	std::vector<std::array<float, 3>> BorderPoints(const BezierTessellator::Mesh& mesh, uint32_t p, int edge)
+	{
+		std::vector<std::array<float, 3>> points;
+		for(uint32_t i = mesh.PatchVertexStart[p]; i < mesh.PatchVertexStart[p + 1]; ++i)
+		{
+			const BezierTessellator::Vertex& v = mesh.Vertices[i];
+			float t = (edge == 0 || edge == 2) ? v.Domain.x : v.Domain.y;
+			if(t == (edge < 2 ? 0.0f : 1.0f))
+				points.push_back({ { v.Pos.x, v.Pos.y, v.Pos.z } });
+		}
+		std::sort(points.begin(), points.end());
+		return points;
+	}
+
+	bool SameFactors(const BezierTessellator::Factors& a, const BezierTessellator::Factors& b)
+	{
+		return std::equal(a.Edge, a.Edge + 4, b.Edge) && std::equal(a.Inside, a.Inside + 2, b.Inside);
+	}
+}
+
+TEST_SUITE(BezierTessellator)
+{
+	std::mt19937 rng(45);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+	// Evaluation on random patches: the corners are control points, and the
+	// vectorized positions and normals match de Casteljau and its derivatives.
+	{
+		float maxPosError = 0.0f, maxNormalError = 0.0f;
+		bool corners = true;
+		for(int p = 0; p < 16; ++p)
+		{
+			BezierTessellator::Patch patch;
+			for(int i = 0; i < 16; ++i)
+				patch.P[i] = XMFLOAT3((i % 4) + 0.3f*signedUnit(rng), signedUnit(rng), (i / 4) + 0.3f*signedUnit(rng));
+
+			XMFLOAT3 c00 = BezierTessellator::Evaluate(patch, 0.0f, 0.0f);
+			XMFLOAT3 c11 = BezierTessellator::Evaluate(patch, 1.0f, 1.0f);
+			corners = corners && c00.x == patch.P[0].x && c00.y == patch.P[0].y && c00.z == patch.P[0].z;
+			corners = corners && fabsf(c11.x - patch.P[15].x) < 1e-6f && fabsf(c11.y - patch.P[15].y) < 1e-6f &&
+				fabsf(c11.z - patch.P[15].z) < 1e-6f;
+
+			// Seven points, so the last group of four is padded.
+			std::vector<XMFLOAT2> domain(7);
+			for(auto& d : domain)
+				d = XMFLOAT2(0.05f + 0.9f*unit(rng), 0.05f + 0.9f*unit(rng));
+			std::vector<BezierTessellator::Vertex> vertices(domain.size());
+			BezierTessellator::EvaluateVertices(patch, domain.data(), domain.size(), vertices.data());
+
+			for(size_t k = 0; k < domain.size(); ++k)
+			{
+				float u = domain[k].x, v = domain[k].y;
+				XMFLOAT3 reference = BezierTessellator::Evaluate(patch, u, v);
+				const XMFLOAT3& pos = vertices[k].Pos;
+				maxPosError = (std::max)(maxPosError, (std::max)(fabsf(pos.x - reference.x),
+					(std::max)(fabsf(pos.y - reference.y), fabsf(pos.z - reference.z))));
+
+				// du x dv by central differences.
+				const float h = 1.0e-3f;
+				auto point = [&](float pu, float pv)
+				{
+					XMFLOAT3 p = BezierTessellator::Evaluate(patch, pu, pv);
+					return XMLoadFloat3(&p);
+				};
+				XMVECTOR du = XMVectorSubtract(point(u + h, v), point(u - h, v));
+				XMVECTOR dv = XMVectorSubtract(point(u, v + h), point(u, v - h));
+				XMVECTOR expected = XMVector3Normalize(XMVector3Cross(du, dv));
+				XMVECTOR error = XMVector3Length(XMVectorSubtract(XMLoadFloat3(&vertices[k].Normal), expected));
+				maxNormalError = (std::max)(maxNormalError, XMVectorGetX(error));
+			}
+		}
+		ModuleTests::Report("evaluation: max position error %.2g, max normal error %.2g", maxPosError, maxNormalError);
+		CHECK(corners);
+		CHECK(maxPosError < 1e-5f);
+		CHECK(maxNormalError < 1e-2f);
+	}
+
+	// Clamping and rounding per partitioning.
+	{
+		BezierTessellator::Desc desc;
+		BezierTessellator::Factors raw = { { 0.5f, 2.3f, 100.0f, std::numeric_limits<float>::quiet_NaN() }, { 0.2f, 7.6f } };
+
+		desc.Partitioning = BezierTessellator::Partitioning::Integer;
+		BezierTessellator::Factors f = BezierTessellator(desc).ProcessFactors(raw);
+		BezierTessellator::Factors integer = { { 1.0f, 3.0f, 64.0f, 1.0f }, { 1.0f, 8.0f } };
+		CHECK(SameFactors(f, integer));
+
+		desc.Partitioning = BezierTessellator::Partitioning::FractionalEven;
+		f = BezierTessellator(desc).ProcessFactors(raw);
+		BezierTessellator::Factors even = { { 2.0f, 2.3f, 64.0f, 2.0f }, { 2.0f, 7.6f } };
+		CHECK(SameFactors(f, even));
+
+		// An odd inside factor of 1 moves just above 1 once any other factor is.
+		desc.Partitioning = BezierTessellator::Partitioning::FractionalOdd;
+		f = BezierTessellator(desc).ProcessFactors(raw);
+		CHECK(f.Edge[0] == 1.0f && f.Edge[1] == 2.3f && f.Edge[2] == 63.0f && f.Edge[3] == 1.0f);
+		CHECK(f.Inside[0] > 1.0f && f.Inside[0] < 1.001f && f.Inside[1] == 7.6f);
+
+		BezierTessellator::Factors ones = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } };
+		CHECK(SameFactors(BezierTessellator(desc).ProcessFactors(ones), ones));
+	}
+
+	// Every triangulation tiles the unit square: its points are in the domain, its
+	// triangles all turn the same way and their areas add up to 1.  Integer factors
+	// put factor + 1 points on an edge.
+	for(auto partitioning : { BezierTessellator::Partitioning::Integer,
+		BezierTessellator::Partitioning::FractionalOdd, BezierTessellator::Partitioning::FractionalEven })
+	{
+		BezierTessellator::Desc desc;
+		desc.Partitioning = partitioning;
+		desc.BucketStep = 0.0f;
+		BezierTessellator tessellator(desc);
+
+		int badTopologies = 0, badEdgeCounts = 0;
+		double maxAreaError = 0.0;
+		for(int k = 0; k < 200; ++k)
+		{
+			BezierTessellator::Factors factors;
+			for(float& e : factors.Edge)
+				e = 1.0f + 20.0f*unit(rng)*unit(rng);
+			for(float& i : factors.Inside)
+				i = 1.0f + 20.0f*unit(rng)*unit(rng);
+			if(k == 0)
+				factors = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 1.0f, 1.0f } };
+
+			const BezierTessellator::Topology& topology = tessellator.GetTopology(factors);
+
+			bool valid = !topology.Indices.empty() && topology.Indices.size() % 3 == 0;
+			for(const XMFLOAT2& d : topology.Domain)
+				valid = valid && d.x >= 0.0f && d.x <= 1.0f && d.y >= 0.0f && d.y <= 1.0f;
+			for(uint32_t index : topology.Indices)
+				valid = valid && index < topology.Domain.size();
+
+			double area = 0.0;
+			for(size_t t = 0; valid && t < topology.Indices.size(); t += 3)
+			{
+				const XMFLOAT2& a = topology.Domain[topology.Indices[t]];
+				const XMFLOAT2& b = topology.Domain[topology.Indices[t + 1]];
+				const XMFLOAT2& c = topology.Domain[topology.Indices[t + 2]];
+				// Clockwise with v down is a positive cross product.
+				double cross = ((double)b.x - a.x)*((double)c.y - a.y) - ((double)b.y - a.y)*((double)c.x - a.x);
+				valid = valid && cross > 0.0;
+				area += 0.5*cross;
+			}
+			badTopologies += valid ? 0 : 1;
+			maxAreaError = (std::max)(maxAreaError, fabs(area - 1.0));
+
+			if(partitioning == BezierTessellator::Partitioning::Integer)
+			{
+				BezierTessellator::Factors processed = tessellator.ProcessFactors(factors);
+				int onEdge = 0;
+				for(const XMFLOAT2& d : topology.Domain)
+					onEdge += d.x == 0.0f ? 1 : 0;
+				badEdgeCounts += onEdge == (int)processed.Edge[0] + 1 ? 0 : 1;
+			}
+		}
+		CHECK(badTopologies == 0);
+		CHECK(maxAreaError < 1e-6);
+		CHECK(badEdgeCounts == 0);
+	}
+
+	// A grid of patches seen from just off its near side, so the factors differ
+	// from patch to patch.
+	const int gridSize = 32;
+	const uint32_t patchCount = gridSize*gridSize;
+	std::vector<BezierTessellator::Patch> patches = MakePatchGrid(gridSize);
+
+	const float width = 1280.0f, height = 720.0f;
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 3.0f, -14.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*3.14159265f, width / height, 1.0f, 1000.0f);
+	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+	BezierTessellator::Desc desc;
+	ThreadPool serialPool(1), fourPool(4);
+	BezierTessellator tessellator(desc);
+	BezierTessellator serialTessellator(desc, &serialPool);
+	BezierTessellator fourTessellator(desc, &fourPool);
+
+	BezierTessellator::Mesh mesh, serialMesh, fourMesh;
+	tessellator.Tessellate(patches.data(), patchCount, viewProj, width, height, mesh);
+	serialTessellator.Tessellate(patches.data(), patchCount, viewProj, width, height, serialMesh);
+	fourTessellator.Tessellate(patches.data(), patchCount, viewProj, width, height, fourMesh);
+
+	CHECK(mesh.PatchVertexStart.size() == patchCount + 1 && mesh.PatchVertexStart[patchCount] == mesh.Vertices.size());
+	CHECK(mesh.Indices == serialMesh.Indices && mesh.Indices == fourMesh.Indices);
+
+	uint32_t mismatches = 0;
+	for(size_t i = 0; i < mesh.Vertices.size(); ++i)
+	{
+		for(const BezierTessellator::Mesh* other : { &serialMesh, &fourMesh })
+		{
+			const XMFLOAT3& a = mesh.Vertices[i].Pos;
+			const XMFLOAT3& b = other->Vertices[i].Pos;
+			mismatches += (a.x != b.x || a.y != b.y || a.z != b.z) ? 1 : 0;
+		}
+	}
+	CHECK(mismatches == 0);
+
+	// Neighbors agree on the factors of their shared edge and put the same vertices
+	// on it.
+	uint32_t sharedEdges = 0, crackedEdges = 0, disagreeingFactors = 0;
+	for(int pj = 0; pj < gridSize; ++pj)
+	{
+		for(int pi = 0; pi < gridSize; ++pi)
+		{
+			uint32_t p = pj*gridSize + pi;
+			BezierTessellator::Factors f = tessellator.ComputeFactors(patches[p], viewProj, width, height);
+			if(pi + 1 < gridSize)
+			{
+				++sharedEdges;
+				crackedEdges += BorderPoints(mesh, p, 2) != BorderPoints(mesh, p + 1, 0) ? 1 : 0;
+				disagreeingFactors += f.Edge[2] != tessellator.ComputeFactors(patches[p + 1], viewProj, width, height).Edge[0] ? 1 : 0;
+			}
+			if(pj + 1 < gridSize)
+			{
+				++sharedEdges;
+				crackedEdges += BorderPoints(mesh, p, 3) != BorderPoints(mesh, p + gridSize, 1) ? 1 : 0;
+				disagreeingFactors += f.Edge[3] != tessellator.ComputeFactors(patches[p + gridSize], viewProj, width, height).Edge[1] ? 1 : 0;
+			}
+		}
+	}
+	ModuleTests::Report("%u patches: %zu vertices, %zu triangles, %zu cached triangulations, %u of %u shared edges cracked",
+		patchCount, mesh.Vertices.size(), mesh.Indices.size() / 3, tessellator.CachedTopologyCount(), crackedEdges, sharedEdges);
+	CHECK(disagreeingFactors == 0);
+	CHECK(crackedEdges == 0);
+
+	// Tessellating again reuses the cached triangulations.
+	size_t cached = tessellator.CachedTopologyCount();
+	CHECK(cached > 1 && cached < patchCount);
+
+	const int repeats = 20;
+	double factorsTime = ModuleTests::Seconds([&]()
+	{
+		for(int r = 0; r < repeats; ++r)
+		{
+			for(const BezierTessellator::Patch& patch : patches)
+				tessellator.ComputeFactors(patch, viewProj, width, height);
+		}
+	}) / repeats;
+	double poolTime = ModuleTests::Seconds([&]()
+	{
+		for(int r = 0; r < repeats; ++r)
+			tessellator.Tessellate(patches.data(), patchCount, viewProj, width, height, mesh);
+	}) / repeats;
+	double serialTime = ModuleTests::Seconds([&]()
+	{
+		for(int r = 0; r < repeats; ++r)
+			serialTessellator.Tessellate(patches.data(), patchCount, viewProj, width, height, serialMesh);
+	}) / repeats;
+	CHECK(tessellator.CachedTopologyCount() == cached);
+
+	ModuleTests::Report("factors only %.0f patches/ms; tessellate %.0f patches/ms (%u threads), %.0f patches/ms on one thread",
+		patchCount / (factorsTime * 1000.0), patchCount / (poolTime * 1000.0), ThreadPool::Default().ThreadCount(),
+		patchCount / (serialTime * 1000.0));
+}
@@ -0,0 +1,247 @@
+//***************************************************************************************
+// BvhTests.cpp
+//
+// Picking through MeshBvh and SceneBvh against the loop over every triangle Pick used
+// before the hierarchies, on the skull and the car: the same triangle at exactly the
+// same distance for every ray, and for the scene the same instance as well.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 17 Picking/Picking/Bvh.h"
+#include "../../Common/ModelLoader.h"
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Every triangle; the first nearest hit wins.
+	bool IntersectBruteForce(const std::vector<XMFLOAT3>& positions, const std::vector<std::uint32_t>& indices,
+		FXMVECTOR rayOrigin, FXMVECTOR rayDir, float& tmin, UINT& triangle)
+	{
+		bool hit = false;
+		tmin = MathHelper::Infinity;
+
+		UINT triCount = (UINT)indices.size() / 3;
+		for(UINT i = 0; i < triCount; ++i)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&positions[indices[i * 3 + 0]]);
+			XMVECTOR v1 = XMLoadFloat3(&positions[indices[i * 3 + 1]]);
+			XMVECTOR v2 = XMLoadFloat3(&positions[indices[i * 3 + 2]]);
+
+			float t = 0.0f;
+			if(TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t) && (!hit || t < tmin))
+			{
+				tmin = t;
+				triangle = i;
+				hit = true;
+			}
+		}
+
+		return hit;
+	}
+
+	// Rays from eight directions around a box through a grid covering it.
+	void MakeRays(const BoundingBox& bounds, UINT raysPerSide, std::vector<XMFLOAT3>& origins, std::vector<XMFLOAT3>& dirs)
+	{
+		XMVECTOR center = XMLoadFloat3(&bounds.Center);
+		float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+
+		origins.clear();
+		dirs.clear();
+		for(int view = 0; view < 8; ++view)
+		{
+			float yaw = view * 0.25f * MathHelper::Pi;
+			float pitch = (view % 2 ? 0.35f : -0.35f);
+			XMVECTOR forward = XMVectorSet(cosf(pitch)*sinf(yaw), sinf(pitch), cosf(pitch)*cosf(yaw), 0.0f);
+			XMVECTOR right = XMVector3Normalize(XMVector3Cross(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), forward));
+			XMVECTOR up = XMVector3Cross(forward, right);
+			XMVECTOR eye = XMVectorSubtract(center, XMVectorScale(forward, 3.0f*radius));
+
+			for(UINT j = 0; j < raysPerSide; ++j)
+			{
+				for(UINT i = 0; i < raysPerSide; ++i)
+				{
+					float x = (2.0f*i / (raysPerSide - 1) - 1.0f) * radius;
+					float y = (2.0f*j / (raysPerSide - 1) - 1.0f) * radius;
+					XMVECTOR target = XMVectorAdd(center, XMVectorAdd(XMVectorScale(right, x), XMVectorScale(up, y)));
+
+					XMFLOAT3 o, d;
+					XMStoreFloat3(&o, eye);
+					XMStoreFloat3(&d, XMVector3Normalize(XMVectorSubtract(target, eye)));
+					origins.push_back(o);
+					dirs.push_back(d);
+				}
+			}
+		}
+	}
+}
+
+TEST_SUITE(Bvh)
+{
+	const char* modelFiles[] = { "Chapter 17 Picking/Picking/Models/skull.txt", "Chapter 17 Picking/Picking/Models/car.txt" };
+	const UINT modelCount = 2;
+
+	std::vector<XMFLOAT3> positions[modelCount];
+	std::vector<std::uint32_t> indices[modelCount];
+	MeshBvh meshes[modelCount];
+
+	// The brute force loop is far slower, so it only checks every n-th ray.  The strides
+	// are prime so the checked rays do not all fall in one column of the grid.
+	const UINT raysPerSide = 64;
+	const UINT bruteForceStride = 37;
+	const UINT sceneBruteForceStride = 127;
+
+	for(UINT m = 0; m < modelCount; ++m)
+	{
+		ModelData model;
+		bool loaded = ModelLoader::LoadText(ModuleTests::SourcePath(modelFiles[m]), model);
+		CHECK(loaded);
+		if(!loaded)
+			return;
+		positions[m] = model.Positions;
+		indices[m].assign(model.Indices.begin(), model.Indices.end());
+
+		UINT triCount = (UINT)indices[m].size() / 3;
+		double buildTime = ModuleTests::Seconds([&]()
+		{
+			meshes[m].Build(positions[m].data(), sizeof(XMFLOAT3), indices[m].data(), triCount);
+		});
+		CHECK(meshes[m].TriangleCount() == triCount);
+
+		std::vector<XMFLOAT3> origins, dirs;
+		MakeRays(meshes[m].Bounds(), raysPerSide, origins, dirs);
+		const UINT rayCount = (UINT)origins.size();
+
+		std::vector<RayHit> hits(rayCount);
+		std::vector<bool> hitFound(rayCount);
+		double bvhTime = ModuleTests::Seconds([&]()
+		{
+			for(UINT r = 0; r < rayCount; ++r)
+			{
+				hitFound[r] = meshes[m].Intersects(XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]),
+					MathHelper::Infinity, hits[r]);
+			}
+		});
+
+		UINT checked = 0, mismatches = 0, hitCount = 0;
+		double bruteTime = ModuleTests::Seconds([&]()
+		{
+			for(UINT r = 0; r < rayCount; r += bruteForceStride)
+			{
+				float t = 0.0f;
+				UINT triangle = 0;
+				bool found = IntersectBruteForce(positions[m], indices[m],
+					XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), t, triangle);
+
+				++checked;
+				if(found != hitFound[r] || (found && (t != hits[r].T || triangle != hits[r].Triangle)))
+					++mismatches;
+			}
+		});
+		for(UINT r = 0; r < rayCount; ++r)
+			hitCount += hitFound[r] ? 1 : 0;
+
+		// A nearer limit than the hit misses; the hit's own distance still finds it.
+		UINT limited = 0;
+		for(UINT r = 0; r < rayCount; r += bruteForceStride)
+		{
+			if(!hitFound[r])
+				continue;
+			RayHit nearer, same;
+			bool nearerFound = meshes[m].Intersects(XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), hits[r].T * 0.99f, nearer);
+			bool sameFound = meshes[m].Intersects(XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), hits[r].T, same);
+			if(nearerFound || !sameFound || same.Triangle != hits[r].Triangle)
+				++limited;
+		}
+
+		ModuleTests::Report("%s: %u triangles, %u nodes, built in %.1f ms; rays/s: BVH %.0f, brute force %.0f; %u of %u hit",
+			m == 0 ? "skull" : "car", triCount, meshes[m].NodeCount(), buildTime * 1000.0,
+			rayCount / bvhTime, checked / bruteTime, hitCount, rayCount);
+		CHECK(hitCount > rayCount / 8 && hitCount < rayCount);
+		CHECK(mismatches == 0);
+		CHECK(limited == 0);
+	}
+
+	// Two levels: a 3x3 grid of rotated, scaled skulls and cars.
+	SceneBvh scene;
+	for(int z = 0; z < 3; ++z)
+	{
+		for(int x = 0; x < 3; ++x)
+		{
+			UINT m = (x + z) % modelCount;
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixScaling(1.0f + 0.25f*x, 1.0f, 1.0f + 0.25f*z) *
+				XMMatrixRotationY(0.7f*(x + 3*z)) * XMMatrixTranslation(14.0f*(x - 1), 0.0f, 14.0f*(z - 1)));
+			CHECK(scene.AddInstance(&meshes[m], world) == (UINT)(3*z + x));
+		}
+	}
+	scene.Build();
+	CHECK(scene.InstanceCount() == 9);
+
+	BoundingBox sceneBounds(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(22.0f, 6.0f, 22.0f));
+	std::vector<XMFLOAT3> origins, dirs;
+	MakeRays(sceneBounds, raysPerSide, origins, dirs);
+	const UINT rayCount = (UINT)origins.size();
+
+	std::vector<RayHit> hits(rayCount);
+	std::vector<bool> hitFound(rayCount);
+	double sceneTime = ModuleTests::Seconds([&]()
+	{
+		for(UINT r = 0; r < rayCount; ++r)
+			hitFound[r] = scene.Intersects(XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), hits[r]);
+	});
+
+	UINT checked = 0, mismatches = 0, hitCount = 0;
+	for(UINT r = 0; r < rayCount; r += sceneBruteForceStride)
+	{
+		bool found = false;
+		float tBest = MathHelper::Infinity;
+		UINT instanceBest = 0;
+		UINT triangleBest = 0;
+		for(UINT i = 0; i < scene.InstanceCount(); ++i)
+		{
+			XMVECTOR localOrigin, localDir;
+			float distanceScale = 1.0f;
+			scene.TransformRay(i, XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), localOrigin, localDir, distanceScale);
+
+			UINT m = scene.GetMesh(i) == &meshes[0] ? 0 : 1;
+			float t = 0.0f;
+			UINT triangle = 0;
+			if(IntersectBruteForce(positions[m], indices[m], localOrigin, localDir, t, triangle) &&
+				(!found || t / distanceScale < tBest))
+			{
+				found = true;
+				tBest = t / distanceScale;
+				instanceBest = i;
+				triangleBest = triangle;
+			}
+		}
+
+		++checked;
+		hitCount += found ? 1 : 0;
+		if(found != hitFound[r] || (found && (tBest != hits[r].T ||
+			instanceBest != hits[r].Instance || triangleBest != hits[r].Triangle)))
+			++mismatches;
+	}
+
+	ModuleTests::Report("scene of %u instances: %.0f rays/s; %u of %u checked rays hit",
+		scene.InstanceCount(), rayCount / sceneTime, hitCount, checked);
+	CHECK(hitCount > checked / 8);
+	CHECK(mismatches == 0);
+
+	// Moving an instance away, then rebuilding, takes its hits with it.
+	XMFLOAT4X4 farAway;
+	XMStoreFloat4x4(&farAway, XMMatrixTranslation(0.0f, 1000.0f, 0.0f));
+	for(UINT i = 0; i < scene.InstanceCount(); ++i)
+		scene.SetWorld(i, farAway);
+	scene.Build();
+	UINT stillHit = 0;
+	for(UINT r = 0; r < rayCount; r += sceneBruteForceStride)
+	{
+		RayHit hit;
+		stillHit += scene.Intersects(XMLoadFloat3(&origins[r]), XMLoadFloat3(&dirs[r]), hit) ? 1 : 0;
+	}
+	CHECK(stillHit == 0);
+}
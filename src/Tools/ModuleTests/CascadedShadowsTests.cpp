@@ -0,0 +1,221 @@
+//***************************************************************************************
+// CascadedShadowsTests.cpp
+//
+// Cascade fitting for the shadow mapping demo's camera and lights: the slices follow
+// each other from the near plane, every point of a slice lands inside its cascade's
+// shadow map and depth range, and every caster between a point and the light is drawn
+// into that cascade.  After the camera moves and turns, a fixed world point moves by
+// whole texels and the texel size stays the same, so edges do not shimmer.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 20 Shadow Mapping/Shadows/CascadedShadows.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+TEST_SUITE(CascadedShadows)
+{
+	// Splits: count + 1 values from near to far, uniform at lambda 0 and geometric at 1.
+	{
+		float splits[CascadedShadows::MaxCascades + 1];
+		CascadedShadows::ComputeSplits(1.0f, 100.0f, 4, 0.0f, splits);
+		CHECK(splits[0] == 1.0f && splits[4] == 100.0f);
+		CHECK_NEAR(splits[2], 50.5f, 1e-3f);
+		CascadedShadows::ComputeSplits(1.0f, 100.0f, 4, 1.0f, splits);
+		CHECK_NEAR(splits[2], 10.0f, 1e-3f);
+
+		// The sphere holds the corners of the slice.
+		float centerZ = 0.0f, radius = 0.0f;
+		const float fovY = 0.25f*XM_PI, aspect = 4.0f / 3.0f;
+		CascadedShadows::FitSliceSphere(5.0f, 20.0f, fovY, aspect, centerZ, radius);
+		bool holdsCorners = true;
+		for(float z : { 5.0f, 20.0f })
+		{
+			float y = z*tanf(0.5f*fovY), x = y*aspect;
+			holdsCorners = holdsCorners && sqrtf(x*x + y*y + (z - centerZ)*(z - centerZ)) <= radius*(1.0f + 1e-5f);
+		}
+		CHECK(holdsCorners);
+	}
+
+	// Roughly the demo's scene: a floor, two rows of columns topped with spheres, a
+	// box and a skull, and a scatter of boxes around them.
+	std::mt19937 rng(20);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<BoundingBox> casters;
+	casters.push_back(BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(10.0f, 0.01f, 15.0f)));
+	casters.push_back(BoundingBox(XMFLOAT3(0.0f, 0.5f, 0.0f), XMFLOAT3(1.5f, 0.5f, 1.5f)));
+	casters.push_back(BoundingBox(XMFLOAT3(0.0f, 1.6f, 0.0f), XMFLOAT3(1.4f, 0.7f, 0.7f)));
+	for(int i = 0; i < 5; ++i)
+	{
+		for(float x : { -5.0f, 5.0f })
+		{
+			casters.push_back(BoundingBox(XMFLOAT3(x, 1.5f, -10.0f + i*5.0f), XMFLOAT3(0.5f, 1.5f, 0.5f)));
+			casters.push_back(BoundingBox(XMFLOAT3(x, 3.5f, -10.0f + i*5.0f), XMFLOAT3(0.5f, 0.5f, 0.5f)));
+		}
+	}
+	for(int i = 0; i < 200; ++i)
+	{
+		XMFLOAT3 center((unit(rng) - 0.5f)*160.0f, unit(rng)*6.0f, (unit(rng) - 0.5f)*160.0f);
+		casters.push_back(BoundingBox(center, XMFLOAT3(0.2f + unit(rng), 0.2f + 2.0f*unit(rng), 0.2f + unit(rng))));
+	}
+	const UINT casterCount = (UINT)casters.size();
+
+	Camera camera;
+	camera.SetPosition(0.0f, 2.0f, -15.0f);
+	camera.SetLens(0.25f*MathHelper::Pi, 4.0f / 3.0f, 1.0f, 1000.0f);
+	camera.UpdateViewMatrix();
+
+	const UINT resolution = 2048;
+	const XMFLOAT3 lightDirections[] = {
+		XMFLOAT3(0.57735f, -0.57735f, 0.57735f),
+		XMFLOAT3(-0.57735f, -0.57735f, 0.57735f),
+		XMFLOAT3(0.0f, -0.707f, -0.707f) };
+
+	for(const XMFLOAT3& light : lightDirections)
+	{
+		XMVECTOR lightDir = XMLoadFloat3(&light);
+
+		CascadedShadows cascades(CascadedShadows::MaxCascades, resolution);
+		cascades.Update(camera, lightDir, casters.data(), casterCount);
+		const UINT cascadeCount = cascades.CascadeCount();
+		CHECK(cascadeCount == CascadedShadows::MaxCascades && cascades.Resolution() == resolution);
+
+		// The slices must follow each other from the near plane on.
+		UINT splitErrors = cascades.GetCascade(0).SplitNear == camera.GetNearZ() ? 0 : 1;
+		for(UINT i = 0; i < cascadeCount; ++i)
+		{
+			const auto& cascade = cascades.GetCascade(i);
+			if(cascade.SplitNear >= cascade.SplitFar || (i > 0 && cascade.SplitNear != cascades.GetCascade(i - 1).SplitFar))
+				++splitErrors;
+		}
+		CHECK(splitErrors == 0);
+
+		// Random points in each slice of the camera frustum must land inside their
+		// cascade's shadow map and depth range, and every caster box on the ray from
+		// a point toward the light must be one of the cascade's casters.
+		XMMATRIX view = camera.GetView();
+		XMVECTOR det = XMMatrixDeterminant(view);
+		XMMATRIX invView = XMMatrixInverse(&det, view);
+		float tanHalfFovY = tanf(0.5f*camera.GetFovY());
+		float aspect = camera.GetAspect();
+		XMVECTOR toLight = XMVectorNegate(XMVector3Normalize(lightDir));
+
+		const UINT samplesPerCascade = 4096;
+		UINT coverageErrors = 0, missedCasters = 0, shadowedPoints = 0;
+		for(UINT i = 0; i < cascadeCount; ++i)
+		{
+			const auto& cascade = cascades.GetCascade(i);
+			XMMATRIX shadowTransform = XMLoadFloat4x4(&cascade.ShadowTransform);
+
+			std::vector<bool> kept(casterCount, false);
+			for(UINT caster : cascade.Casters)
+				kept[caster] = true;
+
+			for(UINT k = 0; k < samplesPerCascade; ++k)
+			{
+				float z = cascade.SplitNear + unit(rng)*(cascade.SplitFar - cascade.SplitNear);
+				float x = (2.0f*unit(rng) - 1.0f)*z*tanHalfFovY*aspect;
+				float y = (2.0f*unit(rng) - 1.0f)*z*tanHalfFovY;
+				XMVECTOR posW = XMVector3TransformCoord(XMVectorSet(x, y, z, 1.0f), invView);
+
+				XMFLOAT3 tex;
+				XMStoreFloat3(&tex, XMVector3TransformCoord(posW, shadowTransform));
+				if(tex.x < 0.0f || tex.x > 1.0f || tex.y < 0.0f || tex.y > 1.0f || tex.z < 0.0f || tex.z > 1.0f)
+					++coverageErrors;
+
+				bool shadowed = false;
+				for(UINT c = 0; c < casterCount; ++c)
+				{
+					float dist = 0.0f;
+					if(casters[c].Intersects(posW, toLight, dist))
+					{
+						shadowed = true;
+						missedCasters += kept[c] ? 0 : 1;
+					}
+				}
+				shadowedPoints += shadowed ? 1 : 0;
+			}
+		}
+		CHECK(coverageErrors == 0);
+		CHECK(shadowedPoints > 0);
+		CHECK(missedCasters == 0);
+
+		// After the camera turns and moves, a fixed world point must move by whole
+		// texels in every cascade, and the texel size must stay the same.
+		const UINT moveCount = 64;
+		UINT stabilityErrors = 0;
+		for(UINT m = 0; m < moveCount; ++m)
+		{
+			Camera moved = camera;
+			moved.RotateY(unit(rng) - 0.5f);
+			moved.Pitch(0.4f*unit(rng) - 0.2f);
+			moved.Walk(4.0f*unit(rng) - 2.0f);
+			moved.Strafe(4.0f*unit(rng) - 2.0f);
+			moved.UpdateViewMatrix();
+
+			CascadedShadows movedCascades(CascadedShadows::MaxCascades, resolution);
+			movedCascades.Update(moved, lightDir, casters.data(), casterCount);
+
+			for(UINT i = 0; i < cascadeCount; ++i)
+			{
+				const auto& before = cascades.GetCascade(i);
+				const auto& after = movedCascades.GetCascade(i);
+
+				float width = before.Right - before.Left;
+				if(fabsf((after.Right - after.Left) - width) > 1e-4f*width)
+					++stabilityErrors;
+
+				XMVECTOR probe = XMLoadFloat3(&before.Bounds.Center);
+				XMFLOAT3 texBefore, texAfter;
+				XMStoreFloat3(&texBefore, XMVector3TransformCoord(probe, XMLoadFloat4x4(&before.ShadowTransform)));
+				XMStoreFloat3(&texAfter, XMVector3TransformCoord(probe, XMLoadFloat4x4(&after.ShadowTransform)));
+
+				float dx = (texAfter.x - texBefore.x)*resolution;
+				float dy = (texAfter.y - texBefore.y)*resolution;
+				if(fabsf(dx - roundf(dx)) > 0.01f || fabsf(dy - roundf(dy)) > 0.01f)
+					++stabilityErrors;
+			}
+		}
+		CHECK(stabilityErrors == 0);
+
+		// Refitting to the same view must leave every drawn cascade clean; moving the
+		// camera or invalidating must not.
+		for(UINT i = 0; i < cascadeCount; ++i)
+			cascades.MarkDrawn(i);
+		cascades.Update(camera, lightDir, casters.data(), casterCount);
+		UINT cacheErrors = 0;
+		for(UINT i = 0; i < cascadeCount; ++i)
+			cacheErrors += cascades.GetCascade(i).Dirty ? 1 : 0;
+		cascades.Invalidate(1);
+		cacheErrors += cascades.GetCascade(1).Dirty ? 0 : 1;
+		cascades.InvalidateAll();
+		for(UINT i = 0; i < cascadeCount; ++i)
+		{
+			cacheErrors += cascades.GetCascade(i).Dirty ? 0 : 1;
+			cascades.MarkDrawn(i);
+		}
+		Camera far = camera;
+		far.Walk(50.0f);
+		far.UpdateViewMatrix();
+		cascades.Update(far, lightDir, casters.data(), casterCount);
+		cacheErrors += cascades.GetCascade(0).Dirty ? 0 : 1;
+		CHECK(cacheErrors == 0);
+
+		const UINT updateCount = 1000;
+		double updateTime = ModuleTests::Seconds([&]()
+		{
+			for(UINT k = 0; k < updateCount; ++k)
+				cascades.Update(camera, lightDir, casters.data(), casterCount);
+		});
+
+		ModuleTests::Report("light (%.2f, %.2f, %.2f): splits %.1f %.1f %.1f %.1f %.1f, casters %zu %zu %zu %zu of %u, update %.3f ms",
+			light.x, light.y, light.z, cascades.GetCascade(0).SplitNear, cascades.GetCascade(1).SplitNear,
+			cascades.GetCascade(2).SplitNear, cascades.GetCascade(3).SplitNear, cascades.GetCascade(3).SplitFar,
+			cascades.GetCascade(0).Casters.size(), cascades.GetCascade(1).Casters.size(),
+			cascades.GetCascade(2).Casters.size(), cascades.GetCascade(3).Casters.size(), casterCount,
+			updateTime * 1000.0 / updateCount);
+	}
+}
@@ -0,0 +1,306 @@
+//***************************************************************************************
+// CpuSkinnerTests.cpp
+//
+// The soldier of chapter 23, posed by its own clip.  LinearBlend against the vertex
+// shader's sum of weighted bone transforms done in double; the AVX2 kernels against
+// the DirectXMath path, for both methods, on CPUs that have them; DualQuaternion
+// against LinearBlend where the two must agree, on a rigid pose and on vertices bound
+// to one bone; and a twisted two bone cylinder, where linear blending collapses and
+// dual quaternions keep the radius and turn the short way round.  The subset boxes
+// hold their subset's skinned vertices and touch the extremes, and Intersects finds
+// what testing every triangle finds.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 23 Character Animation/SkinnedMesh/CpuSkinner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return sqrtf((a.x - b.x)*(a.x - b.x) + (a.y - b.y)*(a.y - b.y) + (a.z - b.z)*(a.z - b.z));
+	}
+
+	float LargestDistance(const std::vector<XMFLOAT3>& a, const std::vector<XMFLOAT3>& b)
+	{
+		float largest = 0.0f;
+		for(size_t i = 0; i < a.size(); ++i)
+			largest = (std::max)(largest, Distance(a[i], b[i]));
+		return largest;
+	}
+
+	// The SKINNED path of Default.hlsl: the palette is transposed, so row j of a bone
+	// dotted with (v, w) gives component j.
+	XMFLOAT3 ReferenceSkin(const M3DLoader::SkinnedVertex& v, const XMFLOAT3& p, float w,
+		const std::vector<XMFLOAT4X4>& bones)
+	{
+		const float weights[4] = { v.BoneWeights.x, v.BoneWeights.y, v.BoneWeights.z,
+			1.0f - v.BoneWeights.x - v.BoneWeights.y - v.BoneWeights.z };
+
+		double out[3] = { 0.0, 0.0, 0.0 };
+		for(int k = 0; k < 4; ++k)
+		{
+			const XMFLOAT4X4& M = bones[v.BoneIndices[k]];
+			for(int j = 0; j < 3; ++j)
+				out[j] += weights[k]*((double)M.m[j][0]*p.x + (double)M.m[j][1]*p.y + (double)M.m[j][2]*p.z + (double)M.m[j][3]*w);
+		}
+		return XMFLOAT3((float)out[0], (float)out[1], (float)out[2]);
+	}
+
+	bool SameBits(const std::vector<XMFLOAT3>& a, const std::vector<XMFLOAT3>& b)
+	{
+		return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()*sizeof(XMFLOAT3)) == 0;
+	}
+}
+
+TEST_SUITE(CpuSkinner)
+{
+	std::vector<M3DLoader::SkinnedVertex> vertices;
+	std::vector<USHORT> indices;
+	std::vector<M3DLoader::Subset> subsets;
+	std::vector<M3DLoader::M3dMaterial> materials;
+	SkinnedData skinInfo;
+	M3DLoader loader;
+	CHECK(loader.LoadM3d(ModuleTests::SourcePath("Chapter 23 Character Animation/SkinnedMesh/Models/soldier.m3d"),
+		vertices, indices, subsets, materials, skinInfo));
+	CHECK(!vertices.empty() && skinInfo.BoneCount() > 0 && !subsets.empty());
+	if(vertices.empty() || subsets.empty())
+		return;
+
+	std::vector<XMFLOAT4X4> pose(skinInfo.BoneCount());
+	skinInfo.GetFinalTransforms("Take1", 0.5f*skinInfo.GetClipEndTime("Take1"), pose);
+
+	ThreadPool serialPool(1), fourPool(4);
+	CpuSkinner skinner(&fourPool);
+	skinner.SetBindPose(vertices, indices, subsets);
+	CHECK(skinner.VertexCount() == vertices.size());
+
+	// Distances are compared against the size of the soldier.
+	XMFLOAT3 lo = vertices[0].Pos, hi = vertices[0].Pos;
+	for(const auto& v : vertices)
+	{
+		lo = XMFLOAT3((std::min)(lo.x, v.Pos.x), (std::min)(lo.y, v.Pos.y), (std::min)(lo.z, v.Pos.z));
+		hi = XMFLOAT3((std::max)(hi.x, v.Pos.x), (std::max)(hi.y, v.Pos.y), (std::max)(hi.z, v.Pos.z));
+	}
+	const float size = Distance(lo, hi);
+
+	// LinearBlend against the reference, positions, normals and tangents.
+	skinner.EnableAVX2(false);
+	skinner.Skin(pose, CpuSkinner::Method::LinearBlend);
+	float positionError = 0.0f, normalError = 0.0f, tangentError = 0.0f;
+	for(size_t i = 0; i < vertices.size(); ++i)
+	{
+		const auto& v = vertices[i];
+		positionError = (std::max)(positionError, Distance(skinner.Positions()[i], ReferenceSkin(v, v.Pos, 1.0f, pose)));
+		normalError = (std::max)(normalError, Distance(skinner.Normals()[i], ReferenceSkin(v, v.Normal, 0.0f, pose)));
+		tangentError = (std::max)(tangentError, Distance(skinner.Tangents()[i], ReferenceSkin(v, v.TangentU, 0.0f, pose)));
+	}
+	ModuleTests::Report("%zu vertices, %zu bones: linear blend off the reference by %.2g of the size, normals %.2g, tangents %.2g",
+		vertices.size(), pose.size(), positionError / size, normalError, tangentError);
+	CHECK(positionError < 1e-5f*size);
+	CHECK(normalError < 1e-4f && tangentError < 1e-4f);
+
+	// Subset boxes hold their vertices and touch the extremes.
+	bool boxesTight = skinner.SubsetBounds().size() == subsets.size();
+	for(size_t s = 0; boxesTight && s < subsets.size(); ++s)
+	{
+		const BoundingBox& box = skinner.SubsetBounds()[s];
+		XMFLOAT3 smin(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+		XMFLOAT3 smax(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+		for(UINT i = subsets[s].VertexStart; i < subsets[s].VertexStart + subsets[s].VertexCount; ++i)
+		{
+			const XMFLOAT3& p = skinner.Positions()[i];
+			smin = XMFLOAT3((std::min)(smin.x, p.x), (std::min)(smin.y, p.y), (std::min)(smin.z, p.z));
+			smax = XMFLOAT3((std::max)(smax.x, p.x), (std::max)(smax.y, p.y), (std::max)(smax.z, p.z));
+		}
+		const float* c = &box.Center.x;
+		const float* e = &box.Extents.x;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			boxesTight = boxesTight && fabsf(c[axis] - e[axis] - (&smin.x)[axis]) <= 1e-5f*size &&
+				fabsf(c[axis] + e[axis] - (&smax.x)[axis]) <= 1e-5f*size;
+		}
+	}
+	CHECK(boxesTight);
+
+	// Rays at random vertices: the nearest hit is the one testing every triangle gives.
+	std::mt19937 rng(26);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+	const XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&lo), XMLoadFloat3(&hi)), 0.5f);
+	uint32_t hits = 0, mismatches = 0;
+	for(int r = 0; r < 200; ++r)
+	{
+		XMVECTOR offset = XMVector3Normalize(XMVectorSet(signedUnit(rng), signedUnit(rng), signedUnit(rng), 0.0f));
+		XMVECTOR origin = XMVectorAdd(center, XMVectorScale(offset, 2.0f*size));
+		XMVECTOR target = XMLoadFloat3(&skinner.Positions()[rng() % vertices.size()]);
+		XMVECTOR dir = XMVector3Normalize(XMVectorSubtract(target, origin));
+
+		float bestT = MathHelper::Infinity;
+		for(size_t f = 0; f < indices.size() / 3; ++f)
+		{
+			float t = 0.0f;
+			if(TriangleTests::Intersects(origin, dir, XMLoadFloat3(&skinner.Positions()[indices[f*3 + 0]]),
+				XMLoadFloat3(&skinner.Positions()[indices[f*3 + 1]]), XMLoadFloat3(&skinner.Positions()[indices[f*3 + 2]]), t))
+				bestT = (std::min)(bestT, t);
+		}
+
+		float t = 0.0f;
+		UINT subset = 0, triangle = 0;
+		bool hit = skinner.Intersects(origin, dir, t, subset, triangle);
+		hits += hit ? 1 : 0;
+		if(hit != (bestT < MathHelper::Infinity) || (hit && (t != bestT || triangle < subsets[subset].FaceStart ||
+			triangle >= subsets[subset].FaceStart + subsets[subset].FaceCount)))
+			++mismatches;
+	}
+	CHECK(mismatches == 0);
+	CHECK(hits > 100);
+
+	// One pool thread or four, the same bits.
+	{
+		CpuSkinner serial(&serialPool);
+		serial.EnableAVX2(false);
+		serial.SetBindPose(vertices, indices, subsets);
+		serial.Skin(pose, CpuSkinner::Method::LinearBlend);
+		CHECK(SameBits(serial.Positions(), skinner.Positions()) && SameBits(serial.Normals(), skinner.Normals()));
+	}
+
+	// The AVX2 kernels against the DirectXMath path; they fuse multiply-adds, so the
+	// results are close rather than equal.
+	for(CpuSkinner::Method method : { CpuSkinner::Method::LinearBlend, CpuSkinner::Method::DualQuaternion })
+	{
+		const char* name = method == CpuSkinner::Method::LinearBlend ? "linear blend" : "dual quaternion";
+
+		skinner.EnableAVX2(false);
+		const int runs = 20;
+		double scalarTime = ModuleTests::Seconds([&]()
+		{
+			for(int run = 0; run < runs; ++run)
+				skinner.Skin(pose, method);
+		}) / runs;
+		std::vector<XMFLOAT3> positions = skinner.Positions(), normals = skinner.Normals(), tangents = skinner.Tangents();
+
+		if(!CpuSkinner::HasAVX2())
+		{
+			ModuleTests::Report("%s: DirectXMath %.3f ms; no AVX2 on this CPU, kernels not checked", name, scalarTime * 1000.0);
+			continue;
+		}
+
+		skinner.EnableAVX2(true);
+		double avx2Time = ModuleTests::Seconds([&]()
+		{
+			for(int run = 0; run < runs; ++run)
+				skinner.Skin(pose, method);
+		}) / runs;
+		CHECK(LargestDistance(skinner.Positions(), positions) < 1e-5f*size);
+		CHECK(LargestDistance(skinner.Normals(), normals) < 1e-4f);
+		CHECK(LargestDistance(skinner.Tangents(), tangents) < 1e-4f);
+
+		ModuleTests::Report("%s: DirectXMath %.3f ms, AVX2 %.3f ms on %u threads; AVX2 off by %.2g of the size",
+			name, scalarTime * 1000.0, avx2Time * 1000.0, fourPool.ThreadCount(),
+			LargestDistance(skinner.Positions(), positions) / size);
+	}
+	skinner.EnableAVX2(true);
+
+	// Vertices bound to a single bone move rigidly, so both methods put them in the
+	// same place.
+	skinner.Skin(pose, CpuSkinner::Method::LinearBlend);
+	std::vector<XMFLOAT3> linear = skinner.Positions();
+	skinner.Skin(pose, CpuSkinner::Method::DualQuaternion);
+	float singleBoneError = 0.0f;
+	uint32_t singleBone = 0;
+	for(size_t i = 0; i < vertices.size(); ++i)
+	{
+		if(vertices[i].BoneWeights.x == 1.0f)
+		{
+			singleBoneError = (std::max)(singleBoneError, Distance(linear[i], skinner.Positions()[i]));
+			++singleBone;
+		}
+	}
+	CHECK(singleBone > 0);
+	CHECK(singleBoneError < 1e-4f*size);
+
+	// Every bone moved by the same rotation and translation: the whole mesh moves
+	// rigidly, whatever the weights.
+	XMMATRIX rigid = XMMatrixMultiply(XMMatrixRotationRollPitchYaw(0.3f, -1.1f, 0.7f), XMMatrixTranslation(5.0f, -2.0f, 9.0f));
+	XMFLOAT4X4 rigidTransposed;
+	XMStoreFloat4x4(&rigidTransposed, XMMatrixTranspose(rigid));
+	std::vector<XMFLOAT4X4> rigidPose(pose.size(), rigidTransposed);
+	skinner.Skin(rigidPose, CpuSkinner::Method::LinearBlend);
+	linear = skinner.Positions();
+	skinner.Skin(rigidPose, CpuSkinner::Method::DualQuaternion);
+	float rigidError = 0.0f;
+	for(size_t i = 0; i < vertices.size(); ++i)
+	{
+		XMFLOAT3 expected;
+		XMStoreFloat3(&expected, XMVector3TransformCoord(XMLoadFloat3(&vertices[i].Pos), rigid));
+		rigidError = (std::max)(rigidError, (std::max)(Distance(linear[i], expected), Distance(skinner.Positions()[i], expected)));
+	}
+	CHECK(rigidError < 1e-4f*size);
+
+	// A unit cylinder along x, bone 0 for x < 0.8 and bone 1 past 1.2, blended in
+	// between.  Bone 1 twists by 170 degrees: linear blending pinches the middle to
+	// cos(85 degrees), dual quaternions keep it round and turn it halfway.  Twisted
+	// by 190 degrees the quaternions of the two bones lie in opposite hemispheres, and
+	// the middle turns halfway the short way round, by -85 degrees.
+	std::vector<M3DLoader::SkinnedVertex> cylinder;
+	for(int ring = 0; ring <= 20; ++ring)
+	{
+		float x = ring * 0.1f;
+		float w1 = (std::min)((std::max)((x - 0.8f) / 0.4f, 0.0f), 1.0f);
+		for(int k = 0; k < 16; ++k)
+		{
+			float a = k * XM_2PI / 16.0f;
+			M3DLoader::SkinnedVertex v = {};
+			v.Pos = XMFLOAT3(x, cosf(a), sinf(a));
+			v.Normal = XMFLOAT3(0.0f, cosf(a), sinf(a));
+			v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			v.BoneWeights = XMFLOAT3(1.0f - w1, w1, 0.0f);
+			v.BoneIndices[0] = 0;
+			v.BoneIndices[1] = 1;
+			cylinder.push_back(v);
+		}
+	}
+	const size_t middle = 10*16;
+
+	CpuSkinner twister(&serialPool);
+	twister.SetBindPose(cylinder, std::vector<USHORT>(), std::vector<M3DLoader::Subset>());
+	for(float degrees : { 170.0f, 190.0f })
+	{
+		std::vector<XMFLOAT4X4> twist(2);
+		XMStoreFloat4x4(&twist[0], XMMatrixIdentity());
+		XMStoreFloat4x4(&twist[1], XMMatrixTranspose(XMMatrixRotationX(XMConvertToRadians(degrees))));
+		const float middleAngle = degrees < 180.0f ? 0.5f*degrees : 0.5f*degrees - 180.0f;
+
+		for(bool avx2 : { false, true })
+		{
+			twister.EnableAVX2(avx2);
+			auto smallestRadius = [&](CpuSkinner::Method method)
+			{
+				twister.Skin(twist, method);
+				float smallest = MathHelper::Infinity;
+				for(const XMFLOAT3& p : twister.Positions())
+					smallest = (std::min)(smallest, sqrtf(p.y*p.y + p.z*p.z));
+				return smallest;
+			};
+			float linearRadius = smallestRadius(CpuSkinner::Method::LinearBlend);
+			float dualQuatRadius = smallestRadius(CpuSkinner::Method::DualQuaternion);
+			const XMFLOAT3& p = twister.Positions()[middle];
+			CHECK_NEAR(linearRadius, cosf(XMConvertToRadians(85.0f)), 1e-4f);
+			CHECK_NEAR(dualQuatRadius, 1.0f, 1e-4f);
+			CHECK_NEAR(atan2f(p.z, p.y) * 180.0f / XM_PI, middleAngle, 1e-3f);
+
+			if(!avx2)
+			{
+				ModuleTests::Report("cylinder twisted %.0f degrees: narrowest radius %.3f linear blend, %.3f dual quaternion",
+					degrees, linearRadius, dualQuatRadius);
+			}
+		}
+	}
+}
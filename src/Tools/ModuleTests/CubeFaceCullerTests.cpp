@@ -0,0 +1,163 @@
+//***************************************************************************************
+// CubeFaceCullerTests.cpp
+//
+// Face masks against the faces themselves: any point of a sphere that lies in a face,
+// farther along that face's axis than along either other axis and within the far
+// plane, must put the face in the sphere's mask.  Small spheres well inside one face
+// get that face alone.  The visible lists follow the masks, and the motion of a
+// sphere is its displacement over its distance from the probe, added to the faces
+// that saw it on either frame.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 18 Cube Mapping/DynamicCube/CubeFaceCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// The face a probe space point lies in, or -1 for one on a face boundary, in
+	// CubeMapFace order: +X, -X, +Y, -Y, +Z, -Z.
+	int FaceOf(float x, float y, float z)
+	{
+		float ax = fabsf(x), ay = fabsf(y), az = fabsf(z);
+		if(ax > ay && ax > az)
+			return x > 0.0f ? 0 : 1;
+		if(ay > ax && ay > az)
+			return y > 0.0f ? 2 : 3;
+		if(az > ax && az > ay)
+			return z > 0.0f ? 4 : 5;
+		return -1;
+	}
+}
+
+TEST_SUITE(CubeFaceCuller)
+{
+	const XMFLOAT3 probe(1.0f, 2.0f, -3.0f);
+	const float farZ = 50.0f;
+
+	// A small sphere down the middle of each face is in that face only.
+	const XMFLOAT3 axes[6] = { XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0),
+		XMFLOAT3(0, -1, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1) };
+	bool singleFaces = true;
+	for(int face = 0; face < 6; ++face)
+	{
+		BoundingSphere sphere(XMFLOAT3(probe.x + 10.0f*axes[face].x + 0.5f*axes[face].y,
+			probe.y + 10.0f*axes[face].y + 0.5f*axes[face].z, probe.z + 10.0f*axes[face].z + 0.5f*axes[face].x), 1.0f);
+		singleFaces = singleFaces && CubeFaceCuller::FaceMask(probe, farZ, sphere) == (1 << face);
+	}
+	CHECK(singleFaces);
+
+	// A sphere around the probe is in every face, one past the far plane in none.
+	CHECK(CubeFaceCuller::FaceMask(probe, farZ, BoundingSphere(probe, 0.5f)) == 0x3f);
+	CHECK(CubeFaceCuller::FaceMask(probe, farZ, BoundingSphere(XMFLOAT3(probe.x + 60.0f, probe.y, probe.z), 5.0f)) == 0);
+	CHECK(CubeFaceCuller::FaceMask(probe, farZ, BoundingSphere(XMFLOAT3(probe.x + 54.0f, probe.y, probe.z), 5.0f)) == 0x01);
+
+	// Random spheres against points spread through them.
+	std::mt19937 rng(46);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	uint32_t missed = 0, extra = 0, setBits = 0;
+	for(int s = 0; s < 2000; ++s)
+	{
+		BoundingSphere sphere(XMFLOAT3(probe.x + 60.0f*signedUnit(rng), probe.y + 60.0f*signedUnit(rng),
+			probe.z + 60.0f*signedUnit(rng)), 0.1f + 8.0f*unit(rng)*unit(rng));
+		uint8_t mask = CubeFaceCuller::FaceMask(probe, farZ, sphere);
+
+		uint8_t reached = 0;
+		for(int k = 0; k < 400; ++k)
+		{
+			float dx, dy, dz;
+			do
+			{
+				dx = signedUnit(rng);
+				dy = signedUnit(rng);
+				dz = signedUnit(rng);
+			} while(dx*dx + dy*dy + dz*dz > 1.0f);
+
+			float x = sphere.Center.x + sphere.Radius*dx - probe.x;
+			float y = sphere.Center.y + sphere.Radius*dy - probe.y;
+			float z = sphere.Center.z + sphere.Radius*dz - probe.z;
+			int face = FaceOf(x, y, z);
+			if(face >= 0 && x*x + y*y + z*z <= farZ*farZ)
+				reached |= (uint8_t)(1 << face);
+		}
+
+		for(int face = 0; face < 6; ++face)
+		{
+			bool inMask = (mask & (1 << face)) != 0;
+			bool inFace = (reached & (1 << face)) != 0;
+			missed += inFace && !inMask ? 1 : 0;
+			extra += inMask && !inFace ? 1 : 0;
+			setBits += inMask ? 1 : 0;
+		}
+	}
+	ModuleTests::Report("2000 random spheres: %u face bits, %u missed, %u not reached by a sample (conservative)",
+		setBits, missed, extra);
+	CHECK(missed == 0);
+	CHECK(extra < setBits / 4);
+
+	// The visible lists and the motion.
+	CubeFaceCuller culler;
+	culler.SetProbe(probe, farZ);
+
+	std::vector<BoundingSphere> spheres =
+	{
+		BoundingSphere(XMFLOAT3(probe.x + 10.0f, probe.y, probe.z), 1.0f),
+		BoundingSphere(XMFLOAT3(probe.x, probe.y, probe.z - 5.0f), 1.0f),
+		BoundingSphere(XMFLOAT3(probe.x + 4.0f, probe.y + 4.0f, probe.z), 1.0f),
+		BoundingSphere(XMFLOAT3(probe.x, probe.y + 100.0f, probe.z), 1.0f)
+	};
+	culler.Cull(spheres.data(), (uint32_t)spheres.size());
+
+	bool listsMatchMasks = true;
+	for(int face = 0; face < 6; ++face)
+	{
+		std::vector<uint32_t> expected;
+		for(uint32_t i = 0; i < spheres.size(); ++i)
+		{
+			if(culler.Mask(i) & (1 << face))
+				expected.push_back(i);
+		}
+		listsMatchMasks = listsMatchMasks && culler.Visible(face) == expected;
+	}
+	CHECK(listsMatchMasks);
+	CHECK(culler.Mask(0) == 0x01 && culler.Mask(1) == 0x20 && culler.Mask(2) == 0x05 && culler.Mask(3) == 0);
+
+	// No history after SetProbe, so no motion on the first Cull.
+	bool still = true;
+	for(int face = 0; face < 6; ++face)
+		still = still && culler.FaceMotion(face) == 0.0f;
+	CHECK(still);
+
+	// The first sphere jumps from +X into +Z, which counts on both faces; then it
+	// moves 1 within +Z, which counts as 1 over its distance there alone.
+	spheres[0].Center = XMFLOAT3(probe.x + 10.0f, probe.y, probe.z + 14.0f);
+	culler.Cull(spheres.data(), (uint32_t)spheres.size());
+	CHECK(culler.Mask(0) == 0x10);
+	CHECK(culler.FaceMotion(0) > 0.0f && culler.FaceMotion(0) == culler.FaceMotion(4));
+	CHECK(culler.FaceMotion(2) == 0.0f && culler.FaceMotion(5) == 0.0f);
+
+	spheres[0].Center = XMFLOAT3(probe.x + 10.0f, probe.y, probe.z + 15.0f);
+	culler.Cull(spheres.data(), (uint32_t)spheres.size());
+	CHECK_NEAR(culler.FaceMotion(4), 1.0f / sqrtf(10.0f*10.0f + 15.0f*15.0f), 1e-6f);
+	CHECK(culler.FaceMotion(0) == 0.0f && culler.FaceMotion(5) == 0.0f);
+
+	// Time to cull a few thousand objects.
+	std::vector<BoundingSphere> crowd(4096);
+	for(auto& sphere : crowd)
+		sphere = BoundingSphere(XMFLOAT3(60.0f*signedUnit(rng), 60.0f*signedUnit(rng), 60.0f*signedUnit(rng)), 2.0f*unit(rng));
+	culler.SetProbe(XMFLOAT3(0.0f, 0.0f, 0.0f), farZ);
+	const int repeats = 100;
+	double time = ModuleTests::Seconds([&]()
+	{
+		for(int r = 0; r < repeats; ++r)
+			culler.Cull(crowd.data(), (uint32_t)crowd.size());
+	});
+	ModuleTests::Report("%zu spheres: %.1f us per cull", crowd.size(), time * 1e6 / repeats);
+}
@@ -0,0 +1,146 @@
+//***************************************************************************************
+// CubeMapSchedulerTests.cpp
+//
+// Invalidated faces are all redrawn at once; otherwise no more than FaceBudget faces
+// are redrawn a frame, moving faces first, and a still face waits no longer than
+// RefreshFrames plus the frames the budget needs to reach it.  Replaying DynamicCube's
+// skull orbit through CubeFaceCuller and the scheduler gives the draws per frame of
+// redrawing every face, of culling, and of culling and scheduling.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 18 Cube Mapping/DynamicCube/CubeFaceCuller.h"
+#include "../../Chapter 18 Cube Mapping/DynamicCube/CubeMapScheduler.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	int BitCount(uint8_t bits)
+	{
+		int count = 0;
+		for(; bits != 0; bits &= bits - 1)
+			++count;
+		return count;
+	}
+}
+
+TEST_SUITE(CubeMapScheduler)
+{
+	CubeMapScheduler::Desc desc;
+	desc.FaceBudget = 2;
+	desc.RefreshFrames = 30;
+	const uint32_t probeCount = 2;
+	CubeMapScheduler scheduler(probeCount, desc);
+
+	// Every face at first, whatever the budget.
+	const std::vector<uint8_t>& first = scheduler.Schedule();
+	CHECK(first.size() == probeCount && first[0] == 0x3f && first[1] == 0x3f);
+
+	// Nothing changes, so nothing is redrawn until faces get old; then the budget
+	// holds, every face comes round, and none waits past its bound.
+	uint32_t overBudget = 0, redrawn = 0, oldest = 0;
+	uint8_t seen[probeCount] = { 0, 0 };
+	const uint32_t bound = desc.RefreshFrames + (probeCount*6 + desc.FaceBudget - 1) / desc.FaceBudget;
+	for(uint32_t frame = 1; frame < 4*desc.RefreshFrames; ++frame)
+	{
+		const std::vector<uint8_t>& faces = scheduler.Schedule();
+		int count = 0;
+		for(uint32_t p = 0; p < probeCount; ++p)
+		{
+			count += BitCount(faces[p]);
+			seen[p] |= faces[p];
+			for(int face = 0; face < 6; ++face)
+				oldest = (std::max)(oldest, scheduler.Age(p, face));
+		}
+		if(frame < desc.RefreshFrames)
+			redrawn += count;
+		overBudget += count > (int)desc.FaceBudget ? 1 : 0;
+	}
+	CHECK(redrawn == 0);
+	CHECK(overBudget == 0);
+	CHECK(seen[0] == 0x3f && seen[1] == 0x3f);
+	CHECK(oldest <= bound);
+
+	// Motion goes ahead of age, the most motion first, and stays until its face is
+	// redrawn.
+	{
+		CubeMapScheduler::Desc oneFace = desc;
+		oneFace.FaceBudget = 1;
+		CubeMapScheduler motionScheduler(probeCount, oneFace);
+		motionScheduler.Schedule();
+		motionScheduler.AddMotion(1, 3, 0.01f);
+		motionScheduler.AddMotion(0, 4, 0.5f);
+		CHECK(motionScheduler.Schedule()[0] == 0x10);
+		const std::vector<uint8_t>& next = motionScheduler.Schedule();
+		CHECK(next[0] == 0 && next[1] == 0x08);
+		CHECK(motionScheduler.Age(0, 4) == 1 && motionScheduler.Age(1, 3) == 0 && motionScheduler.Age(1, 2) == 2);
+	}
+
+	// A probe that moves gets all six faces back next frame, and nothing else does.
+	scheduler.Invalidate(1);
+	const std::vector<uint8_t>& invalidated = scheduler.Schedule();
+	CHECK(invalidated[1] == 0x3f);
+
+	// DynamicCube's scene about its probe: the floor grid, the box under the globe,
+	// five columns and five spheres down each side, and the skull orbiting the globe.
+	std::vector<BoundingSphere> spheres =
+	{
+		BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 18.0f),
+		BoundingSphere(XMFLOAT3(0.0f, 0.5f, 0.0f), 2.2f)
+	};
+	for(int i = 0; i < 5; ++i)
+	{
+		for(float x : { -5.0f, 5.0f })
+		{
+			spheres.push_back(BoundingSphere(XMFLOAT3(x, 1.5f, -10.0f + i*5.0f), 1.6f));
+			spheres.push_back(BoundingSphere(XMFLOAT3(x, 3.5f, -10.0f + i*5.0f), 0.5f));
+		}
+	}
+	const size_t skull = spheres.size();
+	spheres.push_back(BoundingSphere(XMFLOAT3(3.0f, 2.0f, 0.0f), 1.0f));
+
+	CubeFaceCuller culler;
+	culler.SetProbe(XMFLOAT3(0.0f, 2.0f, 0.0f), 1000.0f);
+	CubeMapScheduler orbitScheduler(1, CubeMapScheduler::Desc());
+
+	// Ten seconds at 60 Hz.
+	const int frameCount = 600;
+	const uint32_t skyDraws = 1;
+	uint64_t culledDraws = 0, scheduledDraws = 0;
+	uint32_t scheduledFaces = 0, oldestFace = 0;
+	double cullTime = 0.0;
+	for(int frame = 0; frame < frameCount; ++frame)
+	{
+		float t = frame / 60.0f;
+		spheres[skull].Center = XMFLOAT3(3.0f*cosf(0.5f*t), 2.0f, -3.0f*sinf(0.5f*t));
+
+		cullTime += ModuleTests::Seconds([&]() { culler.Cull(spheres.data(), (uint32_t)spheres.size()); });
+		for(int face = 0; face < 6; ++face)
+			orbitScheduler.AddMotion(0, face, culler.FaceMotion(face));
+
+		uint8_t faces = orbitScheduler.Schedule()[0];
+		for(int face = 0; face < 6; ++face)
+		{
+			uint32_t draws = (uint32_t)culler.Visible(face).size() + skyDraws;
+			culledDraws += draws;
+			if(faces & (1 << face))
+			{
+				scheduledDraws += draws;
+				++scheduledFaces;
+			}
+			oldestFace = (std::max)(oldestFace, orbitScheduler.Age(0, face));
+		}
+	}
+
+	ModuleTests::Report("skull orbit, %zu items: draws per frame %zu for every face, %.1f culled, %.1f culled and scheduled (%.2f faces)",
+		spheres.size(), 6*(spheres.size() + skyDraws), (double)culledDraws / frameCount,
+		(double)scheduledDraws / frameCount, (double)scheduledFaces / frameCount);
+	ModuleTests::Report("%.2f us per cull, oldest face %u frames", cullTime * 1e6 / frameCount, oldestFace);
+	CHECK(culledDraws < 6*(spheres.size() + skyDraws)*frameCount);
+	CHECK(scheduledFaces <= 6 + orbitScheduler.GetDesc().FaceBudget*(frameCount - 1));
+	CHECK(oldestFace <= orbitScheduler.GetDesc().RefreshFrames + 3);
+}
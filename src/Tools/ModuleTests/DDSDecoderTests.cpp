@@ -0,0 +1,439 @@
+//***************************************************************************************
+// DDSDecoderTests.cpp
+//
+// DDS files are built in memory for each layout the decoder reads, and the block
+// decoders are checked against palettes worked out by hand from the format
+// specifications.  The terrain height tiles are decoded and compared with the 16-bit
+// TIFF exports that came with them.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/DDSDecoder.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	enum : uint32_t
+	{
+		FormatR32G32B32A32Float = 2,
+		FormatR8G8B8A8Unorm = 28,
+		FormatR32Float = 41,
+		FormatR16Float = 54,
+		FormatR16Unorm = 56,
+		FormatR8Unorm = 61,
+		FormatBC1Unorm = 71,
+		FormatBC4Unorm = 80,
+		FormatB8G8R8A8Unorm = 87,
+		FormatBC7Unorm = 98
+	};
+
+	// Legacy pixel format fields of a DDS header.
+	struct LegacyFormat
+	{
+		uint32_t Flags;
+		uint32_t FourCC;
+		uint32_t BitCount;
+		uint32_t Masks[4];
+	};
+
+	void Append32(std::vector<uint8_t>& out, uint32_t value)
+	{
+		for(int i = 0; i < 4; ++i)
+			out.push_back((uint8_t)(value >> (8*i)));
+	}
+
+	// A 2D DDS with a DX10 header, or with the legacy header when legacy is given.
+	std::vector<uint8_t> MakeDDS(uint32_t width, uint32_t height, uint32_t mipCount, uint32_t format,
+		const std::vector<uint8_t>& payload, const LegacyFormat* legacy = nullptr)
+	{
+		std::vector<uint8_t> dds;
+		Append32(dds, 0x20534444);
+
+		Append32(dds, 124);
+		Append32(dds, 0x1007 | (mipCount > 1 ? 0x20000 : 0));
+		Append32(dds, height);
+		Append32(dds, width);
+		Append32(dds, 0);
+		Append32(dds, 0);
+		Append32(dds, mipCount);
+		for(int i = 0; i < 11; ++i)
+			Append32(dds, 0);
+
+		Append32(dds, 32);
+		if(legacy != nullptr)
+		{
+			Append32(dds, legacy->Flags);
+			Append32(dds, legacy->FourCC);
+			Append32(dds, legacy->BitCount);
+			for(uint32_t mask : legacy->Masks)
+				Append32(dds, mask);
+		}
+		else
+		{
+			Append32(dds, 0x4);
+			Append32(dds, 0x30315844); // "DX10"
+			for(int i = 0; i < 5; ++i)
+				Append32(dds, 0);
+		}
+
+		Append32(dds, 0x1000);
+		for(int i = 0; i < 4; ++i)
+			Append32(dds, 0);
+
+		if(legacy == nullptr)
+		{
+			Append32(dds, format);
+			Append32(dds, 3);
+			Append32(dds, 0);
+			Append32(dds, 1);
+			Append32(dds, 0);
+		}
+
+		dds.insert(dds.end(), payload.begin(), payload.end());
+		return dds;
+	}
+
+	template<typename T>
+	std::vector<uint8_t> Bytes(const std::vector<T>& values)
+	{
+		std::vector<uint8_t> bytes(values.size() * sizeof(T));
+		std::memcpy(bytes.data(), values.data(), bytes.size());
+		return bytes;
+	}
+
+	uint16_t FloatToHalf(float f)
+	{
+		// Exact for the small integers and halves used below.
+		uint32_t bits;
+		std::memcpy(&bits, &f, 4);
+		uint32_t sign = (bits >> 16) & 0x8000;
+		int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+		uint32_t mantissa = (bits >> 13) & 0x3ff;
+		if((bits & 0x7fffffff) == 0)
+			return (uint16_t)sign;
+		return (uint16_t)(sign | ((uint32_t)exponent << 10) | mantissa);
+	}
+
+	// Writes fields from the least significant bit up, as BC7 stores them.
+	class BitWriter
+	{
+	public:
+		void Write(uint32_t value, uint32_t bits)
+		{
+			for(uint32_t i = 0; i < bits; ++i, ++mPosition)
+			{
+				if((value >> i) & 1)
+					mBlock[mPosition / 8] |= (uint8_t)(1u << (mPosition % 8));
+			}
+		}
+
+		const uint8_t* Block()const { return mBlock; }
+		uint32_t Position()const { return mPosition; }
+
+	private:
+		uint8_t mBlock[16] = {};
+		uint32_t mPosition = 0;
+	};
+
+	// Baseline little-endian TIFF, one 16-bit gray channel, uncompressed.
+	bool LoadTiff16(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint16_t>& texels)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		if(data.size() < 8 || data[0] != 'I' || data[1] != 'I')
+			return false;
+
+		auto read16 = [&](size_t offset) { return (uint32_t)data[offset] | ((uint32_t)data[offset + 1] << 8); };
+		auto read32 = [&](size_t offset) { return read16(offset) | (read16(offset + 2) << 16); };
+
+		uint32_t bits = 0, compression = 1, samples = 1;
+		uint32_t stripCount = 0, stripOffsets = 0, stripBytes = 0;
+		width = height = 0;
+
+		size_t ifd = read32(4);
+		if(ifd + 2 > data.size())
+			return false;
+
+		const uint32_t entryCount = read16(ifd);
+		for(uint32_t e = 0; e < entryCount && ifd + 2 + (e + 1)*12 <= data.size(); ++e)
+		{
+			size_t entry = ifd + 2 + e*12;
+			uint32_t tag = read16(entry);
+			uint32_t type = read16(entry + 2);
+			uint32_t count = read32(entry + 4);
+			uint32_t value = type == 3 && count == 1 ? read16(entry + 8) : read32(entry + 8);
+
+			switch(tag)
+			{
+			case 256: width = value; break;
+			case 257: height = value; break;
+			case 258: bits = value; break;
+			case 259: compression = value; break;
+			case 277: samples = value; break;
+			case 273: stripCount = count; stripOffsets = value; break;
+			case 279: stripBytes = value; break;
+			}
+		}
+
+		if(bits != 16 || compression != 1 || samples != 1 || width == 0 || height == 0 || stripCount == 0)
+			return false;
+
+		// With one strip the offset and byte count are the values themselves, otherwise
+		// they point at arrays of 32-bit values.
+		texels.clear();
+		texels.reserve((size_t)width * height);
+		for(uint32_t s = 0; s < stripCount; ++s)
+		{
+			size_t offset = stripCount == 1 ? stripOffsets : read32(stripOffsets + 4*s);
+			size_t bytes = stripCount == 1 ? stripBytes : read32(stripBytes + 4*s);
+			if(offset + bytes > data.size())
+				return false;
+			for(size_t i = 0; i + 1 < bytes; i += 2)
+				texels.push_back((uint16_t)read16(offset + i));
+		}
+		return texels.size() >= (size_t)width * height;
+	}
+}
+
+TEST_SUITE(DDSDecoder)
+{
+	// Uncompressed layouts, with the DX10 header and the legacy equivalents.
+	{
+		std::vector<uint8_t> r8(4*3);
+		for(size_t i = 0; i < r8.size(); ++i)
+			r8[i] = (uint8_t)(i*23);
+
+		DDSDecoder::Image image;
+		std::vector<uint8_t> dds = MakeDDS(4, 3, 1, FormatR8Unorm, r8);
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image));
+		CHECK(image.Width == 4 && image.Height == 3 && image.Format == FormatR8Unorm);
+		bool match = image.Texels.size() == r8.size();
+		for(size_t i = 0; match && i < r8.size(); ++i)
+			match = std::fabs(image.Texels[i].x - r8[i] / 255.0f) < 1.0e-6f && image.Texels[i].y == 0.0f && image.Texels[i].w == 1.0f;
+		CHECK(match);
+
+		// L16 luminance.
+		std::vector<uint16_t> r16 = { 0, 1, 32768, 65535 };
+		LegacyFormat l16 = { 0x20000, 0, 16, { 0xffff, 0, 0, 0 } };
+		dds = MakeDDS(2, 2, 1, 0, Bytes(r16), &l16);
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image));
+		CHECK(image.Format == FormatR16Unorm);
+		match = image.Texels.size() == 4;
+		for(size_t i = 0; match && i < 4; ++i)
+			match = std::fabs(image.Texels[i].x - r16[i] / 65535.0f) < 1.0e-7f;
+		CHECK(match);
+
+		std::vector<uint16_t> r16f;
+		for(float f : { 0.0f, 0.5f, -2.0f, 1000.0f })
+			r16f.push_back(FloatToHalf(f));
+		dds = MakeDDS(2, 2, 1, FormatR16Float, Bytes(r16f));
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image));
+		CHECK(image.Texels.size() == 4 && image.Texels[1].x == 0.5f && image.Texels[2].x == -2.0f && image.Texels[3].x == 1000.0f);
+
+		// D3DFMT_R32F.
+		std::vector<float> r32 = { -1.5f, 0.25f, 3.0e5f, 7.0f };
+		LegacyFormat r32f = { 0x4, 114, 0, { 0, 0, 0, 0 } };
+		dds = MakeDDS(4, 1, 1, 0, Bytes(r32), &r32f);
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image));
+		CHECK(image.Format == FormatR32Float && image.Texels.size() == 4 &&
+			image.Texels[0].x == -1.5f && image.Texels[2].x == 3.0e5f);
+
+		// BGRA comes back as RGBA.
+		std::vector<uint8_t> bgra = { 10, 20, 30, 40 };
+		LegacyFormat b8g8r8a8 = { 0x41, 0, 32, { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 } };
+		dds = MakeDDS(1, 1, 1, 0, bgra, &b8g8r8a8);
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image));
+		CHECK(image.Format == FormatB8G8R8A8Unorm && image.Texels.size() == 1);
+		CHECK_NEAR(image.Texels[0].x, 30 / 255.0f, 1.0e-6);
+		CHECK_NEAR(image.Texels[0].y, 20 / 255.0f, 1.0e-6);
+		CHECK_NEAR(image.Texels[0].z, 10 / 255.0f, 1.0e-6);
+		CHECK_NEAR(image.Texels[0].w, 40 / 255.0f, 1.0e-6);
+
+		std::vector<float> rgba32 = { 1.0f, 2.0f, 3.0f, 4.0f };
+		dds = MakeDDS(1, 1, 1, FormatR32G32B32A32Float, Bytes(rgba32));
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image));
+		CHECK(image.Texels.size() == 1 && image.Texels[0].z == 3.0f && image.Texels[0].w == 4.0f);
+	}
+
+	// Mip levels: 4x4, 2x2 and 1x1 one after the other.
+	{
+		std::vector<uint8_t> chain(16 + 4 + 1);
+		for(size_t i = 0; i < chain.size(); ++i)
+			chain[i] = (uint8_t)i;
+		std::vector<uint8_t> dds = MakeDDS(4, 4, 3, FormatR8Unorm, chain);
+
+		DDSDecoder::Info info;
+		CHECK(DDSDecoder::GetInfo(dds.data(), dds.size(), info));
+		CHECK(info.Width == 4 && info.Height == 4 && info.MipCount == 3 && info.ArraySize == 1 && !info.IsCube);
+
+		DDSDecoder::Image image;
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image, 1));
+		CHECK(image.Width == 2 && image.Height == 2 && image.Texels.size() == 4 && image.Texels[3].x == 19 / 255.0f);
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image, 2));
+		CHECK(image.Width == 1 && image.Texels.size() == 1 && image.Texels[0].x == 20 / 255.0f);
+		CHECK(!DDSDecoder::LoadFromMemory(dds.data(), dds.size(), image, 3));
+
+		// Truncated data, a bad magic and an unsupported format are refused.
+		CHECK(!DDSDecoder::LoadFromMemory(dds.data(), dds.size() - 1, image, 2));
+		std::vector<uint8_t> bad = dds;
+		bad[0] = 'X';
+		CHECK(!DDSDecoder::LoadFromMemory(bad.data(), bad.size(), image));
+		bad = MakeDDS(4, 4, 1, 95 /* BC6H_UF16 */, std::vector<uint8_t>(16*16));
+		CHECK(!DDSDecoder::LoadFromMemory(bad.data(), bad.size(), image));
+	}
+
+	// BC1: red 565 and blue 565 endpoints, both palette modes.
+	{
+		uint8_t rgba[16][4];
+		uint8_t block[8] = { 0x00, 0xf8, 0x1f, 0x00, 0xe4, 0xe4, 0xe4, 0xe4 }; // indices 0,1,2,3 per row
+		DDSDecoder::DecodeBC1Block(block, rgba);
+
+		const uint8_t expected[4][4] = { { 255, 0, 0, 255 }, { 0, 0, 255, 255 }, { 170, 0, 85, 255 }, { 85, 0, 170, 255 } };
+		bool match = true;
+		for(int i = 0; i < 16; ++i)
+			match = match && std::memcmp(rgba[i], expected[i % 4], 4) == 0;
+		CHECK(match);
+
+		// c0 <= c1: index 2 is the midpoint and index 3 transparent black.
+		uint8_t block3[8] = { 0x1f, 0x00, 0x00, 0xf8, 0xe4, 0xe4, 0xe4, 0xe4 };
+		DDSDecoder::DecodeBC1Block(block3, rgba);
+		CHECK(rgba[2][0] == 127 && rgba[2][2] == 127 && rgba[2][3] == 255);
+		CHECK(rgba[3][0] == 0 && rgba[3][1] == 0 && rgba[3][2] == 0 && rgba[3][3] == 0);
+	}
+
+	// BC4: eight-value and six-value palettes.
+	{
+		uint8_t rgba[16][4];
+		BitWriter indices;
+		for(uint32_t i = 0; i < 16; ++i)
+			indices.Write(i % 8, 3);
+
+		uint8_t block[8] = { 200, 100 };
+		std::memcpy(block + 2, indices.Block(), 6);
+		DDSDecoder::DecodeBC4Block(block, rgba);
+
+		const uint8_t eight[8] = { 200, 100, 186, 171, 157, 143, 129, 114 };
+		bool match = true;
+		for(int i = 0; i < 16; ++i)
+			match = match && rgba[i][0] == eight[i % 8] && rgba[i][1] == 0 && rgba[i][3] == 255;
+		CHECK(match);
+
+		block[0] = 100;
+		block[1] = 200;
+		DDSDecoder::DecodeBC4Block(block, rgba);
+		const uint8_t six[8] = { 100, 200, 120, 140, 160, 180, 0, 255 };
+		match = true;
+		for(int i = 0; i < 16; ++i)
+			match = match && rgba[i][0] == six[i % 8];
+		CHECK(match);
+	}
+
+	// BC7 mode 6: one subset, 7-bit endpoints with a p-bit each and 4-bit indices.
+	{
+		BitWriter bits;
+		bits.Write(1u << 6, 7);
+
+		// Red 0 -> 255, green 255 -> 0, blue 64 -> 64, alpha 255 -> 255 once the p-bits
+		// (0 and 1) are appended.
+		const uint32_t endpoints[4][2] = { { 0, 127 }, { 127, 0 }, { 32, 32 }, { 127, 127 } };
+		for(int c = 0; c < 4; ++c)
+			for(int e = 0; e < 2; ++e)
+				bits.Write(endpoints[c][e], 7);
+		bits.Write(0, 1);
+		bits.Write(1, 1);
+
+		// Texel 0 is the anchor and drops the top bit of its index.
+		for(uint32_t i = 0; i < 16; ++i)
+			bits.Write(i, i == 0 ? 3 : 4);
+		CHECK(bits.Position() == 128);
+
+		// 0 -> 0, 127 with p-bit 1 -> 255, 127 with p-bit 0 -> 254, 32 -> 64 or 65.
+		const uint32_t weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+		const uint32_t low[4] = { 0, 254, 64, 254 };
+		const uint32_t high[4] = { 255, 1, 65, 255 };
+
+		uint8_t rgba[16][4];
+		DDSDecoder::DecodeBC7Block(bits.Block(), rgba);
+
+		bool match = true;
+		for(uint32_t i = 0; i < 16; ++i)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				uint32_t value = ((64 - weights[i])*low[c] + weights[i]*high[c] + 32) >> 6;
+				match = match && rgba[i][c] == value;
+			}
+		}
+		CHECK(match);
+
+		// Mode 8 is reserved and decodes to transparent black.
+		uint8_t reserved[16] = {};
+		DDSDecoder::DecodeBC7Block(reserved, rgba);
+		CHECK(rgba[5][0] == 0 && rgba[5][3] == 0);
+	}
+
+	// A region decodes to the same texels as the whole level, also when it cuts blocks.
+	{
+		std::mt19937 rng(7);
+		std::vector<uint8_t> blocks(5*3*8);
+		for(auto& b : blocks)
+			b = (uint8_t)rng();
+		std::vector<uint8_t> dds = MakeDDS(20, 12, 1, FormatBC4Unorm, blocks);
+
+		DDSDecoder::Image whole, part;
+		DDSDecoder::Region region;
+		region.X = 3;
+		region.Y = 2;
+		region.Width = 11;
+		region.Height = 7;
+		CHECK(DDSDecoder::LoadFromMemory(dds.data(), dds.size(), whole));
+		CHECK(DDSDecoder::LoadRegionFromMemory(dds.data(), dds.size(), 0, region, part));
+		CHECK(part.Width == 11 && part.Height == 7);
+
+		bool match = part.Texels.size() == 11*7;
+		for(uint32_t y = 0; match && y < 7; ++y)
+			for(uint32_t x = 0; x < 11; ++x)
+				match = match && part.Texels[y*11 + x].x == whole.Texels[(y + 2)*20 + x + 3].x;
+		CHECK(match);
+	}
+
+	// The terrain's BC7 height tiles against the 16-bit TIFF exports of the same heights.
+	{
+		const std::string tile = "Chapter 25 Terrain/Terrain/TerrainDetails/001/Height/Height_Out_y1_x2";
+		const std::string ddsPath = ModuleTests::SourcePath(tile + ".dds");
+		const std::string tifPath = ModuleTests::SourcePath(tile + ".tif");
+
+		DDSDecoder::Image image;
+		uint32_t width = 0, height = 0;
+		std::vector<uint16_t> reference;
+		bool loaded = DDSDecoder::LoadFromFile(std::wstring(ddsPath.begin(), ddsPath.end()), image) &&
+			LoadTiff16(tifPath, width, height, reference);
+		CHECK(loaded);
+		CHECK(image.Format == FormatBC7Unorm && image.Width == width && image.Height == height);
+
+		if(loaded && image.Width == width && image.Height == height)
+		{
+			double maxError = 0.0;
+			double sumError = 0.0;
+			for(size_t i = 0; i < reference.size() && i < image.Texels.size(); ++i)
+			{
+				double error = std::fabs(image.Texels[i].x - reference[i] / 65535.0);
+				maxError = (std::max)(maxError, error);
+				sumError += error;
+			}
+
+			const double meanError = sumError / reference.size();
+			ModuleTests::Report("%ux%u BC7 tile vs TIFF: max error %.5f, mean %.6f", width, height, maxError, meanError);
+
+			// An 8-bit channel is off by up to half a step plus BC7's endpoint error.
+			CHECK(maxError < 0.01);
+			CHECK(meanError < 0.002);
+		}
+	}
+}
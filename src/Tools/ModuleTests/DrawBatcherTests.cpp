@@ -0,0 +1,325 @@
+//***************************************************************************************
+// DrawBatcherTests.cpp
+//
+// The radix sort against std::stable_sort, keys and indices both, on keys that need
+// an odd and an even number of passes.  Keys order by layer, pso, material,
+// geometry, mesh and then depth, with back to front layers by depth first.  The
+// batches of a synthetic scene cover every draw once in key order, hold one state
+// each and flag what changed; with MaterialPerInstance a change of material neither
+// splits a batch nor counts, and without Instancing every draw is its own batch.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/DrawBatcher.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace
+{
+	std::vector<DrawBatcher::Entry> StableSorted(std::vector<DrawBatcher::Entry> entries)
+	{
+		std::stable_sort(entries.begin(), entries.end(),
+			[](const DrawBatcher::Entry& a, const DrawBatcher::Entry& b) { return a.Key < b.Key; });
+		return entries;
+	}
+
+	bool SameEntries(const std::vector<DrawBatcher::Entry>& a, const std::vector<DrawBatcher::Entry>& b)
+	{
+		if(a.size() != b.size())
+			return false;
+		for(size_t i = 0; i < a.size(); ++i)
+		{
+			if(a[i].Key != b[i].Key || a[i].Index != b[i].Index)
+				return false;
+		}
+		return true;
+	}
+
+	// Few distinct values in the bytes under mask, so many keys are equal.
+	std::vector<DrawBatcher::Entry> RandomEntries(std::mt19937& rng, uint32_t count, uint64_t mask)
+	{
+		std::vector<DrawBatcher::Entry> entries(count);
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			uint64_t bits = ((uint64_t)rng() << 32 | rng()) & 0x0707070707070707ull;
+			entries[i] = { (bits & mask) | 0x1000000000000000ull, i };
+		}
+		return entries;
+	}
+
+	bool SameState(const DrawBatcher::Draw& a, const DrawBatcher::Draw& b, bool materialPerInstance)
+	{
+		return a.Layer == b.Layer && a.Pso == b.Pso && (materialPerInstance || a.Material == b.Material) &&
+			a.Geometry == b.Geometry && a.Mesh == b.Mesh;
+	}
+
+	// Every draw once, keys in order, one state per batch, a new state per batch
+	// when instancing, and the change flags true to what changed.
+	bool ValidBatches(const DrawBatcher& batcher)
+	{
+		const DrawBatcher::Desc& desc = batcher.GetDesc();
+		const std::vector<uint32_t>& order = batcher.Order();
+		const std::vector<DrawBatcher::Batch>& batches = batcher.Batches();
+		const uint32_t count = batcher.DrawCount();
+		if(order.size() != count)
+			return false;
+
+		std::vector<uint32_t> seen(count, 0);
+		for(uint32_t index : order)
+		{
+			if(index >= count || seen[index]++ != 0)
+				return false;
+		}
+
+		for(uint32_t k = 1; k < count; ++k)
+		{
+			if(batcher.Key(batcher.GetDraw(order[k - 1])) > batcher.Key(batcher.GetDraw(order[k])))
+				return false;
+		}
+
+		uint32_t covered = 0;
+		for(size_t i = 0; i < batches.size(); ++i)
+		{
+			const DrawBatcher::Batch& batch = batches[i];
+			if(batch.First != covered || batch.Count == 0)
+				return false;
+			covered += batch.Count;
+
+			const DrawBatcher::Draw& first = batcher.GetDraw(order[batch.First]);
+			for(uint32_t k = 1; k < batch.Count; ++k)
+			{
+				if(!SameState(first, batcher.GetDraw(order[batch.First + k]), desc.MaterialPerInstance))
+					return false;
+			}
+
+			if(desc.MaterialPerInstance && batch.MaterialChanged)
+				return false;
+
+			if(i == 0)
+			{
+				if(!batch.PsoChanged || batch.MaterialChanged == desc.MaterialPerInstance || !batch.GeometryChanged)
+					return false;
+				continue;
+			}
+
+			const DrawBatcher::Draw& previous = batcher.GetDraw(order[batches[i - 1].First]);
+			if(desc.Instancing && SameState(previous, first, desc.MaterialPerInstance))
+				return false;
+			if(batch.PsoChanged != (previous.Pso != first.Pso) ||
+				batch.MaterialChanged != (!desc.MaterialPerInstance && previous.Material != first.Material) ||
+				batch.GeometryChanged != (previous.Geometry != first.Geometry))
+				return false;
+		}
+
+		return covered == count && batcher.GetStats().Draws == batches.size();
+	}
+
+	void BuildScene(DrawBatcher& batcher, const std::vector<DrawBatcher::Draw>& draws)
+	{
+		batcher.Clear();
+		for(const DrawBatcher::Draw& draw : draws)
+			batcher.Add(draw);
+		batcher.Build();
+	}
+}
+
+TEST_SUITE(DrawBatcher)
+{
+	std::mt19937 rng(49);
+
+	// Nothing and one entry are left alone.
+	std::vector<DrawBatcher::Entry> entries, scratch;
+	DrawBatcher::RadixSort(entries, scratch);
+	CHECK(entries.empty());
+	entries.push_back({ 42, 0 });
+	DrawBatcher::RadixSort(entries, scratch);
+	CHECK(entries.size() == 1 && entries[0].Key == 42 && entries[0].Index == 0);
+
+	// One, two, three and seven passes; after an odd number the result is in scratch
+	// and has to come back.
+	for(uint64_t mask : { 0x0000000000000700ull, 0x0000000000000707ull, 0x0007000700000007ull, 0x0707070707070707ull })
+	{
+		entries = RandomEntries(rng, 5000, mask);
+		std::vector<DrawBatcher::Entry> reference = StableSorted(entries);
+		DrawBatcher::RadixSort(entries, scratch);
+		CHECK(SameEntries(entries, reference));
+		CHECK(scratch.size() == entries.size());
+	}
+
+	// Each field outweighs every field below it, and depth sorts front to back.
+	DrawBatcher batcher(DrawBatcher::Desc{});
+	DrawBatcher::Draw low;
+	low.Pso = 200;
+	low.Material = 4000;
+	low.Geometry = 4000;
+	low.Mesh = 4000;
+	low.Depth = 999.0f;
+	DrawBatcher::Draw high = low;
+	high.Layer = 1;
+	high.Pso = high.Material = high.Geometry = high.Mesh = 0;
+	high.Depth = 0.0f;
+	CHECK(batcher.Key(high) > batcher.Key(low));
+
+	low.Layer = high.Layer;
+	high.Pso = 201;
+	CHECK(batcher.Key(high) > batcher.Key(low));
+
+	low.Pso = high.Pso;
+	high.Material = 4001;
+	CHECK(batcher.Key(high) > batcher.Key(low));
+
+	low.Material = high.Material;
+	high.Geometry = 4001;
+	CHECK(batcher.Key(high) > batcher.Key(low));
+
+	low.Geometry = high.Geometry;
+	high.Mesh = 4001;
+	CHECK(batcher.Key(high) > batcher.Key(low));
+
+	low.Mesh = high.Mesh;
+	high.Depth = 999.5f;
+	CHECK(batcher.Key(high) > batcher.Key(low));
+	// Past FarZ depth clamps.
+	low.Depth = 1500.0f;
+	high.Depth = 2000.0f;
+	CHECK(batcher.Key(high) == batcher.Key(low));
+
+	// A back to front layer orders by depth, far first, before any state, and still
+	// after the layers below it.
+	DrawBatcher::Desc blendedDesc;
+	blendedDesc.BackToFrontLayers = 1 << 2;
+	DrawBatcher blended(blendedDesc);
+	std::uniform_real_distribution<float> depth(0.0f, blendedDesc.FarZ);
+	std::vector<DrawBatcher::Draw> draws(2000);
+	for(DrawBatcher::Draw& draw : draws)
+	{
+		draw.Layer = 1 + rng() % 2;
+		draw.Pso = rng() % 4;
+		draw.Material = rng() % 16;
+		draw.Geometry = rng() % 4;
+		draw.Mesh = rng() % 8;
+		draw.Depth = depth(rng);
+	}
+	BuildScene(blended, draws);
+	CHECK(ValidBatches(blended));
+	bool layered = true, farFirst = true;
+	for(uint32_t k = 1; k < blended.DrawCount(); ++k)
+	{
+		const DrawBatcher::Draw& a = blended.GetDraw(blended.Order()[k - 1]);
+		const DrawBatcher::Draw& b = blended.GetDraw(blended.Order()[k]);
+		layered = layered && a.Layer <= b.Layer;
+		farFirst = farFirst && (a.Layer != 2 || b.Layer != 2 || a.Depth >= b.Depth - blendedDesc.FarZ / 65535.0f);
+	}
+	CHECK(layered && farFirst);
+
+	// Three materials on one mesh: three batches, or one when the material comes with
+	// the instance, its instances still grouped by material.  Another mesh splits.
+	std::vector<DrawBatcher::Draw> materials(12);
+	for(uint32_t i = 0; i < materials.size(); ++i)
+	{
+		materials[i].Material = i % 3;
+		materials[i].Depth = (float)(materials.size() - i);
+	}
+	materials.back().Mesh = 1;
+
+	BuildScene(batcher, materials);
+	CHECK(ValidBatches(batcher));
+	CHECK(batcher.Batches().size() == 4 && batcher.GetStats().MaterialChanges == 3);
+
+	DrawBatcher::Desc perInstanceDesc;
+	perInstanceDesc.MaterialPerInstance = true;
+	DrawBatcher perInstance(perInstanceDesc);
+	BuildScene(perInstance, materials);
+	CHECK(ValidBatches(perInstance));
+	CHECK(perInstance.Batches().size() == 2 && perInstance.Batches()[0].Count == 11);
+	CHECK(perInstance.GetStats().MaterialChanges == 0 && perInstance.UnsortedStats().MaterialChanges == 0);
+	bool grouped = true;
+	for(uint32_t k = 1; k < 11; ++k)
+		grouped = grouped && materials[perInstance.Order()[k - 1]].Material <= materials[perInstance.Order()[k]].Material;
+	CHECK(grouped);
+
+	// A larger scene: four layers, the last one blended, and draws spread over a few
+	// hundred distinct states at random depths.
+	const uint32_t drawCount = 20000;
+	const uint32_t stateCount = 400;
+	DrawBatcher::Desc sceneDesc;
+	sceneDesc.BackToFrontLayers = 1 << 3;
+
+	std::vector<DrawBatcher::Draw> states(stateCount);
+	for(DrawBatcher::Draw& state : states)
+	{
+		state.Layer = rng() % 4;
+		state.Pso = rng() % 8;
+		state.Material = rng() % 64;
+		state.Geometry = rng() % 16;
+		state.Mesh = state.Geometry*8 + rng() % 8;
+	}
+	draws.resize(drawCount);
+	for(DrawBatcher::Draw& draw : draws)
+	{
+		draw = states[rng() % stateCount];
+		draw.Depth = depth(rng);
+	}
+
+	DrawBatcher scene(sceneDesc);
+	const int runs = 20;
+	double buildTime = ModuleTests::Seconds([&]()
+	{
+		for(int run = 0; run < runs; ++run)
+			BuildScene(scene, draws);
+	}) / runs;
+	CHECK(ValidBatches(scene));
+
+	DrawBatcher::Desc sortOnlyDesc = sceneDesc;
+	sortOnlyDesc.Instancing = false;
+	DrawBatcher sortOnly(sortOnlyDesc);
+	BuildScene(sortOnly, draws);
+	CHECK(ValidBatches(sortOnly));
+	CHECK(sortOnly.Batches().size() == drawCount);
+
+	DrawBatcher::Desc sceneMaterialDesc = sceneDesc;
+	sceneMaterialDesc.MaterialPerInstance = true;
+	DrawBatcher sceneMaterial(sceneMaterialDesc);
+	BuildScene(sceneMaterial, draws);
+	CHECK(ValidBatches(sceneMaterial));
+	CHECK(sceneMaterial.GetStats().Draws <= scene.GetStats().Draws);
+
+	const DrawBatcher::Stats unsorted = scene.UnsortedStats();
+	CHECK(unsorted.Draws == drawCount);
+	CHECK(scene.GetStats().StateChanges() <= sortOnly.GetStats().StateChanges());
+	CHECK(sortOnly.GetStats().StateChanges() < unsorted.StateChanges());
+
+	auto report = [](const char* name, const DrawBatcher::Stats& stats)
+	{
+		ModuleTests::Report("%s %u draws, %u state changes (%u pso, %u material, %u geometry)", name,
+			stats.Draws, stats.StateChanges(), stats.PsoChanges, stats.MaterialChanges, stats.GeometryChanges);
+	};
+	ModuleTests::Report("%u draws over %u states, build %.2f ms", drawCount, stateCount, buildTime * 1000.0);
+	report("insertion order:      ", unsorted);
+	report("sorted:               ", sortOnly.GetStats());
+	report("batched:              ", scene.GetStats());
+	report("material per instance:", sceneMaterial.GetStats());
+
+	// The radix sort against std::stable_sort on the scene's keys.
+	entries.resize(drawCount);
+	for(uint32_t i = 0; i < drawCount; ++i)
+		entries[i] = { scene.Key(draws[i]), i };
+
+	std::vector<DrawBatcher::Entry> radix, reference;
+	double radixTime = ModuleTests::Seconds([&]()
+	{
+		for(int run = 0; run < runs; ++run)
+		{
+			radix = entries;
+			DrawBatcher::RadixSort(radix, scratch);
+		}
+	}) / runs;
+	double stableSortTime = ModuleTests::Seconds([&]()
+	{
+		for(int run = 0; run < runs; ++run)
+			reference = StableSorted(entries);
+	}) / runs;
+	CHECK(SameEntries(radix, reference));
+	ModuleTests::Report("radix sort %.3f ms, std::stable_sort %.3f ms", radixTime * 1000.0, stableSortTime * 1000.0);
+}
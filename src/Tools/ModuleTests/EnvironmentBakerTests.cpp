@@ -0,0 +1,180 @@
+//***************************************************************************************
+// EnvironmentBakerTests.cpp
+//
+// The image based lighting baker against closed forms.  The SH of a constant
+// environment is the constant times 2 sqrt(pi) in the first coefficient and nothing
+// else, and its irradiance is the constant in every direction; the SH of a clamped
+// cosine lobe about +z has only the zonal coefficients sqrt(pi)/2, sqrt(pi/3) and
+// sqrt(5 pi)/8, and an irradiance known band by band.  The prefiltered chain at
+// roughness 0 is the source (or its box filtered mip when the chain is smaller), and
+// a constant environment stays constant at every roughness.  The BRDF table sums
+// scale and bias to the directional albedo of GGX with F0 = 1: 1 for a mirror seen
+// head on, 1 - ln 2 at roughness 1.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/EnvironmentBaker.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t FormatR32G32B32A32Float = 2;
+
+	// A cube map whose texels are radiance(direction through the texel).
+	template<typename Radiance>
+	EnvironmentBaker::CubeMap MakeCube(uint32_t size, Radiance radiance)
+	{
+		EnvironmentBaker::CubeMap cube;
+		cube.Size = size;
+		cube.MipCount = 1;
+		cube.Faces.resize(EnvironmentBaker::FaceCount);
+		for(int face = 0; face < EnvironmentBaker::FaceCount; ++face)
+		{
+			DDSDecoder::Image& image = cube.Face(face);
+			image.Width = size;
+			image.Height = size;
+			image.Format = FormatR32G32B32A32Float;
+			image.Texels.resize((size_t)size*size);
+			for(uint32_t y = 0; y < size; ++y)
+			{
+				for(uint32_t x = 0; x < size; ++x)
+					image.Texels[(size_t)y*size + x] = radiance(EnvironmentBaker::TexelDirection(face, x, y, size));
+			}
+		}
+		return cube;
+	}
+
+	float LargestDifference(const DDSDecoder::Image& a, const DDSDecoder::Image& b)
+	{
+		float largest = 0.0f;
+		for(size_t i = 0; i < a.Texels.size(); ++i)
+		{
+			largest = (std::max)(largest, fabsf(a.Texels[i].x - b.Texels[i].x));
+			largest = (std::max)(largest, fabsf(a.Texels[i].y - b.Texels[i].y));
+			largest = (std::max)(largest, fabsf(a.Texels[i].z - b.Texels[i].z));
+		}
+		return largest;
+	}
+}
+
+TEST_SUITE(EnvironmentBaker)
+{
+	ThreadPool fourPool(4);
+	EnvironmentBaker::Desc desc;
+	EnvironmentBaker baker(desc, &fourPool);
+
+	// A constant environment.
+	const XMFLOAT4 constant(0.5f, 1.0f, 2.0f, 1.0f);
+	EnvironmentBaker::CubeMap flat = MakeCube(32, [&](FXMVECTOR) { return constant; });
+	EnvironmentBaker::SH9 flatSH = baker.ProjectSH(flat);
+	const float twoSqrtPi = 2.0f*sqrtf(XM_PI);
+	CHECK_NEAR(flatSH.C[0].x, constant.x*twoSqrtPi, 1e-4f);
+	CHECK_NEAR(flatSH.C[0].y, constant.y*twoSqrtPi, 1e-4f);
+	CHECK_NEAR(flatSH.C[0].z, constant.z*twoSqrtPi, 1e-4f);
+	float higher = 0.0f;
+	for(int k = 1; k < 9; ++k)
+		higher = (std::max)(higher, XMVectorGetX(XMVector3Length(XMLoadFloat4(&flatSH.C[k]))));
+	CHECK(higher < 1e-5f);
+
+	EnvironmentBaker::SH9 flatIrradiance = EnvironmentBaker::IrradianceSH(flatSH);
+	float irradianceError = 0.0f;
+	std::mt19937 rng(47);
+	std::normal_distribution<float> normal;
+	for(int i = 0; i < 100; ++i)
+	{
+		XMVECTOR n = XMVectorSet(normal(rng), normal(rng), normal(rng), 0.0f);
+		XMVECTOR e = EnvironmentBaker::EvaluateSH(flatIrradiance, n);
+		irradianceError = (std::max)(irradianceError, XMVectorGetX(XMVector3Length(e - XMLoadFloat4(&constant))));
+	}
+	CHECK(irradianceError < 1e-5f);
+
+	// A clamped cosine lobe about +z.
+	EnvironmentBaker::CubeMap lobe = MakeCube(64, [](FXMVECTOR d)
+	{
+		float c = (std::max)(XMVectorGetZ(d), 0.0f);
+		return XMFLOAT4(c, c, c, 1.0f);
+	});
+	EnvironmentBaker::SH9 lobeSH = baker.ProjectSH(lobe);
+	const float zonal[9] = { sqrtf(XM_PI)*0.5f, 0.0f, sqrtf(XM_PI / 3.0f), 0.0f, 0.0f, 0.0f, sqrtf(5.0f*XM_PI)*0.125f, 0.0f, 0.0f };
+	float lobeError = 0.0f;
+	for(int k = 0; k < 9; ++k)
+		lobeError = (std::max)(lobeError, fabsf(lobeSH.C[k].x - zonal[k]));
+	CHECK(lobeError < 1e-3f);
+
+	// Its irradiance straight up is 2/3; the three bands give 1/4 + 1/3 + 5/64 of it.
+	XMVECTOR up = EnvironmentBaker::EvaluateSH(EnvironmentBaker::IrradianceSH(lobeSH), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f));
+	CHECK_NEAR(XMVectorGetX(up), 0.25f + 1.0f / 3.0f + 5.0f / 64.0f, 1e-3f);
+
+	// The prefilter at roughness 0 is the source, or its mip of the chain's size.
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	EnvironmentBaker::CubeMap noise = MakeCube(32, [&](FXMVECTOR)
+	{
+		return XMFLOAT4(unit(rng), unit(rng), unit(rng), 1.0f);
+	});
+	EnvironmentBaker::Desc smallDesc;
+	smallDesc.SpecularSamples = 64;
+	EnvironmentBaker full(smallDesc, &fourPool);
+	EnvironmentBaker::CubeMap specular = full.PrefilterSpecular(noise);
+	CHECK(specular.Size == 32 && specular.MipCount == 4);
+
+	smallDesc.SpecularSize = 16;
+	EnvironmentBaker half(smallDesc, &fourPool);
+	EnvironmentBaker::CubeMap halfSpecular = half.PrefilterSpecular(noise);
+	EnvironmentBaker::CubeMap noiseMips = noise;
+	half.GenerateMips(noiseMips);
+	CHECK(halfSpecular.Size == 16 && halfSpecular.MipCount == 3);
+
+	bool sourceKept = true;
+	for(int face = 0; face < EnvironmentBaker::FaceCount; ++face)
+	{
+		sourceKept = sourceKept && memcmp(specular.Face(face).Texels.data(), noise.Face(face).Texels.data(),
+			noise.Face(face).Texels.size()*sizeof(XMFLOAT4)) == 0;
+		sourceKept = sourceKept && memcmp(halfSpecular.Face(face).Texels.data(), noiseMips.Face(face, 1).Texels.data(),
+			noiseMips.Face(face, 1).Texels.size()*sizeof(XMFLOAT4)) == 0;
+	}
+	CHECK(sourceKept);
+
+	// Rough mips of a constant environment are that constant.
+	EnvironmentBaker::CubeMap flatSpecular = full.PrefilterSpecular(flat);
+	float flatError = 0.0f;
+	for(uint32_t mip = 1; mip < flatSpecular.MipCount; ++mip)
+	{
+		for(int face = 0; face < EnvironmentBaker::FaceCount; ++face)
+			flatError = (std::max)(flatError, LargestDifference(flatSpecular.Face(face, mip), flat.Face(face)) / constant.z);
+	}
+	CHECK(flatError < 1e-4f);
+
+	// Scale + bias is the albedo with F0 = 1.  Head on and nearly smooth it is 1.  At
+	// roughness 1 and N.V = 1 every sample has V.H = N.H and G = 2 N.L / (N.L + 1), with
+	// N.L uniform on [-1, 1], which integrates to 1 - ln 2.  Texel centers stop half a
+	// texel short of 1, so the last two rows and columns are extrapolated to the edge.
+	EnvironmentBaker::Desc lutDesc;
+	lutDesc.BrdfLutSize = 64;
+	lutDesc.BrdfLutSamples = 1024;
+	EnvironmentBaker lutBaker(lutDesc, &fourPool);
+	DDSDecoder::Image lut;
+	double lutTime = ModuleTests::Seconds([&]() { lut = lutBaker.IntegrateBrdf(); });
+	const uint32_t last = lutDesc.BrdfLutSize - 1;
+	auto albedo = [&](uint32_t x, uint32_t y)
+	{
+		const XMFLOAT4& texel = lut.Texels[(size_t)y*lutDesc.BrdfLutSize + x];
+		return texel.x + texel.y;
+	};
+	float smooth = 1.5f*albedo(last, 0) - 0.5f*albedo(last - 1, 0);
+	float rough = 2.25f*albedo(last, last) - 0.75f*(albedo(last - 1, last) + albedo(last, last - 1)) +
+		0.25f*albedo(last - 1, last - 1);
+	CHECK_NEAR(smooth, 1.0f, 1e-3f);
+	CHECK_NEAR(rough, 1.0f - logf(2.0f), 1e-3f);
+	ModuleTests::Report("at N.V 1: scale + bias %.4f nearly smooth, %.4f at roughness 1 (1 - ln 2 = %.4f)",
+		smooth, rough, 1.0f - logf(2.0f));
+
+	ModuleTests::Report("%ux%u BRDF table of %u samples in %.1f ms on four threads",
+		lutDesc.BrdfLutSize, lutDesc.BrdfLutSize, lutDesc.BrdfLutSamples, lutTime*1e3);
+}
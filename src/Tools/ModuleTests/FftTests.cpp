@@ -0,0 +1,122 @@
+//***************************************************************************************
+// FftTests.cpp
+//
+// Fft against a direct 2D DFT worked out in double, forward and inverse, for sizes
+// with an even and an odd number of radix-2 stages.  An inverse of a forward
+// transform gives the input times the point count, and the result is the same bit
+// for bit on one thread and on four.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/Fft.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Direct DFT, O(n^4).
+	void DftReference2D(const std::vector<float>& re, const std::vector<float>& im, int n, bool inverse,
+		std::vector<double>& outRe, std::vector<double>& outIm)
+	{
+		const double sign = inverse ? 1.0 : -1.0;
+		outRe.assign(n*n, 0.0);
+		outIm.assign(n*n, 0.0);
+		for(int p = 0; p < n; ++p)
+		{
+			for(int q = 0; q < n; ++q)
+			{
+				for(int i = 0; i < n; ++i)
+				{
+					for(int j = 0; j < n; ++j)
+					{
+						double angle = sign * 2.0 * 3.14159265358979323846 * ((i*p + j*q) % n) / n;
+						double c = cos(angle);
+						double s = sin(angle);
+						outRe[p*n + q] += re[i*n + j]*c - im[i*n + j]*s;
+						outIm[p*n + q] += re[i*n + j]*s + im[i*n + j]*c;
+					}
+				}
+			}
+		}
+	}
+}
+
+TEST_SUITE(Fft)
+{
+	std::mt19937 rng(41);
+	std::uniform_real_distribution<float> signedUnit(-1.0f, 1.0f);
+
+	for(int n : { 16, 32, 64 })
+	{
+		Fft fft(n);
+		CHECK(fft.Size() == (uint32_t)n);
+
+		for(bool inverse : { false, true })
+		{
+			std::vector<float> re(n*n), im(n*n);
+			for(int i = 0; i < n*n; ++i)
+			{
+				re[i] = signedUnit(rng);
+				im[i] = signedUnit(rng);
+			}
+
+			std::vector<double> expectedRe, expectedIm;
+			DftReference2D(re, im, n, inverse, expectedRe, expectedIm);
+			fft.Transform2D(re.data(), im.data(), inverse);
+
+			double maxError = 0.0, maxMagnitude = 0.0;
+			for(int i = 0; i < n*n; ++i)
+			{
+				double dr = re[i] - expectedRe[i];
+				double di = im[i] - expectedIm[i];
+				maxError = (std::max)(maxError, sqrt(dr*dr + di*di));
+				maxMagnitude = (std::max)(maxMagnitude, sqrt(expectedRe[i]*expectedRe[i] + expectedIm[i]*expectedIm[i]));
+			}
+
+			ModuleTests::Report("%dx%d %s: max error %.2g of the largest output", n, n,
+				inverse ? "inverse" : "forward", maxError / maxMagnitude);
+			CHECK(maxError < 1e-5*maxMagnitude);
+		}
+	}
+
+	// Round trip and thread count on sizes too big for the direct DFT.
+	ThreadPool serialPool(1), fourPool(4);
+	for(uint32_t n : { 128u, 256u, 512u })
+	{
+		Fft fft(n);
+		std::vector<float> re(n*n), im(n*n);
+		for(uint32_t i = 0; i < n*n; ++i)
+		{
+			re[i] = signedUnit(rng);
+			im[i] = signedUnit(rng);
+		}
+
+		std::vector<float> serialRe(re), serialIm(im), fourRe(re), fourIm(im);
+		fft.Transform2D(serialRe.data(), serialIm.data(), false, &serialPool);
+		fft.Transform2D(fourRe.data(), fourIm.data(), false, &fourPool);
+		CHECK(serialRe == fourRe && serialIm == fourIm);
+
+		fft.Transform2D(fourRe.data(), fourIm.data(), true, &fourPool);
+		float maxError = 0.0f;
+		const float scale = 1.0f / (float)(n*n);
+		for(uint32_t i = 0; i < n*n; ++i)
+		{
+			maxError = (std::max)(maxError, fabsf(fourRe[i]*scale - re[i]));
+			maxError = (std::max)(maxError, fabsf(fourIm[i]*scale - im[i]));
+		}
+		CHECK(maxError < 1e-5f);
+
+		const int runs = 10;
+		double time = 0.0;
+		for(int r = 0; r < runs; ++r)
+		{
+			std::vector<float> timedRe(re), timedIm(im);
+			time += ModuleTests::Seconds([&]() { fft.Transform2D(timedRe.data(), timedIm.data(), false); });
+		}
+		ModuleTests::Report("%ux%u: round trip error %.2g, %.2f ms per transform (%u threads)",
+			n, n, maxError, time * 1000.0 / runs, ThreadPool::Default().ThreadCount());
+	}
+}
@@ -0,0 +1,298 @@
+//***************************************************************************************
+// GaussianBlurTests.cpp
+//
+// The exact path against a direct separable convolution in double with the same
+// kernel and clamped edges, in float and in RGBA8.  An extended box blur of a single
+// bright pixel must spread it with a variance of exactly sigma^2 and stay within a
+// few levels of the exact blur.  Results are the same bit for bit on one thread and
+// on four, and blurring in place gives what blurring into another image gives.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/GaussianBlur.h"
+#include "../../Common/ThreadPool.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	// DXGI_FORMAT values.
+	const uint32_t FormatR32G32B32A32Float = 2;
+	const uint32_t FormatR16G16B16A16Float = 10;
+	const uint32_t FormatR8G8B8A8Unorm = 28;
+	const uint32_t FormatR8G8B8A8UnormSrgb = 29;
+
+	// Smooth gradients, hard edged squares and noise, so that both the flat parts and
+	// the edges of a blur show up in the errors.
+	void MakeTestImage(int width, int height, std::vector<XMFLOAT4>& image)
+	{
+		image.resize(width*height);
+		for(int y = 0; y < height; ++y)
+		{
+			for(int x = 0; x < width; ++x)
+			{
+				uint32_t hash = (x*73856093u) ^ (y*19349663u);
+				hash ^= hash >> 13;
+				hash *= 0x5bd1e995u;
+				hash ^= hash >> 15;
+
+				float u = (float)x / width;
+				float v = (float)y / height;
+				bool square = (((x / 64) + (y / 64)) & 1) != 0;
+				image[y*width + x] = XMFLOAT4(u, square ? 0.9f : 0.1f, (hash & 0xffff) / 65535.0f, 0.5f*(u + v));
+			}
+		}
+	}
+
+	std::vector<uint8_t> ToRgba8(const std::vector<XMFLOAT4>& image)
+	{
+		std::vector<uint8_t> bytes(image.size()*4);
+		for(size_t i = 0; i < image.size(); ++i)
+		{
+			const float* p = &image[i].x;
+			for(int c = 0; c < 4; ++c)
+				bytes[i*4 + c] = (uint8_t)(p[c]*255.0f + 0.5f);
+		}
+		return bytes;
+	}
+
+	// Direct separable convolution in double, with the same kernel and clamped edges
+	// as the exact path.
+	void BlurReference(const std::vector<XMFLOAT4>& src, std::vector<XMFLOAT4>& dst,
+		int width, int height, float sigma)
+	{
+		int radius = GaussianBlur::ExactRadius(sigma);
+		std::vector<double> weights(2*radius + 1);
+		double weightSum = 0.0;
+		for(int k = -radius; k <= radius; ++k)
+		{
+			weights[k + radius] = exp(-(double)k*k / (2.0*sigma*sigma));
+			weightSum += weights[k + radius];
+		}
+		for(auto& w : weights)
+			w /= weightSum;
+
+		std::vector<double> rows(width*height*4, 0.0);
+		for(int y = 0; y < height; ++y)
+		{
+			for(int x = 0; x < width; ++x)
+			{
+				for(int k = -radius; k <= radius; ++k)
+				{
+					const float* p = &src[y*width + (std::min)((std::max)(x + k, 0), width - 1)].x;
+					for(int c = 0; c < 4; ++c)
+						rows[(y*width + x)*4 + c] += weights[k + radius]*p[c];
+				}
+			}
+		}
+
+		dst.resize(width*height);
+		for(int y = 0; y < height; ++y)
+		{
+			for(int x = 0; x < width; ++x)
+			{
+				double sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+				for(int k = -radius; k <= radius; ++k)
+				{
+					int row = (std::min)((std::max)(y + k, 0), height - 1);
+					for(int c = 0; c < 4; ++c)
+						sum[c] += weights[k + radius]*rows[(row*width + x)*4 + c];
+				}
+				dst[y*width + x] = XMFLOAT4((float)sum[0], (float)sum[1], (float)sum[2], (float)sum[3]);
+			}
+		}
+	}
+
+	int MaxLevelError(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+	{
+		int maxError = 0;
+		for(size_t i = 0; i < a.size(); ++i)
+			maxError = (std::max)(maxError, std::abs((int)a[i] - (int)b[i]));
+		return maxError;
+	}
+}
+
+TEST_SUITE(GaussianBlur)
+{
+	CHECK(GaussianBlur::IsFormatSupported(FormatR8G8B8A8Unorm));
+	CHECK(GaussianBlur::IsFormatSupported(FormatR16G16B16A16Float));
+	CHECK(GaussianBlur::IsFormatSupported(FormatR32G32B32A32Float));
+	CHECK(!GaussianBlur::IsFormatSupported(FormatR8G8B8A8UnormSrgb));
+	CHECK(GaussianBlur::ChooseMethod(2.5f) == GaussianBlur::Method::Exact);
+	CHECK(GaussianBlur::ChooseMethod(4.0f) == GaussianBlur::Method::ExtendedBox);
+
+	// The sampled kernel is symmetric and adds up to 1.
+	{
+		std::vector<float> weights = GaussianBlur::GaussWeights(2.5f, GaussianBlur::ExactRadius(2.5f));
+		double sum = 0.0;
+		bool symmetric = true;
+		for(size_t k = 0; k < weights.size(); ++k)
+		{
+			sum += weights[k];
+			symmetric = symmetric && weights[k] == weights[weights.size() - 1 - k];
+		}
+		CHECK(weights.size() == 2*GaussianBlur::ExactRadius(2.5f) + 1);
+		CHECK(symmetric);
+		CHECK_NEAR(sum, 1.0, 1e-6);
+	}
+
+	GaussianBlur blur;
+
+	// A small image with a width and height that do not fill the last tile.
+	const int checkWidth = 131;
+	const int checkHeight = 97;
+	std::vector<XMFLOAT4> image;
+	MakeTestImage(checkWidth, checkHeight, image);
+	std::vector<uint8_t> unsupported(checkWidth*checkHeight*4);
+	CHECK(!blur.Blur(unsupported.data(), unsupported.data(), checkWidth, checkHeight, checkWidth*4,
+		FormatR8G8B8A8UnormSrgb, 2.0f));
+
+	for(float sigma : { 1.0f, 2.5f, 3.0f })
+	{
+		std::vector<XMFLOAT4> reference;
+		BlurReference(image, reference, checkWidth, checkHeight, sigma);
+
+		std::vector<XMFLOAT4> result(image.size());
+		CHECK(blur.Blur(image.data(), result.data(), checkWidth, checkHeight, checkWidth*sizeof(XMFLOAT4),
+			FormatR32G32B32A32Float, sigma, GaussianBlur::Method::Exact));
+
+		float maxError = 0.0f;
+		for(size_t i = 0; i < image.size(); ++i)
+		{
+			const float* p = &reference[i].x;
+			const float* q = &result[i].x;
+			for(int c = 0; c < 4; ++c)
+				maxError = (std::max)(maxError, fabsf(p[c] - q[c]));
+		}
+
+		// RGBA8 takes the same values in and rounds the result to the nearest level.
+		std::vector<uint8_t> bytes = ToRgba8(image);
+		std::vector<XMFLOAT4> byteInput(image.size());
+		for(size_t i = 0; i < image.size(); ++i)
+			byteInput[i] = XMFLOAT4(bytes[i*4] / 255.0f, bytes[i*4 + 1] / 255.0f, bytes[i*4 + 2] / 255.0f, bytes[i*4 + 3] / 255.0f);
+		BlurReference(byteInput, reference, checkWidth, checkHeight, sigma);
+		CHECK(blur.Blur(bytes.data(), bytes.data(), checkWidth, checkHeight, checkWidth*4,
+			FormatR8G8B8A8Unorm, sigma, GaussianBlur::Method::Exact));
+
+		float maxLevelError = 0.0f;
+		for(size_t i = 0; i < image.size(); ++i)
+		{
+			const float* p = &reference[i].x;
+			for(int c = 0; c < 4; ++c)
+				maxLevelError = (std::max)(maxLevelError, fabsf(bytes[i*4 + c] - p[c]*255.0f));
+		}
+
+		ModuleTests::Report("exact, sigma %.1f: max error %.2g in float, %.3f levels in RGBA8", sigma, maxError, maxLevelError);
+		CHECK(maxError < 1e-5f);
+		CHECK(maxLevelError < 0.501f);
+	}
+
+	// A single bright pixel in the middle of a black image.  Its blur must keep the
+	// total and spread it with a variance of sigma^2 along both axes.
+	for(float sigma : { 4.0f, 8.0f, 16.0f })
+	{
+		const int size = 12*(int)sigma + 1;
+		const int center = size / 2;
+		std::vector<XMFLOAT4> impulse(size*size, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+		impulse[center*size + center] = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		CHECK(blur.Blur(impulse.data(), impulse.data(), size, size, size*sizeof(XMFLOAT4),
+			FormatR32G32B32A32Float, sigma, GaussianBlur::Method::ExtendedBox));
+
+		double total = 0.0, varianceX = 0.0, varianceY = 0.0;
+		for(int y = 0; y < size; ++y)
+		{
+			for(int x = 0; x < size; ++x)
+			{
+				double w = impulse[y*size + x].x;
+				total += w;
+				varianceX += w*(x - center)*(x - center);
+				varianceY += w*(y - center)*(y - center);
+			}
+		}
+		ModuleTests::Report("extended box, sigma %.0f: total %.6f, variance %.4f x %.4f", sigma, total, varianceX, varianceY);
+		CHECK_NEAR(total, 1.0, 1e-4);
+		CHECK_NEAR(varianceX, sigma*sigma, 1e-3*sigma*sigma);
+		CHECK_NEAR(varianceY, sigma*sigma, 1e-3*sigma*sigma);
+	}
+
+	// A frame sized image in RGBA8: the boxes against the exact kernel, the thread
+	// count, in place against out of place, and RGBA16F against float.
+	const int width = 1280;
+	const int height = 720;
+	const double megapixels = width*height / 1.0e6;
+	MakeTestImage(width, height, image);
+	std::vector<uint8_t> source = ToRgba8(image);
+	std::vector<uint8_t> exact(source.size()), box(source.size());
+
+	// The first call sizes the buffers.
+	blur.Blur(source.data(), exact.data(), width, height, width*4, FormatR8G8B8A8Unorm, 1.0f);
+
+	for(float sigma : { 2.5f, 4.0f, 8.0f, 16.0f })
+	{
+		double exactTime = ModuleTests::Seconds([&]()
+		{
+			blur.Blur(source.data(), exact.data(), width, height, width*4, FormatR8G8B8A8Unorm, sigma, GaussianBlur::Method::Exact);
+		});
+		double boxTime = ModuleTests::Seconds([&]()
+		{
+			blur.Blur(source.data(), box.data(), width, height, width*4, FormatR8G8B8A8Unorm, sigma, GaussianBlur::Method::ExtendedBox);
+		});
+
+		int maxError = MaxLevelError(exact, box);
+		ModuleTests::Report("sigma %4.1f: exact %.0f MP/s, box %.0f MP/s, box within %d levels of exact",
+			sigma, megapixels / exactTime, megapixels / boxTime, maxError);
+		CHECK(maxError <= 4);
+	}
+
+	for(float sigma : { 32.0f, 64.0f })
+	{
+		double boxTime = ModuleTests::Seconds([&]()
+		{
+			blur.Blur(source.data(), box.data(), width, height, width*4, FormatR8G8B8A8Unorm, sigma);
+		});
+		ModuleTests::Report("sigma %4.1f: box %.0f MP/s", sigma, megapixels / boxTime);
+	}
+
+	ThreadPool serialPool(1), fourPool(4);
+	GaussianBlur serialBlur(&serialPool), fourBlur(&fourPool);
+	for(float sigma : { 2.0f, 16.0f })
+	{
+		std::vector<uint8_t> pooled(source.size()), serial(source.size()), inPlace(source);
+		blur.Blur(source.data(), pooled.data(), width, height, width*4, FormatR8G8B8A8Unorm, sigma);
+		serialBlur.Blur(source.data(), serial.data(), width, height, width*4, FormatR8G8B8A8Unorm, sigma);
+		fourBlur.Blur(inPlace.data(), inPlace.data(), width, height, width*4, FormatR8G8B8A8Unorm, sigma);
+		CHECK(pooled == serial);
+		CHECK(pooled == inPlace);
+	}
+
+	// Halves keep 11 significant bits, and every value here is below 1.
+	{
+		const float sigma = 16.0f;
+		std::vector<XMFLOAT4> floatResult(image.size());
+		blur.Blur(image.data(), floatResult.data(), width, height, width*sizeof(XMFLOAT4), FormatR32G32B32A32Float, sigma);
+
+		std::vector<HALF> halfImage(image.size()*4);
+		XMConvertFloatToHalfStream(halfImage.data(), sizeof(HALF), &image[0].x, sizeof(float), halfImage.size());
+		std::vector<HALF> halfResult(halfImage.size());
+		double halfTime = ModuleTests::Seconds([&]()
+		{
+			blur.Blur(halfImage.data(), halfResult.data(), width, height, width*sizeof(XMHALF4), FormatR16G16B16A16Float, sigma);
+		});
+
+		float maxError = 0.0f;
+		for(size_t i = 0; i < image.size(); ++i)
+		{
+			const float* p = &floatResult[i].x;
+			for(int c = 0; c < 4; ++c)
+				maxError = (std::max)(maxError, fabsf(XMConvertHalfToFloat(halfResult[i*4 + c]) - p[c]));
+		}
+		ModuleTests::Report("RGBA16F, sigma %.0f: %.0f MP/s, max error %.2g against float", sigma, megapixels / halfTime, maxError);
+		CHECK(maxError < 2e-3f);
+	}
+}
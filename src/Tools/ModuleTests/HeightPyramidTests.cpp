@@ -0,0 +1,141 @@
+//***************************************************************************************
+// HeightPyramidTests.cpp
+//
+// The terrain's min/max pyramid must bound the bilinear surface over any rectangle,
+// or culling and picking drop terrain that is there.  Ranges are checked against a
+// dense scan of the surface, on a heightmap whose sides are not powers of two.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 25 Terrain/Terrain/HeightPyramid.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	float Bilinear(const std::vector<float>& heights, int width, int height, float u, float v)
+	{
+		int x0 = (std::min)((int)u, width - 1);
+		int z0 = (std::min)((int)v, height - 1);
+		int x1 = (std::min)(x0 + 1, width - 1);
+		int z1 = (std::min)(z0 + 1, height - 1);
+		float s = u - x0;
+		float t = v - z0;
+
+		float top = heights[z0*width + x0] + (heights[z0*width + x1] - heights[z0*width + x0])*s;
+		float bottom = heights[z1*width + x0] + (heights[z1*width + x1] - heights[z1*width + x0])*s;
+		return top + (bottom - top)*t;
+	}
+}
+
+TEST_SUITE(HeightPyramid)
+{
+	const int width = 67;
+	const int height = 45;
+
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// Smooth hills plus noise, so ranges are neither flat nor all of [0, 1].
+	std::vector<float> heights(width*height);
+	for(int z = 0; z < height; ++z)
+		for(int x = 0; x < width; ++x)
+			heights[z*width + x] = 0.5f + 0.3f*sinf(x*0.2f)*cosf(z*0.15f) + 0.1f*unit(rng);
+
+	HeightPyramid pyramid;
+	float minH, maxH;
+	CHECK(pyramid.IsEmpty() && !pyramid.GetRange(0.0f, 0.0f, 1.0f, 1.0f, minH, maxH));
+
+	pyramid.Build(heights, width, height);
+	CHECK(!pyramid.IsEmpty());
+	CHECK(pyramid.GetLevelWidth(0) == (UINT)width && pyramid.GetLevelHeight(0) == (UINT)height);
+
+	const UINT top = pyramid.GetLevelCount() - 1;
+	CHECK(pyramid.GetLevelWidth(top) == 1 && pyramid.GetLevelHeight(top) == 1);
+
+	// The top cell holds the extremes of the whole map.
+	DirectX::XMFLOAT2 all = pyramid.GetCell(top, 0, 0);
+	CHECK(all.x == *std::min_element(heights.begin(), heights.end()));
+	CHECK(all.y == *std::max_element(heights.begin(), heights.end()));
+
+	// Base cells bound their 2x2 texels, clamped at the far edges.
+	bool baseMatch = true;
+	for(int z = 0; z < height; ++z)
+	{
+		for(int x = 0; x < width; ++x)
+		{
+			int x1 = (std::min)(x + 1, width - 1);
+			int z1 = (std::min)(z + 1, height - 1);
+			float lo = (std::min)((std::min)(heights[z*width + x], heights[z*width + x1]), (std::min)(heights[z1*width + x], heights[z1*width + x1]));
+			float hi = (std::max)((std::max)(heights[z*width + x], heights[z*width + x1]), (std::max)(heights[z1*width + x], heights[z1*width + x1]));
+			DirectX::XMFLOAT2 cell = pyramid.GetCell(0, x, z);
+			baseMatch = baseMatch && cell.x == lo && cell.y == hi;
+		}
+	}
+	CHECK(baseMatch);
+
+	// Random rectangles, from a fraction of a texel to the whole map, against a scan.
+	uint32_t violations = 0;
+	double slack = 0.0;
+	const int rectangles = 2000;
+	for(int r = 0; r < rectangles; ++r)
+	{
+		float u0 = unit(rng)*(width - 1), u1 = unit(rng)*(width - 1);
+		float v0 = unit(rng)*(height - 1), v1 = unit(rng)*(height - 1);
+		if(r % 2 == 0)
+		{
+			// Small rectangles, which read the finest levels.
+			u1 = (std::min)(u0 + unit(rng)*3.0f, width - 1.0f);
+			v1 = (std::min)(v0 + unit(rng)*3.0f, height - 1.0f);
+		}
+
+		if(!pyramid.GetRange(u0, v0, u1, v1, minH, maxH))
+		{
+			++violations;
+			continue;
+		}
+
+		float scanMin = FLT_MAX, scanMax = -FLT_MAX;
+		const int steps = 24;
+		for(int j = 0; j <= steps; ++j)
+		{
+			for(int i = 0; i <= steps; ++i)
+			{
+				float u = u0 + (u1 - u0)*i / steps;
+				float v = v0 + (v1 - v0)*j / steps;
+				float h = Bilinear(heights, width, height, u, v);
+				scanMin = (std::min)(scanMin, h);
+				scanMax = (std::max)(scanMax, h);
+			}
+		}
+
+		if(scanMin < minH || scanMax > maxH)
+			++violations;
+		slack += (maxH - minH) - (scanMax - scanMin);
+	}
+
+	ModuleTests::Report("%d rectangles, mean range wider than the scan by %.4f", rectangles, slack / rectangles);
+	CHECK(violations == 0);
+
+	// Widening a block, as the terrain does when a finer tile arrives, reaches every
+	// level above it and leaves the other cells alone.
+	std::vector<DirectX::XMFLOAT2> ranges(5*3, DirectX::XMFLOAT2(0.45f, 0.55f));
+	ranges[7] = DirectX::XMFLOAT2(-1.0f, 2.0f);
+	DirectX::XMFLOAT2 before = pyramid.GetCell(0, 0, 0);
+	DirectX::XMFLOAT2 untouched = pyramid.GetCell(0, 40, 30);
+	pyramid.Widen(20, 10, 5, 3, ranges);
+
+	DirectX::XMFLOAT2 widened = pyramid.GetCell(0, 22, 11);
+	CHECK(widened.x == -1.0f && widened.y == 2.0f);
+	CHECK(pyramid.GetCell(0, 20, 10).x <= 0.45f && pyramid.GetCell(0, 20, 10).y >= 0.55f);
+	CHECK(pyramid.GetCell(0, 0, 0).x == before.x && pyramid.GetCell(0, 0, 0).y == before.y);
+	CHECK(pyramid.GetCell(0, 40, 30).x == untouched.x && pyramid.GetCell(0, 40, 30).y == untouched.y);
+
+	all = pyramid.GetCell(top, 0, 0);
+	CHECK(all.x == -1.0f && all.y == 2.0f);
+	CHECK(pyramid.GetRange(22.2f, 11.2f, 22.8f, 11.8f, minH, maxH) && minH == -1.0f && maxH == 2.0f);
+	CHECK(pyramid.GetRange(0.0f, 0.0f, 3.0f, 3.0f, minH, maxH) && maxH < 2.0f);
+}
@@ -0,0 +1,143 @@
+//***************************************************************************************
+// HeightfieldRayCasterTests.cpp
+//
+// The pyramid walk and the batch API must find the same first hit as the dense walk
+// over every cell, including on one-texel spikes a fixed-step march would step over.
+// Hits must lie on the bilinear surface Terrain::GetHeight describes.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "HeightfieldReference.h"
+#include "../../Chapter 25 Terrain/Terrain/HeightfieldRayCaster.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+TEST_SUITE(HeightfieldRayCaster)
+{
+	HeightfieldReference terrain;
+	terrain.Width = 256;
+	terrain.Height = 192;
+	terrain.TerrainSize = 512.0f;
+	terrain.MinHeight = -20.0f;
+	terrain.MaxHeight = 180.0f;
+
+	// Rolling hills with a few single-texel spikes.
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	terrain.Heights.resize((size_t)terrain.Width * terrain.Height);
+	for(int z = 0; z < terrain.Height; ++z)
+		for(int x = 0; x < terrain.Width; ++x)
+			terrain.Heights[(size_t)z * terrain.Width + x] = 0.3f + 0.15f*sinf(x*0.05f)*cosf(z*0.07f) + 0.02f*unit(rng);
+	for(int i = 0; i < 40; ++i)
+		terrain.Heights[(size_t)(rng() % terrain.Height) * terrain.Width + rng() % terrain.Width] = 0.9f + 0.1f*unit(rng);
+
+	HeightPyramid pyramid;
+	pyramid.Build(terrain.Heights, terrain.Width, terrain.Height);
+
+	HeightfieldRayCaster caster;
+	HeightfieldHit hit;
+	CHECK(caster.IsEmpty() && !caster.Intersect(HeightfieldRay(), hit));
+	caster.Attach(terrain.Heights, terrain.Width, terrain.Height, pyramid,
+		terrain.TerrainSize, terrain.MinHeight, terrain.MaxHeight);
+	CHECK(!caster.IsEmpty());
+
+	// Straight down lands on the surface height; straight up, or away above it, misses.
+	{
+		bool onSurface = true;
+		for(int i = 0; i < 200; ++i)
+		{
+			float x = (unit(rng) - 0.5f) * 500.0f, z = (unit(rng) - 0.5f) * 500.0f;
+			HeightfieldRay ray;
+			ray.Origin = XMFLOAT3(x, 400.0f, z);
+			ray.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+			onSurface = onSurface && caster.Intersect(ray, hit) && fabsf(hit.Position.y - terrain.GetHeight(x, z)) < 1e-3f;
+		}
+		CHECK(onSurface);
+
+		HeightfieldRay up;
+		up.Origin = XMFLOAT3(10.0f, 300.0f, 10.0f);
+		up.Direction = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		CHECK(!caster.Intersect(up, hit) && !hit.Hit);
+
+		HeightfieldRay shortRay;
+		shortRay.Origin = XMFLOAT3(0.0f, 400.0f, 0.0f);
+		shortRay.Direction = XMFLOAT3(0.0f, -1.0f, 0.0f);
+		shortRay.MaxT = 100.0f;
+		CHECK(!caster.Intersect(shortRay, hit));
+	}
+
+	// Camera-like fans from a few viewpoints, plus rays in random directions.
+	std::vector<HeightfieldRay> rays;
+	const XMFLOAT3 eyes[] = { { -300.0f, 120.0f, -300.0f }, { 0.0f, 40.0f, 0.0f }, { 250.0f, 300.0f, -50.0f } };
+	for(const XMFLOAT3& eye : eyes)
+	{
+		float yaw = atan2f(-eye.x, -eye.z);
+		for(int y = 0; y < 90; ++y)
+		{
+			for(int x = 0; x < 160; ++x)
+			{
+				float a = yaw + (x / 159.0f - 0.5f) * 1.4f;
+				float pitch = -0.05f - (y / 89.0f) * 0.8f;
+				HeightfieldRay ray;
+				ray.Origin = eye;
+				ray.Direction = XMFLOAT3(cosf(pitch)*sinf(a), sinf(pitch), cosf(pitch)*cosf(a));
+				rays.push_back(ray);
+			}
+		}
+	}
+	for(int i = 0; i < 20000; ++i)
+	{
+		HeightfieldRay ray;
+		ray.Origin = XMFLOAT3((unit(rng) - 0.5f) * 700.0f, unit(rng) * 250.0f, (unit(rng) - 0.5f) * 700.0f);
+		ray.Direction = XMFLOAT3(unit(rng) - 0.5f, unit(rng) - 0.7f, unit(rng) - 0.5f);
+		rays.push_back(ray);
+	}
+
+	std::vector<HeightfieldHit> reference(rays.size()), single(rays.size()), batch(rays.size());
+	double referenceTime = ModuleTests::Seconds([&]()
+	{
+		for(size_t i = 0; i < rays.size(); ++i)
+			caster.IntersectReference(rays[i], reference[i]);
+	});
+	double singleTime = ModuleTests::Seconds([&]()
+	{
+		for(size_t i = 0; i < rays.size(); ++i)
+			caster.Intersect(rays[i], single[i]);
+	});
+	double batchTime = ModuleTests::Seconds([&]()
+	{
+		caster.IntersectBatch(rays.data(), batch.data(), rays.size());
+	});
+
+	uint32_t hits = 0, mismatches = 0, offSurface = 0;
+	for(size_t i = 0; i < rays.size(); ++i)
+	{
+		hits += reference[i].Hit ? 1 : 0;
+		for(const HeightfieldHit* h : { &single[i], &batch[i] })
+		{
+			if(h->Hit != reference[i].Hit || (h->Hit && fabsf(h->T - reference[i].T) > 1e-3f))
+				++mismatches;
+		}
+
+		// Rays that start over the terrain and above it hit the surface itself; others
+		// can enter the heightfield through its side.
+		const HeightfieldRay& ray = rays[i];
+		const HeightfieldHit& h = reference[i];
+		bool overTerrain = fabsf(ray.Origin.x) < 0.5f*terrain.TerrainSize && fabsf(ray.Origin.z) < 0.5f*terrain.TerrainSize &&
+			ray.Origin.y > terrain.GetHeight(ray.Origin.x, ray.Origin.z);
+		if(h.Hit && overTerrain && fabsf(h.Position.y - terrain.GetHeight(h.Position.x, h.Position.z)) > 0.01f)
+			++offSurface;
+	}
+
+	ModuleTests::Report("%zu rays, %u hits; rays/s: dense %.0f, pyramid %.0f, batch %.0f", rays.size(), hits,
+		rays.size() / referenceTime, rays.size() / singleTime, rays.size() / batchTime);
+	CHECK(hits > rays.size() / 4);
+	CHECK(mismatches == 0);
+	CHECK(offSurface == 0);
+
+	caster.Detach();
+	CHECK(caster.IsEmpty());
+}
@@ -0,0 +1,62 @@
+//***************************************************************************************
+// HeightfieldReference.h
+//
+// Terrain::GetHeight and Terrain::GetNormal written out on a plain array, for the
+// suites that check the batched and pyramid-walking heightfield code against them.
+// Terrain itself needs a Direct3D device.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+struct HeightfieldReference
+{
+	std::vector<float> Heights;	// Normalized [0,1], row-major
+	int Width = 0;
+	int Height = 0;
+	float TerrainSize = 1.0f;
+	float MinHeight = 0.0f;
+	float MaxHeight = 1.0f;
+
+	float Texel(int x, int z) const
+	{
+		x = (std::max)(0, (std::min)(x, Width - 1));
+		z = (std::max)(0, (std::min)(z, Height - 1));
+		return Heights[(size_t)z * Width + x];
+	}
+
+	float GetHeight(float x, float z) const
+	{
+		float u = (x / TerrainSize + 0.5f) * Width;
+		float v = (z / TerrainSize + 0.5f) * Height;
+
+		int x0 = (int)floorf(u);
+		int z0 = (int)floorf(v);
+		float fx = u - x0;
+		float fz = v - z0;
+
+		float h00 = Texel(x0, z0);
+		float h10 = Texel(x0 + 1, z0);
+		float h01 = Texel(x0, z0 + 1);
+		float h11 = Texel(x0 + 1, z0 + 1);
+
+		float h0 = h00 + (h10 - h00) * fx;
+		float h1 = h01 + (h11 - h01) * fx;
+		float h = h0 + (h1 - h0) * fz;
+
+		return MinHeight + h * (MaxHeight - MinHeight);
+	}
+
+	DirectX::XMFLOAT3 GetNormal(float x, float z) const
+	{
+		float delta = TerrainSize / Width;
+		DirectX::XMFLOAT3 normal(GetHeight(x - delta, z) - GetHeight(x + delta, z), 2.0f * delta,
+			GetHeight(x, z - delta) - GetHeight(x, z + delta));
+		DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&normal)));
+		return normal;
+	}
+};
@@ -0,0 +1,132 @@
+//***************************************************************************************
+// HeightfieldSamplerTests.cpp
+//
+// Batched height, normal and slope queries against Terrain::GetHeight and GetNormal:
+// heights must match bit for bit, on and off the terrain, for counts that do not
+// fill the last four lanes, on one thread and split across workers.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "HeightfieldReference.h"
+#include "../../Chapter 25 Terrain/Terrain/HeightfieldSampler.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+TEST_SUITE(HeightfieldSampler)
+{
+	HeightfieldReference terrain;
+	terrain.Width = 300;
+	terrain.Height = 220;
+	terrain.TerrainSize = 600.0f;
+	terrain.MinHeight = -15.0f;
+	terrain.MaxHeight = 140.0f;
+
+	std::mt19937 rng(9);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	terrain.Heights.resize((size_t)terrain.Width * terrain.Height);
+	for(int z = 0; z < terrain.Height; ++z)
+		for(int x = 0; x < terrain.Width; ++x)
+			terrain.Heights[(size_t)z * terrain.Width + x] = 0.5f + 0.3f*sinf(x*0.04f)*cosf(z*0.06f) + 0.05f*unit(rng);
+
+	HeightfieldSampler sampler;
+	CHECK(sampler.IsEmpty());
+
+	// Detached: flat ground at zero.
+	{
+		float x[5] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f }, z[5] = {};
+		float h[5], nx[5], ny[5], nz[5], s[5];
+		HeightfieldSamples out;
+		out.Heights = h;
+		out.NormalX = nx;
+		out.NormalY = ny;
+		out.NormalZ = nz;
+		out.Slopes = s;
+		sampler.Sample(x, z, 5, out);
+		bool flat = true;
+		for(int i = 0; i < 5; ++i)
+			flat = flat && h[i] == 0.0f && nx[i] == 0.0f && ny[i] == 1.0f && nz[i] == 0.0f && s[i] == 0.0f;
+		CHECK(flat);
+	}
+
+	sampler.Attach(terrain.Heights, terrain.Width, terrain.Height, terrain.TerrainSize, terrain.MinHeight, terrain.MaxHeight);
+	CHECK(!sampler.IsEmpty());
+
+	// Scattered positions, some off the terrain for the edge clamp; the count leaves
+	// three lanes over.
+	const size_t count = (1 << 18) + 3;
+	const float extent = terrain.TerrainSize * 0.55f;
+	std::vector<float> xs(count), zs(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		xs[i] = (unit(rng) * 2.0f - 1.0f) * extent;
+		zs[i] = (unit(rng) * 2.0f - 1.0f) * extent;
+	}
+
+	std::vector<float> heights(count), normalX(count), normalY(count), normalZ(count), slopes(count);
+	HeightfieldSamples samples;
+	samples.Heights = heights.data();
+	samples.NormalX = normalX.data();
+	samples.NormalY = normalY.data();
+	samples.NormalZ = normalZ.data();
+	samples.Slopes = slopes.data();
+
+	std::vector<float> referenceHeights(count), referenceSlopes(count);
+	std::vector<XMFLOAT3> referenceNormals(count);
+	double scalarTime = ModuleTests::Seconds([&]()
+	{
+		for(size_t i = 0; i < count; ++i)
+		{
+			referenceHeights[i] = terrain.GetHeight(xs[i], zs[i]);
+			referenceNormals[i] = terrain.GetNormal(xs[i], zs[i]);
+		}
+	});
+	const float delta = terrain.TerrainSize / terrain.Width;
+	for(size_t i = 0; i < count; ++i)
+	{
+		float dx = terrain.GetHeight(xs[i] + delta, zs[i]) - terrain.GetHeight(xs[i] - delta, zs[i]);
+		float dz = terrain.GetHeight(xs[i], zs[i] + delta) - terrain.GetHeight(xs[i], zs[i] - delta);
+		referenceSlopes[i] = sqrtf(dx*dx + dz*dz) / (2.0f * delta);
+	}
+
+	auto compare = [&](const char* label, double time)
+	{
+		size_t heightMismatches = 0;
+		float normalError = 0.0f, slopeError = 0.0f;
+		for(size_t i = 0; i < count; ++i)
+		{
+			heightMismatches += (heights[i] != referenceHeights[i]) ? 1 : 0;
+			normalError = (std::max)(normalError, fabsf(normalX[i] - referenceNormals[i].x));
+			normalError = (std::max)(normalError, fabsf(normalY[i] - referenceNormals[i].y));
+			normalError = (std::max)(normalError, fabsf(normalZ[i] - referenceNormals[i].z));
+			slopeError = (std::max)(slopeError, fabsf(slopes[i] - referenceSlopes[i]) / (1.0f + referenceSlopes[i]));
+		}
+		ModuleTests::Report("%s: %.1f M queries/s (scalar %.1f M), max normal error %g, max slope error %g",
+			label, count / time / 1e6, count / scalarTime / 1e6, normalError, slopeError);
+		CHECK(heightMismatches == 0);
+		CHECK(normalError < 1e-5f);
+		CHECK(slopeError < 1e-4f);
+	};
+
+	double singleTime = ModuleTests::Seconds([&]() { sampler.Sample(xs.data(), zs.data(), count, samples); });
+	compare("Sample", singleTime);
+
+	std::fill(heights.begin(), heights.end(), 0.0f);
+	double batchTime = ModuleTests::Seconds([&]() { sampler.SampleBatch(xs.data(), zs.data(), count, samples); });
+	compare("SampleBatch", batchTime);
+
+	// Heights only, leaving the other outputs alone.
+	HeightfieldSamples heightsOnly;
+	std::vector<float> onlyHeights(count);
+	heightsOnly.Heights = onlyHeights.data();
+	std::fill(normalX.begin(), normalX.end(), 7.0f);
+	sampler.SampleBatch(xs.data(), zs.data(), count, heightsOnly);
+	CHECK(onlyHeights == referenceHeights);
+	CHECK(std::all_of(normalX.begin(), normalX.end(), [](float v) { return v == 7.0f; }));
+
+	sampler.Detach();
+	CHECK(sampler.IsEmpty());
+}
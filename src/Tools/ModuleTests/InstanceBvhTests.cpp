@@ -0,0 +1,174 @@
+//***************************************************************************************
+// InstanceBvhTests.cpp
+//
+// Frustum culling through InstanceBvh against the per-instance test the instancing
+// demo ran before it, which moves the frustum into each instance's local space: the
+// tree may keep extra instances, since a rotated instance's world box is looser than
+// its local box, but must never drop one the local test keeps.  The same holds after
+// instances move and the tree is refitted instead of rebuilt.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 16 Instancing and Frustum Culling/InstancingAndCulling/InstanceBvh.h"
+#include "../../Common/ModelLoader.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// The loop UpdateInstanceData ran before the instance hierarchy.
+	void CullInstancesLocal(const BoundingFrustum& viewFrustum, FXMMATRIX invView, const BoundingBox& localBounds,
+		const std::vector<XMFLOAT4X4>& worlds, std::vector<bool>& visible)
+	{
+		for(size_t i = 0; i < worlds.size(); ++i)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+			XMVECTOR det = XMMatrixDeterminant(world);
+			XMMATRIX viewToLocal = XMMatrixMultiply(invView, XMMatrixInverse(&det, world));
+
+			BoundingFrustum localSpaceFrustum;
+			viewFrustum.Transform(localSpaceFrustum, viewToLocal);
+			visible[i] = localSpaceFrustum.Contains(localBounds) != DISJOINT;
+		}
+	}
+}
+
+TEST_SUITE(InstanceBvh)
+{
+	ModelData skull;
+	bool loaded = ModelLoader::LoadText(
+		ModuleTests::SourcePath("Chapter 16 Instancing and Frustum Culling/InstancingAndCulling/Models/skull.txt"), skull);
+	CHECK(loaded);
+	if(!loaded)
+		return;
+	const BoundingBox& skullBounds = skull.Bounds;
+
+	// An n x n x n grid of randomly rotated skulls, spacing apart, centered on the origin.
+	std::mt19937 rng(16);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const int n = 40;
+	const float spacing = 12.0f;
+	const UINT instanceCount = n*n*n;
+
+	std::vector<XMFLOAT4X4> worlds(instanceCount);
+	std::vector<BoundingBox> worldBounds(instanceCount);
+	for(int k = 0; k < n; ++k)
+	{
+		for(int i = 0; i < n; ++i)
+		{
+			for(int j = 0; j < n; ++j)
+			{
+				int index = k*n*n + i*n + j;
+				XMMATRIX rotation = XMMatrixRotationRollPitchYaw(unit(rng)*XM_2PI, unit(rng)*XM_2PI, unit(rng)*XM_2PI);
+				XMMATRIX translation = XMMatrixTranslation(spacing*(j - 0.5f*n), spacing*(i - 0.5f*n), spacing*(k - 0.5f*n));
+				XMMATRIX world = XMMatrixMultiply(rotation, translation);
+				XMStoreFloat4x4(&worlds[index], world);
+				skullBounds.Transform(worldBounds[index], world);
+			}
+		}
+	}
+
+	InstanceBvh tree;
+	CHECK(tree.InstanceCount() == 0);
+	double buildTime = ModuleTests::Seconds([&]() { tree.Build(worldBounds); });
+	CHECK(tree.InstanceCount() == instanceCount);
+
+	// The demo's lens, from cameras inside and around the grid looking in random directions.
+	BoundingFrustum camFrustum;
+	BoundingFrustum::CreateFromMatrix(camFrustum, XMMatrixPerspectiveFovLH(0.25f*XM_PI, 4.0f / 3.0f, 1.0f, 1000.0f));
+
+	const UINT viewCount = 16;
+	std::vector<XMFLOAT4X4> invViews(viewCount);
+	for(UINT v = 0; v < viewCount; ++v)
+	{
+		float extent = spacing*n;
+		XMVECTOR pos = XMVectorSet((2.0f*unit(rng) - 1.0f)*extent, (2.0f*unit(rng) - 1.0f)*extent,
+			(2.0f*unit(rng) - 1.0f)*extent, 1.0f);
+		XMVECTOR dir = XMVector3Normalize(XMVectorSet(2.0f*unit(rng) - 1.0f, 1.4f*unit(rng) - 0.7f, 2.0f*unit(rng) - 1.0f, 0.0f));
+
+		XMMATRIX view = XMMatrixLookToLH(pos, dir, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMVECTOR det = XMMatrixDeterminant(view);
+		XMStoreFloat4x4(&invViews[v], XMMatrixInverse(&det, view));
+	}
+
+	// Instances the local test keeps but the tree drops are errors.  The tree must
+	// also report each instance once.
+	auto compare = [&](const char* label)
+	{
+		UINT missed = 0, extra = 0, duplicates = 0, localVisible = 0, treeVisible = 0;
+		std::vector<bool> localSet(instanceCount);
+		std::vector<UINT> treeCount(instanceCount);
+		double localTime = 0.0, treeTime = 0.0;
+		for(UINT v = 0; v < viewCount; ++v)
+		{
+			XMMATRIX invView = XMLoadFloat4x4(&invViews[v]);
+			localTime += ModuleTests::Seconds([&]() { CullInstancesLocal(camFrustum, invView, skullBounds, worlds, localSet); });
+
+			BoundingFrustum worldSpaceFrustum;
+			camFrustum.Transform(worldSpaceFrustum, invView);
+			std::fill(treeCount.begin(), treeCount.end(), 0);
+			treeTime += ModuleTests::Seconds([&]() { tree.Cull(worldSpaceFrustum, [&](UINT i) { ++treeCount[i]; }); });
+
+			for(UINT i = 0; i < instanceCount; ++i)
+			{
+				localVisible += localSet[i] ? 1 : 0;
+				treeVisible += treeCount[i] ? 1 : 0;
+				missed += (localSet[i] && treeCount[i] == 0) ? 1 : 0;
+				extra += (!localSet[i] && treeCount[i] != 0) ? 1 : 0;
+				duplicates += treeCount[i] > 1 ? 1 : 0;
+			}
+		}
+
+		ModuleTests::Report("%s: per view %.2f ms per-instance, %.3f ms tree; %u vs %u visible, %u extra",
+			label, localTime * 1000.0 / viewCount, treeTime * 1000.0 / viewCount,
+			localVisible / viewCount, treeVisible / viewCount, extra / viewCount);
+		CHECK(localVisible > 0);
+		CHECK(missed == 0);
+		CHECK(duplicates == 0);
+		CHECK(extra < localVisible / 4);
+	};
+
+	ModuleTests::Report("%u instances, %u nodes, built in %.1f ms", instanceCount, tree.NodeCount(), buildTime * 1000.0);
+	compare("built");
+
+	// Move every tenth instance a little and refit, as a frame of moving objects would,
+	// then move a few far across the grid.
+	const UINT moveStride = 10;
+	double refitTime = ModuleTests::Seconds([&]()
+	{
+		for(UINT i = 0; i < instanceCount; i += moveStride)
+		{
+			float reach = (i % (moveStride*50) == 0) ? spacing*n : 3.0f;
+			XMMATRIX world = XMMatrixMultiply(XMLoadFloat4x4(&worlds[i]), XMMatrixTranslation(
+				(2.0f*unit(rng) - 1.0f)*reach, (2.0f*unit(rng) - 1.0f)*reach, (2.0f*unit(rng) - 1.0f)*reach));
+			XMStoreFloat4x4(&worlds[i], world);
+			skullBounds.Transform(worldBounds[i], world);
+			tree.SetBounds(i, worldBounds[i]);
+		}
+		tree.Refit();
+	});
+	ModuleTests::Report("moved %u instances, refit in %.2f ms", (instanceCount + moveStride - 1) / moveStride, refitTime * 1000.0);
+	compare("refitted");
+
+	tree.Build(worldBounds);
+	compare("rebuilt");
+
+	// Nothing in front of a camera looking away from the grid.
+	XMMATRIX away = XMMatrixLookToLH(XMVectorSet(0.0f, 0.0f, -3.0f*spacing*n, 1.0f),
+		XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMVECTOR det = XMMatrixDeterminant(away);
+	BoundingFrustum awayFrustum;
+	camFrustum.Transform(awayFrustum, XMMatrixInverse(&det, away));
+	UINT awayVisible = 0;
+	tree.Cull(awayFrustum, [&](UINT) { ++awayVisible; });
+	CHECK(awayVisible == 0);
+
+	InstanceBvh empty;
+	empty.Build(std::vector<BoundingBox>());
+	UINT emptyVisible = 0;
+	empty.Cull(awayFrustum, [&](UINT) { ++emptyVisible; });
+	CHECK(empty.InstanceCount() == 0 && emptyVisible == 0);
+}
@@ -0,0 +1,151 @@
+//***************************************************************************************
+// ModelLoaderTests.cpp
+//
+// Both chapter models as the iostream reader every sample used before ModelLoader
+// reads them, bit for bit, and the sidecar against the text it was made from.  The
+// models are copied to a temporary folder so the sidecars are written there: Load
+// parses the text and writes the sidecar the first time, reads the sidecar after
+// that, and goes back to the text when the text changes or the sidecar is damaged.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/ModelLoader.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// The reader the samples had, as the reference.
+	bool LoadModelIostream(const std::string& filename, ModelData& model)
+	{
+		std::ifstream fin(filename);
+		if(!fin)
+			return false;
+
+		uint32_t vcount = 0;
+		uint32_t tcount = 0;
+		std::string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		model.Positions.resize(vcount);
+		model.Normals.resize(vcount);
+		for(uint32_t i = 0; i < vcount; ++i)
+		{
+			fin >> model.Positions[i].x >> model.Positions[i].y >> model.Positions[i].z;
+			fin >> model.Normals[i].x >> model.Normals[i].y >> model.Normals[i].z;
+		}
+
+		fin >> ignore >> ignore >> ignore;
+
+		model.Indices.resize(3 * tcount);
+		for(uint32_t i = 0; i < 3 * tcount; ++i)
+			fin >> model.Indices[i];
+
+		return !fin.fail();
+	}
+
+	// Bit for bit, so -0 and 0 count as different.
+	bool SameBits(const ModelData& a, const ModelData& b)
+	{
+		return a.Positions.size() == b.Positions.size() && a.Normals.size() == b.Normals.size() &&
+			std::memcmp(a.Positions.data(), b.Positions.data(), a.Positions.size()*sizeof(XMFLOAT3)) == 0 &&
+			std::memcmp(a.Normals.data(), b.Normals.data(), a.Normals.size()*sizeof(XMFLOAT3)) == 0 &&
+			a.Indices == b.Indices;
+	}
+
+	bool SameBounds(const BoundingBox& a, const BoundingBox& b)
+	{
+		return std::memcmp(&a.Center, &b.Center, sizeof(XMFLOAT3)) == 0 &&
+			std::memcmp(&a.Extents, &b.Extents, sizeof(XMFLOAT3)) == 0;
+	}
+}
+
+TEST_SUITE(ModelLoader)
+{
+	namespace fs = std::filesystem;
+
+	const fs::path folder = fs::temp_directory_path() / "ModelLoaderTests";
+	fs::remove_all(folder);
+	fs::create_directories(folder);
+
+	ModelData missing;
+	CHECK(!ModelLoader::LoadText((folder / "missing.txt").string(), missing));
+	CHECK(ModelLoader::SidecarName("Models/skull.txt") == "Models/skull.txt.bin");
+
+	for(const char* model : { "skull.txt", "car.txt" })
+	{
+		const std::string source = ModuleTests::SourcePath(std::string("Chapter 17 Picking/Picking/Models/") + model);
+		const std::string filename = (folder / model).string();
+		fs::copy_file(source, filename);
+
+		ModelData reference, text;
+		double iostreamTime = ModuleTests::Seconds([&]() { CHECK(LoadModelIostream(filename, reference)); });
+		double textTime = ModuleTests::Seconds([&]() { CHECK(ModelLoader::LoadText(filename, text)); });
+		CHECK(!text.Positions.empty() && text.Indices.size() % 3 == 0);
+		CHECK(SameBits(text, reference));
+
+		// The bounds hold every position and touch the extremes on each axis.
+		XMFLOAT3 lo = text.Positions[0], hi = text.Positions[0];
+		for(const XMFLOAT3& p : text.Positions)
+		{
+			lo = XMFLOAT3((std::min)(lo.x, p.x), (std::min)(lo.y, p.y), (std::min)(lo.z, p.z));
+			hi = XMFLOAT3((std::max)(hi.x, p.x), (std::max)(hi.y, p.y), (std::max)(hi.z, p.z));
+		}
+		const float* center = &text.Bounds.Center.x;
+		const float* extents = &text.Bounds.Extents.x;
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			CHECK_NEAR(center[axis] - extents[axis], (&lo.x)[axis], 1e-4f);
+			CHECK_NEAR(center[axis] + extents[axis], (&hi.x)[axis], 1e-4f);
+		}
+
+		// Cut short, or with a vertex count past what the text holds, the text fails.
+		std::vector<char> bytes(fs::file_size(filename));
+		std::ifstream(filename, std::ios::binary).read(bytes.data(), bytes.size());
+		ModelData damaged;
+		CHECK(ModelLoader::ParseText(bytes.data(), bytes.size(), damaged));
+		CHECK(!ModelLoader::ParseText(bytes.data(), bytes.size() / 2, damaged));
+		std::string hugeHeader = "VertexCount: 4000000000\nTriangleCount: 1\n";
+		CHECK(!ModelLoader::ParseText(hugeHeader.data(), hugeHeader.size(), damaged));
+
+		// Text and sidecar written, then the sidecar alone.
+		ModelData written, mapped;
+		ModelLoader::Source firstSource = ModelLoader::Source::Sidecar, secondSource = ModelLoader::Source::Text;
+		double firstTime = ModuleTests::Seconds([&]() { CHECK(ModelLoader::Load(filename, written, &firstSource)); });
+		double sidecarTime = ModuleTests::Seconds([&]() { CHECK(ModelLoader::Load(filename, mapped, &secondSource)); });
+		CHECK(firstSource == ModelLoader::Source::Text && secondSource == ModelLoader::Source::Sidecar);
+		CHECK(ModuleTests::FileExists(ModelLoader::SidecarName(filename)));
+		CHECK(SameBits(written, text) && SameBits(mapped, text));
+		CHECK(SameBounds(mapped.Bounds, text.Bounds));
+
+		ModuleTests::Report("%s: %zu vertices, %zu triangles; iostream %.2f ms, text %.2f ms, first load %.2f ms, sidecar %.2f ms",
+			model, text.Positions.size(), text.Indices.size() / 3, iostreamTime * 1000.0, textTime * 1000.0,
+			firstTime * 1000.0, sidecarTime * 1000.0);
+
+		// A changed text makes the sidecar stale; the next load parses and rewrites it.
+		std::ofstream(filename, std::ios::binary | std::ios::app) << "\n";
+		ModelData reloaded;
+		ModelLoader::Source reloadSource = ModelLoader::Source::Sidecar;
+		CHECK(!ModelLoader::LoadSidecar(filename, reloaded));
+		CHECK(ModelLoader::Load(filename, reloaded, &reloadSource) && reloadSource == ModelLoader::Source::Text);
+		CHECK(ModelLoader::Load(filename, reloaded, &reloadSource) && reloadSource == ModelLoader::Source::Sidecar);
+		CHECK(SameBits(reloaded, text));
+
+		// A cut short sidecar is ignored.
+		fs::resize_file(ModelLoader::SidecarName(filename), fs::file_size(ModelLoader::SidecarName(filename)) - 4);
+		CHECK(!ModelLoader::LoadSidecar(filename, reloaded));
+		CHECK(ModelLoader::Load(filename, reloaded, &reloadSource) && reloadSource == ModelLoader::Source::Text);
+		CHECK(SameBits(reloaded, text));
+	}
+
+	fs::remove_all(folder);
+}
@@ -0,0 +1,144 @@
+//***************************************************************************************
+// ModuleTests.cpp
+//
+// Checks for the CPU modules the samples share (Common/) and the CPU halves of the
+// chapter samples (BVHs, the terrain quadtree, cube map culling, ...).  Needs no GPU
+// and builds outside Windows; see CMakeLists.txt.
+//
+// Usage:
+//   ModuleTests [suite]...    runs the named suites, or all of them
+//   ModuleTests --list        prints the suite names
+//
+// The exit code is 0 when every check passed, 1 when one failed and 2 for an unknown
+// suite.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifndef MODULE_TESTS_SOURCE_ROOT
+#define MODULE_TESTS_SOURCE_ROOT "../.."
+#endif
+
+namespace
+{
+	const int ExitPass = 0;
+	const int ExitFail = 1;
+	const int ExitError = 2;
+
+	struct Suite
+	{
+		const char* Name;
+		ModuleTests::SuiteFunc Run;
+	};
+
+	// Filled while static objects are constructed, so it must not be a global object itself.
+	std::vector<Suite>& Suites()
+	{
+		static std::vector<Suite> suites;
+		return suites;
+	}
+
+	uint32_t gChecks = 0;
+	uint32_t gFailures = 0;
+}
+
+bool ModuleTests::RegisterSuite(const char* name, SuiteFunc run)
+{
+	Suites().push_back({ name, run });
+	return true;
+}
+
+bool ModuleTests::Check(bool condition, const char* file, int line, const char* expression)
+{
+	++gChecks;
+	if(!condition)
+	{
+		++gFailures;
+
+		const char* name = std::max(strrchr(file, '/'), strrchr(file, '\\'));
+		printf("  FAILED %s:%d: %s\n", name != nullptr ? name + 1 : file, line, expression);
+	}
+	return condition;
+}
+
+void ModuleTests::Report(const char* format, ...)
+{
+	printf("  ");
+
+	va_list args;
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+
+	printf("\n");
+}
+
+double ModuleTests::Seconds(const std::function<void()>& work)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	work();
+	return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+std::string ModuleTests::SourcePath(const std::string& relative)
+{
+	return std::string(MODULE_TESTS_SOURCE_ROOT) + "/" + relative;
+}
+
+bool ModuleTests::FileExists(const std::string& path)
+{
+	return (bool)std::ifstream(path, std::ios::binary);
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<Suite> suites = Suites();
+	std::sort(suites.begin(), suites.end(),
+		[](const Suite& a, const Suite& b) { return strcmp(a.Name, b.Name) < 0; });
+
+	std::vector<Suite> selected;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "--list") == 0)
+		{
+			for(const Suite& suite : suites)
+				printf("%s\n", suite.Name);
+			return ExitPass;
+		}
+
+		auto it = std::find_if(suites.begin(), suites.end(),
+			[&](const Suite& suite) { return strcmp(suite.Name, argv[i]) == 0; });
+		if(it == suites.end())
+		{
+			fprintf(stderr, "Unknown suite %s\n", argv[i]);
+			return ExitError;
+		}
+		selected.push_back(*it);
+	}
+
+	if(selected.empty())
+		selected = suites;
+
+	uint32_t failedSuites = 0;
+	for(const Suite& suite : selected)
+	{
+		printf("%s\n", suite.Name);
+
+		const uint32_t failuresBefore = gFailures;
+		suite.Run();
+
+		if(gFailures != failuresBefore)
+			++failedSuites;
+	}
+
+	printf("%u checks, %u failed in %u of %u suites\n", gChecks, gFailures, failedSuites, (uint32_t)selected.size());
+	printf(gFailures == 0 ? "PASSED\n" : "FAILED\n");
+	return gFailures == 0 ? ExitPass : ExitFail;
+}
@@ -0,0 +1,54 @@
+//***************************************************************************************
+// ModuleTests.h
+//
+// The pieces the module test suites share.  A suite is a function registered with
+// TEST_SUITE; CHECK and CHECK_NEAR count failures and print where they happened, and
+// a suite goes on after a failed check so one run shows every mismatch.
+//
+//   TEST_SUITE(Fft)
+//   {
+//       CHECK(Fft::IsPowerOfTwo(64));
+//   }
+//
+// Report prints a line under the running suite; suites use it for sizes and timings,
+// which are information only and never fail a run.
+//***************************************************************************************
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace ModuleTests
+{
+	using SuiteFunc = void(*)();
+
+	// Called by TEST_SUITE before main runs.
+	bool RegisterSuite(const char* name, SuiteFunc run);
+
+	// Counts a failure of the running suite and prints it when condition is false.
+	bool Check(bool condition, const char* file, int line, const char* expression);
+
+	void Report(const char* format, ...);
+
+	// Wall clock time of one call of work.
+	double Seconds(const std::function<void()>& work);
+
+	// Path of a file under src/, e.g. "Chapter 17 Picking/Picking/Models/skull.txt".
+	std::string SourcePath(const std::string& relative);
+
+	bool FileExists(const std::string& path);
+}
+
+#define TEST_SUITE(name) \
+	static void name##Suite(); \
+	static const bool name##SuiteRegistered = ModuleTests::RegisterSuite(#name, name##Suite); \
+	static void name##Suite()
+
+#define CHECK(condition) \
+	ModuleTests::Check((condition), __FILE__, __LINE__, #condition)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	ModuleTests::Check(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance), __FILE__, __LINE__, #a " ~ " #b)
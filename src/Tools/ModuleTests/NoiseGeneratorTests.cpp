@@ -0,0 +1,99 @@
+//***************************************************************************************
+// NoiseGeneratorTests.cpp
+//
+// The four-wide, multithreaded Generate must give the same bits as the scalar Sample,
+// for any region and thread split, so tiles generated on their own meet without
+// seams.  A seed must give the same heights on every run.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 25 Terrain/Terrain/NoiseGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+TEST_SUITE(NoiseGenerator)
+{
+	NoiseGenerator noise(1337);
+
+	// Perlin noise is zero on the lattice and stays near [-1, 1] between.
+	bool latticeZero = true;
+	for(int z = -3; z <= 3; ++z)
+		for(int x = -3; x <= 3; ++x)
+			latticeZero = latticeZero && noise.Perlin((float)x, (float)z) == 0.0f;
+	CHECK(latticeZero);
+
+	const NoiseType types[] = { NoiseType::Fbm, NoiseType::Ridged, NoiseType::Warped };
+	const char* names[] = { "fBm", "ridged", "warped" };
+	for(int t = 0; t < 3; ++t)
+	{
+		NoiseDesc desc;
+		desc.Type = types[t];
+
+		// A width that is not a multiple of four, starting off the origin.
+		const UINT width = 203, height = 61;
+		const int firstX = -17, firstZ = 40;
+		const float texelSize = 1.0f / 256;
+		std::vector<float> region((size_t)width * height);
+		noise.Generate(desc, firstX, firstZ, width, height, texelSize, region.data());
+
+		float maxError = 0.0f, lo = region[0], hi = region[0];
+		for(UINT j = 0; j < height; ++j)
+		{
+			for(UINT i = 0; i < width; ++i)
+			{
+				float value = region[(size_t)j * width + i];
+				float reference = noise.Sample(desc, (firstX + (int)i) * texelSize, (firstZ + (int)j) * texelSize);
+				maxError = (std::max)(maxError, fabsf(value - reference));
+				lo = (std::min)(lo, value);
+				hi = (std::max)(hi, value);
+			}
+		}
+		ModuleTests::Report("%s: range [%.3f, %.3f], max difference from Sample %g", names[t], lo, hi, maxError);
+		CHECK(maxError == 0.0f);
+		CHECK(lo >= -1.5f && hi <= 1.5f && hi - lo > 0.2f);
+
+		// The same texels as two tiles side by side and one below.
+		std::vector<float> left((size_t)100 * 30), right((size_t)103 * 30), below((size_t)width * 31);
+		noise.Generate(desc, firstX, firstZ, 100, 30, texelSize, left.data());
+		noise.Generate(desc, firstX + 100, firstZ, 103, 30, texelSize, right.data());
+		noise.Generate(desc, firstX, firstZ + 30, width, 31, texelSize, below.data());
+
+		bool seamless = true;
+		for(UINT j = 0; j < 30; ++j)
+		{
+			seamless = seamless && memcmp(&left[(size_t)j * 100], &region[(size_t)j * width], 100 * sizeof(float)) == 0;
+			seamless = seamless && memcmp(&right[(size_t)j * 103], &region[(size_t)j * width + 100], 103 * sizeof(float)) == 0;
+		}
+		seamless = seamless && memcmp(below.data(), &region[(size_t)30 * width], below.size() * sizeof(float)) == 0;
+		CHECK(seamless);
+	}
+
+	// Seeds: the same one repeats, another one differs.
+	NoiseDesc desc;
+	std::vector<float> first((size_t)256 * 256), second(first.size()), other(first.size());
+	noise.Generate(desc, 0, 0, 256, 256, 1.0f / 256, first.data());
+	NoiseGenerator again(1337), reseeded(7);
+	again.Generate(desc, 0, 0, 256, 256, 1.0f / 256, second.data());
+	reseeded.Generate(desc, 0, 0, 256, 256, 1.0f / 256, other.data());
+	CHECK(memcmp(first.data(), second.data(), first.size() * sizeof(float)) == 0);
+	CHECK(memcmp(first.data(), other.data(), first.size() * sizeof(float)) != 0);
+	reseeded.SetSeed(1337);
+	reseeded.Generate(desc, 0, 0, 256, 256, 1.0f / 256, other.data());
+	CHECK(reseeded.GetSeed() == 1337 && memcmp(first.data(), other.data(), first.size() * sizeof(float)) == 0);
+
+	// Throughput, in strips through one buffer like a streaming bake.
+	const UINT stripRows = 256;
+	std::vector<float> strip((size_t)2048 * stripRows);
+	for(UINT size = 1024; size <= 2048; size *= 2)
+	{
+		double time = ModuleTests::Seconds([&]()
+		{
+			for(UINT row = 0; row < size; row += stripRows)
+				noise.Generate(desc, 0, (int)row, size, stripRows, 1.0f / 1024, strip.data());
+		});
+		ModuleTests::Report("%ux%u, %d octaves: %.0f ms, %.1f Msamples/s", size, size, desc.Octaves,
+			time * 1000.0, (double)size * size / time / 1e6);
+	}
+}
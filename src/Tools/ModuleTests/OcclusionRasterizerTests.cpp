@@ -0,0 +1,204 @@
+//***************************************************************************************
+// OcclusionRasterizerTests.cpp
+//
+// The binned, multithreaded Rasterize must write the same depth as RasterizeSerial,
+// bit for bit.  Queries must stay conservative: the pyramid may keep a box the full
+// resolution test hides but never the other way round, the batched TestBoxes must
+// agree with IsVisible, and a bounding sphere is never hidden while its box is not.
+// The scene is the instancing demo's grid of skulls seen from just outside one face.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/OcclusionRasterizer.h"
+#include "../../Common/ModelLoader.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+TEST_SUITE(OcclusionRasterizer)
+{
+	ModelData skull;
+	bool loaded = ModelLoader::LoadText(
+		ModuleTests::SourcePath("Chapter 16 Instancing and Frustum Culling/InstancingAndCulling/Models/skull.txt"), skull);
+	CHECK(loaded);
+	if(!loaded)
+		return;
+	std::vector<uint32_t> indices(skull.Indices.begin(), skull.Indices.end());
+	const uint32_t vertexCount = (uint32_t)skull.Positions.size();
+	const uint32_t indexCount = (uint32_t)indices.size();
+
+	// A 48x48x48 grid of randomly rotated skulls.
+	std::mt19937 rng(37);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const int n = 48;
+	const float spacing = 12.0f;
+	std::vector<XMFLOAT4X4> worlds(n*n*n);
+	std::vector<BoundingBox> worldBounds(n*n*n);
+	for(int k = 0; k < n; ++k)
+	{
+		for(int i = 0; i < n; ++i)
+		{
+			for(int j = 0; j < n; ++j)
+			{
+				int index = k*n*n + i*n + j;
+				XMMATRIX rotation = XMMatrixRotationRollPitchYaw(unit(rng)*XM_2PI, unit(rng)*XM_2PI, unit(rng)*XM_2PI);
+				XMMATRIX translation = XMMatrixTranslation(spacing*(j - 0.5f*n), spacing*(i - 0.5f*n), spacing*(k - 0.5f*n));
+				XMMATRIX world = XMMatrixMultiply(rotation, translation);
+				XMStoreFloat4x4(&worlds[index], world);
+				skull.Bounds.Transform(worldBounds[index], world);
+			}
+		}
+	}
+
+	// The demo's lens, just outside the -z face looking in.
+	const float aspect = 4.0f / 3.0f;
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, aspect, 1.0f, 1000.0f);
+	XMVECTOR eye = XMVectorSet(0.3f*spacing, 0.2f*spacing, -spacing*(0.5f*n + 2.0f), 1.0f);
+	XMMATRIX view = XMMatrixLookToLH(eye, XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
+
+	BoundingFrustum frustum;
+	BoundingFrustum::CreateFromMatrix(frustum, proj);
+	XMVECTOR det = XMMatrixDeterminant(view);
+	frustum.Transform(frustum, XMMatrixInverse(&det, view));
+
+	std::vector<uint32_t> candidates;
+	std::vector<BoundingBox> candidateBounds;
+	for(uint32_t i = 0; i < (uint32_t)worldBounds.size(); ++i)
+	{
+		if(frustum.Contains(worldBounds[i]) != DISJOINT)
+		{
+			candidates.push_back(i);
+			candidateBounds.push_back(worldBounds[i]);
+		}
+	}
+	CHECK(!candidates.empty());
+
+	// The nearest instances are the occluders.
+	std::vector<uint32_t> nearest(candidates);
+	auto distanceSq = [&](uint32_t i)
+	{
+		return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&worldBounds[i].Center), eye)));
+	};
+	std::sort(nearest.begin(), nearest.end(), [&](uint32_t a, uint32_t b) { return distanceSq(a) < distanceSq(b); });
+
+	ModuleTests::Report("%zu of %zu instances in the frustum, %u triangles per occluder",
+		candidates.size(), worlds.size(), indexCount / 3);
+
+	const uint32_t runs = 5;
+	const uint32_t occluderCounts[] = { 4, 16 };
+	const uint32_t widths[] = { 256, 512 };
+	for(uint32_t width : widths)
+	{
+		OcclusionRasterizer rasterizer;
+		rasterizer.Resize(width, (uint32_t)(width / aspect));
+		CHECK(rasterizer.Width() == width && rasterizer.DepthPitch() >= width);
+
+		// Cleared depth hides nothing in the frustum.
+		rasterizer.Clear();
+		rasterizer.Rasterize();
+		std::vector<uint8_t> visible(candidateBounds.size());
+		rasterizer.TestBoxes(candidateBounds.data(), candidateBounds.size(), viewProj, visible.data());
+		CHECK(std::all_of(visible.begin(), visible.end(), [](uint8_t v) { return v == 1; }));
+
+		for(uint32_t occluderCount : occluderCounts)
+		{
+			rasterizer.Clear();
+			for(uint32_t k = 0; k < occluderCount && k < (uint32_t)nearest.size(); ++k)
+			{
+				XMMATRIX world = XMLoadFloat4x4(&worlds[nearest[k]]);
+				rasterizer.AddOccluder(skull.Positions.data(), sizeof(XMFLOAT3), vertexCount,
+					indices.data(), indexCount, XMMatrixMultiply(world, viewProj));
+			}
+			double submitted = (double)occluderCount * (indexCount / 3);
+
+			double serialTime = ModuleTests::Seconds([&]() { rasterizer.RasterizeSerial(); });
+			std::vector<float> serialDepth(rasterizer.GetDepth(),
+				rasterizer.GetDepth() + rasterizer.DepthPitch() * rasterizer.Height());
+
+			double rasterTime = ModuleTests::Seconds([&]()
+			{
+				for(uint32_t r = 0; r < runs; ++r)
+					rasterizer.Rasterize();
+			}) / runs;
+
+			uint32_t depthMismatches = 0, covered = 0;
+			for(size_t p = 0; p < serialDepth.size(); ++p)
+			{
+				depthMismatches += (serialDepth[p] != rasterizer.GetDepth()[p]) ? 1 : 0;
+				covered += serialDepth[p] < 1.0f ? 1 : 0;
+			}
+
+			uint32_t hidden = 0;
+			double queryTime = ModuleTests::Seconds([&]()
+			{
+				for(const BoundingBox& box : candidateBounds)
+					hidden += rasterizer.IsVisible(box, viewProj) ? 0 : 1;
+			});
+			double batchTime = ModuleTests::Seconds([&]()
+			{
+				rasterizer.TestBoxes(candidateBounds.data(), candidateBounds.size(), viewProj, visible.data());
+			});
+
+			uint32_t hiddenFull = 0, pyramidErrors = 0, batchErrors = 0, sphereErrors = 0;
+			for(size_t i = 0; i < candidateBounds.size(); ++i)
+			{
+				bool pyramid = rasterizer.IsVisible(candidateBounds[i], viewProj);
+				bool full = rasterizer.IsVisible(candidateBounds[i], viewProj, true);
+
+				BoundingSphere sphere;
+				BoundingSphere::CreateFromBoundingBox(sphere, candidateBounds[i]);
+
+				hiddenFull += full ? 0 : 1;
+				pyramidErrors += (!pyramid && full) ? 1 : 0;
+				batchErrors += (pyramid != (visible[i] != 0)) ? 1 : 0;
+				sphereErrors += (!rasterizer.IsVisible(sphere, viewProj) && full) ? 1 : 0;
+			}
+
+			// The occluders themselves are in front of everything, so they stay visible.
+			uint32_t hiddenOccluders = 0;
+			for(uint32_t k = 0; k < occluderCount; ++k)
+				hiddenOccluders += rasterizer.IsVisible(worldBounds[nearest[k]], viewProj, true) ? 0 : 1;
+
+			size_t queries = candidateBounds.size();
+			ModuleTests::Report("%ux%u, %u occluders: %u of %.0f triangles binned, rasterize %.2f ms (serial %.2f ms); "
+				"queries %.0f/ms, batched %.0f/ms; %u of %zu hidden (%u at full resolution)",
+				width, rasterizer.Height(), occluderCount, rasterizer.TriangleCount(), submitted,
+				rasterTime * 1000.0, serialTime * 1000.0, queries / (queryTime * 1000.0), queries / (batchTime * 1000.0),
+				hidden, queries, hiddenFull);
+			CHECK(rasterizer.TriangleCount() > 0 && rasterizer.TriangleCount() < submitted);
+			CHECK(covered > 0);
+			CHECK(depthMismatches == 0);
+			CHECK(hidden > 0 && hidden <= hiddenFull);
+			CHECK(pyramidErrors == 0);
+			CHECK(batchErrors == 0);
+			CHECK(sphereErrors == 0);
+			CHECK(hiddenOccluders == 0);
+		}
+	}
+
+	// A wall across the whole view, just past the near plane, hides the grid.
+	{
+		OcclusionRasterizer rasterizer;
+		rasterizer.Resize(128, 96);
+		const XMFLOAT3 wall[4] = { { -1.0f, -1.0f, 0.5f }, { -1.0f, 1.0f, 0.5f }, { 1.0f, 1.0f, 0.5f }, { 1.0f, -1.0f, 0.5f } };
+		const uint32_t wallIndices[6] = { 0, 1, 2, 0, 2, 3 };
+		rasterizer.AddOccluder(wall, sizeof(XMFLOAT3), 4, wallIndices, 6, XMMatrixIdentity());
+		rasterizer.Rasterize();
+
+		std::vector<uint8_t> visible(candidateBounds.size());
+		rasterizer.TestBoxes(candidateBounds.data(), candidateBounds.size(), viewProj, visible.data());
+		CHECK(std::none_of(visible.begin(), visible.end(), [](uint8_t v) { return v != 0; }));
+
+		// Wound the other way it is a back face and hides nothing.
+		const uint32_t backIndices[6] = { 0, 2, 1, 0, 3, 2 };
+		rasterizer.Clear();
+		rasterizer.AddOccluder(wall, sizeof(XMFLOAT3), 4, backIndices, 6, XMMatrixIdentity());
+		rasterizer.Rasterize();
+		CHECK(rasterizer.TriangleCount() == 0);
+		rasterizer.TestBoxes(candidateBounds.data(), candidateBounds.size(), viewProj, visible.data());
+		CHECK(std::all_of(visible.begin(), visible.end(), [](uint8_t v) { return v == 1; }));
+	}
+}
@@ -0,0 +1,118 @@
+//***************************************************************************************
+// OceanTests.cpp
+//
+// The FFT ocean gives the same surface for the same Desc and time, bit for bit on
+// one thread and on four.  The spectrum has no constant term and no waves across the
+// wind, so the mean height is zero, and a patch repeats with its own size.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/Ocean.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+TEST_SUITE(Ocean)
+{
+	// The spectrum.
+	Ocean::Desc desc;
+	CHECK(Ocean::Phillips(0.0f, 0.0f, desc) == 0.0f);
+	CHECK(Ocean::Phillips(-desc.Wind.y, desc.Wind.x, desc) == 0.0f);
+	CHECK(Ocean::Phillips(0.3f*desc.Wind.x, 0.3f*desc.Wind.y, desc) > 0.0f);
+
+	// The demo's surface on the shared pool, one thread and four threads.
+	ThreadPool serialPool(1), fourPool(4);
+	Ocean pooled(desc);
+	Ocean serial(desc, &serialPool);
+	Ocean four(desc, &fourPool);
+	const float time = 10.0f;
+	pooled.Update(time);
+	serial.Update(time);
+	four.Update(time);
+
+	const uint32_t n = desc.GridSize;
+	const uint32_t count = n*n;
+	uint32_t mismatches = 0;
+	for(uint32_t c = 0; c < desc.CascadeCount; ++c)
+	{
+		for(const Ocean* other : { &serial, &four })
+		{
+			if(!std::equal(pooled.Heights(c), pooled.Heights(c) + count, other->Heights(c)) ||
+			   !std::equal(pooled.DisplacementsX(c), pooled.DisplacementsX(c) + count, other->DisplacementsX(c)) ||
+			   !std::equal(pooled.DisplacementsZ(c), pooled.DisplacementsZ(c) + count, other->DisplacementsZ(c)) ||
+			   !std::equal(pooled.SlopesX(c), pooled.SlopesX(c) + count, other->SlopesX(c)) ||
+			   !std::equal(pooled.SlopesZ(c), pooled.SlopesZ(c) + count, other->SlopesZ(c)))
+				++mismatches;
+		}
+	}
+	CHECK(mismatches == 0);
+
+	// Every cascade has waves and a mean height of zero.
+	for(uint32_t c = 0; c < desc.CascadeCount; ++c)
+	{
+		double sum = 0.0, sumSq = 0.0;
+		for(uint32_t i = 0; i < count; ++i)
+		{
+			sum += pooled.Heights(c)[i];
+			sumSq += (double)pooled.Heights(c)[i]*pooled.Heights(c)[i];
+		}
+		double rms = sqrt(sumSq / count);
+		ModuleTests::Report("cascade %u (%.1f m): rms height %.3g m", c, desc.PatchSizes[c], rms);
+		CHECK(rms > 0.0);
+		CHECK(fabs(sum / count) < 1e-3*rms);
+	}
+
+	// Updating again to the same time gives the same surface.
+	pooled.Update(0.5f*time);
+	pooled.Update(time);
+	CHECK(std::equal(pooled.Heights(0), pooled.Heights(0) + count, serial.Heights(0)));
+
+	// One cascade repeats with its patch size and samples the grid exactly at grid
+	// points; the normals are unit length.
+	{
+		Ocean::Desc single = desc;
+		single.CascadeCount = 1;
+		single.PatchSizes[0] = 64.0f;
+		Ocean ocean(single);
+		ocean.Update(time);
+
+		const float cell = single.PatchSizes[0] / n;
+		float maxRepeatError = 0.0f, maxGridError = 0.0f, maxNormalError = 0.0f;
+		for(uint32_t k = 0; k < 64; ++k)
+		{
+			uint32_t i = (k*37) % n, j = (k*101) % n;
+			XMFLOAT3 d, normal, dRepeat, normalRepeat;
+			ocean.Sample(j*cell, i*cell, d, normal);
+			ocean.Sample(j*cell + single.PatchSizes[0], i*cell - 2.0f*single.PatchSizes[0], dRepeat, normalRepeat);
+
+			maxGridError = (std::max)(maxGridError, fabsf(d.y - ocean.Heights(0)[i*n + j]));
+			maxRepeatError = (std::max)(maxRepeatError, fabsf(d.y - dRepeat.y));
+			float length = sqrtf(normal.x*normal.x + normal.y*normal.y + normal.z*normal.z);
+			maxNormalError = (std::max)(maxNormalError, fabsf(length - 1.0f));
+		}
+		CHECK(maxGridError < 1e-5f);
+		CHECK(maxRepeatError < 1e-3f);
+		CHECK(maxNormalError < 1e-5f);
+	}
+
+	// One cascade per update: the spectrum and three inverse FFTs.
+	for(uint32_t gridSize : { 256u, 512u, 1024u })
+	{
+		Ocean::Desc timed = desc;
+		timed.GridSize = gridSize;
+		timed.CascadeCount = 1;
+		Ocean ocean(timed);
+
+		const int updateCount = 10;
+		double updateTime = ModuleTests::Seconds([&]()
+		{
+			for(int u = 0; u < updateCount; ++u)
+				ocean.Update(0.1f*u);
+		});
+		ModuleTests::Report("%ux%u: %.2f ms per cascade update (%u threads)", gridSize, gridSize,
+			updateTime * 1000.0 / updateCount, ThreadPool::Default().ThreadCount());
+	}
+}
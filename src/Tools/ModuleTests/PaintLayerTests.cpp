@@ -0,0 +1,202 @@
+//***************************************************************************************
+// PaintLayerTests.cpp
+//
+// The four-lane brush against one texel at a time on a flat image, over strokes that
+// straddle tile edges, tile corners and the borders of a layer whose last tiles are
+// partial.  After each batch of strokes TakeDirtyTiles returns exactly the tiles with
+// a texel that changed, each once and oldest first, and only tiles the brush reached
+// are allocated.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 25 Terrain/Terrain/PaintLayer.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Stroke
+	{
+		int X;
+		int Y;
+		int Radius;
+		XMFLOAT3 Color;
+		float Strength;
+	};
+
+	// PaintLayer::Paint one texel at a time on a row major image.
+	void PaintReference(std::vector<uint32_t>& image, int width, int height, const Stroke& s)
+	{
+		if(s.Radius <= 0)
+			return;
+
+		const float radius = (float)s.Radius;
+		for(int y = (std::max)(s.Y - s.Radius, 0); y <= (std::min)(s.Y + s.Radius, height - 1); ++y)
+		{
+			float dy = (float)(y - s.Y);
+			for(int x = (std::max)(s.X - s.Radius, 0); x <= (std::min)(s.X + s.Radius, width - 1); ++x)
+			{
+				float dx = (float)x - (float)s.X;
+				float distance = sqrtf(dx*dx + dy*dy);
+				if(distance > radius)
+					continue;
+
+				float alpha = 1.0f - distance / radius;
+				alpha = alpha*alpha;
+				float blend = alpha*s.Strength;
+				float keep = 1.0f - blend;
+
+				uint32_t& texel = image[(size_t)y*width + x];
+				float r = (float)(texel & 0xff) / 255.0f;
+				float g = (float)((texel >> 8) & 0xff) / 255.0f;
+				float b = (float)((texel >> 16) & 0xff) / 255.0f;
+				float a = (float)(texel >> 24) / 255.0f;
+
+				r = r*keep + s.Color.x*blend;
+				g = g*keep + s.Color.y*blend;
+				b = b*keep + s.Color.z*blend;
+				a = (std::min)(a + blend, 1.0f);
+
+				texel = (uint32_t)truncf(r*255.0f) | (uint32_t)truncf(g*255.0f) << 8 |
+					(uint32_t)truncf(b*255.0f) << 16 | (uint32_t)truncf(a*255.0f) << 24;
+			}
+		}
+	}
+
+	uint32_t TileOf(const PaintLayer& layer, int x, int y)
+	{
+		return (y / layer.GetTileSize())*layer.GetTilesX() + x / layer.GetTileSize();
+	}
+
+	uint32_t DifferingTexels(const PaintLayer& layer, const std::vector<uint32_t>& image)
+	{
+		uint32_t count = 0;
+		for(UINT y = 0; y < layer.GetHeight(); ++y)
+		{
+			for(UINT x = 0; x < layer.GetWidth(); ++x)
+				count += layer.GetTexel(x, y) != image[(size_t)y*layer.GetWidth() + x] ? 1 : 0;
+		}
+		return count;
+	}
+}
+
+TEST_SUITE(PaintLayer)
+{
+	// 300 x 200 in 64 texel tiles: 5 x 4 tiles, the last column 44 wide and the last
+	// row 8 high.
+	const int width = 300, height = 200;
+	PaintLayer layer(width, height, 64);
+	CHECK(layer.GetTilesX() == 5 && layer.GetTilesY() == 4);
+	UINT rx, ry, rw, rh;
+	layer.GetTileRect(19, rx, ry, rw, rh);
+	CHECK(rx == 256 && ry == 192 && rw == 44 && rh == 8);
+	CHECK(layer.GetAllocatedTileCount() == 0 && layer.GetDirtyTileCount() == 0);
+
+	std::vector<uint32_t> image((size_t)width*height, 0);
+	std::vector<UINT> dirty;
+
+	// A stroke on a tile corner, one along a vertical tile edge, one hanging off the
+	// bottom right corner, one wholly outside, one whose rim alone touches the next
+	// tile, and one too faint to change a texel.
+	const std::vector<std::vector<Stroke>> batches =
+	{
+		{ { 64, 64, 10, XMFLOAT3(1.0f, 0.0f, 0.0f), 0.5f } },
+		{ { 127, 30, 6, XMFLOAT3(0.0f, 1.0f, 0.0f), 0.8f }, { 298, 198, 12, XMFLOAT3(0.0f, 0.0f, 1.0f), 1.0f } },
+		{ { -50, 100, 20, XMFLOAT3(1.0f, 1.0f, 1.0f), 1.0f } },
+		{ { 55, 160, 9, XMFLOAT3(0.2f, 0.4f, 0.6f), 0.7f }, { 200, 130, 5, XMFLOAT3(1.0f, 1.0f, 1.0f), 0.001f } },
+		// Over the first stroke again, so its tiles are dirty once more.
+		{ { 64, 64, 10, XMFLOAT3(1.0f, 0.0f, 0.0f), 0.5f }, { 70, 60, 3, XMFLOAT3(0.0f, 1.0f, 0.0f), 0.5f } }
+	};
+
+	std::set<uint32_t> reached;
+	for(const std::vector<Stroke>& strokes : batches)
+	{
+		std::vector<uint32_t> before = image;
+		for(const Stroke& s : strokes)
+		{
+			layer.Paint(s.X, s.Y, s.Radius, s.Color, s.Strength);
+			PaintReference(image, width, height, s);
+
+			for(int y = (std::max)(s.Y - s.Radius, 0); y <= (std::min)(s.Y + s.Radius, height - 1); ++y)
+			{
+				for(int x = (std::max)(s.X - s.Radius, 0); x <= (std::min)(s.X + s.Radius, width - 1); ++x)
+				{
+					if((x - s.X)*(x - s.X) + (y - s.Y)*(y - s.Y) < s.Radius*s.Radius)
+						reached.insert(TileOf(layer, x, y));
+				}
+			}
+		}
+		CHECK(DifferingTexels(layer, image) == 0);
+
+		std::set<uint32_t> changed;
+		for(int y = 0; y < height; ++y)
+		{
+			for(int x = 0; x < width; ++x)
+			{
+				if(image[(size_t)y*width + x] != before[(size_t)y*width + x])
+					changed.insert(TileOf(layer, x, y));
+			}
+		}
+
+		layer.TakeDirtyTiles(1000, dirty);
+		CHECK(dirty.size() == changed.size());
+		CHECK(std::set<uint32_t>(dirty.begin(), dirty.end()) == changed);
+		CHECK(layer.GetDirtyTileCount() == 0);
+	}
+
+	// Tiles are allocated where the brush reached and nowhere else.
+	bool sparse = true;
+	for(uint32_t tile = 0; tile < layer.GetTilesX()*layer.GetTilesY(); ++tile)
+		sparse = sparse && (layer.GetTileData(tile) != nullptr) == (reached.count(tile) != 0);
+	CHECK(sparse);
+	CHECK(layer.GetAllocatedTileCount() == reached.size() && reached.size() < 20);
+
+	// Pending tiles come out oldest first and are queued once however often painted.
+	layer.Paint(10, 10, 4, XMFLOAT3(1.0f, 1.0f, 0.0f), 1.0f);
+	layer.Paint(200, 100, 4, XMFLOAT3(1.0f, 1.0f, 0.0f), 1.0f);
+	layer.Paint(12, 12, 4, XMFLOAT3(0.0f, 1.0f, 1.0f), 1.0f);
+	CHECK(layer.GetDirtyTileCount() == 2);
+	layer.TakeDirtyTiles(1, dirty);
+	CHECK(dirty.size() == 1 && dirty[0] == 0);
+	layer.TakeDirtyTiles(1, dirty);
+	CHECK(dirty.size() == 1 && dirty[0] == TileOf(layer, 200, 100));
+	layer.TakeDirtyTiles(1, dirty);
+	CHECK(dirty.empty());
+
+	// Random strokes over a larger layer against the reference, and the time of each.
+	const int size = 1024;
+	PaintLayer big(size, size);
+	std::vector<uint32_t> bigImage((size_t)size*size, 0);
+	std::mt19937 rng(31);
+	std::uniform_int_distribution<int> position(-32, size + 32);
+	std::uniform_int_distribution<int> radius(1, 64);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Stroke> strokes(2000);
+	uint64_t texels = 0;
+	for(Stroke& s : strokes)
+	{
+		s = { position(rng), position(rng), radius(rng), XMFLOAT3(unit(rng), unit(rng), unit(rng)), unit(rng) };
+		texels += (uint64_t)(2*s.Radius + 1)*(2*s.Radius + 1);
+	}
+
+	double brushTime = ModuleTests::Seconds([&]()
+	{
+		for(const Stroke& s : strokes)
+			big.Paint(s.X, s.Y, s.Radius, s.Color, s.Strength);
+	});
+	double referenceTime = ModuleTests::Seconds([&]()
+	{
+		for(const Stroke& s : strokes)
+			PaintReference(bigImage, size, size, s);
+	});
+	CHECK(DifferingTexels(big, bigImage) == 0);
+
+	ModuleTests::Report("%zu strokes on %dx%d, %u of %u tiles allocated: brush %.1f Mtexels/s, one texel at a time %.1f Mtexels/s",
+		strokes.size(), size, size, big.GetAllocatedTileCount(), big.GetTilesX()*big.GetTilesY(),
+		texels / brushTime * 1e-6, texels / referenceTime * 1e-6);
+}
@@ -0,0 +1,323 @@
+//***************************************************************************************
+// QuadTreeTests.cpp
+//
+// The terrain quadtree keeps its nodes in one breadth-first array and reuses last
+// frame's selection for subtrees the camera cannot have changed.  Both are checked
+// against a plain pointer tree that builds the same nodes recursively and selects
+// from scratch every frame by the same rules, along a random camera walk.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 25 Terrain/Terrain/QuadTree.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct RefNode
+	{
+		float X = 0.0f, Z = 0.0f, Size = 0.0f;
+		float MinY = 0.0f, MaxY = 0.0f;
+		int Depth = 0;
+		int Level = 0;
+		std::unique_ptr<RefNode> Children[4];
+
+		bool IsLeaf() const { return !Children[0]; }
+	};
+
+	struct Selected
+	{
+		float X, Z, Size;
+		int LODLevel;
+	};
+
+	// Same split rule and child order (NW, NE, SW, SE) as QuadTree::BuildTree.
+	std::unique_ptr<RefNode> BuildRef(float x, float z, float size, int depth, float minNodeSize, int maxLevels)
+	{
+		auto node = std::make_unique<RefNode>();
+		node->X = x;
+		node->Z = z;
+		node->Size = size;
+		node->Depth = depth;
+
+		if(size > minNodeSize && depth < maxLevels - 1)
+		{
+			const float q = size * 0.25f;
+			const float offsets[4][2] = { { -q, q }, { q, q }, { -q, -q }, { q, -q } };
+			for(int c = 0; c < 4; ++c)
+				node->Children[c] = BuildRef(x + offsets[c][0], z + offsets[c][1], size * 0.5f, depth + 1, minNodeSize, maxLevels);
+		}
+		return node;
+	}
+
+	// Levels counted from the leaves; leaves are queried and parents merge, as in
+	// QuadTree::UpdateHeightRanges.
+	void Finish(RefNode& node, const QuadTree::HeightRangeQuery& query, int top)
+	{
+		node.Level = top - node.Depth;
+		if(node.IsLeaf())
+		{
+			query(node.X, node.Z, node.Size, node.MinY, node.MaxY);
+			return;
+		}
+
+		node.MinY = FLT_MAX;
+		node.MaxY = -FLT_MAX;
+		for(auto& child : node.Children)
+		{
+			Finish(*child, query, top);
+			node.MinY = (std::min)(node.MinY, child->MinY);
+			node.MaxY = (std::max)(node.MaxY, child->MaxY);
+		}
+	}
+
+	int MaxDepth(const RefNode& node)
+	{
+		return node.IsLeaf() ? node.Depth : MaxDepth(*node.Children[0]);
+	}
+
+	// Written out in the order QuadTree's four-wide test evaluates it, so results on
+	// the planes themselves agree.
+	void Classify(const RefNode& node, const XMFLOAT4* planes, bool& visible, bool& inside)
+	{
+		float cy = (node.MinY + node.MaxY) * 0.5f;
+		float e = node.Size * 0.5f, ey = (node.MaxY - node.MinY) * 0.5f;
+
+		visible = true;
+		inside = true;
+		for(int i = 0; i < 6; ++i)
+		{
+			const XMFLOAT4& p = planes[i];
+			float d = p.x*node.X + (p.y*cy + (p.z*node.Z + p.w));
+			float r = fabsf(p.x)*e + (fabsf(p.y)*ey + fabsf(p.z)*e);
+			visible = visible && !(d + r < 0.0f);
+			inside = inside && (d - r >= 0.0f);
+		}
+	}
+
+	bool InRange(const RefNode& node, float range, const XMFLOAT3& eye)
+	{
+		float h = node.Size * 0.5f;
+		float dx = (std::max)((std::max)(node.X - h - eye.x, eye.x - (node.X + h)), 0.0f);
+		float dy = (std::max)((std::max)(node.MinY - eye.y, eye.y - node.MaxY), 0.0f);
+		float dz = (std::max)((std::max)(node.Z - h - eye.z, eye.z - (node.Z + h)), 0.0f);
+		return sqrtf(dx*dx + dy*dy + dz*dz) <= range;
+	}
+
+	// Selection from scratch: split where the next finer range reaches the node, draw
+	// children it does not reach as quadrants of the node's grid.
+	void SelectRef(const RefNode& node, bool inside, const XMFLOAT3& eye, const XMFLOAT4* planes,
+		const std::vector<float>& ranges, std::vector<Selected>& out)
+	{
+		if(node.IsLeaf() || !InRange(node, ranges[node.Level - 1], eye))
+		{
+			out.push_back({ node.X, node.Z, node.Size, node.Level });
+			return;
+		}
+
+		bool visit[4] = {};
+		bool childInside[4] = {};
+		for(int c = 0; c < 4; ++c)
+		{
+			const RefNode& child = *node.Children[c];
+			bool visible = true;
+			childInside[c] = true;
+			if(!inside)
+				Classify(child, planes, visible, childInside[c]);
+			if(!visible)
+				continue;
+
+			visit[c] = InRange(child, ranges[node.Level - 1], eye);
+			if(!visit[c])
+				out.push_back({ child.X, child.Z, child.Size, node.Level });
+		}
+
+		for(int c = 0; c < 4; ++c)
+		{
+			if(visit[c])
+				SelectRef(*node.Children[c], childInside[c], eye, planes, ranges, out);
+		}
+	}
+
+	// Inward-facing planes of a left-handed perspective camera.
+	void MakeFrustum(const XMFLOAT3& eye, float yaw, float pitch, float fovY, float aspect,
+		float nearZ, float farZ, XMFLOAT4 planes[6])
+	{
+		XMFLOAT3 f(cosf(pitch)*sinf(yaw), sinf(pitch), cosf(pitch)*cosf(yaw));
+		XMFLOAT3 r(cosf(yaw), 0.0f, -sinf(yaw));
+		XMFLOAT3 u(f.y*r.z - f.z*r.y, f.z*r.x - f.x*r.z, f.x*r.y - f.y*r.x);
+		float tanV = tanf(fovY * 0.5f), tanH = tanV * aspect;
+
+		auto plane = [&](const XMFLOAT3& n, float offset)
+		{
+			return XMFLOAT4(n.x, n.y, n.z, -(n.x*eye.x + n.y*eye.y + n.z*eye.z) + offset);
+		};
+		auto combine = [](const XMFLOAT3& a, float s, const XMFLOAT3& b, float t)
+		{
+			return XMFLOAT3(a.x*s + b.x*t, a.y*s + b.y*t, a.z*s + b.z*t);
+		};
+
+		planes[0] = plane(f, -nearZ);
+		planes[1] = plane(XMFLOAT3(-f.x, -f.y, -f.z), farZ);
+		planes[2] = plane(combine(f, tanH, r, 1.0f), 0.0f);
+		planes[3] = plane(combine(f, tanH, r, -1.0f), 0.0f);
+		planes[4] = plane(combine(f, tanV, u, 1.0f), 0.0f);
+		planes[5] = plane(combine(f, tanV, u, -1.0f), 0.0f);
+	}
+
+	// A smooth height field, bounded over a square by sampling a grid and padding.
+	void QueryHeights(float x, float z, float size, float& minY, float& maxY)
+	{
+		minY = FLT_MAX;
+		maxY = -FLT_MAX;
+		for(int j = 0; j <= 4; ++j)
+		{
+			for(int i = 0; i <= 4; ++i)
+			{
+				float sx = x + size * (i / 4.0f - 0.5f);
+				float sz = z + size * (j / 4.0f - 0.5f);
+				float h = 40.0f + 30.0f*sinf(sx / 90.0f)*cosf(sz / 70.0f) + 10.0f*sinf((sx + sz) / 23.0f);
+				minY = (std::min)(minY, h);
+				maxY = (std::max)(maxY, h);
+			}
+		}
+		minY -= 2.0f;
+		maxY += 2.0f;
+	}
+}
+
+TEST_SUITE(QuadTree)
+{
+	// The terrain sample's shape: 1024 units, five levels, leaves of 64.
+	const float terrainSize = 1024.0f;
+	const int levels = 5;
+	const float minNodeSize = terrainSize / (1 << (levels - 1));
+
+	QuadTree tree;
+	tree.SetLODRanges({ 40.0f, 90.0f, 200.0f, 420.0f });
+	tree.Initialize(terrainSize, minNodeSize, levels);
+	tree.UpdateHeightRanges(QueryHeights);
+
+	std::unique_ptr<RefNode> root = BuildRef(0.0f, 0.0f, terrainSize, 0, minNodeSize, levels);
+	Finish(*root, QueryHeights, MaxDepth(*root));
+
+	// Breadth-first layout: same nodes, in order, with matching links.
+	{
+		std::deque<std::pair<const RefNode*, UINT>> queue = { { root.get(), 0u } };
+		UINT index = 0, next = 1;
+		bool match = true;
+		while(!queue.empty())
+		{
+			const RefNode* ref = queue.front().first;
+			UINT parent = queue.front().second;
+			queue.pop_front();
+
+			const TerrainNode& node = tree.GetNode(index);
+			match = match && node.X == ref->X && node.Z == ref->Z && node.Size == ref->Size &&
+				node.Level == ref->Level && node.IsLeaf == ref->IsLeaf() && node.Parent == parent &&
+				node.MinY == ref->MinY && node.MaxY == ref->MaxY;
+			if(!ref->IsLeaf())
+			{
+				match = match && node.FirstChild == next;
+				for(int c = 0; c < 4; ++c)
+				{
+					match = match && tree.GetNode(next + c).Quadrant == c;
+					queue.push_back({ ref->Children[c].get(), index });
+				}
+				next += 4;
+			}
+			++index;
+		}
+		CHECK(match);
+		CHECK(tree.GetTotalNodeCount() == (int)index);
+		CHECK(tree.GetLevelCount() == levels);
+	}
+
+	// Either limit stops the split: with small leaves allowed, the level count does.
+	{
+		QuadTree deep;
+		deep.Initialize(terrainSize, 1.0f, 3);
+		CHECK(deep.GetLevelCount() == 3 && deep.GetTotalNodeCount() == 1 + 4 + 16);
+		CHECK(deep.GetNode(0).Level == 2 && deep.GetNode(5).IsLeaf && deep.GetNode(5).Size == terrainSize / 4);
+
+		QuadTree coarse;
+		coarse.Initialize(terrainSize, terrainSize / 2, 6);
+		CHECK(coarse.GetLevelCount() == 2 && coarse.GetTotalNodeCount() == 5);
+	}
+
+	// Random walk over and around the terrain: mostly small steps and turns, which the
+	// incremental selection can reuse, with jumps and frames where nothing moves.
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	XMFLOAT3 eye(0.0f, 120.0f, -600.0f);
+	float yaw = 0.3f, pitch = -0.2f;
+	XMFLOAT4 planes[6];
+
+	const int frames = 1500;
+	uint32_t mismatches = 0, levelJumps = 0, morphGaps = 0, reusedFrames = 0;
+	uint64_t evaluated = 0;
+	std::vector<TerrainNode*> visible;
+	std::vector<Selected> expected;
+	for(int frame = 0; frame < frames; ++frame)
+	{
+		int move = frame % 50;
+		if(move == 0)
+		{
+			eye = XMFLOAT3(unit(rng) * 700.0f, 60.0f + 200.0f * (unit(rng) + 1.0f), unit(rng) * 700.0f);
+			yaw = unit(rng) * 3.1416f;
+		}
+		else if(move % 7 == 3)
+		{
+			yaw += unit(rng) * 0.05f;
+			pitch = (std::max)(-1.2f, (std::min)(0.3f, pitch + unit(rng) * 0.05f));
+		}
+		else if(move % 11 != 5)
+		{
+			eye.x += unit(rng) * 3.0f;
+			eye.y = (std::max)(5.0f, eye.y + unit(rng));
+			eye.z += unit(rng) * 3.0f;
+		}
+
+		MakeFrustum(eye, yaw, pitch, 0.25f * 3.1416f, 16.0f / 9.0f, 1.0f, 3000.0f, planes);
+		tree.Update(eye, planes);
+		tree.GetVisibleNodes(visible);
+		evaluated += tree.GetEvaluatedNodeCount();
+		if(tree.GetEvaluatedNodeCount() < (int)visible.size())
+			++reusedFrames;
+
+		expected.clear();
+		bool rootVisible, rootInside;
+		Classify(*root, planes, rootVisible, rootInside);
+		if(rootVisible)
+			SelectRef(*root, rootInside, eye, planes, tree.GetLODRanges(), expected);
+
+		bool same = visible.size() == expected.size();
+		for(size_t i = 0; same && i < visible.size(); ++i)
+		{
+			same = visible[i]->X == expected[i].X && visible[i]->Z == expected[i].Z &&
+				visible[i]->Size == expected[i].Size && visible[i]->LODLevel == expected[i].LODLevel;
+		}
+		if(!same)
+			++mismatches;
+
+		QuadTree::SelectionCheck check = tree.CheckSelection(eye);
+		if(check.MaxLODDifference > 1)
+			++levelJumps;
+		morphGaps += check.MorphGaps;
+	}
+
+	ModuleTests::Report("%d frames, %.1f of %d nodes evaluated per frame, %u frames mostly reused",
+		frames, (double)evaluated / frames, tree.GetTotalNodeCount(), reusedFrames);
+	CHECK(mismatches == 0);
+	CHECK(levelJumps == 0);
+	CHECK(morphGaps == 0);
+	CHECK(reusedFrames > 0);
+}
@@ -0,0 +1,133 @@
+//***************************************************************************************
+// SampleSetsTests.cpp
+//
+// The sample sets of the SSAO sample.  Its kernel, eight Sobol offsets sorted by
+// length, lies in the +z hemisphere between the minimum length and 1, shortest
+// first, and sorting keeps the set; a long kernel has the mean cosine of 2/3 that
+// cosine weighting gives.  Its 64x64 blue noise rotation map holds every value
+// (rank + 0.5) / 4096 once, comes out the same for a seed on every run, and has a
+// small fraction of the low frequency power of the same values shuffled.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/Fft.h"
+#include "../../Common/SampleSets.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	float Length(const XMFLOAT4& k)
+	{
+		return sqrtf(k.x*k.x + k.y*k.y + k.z*k.z);
+	}
+
+	// Mean power of the frequencies up to n/8 long over the mean of all those up to
+	// n/2 but the constant one: about 1 for white noise, far less for blue noise.
+	double LowFrequencyPower(const std::vector<float>& values, uint32_t n)
+	{
+		double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+		std::vector<float> re(values.size()), im(values.size(), 0.0f);
+		for(size_t i = 0; i < values.size(); ++i)
+			re[i] = (float)(values[i] - mean);
+
+		Fft fft(n);
+		fft.Transform2D(re.data(), im.data(), false);
+
+		double low = 0.0, all = 0.0;
+		uint32_t lowCount = 0, allCount = 0;
+		for(uint32_t y = 0; y < n; ++y)
+		{
+			for(uint32_t x = 0; x < n; ++x)
+			{
+				int kx = x < n/2 ? (int)x : (int)x - (int)n;
+				int ky = y < n/2 ? (int)y : (int)y - (int)n;
+				double k = sqrt((double)(kx*kx + ky*ky));
+				if(k == 0.0 || k > n/2)
+					continue;
+
+				size_t i = (size_t)y*n + x;
+				double power = (double)re[i]*re[i] + (double)im[i]*im[i];
+				all += power;
+				++allCount;
+				if(k <= n/8)
+				{
+					low += power;
+					++lowCount;
+				}
+			}
+		}
+		return (low / lowCount) / (all / allCount);
+	}
+}
+
+TEST_SUITE(SampleSets)
+{
+	// The kernel as Ssao::BuildOffsetVectors makes it.
+	const uint32_t sampleCount = 8;
+	const float minLength = 0.25f;
+	std::vector<XMFLOAT4> unsorted = SampleSets::HemisphereKernel(sampleCount, SampleSets::Sequence::Sobol, minLength);
+	std::vector<XMFLOAT4> kernel = unsorted;
+	SampleSets::SortByLength(kernel);
+	CHECK(kernel.size() == sampleCount);
+
+	bool inHemisphere = true, sorted = true, sameSet = true;
+	for(size_t i = 0; i < kernel.size(); ++i)
+	{
+		float length = Length(kernel[i]);
+		inHemisphere = inHemisphere && kernel[i].z > 0.0f && kernel[i].w == 0.0f &&
+			length >= minLength - 1e-6f && length <= 1.0f + 1e-6f;
+		sorted = sorted && (i == 0 || Length(kernel[i - 1]) <= length);
+		sameSet = sameSet && std::count_if(unsorted.begin(), unsorted.end(), [&](const XMFLOAT4& k)
+		{
+			return k.x == kernel[i].x && k.y == kernel[i].y && k.z == kernel[i].z;
+		}) == 1;
+	}
+	CHECK(inHemisphere);
+	CHECK(sorted);
+	CHECK(sameSet);
+
+	// Both sequences, long enough for the mean cosine to settle.
+	for(SampleSets::Sequence sequence : { SampleSets::Sequence::Hammersley, SampleSets::Sequence::Sobol })
+	{
+		std::vector<XMFLOAT4> large = SampleSets::HemisphereKernel(4096, sequence, minLength);
+		double cosine = 0.0;
+		bool above = true;
+		for(const XMFLOAT4& k : large)
+		{
+			cosine += k.z / Length(k);
+			above = above && k.z > 0.0f;
+		}
+		CHECK(above);
+		CHECK_NEAR(cosine / large.size(), 2.0 / 3.0, 1e-3);
+	}
+
+	// The rotation map.
+	const uint32_t size = 64;
+	std::vector<float> noise;
+	double noiseTime = ModuleTests::Seconds([&]() { noise = SampleSets::BlueNoise(size); });
+	CHECK(noise.size() == size*size);
+	CHECK(SampleSets::BlueNoise(size) == noise);
+
+	std::vector<float> values = noise;
+	std::sort(values.begin(), values.end());
+	bool permutation = true;
+	for(uint32_t i = 0; i < size*size; ++i)
+		permutation = permutation && values[i] == (i + 0.5f) / (size*size);
+	CHECK(permutation);
+
+	std::vector<float> white = noise;
+	std::shuffle(white.begin(), white.end(), std::mt19937(44));
+	double blueLow = LowFrequencyPower(noise, size);
+	double whiteLow = LowFrequencyPower(white, size);
+	CHECK(blueLow < 0.01);
+	CHECK(whiteLow > 0.5);
+
+	ModuleTests::Report("%ux%u blue noise in %.1f ms: low frequency power %.4f, shuffled %.2f",
+		size, size, noiseTime*1e3, blueLow, whiteLow);
+}
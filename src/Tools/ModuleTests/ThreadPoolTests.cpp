@@ -0,0 +1,74 @@
+//***************************************************************************************
+// ThreadPoolTests.cpp
+//
+// ParallelFor must run every index exactly once for any pool size and count, run a
+// loop issued from inside a task on the calling worker, and keep loops issued from
+// several threads at once apart.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST_SUITE(ThreadPool)
+{
+	CHECK(ThreadPool::Default().ThreadCount() >= 1);
+
+	ThreadPool one(1), three(3);
+	CHECK(one.ThreadCount() == 1 && three.ThreadCount() == 3);
+
+	for(ThreadPool* pool : { &one, &three, &ThreadPool::Default() })
+	{
+		bool exact = true;
+		for(uint32_t count : { 0u, 1u, 2u, 7u, 1000u, 100003u })
+		{
+			std::vector<std::atomic<uint32_t>> runs(count);
+			for(auto& r : runs)
+				r = 0;
+			pool->ParallelFor(count, [&](uint32_t i) { ++runs[i]; });
+			exact = exact && std::all_of(runs.begin(), runs.end(), [](const std::atomic<uint32_t>& r) { return r == 1; });
+		}
+		CHECK(exact);
+
+		// Nested loops run inline, so every inner index still runs once per outer one.
+		const uint32_t outer = 64, inner = 257;
+		std::vector<std::atomic<uint32_t>> cells(outer*inner);
+		for(auto& c : cells)
+			c = 0;
+		pool->ParallelFor(outer, [&](uint32_t i)
+		{
+			pool->ParallelFor(inner, [&](uint32_t j) { ++cells[i*inner + j]; });
+		});
+		CHECK(std::all_of(cells.begin(), cells.end(), [](const std::atomic<uint32_t>& c) { return c == 1; }));
+	}
+
+	// Loops from several threads at once.
+	std::vector<std::atomic<uint32_t>> sums(4);
+	for(auto& s : sums)
+		s = 0;
+	std::vector<std::thread> submitters;
+	for(uint32_t t = 0; t < 4; ++t)
+	{
+		submitters.emplace_back([&, t]()
+		{
+			for(int loop = 0; loop < 50; ++loop)
+				three.ParallelFor(100, [&](uint32_t i) { sums[t] += i; });
+		});
+	}
+	for(auto& s : submitters)
+		s.join();
+	CHECK(std::all_of(sums.begin(), sums.end(), [](const std::atomic<uint32_t>& s) { return s == 50u*4950u; }));
+
+	// Many short loops, the case a step of a small wave grid makes.
+	const int loopCount = 20000;
+	double time = ModuleTests::Seconds([&]()
+	{
+		for(int loop = 0; loop < loopCount; ++loop)
+			ThreadPool::Default().ParallelFor(8, [](uint32_t) {});
+	});
+	ModuleTests::Report("%u threads, %.2f us per loop of 8 empty tasks",
+		ThreadPool::Default().ThreadCount(), time * 1e6 / loopCount);
+}
@@ -0,0 +1,241 @@
+//***************************************************************************************
+// TileStreamerTests.cpp
+//
+// The terrain tile scheduler driven offline with a loader that makes its tiles up.
+// Tiles shown one after another evict least recently used first; along a scripted
+// camera path replayed through the quadtree the cache stays within its budget after
+// every frame, each page table entry points at the atlas slot of a resident level of
+// its own tile, and the look-ahead along the camera velocity loads tiles before the
+// camera reaches them.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Chapter 25 Terrain/Terrain/TileStreamer.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Counts the loads and fills the tile plus its border with something per tile.
+	struct SyntheticLoader
+	{
+		UINT Resolution = 0;
+		std::vector<TileKey>* Loads = nullptr;
+
+		bool operator()(const TileKey& key, std::vector<float>& heights, float& minH, float& maxH) const
+		{
+			UINT side = (std::max)(1u, Resolution >> key.Mip) + 2;
+			heights.assign((size_t)side*side, (float)(key.X*100 + key.Y*10 + key.Mip));
+			minH = maxH = heights[0];
+			Loads->push_back(key);
+			return true;
+		}
+	};
+
+	size_t TileBytes(UINT resolution, UINT mip)
+	{
+		size_t side = (std::max)(1u, resolution >> mip) + 2;
+		return side*side*sizeof(float);
+	}
+
+	void FlatHeights(float, float, float, float& minY, float& maxY)
+	{
+		minY = -2.0f;
+		maxY = 2.0f;
+	}
+
+	struct PathRun
+	{
+		bool WithinBudget = true;
+		bool PageTableMatches = true;
+		UINT MappedEntries = 0;
+		std::vector<int> FirstFineFrame;    // Per tile along the path, -1 = never at mip 0
+		TileStreamer::Stats Stats;
+	};
+
+	// The camera flies along +x at 60 units a second, ten samples a second, looking
+	// back the way it came, so only the look-ahead can ask for the tiles in front of it.
+	// The far plane at 300 lets the tiles left behind fall out of view and be evicted.
+	PathRun RunPath(float prefetchTime)
+	{
+		const float terrainSize = 1024.0f;
+		const int levels = 5;
+		QuadTree quadTree;
+		quadTree.SetLODRanges({ 40.0f, 90.0f, 200.0f, 420.0f });
+		quadTree.Initialize(terrainSize, terrainSize / (1 << (levels - 1)), levels);
+		quadTree.UpdateHeightRanges(FlatHeights);
+
+		TileStreamer::Desc desc;
+		desc.TerrainSize = terrainSize;
+		desc.TilesX = 8;
+		desc.TilesY = 8;
+		desc.TileResolution = 16;
+		desc.BaseMip = 4;
+		desc.MemoryBudget = 16*TileBytes(desc.TileResolution, 0);
+		desc.AtlasSlotsX = 4;
+		desc.AtlasSlotsY = 2;
+		desc.MaxRequestsInFlight = 64;
+		desc.MaxUploadsPerFrame = 4;
+		desc.MipDistance = 96.0f;
+		desc.PrefetchTime = prefetchTime;
+		desc.Asynchronous = false;
+
+		std::vector<TileKey> loads;
+		TileStreamer streamer(desc, SyntheticLoader{ desc.TileResolution, &loads });
+
+		std::vector<CameraPathSample> path;
+		for(int i = 0; i <= 150; ++i)
+		{
+			CameraPathSample s;
+			s.Time = i * 0.1f;
+			s.Position = XMFLOAT3(-450.0f + 6.0f*i, 30.0f, 10.0f);
+			s.Look = XMFLOAT3(-1.0f, 0.0f, 0.0f);
+			path.push_back(s);
+		}
+
+		const float tileSize = terrainSize / desc.TilesX;
+		const int row = (int)((path[0].Position.z + 0.5f*terrainSize) / tileSize);
+		const UINT slotSize = desc.TileResolution + 2;
+		const float atlasW = (float)streamer.GetAtlasWidth();
+		const float atlasH = (float)streamer.GetAtlasHeight();
+
+		PathRun run;
+		run.FirstFineFrame.assign(desc.TilesX, -1);
+		std::vector<TileKey> slotContents(desc.AtlasSlotsX*desc.AtlasSlotsY);
+
+		run.Stats = ReplayCameraPath(streamer, quadTree, path, 0.25f*XM_PI, 16.0f / 9.0f, 1.0f, 300.0f,
+			[&](size_t sample)
+			{
+				run.WithinBudget = run.WithinBudget && streamer.GetStats().MemoryUsed <= desc.MemoryBudget;
+
+				for(const TileStreamer::SlotUpload& upload : streamer.GetPendingUploads())
+				{
+					UINT slot = (upload.Y / slotSize)*desc.AtlasSlotsX + upload.X / slotSize;
+					slotContents[slot] = upload.Key;
+					run.PageTableMatches = run.PageTableMatches && streamer.IsResident(upload.Key);
+				}
+
+				// Every mapped tile: its own tile, resident, at the scale of its level,
+				// and no two tiles in one slot.
+				std::vector<bool> slotUsed(slotContents.size(), false);
+				const std::vector<XMFLOAT4>& pageTable = streamer.GetPageTable();
+				for(int y = 0; y < desc.TilesY; ++y)
+				{
+					for(int x = 0; x < desc.TilesX; ++x)
+					{
+						const XMFLOAT4& entry = pageTable[y*desc.TilesX + x];
+						if(entry.x == 0.0f)
+							continue;
+						++run.MappedEntries;
+
+						UINT ox = (UINT)lroundf(entry.z*atlasW) - 1;
+						UINT oy = (UINT)lroundf(entry.w*atlasH) - 1;
+						UINT slot = (oy / slotSize)*desc.AtlasSlotsX + ox / slotSize;
+						if(slot >= slotContents.size())
+						{
+							run.PageTableMatches = false;
+							continue;
+						}
+						const TileKey& key = slotContents[slot];
+						float res = (float)(std::max)(1u, desc.TileResolution >> key.Mip);
+						run.PageTableMatches = run.PageTableMatches && ox % slotSize == 0 && oy % slotSize == 0 &&
+							!slotUsed[slot] && key.X == x && key.Y == y && streamer.IsResident(key) &&
+							entry.x == res / atlasW && entry.y == res / atlasH;
+						slotUsed[slot] = true;
+					}
+				}
+
+				for(int x = 0; x < desc.TilesX; ++x)
+				{
+					if(run.FirstFineFrame[x] < 0 && streamer.IsResident(TileKey{ x, row, 0 }))
+						run.FirstFineFrame[x] = (int)sample;
+				}
+			});
+		return run;
+	}
+}
+
+TEST_SUITE(TileStreamer)
+{
+	// Four tiles in a row, each wanted at mip 0 wherever the camera is, and room for two.
+	{
+		TileStreamer::Desc desc;
+		desc.TerrainSize = 400.0f;
+		desc.TilesX = 4;
+		desc.TilesY = 1;
+		desc.TileResolution = 16;
+		desc.MipDistance = 1e4f;
+		desc.MemoryBudget = 2*TileBytes(desc.TileResolution, 0);
+		desc.Asynchronous = false;
+
+		std::vector<TileKey> loads;
+		TileStreamer streamer(desc, SyntheticLoader{ desc.TileResolution, &loads });
+
+		const XMFLOAT3 camera(0.0f, 50.0f, 0.0f), still(0.0f, 0.0f, 0.0f);
+		auto show = [&](int first, int last)
+		{
+			TerrainNode node = {};
+			node.X = -200.0f + 50.0f*(first + last + 1);
+			node.Size = 100.0f*(last - first + 1) - 10.0f;
+			streamer.Update(camera, still, { &node });
+		};
+		auto resident = [&](std::vector<int> tiles)
+		{
+			bool match = true;
+			for(int x = 0; x < 4; ++x)
+				match = match && streamer.IsResident(TileKey{ x, 0, 0 }) == (std::find(tiles.begin(), tiles.end(), x) != tiles.end());
+			return match;
+		};
+
+		show(0, 0);
+		show(1, 1);
+		CHECK(resident({ 0, 1 }) && streamer.GetStats().Evictions == 0);
+
+		// Showing 0 again makes 1 the least recently used, so 2 pushes out 1, not 0.
+		show(0, 0);
+		CHECK(loads.size() == 2);
+		show(2, 2);
+		CHECK(resident({ 0, 2 }) && streamer.GetStats().Evictions == 1);
+		show(3, 3);
+		CHECK(resident({ 2, 3 }) && streamer.GetStats().Evictions == 2);
+		show(2, 2);
+		CHECK(loads.size() == 4);
+		CHECK(streamer.GetStats().MemoryUsed <= desc.MemoryBudget);
+
+		// Tiles shown this frame stay even when together they go over the budget.
+		show(0, 3);
+		CHECK(resident({ 0, 1, 2, 3 }) && loads.size() == 6);
+		show(1, 1);
+		CHECK(resident({ 1, 3 }) && streamer.GetStats().MemoryUsed <= desc.MemoryBudget);
+	}
+
+	// The scripted path, with and without the look-ahead.
+	PathRun ahead = RunPath(1.5f);
+	PathRun plain = RunPath(0.0f);
+	CHECK(ahead.WithinBudget && plain.WithinBudget);
+	CHECK(ahead.Stats.Evictions > 0 && plain.Stats.Evictions > 0);
+	CHECK(ahead.PageTableMatches && plain.PageTableMatches);
+	CHECK(ahead.MappedEntries > 0 && plain.MappedEntries > 0);
+
+	// Each tile the camera flies into after the first is fine before the camera gets
+	// there with the look-ahead, and not until it is over it without.
+	bool earlier = true;
+	for(int x = 1; x < 8; ++x)
+	{
+		float tileStart = -512.0f + 128.0f*x;
+		int arrival = (int)ceilf((tileStart + 450.0f) / 6.0f);
+		if(arrival > 150)
+			continue;
+		earlier = earlier && ahead.FirstFineFrame[x] >= 0 && ahead.FirstFineFrame[x] < arrival &&
+			(plain.FirstFineFrame[x] < 0 || plain.FirstFineFrame[x] >= arrival);
+	}
+	CHECK(earlier);
+
+	ModuleTests::Report("%u frames: %u loads and %u evictions with the look-ahead, %u and %u without; %u coarse fallbacks against %u",
+		ahead.Stats.Frames, ahead.Stats.Requests, ahead.Stats.Evictions, plain.Stats.Requests, plain.Stats.Evictions,
+		ahead.Stats.CoarseFallbacks, plain.Stats.CoarseFallbacks);
+}
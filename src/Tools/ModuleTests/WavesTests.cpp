@@ -0,0 +1,208 @@
+//***************************************************************************************
+// WavesTests.cpp
+//
+// The tiled solver against the per-point loop it replaced, which kept a whole vertex
+// per grid point and made one pass for the heights and one for the normals: heights
+// must match bit for bit, on the shared pool, on one thread and on four, and normals and
+// tangents to rounding.  The copies the demos stream instead of vertices must hold the
+// heights and normals to the precision of their formats.
+//***************************************************************************************
+
+#include "ModuleTests.h"
+#include "../../Common/Waves.h"
+#include "../../Common/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ppl.h>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// One step of the solver as it was before Waves moved to Common.
+	void StepWavesReference(int m, int n, float k1, float k2, float k3, float spatialStep,
+		std::vector<XMFLOAT3>& prev, std::vector<XMFLOAT3>& curr,
+		std::vector<XMFLOAT3>& normals, std::vector<XMFLOAT3>& tangentX)
+	{
+		concurrency::parallel_for(1, m - 1, [&](int i)
+		{
+			for(int j = 1; j < n - 1; ++j)
+			{
+				prev[i*n + j].y =
+					k1*prev[i*n + j].y +
+					k2*curr[i*n + j].y +
+					k3*(curr[(i + 1)*n + j].y +
+						curr[(i - 1)*n + j].y +
+						curr[i*n + j + 1].y +
+						curr[i*n + j - 1].y);
+			}
+		});
+
+		std::swap(prev, curr);
+
+		concurrency::parallel_for(1, m - 1, [&](int i)
+		{
+			for(int j = 1; j < n - 1; ++j)
+			{
+				float l = curr[i*n + j - 1].y;
+				float r = curr[i*n + j + 1].y;
+				float t = curr[(i - 1)*n + j].y;
+				float b = curr[(i + 1)*n + j].y;
+
+				XMStoreFloat3(&normals[i*n + j], XMVector3Normalize(XMVectorSet(l - r, 2.0f*spatialStep, b - t, 0.0f)));
+				XMStoreFloat3(&tangentX[i*n + j], XMVector3Normalize(XMVectorSet(2.0f*spatialStep, r - l, 0.0f, 0.0f)));
+			}
+		});
+	}
+}
+
+TEST_SUITE(Waves)
+{
+	// The demo's constants on a grid far too big to draw, with a column count that
+	// leaves a scalar tail in every row.
+	const int m = 1031;
+	const int n = 1027;
+	const float dx = 1.0f;
+	const float dt = 0.03f;
+	const float speed = 4.0f;
+	const float damping = 0.2f;
+	const int stepCount = 20;
+
+	// The shared pool, one thread, and four threads whatever the machine has, so
+	// tiles run side by side even on a small one.
+	ThreadPool serialPool(1), fourPool(4);
+	Waves waves(m, n, dx, dt, speed, damping);
+	Waves serialWaves(m, n, dx, dt, speed, damping, &serialPool);
+	Waves fourWaves(m, n, dx, dt, speed, damping, &fourPool);
+	CHECK(waves.RowCount() == m && waves.ColumnCount() == n && waves.VertexCount() == m*n);
+	CHECK(waves.TriangleCount() == (m - 1)*(n - 1)*2);
+
+	// Grid points are laid out from the back left corner, row by row.
+	XMFLOAT3 first = waves.Position(0), last = waves.Position(m*n - 1);
+	CHECK(first.x == -0.5f*(n - 1)*dx && first.z == 0.5f*(m - 1)*dx);
+	CHECK(last.x == 0.5f*(n - 1)*dx && last.z == -0.5f*(m - 1)*dx);
+
+	float d = damping*dt + 2.0f;
+	float e = (speed*speed)*(dt*dt) / (dx*dx);
+	float k1 = (damping*dt - 2.0f) / d;
+	float k2 = (4.0f - 8.0f*e) / d;
+	float k3 = (2.0f*e) / d;
+
+	std::vector<XMFLOAT3> prev(m*n, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	std::vector<XMFLOAT3> curr(m*n, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	std::vector<XMFLOAT3> normals(m*n, XMFLOAT3(0.0f, 1.0f, 0.0f));
+	std::vector<XMFLOAT3> tangentX(m*n, XMFLOAT3(1.0f, 0.0f, 0.0f));
+
+	// The same drops in all four grids, some next to the boundary.
+	for(int k = 0; k < 64; ++k)
+	{
+		int i = 2 + (k*977) % (m - 4);
+		int j = 2 + (k*541) % (n - 4);
+		float magnitude = 0.2f + 0.005f*k;
+
+		waves.Disturb(i, j, magnitude);
+		serialWaves.Disturb(i, j, magnitude);
+		fourWaves.Disturb(i, j, magnitude);
+
+		curr[i*n + j].y += magnitude;
+		curr[i*n + j + 1].y += 0.5f*magnitude;
+		curr[i*n + j - 1].y += 0.5f*magnitude;
+		curr[(i + 1)*n + j].y += 0.5f*magnitude;
+		curr[(i - 1)*n + j].y += 0.5f*magnitude;
+	}
+
+	// Less than a time step does nothing.
+	waves.Update(0.5f*dt);
+	CHECK(waves.Heights()[2*n + 2] == curr[2*n + 2].y);
+
+	double referenceTime = ModuleTests::Seconds([&]()
+	{
+		for(int s = 0; s < stepCount; ++s)
+			StepWavesReference(m, n, k1, k2, k3, dx, prev, curr, normals, tangentX);
+	});
+
+	// The half step above plus another half is the first step.
+	double wavesTime = ModuleTests::Seconds([&]()
+	{
+		waves.Update(0.5f*dt);
+		for(int s = 1; s < stepCount; ++s)
+			waves.Step();
+	});
+
+	double serialTime = ModuleTests::Seconds([&]()
+	{
+		for(int s = 0; s < stepCount; ++s)
+			serialWaves.Step();
+	});
+	for(int s = 0; s < stepCount; ++s)
+		fourWaves.Step();
+
+	int heightMismatches = 0;
+	float maxHeight = 0.0f, maxNormalError = 0.0f, maxTangentError = 0.0f;
+	for(int i = 0; i < m*n; ++i)
+	{
+		if(waves.Position(i).y != curr[i].y || waves.Heights()[i] != curr[i].y ||
+		   serialWaves.Heights()[i] != curr[i].y || fourWaves.Heights()[i] != curr[i].y)
+			++heightMismatches;
+		maxHeight = (std::max)(maxHeight, fabsf(curr[i].y));
+
+		XMFLOAT3 normal = fourWaves.Normal(i);
+		XMFLOAT3 tangent = fourWaves.TangentX(i);
+		XMVECTOR normalError = XMVector3Length(XMVectorSubtract(XMLoadFloat3(&normal), XMLoadFloat3(&normals[i])));
+		XMVECTOR tangentError = XMVector3Length(XMVectorSubtract(XMLoadFloat3(&tangent), XMLoadFloat3(&tangentX[i])));
+		maxNormalError = (std::max)(maxNormalError, XMVectorGetX(normalError));
+		maxTangentError = (std::max)(maxTangentError, XMVectorGetX(tangentError));
+	}
+
+	ModuleTests::Report("%dx%d, %d steps: per-point loop %.2f ms/step, Waves %.2f ms/step (%u threads), one thread %.2f ms/step",
+		m, n, stepCount, referenceTime * 1000.0 / stepCount, wavesTime * 1000.0 / stepCount,
+		ThreadPool::Default().ThreadCount(), serialTime * 1000.0 / stepCount);
+	ModuleTests::Report("max height %g, max normal error %g, max tangent error %g", maxHeight, maxNormalError, maxTangentError);
+	CHECK(maxHeight > 0.01f);
+	CHECK(heightMismatches == 0);
+	CHECK(maxNormalError < 1e-6f);
+	CHECK(maxTangentError < 1e-6f);
+
+	// The boundary stays flat.
+	bool flatEdges = true;
+	for(int j = 0; j < n; ++j)
+		flatEdges = flatEdges && waves.Heights()[j] == 0.0f && waves.Heights()[(m - 1)*n + j] == 0.0f;
+	for(int i = 0; i < m; ++i)
+		flatEdges = flatEdges && waves.Heights()[i*n] == 0.0f && waves.Heights()[i*n + n - 1] == 0.0f;
+	CHECK(flatEdges);
+
+	// What the wave demos stream in place of whole vertices: the heights as they are,
+	// the heights as halves, and the normals as two snorms with y rebuilt the way
+	// WavesVS rebuilds it.
+	std::vector<float> heights(m*n);
+	waves.CopyHeights(heights.data());
+	CHECK(std::equal(heights.begin(), heights.end(), waves.Heights()));
+
+	std::vector<DirectX::PackedVector::HALF> halfHeights(m*n);
+	waves.CopyHeightsHalf(halfHeights.data());
+	std::vector<std::uint32_t> packedNormals(m*n);
+	waves.CopyPackedNormals(packedNormals.data());
+
+	int halfErrors = 0;
+	float maxHalfError = 0.0f, maxPackedError = 0.0f;
+	for(int i = 0; i < m*n; ++i)
+	{
+		float h = waves.Heights()[i];
+		float halfError = fabsf(DirectX::PackedVector::XMConvertHalfToFloat(halfHeights[i]) - h);
+		maxHalfError = (std::max)(maxHalfError, halfError);
+		// Halves keep 11 significant bits down to 2^-14, where the step stops shrinking.
+		halfErrors += halfError <= fabsf(h) / 1024.0f + 6.1e-5f ? 0 : 1;
+
+		float x = (std::max)((std::int16_t)(packedNormals[i] & 0xffff) / 32767.0f, -1.0f);
+		float z = (std::max)((std::int16_t)(packedNormals[i] >> 16) / 32767.0f, -1.0f);
+		float y = sqrtf((std::max)(1.0f - x*x - z*z, 0.0f));
+		XMFLOAT3 normal = waves.Normal(i);
+		maxPackedError = (std::max)(maxPackedError, (std::max)(fabsf(x - normal.x), (std::max)(fabsf(y - normal.y), fabsf(z - normal.z))));
+	}
+	ModuleTests::Report("heights only: %zu bytes per frame instead of %zu, max half height error %g, max packed normal error %g",
+		m*n*sizeof(float), m*n*(sizeof(XMFLOAT3)*2 + sizeof(XMFLOAT2)), maxHalfError, maxPackedError);
+	CHECK(halfErrors == 0);
+	CHECK(maxPackedError < 1e-3f);
+}
@@ -0,0 +1,32 @@
+//***************************************************************************************
+// Windows.h
+//
+// Stand-in for the Windows header outside Windows.  The modules the tests build take
+// only the integer typedefs and the min/max macros from it; min and max are templates
+// here, so std::min and std::max in the same file still compile.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short USHORT;
+typedef int INT;
+typedef unsigned int UINT;
+typedef unsigned long DWORD;
+typedef int8_t INT8;
+typedef int16_t INT16;
+typedef int32_t INT32;
+typedef int64_t INT64;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+
+template<typename T>
+inline T min(T a, T b) { return b < a ? b : a; }
+
+template<typename T>
+inline T max(T a, T b) { return a < b ? b : a; }
@@ -0,0 +1,44 @@
+//***************************************************************************************
+// ppl.h
+//
+// Stand-in for the parallel algorithms of the Parallel Patterns Library outside
+// Windows, run on Common/ThreadPool.  Only the overloads the modules call are here.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../../Common/ThreadPool.h"
+
+namespace concurrency
+{
+	template<typename Index, typename Func>
+	void parallel_for(Index first, Index last, Index step, const Func& func)
+	{
+		if(last <= first)
+			return;
+
+		const uint32_t count = (uint32_t)((last - first + step - 1) / step);
+		ThreadPool::Default().ParallelFor(count, [&](uint32_t i)
+		{
+			func((Index)(first + (Index)i*step));
+		});
+	}
+
+	template<typename Index, typename Func>
+	void parallel_for(Index first, Index last, const Func& func)
+	{
+		parallel_for(first, last, Index(1), func);
+	}
+
+	template<typename Func1, typename Func2>
+	void parallel_invoke(const Func1& func1, const Func2& func2)
+	{
+		ThreadPool::Default().ParallelFor(2, [&](uint32_t i)
+		{
+			if(i == 0)
+				func1();
+			else
+				func2();
+		});
+	}
+}